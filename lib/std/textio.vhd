@@ -426,40 +426,52 @@ package body textio is
     end procedure;
 
     procedure readline (file f: text; l: inout line) is
-        variable tmp  : line;
-        variable ch   : string(1 to 1);
-        variable used : natural;
-        variable got  : integer;
+        subtype chunk_t is string(1 to 256);
+
+        -- Reads from the file until the end of the line or the buffer is
+        -- full, sets done at the end of the line or file
+        procedure nvc_read_line (file f : text;
+                                 buf    : out chunk_t;
+                                 len    : in natural;
+                                 used   : out natural;
+                                 done   : out natural );
+        attribute foreign of nvc_read_line : procedure is
+            "_std_textio_read_line";
+
+        variable tmp   : line;
+        variable chunk : chunk_t;
+        variable used  : natural;
+        variable n     : natural;
+        variable done  : natural;
+        variable dummy : natural;
     begin
         if l /= null then
             deallocate(l);
         end if;
 
-        tmp := new string(1 to 128);
         loop
-            exit when endfile(f);
+            nvc_read_line(f, chunk, chunk'length, n, done);
 
-            read(f, ch, got);
-            exit when got /= 1;
-
-            next when ch(1) = CR;
-
-            if ch(1) = LF then
-                exit;
-            else
-                if used = tmp'length then
-                    grow(tmp, 128, used);
+            if n > 0 then
+                if tmp = null then
+                    tmp := new string(1 to chunk'length);
+                elsif used + n > tmp'length then
+                    grow(tmp, tmp'length, dummy);
                 end if;
-                used := used + 1;
-                tmp(used) := ch(1);
+                tmp(used + 1 to used + n) := chunk(1 to n);
+                used := used + n;
             end if;
+
+            exit when done /= 0;
         end loop;
 
         if used = 0 then
             l := new string'("");
-        else
+        elsif used < tmp'length then
             shrink(tmp, used);
             l := tmp;
+        else
+            l := tmp;
         end if;
     end procedure;
 
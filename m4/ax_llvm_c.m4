@@ -95,6 +95,21 @@ AC_DEFUN([AX_LLVM_C], [
                                  [LLVM has new ORC API])
           fi
 
+          if test "$llvm_ver_num" -ge "80"; then
+              AC_DEFINE_UNQUOTED(LLVM_HAS_GLOBAL_METADATA, [1],
+                                 [LLVM can attach metadata to functions])
+          fi
+
+          if test "$llvm_ver_num" -ge "110"; then
+              AC_DEFINE_UNQUOTED(LLVM_HAS_DEBUG_INFO, [1],
+                                 [LLVM has the current DIBuilder C API])
+          fi
+
+          if test "$llvm_ver_num" -ge "130"; then
+              AC_DEFINE_UNQUOTED(LLVM_HAS_LAZY_JIT, [1],
+                                 [LLVM has LLJIT and lazy re-exports in C API])
+          fi
+
           LLVM_OBJ_EXT="o"
           case $host_os in
               *cygwin*|msys*|mingw32*)
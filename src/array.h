@@ -19,6 +19,7 @@
 #define _ARRAY_H
 
 #include <assert.h>
+#include <stdint.h>
 
 #define ARRAY_BASE_SZ 8
 
@@ -93,4 +94,103 @@
    DECLARE_ARRAY(what)                 \
    DEFINE_ARRAY(what)
 
+//
+// Packed variant which keeps the count in a header in front of the
+// items so the array itself is a single pointer and an empty array
+// needs no storage at all
+//
+
+#define PACKED_ARRAY_BASE_SZ 2
+
+typedef struct {
+   uint32_t count;
+   uint32_t max;
+} array_hdr_t;
+
+#define ARRAY_HDR(items) (((array_hdr_t *)(items)) - 1)
+
+#define DEFINE_PACKED_ARRAY(what)                                \
+   static void what##_array_grow(what##_array_t *a, uint32_t max) \
+   {                                                             \
+      array_hdr_t *hdr = a->items ? ARRAY_HDR(a->items) : NULL;  \
+      const uint32_t count = hdr ? hdr->count : 0;               \
+      hdr = xrealloc(hdr, sizeof(array_hdr_t)                    \
+                     + max * sizeof(what##_t));                  \
+      hdr->count = count;                                        \
+      hdr->max   = max;                                          \
+      a->items = (what##_t *)(hdr + 1);                          \
+   }                                                             \
+                                                                 \
+   what##_t *what##_array_alloc(what##_array_t *a)               \
+   {                                                             \
+      if (unlikely(a->items == NULL))                            \
+         what##_array_grow(a, PACKED_ARRAY_BASE_SZ);             \
+      else if (ARRAY_HDR(a->items)->count                        \
+               == ARRAY_HDR(a->items)->max)                      \
+         what##_array_grow(a, ARRAY_HDR(a->items)->max * 2);     \
+                                                                 \
+      return &(a->items[ARRAY_HDR(a->items)->count++]);          \
+   }                                                             \
+                                                                 \
+   void what##_array_add(what##_array_t *a, what##_t t)          \
+   {                                                             \
+      *what##_array_alloc(a) = t;                                \
+   }                                                             \
+                                                                 \
+   void what##_array_resize(what##_array_t *a,                   \
+                            size_t n, uint8_t fill)              \
+   {                                                             \
+      if (n == 0 && a->items == NULL)                            \
+         return;                                                 \
+      else if (a->items == NULL || n > ARRAY_HDR(a->items)->max) \
+         what##_array_grow(a, n);                                \
+                                                                 \
+      array_hdr_t *hdr = ARRAY_HDR(a->items);                    \
+      if (n > hdr->count)                                        \
+         memset(a->items + hdr->count, fill,                     \
+                (n - hdr->count) * sizeof(what##_t));            \
+      hdr->count = n;                                            \
+   }                                                             \
+                                                                 \
+   void what##_array_free(what##_array_t *a)                     \
+   {                                                             \
+      if (a->items != NULL)                                      \
+         free(ARRAY_HDR(a->items));                              \
+      a->items = NULL;                                           \
+   }
+
+#define DECLARE_PACKED_ARRAY(what)                               \
+   typedef struct {                                              \
+      what##_t *items;                                           \
+   } what##_array_t;                                             \
+                                                                 \
+   void what##_array_add(what##_array_t *a, what##_t t);         \
+   what##_t *what##_array_alloc(what##_array_t *a);              \
+   void what##_array_resize(what##_array_t *a,                   \
+                            size_t n, uint8_t fill);             \
+   void what##_array_free(what##_array_t *a);                    \
+                                                                 \
+   __attribute__ ((unused))                                      \
+   static inline unsigned what##_array_count(                    \
+      const what##_array_t *a)                                   \
+   {                                                             \
+      return a->items == NULL ? 0 : ARRAY_HDR(a->items)->count;  \
+   }                                                             \
+                                                                 \
+   __attribute__ ((unused))                                      \
+   static inline what##_t *what##_array_nth_ptr(                 \
+      what##_array_t *a, unsigned n)                             \
+   {                                                             \
+      assert(n < what##_array_count(a));                         \
+      return &(a->items[n]);                                     \
+   }                                                             \
+                                                                 \
+   __attribute__ ((unused))                                      \
+   static inline what##_t what##_array_nth(what##_array_t *a,    \
+                                           unsigned n)           \
+   {                                                             \
+      assert(n < what##_array_count(a));                         \
+      return a->items[n];                                        \
+   }
+
 #endif  // _ARRAY_H
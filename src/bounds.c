@@ -25,7 +25,7 @@
 #include <stdlib.h>
 #include <inttypes.h>
 
-static void bounds_check_assignment(tree_t target, tree_t value);
+static bool bounds_check_assignment(tree_t target, tree_t value);
 
 typedef struct interval interval_t;
 
@@ -105,6 +105,105 @@ static bool is_out_of_range(tree_t value, range_t range, bool *checked)
    }
 }
 
+static bool bounds_type_range(type_t type, int64_t *low, int64_t *high)
+{
+   if (!type_is_scalar(type))
+      return false;
+
+   switch (type_base_kind(type)) {
+   case T_INTEGER:
+   case T_ENUM:
+      return folded_bounds(range_of(type, 0), low, high);
+   default:
+      return false;
+   }
+}
+
+static bool bounds_static_range(tree_t t, int64_t *low, int64_t *high)
+{
+   // Find an interval which always contains the value of the expression:
+   // every object holds a value of its subtype as assignments to it are
+   // checked so this only needs to follow a little arithmetic
+
+   int64_t ival;
+   unsigned uval;
+   if (folded_int(t, &ival)) {
+      *low = *high = ival;
+      return true;
+   }
+   else if (folded_enum(t, &uval)) {
+      *low = *high = uval;
+      return true;
+   }
+
+   switch (tree_kind(t)) {
+   case T_REF:
+      {
+         tree_t decl = tree_ref(t);
+         // Ports and signals may take the subtype of another object
+         // through a port map so only local objects are followed
+         const tree_kind_t kind = tree_kind(decl);
+         if (kind != T_VAR_DECL && kind != T_CONST_DECL)
+            return false;
+
+         return bounds_type_range(tree_type(decl), low, high);
+      }
+
+   case T_QUALIFIED:
+      return bounds_static_range(tree_value(t), low, high);
+
+   case T_FCALL:
+      {
+         ident_t builtin = tree_attr_str(tree_ref(t), builtin_i);
+         if (builtin == NULL || tree_params(t) != 2)
+            return false;
+
+         int64_t llow, lhigh, rlow, rhigh;
+         if (!bounds_static_range(tree_value(tree_param(t, 0)), &llow, &lhigh)
+             || !bounds_static_range(tree_value(tree_param(t, 1)),
+                                     &rlow, &rhigh))
+            return false;
+
+         bool overflow = false;
+         if (icmp(builtin, "add")) {
+            overflow |= __builtin_add_overflow(llow, rlow, low);
+            overflow |= __builtin_add_overflow(lhigh, rhigh, high);
+         }
+         else if (icmp(builtin, "sub")) {
+            overflow |= __builtin_sub_overflow(llow, rhigh, low);
+            overflow |= __builtin_sub_overflow(lhigh, rlow, high);
+         }
+         else if (icmp(builtin, "mul")) {
+            int64_t p[4];
+            overflow |= __builtin_mul_overflow(llow, rlow, &(p[0]));
+            overflow |= __builtin_mul_overflow(llow, rhigh, &(p[1]));
+            overflow |= __builtin_mul_overflow(lhigh, rlow, &(p[2]));
+            overflow |= __builtin_mul_overflow(lhigh, rhigh, &(p[3]));
+            *low = *high = p[0];
+            for (int i = 1; i < 4; i++) {
+               *low  = MIN(*low, p[i]);
+               *high = MAX(*high, p[i]);
+            }
+         }
+         else
+            return false;
+
+         return !overflow;
+      }
+
+   default:
+      return false;
+   }
+}
+
+static bool bounds_statically_within(tree_t value, range_t range)
+{
+   int64_t vlow, vhigh, low, high;
+   return bounds_static_range(value, &vlow, &vhigh)
+      && folded_bounds(range, &low, &high)
+      && vlow >= low && vhigh <= high;
+}
+
 static const char *value_str(tree_t value)
 {
    static const int BUF_SZ = 64;
@@ -280,6 +379,10 @@ static void bounds_check_array_ref(tree_t t)
             checked = true;
       }
 
+      if (!checked && !unconstrained
+          && bounds_statically_within(pvalue, range_of(value_type, i)))
+         checked = true;
+
       if (checked)
          nstatic++;
    }
@@ -547,8 +650,9 @@ static void bounds_check_decl(tree_t t)
    }
 }
 
-static void bounds_check_assignment(tree_t target, tree_t value)
+static bool bounds_check_assignment(tree_t target, tree_t value)
 {
+   // Returns true if a scalar value is always within the target subtype
    type_t target_type = tree_type(target);
    type_t value_type  = tree_type(value);
 
@@ -587,7 +691,11 @@ static void bounds_check_assignment(tree_t target, tree_t value)
                       (r.kind == RANGE_TO) ? "to" : "downto",
                       value_str(r.right));
       }
+      else
+         return bounds_statically_within(value, r);
    }
+
+   return false;
 }
 
 static void bounds_check_signal_assign(tree_t t)
@@ -595,11 +703,13 @@ static void bounds_check_signal_assign(tree_t t)
    int64_t last_delay = 0;
    tree_t target = tree_target(t);
 
+   bool in_bounds = true;
    const int nwaves = tree_waveforms(t);
    for (int i = 0; i < nwaves; i++) {
       tree_t w = tree_waveform(t, i);
 
-      bounds_check_assignment(target, tree_value(w));
+      if (!bounds_check_assignment(target, tree_value(w)))
+         in_bounds = false;
 
       int64_t delay = 0;
       bool delay_is_known = true;
@@ -630,11 +740,15 @@ static void bounds_check_signal_assign(tree_t t)
       // even if the delay isn't known, it has to be at least zero
       last_delay = delay;
    }
+
+   if (in_bounds && nwaves > 0)
+      tree_add_attr_int(t, elide_bounds_i, 1);
 }
 
 static void bounds_check_var_assign(tree_t t)
 {
-   bounds_check_assignment(tree_target(t), tree_value(t));
+   if (bounds_check_assignment(tree_target(t), tree_value(t)))
+      tree_add_attr_int(t, elide_bounds_i, 1);
 }
 
 static void bounds_case_cover(interval_t **isp, tree_t t,
@@ -17,32 +17,59 @@
 
 #include "util.h"
 #include "phase.h"
+#include "mem.h"
 #include "lib.h"
 #include "common.h"
 #include "vcode.h"
 #include "array.h"
+#include "hash.h"
 #include "rt/rt.h"
 #include "rt/cover.h"
+#include "rt/pgo.h"
 
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <inttypes.h>
 #include <unistd.h>
+#include <dirent.h>
+#include <time.h>
+#include <utime.h>
 #include <sys/stat.h>
 
 #include <llvm-c/Core.h>
+#include <llvm-c/BitReader.h>
 #include <llvm-c/BitWriter.h>
 #include <llvm-c/ExecutionEngine.h>
+#include <llvm-c/Linker.h>
 #include <llvm-c/Analysis.h>
 #include <llvm-c/Transforms/Scalar.h>
 #include <llvm-c/Transforms/IPO.h>
 #include <llvm-c/Transforms/PassManagerBuilder.h>
 #include <llvm-c/TargetMachine.h>
 
+#if LLVM_HAS_DEBUG_INFO
+#include <llvm-c/DebugInfo.h>
+#endif
+
+#if LLVM_HAS_LAZY_JIT
+#include <llvm-c/Error.h>
+#include <llvm-c/LLJIT.h>
+#include <llvm-c/Orc.h>
+#include <llvm-c/OrcEE.h>
+#endif
+
+#if RT_MULTITHREAD
+#include <pthread.h>
+#endif
+
 #undef NDEBUG
 #include <assert.h>
 
-#define MAX_STATIC_NETS 256
+#define MAX_STATIC_NETS  256
+#define MODULE_INSNS     50000
+#define CACHE_MAX_SIZE   (256 * 1024 * 1024)
+#define MAX_PACKED_ELEMS 256
 
 typedef struct {
    LLVMValueRef      *regs;
@@ -54,6 +81,11 @@ typedef struct {
    size_t             param_base;
    LLVMValueRef      *locals;
    loc_t              last_loc;
+   LLVMValueRef       pgo_counters;
+   const uint64_t    *pgo_counts;
+#if LLVM_HAS_DEBUG_INFO
+   LLVMMetadataRef    debug_scope;
+#endif
 } cgen_ctx_t;
 
 typedef struct {
@@ -71,19 +103,94 @@ typedef enum {
    FUNC_ATTR_READONLY,
    FUNC_ATTR_NOCAPTURE,
    FUNC_ATTR_BYVAL,
+   FUNC_ATTR_COLD,
+   FUNC_ATTR_NOINLINE,
+   FUNC_ATTR_OPTNONE,
 
    FUNC_ATTR_DLLEXPORT,   // Should be last
 } func_attr_t;
 
+typedef struct {
+   LLVMModuleRef       module;
+   LLVMMemoryBufferRef bitcode;
+   char               *obj_path;
+   char               *tmp_path;
+} cgen_job_t;
+
 static LLVMModuleRef  module = NULL;
 static LLVMBuilderRef builder = NULL;
 
+// Large designs are split into several modules which are optimised and
+// compiled in parallel: the first module defines all the signals and
+// shared variables and the others only declare them
+static LLVMModuleRef *modules = NULL;
+static unsigned       nmodules = 0;
+static unsigned       module_insns = 0;
+static unsigned       max_module_insns = 0;
+
+// Read-only copies of constant aggregates in the current module keyed
+// by the uniqued LLVM constant so identical values share one global
+static hash_t        *const_data = NULL;
+
+// Bitcode for the runtime support functions in rt/inline.c which is
+// linked into every module so calls to them can be inlined
+static LLVMMemoryBufferRef rtinline_bc = NULL;
+static uint64_t            rtinline_hash = 0;
+
+#if LLVM_HAS_DEBUG_INFO
+// Line tables for --debug-info are built separately for each module
+static LLVMDIBuilderRef debug_builder = NULL;
+static hash_t          *debug_files = NULL;
+#endif
+
+// Block counts from a previous run with --pgo-collect
+static pgo_t   *pgo_profile = NULL;
+static unsigned pgo_matched = 0;
+static unsigned pgo_procs = 0;
+
+static cover_mode_t cover_mode = COVER_NONE;
+
+static LLVMTargetRef       target_ref = NULL;
+static char               *target_triple = NULL;
+static char               *target_layout = NULL;
+static LLVMTargetDataRef   target_data = NULL;
+static LLVMCodeGenOptLevel code_gen_level = LLVMCodeGenLevelDefault;
+
+#if RT_MULTITHREAD
+static cgen_job_t     *jobs = NULL;
+static unsigned        njobs = 0;
+static unsigned        next_job = 0;
+static pthread_mutex_t job_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+#if LLVM_HAS_LAZY_JIT
+typedef struct {
+   char     *name;
+   unsigned  module;
+} cgen_lazy_t;
+
+// With --jit every process is reached through a lazy stub which
+// compiles the module containing its body on the first call
+static LLVMOrcLLJITRef                  jit = NULL;
+static LLVMOrcLazyCallThroughManagerRef jit_lctm = NULL;
+static LLVMOrcIndirectStubsManagerRef   jit_ism = NULL;
+static cgen_lazy_t                     *lazy_procs = NULL;
+static size_t                           n_lazy_procs = 0;
+static size_t                           max_lazy_procs = 0;
+#endif
+
 static char **link_args = NULL;
 static size_t n_link_args = 0;
 static size_t max_link_args = 0;
 
+// Packages linked into the shared library with --bundle found when the
+// symbol table is generated and used again for the link step
+static ident_list_t *bundle_units = NULL;
+
 static LLVMValueRef cgen_support_fn(const char *name);
 static LLVMValueRef cgen_resolution_wrapper(const vcode_res_elem_t *rdata);
+static void cgen_new_module(tree_t top, vcode_unit_t vcode, ident_t name);
+static void cgen_tmp_stack(void);
 
 static LLVMValueRef llvm_int1(bool b)
 {
@@ -258,7 +365,8 @@ static void cgen_add_func_attr(LLVMValueRef fn, func_attr_t attr, int param)
 
 #if LLVM_NEW_ATTRIBUTE_API
    const char *names[] = {
-      "nounwind", "noreturn", "readonly", "nocapture", "byval"
+      "nounwind", "noreturn", "readonly", "nocapture", "byval", "cold",
+      "noinline", "optnone"
    };
    assert(attr < ARRAY_LEN(names));
 
@@ -277,10 +385,16 @@ static void cgen_add_func_attr(LLVMValueRef fn, func_attr_t attr, int param)
       LLVMNoReturnAttribute,
       LLVMReadOnlyAttribute,
       LLVMNoCaptureAttribute,
-      LLVMByValAttribute
+      LLVMByValAttribute,
+      0,    // Cold not available
+      LLVMNoInlineAttribute,
+      0     // Optnone not available
    };
    assert(attr < ARRAY_LEN(llvm_attrs));
 
+   if (llvm_attrs[attr] == 0)
+      return;
+
    if (param == -1)
       LLVMAddFunctionAttr(fn, llvm_attrs[attr]);
    else
@@ -437,10 +551,34 @@ static LLVMValueRef cgen_get_var(vcode_var_t var, cgen_ctx_t *ctx)
       return value;
 }
 
+#if RT_MULTITHREAD
+static void cgen_thread_local(LLVMValueRef var)
+{
+   // The variable is defined in the nvc executable whose thread local
+   // block is always allocated at startup so the initial exec model
+   // can use a fixed offset from the thread pointer instead of calling
+   // __tls_get_addr on every access from a shared library
+   LLVMSetThreadLocalMode(var, LLVMInitialExecTLSModel);
+}
+#endif
+
+static LLVMValueRef cgen_tmp_global(const char *name)
+{
+#if LLVM_HAS_LAZY_JIT && RT_MULTITHREAD
+   if (lazy_procs != NULL) {
+      // The JIT cannot resolve thread local variables in the runtime
+      char *fname LOCAL = xasprintf("%s_ptr", name);
+      return LLVMBuildCall(builder, llvm_fn(fname), NULL, 0, "");
+   }
+#endif
+
+   return LLVMGetNamedGlobal(module, name);
+}
+
 static LLVMValueRef cgen_tmp_alloc(LLVMValueRef bytes, LLVMTypeRef type)
 {
-   LLVMValueRef _tmp_stack_ptr = LLVMGetNamedGlobal(module, "_tmp_stack");
-   LLVMValueRef _tmp_alloc_ptr = LLVMGetNamedGlobal(module, "_tmp_alloc");
+   LLVMValueRef _tmp_stack_ptr = cgen_tmp_global("_tmp_stack");
+   LLVMValueRef _tmp_alloc_ptr = cgen_tmp_global("_tmp_alloc");
 
    LLVMValueRef alloc = LLVMBuildLoad(builder, _tmp_alloc_ptr, "alloc");
    LLVMValueRef stack = LLVMBuildLoad(builder, _tmp_stack_ptr, "stack");
@@ -947,16 +1085,52 @@ static void cgen_op_wait(int op, cgen_ctx_t *ctx)
       LLVMBuildRetVoid(builder);
 }
 
+static void cgen_store(LLVMValueRef value, LLVMValueRef ptr)
+{
+   // Constant aggregates such as records initialised from an aggregate
+   // are copied from read-only global data rather than stored as a
+   // single first class value which LLVM expands field by field
+
+   LLVMTypeRef type = LLVMTypeOf(value);
+   const LLVMTypeKind kind = LLVMGetTypeKind(type);
+   if (!LLVMIsConstant(value) || LLVMIsUndef(value)
+       || (kind != LLVMStructTypeKind && kind != LLVMArrayTypeKind)) {
+      LLVMBuildStore(builder, value, ptr);
+      return;
+   }
+
+   // The destination holds a value of the same type so has at least
+   // its ABI alignment which may be a single byte for bit arrays
+   const unsigned align = LLVMABIAlignmentOfType(target_data, type);
+
+   LLVMValueRef global = hash_get(const_data, value);
+   if (global == NULL) {
+      char *name LOCAL =
+         xasprintf("%s_const_data", istr(vcode_unit_name()));
+
+      global = LLVMAddGlobal(module, type, name);
+      LLVMSetLinkage(global, LLVMPrivateLinkage);
+      LLVMSetGlobalConstant(global, true);
+      LLVMSetUnnamedAddr(global, true);
+      LLVMSetInitializer(global, value);
+      LLVMSetAlignment(global, align);
+
+      hash_put(const_data, value, global);
+   }
+
+   LLVMBuildMemCpy(builder, ptr, align, global, align, llvm_sizeof(type));
+}
+
 static void cgen_op_store(int op, cgen_ctx_t *ctx)
 {
    vcode_var_t var = vcode_get_address(op);
 
-   LLVMBuildStore(builder, cgen_get_arg(op, 0, ctx), cgen_get_var(var, ctx));
+   cgen_store(cgen_get_arg(op, 0, ctx), cgen_get_var(var, ctx));
 }
 
 static void cgen_op_store_indirect(int op, cgen_ctx_t *ctx)
 {
-   LLVMBuildStore(builder, cgen_get_arg(op, 0, ctx), cgen_get_arg(op, 1, ctx));
+   cgen_store(cgen_get_arg(op, 0, ctx), cgen_get_arg(op, 1, ctx));
 }
 
 static void cgen_op_load(int op, cgen_ctx_t *ctx)
@@ -1411,6 +1585,24 @@ static void cgen_op_image(int op, cgen_ctx_t *ctx)
    const bool is_signed = arg_kind == VCODE_TYPE_INT && vtype_low(arg_type) < 0;
    const bool real = (arg_kind == VCODE_TYPE_REAL);
 
+   LLVMOpcode cop = real ? LLVMBitCast : (is_signed ? LLVMSExt : LLVMZExt);
+   LLVMValueRef res = LLVMBuildAlloca(builder,
+                                      llvm_uarray_type(LLVMInt8Type(), 1),
+                                      "image");
+   LLVMValueRef val =
+      LLVMBuildCast(builder, cop, ctx->regs[arg], LLVMInt64Type(), "");
+
+   vcode_reg_t result = vcode_get_result(op);
+
+   if (!real && vcode_count_args(op) == 1) {
+      // Integers do not need a map so use the specialised entry point
+      LLVMValueRef iargs[] = { val, res };
+      LLVMBuildCall(builder, llvm_fn("_image_int"), iargs,
+                    ARRAY_LEN(iargs), "");
+      ctx->regs[result] = LLVMBuildLoad(builder, res, cgen_reg_name(result));
+      return;
+   }
+
    LLVMValueRef image_map;
    if (vcode_count_args(op) > 1)
       image_map = cgen_get_arg(op, 1, ctx);
@@ -1425,18 +1617,9 @@ static void cgen_op_image(int op, cgen_ctx_t *ctx)
          image_map);
    }
 
-   LLVMOpcode cop = real ? LLVMBitCast : (is_signed ? LLVMSExt : LLVMZExt);
-   LLVMValueRef res = LLVMBuildAlloca(builder,
-                                      llvm_uarray_type(LLVMInt8Type(), 1),
-                                      "image");
-   LLVMValueRef iargs[] = {
-      LLVMBuildCast(builder, cop, ctx->regs[arg], LLVMInt64Type(), ""),
-      image_map,
-      res
-   };
+   LLVMValueRef iargs[] = { val, image_map, res };
    LLVMBuildCall(builder, llvm_fn("_image"), iargs, ARRAY_LEN(iargs), "");
 
-   vcode_reg_t result = vcode_get_result(op);
    ctx->regs[result] = LLVMBuildLoad(builder, res, cgen_reg_name(result));
 }
 
@@ -1511,12 +1694,44 @@ static void cgen_op_alloca(int op, cgen_ctx_t *ctx)
    }
 }
 
+static void cgen_branch_weights(LLVMValueRef br, int op, int ntargets,
+                                cgen_ctx_t *ctx)
+{
+   // The weight of each edge is the count of the block it leads to which
+   // is exact for the blocks which have a single predecessor
+
+   uint64_t max = 0;
+   for (int i = 0; i < ntargets; i++)
+      max = MAX(max, ctx->pgo_counts[vcode_get_target(op, i) + 1]);
+
+   if (max == 0)
+      return;   // Never executed
+
+   // Branch weights are 32-bit so scale down very large counts
+   int shift = 0;
+   while ((max >> shift) > UINT32_MAX)
+      shift++;
+
+   LLVMValueRef md[ntargets + 1];
+   md[0] = LLVMMDString("branch_weights", 14);
+   for (int i = 0; i < ntargets; i++) {
+      const uint64_t count = ctx->pgo_counts[vcode_get_target(op, i) + 1];
+      md[i + 1] = llvm_int32(count >> shift);
+   }
+
+   LLVMSetMetadata(br, LLVMGetMDKindID("prof", 4),
+                   LLVMMDNode(md, ntargets + 1));
+}
+
 static void cgen_op_cond(int op, cgen_ctx_t *ctx)
 {
    LLVMValueRef test = cgen_get_arg(op, 0, ctx);
-   LLVMBuildCondBr(builder, test,
-                   ctx->blocks[vcode_get_target(op, 0)],
-                   ctx->blocks[vcode_get_target(op, 1)]);
+   LLVMValueRef br = LLVMBuildCondBr(builder, test,
+                                     ctx->blocks[vcode_get_target(op, 0)],
+                                     ctx->blocks[vcode_get_target(op, 1)]);
+
+   if (ctx->pgo_counts != NULL)
+      cgen_branch_weights(br, op, 2, ctx);
 }
 
 static void cgen_op_wrap(int op, cgen_ctx_t *ctx)
@@ -1822,6 +2037,10 @@ static LLVMValueRef cgen_resolution_wrapper(const vcode_res_elem_t *rdata)
                         LLVMFunctionType(result_type, args,
                                          ARRAY_LEN(args), false));
 
+   // Each module which needs a wrapper generates its own copy so these
+   // must not clash when objects are linked together
+   LLVMSetLinkage(fn, LLVMInternalLinkage);
+
    LLVMBasicBlockRef saved_bb = LLVMGetInsertBlock(builder);
 
    LLVMBasicBlockRef entry_bb = LLVMAppendBasicBlock(fn, "entry");
@@ -1906,7 +2125,31 @@ static void cgen_op_set_initial(int op, cgen_ctx_t *ctx)
       LLVMSetUnnamedAddr(name_ll, true);
    }
 
-   if (size_list.count == 1 && size_list.items[0].flags == 0) {
+   vcode_reg_t fill_reg;
+   const bool uniform = size_list.count == 1 && size_list.items[0].flags == 0
+      && vcode_reg_const_fill(vcode_get_arg(op, 0), &fill_reg);
+
+   if (uniform) {
+      // Initialise every element with one fill instead of copying
+      // from a constant array
+      LLVMValueRef fill = ctx->regs[fill_reg];
+      if (vcode_reg_kind(fill_reg) == VCODE_TYPE_REAL)
+         fill = LLVMBuildBitCast(builder, fill, LLVMInt64Type(), "");
+      else
+         fill = LLVMBuildZExt(builder, fill, LLVMInt64Type(), "");
+
+      LLVMValueRef args[] = {
+         llvm_int32(nid),
+         fill,
+         size_list.items[0].size,
+         llvm_int32(size_list.items[0].count),
+         llvm_void_cast(size_list.items[0].resolution),
+         llvm_void_cast(name_ll)
+      };
+      LLVMBuildCall(builder, llvm_fn("_set_initial_fill"), args,
+                    ARRAY_LEN(args), "");
+   }
+   else if (size_list.count == 1 && size_list.items[0].flags == 0) {
       LLVMValueRef args[] = {
          llvm_int32(nid),
          llvm_void_cast(valptr),
@@ -2011,11 +2254,67 @@ static void cgen_op_const_record(int op, cgen_ctx_t *ctx)
    ctx->regs[result] = LLVMConstNamedStruct(lltype, fields, nargs);
 }
 
+static int cgen_packed_length(int op, int nth, LLVMValueRef data)
+{
+   // Arrays of integers or enumerations with a small constant length are
+   // loaded into LLVM vector registers rather than processed one element
+   // at a time: returns zero if this is not possible
+
+   if (LLVMGetTypeKind(LLVMGetElementType(LLVMTypeOf(data)))
+       != LLVMIntegerTypeKind)
+      return 0;
+
+   int64_t length;
+   if (!vcode_reg_const(vcode_get_arg(op, nth), &length))
+      return 0;
+   else if (length < 1 || length > MAX_PACKED_ELEMS)
+      return 0;
+   else
+      return length;
+}
+
+static LLVMTypeRef cgen_packed_type(LLVMValueRef data, int length)
+{
+   // Each i1 is stored in a byte whereas an <N x i1> vector is stored
+   // as a bit mask so load those as bytes valued zero or one
+   LLVMTypeRef elem = LLVMGetElementType(LLVMTypeOf(data));
+   if (LLVMGetIntTypeWidth(elem) < 8)
+      elem = LLVMInt8Type();
+
+   return LLVMVectorType(elem, length);
+}
+
+static LLVMValueRef cgen_packed_load(LLVMValueRef data, int length)
+{
+   LLVMTypeRef type = cgen_packed_type(data, length);
+   LLVMValueRef ptr =
+      LLVMBuildPointerCast(builder, data, LLVMPointerType(type, 0), "");
+   LLVMValueRef load = LLVMBuildLoad(builder, ptr, "");
+   LLVMSetAlignment(load, 1);
+   return load;
+}
+
+static void cgen_packed_store(LLVMValueRef value, LLVMValueRef data)
+{
+   LLVMValueRef ptr = LLVMBuildPointerCast(
+      builder, data, LLVMPointerType(LLVMTypeOf(value), 0), "");
+   LLVMValueRef store = LLVMBuildStore(builder, value, ptr);
+   LLVMSetAlignment(store, 1);
+}
+
 static void cgen_op_copy(int op, cgen_ctx_t *ctx)
 {
    LLVMValueRef dest = cgen_get_arg(op, 0, ctx);
    LLVMValueRef src  = cgen_get_arg(op, 1, ctx);
 
+   const int packed = (vcode_count_args(op) > 2)
+      ? cgen_packed_length(op, 2, src) : 0;
+   if (packed > 0) {
+      // Loading the whole vector before storing it is a valid memmove
+      cgen_packed_store(cgen_packed_load(src, packed), dest);
+      return;
+   }
+
    LLVMValueRef count = NULL;
    if (vcode_count_args(op) > 2)
       count = cgen_get_arg(op, 2, ctx);
@@ -2170,6 +2469,22 @@ static void cgen_op_memcmp(int op, cgen_ctx_t *ctx)
    LLVMValueRef rhs_data = cgen_get_arg(op, 1, ctx);
    LLVMValueRef length   = cgen_get_arg(op, 2, ctx);
 
+   const int packed = cgen_packed_length(op, 2, lhs_data);
+   if (packed > 0) {
+      // Compare all the elements at once and then test the resulting
+      // vector of i1 as a single bit-packed integer
+      LLVMValueRef cmp = LLVMBuildICmp(builder, LLVMIntEQ,
+                                       cgen_packed_load(lhs_data, packed),
+                                       cgen_packed_load(rhs_data, packed),
+                                       "");
+      LLVMTypeRef mask_type = LLVMIntType(packed);
+      LLVMValueRef mask = LLVMBuildBitCast(builder, cmp, mask_type, "");
+      ctx->regs[result] = LLVMBuildICmp(builder, LLVMIntEQ, mask,
+                                        LLVMConstAllOnes(mask_type),
+                                        cgen_reg_name(result));
+      return;
+   }
+
    LLVMValueRef i = LLVMBuildAlloca(builder, LLVMInt32Type(), "i");
    LLVMBuildStore(builder, llvm_int32(0), i);
 
@@ -2293,6 +2608,9 @@ static void cgen_op_case(int op, cgen_ctx_t *ctx)
    for (int i = 0; i < num_cases; i++)
       LLVMAddCase(sw, cgen_get_arg(op, i + 1, ctx),
                   ctx->blocks[vcode_get_target(op, i + 1)]);
+
+   if (ctx->pgo_counts != NULL)
+      cgen_branch_weights(sw, op, num_cases + 1, ctx);
 }
 
 static void cgen_op_file_open(int op, cgen_ctx_t *ctx)
@@ -2510,13 +2828,109 @@ static void cgen_op_bit_shift(int op, cgen_ctx_t *ctx)
    ctx->regs[result] = LLVMBuildLoad(builder, tmp, cgen_reg_name(result));
 }
 
+static LLVMValueRef cgen_packed_bit_vec_op(int op, int length,
+                                           cgen_ctx_t *ctx)
+{
+   LLVMValueRef left_data = cgen_get_arg(op, 0, ctx);
+   LLVMValueRef left_dir  = cgen_get_arg(op, 2, ctx);
+
+   LLVMValueRef left = cgen_packed_load(left_data, length);
+   LLVMValueRef right = NULL;
+   if (vcode_count_args(op) == 6)
+      right = cgen_packed_load(cgen_get_arg(op, 3, ctx), length);
+
+   // Bits are stored as bytes valued zero or one
+   LLVMValueRef ones_elems[length];
+   for (int i = 0; i < length; i++)
+      ones_elems[i] = llvm_int8(1);
+   LLVMValueRef ones = LLVMConstVector(ones_elems, length);
+
+   LLVMValueRef value = NULL;
+   switch (vcode_get_subkind(op)) {
+   case BIT_VEC_NOT:
+      value = LLVMBuildXor(builder, left, ones, "");
+      break;
+   case BIT_VEC_AND:
+      value = LLVMBuildAnd(builder, left, right, "");
+      break;
+   case BIT_VEC_OR:
+      value = LLVMBuildOr(builder, left, right, "");
+      break;
+   case BIT_VEC_XOR:
+      value = LLVMBuildXor(builder, left, right, "");
+      break;
+   case BIT_VEC_XNOR:
+      value = LLVMBuildXor(builder, LLVMBuildXor(builder, left, right, ""),
+                           ones, "");
+      break;
+   case BIT_VEC_NAND:
+      value = LLVMBuildXor(builder, LLVMBuildAnd(builder, left, right, ""),
+                           ones, "");
+      break;
+   case BIT_VEC_NOR:
+      value = LLVMBuildXor(builder, LLVMBuildOr(builder, left, right, ""),
+                           ones, "");
+      break;
+   default:
+      return NULL;
+   }
+
+   LLVMTypeRef elem_type = LLVMGetElementType(LLVMTypeOf(left_data));
+   LLVMValueRef buf = cgen_tmp_alloc(llvm_int32(length), elem_type);
+   cgen_packed_store(value, buf);
+
+   // The result has the same direction as the left argument and is
+   // indexed from zero like the runtime version
+   LLVMValueRef is_to = LLVMBuildICmp(builder, LLVMIntEQ, left_dir,
+                                      LLVMConstInt(LLVMTypeOf(left_dir),
+                                                   RANGE_TO, false), "");
+   LLVMValueRef zero = llvm_int32(0), high = llvm_int32(length - 1);
+
+   vcode_reg_t result = vcode_get_result(op);
+   LLVMTypeRef uarray_type = cgen_type(vcode_reg_type(result));
+
+   LLVMValueRef u = LLVMGetUndef(uarray_type);
+   u = LLVMBuildInsertValue(builder, u, buf, 0, "");
+
+   LLVMValueRef dims = LLVMBuildExtractValue(builder, u, 1, "");
+   LLVMValueRef dim = LLVMBuildExtractValue(builder, dims, 0, "");
+   dim = LLVMBuildInsertValue(builder, dim,
+                              LLVMBuildSelect(builder, is_to, zero, high, ""),
+                              0, "");
+   dim = LLVMBuildInsertValue(builder, dim,
+                              LLVMBuildSelect(builder, is_to, high, zero, ""),
+                              1, "");
+   dim = LLVMBuildInsertValue(builder, dim, left_dir, 2, "");
+   dims = LLVMBuildInsertValue(builder, dims, dim, 0, "");
+
+   return LLVMBuildInsertValue(builder, u, dims, 1, cgen_reg_name(result));
+}
+
 static void cgen_op_bit_vec_op(int op, cgen_ctx_t *ctx)
 {
+   LLVMValueRef left_data = cgen_get_arg(op, 0, ctx);
+
+   int packed = cgen_packed_length(op, 1, left_data);
+   if (packed > 0 && vcode_count_args(op) == 6) {
+      // Length mismatches are reported by the runtime
+      int64_t right_len;
+      if (!vcode_reg_const(vcode_get_arg(op, 4), &right_len)
+          || right_len != packed)
+         packed = 0;
+   }
+
+   if (packed > 0) {
+      LLVMValueRef value = cgen_packed_bit_vec_op(op, packed, ctx);
+      if (value != NULL) {
+         ctx->regs[vcode_get_result(op)] = value;
+         return;
+      }
+   }
+
    LLVMValueRef tmp = LLVMBuildAlloca(builder,
                                       llvm_uarray_type(LLVMInt1Type(), 1),
                                       "bit_vec_op");
 
-   LLVMValueRef left_data = cgen_get_arg(op, 0, ctx);
    LLVMValueRef left_len  = cgen_get_arg(op, 1, ctx);
    LLVMValueRef left_dir  = cgen_get_arg(op, 2, ctx);
 
@@ -2658,15 +3072,41 @@ static void cgen_op_debug_out(int op, cgen_ctx_t *ctx)
    }
 }
 
+static LLVMValueRef cgen_cover_counter(const char *name, int index)
+{
+#if RT_MULTITHREAD
+   // Each kernel thread counts into its own shard of the array which
+   // the runtime adds up when it writes the report
+   char *shard_name LOCAL = xasprintf("_%s", name);
+   LLVMValueRef shard =
+      LLVMBuildLoad(builder, cgen_tmp_global(shard_name), "shard");
+   LLVMValueRef indexes[] = { llvm_int32(index) };
+#else
+   LLVMValueRef shard = LLVMGetNamedGlobal(module, name);
+   LLVMValueRef indexes[] = { llvm_int32(0), llvm_int32(index) };
+#endif
+
+   return LLVMBuildGEP(builder, shard, indexes, ARRAY_LEN(indexes), "");
+}
+
 static void cgen_op_cover_stmt(int op, cgen_ctx_t *ctx)
 {
    const uint32_t cover_tag = vcode_get_tag(op);
 
-   LLVMValueRef cover_counts = LLVMGetNamedGlobal(module, "cover_stmts");
+   if (cover_mode == COVER_HIT) {
+      // A constant store needs no load and cannot lose an update when
+      // several threads execute the statement at once
+      LLVMValueRef cover_hits = LLVMGetNamedGlobal(module, "cover_stmts");
 
-   LLVMValueRef indexes[] = { llvm_int32(0), llvm_int32(cover_tag) };
-   LLVMValueRef count_ptr = LLVMBuildGEP(builder, cover_counts,
-                                         indexes, ARRAY_LEN(indexes), "");
+      LLVMValueRef indexes[] = { llvm_int32(0), llvm_int32(cover_tag) };
+      LLVMValueRef hit_ptr = LLVMBuildGEP(builder, cover_hits,
+                                          indexes, ARRAY_LEN(indexes), "");
+
+      LLVMBuildStore(builder, llvm_int8(1), hit_ptr);
+      return;
+   }
+
+   LLVMValueRef count_ptr = cgen_cover_counter("cover_stmts", cover_tag);
 
    LLVMValueRef count = LLVMBuildLoad(builder, count_ptr, "cover_count");
    LLVMValueRef count1 = LLVMBuildAdd(builder, count, llvm_int32(1), "");
@@ -2679,11 +3119,25 @@ static void cgen_op_cover_cond(int op, cgen_ctx_t *ctx)
    const uint32_t cover_tag = vcode_get_tag(op);
    const int sub_cond  = vcode_get_subkind(op);
 
-   LLVMValueRef cover_conds = LLVMGetNamedGlobal(module, "cover_conds");
+   if (cover_mode == COVER_HIT) {
+      // Each sub-condition has a byte for false followed by one for true
+      LLVMValueRef cover_hits = LLVMGetNamedGlobal(module, "cover_conds");
+
+      LLVMValueRef outcome = LLVMBuildZExt(builder, cgen_get_arg(op, 0, ctx),
+                                           LLVMInt32Type(), "");
+      LLVMValueRef index = LLVMBuildAdd(
+         builder, outcome,
+         llvm_int32(cover_tag * COVER_HIT_BYTES + sub_cond * 2), "");
+
+      LLVMValueRef indexes[] = { llvm_int32(0), index };
+      LLVMValueRef hit_ptr = LLVMBuildGEP(builder, cover_hits,
+                                          indexes, ARRAY_LEN(indexes), "");
+
+      LLVMBuildStore(builder, llvm_int8(1), hit_ptr);
+      return;
+   }
 
-   LLVMValueRef indexes[] = { llvm_int32(0), llvm_int32(cover_tag) };
-   LLVMValueRef mask_ptr = LLVMBuildGEP(builder, cover_conds,
-                                        indexes, ARRAY_LEN(indexes), "");
+   LLVMValueRef mask_ptr = cgen_cover_counter("cover_conds", cover_tag);
 
    LLVMValueRef mask = LLVMBuildLoad(builder, mask_ptr, "cover_conds");
 
@@ -2702,7 +3156,7 @@ static void cgen_op_cover_cond(int op, cgen_ctx_t *ctx)
 
 static void cgen_op_heap_save(int op, cgen_ctx_t *ctx)
 {
-   LLVMValueRef cur_ptr = LLVMGetNamedGlobal(module, "_tmp_alloc");
+   LLVMValueRef cur_ptr = cgen_tmp_global("_tmp_alloc");
 
    vcode_reg_t result = vcode_get_result(op);
    ctx->regs[result] = LLVMBuildLoad(builder, cur_ptr, cgen_reg_name(result));
@@ -2710,14 +3164,126 @@ static void cgen_op_heap_save(int op, cgen_ctx_t *ctx)
 
 static void cgen_op_heap_restore(int op, cgen_ctx_t *ctx)
 {
-   LLVMValueRef cur_ptr = LLVMGetNamedGlobal(module, "_tmp_alloc");
+   LLVMValueRef cur_ptr = cgen_tmp_global("_tmp_alloc");
    LLVMBuildStore(builder, cgen_get_arg(op, 0, ctx), cur_ptr);
 }
 
+#if LLVM_HAS_DEBUG_INFO
+static LLVMMetadataRef cgen_debug_file(ident_t name)
+{
+   LLVMMetadataRef file = hash_get(debug_files, name);
+   if (file == NULL) {
+      const char *path = istr(name);
+      const char *slash = strrchr(path, PATH_SEP[0]);
+      if (slash != NULL)
+         file = LLVMDIBuilderCreateFile(debug_builder, slash + 1,
+                                        strlen(slash + 1), path, slash - path);
+      else {
+         char cwd[PATH_MAX];
+         if (getcwd(cwd, sizeof(cwd)) == NULL)
+            fatal_errno("getcwd");
+         file = LLVMDIBuilderCreateFile(debug_builder, path, strlen(path),
+                                        cwd, strlen(cwd));
+      }
+
+      hash_put(debug_files, name, file);
+   }
+
+   return file;
+}
+
+static void cgen_debug_module(tree_t top)
+{
+   debug_builder = LLVMCreateDIBuilder(module);
+   debug_files   = hash_new(16, true);
+
+   ident_t file = tree_loc(top)->file ?: ident_new("unknown");
+
+   // There is no DWARF language code for VHDL and Ada is the closest
+   LLVMDIBuilderCreateCompileUnit(
+      debug_builder, LLVMDWARFSourceLanguageAda95, cgen_debug_file(file),
+      PACKAGE_STRING, strlen(PACKAGE_STRING), opt_get_int("optimise") > 0,
+      "", 0, 0, "", 0, LLVMDWARFEmissionLineTablesOnly, 0, false, false,
+      "", 0, "", 0);
+
+   LLVMValueRef version = llvm_int32(LLVMDebugMetadataVersion());
+   LLVMAddModuleFlag(module, LLVMModuleFlagBehaviorWarning,
+                     "Debug Info Version", 18, LLVMValueAsMetadata(version));
+   LLVMAddModuleFlag(module, LLVMModuleFlagBehaviorWarning, "Dwarf Version",
+                     13, LLVMValueAsMetadata(llvm_int32(4)));
+}
+
+static void cgen_debug_finish(void)
+{
+   if (debug_builder == NULL)
+      return;
+
+   LLVMDIBuilderFinalize(debug_builder);
+   LLVMDisposeDIBuilder(debug_builder);
+   hash_free(debug_files);
+
+   debug_builder = NULL;
+   debug_files   = NULL;
+}
+
+static void cgen_debug_location(const loc_t *loc, cgen_ctx_t *ctx)
+{
+   LLVMMetadataRef dl = LLVMDIBuilderCreateDebugLocation(
+      LLVMGetGlobalContext(), loc->first_line, loc->first_column,
+      ctx->debug_scope, NULL);
+   LLVMSetCurrentDebugLocation2(builder, dl);
+}
+
+static void cgen_debug_function(cgen_ctx_t *ctx)
+{
+   assert(ctx->debug_scope == NULL);
+
+   // The function starts at the location of its first statement which
+   // is also used for any code generated before that
+
+   const loc_t *loc = NULL;
+   const int nblocks = vcode_count_blocks();
+   for (int i = 0; i < nblocks && loc == NULL; i++) {
+      vcode_select_block(i);
+      const int nops = vcode_count_ops();
+      for (int j = 0; j < nops; j++) {
+         if (vcode_get_op(j) == VCODE_OP_DEBUG_INFO) {
+            loc = vcode_get_loc(j);
+            break;
+         }
+      }
+   }
+
+   if (loc == NULL || loc->file == NULL)
+      return;
+
+   LLVMMetadataRef file = cgen_debug_file(loc->file);
+   LLVMMetadataRef type =
+      LLVMDIBuilderCreateSubroutineType(debug_builder, file, NULL, 0,
+                                        LLVMDIFlagZero);
+
+   const char *name = istr(vcode_unit_name());
+   size_t linkage_len;
+   const char *linkage = LLVMGetValueName2(ctx->fn, &linkage_len);
+
+   ctx->debug_scope = LLVMDIBuilderCreateFunction(
+      debug_builder, file, name, strlen(name), linkage, linkage_len, file,
+      loc->first_line, type, false, true, loc->first_line, LLVMDIFlagZero,
+      opt_get_int("optimise") > 0);
+   LLVMSetSubprogram(ctx->fn, ctx->debug_scope);
+
+   cgen_debug_location(loc, ctx);
+}
+#endif  // LLVM_HAS_DEBUG_INFO
+
 static void cgen_op_debug_info(int op, cgen_ctx_t *ctx)
 {
-   // TODO: emit LLVM debug info here
    ctx->last_loc = *vcode_get_loc(op);
+
+#if LLVM_HAS_DEBUG_INFO
+   if (ctx->debug_scope != NULL && ctx->last_loc.file != NULL)
+      cgen_debug_location(&(ctx->last_loc), ctx);
+#endif
 }
 
 static void cgen_op_addi(int op, cgen_ctx_t *ctx)
@@ -3050,6 +3616,23 @@ static void cgen_op(int i, cgen_ctx_t *ctx)
    }
 }
 
+static void cgen_pgo_increment(LLVMValueRef counters, int index)
+{
+   LLVMValueRef indexes[] = { llvm_int32(0), llvm_int32(index) };
+   LLVMValueRef ptr = LLVMBuildGEP(builder, counters, indexes,
+                                   ARRAY_LEN(indexes), "");
+#if RT_MULTITHREAD
+   // Processes in the same batch may run the same block on several
+   // threads at once
+   LLVMBuildAtomicRMW(builder, LLVMAtomicRMWBinOpAdd, ptr, llvm_int64(1),
+                      LLVMAtomicOrderingMonotonic, false);
+#else
+   LLVMValueRef count = LLVMBuildLoad(builder, ptr, "");
+   LLVMBuildStore(builder, LLVMBuildAdd(builder, count, llvm_int64(1), ""),
+                  ptr);
+#endif
+}
+
 static void cgen_block(int block, cgen_ctx_t *ctx)
 {
    vcode_select_block(block);
@@ -3058,6 +3641,9 @@ static void cgen_block(int block, cgen_ctx_t *ctx)
 
    const int nops = vcode_count_ops();
    if (nops > 0) {
+      if (ctx->pgo_counters != NULL)
+         cgen_pgo_increment(ctx->pgo_counters, block + 2);
+
       for (int i = 0; i < nops; i++)
          cgen_op(i, ctx);
    }
@@ -3095,9 +3681,19 @@ static void cgen_free_context(cgen_ctx_t *ctx)
 
 static void cgen_code(cgen_ctx_t *ctx)
 {
+#if LLVM_HAS_DEBUG_INFO
+   if (debug_builder != NULL)
+      cgen_debug_function(ctx);
+#endif
+
    const int nblocks = vcode_count_blocks();
    for (int i = 0; i < nblocks; i++)
       cgen_block(i, ctx);
+
+#if LLVM_HAS_DEBUG_INFO
+   // Code generated outside this function must not use its scope
+   LLVMSetCurrentDebugLocation2(builder, NULL);
+#endif
 }
 
 static void cgen_params(cgen_ctx_t *ctx)
@@ -3194,6 +3790,60 @@ static LLVMTypeRef cgen_state_type(cgen_ctx_t *ctx)
    return LLVMStructType(fields, nfields, false);
 }
 
+static bool cgen_is_relocatable(vcode_type_t type)
+{
+   // True if a value of this type contains no pointers and so can be
+   // saved and restored by copying its bytes
+
+   switch (vtype_kind(type)) {
+   case VCODE_TYPE_INT:
+   case VCODE_TYPE_REAL:
+   case VCODE_TYPE_OFFSET:
+      return true;
+
+   case VCODE_TYPE_CARRAY:
+      return cgen_is_relocatable(vtype_elem(type));
+
+   case VCODE_TYPE_RECORD:
+      {
+         const int nfields = vtype_fields(type);
+         for (int i = 0; i < nfields; i++) {
+            if (!cgen_is_relocatable(vtype_field(type, i)))
+               return false;
+         }
+
+         return true;
+      }
+
+   default:
+      return false;
+   }
+}
+
+static void cgen_checkpoint_info(cgen_ctx_t *ctx, LLVMTypeRef state_ty)
+{
+   // Export the size and address of the process state for checkpointing
+   // or a size of zero if the state cannot be copied
+
+   bool relocatable = true;
+   const int nvars = vcode_count_vars();
+   for (int i = 0; relocatable && (i < nvars); i++)
+      relocatable = cgen_is_relocatable(vcode_var_type(vcode_var_handle(i)));
+
+   LLVMValueRef fields[] = {
+      relocatable ? LLVMSizeOf(state_ty) : llvm_int64(0),
+      llvm_void_cast(ctx->state)
+   };
+
+   LLVMValueRef init = LLVMConstStruct(fields, ARRAY_LEN(fields), false);
+
+   char *name LOCAL = xasprintf("%s__checkpoint", istr(vcode_unit_name()));
+   LLVMValueRef info = LLVMAddGlobal(module, LLVMTypeOf(init),
+                                     safe_symbol(name));
+   LLVMSetInitializer(info, init);
+   LLVMSetGlobalConstant(info, true);
+}
+
 static void cgen_state_struct(cgen_ctx_t *ctx)
 {
    char *name LOCAL = xasprintf("%s__state", istr(vcode_unit_name()));
@@ -3201,6 +3851,8 @@ static void cgen_state_struct(cgen_ctx_t *ctx)
    ctx->state = LLVMAddGlobal(module, state_ty, safe_symbol(name));
    LLVMSetLinkage(ctx->state, LLVMInternalLinkage);
    LLVMSetInitializer(ctx->state, LLVMGetUndef(state_ty));
+
+   cgen_checkpoint_info(ctx, state_ty);
 }
 
 static void cgen_jump_table(cgen_ctx_t *ctx)
@@ -3311,31 +3963,104 @@ static void cgen_procedure(LLVMTypeRef display_type)
    cgen_free_context(&ctx);
 }
 
-static void cgen_process(vcode_unit_t code)
+static LLVMValueRef cgen_pgo_counters(void)
 {
-   vcode_select_unit(code);
-   assert(vcode_unit_kind() == VCODE_UNIT_PROCESS);
+   // The first element is the number of counters which follow: one for
+   // calls to the process function and then one for each vcode block
 
-   LLVMTypeRef pargs[] = { LLVMInt32Type() };
-   LLVMTypeRef ftype = LLVMFunctionType(LLVMVoidType(), pargs, 1, false);
-   const char *name = safe_symbol(istr(vcode_unit_name()));
-   LLVMValueRef fn = LLVMAddFunction(module, name, ftype);
-   cgen_add_func_attr(fn, FUNC_ATTR_NOUNWIND, -1);
-   cgen_add_func_attr(fn, FUNC_ATTR_DLLEXPORT, -1);
+   const int ncounts = vcode_count_blocks() + 2;
+   LLVMTypeRef type = LLVMArrayType(LLVMInt64Type(), ncounts);
 
-   LLVMBasicBlockRef entry_bb = LLVMAppendBasicBlock(fn, "entry");
-   LLVMBasicBlockRef reset_bb = LLVMAppendBasicBlock(fn, "reset");
-   LLVMBasicBlockRef jump_bb  = LLVMAppendBasicBlock(fn, "jump_table");
+   char *var_name LOCAL = xasprintf("%s.pgo", istr(vcode_unit_name()));
+   LLVMValueRef var = LLVMAddGlobal(module, type, safe_symbol(var_name));
 
-   cgen_ctx_t ctx = {
-      .fn = fn
+   LLVMValueRef init[ncounts];
+   init[0] = llvm_int64(ncounts - 1);
+   for (int i = 1; i < ncounts; i++)
+      init[i] = llvm_int64(0);
+
+   LLVMSetInitializer(var, LLVMConstArray(LLVMInt64Type(), init, ncounts));
+   cgen_add_func_attr(var, FUNC_ATTR_DLLEXPORT, -1);
+
+   return var;
+}
+
+static const uint64_t *cgen_pgo_use(LLVMValueRef fn)
+{
+   pgo_procs++;
+
+   const uint64_t *counts = pgo_lookup(pgo_profile, vcode_unit_name(),
+                                       vcode_count_blocks() + 1);
+   if (counts == NULL)
+      return NULL;
+
+   pgo_matched++;
+
+#if LLVM_HAS_GLOBAL_METADATA
+   LLVMMetadataRef md[] = {
+      LLVMMDStringInContext2(LLVMGetGlobalContext(), "function_entry_count",
+                             20),
+      LLVMValueAsMetadata(llvm_int64(counts[0]))
+   };
+   LLVMGlobalSetMetadata(fn, LLVMGetMDKindID("prof", 4),
+                         LLVMMDNodeInContext2(LLVMGetGlobalContext(),
+                                              md, ARRAY_LEN(md)));
+#endif
+
+   // Every process is called once to reset it and then runs until the
+   // first wait statement: anything never resumed after that is not
+   // worth the time to optimise
+   if (counts[0] <= 2) {
+      cgen_add_func_attr(fn, FUNC_ATTR_COLD, -1);
+      if (opt_get_int("optimise") > 0) {
+         cgen_add_func_attr(fn, FUNC_ATTR_NOINLINE, -1);
+         cgen_add_func_attr(fn, FUNC_ATTR_OPTNONE, -1);
+      }
+   }
+
+   return counts;
+}
+
+static void cgen_process(vcode_unit_t code)
+{
+   vcode_select_unit(code);
+   assert(vcode_unit_kind() == VCODE_UNIT_PROCESS);
+
+   LLVMTypeRef pargs[] = { LLVMInt32Type() };
+   LLVMTypeRef ftype = LLVMFunctionType(LLVMVoidType(), pargs, 1, false);
+   const char *name = safe_symbol(istr(vcode_unit_name()));
+   LLVMValueRef fn = LLVMAddFunction(module, name, ftype);
+   cgen_add_func_attr(fn, FUNC_ATTR_NOUNWIND, -1);
+   cgen_add_func_attr(fn, FUNC_ATTR_DLLEXPORT, -1);
+
+#if LLVM_HAS_LAZY_JIT
+   if (lazy_procs != NULL) {
+      cgen_lazy_t lazy = { xstrdup(name), nmodules - 1 };
+      ARRAY_APPEND(lazy_procs, lazy, n_lazy_procs, max_lazy_procs);
+   }
+#endif
+
+   LLVMBasicBlockRef entry_bb = LLVMAppendBasicBlock(fn, "entry");
+   LLVMBasicBlockRef reset_bb = LLVMAppendBasicBlock(fn, "reset");
+   LLVMBasicBlockRef jump_bb  = LLVMAppendBasicBlock(fn, "jump_table");
+
+   cgen_ctx_t ctx = {
+      .fn = fn
    };
    cgen_state_struct(&ctx);
    cgen_alloc_context(&ctx);
 
+   if (opt_get_int("pgo-collect"))
+      ctx.pgo_counters = cgen_pgo_counters();
+   else if (pgo_profile != NULL)
+      ctx.pgo_counts = cgen_pgo_use(fn);
+
    // If the parameter is non-zero jump to the init block
 
    LLVMPositionBuilderAtEnd(builder, entry_bb);
+
+   if (ctx.pgo_counters != NULL)
+      cgen_pgo_increment(ctx.pgo_counters, 1);
    LLVMValueRef reset = LLVMBuildICmp(builder, LLVMIntNE, LLVMGetParam(fn, 0),
                                       llvm_int32(0), "reset");
    LLVMBuildCondBr(builder, reset, reset_bb, jump_bb);
@@ -3456,27 +4181,68 @@ static void cgen_reset_function(tree_t top)
    cgen_free_context(&ctx);
 }
 
-static void cgen_coverage_state(tree_t t)
+static void cgen_cover_array(const char *name, int length, bool define)
 {
-   const int stmt_tags = tree_attr_int(t, ident_new("stmt_tags"), 0);
-   if (stmt_tags > 0) {
-      LLVMTypeRef type = LLVMArrayType(LLVMInt32Type(), stmt_tags);
-      LLVMValueRef var = LLVMAddGlobal(module, type, "cover_stmts");
+   LLVMTypeRef elem = cover_mode == COVER_HIT
+      ? LLVMInt8Type() : LLVMInt32Type();
+   LLVMTypeRef type = LLVMArrayType(elem, length);
+   LLVMValueRef var = LLVMAddGlobal(module, type, name);
+   if (define) {
       LLVMSetInitializer(var, LLVMGetUndef(type));
       cgen_add_func_attr(var, FUNC_ATTR_DLLEXPORT, -1);
    }
+   else
+      LLVMSetLinkage(var, LLVMExternalLinkage);
+
+#if RT_MULTITHREAD
+   if (cover_mode == COVER_COUNT) {
+      char *shard_name LOCAL = xasprintf("_%s", name);
+      LLVMValueRef shard = LLVMAddGlobal(module, LLVMPointerType(elem, 0),
+                                         shard_name);
+      LLVMSetLinkage(shard, LLVMExternalLinkage);
+      cgen_thread_local(shard);
+   }
+#endif
+}
+
+static void cgen_coverage_state(tree_t t, bool define)
+{
+   cover_mode = tree_attr_int(t, ident_new("cover_mode"), COVER_COUNT);
+
+   const int stmt_tags = tree_attr_int(t, ident_new("stmt_tags"), 0);
+   if (stmt_tags > 0)
+      cgen_cover_array("cover_stmts", stmt_tags, define);
 
    const int cond_tags = tree_attr_int(t, ident_new("cond_tags"), 0);
    if (cond_tags > 0) {
-      LLVMTypeRef type = LLVMArrayType(LLVMInt32Type(), stmt_tags);
-      LLVMValueRef var = LLVMAddGlobal(module, type, "cover_conds");
-      LLVMSetInitializer(var, LLVMGetUndef(type));
-      cgen_add_func_attr(var, FUNC_ATTR_DLLEXPORT, -1);
+      const int length =
+         cond_tags * (cover_mode == COVER_HIT ? COVER_HIT_BYTES : 1);
+      cgen_cover_array("cover_conds", length, define);
    }
 }
 
-static void cgen_subprograms(vcode_unit_t vcode)
+static unsigned cgen_count_insns(LLVMValueRef after)
 {
+   unsigned count = 0;
+   LLVMValueRef fn = after ? LLVMGetNextFunction(after)
+      : LLVMGetFirstFunction(module);
+   for (; fn != NULL; fn = LLVMGetNextFunction(fn)) {
+      for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(fn);
+           bb != NULL; bb = LLVMGetNextBasicBlock(bb)) {
+         for (LLVMValueRef i = LLVMGetFirstInstruction(bb);
+              i != NULL; i = LLVMGetNextInstruction(i))
+            count++;
+      }
+   }
+
+   return count;
+}
+
+static void cgen_subprograms(vcode_unit_t vcode, tree_t split)
+{
+   // If split is not NULL then start a new module whenever the current
+   // one becomes too large
+
    vcode_select_unit(vcode);
 
    LLVMTypeRef display = NULL;
@@ -3489,10 +4255,21 @@ static void cgen_subprograms(vcode_unit_t vcode)
 
       vcode_select_unit(it);
 
-      switch (vcode_unit_kind()) {
+      const vunit_kind_t kind = vcode_unit_kind();
+      const bool has_code = kind == VCODE_UNIT_PROCEDURE
+         || kind == VCODE_UNIT_FUNCTION || kind == VCODE_UNIT_PROCESS;
+
+      if (split != NULL && has_code && module_insns >= max_module_insns) {
+         cgen_new_module(split, vcode, vcode_unit_name());
+         vcode_select_unit(it);
+      }
+
+      LLVMValueRef last = LLVMGetLastFunction(module);
+
+      switch (kind) {
       case VCODE_UNIT_PROCEDURE:
       case VCODE_UNIT_FUNCTION:
-         cgen_subprograms(it);
+         cgen_subprograms(it, NULL);
          if (display == NULL && needs_display)
             display = cgen_display_type(vcode);
          vcode_select_unit(it);
@@ -3502,16 +4279,24 @@ static void cgen_subprograms(vcode_unit_t vcode)
             cgen_procedure(display);
          break;
       case VCODE_UNIT_PROCESS:
-         cgen_subprograms(it);
-         cgen_process(it);
+         {
+            ident_t name = vcode_unit_name();
+            phase_begin("llvm");
+            cgen_subprograms(it, NULL);
+            cgen_process(it);
+            phase_end(name);
+         }
          break;
       default:
          break;
       }
+
+      if (split != NULL)
+         module_insns += cgen_count_insns(last);
    }
 }
 
-static void cgen_shared_variables(void)
+static void cgen_shared_variables(bool define)
 {
    const int nvars = vcode_count_vars();
    for (int i = 0; i < nvars; i++) {
@@ -3520,7 +4305,7 @@ static void cgen_shared_variables(void)
       LLVMTypeRef type = cgen_type(vcode_var_type(var));
       const char *name = safe_symbol(istr(vcode_var_name(var)));
       LLVMValueRef global = LLVMAddGlobal(module, type, name);
-      if (vcode_var_extern(var)) {
+      if (vcode_var_extern(var) || !define) {
 #ifdef IMPLIB_REQUIRED
          LLVMSetDLLStorageClass(global, LLVMDLLImportStorageClass);
 #endif
@@ -3535,7 +4320,7 @@ static void cgen_shared_variables(void)
    }
 }
 
-static void cgen_signals(void)
+static void cgen_signals(bool define)
 {
    const int nsignals = vcode_count_signals();
    for (int i = 0 ; i < nsignals; i++) {
@@ -3547,12 +4332,14 @@ static void cgen_signals(void)
       LLVMTypeRef nid_type = cgen_net_id_type();
       LLVMTypeRef map_type = LLVMArrayType(nid_type, nnets);
 
+      const bool is_static =
+         nnets <= MAX_STATIC_NETS && nnets > 0 && nets[0] != NETID_INVALID;
+
       LLVMValueRef map_var = LLVMAddGlobal(module, map_type, buf);
-      if (vcode_signal_extern(i))
+      if (vcode_signal_extern(i) || (!define && !is_static))
          LLVMSetLinkage(map_var, LLVMExternalLinkage);
       else {
-         if (nnets <= MAX_STATIC_NETS && nnets > 0
-             && nets[0] != NETID_INVALID) {
+         if (is_static) {
             // Generate a constant mapping table from sub-element to net ID
             LLVMSetGlobalConstant(map_var, true);
             LLVMSetUnnamedAddr(map_var, true);
@@ -3563,6 +4350,12 @@ static void cgen_signals(void)
 
             LLVMSetInitializer(map_var, LLVMConstArray(nid_type, init, nnets));
             free(init);
+
+            if (!define) {
+               // Private copy so net IDs can still be folded into code
+               LLVMSetLinkage(map_var, LLVMInternalLinkage);
+               continue;
+            }
          }
          else {
             // Values will be filled in by reset function
@@ -3576,21 +4369,137 @@ static void cgen_signals(void)
    }
 }
 
+static void cgen_new_module(tree_t top, vcode_unit_t vcode, ident_t name)
+{
+   // Modules are named after their first unit so the bitcode for a unit
+   // does not depend on how many modules came before it
+
+#if LLVM_HAS_DEBUG_INFO
+   cgen_debug_finish();
+#endif
+
+   module = LLVMModuleCreateWithName(istr(name));
+   LLVMSetTarget(module, target_triple);
+
+   if (const_data != NULL)
+      hash_free(const_data);
+   const_data = hash_new(64, true);
+   LLVMSetDataLayout(module, target_layout);
+
+#if LLVM_HAS_DEBUG_INFO
+   if (opt_get_int("debug-info"))
+      cgen_debug_module(top);
+#endif
+
+   modules = xrealloc(modules, (nmodules + 1) * sizeof(LLVMModuleRef));
+   modules[nmodules++] = module;
+   module_insns = 0;
+
+   cgen_tmp_stack();
+
+   if (nmodules > 1) {
+      vcode_select_unit(vcode);
+      cgen_coverage_state(top, false);
+      cgen_shared_variables(false);
+      cgen_signals(false);
+   }
+}
+
 static void cgen_top(tree_t t, vcode_unit_t vcode)
 {
    vcode_select_unit(vcode);
 
-   cgen_coverage_state(t);
-   cgen_shared_variables();
-   cgen_signals();
+   cgen_coverage_state(t, true);
+   cgen_shared_variables(true);
+   cgen_signals(true);
    cgen_reset_function(t);
-   cgen_subprograms(vcode);
+
+   module_insns = cgen_count_insns(NULL);
+   cgen_subprograms(vcode, t);
+}
+
+static void cgen_load_rtinline(void)
+{
+   if (rtinline_bc != NULL || opt_get_int("optimise") == 0)
+      return;
+
+   // The bitcode is only built when clang is available
+   lib_t lib = lib_find(ident_new("NVC"), false);
+   if (lib == NULL)
+      return;
+
+   char path[PATH_MAX];
+   lib_realpath(lib, "_rtinline.bc", path, sizeof(path));
+
+   if (access(path, F_OK) != 0)
+      return;
+
+   char *error;
+   if (LLVMCreateMemoryBufferWithContentsOfFile(path, &rtinline_bc, &error))
+      fatal("failed to read %s: %s", path, error);
+
+   rtinline_hash = hash_bytes(LLVMGetBufferStart(rtinline_bc),
+                              LLVMGetBufferSize(rtinline_bc), 0);
+}
+
+static void cgen_link_rtinline(LLVMModuleRef mod)
+{
+   LLVMModuleRef rt;
+   if (LLVMParseBitcodeInContext2(LLVMGetModuleContext(mod),
+                                  rtinline_bc, &rt))
+      fatal("failed to read runtime support bitcode");
+
+   LLVMSetTarget(rt, LLVMGetTarget(mod));
+   LLVMSetDataLayout(rt, LLVMGetDataLayoutStr(mod));
+
+#if LLVM_NEW_ATTRIBUTE_API
+   const unsigned kind = LLVMGetEnumAttributeKindForName("alwaysinline", 12);
+   LLVMAttributeRef always_inline =
+      LLVMCreateEnumAttribute(LLVMGetModuleContext(rt), kind, 0);
+#endif
+
+   // Only keep functions which this module calls and make them
+   // available_externally so the symbol still comes from the runtime
+   LLVMValueRef next;
+   for (LLVMValueRef fn = LLVMGetFirstFunction(rt); fn != NULL; fn = next) {
+      next = LLVMGetNextFunction(fn);
+
+      if (LLVMIsDeclaration(fn))
+         continue;
+
+      LLVMValueRef decl = LLVMGetNamedFunction(mod, LLVMGetValueName(fn));
+      if (decl == NULL || LLVMGetFirstUse(decl) == NULL) {
+         LLVMDeleteFunction(fn);
+         continue;
+      }
+
+#if LLVM_NEW_ATTRIBUTE_API
+      // Otherwise the inliner may refuse to inline into generated code
+      LLVMRemoveStringAttributeAtIndex(fn, LLVMAttributeFunctionIndex,
+                                       "target-cpu", 10);
+      LLVMRemoveStringAttributeAtIndex(fn, LLVMAttributeFunctionIndex,
+                                       "target-features", 15);
+      LLVMAddAttributeAtIndex(fn, LLVMAttributeFunctionIndex, always_inline);
+#else
+      LLVMAddFunctionAttr(fn, LLVMAlwaysInlineAttribute);
+#endif
+
+      LLVMSetLinkage(fn, LLVMAvailableExternallyLinkage);
+   }
+
+   if (LLVMLinkModules2(mod, rt))
+      fatal("failed to link runtime support bitcode");
 }
 
-static void cgen_optimise(void)
+static void cgen_optimise(LLVMModuleRef mod)
 {
    LLVMPassManagerRef pass_mgr = LLVMCreatePassManager();
 
+   if (rtinline_bc != NULL) {
+      cgen_link_rtinline(mod);
+      LLVMAddAlwaysInlinerPass(pass_mgr);
+   }
+
    LLVMAddPromoteMemoryToRegisterPass(pass_mgr);
    LLVMAddInstructionCombiningPass(pass_mgr);
    LLVMAddReassociatePass(pass_mgr);
@@ -3601,7 +4510,7 @@ static void cgen_optimise(void)
    LLVMPassManagerBuilderSetOptLevel(builder, opt_get_int("optimise"));
    LLVMPassManagerBuilderPopulateModulePassManager(builder, pass_mgr);
 
-   LLVMRunPassManager(pass_mgr, module);
+   LLVMRunPassManager(pass_mgr, mod);
 
    LLVMDisposePassManager(pass_mgr);
    LLVMPassManagerBuilderDispose(builder);
@@ -3674,6 +4583,19 @@ static LLVMValueRef cgen_support_fn(const char *name)
                            LLVMFunctionType(LLVMVoidType(),
                                             args, ARRAY_LEN(args), false));
    }
+   else if (strcmp(name, "_set_initial_fill") == 0) {
+      LLVMTypeRef args[] = {
+         LLVMInt32Type(),
+         LLVMInt64Type(),
+         LLVMInt32Type(),
+         LLVMInt32Type(),
+         llvm_void_ptr(),
+         LLVMPointerType(LLVMInt8Type(), 0)
+      };
+      fn = LLVMAddFunction(module, "_set_initial_fill",
+                           LLVMFunctionType(LLVMVoidType(),
+                                            args, ARRAY_LEN(args), false));
+   }
    else if (strcmp(name, "_needs_last_value") == 0) {
       LLVMTypeRef args[] = {
          LLVMPointerType(LLVMInt32Type(), 0),
@@ -3737,6 +4659,15 @@ static LLVMValueRef cgen_support_fn(const char *name)
                            LLVMFunctionType(LLVMVoidType(),
                                             args, ARRAY_LEN(args), false));
    }
+   else if (strcmp(name, "_image_int") == 0) {
+      LLVMTypeRef args[] = {
+         LLVMInt64Type(),
+         LLVMPointerType(llvm_uarray_type(LLVMInt8Type(), 1), 0)
+      };
+      fn = LLVMAddFunction(module, "_image_int",
+                           LLVMFunctionType(LLVMVoidType(),
+                                            args, ARRAY_LEN(args), false));
+   }
    else if (strcmp(name, "_debug_out") == 0) {
       LLVMTypeRef args[] = {
          LLVMInt32Type(),
@@ -3937,6 +4868,23 @@ static LLVMValueRef cgen_support_fn(const char *name)
                            LLVMFunctionType(LLVMVoidType(),
                                             NULL, 0, false));
    }
+   else if (strcmp(name, "_tmp_stack_ptr") == 0) {
+      fn = LLVMAddFunction(module, "_tmp_stack_ptr",
+                           LLVMFunctionType(LLVMPointerType(llvm_void_ptr(), 0),
+                                            NULL, 0, false));
+   }
+   else if (strcmp(name, "_tmp_alloc_ptr") == 0) {
+      fn = LLVMAddFunction(module, "_tmp_alloc_ptr",
+                           LLVMFunctionType(LLVMPointerType(LLVMInt32Type(), 0),
+                                            NULL, 0, false));
+   }
+   else if (strcmp(name, "_cover_stmts_ptr") == 0
+            || strcmp(name, "_cover_conds_ptr") == 0) {
+      LLVMTypeRef shard_type = LLVMPointerType(LLVMInt32Type(), 0);
+      fn = LLVMAddFunction(module, name,
+                           LLVMFunctionType(LLVMPointerType(shard_type, 0),
+                                            NULL, 0, false));
+   }
 
    if (fn != NULL)
       cgen_add_func_attr(fn, FUNC_ATTR_NOUNWIND, -1);
@@ -3953,6 +4901,12 @@ static void cgen_tmp_stack(void)
    LLVMValueRef _tmp_alloc =
       LLVMAddGlobal(module, LLVMInt32Type(), "_tmp_alloc");
    LLVMSetLinkage(_tmp_alloc, LLVMExternalLinkage);
+
+#if RT_MULTITHREAD
+   // Each kernel thread has its own temporary stack
+   cgen_thread_local(_tmp_stack);
+   cgen_thread_local(_tmp_alloc);
+#endif
 }
 
 static void cgen_link_arg(const char *fmt, ...)
@@ -4011,18 +4965,409 @@ static void cgen_find_implib_deps(ident_t unit_name, ident_list_t **deps)
 }
 #endif  // IMPLIB_REQUIRED
 
-static void cgen_native(tree_t top, LLVMTargetMachineRef tm_ref)
+static LLVMTargetMachineRef cgen_target_machine(void)
+{
+   return LLVMCreateTargetMachine(target_ref, target_triple, "", "",
+                                  code_gen_level,
+                                  LLVMRelocPIC,
+                                  LLVMCodeModelDefault);
+}
+
+static char *cgen_obj_path(tree_t top, unsigned n)
 {
    ident_t unit_name = tree_ident(top);
-   char *obj_name LOCAL = xasprintf("_%s." LLVM_OBJ_EXT, istr(unit_name));
+   char *obj_name LOCAL = (nmodules == 1)
+      ? xasprintf("_%s." LLVM_OBJ_EXT, istr(unit_name))
+      : xasprintf("_%s.%u." LLVM_OBJ_EXT, istr(unit_name), n);
 
    char obj_path[PATH_MAX];
    lib_realpath(lib_work(), obj_name, obj_path, sizeof(obj_path));
+   return xstrdup(obj_path);
+}
+
+static char *cgen_cache_path(LLVMMemoryBufferRef bitcode)
+{
+   // Objects in the cache are named by a hash of the module bitcode and
+   // everything else which affects the generated machine code
+
+   char *flags LOCAL = xasprintf("%s %s %d %"PRIx64, PACKAGE_VERSION,
+                                 target_triple, opt_get_int("optimise"),
+                                 rtinline_hash);
+   const uint64_t seed = hash_bytes(flags, strlen(flags), 0);
+
+   const char *data = LLVMGetBufferStart(bitcode);
+   const size_t size = LLVMGetBufferSize(bitcode);
+
+   char *obj_name LOCAL =
+      xasprintf("_cache" PATH_SEP "%016"PRIx64"%016"PRIx64"." LLVM_OBJ_EXT,
+                hash_bytes(data, size, seed), hash_bytes(data, size, ~seed));
+
+   char obj_path[PATH_MAX];
+   lib_realpath(lib_work(), obj_name, obj_path, sizeof(obj_path));
+   return xstrdup(obj_path);
+}
+
+static void cgen_bundle_units(tree_t top, ident_list_t **units)
+{
+   // Packages with generated code which are linked into the shared
+   // library for a design elaborated with --bundle
+
+   const int ncontext = tree_contexts(top);
+   for (int i = 0; i < ncontext; i++) {
+      tree_t c = tree_context(top, i);
+      if (tree_kind(c) != T_USE)
+         continue;
+
+      ident_t name = tree_ident(c);
+      if (ident_list_find(*units, name))
+         continue;
+
+      lib_t lib = lib_find(ident_until(name, '.'), true);
+
+      const tree_kind_t kind = lib_index_kind(lib, name);
+      if (kind != T_PACKAGE && kind != T_PACK_BODY)
+         continue;
+
+      char *so_name LOCAL = xasprintf("_%s." DLL_EXT, istr(name));
+      char so_path[PATH_MAX];
+      lib_realpath(lib, so_name, so_path, sizeof(so_path));
+
+      if (access(so_path, F_OK) == 0)
+         ident_list_push(units, name);
+   }
+}
+
+static void cgen_bundle_objects(ident_t unit)
+{
+   lib_t lib = lib_find(ident_until(unit, '.'), true);
+
+   char *obj_name LOCAL = xasprintf("_%s." LLVM_OBJ_EXT, istr(unit));
+   char obj_path[PATH_MAX];
+   lib_realpath(lib, obj_name, obj_path, sizeof(obj_path));
+
+   if (access(obj_path, F_OK) == 0) {
+      cgen_link_arg("%s", obj_path);
+      return;
+   }
+
+   // Large packages compiled on several threads have one object for
+   // each module
+   for (unsigned n = 0; ; n++) {
+      char *part_name LOCAL =
+         xasprintf("_%s.%u." LLVM_OBJ_EXT, istr(unit), n);
+      lib_realpath(lib, part_name, obj_path, sizeof(obj_path));
+
+      if (access(obj_path, F_OK) == 0)
+         cgen_link_arg("%s", obj_path);
+      else if (n == 0)
+         fatal("cannot bundle %s as its object file is missing: analyse "
+               "it again to regenerate the object", istr(unit));
+      else
+         break;
+   }
+}
+
+static lib_mtime_t cgen_bundle_stamp(ident_t unit)
+{
+   // The shared library for a package is written again each time it is
+   // analysed so its modification time identifies the code bundled
+
+   lib_t lib = lib_find(ident_until(unit, '.'), true);
+
+   char *so_name LOCAL = xasprintf("_%s." DLL_EXT, istr(unit));
+   lib_mtime_t mt;
+   if (!lib_stat(lib, so_name, &mt))
+      fatal("cannot bundle %s as its shared library is missing",
+            istr(unit));
+
+   return mt;
+}
+
+static LLVMValueRef cgen_bundle_string(LLVMModuleRef mod, const char *name,
+                                       const char *str)
+{
+   const size_t len = strlen(str);
+   LLVMValueRef g = LLVMAddGlobal(mod, LLVMArrayType(LLVMInt8Type(), len + 1),
+                                  name);
+   LLVMSetGlobalConstant(g, true);
+   LLVMSetInitializer(g, LLVMConstString(str, len, false));
+   LLVMSetLinkage(g, LLVMPrivateLinkage);
+   LLVMSetUnnamedAddr(g, true);
+
+   return LLVMConstBitCast(g, llvm_void_ptr());
+}
+
+static void cgen_bundle_unit_table(LLVMModuleRef mod)
+{
+   // The runtime checks none of the packages have been analysed again
+   // since the design was elaborated
+
+   size_t nunits = 0;
+   for (const ident_list_t *it = bundle_units; it != NULL; it = it->next)
+      nunits++;
+
+   LLVMTypeRef fields[] = { llvm_void_ptr(), LLVMInt64Type() };
+   LLVMTypeRef entry_type = LLVMStructType(fields, ARRAY_LEN(fields), false);
+
+   LLVMValueRef *entries = xmalloc(MAX(nunits, 1) * sizeof(LLVMValueRef));
+   nunits = 0;
+   for (const ident_list_t *it = bundle_units; it != NULL; it = it->next) {
+      char *str_name LOCAL = xasprintf("bundle_unit%zu", nunits);
+      LLVMValueRef values[] = {
+         cgen_bundle_string(mod, str_name, istr(it->ident)),
+         llvm_int64(cgen_bundle_stamp(it->ident))
+      };
+      entries[nunits++] =
+         LLVMConstNamedStruct(entry_type, values, ARRAY_LEN(values));
+   }
+
+   LLVMValueRef table = LLVMAddGlobal(mod, LLVMArrayType(entry_type, nunits),
+                                      "_nvc_bundle_units");
+   LLVMSetGlobalConstant(table, true);
+   LLVMSetInitializer(table, LLVMConstArray(entry_type, entries, nunits));
+   cgen_add_func_attr(table, FUNC_ATTR_DLLEXPORT, -1);
+
+   LLVMValueRef count = LLVMAddGlobal(mod, LLVMInt32Type(),
+                                      "_nvc_bundle_nunits");
+   LLVMSetGlobalConstant(count, true);
+   LLVMSetInitializer(count, llvm_int32(nunits));
+
+   free(entries);
+}
+
+static int cgen_symbol_cmp(const void *a, const void *b)
+{
+   return strcmp(*(const char **)a, *(const char **)b);
+}
+
+static void cgen_bundle_symtab(tree_t top)
+{
+   // The runtime finds processes, reset functions and other data by
+   // name so a design bundle carries a sorted table of every symbol it
+   // defines which saves looking each one up with the dynamic loader
+
+   size_t nnames = 0, max_names = 256;
+   const char **names = xmalloc(max_names * sizeof(const char *));
+
+   for (unsigned i = 0; i < nmodules; i++) {
+      for (LLVMValueRef fn = LLVMGetFirstFunction(modules[i]);
+           fn != NULL; fn = LLVMGetNextFunction(fn)) {
+         if (!LLVMIsDeclaration(fn)
+             && LLVMGetLinkage(fn) == LLVMExternalLinkage) {
+            const char *name = LLVMGetValueName(fn);
+            ARRAY_APPEND(names, name, nnames, max_names);
+         }
+      }
+
+      for (LLVMValueRef g = LLVMGetFirstGlobal(modules[i]);
+           g != NULL; g = LLVMGetNextGlobal(g)) {
+         if (!LLVMIsDeclaration(g)
+             && LLVMGetLinkage(g) == LLVMExternalLinkage) {
+            const char *name = LLVMGetValueName(g);
+            ARRAY_APPEND(names, name, nnames, max_names);
+         }
+      }
+   }
+
+   assert(bundle_units == NULL);
+   cgen_bundle_units(top, &bundle_units);
+
+   size_t nresets = 0;
+   for (const ident_list_t *it = bundle_units; it != NULL; it = it->next)
+      nresets++;
+
+   char **resets = xmalloc(MAX(nresets, 1) * sizeof(char *));
+   nresets = 0;
+   for (const ident_list_t *it = bundle_units; it != NULL; it = it->next) {
+      resets[nresets] = xasprintf("%s_reset", istr(it->ident));
+      ARRAY_APPEND(names, resets[nresets], nnames, max_names);
+      nresets++;
+   }
+
+   qsort(names, nnames, sizeof(const char *), cgen_symbol_cmp);
+
+   LLVMModuleRef mod = modules[0];
+
+   LLVMTypeRef fields[] = { llvm_void_ptr(), llvm_void_ptr() };
+   LLVMTypeRef entry_type = LLVMStructType(fields, ARRAY_LEN(fields), false);
+
+   LLVMValueRef *entries = xmalloc(MAX(nnames, 1) * sizeof(LLVMValueRef));
+   for (size_t i = 0; i < nnames; i++) {
+      char *str_name LOCAL = xasprintf("bundle_sym%zu", i);
+      LLVMValueRef str = cgen_bundle_string(mod, str_name, names[i]);
+
+      // Symbols defined in other modules are only referenced by address
+      // so any declaration will do for the linker
+      LLVMValueRef addr = LLVMGetNamedFunction(mod, names[i]);
+      if (addr == NULL)
+         addr = LLVMGetNamedGlobal(mod, names[i]);
+      if (addr == NULL)
+         addr = LLVMAddGlobal(mod, LLVMInt8Type(), names[i]);
+
+      LLVMValueRef values[] = {
+         str,
+         LLVMConstBitCast(addr, llvm_void_ptr())
+      };
+      entries[i] = LLVMConstNamedStruct(entry_type, values, ARRAY_LEN(values));
+   }
+
+   LLVMValueRef table = LLVMAddGlobal(mod, LLVMArrayType(entry_type, nnames),
+                                      "_nvc_bundle_syms");
+   LLVMSetGlobalConstant(table, true);
+   LLVMSetInitializer(table, LLVMConstArray(entry_type, entries, nnames));
+   cgen_add_func_attr(table, FUNC_ATTR_DLLEXPORT, -1);
+
+   LLVMValueRef count = LLVMAddGlobal(mod, LLVMInt32Type(),
+                                      "_nvc_bundle_nsyms");
+   LLVMSetGlobalConstant(count, true);
+   LLVMSetInitializer(count, llvm_int32(nnames));
+
+   cgen_bundle_unit_table(mod);
+
+   for (size_t i = 0; i < nresets; i++)
+      free(resets[i]);
+   free(resets);
+   free(entries);
+   free(names);
+}
+
+static void cgen_prune_module(LLVMModuleRef mod)
+{
+   // Remove declarations which are not used so modules only depend on
+   // what they reference
+
+   LLVMValueRef next;
+   for (LLVMValueRef fn = LLVMGetFirstFunction(mod); fn != NULL; fn = next) {
+      next = LLVMGetNextFunction(fn);
+      if (LLVMIsDeclaration(fn) && LLVMGetFirstUse(fn) == NULL)
+         LLVMDeleteFunction(fn);
+   }
+
+   for (LLVMValueRef g = LLVMGetFirstGlobal(mod); g != NULL; g = next) {
+      next = LLVMGetNextGlobal(g);
+      if (LLVMGetFirstUse(g) != NULL)
+         continue;
+      else if (LLVMIsDeclaration(g)
+               || LLVMGetLinkage(g) == LLVMInternalLinkage)
+         LLVMDeleteGlobal(g);
+   }
+}
 
+static void cgen_emit(LLVMModuleRef mod, LLVMTargetMachineRef tm_ref,
+                      const char *obj_path)
+{
    char *error;
-   if (LLVMTargetMachineEmitToFile(tm_ref, module, obj_path,
+   if (LLVMTargetMachineEmitToFile(tm_ref, mod, (char *)obj_path,
                                    LLVMObjectFile, &error))
       fatal("Failed to write object file: %s", error);
+}
+
+static void cgen_write_object(cgen_job_t *job, LLVMModuleRef mod,
+                              LLVMTargetMachineRef tm_ref)
+{
+   if (job->tmp_path != NULL) {
+      // Another elaboration may be using the same cache entry
+      cgen_emit(mod, tm_ref, job->tmp_path);
+      if (rename(job->tmp_path, job->obj_path) != 0)
+         fatal_errno("rename %s", job->tmp_path);
+   }
+   else
+      cgen_emit(mod, tm_ref, job->obj_path);
+}
+
+#if RT_MULTITHREAD
+static void cgen_compile(cgen_job_t *job, LLVMModuleRef mod,
+                         LLVMTargetMachineRef tm_ref)
+{
+   cgen_optimise(mod);
+   cgen_write_object(job, mod, tm_ref);
+}
+
+static void *cgen_worker_thread(void *arg)
+{
+   // Each thread reads modules into its own context as LLVM contexts
+   // cannot be shared between threads
+
+   LLVMContextRef context = LLVMContextCreate();
+
+   for (;;) {
+      pthread_mutex_lock(&job_lock);
+      const unsigned n = next_job++;
+      pthread_mutex_unlock(&job_lock);
+
+      if (n >= njobs)
+         break;
+
+      LLVMModuleRef mod;
+      if (LLVMParseBitcodeInContext2(context, jobs[n].bitcode, &mod))
+         fatal("failed to read LLVM bitcode for %s", jobs[n].obj_path);
+
+      cgen_compile(&(jobs[n]), mod, (LLVMTargetMachineRef)arg);
+
+      LLVMDisposeModule(mod);
+
+      // The memory sources are only sampled by one thread at a time
+      pthread_mutex_lock(&job_lock);
+      mem_check("compiling %s", jobs[n].obj_path);
+      pthread_mutex_unlock(&job_lock);
+   }
+
+   LLVMContextDispose(context);
+   return NULL;
+}
+
+static void cgen_parallel(cgen_job_t *list, unsigned count, unsigned nthreads)
+{
+   jobs     = list;
+   njobs    = count;
+   next_job = 0;
+
+   for (unsigned i = 0; i < njobs; i++) {
+      if (jobs[i].bitcode == NULL)
+         jobs[i].bitcode = LLVMWriteBitcodeToMemoryBuffer(jobs[i].module);
+      LLVMDisposeModule(jobs[i].module);
+      jobs[i].module = NULL;
+   }
+
+   pthread_t threads[nthreads];
+   LLVMTargetMachineRef tm_refs[nthreads];
+   for (unsigned i = 0; i < nthreads; i++) {
+      tm_refs[i] = cgen_target_machine();
+      if (pthread_create(&threads[i], NULL, cgen_worker_thread, tm_refs[i]))
+         fatal_errno("pthread_create");
+   }
+
+   for (unsigned i = 0; i < nthreads; i++) {
+      if (pthread_join(threads[i], NULL))
+         fatal_errno("pthread_join");
+      LLVMDisposeTargetMachine(tm_refs[i]);
+   }
+
+   jobs = NULL;
+   njobs = 0;
+}
+#endif  // RT_MULTITHREAD
+
+static unsigned cgen_threads(void)
+{
+#if RT_MULTITHREAD && !defined IMPLIB_REQUIRED
+   // Each thread holds its own LLVM context and module
+   if (mem_constrained())
+      return 1;
+
+   const int nthreads = opt_get_int("cgen-jobs");
+   if (nthreads > 0)
+      return nthreads;
+   else
+      return MAX(sysconf(_SC_NPROCESSORS_ONLN), 1);
+#else
+   return 1;
+#endif
+}
+
+static void cgen_native(tree_t top, char **obj_paths)
+{
+   ident_t unit_name = tree_ident(top);
 
    max_link_args = 64;
    link_args = xmalloc(sizeof(char *) * max_link_args);
@@ -4049,9 +5394,13 @@ static void cgen_native(tree_t top, LLVMTargetMachineRef tm_ref)
 
    cgen_link_arg("-o");
    cgen_link_arg("%s", so_path);
-   cgen_link_arg("%s", obj_path);
+   for (unsigned i = 0; i < nmodules; i++)
+      cgen_link_arg("%s", obj_paths[i]);
+
+   for (const ident_list_t *it = bundle_units; it != NULL; it = it->next)
+      cgen_bundle_objects(it->ident);
 
-#if IMPLIB_REQUIRED
+#ifdef IMPLIB_REQUIRED
    char *impname LOCAL = xasprintf("_%s.lib", istr(unit_name));
    char imp_path[PATH_MAX];
    lib_realpath(lib_work(), impname, imp_path, PATH_MAX);
@@ -4101,25 +5450,335 @@ static void cgen_native(tree_t top, LLVMTargetMachineRef tm_ref)
    link_args = NULL;
 }
 
+typedef struct {
+   char   *path;
+   time_t  mtime;
+   off_t   size;
+} cache_entry_t;
+
+static int cgen_cache_entry_cmp(const void *a, const void *b)
+{
+   const time_t ta = ((const cache_entry_t *)a)->mtime;
+   const time_t tb = ((const cache_entry_t *)b)->mtime;
+   return (ta > tb) - (ta < tb);
+}
+
+static void cgen_evict_cache(time_t start)
+{
+   // Each entry is touched when it is used so the least recently used
+   // are removed until the cache fits in its size limit but never an
+   // entry used by this elaboration
+
+   char dir[PATH_MAX];
+   lib_realpath(lib_work(), "_cache", dir, sizeof(dir));
+
+   DIR *d = opendir(dir);
+   if (d == NULL)
+      return;
+
+   size_t nentries = 0, max_entries = 64;
+   cache_entry_t *entries = xmalloc(max_entries * sizeof(cache_entry_t));
+   uint64_t total = 0;
+
+   struct dirent *e;
+   while ((e = readdir(d))) {
+      if (e->d_name[0] == '.')
+         continue;
+
+      char *path = xasprintf("%s" PATH_SEP "%s", dir, e->d_name);
+
+      struct stat st;
+      if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+         free(path);
+         continue;
+      }
+
+      total += st.st_size;
+
+      const cache_entry_t entry = {
+         .path  = path,
+         .mtime = st.st_mtime,
+         .size  = st.st_size
+      };
+      ARRAY_APPEND(entries, entry, nentries, max_entries);
+   }
+
+   closedir(d);
+
+   qsort(entries, nentries, sizeof(cache_entry_t), cgen_cache_entry_cmp);
+
+   unsigned evicted = 0;
+   for (size_t i = 0; i < nentries; i++) {
+      if (total > CACHE_MAX_SIZE && entries[i].mtime < start) {
+         if (unlink(entries[i].path) == 0) {
+            total -= entries[i].size;
+            evicted++;
+         }
+      }
+      free(entries[i].path);
+   }
+
+   free(entries);
+
+   if (evicted > 0 && opt_get_int("verbose"))
+      notef("removed %u old entries from the cache", evicted);
+}
+
+static void cgen_objects(tree_t top, LLVMTargetMachineRef tm_ref,
+                         bool use_cache, unsigned nthreads)
+{
+   const time_t start = time(NULL);
+
+   if (use_cache)
+      lib_mkdir(lib_work(), "_cache");
+
+   char **obj_paths = xmalloc(nmodules * sizeof(char *));
+   cgen_job_t *list = xcalloc(nmodules * sizeof(cgen_job_t));
+   unsigned count = 0;
+
+   for (unsigned i = 0; i < nmodules; i++) {
+      cgen_job_t *job = &(list[count]);
+      job->module = modules[i];
+
+      if (use_cache) {
+         job->bitcode = LLVMWriteBitcodeToMemoryBuffer(modules[i]);
+         obj_paths[i] = cgen_cache_path(job->bitcode);
+
+         if (utime(obj_paths[i], NULL) == 0) {
+            // Found in the cache and marked as recently used
+            LLVMDisposeMemoryBuffer(job->bitcode);
+            LLVMDisposeModule(job->module);
+            memset(job, '\0', sizeof(cgen_job_t));
+            continue;
+         }
+
+         job->tmp_path = xasprintf("%s.%d", obj_paths[i], getpid());
+      }
+      else
+         obj_paths[i] = cgen_obj_path(top, i);
+
+      job->obj_path = obj_paths[i];
+      count++;
+   }
+
+   if (use_cache && opt_get_int("verbose"))
+      notef("%u of %u LLVM modules found in cache", nmodules - count,
+            nmodules);
+
+#if RT_MULTITHREAD
+   if (count > 1 && nthreads > 1) {
+      if (opt_get_int("verbose"))
+         notef("compiling %u LLVM modules on %u threads",
+               count, MIN(nthreads, count));
+
+      phase_begin("compile");
+      cgen_parallel(list, count, MIN(nthreads, count));
+      phase_end(NULL);
+   }
+   else
+#endif
+   {
+      // The phases are only recorded here as the worker threads
+      // optimise and emit each module together
+      for (unsigned i = 0; i < count; i++) {
+         phase_begin("optimise");
+         cgen_optimise(list[i].module);
+         phase_end(NULL);
+
+         phase_begin("emit");
+         cgen_write_object(&(list[i]), list[i].module, tm_ref);
+         phase_end(NULL);
+
+         LLVMDisposeModule(list[i].module);
+
+         mem_check("compiling %s", list[i].obj_path);
+      }
+   }
+
+   for (unsigned i = 0; i < count; i++) {
+      if (list[i].bitcode != NULL)
+         LLVMDisposeMemoryBuffer(list[i].bitcode);
+      free(list[i].tmp_path);
+   }
+   free(list);
+
+   phase_begin("link");
+   cgen_native(top, obj_paths);
+   phase_end(NULL);
+
+   if (use_cache)
+      cgen_evict_cache(start);
+
+   for (unsigned i = 0; i < nmodules; i++)
+      free(obj_paths[i]);
+   free(obj_paths);
+}
+
+#if LLVM_HAS_LAZY_JIT
+static void cgen_jit_check(LLVMErrorRef error)
+{
+   if (error != LLVMErrorSuccess) {
+      char *llvm_msg = LLVMGetErrorMessage(error);
+      char *msg LOCAL = xstrdup(llvm_msg);
+      LLVMDisposeErrorMessage(llvm_msg);
+
+      fatal("LLVM JIT: %s", msg);
+   }
+}
+
+static LLVMErrorRef cgen_jit_optimise(void *context, LLVMModuleRef mod)
+{
+   cgen_optimise(mod);
+   return LLVMErrorSuccess;
+}
+
+static LLVMErrorRef cgen_jit_transform(void *context,
+                                       LLVMOrcThreadSafeModuleRef *tsm,
+                                       LLVMOrcMaterializationResponsibilityRef mr)
+{
+   return LLVMOrcThreadSafeModuleWithModuleDo(*tsm, cgen_jit_optimise, NULL);
+}
+
+static void cgen_jit_failed(void)
+{
+   fatal("LLVM JIT: failed to compile process");
+}
+
+static void *cgen_jit_lookup(const char *name)
+{
+   LLVMOrcExecutorAddress addr;
+   LLVMErrorRef error = LLVMOrcLLJITLookup(jit, &addr, name);
+   if (error != LLVMErrorSuccess) {
+      LLVMConsumeError(error);
+      return NULL;
+   }
+
+   return (void *)(uintptr_t)addr;
+}
+
+static LLVMOrcObjectLayerRef cgen_jit_object_layer(
+   void *context, LLVMOrcExecutionSessionRef es, const char *triple)
+{
+   LLVMOrcObjectLayerRef layer =
+      LLVMOrcCreateRTDyldObjectLinkingLayerWithSectionMemoryManager(es);
+   LLVMOrcRTDyldObjectLinkingLayerRegisterJITEventListener(layer, context);
+   return layer;
+}
+
+static void cgen_jit(tree_t top)
+{
+   LLVMOrcLLJITBuilderRef jit_builder = NULL;
+   if (opt_get_int("debug-info")) {
+      // Write a jitdump file for perf with the address and line table of
+      // each process as it is compiled
+      LLVMJITEventListenerRef perf = LLVMCreatePerfJITEventListener();
+      if (perf == NULL)
+         warnf("LLVM was built without perf support so JIT compiled code "
+               "will not be visible to perf");
+      else {
+         jit_builder = LLVMOrcCreateLLJITBuilder();
+         LLVMOrcLLJITBuilderSetObjectLinkingLayerCreator(
+            jit_builder, cgen_jit_object_layer, perf);
+      }
+   }
+
+   cgen_jit_check(LLVMOrcCreateLLJIT(&jit, jit_builder));
+
+   LLVMOrcExecutionSessionRef es = LLVMOrcLLJITGetExecutionSession(jit);
+   LLVMOrcJITDylibRef jd = LLVMOrcLLJITGetMainJITDylib(jit);
+
+   // Runtime functions and packages compiled to shared libraries are
+   // resolved from the running process
+   LLVMOrcDefinitionGeneratorRef gen;
+   cgen_jit_check(LLVMOrcCreateDynamicLibrarySearchGeneratorForProcess(
+                     &gen, LLVMOrcLLJITGetGlobalPrefix(jit), NULL, NULL));
+   LLVMOrcJITDylibAddGenerator(jd, gen);
+
+   // Optimisation is deferred until a module is first needed
+   LLVMOrcIRTransformLayerSetTransform(LLVMOrcLLJITGetIRTransformLayer(jit),
+                                       cgen_jit_transform, NULL);
+
+   LLVMOrcThreadSafeContextRef tsc = LLVMOrcCreateNewThreadSafeContext();
+   LLVMContextRef context = LLVMOrcThreadSafeContextGetContext(tsc);
+
+   cgen_lazy_t *lazy = lazy_procs;
+   for (unsigned i = 0; i < nmodules; i++) {
+      // Move the module into the context owned by the JIT
+      LLVMMemoryBufferRef bitcode = LLVMWriteBitcodeToMemoryBuffer(modules[i]);
+      LLVMDisposeModule(modules[i]);
+
+      LLVMModuleRef mod;
+      if (LLVMParseBitcodeInContext2(context, bitcode, &mod))
+         fatal("failed to read LLVM bitcode");
+      LLVMDisposeMemoryBuffer(bitcode);
+
+      // The process body is renamed and the original symbol is defined
+      // later as a lazy stub which calls it
+      for (; lazy < lazy_procs + n_lazy_procs && lazy->module == i; lazy++) {
+         LLVMValueRef fn = LLVMGetNamedFunction(mod, lazy->name);
+         assert(fn != NULL);
+
+         char *body LOCAL = xasprintf("%s.body", lazy->name);
+         LLVMSetValueName(fn, body);
+      }
+
+      LLVMOrcThreadSafeModuleRef tsm = LLVMOrcCreateNewThreadSafeModule(mod, tsc);
+      cgen_jit_check(LLVMOrcLLJITAddLLVMIRModule(jit, jd, tsm));
+   }
+
+   LLVMOrcDisposeThreadSafeContext(tsc);
+
+   cgen_jit_check(LLVMOrcCreateLocalLazyCallThroughManager(
+                     target_triple, es, (uintptr_t)cgen_jit_failed,
+                     &jit_lctm));
+   jit_ism = LLVMOrcCreateLocalIndirectStubsManager(target_triple);
+
+   LLVMOrcCSymbolAliasMapPair *aliases =
+      xmalloc(MAX(n_lazy_procs, 1) * sizeof(LLVMOrcCSymbolAliasMapPair));
+
+   for (size_t i = 0; i < n_lazy_procs; i++) {
+      char *body LOCAL = xasprintf("%s.body", lazy_procs[i].name);
+
+      aliases[i].Name = LLVMOrcLLJITMangleAndIntern(jit, lazy_procs[i].name);
+      aliases[i].Entry.Name = LLVMOrcLLJITMangleAndIntern(jit, body);
+      aliases[i].Entry.Flags.GenericFlags =
+         LLVMJITSymbolGenericFlagsExported | LLVMJITSymbolGenericFlagsCallable;
+      aliases[i].Entry.Flags.TargetFlags = 0;
+
+      free(lazy_procs[i].name);
+   }
+
+   if (n_lazy_procs > 0) {
+      LLVMOrcMaterializationUnitRef mu =
+         LLVMOrcLazyReexports(jit_lctm, jit_ism, jd, aliases, n_lazy_procs);
+      cgen_jit_check(LLVMOrcJITDylibDefine(jd, mu));
+   }
+
+   free(aliases);
+   free(lazy_procs);
+   lazy_procs = NULL;
+   n_lazy_procs = max_lazy_procs = 0;
+
+   jit_register(tree_ident(top), cgen_jit_lookup);
+}
+#endif  // LLVM_HAS_LAZY_JIT
+
 void cgen(tree_t top, vcode_unit_t vcode)
 {
    tree_kind_t kind = tree_kind(top);
    if (kind != T_ELAB && kind != T_PACK_BODY && kind != T_PACKAGE)
       fatal("cannot generate code for %s", tree_kind_str(kind));
 
-   module = LLVMModuleCreateWithName(istr(tree_ident(top)));
    builder = LLVMCreateBuilder();
 
    LLVMInitializeNativeTarget();
    LLVMInitializeNativeAsmPrinter();
 
-   char *def_triple = LLVMGetDefaultTargetTriple();
+   target_triple = LLVMGetDefaultTargetTriple();
    char *error;
-   LLVMTargetRef target_ref;
-   if (LLVMGetTargetFromTriple(def_triple, &target_ref, &error))
-      fatal("failed to get LLVM target for %s: %s", def_triple, error);
+   if (LLVMGetTargetFromTriple(target_triple, &target_ref, &error))
+      fatal("failed to get LLVM target for %s: %s", target_triple, error);
 
-   LLVMCodeGenOptLevel code_gen_level;
    switch (opt_get_int("optimise")) {
    case 0: code_gen_level = LLVMCodeGenLevelNone; break;
    case 1: code_gen_level = LLVMCodeGenLevelLess; break;
@@ -4127,13 +5786,7 @@ void cgen(tree_t top, vcode_unit_t vcode)
    default: code_gen_level = LLVMCodeGenLevelDefault;
    }
 
-   LLVMTargetMachineRef tm_ref =
-      LLVMCreateTargetMachine(target_ref, def_triple, "", "",
-                              code_gen_level,
-                              LLVMRelocPIC,
-                              LLVMCodeModelDefault);
-
-   LLVMSetTarget(module, def_triple);
+   LLVMTargetMachineRef tm_ref = cgen_target_machine();
 
 #if LLVM_HAS_CREATE_TARGET_DATA_LAYOUT
    LLVMTargetDataRef data_ref = LLVMCreateTargetDataLayout(tm_ref);
@@ -4141,27 +5794,111 @@ void cgen(tree_t top, vcode_unit_t vcode)
    LLVMTargetDataRef data_ref = LLVMGetTargetMachineData(tm_ref);
 #endif
 
-   char *layout LOCAL = LLVMCopyStringRepOfTargetData(data_ref);
-   LLVMSetDataLayout(module, layout);
+   target_layout = LLVMCopyStringRepOfTargetData(data_ref);
+   target_data   = data_ref;
 
-   cgen_tmp_stack();
+   cgen_load_rtinline();
+
+   const bool use_cache = opt_get_int("cgen-cache");
+   const bool use_jit = opt_get_int("jit") && kind == T_ELAB;
+   const unsigned nthreads = cgen_threads();
 
+#if LLVM_HAS_LAZY_JIT
+   if (use_jit) {
+      max_lazy_procs = 64;
+      lazy_procs = xmalloc(max_lazy_procs * sizeof(cgen_lazy_t));
+   }
+#else
+   if (use_jit)
+      fatal("--jit requires " PACKAGE_NAME " to be built with LLVM 13 or later");
+#endif
+
+   // With the cache or JIT enabled every top-level unit gets its own
+   // module so only the code which is needed is compiled
+   if (use_cache || use_jit)
+      max_module_insns = 0;
+   else
+      max_module_insns = (nthreads > 1) ? MODULE_INSNS : UINT_MAX;
+
+   const char *pgo_file = opt_get_str("pgo-use");
+   if (pgo_file != NULL && kind == T_ELAB)
+      pgo_profile = pgo_read(pgo_file);
+
+#if !LLVM_HAS_DEBUG_INFO
+   if (opt_get_int("debug-info"))
+      warnf("--debug-info requires " PACKAGE_NAME " to be built with LLVM 11 "
+            "or later");
+#endif
+
+   phase_begin("llvm");
+   cgen_new_module(top, vcode, tree_ident(top));
    cgen_top(top, vcode);
 
-   if (opt_get_int("dump-llvm"))
-      LLVMDumpModule(module);
+   if (kind == T_ELAB && tree_attr_int(top, bundle_i, 0))
+      cgen_bundle_symtab(top);
+
+   phase_end(NULL);
+
+#if LLVM_HAS_DEBUG_INFO
+   cgen_debug_finish();
+#endif
+
+   if (pgo_profile != NULL) {
+      if (pgo_matched == 0)
+         warnf("profile %s does not match any process in this design",
+               pgo_file);
+      else if (pgo_matched < pgo_procs)
+         warnf("profile %s is out of date for %u of %u processes",
+               pgo_file, pgo_procs - pgo_matched, pgo_procs);
+
+      pgo_free(pgo_profile);
+      pgo_profile = NULL;
+   }
+
+   phase_begin("verify");
+
+   for (unsigned i = 0; i < nmodules; i++) {
+      if (i > 0)
+         cgen_prune_module(modules[i]);
+
+      if (opt_get_int("dump-llvm"))
+         LLVMDumpModule(modules[i]);
+
+      if (LLVMVerifyModule(modules[i], LLVMPrintMessageAction, NULL))
+         fatal("LLVM verification failed");
+   }
+
+   phase_end(NULL);
+
+#if LLVM_HAS_LAZY_JIT
+   if (use_jit) {
+      phase_begin("jit");
+      cgen_jit(top);
+      phase_end(NULL);
+   }
+   else
+#endif
+      cgen_objects(top, tm_ref, use_cache, nthreads);
+
+   free(modules);
+   modules  = NULL;
+   nmodules = 0;
+   module   = NULL;
 
-   if (LLVMVerifyModule(module, LLVMPrintMessageAction, NULL))
-      fatal("LLVM verification failed");
+   ident_list_free(bundle_units);
+   bundle_units = NULL;
 
-   cgen_optimise();
-   cgen_native(top, tm_ref);
+   hash_free(const_data);
+   const_data = NULL;
 
-   LLVMDisposeModule(module);
    LLVMDisposeBuilder(builder);
    LLVMDisposeTargetMachine(tm_ref);
 #if LLVM_HAS_CREATE_TARGET_DATA_LAYOUT
    LLVMDisposeTargetData(data_ref);
 #endif
-   LLVMDisposeMessage(def_triple);
+   LLVMDisposeMessage(target_layout);
+   LLVMDisposeMessage(target_triple);
+   target_layout = NULL;
+   target_triple = NULL;
+   target_data   = NULL;
 }
@@ -933,6 +933,7 @@ void intern_strings(void)
    cond_tag_i       = ident_new("cond_tag");
    sub_cond_i       = ident_new("sub_cond");
    range_var_i      = ident_new("range_var");
+   elide_bounds_i   = ident_new("elide_bounds");
    work_i           = ident_new("WORK");
    wait_level_i     = ident_new("wait_level");
    impure_io_i      = ident_new("impure_io");
@@ -940,6 +941,8 @@ void intern_strings(void)
    std_i            = ident_new("STD");
    nnets_i          = ident_new("nnets");
    thunk_i          = ident_new("thunk");
+   cycle_level_i    = ident_new("cycle_level");
+   bundle_i         = ident_new("bundle");
 }
 
 bool pack_needs_cgen(tree_t t)
@@ -191,6 +191,7 @@ GLOBAL ident_t cond_tag_i;
 GLOBAL ident_t sub_cond_i;
 GLOBAL ident_t static_i;
 GLOBAL ident_t range_var_i;
+GLOBAL ident_t elide_bounds_i;
 GLOBAL ident_t work_i;
 GLOBAL ident_t wait_level_i;
 GLOBAL ident_t impure_io_i;
@@ -198,6 +199,8 @@ GLOBAL ident_t simple_name_i;
 GLOBAL ident_t std_i;
 GLOBAL ident_t nnets_i;
 GLOBAL ident_t thunk_i;
+GLOBAL ident_t cycle_level_i;
+GLOBAL ident_t bundle_i;
 
 void intern_strings();
 
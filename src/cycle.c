@@ -0,0 +1,468 @@
+//
+//  Copyright (C) 2018  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "util.h"
+#include "tree.h"
+#include "phase.h"
+#include "common.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+// A process is combinational if it suspends only on a static wait at
+// the end, reads no signals other than those it waits on, and drives
+// signals it does not read with zero delay that no other process
+// drives. Such processes are sorted into levels so that every process
+// only waits on signals driven by processes at lower levels or outside
+// the region, and the runtime can evaluate each level in turn without
+// any intervening delta cycles.
+
+#define WRITER_NONE  -1
+#define WRITER_MANY  -2
+
+typedef struct {
+   tree_t   *items;
+   unsigned  count;
+   unsigned  max;
+} cycle_list_t;
+
+typedef struct {
+   tree_t        proc;
+   bool          comb;
+   int           level;
+   unsigned      npreds;
+   unsigned      nsuccs;
+   unsigned      maxsuccs;
+   int          *succs;
+   cycle_list_t  reads;
+   cycle_list_t  targets;
+   cycle_list_t  triggers;
+   cycle_list_t  writes;
+} cycle_proc_t;
+
+typedef struct {
+   cycle_proc_t *procs;
+   int           nprocs;
+   int          *writer;
+   int           nnets;
+   cycle_proc_t *current;
+   int           index;
+} cycle_ctx_t;
+
+static bool cycle_list_contains(const cycle_list_t *list, tree_t t)
+{
+   for (unsigned i = 0; i < list->count; i++) {
+      if (list->items[i] == t)
+         return true;
+   }
+
+   return false;
+}
+
+static void cycle_list_add(cycle_list_t *list, tree_t t)
+{
+   if (cycle_list_contains(list, t))
+      return;
+
+   if (list->count == list->max) {
+      list->max = MAX(list->max * 2, 8);
+      list->items = xrealloc(list->items, list->max * sizeof(tree_t));
+   }
+
+   list->items[(list->count)++] = t;
+}
+
+static tree_t cycle_signal_ref(tree_t name)
+{
+   // Return the reference to a signal at the base of a name or NULL
+
+   tree_kind_t kind;
+   while ((kind = tree_kind(name)) == T_ARRAY_REF || kind == T_ARRAY_SLICE
+          || kind == T_RECORD_REF)
+      name = tree_value(name);
+
+   if (kind != T_REF || tree_kind(tree_ref(name)) != T_SIGNAL_DECL)
+      return NULL;
+
+   return name;
+}
+
+static tree_t cycle_signal_name(tree_t name)
+{
+   tree_t ref = cycle_signal_ref(name);
+   return ref == NULL ? NULL : tree_ref(ref);
+}
+
+static bool cycle_zero_delay(tree_t delay)
+{
+   int64_t value;
+   return folded_int(delay, &value) && value == 0;
+}
+
+static bool cycle_local_var(tree_t proc, tree_t decl)
+{
+   const int ndecls = tree_decls(proc);
+   for (int i = 0; i < ndecls; i++) {
+      if (tree_decl(proc, i) == decl)
+         return true;
+   }
+
+   return false;
+}
+
+static void cycle_mark_writer(cycle_ctx_t *ctx, tree_t decl)
+{
+   const int nnets = tree_nets(decl);
+   if (nnets == 0)
+      ctx->current->comb = false;
+
+   for (int i = 0; i < nnets; i++) {
+      const netid_t nid = tree_net(decl, i);
+      if (nid >= ctx->nnets)
+         continue;
+      else if (ctx->writer[nid] == WRITER_NONE)
+         ctx->writer[nid] = ctx->index;
+      else if (ctx->writer[nid] != ctx->index)
+         ctx->writer[nid] = WRITER_MANY;
+   }
+}
+
+static void cycle_signal_assign(tree_t t, void *_ctx)
+{
+   cycle_ctx_t *ctx = _ctx;
+   cycle_proc_t *p = ctx->current;
+
+   tree_t ref = cycle_signal_ref(tree_target(t));
+   if (ref == NULL) {
+      // Aggregate targets are not tracked
+      p->comb = false;
+      return;
+   }
+
+   cycle_mark_writer(ctx, tree_ref(ref));
+   cycle_list_add(&(p->targets), ref);
+   cycle_list_add(&(p->writes), tree_ref(ref));
+
+   if (tree_has_reject(t) && !cycle_zero_delay(tree_reject(t)))
+      p->comb = false;
+
+   const int nwaves = tree_waveforms(t);
+   for (int i = 0; i < nwaves; i++) {
+      tree_t w = tree_waveform(t, i);
+      if (tree_has_delay(w) && !cycle_zero_delay(tree_delay(w)))
+         p->comb = false;
+   }
+}
+
+static void cycle_pcall(tree_t t, cycle_ctx_t *ctx)
+{
+   // A procedure may drive any signal passed to it and may also wait so
+   // the calling process is never combinational
+
+   ctx->current->comb = false;
+
+   const int nparams = tree_params(t);
+   for (int i = 0; i < nparams; i++) {
+      tree_t decl = cycle_signal_name(tree_value(tree_param(t, i)));
+      if (decl != NULL)
+         cycle_mark_writer(ctx, decl);
+   }
+}
+
+static void cycle_fcall(tree_t t, cycle_ctx_t *ctx)
+{
+   tree_t decl = tree_ref(t);
+
+   if (tree_attr_str(decl, builtin_i) != NULL)
+      return;
+   else if (tree_flags(decl) & TREE_F_IMPURE)
+      ctx->current->comb = false;
+   else {
+      // Signal parameters allow the function to read attributes such
+      // as 'EVENT which depend on when the process runs
+      const int nports = tree_ports(decl);
+      for (int i = 0; i < nports; i++) {
+         if (tree_class(tree_port(decl, i)) == C_SIGNAL)
+            ctx->current->comb = false;
+      }
+   }
+}
+
+static void cycle_visit_fn(tree_t t, void *_ctx)
+{
+   cycle_ctx_t *ctx = _ctx;
+   cycle_proc_t *p = ctx->current;
+
+   switch (tree_kind(t)) {
+   case T_PCALL:
+      cycle_pcall(t, ctx);
+      break;
+
+   case T_FCALL:
+      cycle_fcall(t, ctx);
+      break;
+
+   case T_REF:
+      {
+         tree_t decl = tree_ref(t);
+         switch (tree_kind(decl)) {
+         case T_SIGNAL_DECL:
+            if (!cycle_list_contains(&(p->targets), t))
+               cycle_list_add(&(p->reads), decl);
+            break;
+         case T_VAR_DECL:
+            if (!cycle_local_var(p->proc, decl))
+               p->comb = false;
+            break;
+         case T_ALIAS:
+         case T_FILE_DECL:
+            p->comb = false;
+            break;
+         default:
+            break;
+         }
+      }
+      break;
+
+   case T_WAIT:
+   case T_ATTR_REF:
+      p->comb = false;
+      break;
+
+   default:
+      break;
+   }
+}
+
+static tree_t cycle_static_wait(tree_t proc)
+{
+   // Return the static wait at the end of the process if it only waits
+   // for events on whole signals
+
+   const int nstmts = tree_stmts(proc);
+   if (nstmts == 0)
+      return NULL;
+
+   tree_t wait = tree_stmt(proc, nstmts - 1);
+   if (tree_kind(wait) != T_WAIT || !tree_attr_int(wait, static_i, 0))
+      return NULL;
+   else if (tree_has_delay(wait) || tree_has_value(wait))
+      return NULL;
+
+   const int ntriggers = tree_triggers(wait);
+   if (ntriggers == 0)
+      return NULL;
+
+   for (int i = 0; i < ntriggers; i++) {
+      if (cycle_signal_name(tree_trigger(wait, i)) == NULL)
+         return NULL;
+   }
+
+   return wait;
+}
+
+static void cycle_analyse(cycle_ctx_t *ctx, int index)
+{
+   cycle_proc_t *p = &(ctx->procs[index]);
+   ctx->current = p;
+   ctx->index   = index;
+
+   p->comb = !(tree_flags(p->proc) & TREE_F_POSTPONED);
+
+   tree_t wait = cycle_static_wait(p->proc);
+   if (wait == NULL)
+      p->comb = false;
+
+   const int nstmts = tree_stmts(p->proc);
+   for (int i = 0; i < nstmts; i++) {
+      tree_t s = tree_stmt(p->proc, i);
+      if (s != wait) {
+         tree_visit_only(s, cycle_signal_assign, ctx, T_SIGNAL_ASSIGN);
+         tree_visit(s, cycle_visit_fn, ctx);
+      }
+   }
+
+   const int ndecls = tree_decls(p->proc);
+   for (int i = 0; i < ndecls; i++)
+      tree_visit(tree_decl(p->proc, i), cycle_visit_fn, ctx);
+
+   if (!p->comb)
+      return;
+
+   const int ntriggers = tree_triggers(wait);
+   for (int i = 0; i < ntriggers; i++)
+      cycle_list_add(&(p->triggers), cycle_signal_name(tree_trigger(wait, i)));
+
+   // Every signal read must be waited on and none of them may be
+   // driven by this process
+
+   for (unsigned i = 0; i < p->reads.count && p->comb; i++) {
+      tree_t decl = p->reads.items[i];
+      p->comb = cycle_list_contains(&(p->triggers), decl)
+         && !cycle_list_contains(&(p->writes), decl);
+   }
+}
+
+static void cycle_add_edge(cycle_proc_t *from, int to)
+{
+   if (from->nsuccs > 0 && from->succs[from->nsuccs - 1] == to)
+      return;
+
+   if (from->nsuccs == from->maxsuccs) {
+      from->maxsuccs = MAX(from->maxsuccs * 2, 8);
+      from->succs = xrealloc(from->succs, from->maxsuccs * sizeof(int));
+   }
+
+   from->succs[(from->nsuccs)++] = to;
+}
+
+static void cycle_build_graph(cycle_ctx_t *ctx)
+{
+   for (int i = 0; i < ctx->nprocs; i++) {
+      cycle_proc_t *p = &(ctx->procs[i]);
+
+      for (unsigned j = 0; j < p->writes.count && p->comb; j++) {
+         const int nnets = tree_nets(p->writes.items[j]);
+         for (int k = 0; k < nnets; k++) {
+            const netid_t nid = tree_net(p->writes.items[j], k);
+            if (nid < ctx->nnets && ctx->writer[nid] != i)
+               p->comb = false;
+         }
+      }
+   }
+
+   for (int i = 0; i < ctx->nprocs; i++) {
+      cycle_proc_t *p = &(ctx->procs[i]);
+      if (!p->comb)
+         continue;
+
+      for (unsigned j = 0; j < p->triggers.count && p->comb; j++) {
+         const int nnets = tree_nets(p->triggers.items[j]);
+         for (int k = 0; k < nnets; k++) {
+            const netid_t nid = tree_net(p->triggers.items[j], k);
+            if (nid >= ctx->nnets)
+               continue;
+
+            const int w = ctx->writer[nid];
+            if (w == i) {
+               // Waits on a signal it drives
+               p->comb = false;
+               break;
+            }
+            else if (w >= 0)
+               cycle_add_edge(&(ctx->procs[w]), i);
+         }
+      }
+   }
+
+   for (int i = 0; i < ctx->nprocs; i++) {
+      cycle_proc_t *p = &(ctx->procs[i]);
+      if (!p->comb)
+         continue;
+
+      for (unsigned j = 0; j < p->nsuccs; j++)
+         ctx->procs[p->succs[j]].npreds++;
+   }
+}
+
+static int cycle_levelise(cycle_ctx_t *ctx)
+{
+   // Kahn's algorithm: processes on a combinational loop or downstream
+   // of one are never released and stay event driven
+
+   int *queue = xmalloc(ctx->nprocs * sizeof(int));
+   int head = 0, tail = 0;
+
+   for (int i = 0; i < ctx->nprocs; i++) {
+      cycle_proc_t *p = &(ctx->procs[i]);
+      if (p->comb && p->npreds == 0) {
+         p->level = 0;
+         queue[tail++] = i;
+      }
+   }
+
+   int nlevels = 0;
+   while (head < tail) {
+      cycle_proc_t *p = &(ctx->procs[queue[head++]]);
+      nlevels = MAX(nlevels, p->level + 1);
+
+      for (unsigned i = 0; i < p->nsuccs; i++) {
+         cycle_proc_t *s = &(ctx->procs[p->succs[i]]);
+         if (!s->comb)
+            continue;
+
+         s->level = MAX(s->level, p->level + 1);
+         if (--(s->npreds) == 0)
+            queue[tail++] = p->succs[i];
+      }
+   }
+
+   for (int i = 0; i < tail; i++) {
+      cycle_proc_t *p = &(ctx->procs[queue[i]]);
+      tree_add_attr_int(p->proc, cycle_level_i, p->level);
+   }
+
+   free(queue);
+   return nlevels;
+}
+
+void cycle_regions(tree_t top)
+{
+   cycle_ctx_t ctx;
+   ctx.nnets   = tree_attr_int(top, nnets_i, 0);
+   ctx.nprocs  = tree_stmts(top);
+   ctx.procs   = xcalloc(ctx.nprocs * sizeof(cycle_proc_t));
+   ctx.writer  = xmalloc(ctx.nnets * sizeof(int));
+   ctx.current = NULL;
+   ctx.index   = -1;
+
+   for (int i = 0; i < ctx.nnets; i++)
+      ctx.writer[i] = WRITER_NONE;
+
+   for (int i = 0; i < ctx.nprocs; i++) {
+      tree_t p = tree_stmt(top, i);
+      assert(tree_kind(p) == T_PROCESS);
+
+      ctx.procs[i].proc  = p;
+      ctx.procs[i].level = 0;
+      cycle_analyse(&ctx, i);
+   }
+
+   cycle_build_graph(&ctx);
+   const int nlevels = cycle_levelise(&ctx);
+
+   if (opt_get_int("verbose")) {
+      int nregion = 0;
+      for (int i = 0; i < ctx.nprocs; i++) {
+         if (tree_attr_int(ctx.procs[i].proc, cycle_level_i, -1) >= 0)
+            nregion++;
+      }
+
+      notef("%d of %d processes in cycle-based regions with %d levels",
+            nregion, ctx.nprocs, nlevels);
+   }
+
+   for (int i = 0; i < ctx.nprocs; i++) {
+      free(ctx.procs[i].succs);
+      free(ctx.procs[i].reads.items);
+      free(ctx.procs[i].targets.items);
+      free(ctx.procs[i].triggers.items);
+      free(ctx.procs[i].writes.items);
+   }
+   free(ctx.procs);
+   free(ctx.writer);
+}
@@ -0,0 +1,285 @@
+//
+//  Copyright (C) 2018  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "util.h"
+#include "phase.h"
+#include "hash.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// The scan does not parse the source: it only looks for the few token
+// sequences which declare a design unit or name one in the work library
+// so it may find spurious dependencies but should never miss one
+
+#define WINDOW 5
+
+typedef enum {
+   TOK_ID,
+   TOK_DOT,
+   TOK_OTHER
+} tok_kind_t;
+
+typedef struct {
+   tok_kind_t kind;
+   ident_t    ident;
+} tok_t;
+
+typedef struct {
+   ident_t *defines;
+   unsigned ndefines;
+   unsigned defines_alloc;
+   ident_t *uses;
+   unsigned nuses;
+   unsigned uses_alloc;
+} scan_file_t;
+
+typedef struct {
+   tok_t        window[WINDOW];
+   scan_file_t *file;
+   ident_t      work;
+} scan_state_t;
+
+static ident_t work_i, entity_i, package_i, body_i, architecture_i;
+static ident_t configuration_i, context_i, of_i, is_i;
+
+static void scan_define(scan_state_t *s, ident_t name)
+{
+   scan_file_t *f = s->file;
+   ARRAY_APPEND(f->defines, name, f->ndefines, f->defines_alloc);
+}
+
+static void scan_use(scan_state_t *s, ident_t name)
+{
+   scan_file_t *f = s->file;
+   ARRAY_APPEND(f->uses, name, f->nuses, f->uses_alloc);
+}
+
+static bool scan_is(scan_state_t *s, int back, ident_t what)
+{
+   const tok_t *t = &(s->window[WINDOW - back]);
+   return t->kind == TOK_ID && t->ident == what;
+}
+
+static bool scan_is_id(scan_state_t *s, int back)
+{
+   return s->window[WINDOW - back].kind == TOK_ID;
+}
+
+static void scan_token(scan_state_t *s, tok_kind_t kind, ident_t ident)
+{
+   memmove(s->window, s->window + 1, (WINDOW - 1) * sizeof(tok_t));
+   s->window[WINDOW - 1].kind  = kind;
+   s->window[WINDOW - 1].ident = ident;
+
+   if (scan_is(s, 1, is_i) && scan_is_id(s, 2)) {
+      ident_t name = s->window[WINDOW - 2].ident;
+
+      if (scan_is(s, 3, entity_i) || scan_is(s, 3, context_i))
+         scan_define(s, name);
+      else if (scan_is(s, 3, package_i) && name != body_i)
+         scan_define(s, name);
+      else if (scan_is(s, 3, body_i) && scan_is(s, 4, package_i))
+         scan_use(s, name);
+      else if (scan_is(s, 3, of_i) && scan_is_id(s, 4)) {
+         if (scan_is(s, 5, architecture_i))
+            scan_use(s, name);
+         else if (scan_is(s, 5, configuration_i)) {
+            scan_define(s, s->window[WINDOW - 4].ident);
+            scan_use(s, name);
+         }
+      }
+   }
+   else if (kind == TOK_ID && s->window[WINDOW - 2].kind == TOK_DOT
+            && (scan_is(s, 3, work_i) || scan_is(s, 3, s->work))
+            && s->window[WINDOW - 4].kind != TOK_DOT)
+      scan_use(s, ident);
+}
+
+static void scan_buffer(scan_state_t *s, const char *p, const char *end)
+{
+   bool tick_is_attr = false;
+
+   while (p < end) {
+      const char c = *p;
+
+      if (isspace((int)c)) {
+         p++;
+         continue;
+      }
+      else if (c == '-' && p + 1 < end && p[1] == '-') {
+         while (p < end && *p != '\n')
+            p++;
+         continue;
+      }
+      else if (c == '/' && p + 1 < end && p[1] == '*') {
+         for (p += 2; p + 1 < end && !(p[0] == '*' && p[1] == '/'); p++)
+            ;
+         p += 2;
+         continue;
+      }
+
+      if (isalpha((int)c)) {
+         char buf[256];
+         size_t len = 0;
+         for (; p < end && (isalnum((int)*p) || *p == '_'); p++) {
+            if (len < sizeof(buf) - 1)
+               buf[len++] = toupper((int)*p);
+         }
+         buf[len] = '\0';
+
+         scan_token(s, TOK_ID, ident_new(buf));
+         tick_is_attr = true;
+         continue;
+      }
+      else if (isdigit((int)c)) {
+         // Includes based literals and the fraction of a real
+         while (p < end && (isalnum((int)*p) || *p == '_' || *p == '#'
+                            || (*p == '.' && p + 1 < end
+                                && isalnum((int)p[1]))))
+            p++;
+         scan_token(s, TOK_OTHER, NULL);
+         tick_is_attr = true;
+         continue;
+      }
+      else if (c == '"' || c == '\\') {
+         // A doubled delimiter inside the literal is an escaped one
+         for (p++; p < end; p++) {
+            if (*p == c && (p + 1 == end || p[1] != c))
+               break;
+            else if (*p == c)
+               p++;
+            else if (*p == '\n')
+               break;
+         }
+         p++;
+         scan_token(s, TOK_OTHER, NULL);
+         tick_is_attr = (c == '\\');
+         continue;
+      }
+      else if (c == '\'' && !tick_is_attr && p + 2 < end && p[2] == '\'') {
+         p += 3;
+         scan_token(s, TOK_OTHER, NULL);
+         tick_is_attr = true;
+         continue;
+      }
+
+      p++;
+      scan_token(s, c == '.' ? TOK_DOT : TOK_OTHER, NULL);
+      tick_is_attr = (c == ')' || c == ']');
+   }
+}
+
+static void scan_file(const char *file, scan_file_t *f, ident_t work)
+{
+   scan_state_t s = {
+      .file = f,
+      .work = work
+   };
+
+   const int fd = open(file, O_RDONLY);
+   if (fd < 0)
+      fatal_errno("opening %s", file);
+
+   struct stat buf;
+   if (fstat(fd, &buf) != 0)
+      fatal_errno("fstat");
+
+   if (!S_ISREG(buf.st_mode))
+      fatal("opening %s: not a regular file", file);
+
+   if (buf.st_size > 0) {
+      const char *map = map_file(fd, buf.st_size);
+      scan_buffer(&s, map, map + buf.st_size);
+      unmap_file((void *)map, buf.st_size);
+   }
+
+   close(fd);
+}
+
+depend_t *depend_scan(char **files, int nfiles, ident_t work)
+{
+   if (work_i == NULL) {
+      work_i          = ident_new("WORK");
+      entity_i        = ident_new("ENTITY");
+      package_i       = ident_new("PACKAGE");
+      body_i          = ident_new("BODY");
+      architecture_i  = ident_new("ARCHITECTURE");
+      configuration_i = ident_new("CONFIGURATION");
+      context_i       = ident_new("CONTEXT");
+      of_i            = ident_new("OF");
+      is_i            = ident_new("IS");
+   }
+
+   scan_file_t *scanned = xcalloc(nfiles * sizeof(scan_file_t));
+   hash_t *where = hash_new(nfiles * 4, false);
+
+   for (int i = 0; i < nfiles; i++) {
+      scan_file_t *f = &(scanned[i]);
+      f->defines_alloc = f->uses_alloc = 8;
+      f->defines = xmalloc(f->defines_alloc * sizeof(ident_t));
+      f->uses    = xmalloc(f->uses_alloc * sizeof(ident_t));
+
+      scan_file(files[i], f, work);
+
+      for (unsigned j = 0; j < f->ndefines; j++)
+         hash_put(where, f->defines[j], (void *)(uintptr_t)(i + 1));
+   }
+
+   // Analysing the files in any order which respects these constraints
+   // gives the same library as analysing them in the order given: a
+   // file which names a unit waits for the earlier files declaring it,
+   // and a later file redeclaring that unit waits until it is used
+
+   depend_t *after = xcalloc(nfiles * nfiles * sizeof(depend_t));
+
+   for (int i = 0; i < nfiles; i++) {
+      scan_file_t *f = &(scanned[i]);
+
+      for (unsigned j = 0; j < f->nuses + f->ndefines; j++) {
+         const bool use = j < f->nuses;
+         ident_t name = use ? f->uses[j] : f->defines[j - f->nuses];
+
+         void *value;
+         int k = 0, tmp;
+         while (tmp = k++, (value = hash_get_nth(where, name, &tmp))) {
+            const int other = (uintptr_t)value - 1;
+            if (other < i && use)
+               after[i * nfiles + other] = DEPEND_USE;
+            else if (other < i && after[i * nfiles + other] == DEPEND_NONE)
+               after[i * nfiles + other] = DEPEND_ORDER;
+            else if (other > i && use
+                     && after[other * nfiles + i] == DEPEND_NONE)
+               after[other * nfiles + i] = DEPEND_ORDER;
+         }
+      }
+   }
+
+   for (int i = 0; i < nfiles; i++) {
+      free(scanned[i].defines);
+      free(scanned[i].uses);
+   }
+   free(scanned);
+   hash_free(where);
+
+   return after;
+}
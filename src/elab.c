@@ -18,6 +18,8 @@
 #include "phase.h"
 #include "util.h"
 #include "common.h"
+#include "hash.h"
+#include "mem.h"
 #include "rt/cover.h"
 
 #include <ctype.h>
@@ -60,13 +62,6 @@ typedef struct map_list {
    tree_t name;
 } map_list_t;
 
-typedef struct copy_list copy_list_t;
-
-struct copy_list {
-   copy_list_t *next;
-   tree_t       tree;
-};
-
 typedef struct {
    lib_t    lib;
    ident_t  name;
@@ -93,6 +88,10 @@ static int errors = 0;
 
 static generic_list_t *generic_override = NULL;
 
+static hash_t   *memo = NULL;
+static unsigned  memo_hits = 0;
+static unsigned  memo_misses = 0;
+
 static ident_t hpathf(ident_t path, char sep, const char *fmt, ...)
 {
    va_list ap;
@@ -649,79 +648,98 @@ static map_list_t *elab_map(tree_t t, tree_t arch,
    return maps;
 }
 
-static netid_t elab_get_net(tree_t expr, int n)
+static tree_t elab_net_decl(tree_t expr, int *offset)
 {
-   switch (tree_kind(expr)) {
-   case T_REF:
-      {
-         tree_t decl = tree_ref(expr);
-         if (n < 0 || n >= tree_nets(decl)) {
-            assert(bounds_errors() > 0);   // Should have already caught this
-            return NETID_INVALID;
-         }
-         else
-            return tree_net(tree_ref(expr), n);
-      }
+   // Find the signal declaration an actual refers to and add the offset
+   // of its first net within that declaration
 
-   case T_ARRAY_REF:
-      {
-         tree_t value = tree_value(expr);
-         type_t array_type = tree_type(value);
+   for (;;) {
+      switch (tree_kind(expr)) {
+      case T_REF:
+         return tree_ref(expr);
 
-         const int nparams = tree_params(expr);
+      case T_ARRAY_REF:
+         {
+            tree_t value = tree_value(expr);
+            type_t array_type = tree_type(value);
 
-         int64_t offset = 0;
-         for (int i = 0; i < nparams; i++) {
-            tree_t index = tree_value(tree_param(expr, i));
-            const int64_t dim_off =
-               rebase_index(array_type, i, assume_int(index));
+            const int nparams = tree_params(expr);
 
-            if (i > 0) {
-               range_t type_r = type_dim(array_type, i);
-               int64_t low, high;
-               range_bounds(type_r, &low, &high);
+            int64_t index_off = 0;
+            for (int i = 0; i < nparams; i++) {
+               tree_t index = tree_value(tree_param(expr, i));
+               const int64_t dim_off =
+                  rebase_index(array_type, i, assume_int(index));
+
+               if (i > 0) {
+                  range_t type_r = type_dim(array_type, i);
+                  int64_t low, high;
+                  range_bounds(type_r, &low, &high);
+
+                  index_off *= high - low + 1;
+               }
 
-               offset *= high - low + 1;
+               index_off += dim_off;
             }
 
-            offset += dim_off;
+            const int64_t stride = type_width(type_elem(array_type));
+            *offset += index_off * stride;
+            expr = value;
          }
+         break;
 
-         const int64_t stride = type_width(type_elem(array_type));
-         return elab_get_net(value, n + offset * stride);
-      }
-
-   case T_ARRAY_SLICE:
-      {
-         tree_t value = tree_value(expr);
-         type_t array_type = tree_type(value);
+      case T_ARRAY_SLICE:
+         {
+            tree_t value = tree_value(expr);
+            type_t array_type = tree_type(value);
 
-         range_t type_r  = range_of(array_type, 0);
-         range_t slice_r = tree_range(expr, 0);
+            range_t type_r  = range_of(array_type, 0);
+            range_t slice_r = tree_range(expr, 0);
 
-         assert(type_r.kind == slice_r.kind);
+            assert(type_r.kind == slice_r.kind);
 
-         const int64_t type_off =
-            rebase_index(array_type, 0, assume_int(slice_r.left));
+            const int64_t type_off =
+               rebase_index(array_type, 0, assume_int(slice_r.left));
 
-         const int stride = type_width(type_elem(array_type));
+            const int stride = type_width(type_elem(array_type));
 
-         return elab_get_net(value, n + (type_off * stride));
-      }
+            *offset += type_off * stride;
+            expr = value;
+         }
+         break;
 
-   case T_RECORD_REF:
-      {
-         tree_t rec  = tree_value(expr);
-         type_t type = tree_type(rec);
+      case T_RECORD_REF:
+         {
+            tree_t rec  = tree_value(expr);
+            type_t type = tree_type(rec);
 
-         const int roff = record_field_to_net(type, tree_ident(expr));
+            *offset += record_field_to_net(type, tree_ident(expr));
+            expr = rec;
+         }
+         break;
 
-         return elab_get_net(rec, n + roff);
+      default:
+         assert(false);
       }
+   }
+}
 
-   default:
-      assert(false);
+static void elab_map_range(tree_t signal, int first, tree_t actual,
+                           int count)
+{
+   // The nets of any actual are a contiguous range of the nets of the
+   // signal it names so are copied in one go
+
+   int offset = 0;
+   tree_t decl = elab_net_decl(actual, &offset);
+
+   if (offset < 0 || offset + count > tree_nets(decl)) {
+      assert(bounds_errors() > 0);   // Should have already caught this
+      for (int i = 0; i < count; i++)
+         tree_change_net(signal, first + i, NETID_INVALID);
    }
+   else
+      tree_copy_nets(signal, first, decl, offset, count);
 }
 
 static void elab_map_nets(map_list_t *maps)
@@ -742,8 +760,8 @@ static void elab_map_nets(map_list_t *maps)
             }
          }
 
-         for (int i = 0; i < awidth; i++)
-            tree_add_net(maps->signal, elab_get_net(maps->actual, i));
+         elab_map_range(maps->signal, tree_nets(maps->signal),
+                        maps->actual, awidth);
       }
       else {
          // Associate a sub-element or slice of the port
@@ -761,9 +779,8 @@ static void elab_map_nets(map_list_t *maps)
                const int64_t index_off =
                   rebase_index(array_type, 0, assume_int(index));
 
-               for (int i = 0; i < width; i++)
-                  tree_change_net(maps->signal, index_off * width + i,
-                                  elab_get_net(maps->actual, i));
+               elab_map_range(maps->signal, index_off * width,
+                              maps->actual, width);
             }
             break;
 
@@ -780,9 +797,7 @@ static void elab_map_nets(map_list_t *maps)
                   rebase_index(array_type, 0, assume_int(slice.left));
 
                const int width = MAX(high - low + 1, 0);
-               for (int i = 0; i < width; i++)
-                  tree_change_net(maps->signal, base_off + i,
-                                  elab_get_net(maps->actual, i));
+               elab_map_range(maps->signal, base_off, maps->actual, width);
             }
             break;
 
@@ -833,50 +848,35 @@ static bool elab_should_copy(tree_t t)
    }
 }
 
-static void elab_build_copy_list(tree_t t, void *context)
+static void elab_build_copy_set(tree_t t, void *context)
 {
-   copy_list_t **list = context;
-
-   if (elab_should_copy(t)) {
-      copy_list_t *new = xmalloc(sizeof(copy_list_t));
-      new->tree = t;
-      new->next = *list;
+   hash_t *set = context;
 
-      *list = new;
-   }
+   if (elab_should_copy(t))
+      hash_put(set, t, t);
 }
 
 static bool elab_copy_trees(tree_t t, void *context)
 {
-   copy_list_t *list = context;
-
-   if (elab_should_copy(t)) {
-      for (; list != NULL; list = list->next) {
-         if (list->tree == t)
-            return true;
-      }
-   }
-
-   return false;
+   return hash_get((hash_t *)context, t) != NULL;
 }
 
 static tree_t elab_copy(tree_t t)
 {
-   copy_list_t *copy_list = NULL;
-   tree_visit(t, elab_build_copy_list, &copy_list);
+   // Only the nodes in this set and the nodes which reach them are
+   // duplicated for each instance: everything else in the architecture
+   // such as subprogram bodies and types not depending on generics is
+   // shared by all copies
+   hash_t *copy_set = hash_new(256, true);
+   tree_visit(t, elab_build_copy_set, copy_set);
 
    // For achitectures, also make a copy of the entity ports
    if (tree_kind(t) == T_ARCH)
-      tree_visit(tree_ref(t), elab_build_copy_list, &copy_list);
-
-   tree_t copy = tree_copy(t, elab_copy_trees, copy_list);
+      tree_visit(tree_ref(t), elab_build_copy_set, copy_set);
 
-   while (copy_list != NULL) {
-      copy_list_t *tmp = copy_list->next;
-      free(copy_list);
-      copy_list = tmp;
-   }
+   tree_t copy = tree_copy(t, elab_copy_trees, copy_set);
 
+   hash_free(copy_set);
    return copy;
 }
 
@@ -994,8 +994,7 @@ static tree_t elab_default_binding(tree_t inst, lib_t *new_lib,
       }
    }
 
-   tree_t arch = elab_copy(pick_arch(tree_loc(comp),
-                                     tree_ident(entity), new_lib, ctx));
+   tree_t arch = pick_arch(tree_loc(comp), tree_ident(entity), new_lib, ctx);
 
    // Check entity is compatible with component declaration
 
@@ -1058,13 +1057,156 @@ static void elab_hint_fn(void *arg)
    note_at(tree_loc(t), "%s", tb_get(tb));
 }
 
+static bool elab_memo_port(tree_t formal, tree_t param)
+{
+   // Only a whole port connected to a signal is the same for every
+   // instance once renamed: anything else may be folded or checked
+   // differently depending on the actual
+
+   if (tree_subkind(param) == P_NAMED && tree_kind(tree_name(param)) != T_REF)
+      return false;
+   else if (type_is_unconstrained(tree_type(formal)))
+      return false;
+
+   tree_t ref = tree_value(param);
+   for (;;) {
+      switch (tree_kind(ref)) {
+      case T_REF:
+         return tree_kind(tree_ref(ref)) == T_SIGNAL_DECL;
+      case T_ARRAY_REF:
+      case T_ARRAY_SLICE:
+      case T_RECORD_REF:
+         ref = tree_value(ref);
+         break;
+      default:
+         return false;
+      }
+   }
+}
+
+static bool elab_memo_generic(tree_t value, text_buf_t *tb)
+{
+   switch (tree_kind(value)) {
+   case T_LITERAL:
+      switch (tree_subkind(value)) {
+      case L_INT:
+         tb_printf(tb, ",i%"PRIi64, tree_ival(value));
+         return true;
+      case L_REAL:
+         tb_printf(tb, ",r%a", tree_dval(value));
+         return true;
+      default:
+         return false;
+      }
+   case T_REF:
+      if (tree_kind(tree_ref(value)) == T_ENUM_LIT) {
+         tb_printf(tb, ",e%p", tree_ref(value));
+         return true;
+      }
+      else
+         return false;
+   default:
+      return false;
+   }
+}
+
+static ident_t elab_memo_key(tree_t t, tree_t arch)
+{
+   // Instances of the same architecture whose generics have the same
+   // literal values and whose ports are all connected to signals give
+   // the same tree after folding and bounds checking
+
+   tree_t entity = tree_ref(arch);
+
+   const int nports = tree_ports(entity);
+   if (tree_params(t) != nports)
+      return NULL;
+
+   for (int i = 0; i < nports; i++) {
+      tree_t p = tree_param(t, i);
+      tree_t formal = NULL;
+      if (tree_subkind(p) == P_POS)
+         formal = tree_port(entity, tree_pos(p));
+      else {
+         ident_t name = elab_formal_name(tree_name(p));
+         for (int j = 0; formal == NULL && j < nports; j++) {
+            if (tree_ident(tree_port(entity, j)) == name)
+               formal = tree_port(entity, j);
+         }
+      }
+
+      if (formal == NULL || !elab_memo_port(formal, p))
+         return NULL;
+   }
+
+   LOCAL_TEXT_BUF tb = tb_new();
+   tb_printf(tb, "%s", istr(tree_ident(arch)));
+
+   const int ngenerics = tree_generics(entity);
+   const int ngenmaps  = tree_genmaps(t);
+   for (int i = 0; i < ngenerics; i++) {
+      tree_t g = tree_generic(entity, i);
+
+      tree_t value = NULL;
+      for (int j = 0; value == NULL && j < ngenmaps; j++) {
+         tree_t m = tree_genmap(t, j);
+         if (tree_subkind(m) == P_POS) {
+            if (tree_pos(m) == i)
+               value = tree_value(m);
+         }
+         else if (tree_kind(tree_name(m)) != T_REF)
+            return NULL;
+         else if (tree_ident(tree_name(m)) == tree_ident(g))
+            value = tree_value(m);
+      }
+
+      if (value == NULL)
+         tb_printf(tb, ",d");
+      else if (!elab_memo_generic(value, tb))
+         return NULL;
+   }
+
+   return ident_new(tb_get(tb));
+}
+
+static tree_t elab_memo_arch(tree_t t, tree_t arch)
+{
+   // Generics are substituted and the result folded and checked once
+   // for all identical instances which then copy it like a library unit
+
+   ident_t key = elab_memo_key(t, arch);
+   if (key == NULL)
+      return NULL;
+
+   tree_t template = hash_get(memo, key);
+   if (template != NULL) {
+      memo_hits++;
+      return template;
+   }
+
+   memo_misses++;
+
+   template = elab_copy(arch);
+
+   (void)elab_map(t, template, tree_generics, tree_generic,
+                  tree_genmaps, tree_genmap);
+
+   set_hint_fn(elab_hint_fn, t);
+   simplify(template, EVAL_LOWER);
+   bounds_check(template);
+   clear_hint();
+
+   hash_put(memo, key, template);
+   return template;
+}
+
 static void elab_instance(tree_t t, const elab_ctx_t *ctx)
 {
    lib_t new_lib = NULL;
    tree_t arch = NULL;
    switch (tree_class(t)) {
    case C_ENTITY:
-      arch = elab_copy(pick_arch(tree_loc(t), tree_ident2(t), &new_lib, ctx));
+      arch = pick_arch(tree_loc(t), tree_ident2(t), &new_lib, ctx);
       break;
 
    case C_COMPONENT:
@@ -1082,11 +1224,22 @@ static void elab_instance(tree_t t, const elab_ctx_t *ctx)
    if (arch == NULL)
       return;
 
+   tree_t template = elab_memo_arch(t, arch);
+   if (template != NULL) {
+      if (eval_errors() > 0 || bounds_errors() > 0)
+         return;
+
+      arch = elab_copy(template);
+   }
+   else
+      arch = elab_copy(arch);
+
    map_list_t *maps = elab_map(t, arch, tree_ports, tree_port,
                                tree_params, tree_param);
 
-   (void)elab_map(t, arch, tree_generics, tree_generic,
-                  tree_genmaps, tree_genmap);
+   if (template == NULL)
+      (void)elab_map(t, arch, tree_generics, tree_generic,
+                     tree_genmaps, tree_genmap);
 
    ident_t ninst = hpathf(ctx->inst, '@', "%s(%s)",
                           simple_name(istr(tree_ident2(arch))),
@@ -1108,15 +1261,19 @@ static void elab_instance(tree_t t, const elab_ctx_t *ctx)
    elab_map_nets(maps);
    elab_free_maps(maps);
 
-   set_hint_fn(elab_hint_fn, t);
-   simplify(arch, EVAL_LOWER);
-   bounds_check(arch);
-   clear_hint();
+   if (template == NULL) {
+      set_hint_fn(elab_hint_fn, t);
+      simplify(arch, EVAL_LOWER);
+      bounds_check(arch);
+      clear_hint();
 
-   if (eval_errors() > 0 || bounds_errors() > 0)
-      return;
+      if (eval_errors() > 0 || bounds_errors() > 0)
+         return;
+   }
 
    elab_arch(arch, &new_ctx);
+
+   mem_check("elaborating %s", istr(ninst));
 }
 
 static void elab_signal_nets(tree_t decl, const elab_ctx_t *ctx)
@@ -1128,8 +1285,8 @@ static void elab_signal_nets(tree_t decl, const elab_ctx_t *ctx)
    }
    else {
       const int width = type_width(tree_type(decl));
-      for (int i = 0; i < width; i++)
-         tree_add_net(decl, (*ctx->next_net)++);
+      tree_add_nets(decl, *ctx->next_net, width);
+      *ctx->next_net += width;
    }
 }
 
@@ -1617,6 +1774,12 @@ static void elab_package_signals(tree_t unit, const elab_ctx_t *ctx)
    elab_pop_scope(ctx);
 }
 
+void elab_memo_stats(unsigned *hits, unsigned *misses)
+{
+   *hits   = memo_hits;
+   *misses = memo_misses;
+}
+
 void elab_set_generic(const char *name, const char *value)
 {
    ident_t id = ident_new(name);
@@ -1637,12 +1800,17 @@ void elab_set_generic(const char *name, const char *value)
 
 tree_t elab(tree_t top)
 {
+   tree_new_arena();
+
    tree_t e = tree_new(T_ELAB);
    tree_set_ident(e, ident_prefix(tree_ident(top),
                                   ident_new("elab"), '.'));
 
    errors = 0;
 
+   memo = hash_new(64, true);
+   memo_hits = memo_misses = 0;
+
    netid_t next_net = 0;
    elab_ctx_t ctx = {
       .out      = e,
@@ -1666,13 +1834,19 @@ tree_t elab(tree_t top)
       fatal("%s is not a suitable top-level unit", istr(tree_ident(top)));
    }
 
+   hash_free(memo);
+   memo = NULL;
+
+   eval_free_code_cache();
+
    if (errors > 0 || eval_errors() > 0)
       return NULL;
 
    tree_add_attr_int(e, nnets_i, next_net);
 
-   if (opt_get_int("cover"))
-      cover_tag(e);
+   const cover_mode_t cover = opt_get_int("cover");
+   if (cover != COVER_NONE)
+      cover_tag(e, cover);
 
    for (generic_list_t *it = generic_override; it != NULL; it = it->next) {
       if (!it->used)
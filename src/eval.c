@@ -19,6 +19,7 @@
 #include "util.h"
 #include "common.h"
 #include "vcode.h"
+#include "hash.h"
 
 #include <assert.h>
 #include <string.h>
@@ -31,6 +32,8 @@
 #define MAX_DIMS   4
 #define EVAL_HEAP  (16 * 1024)
 #define ITER_LIMIT 1000
+#define MEMO_SIZE  4096
+#define MEMO_ARGS  4
 
 typedef enum {
    VALUE_INVALID,
@@ -88,8 +91,63 @@ typedef struct {
    size_t       halloc;
    loc_t        last_loc;
    int          iterations;
+   bool         reported;
 } eval_state_t;
 
+typedef enum {
+   EVAL_I_GENERIC,
+   EVAL_I_CONST,
+   EVAL_I_ADD,
+   EVAL_I_SUB,
+   EVAL_I_MUL,
+   EVAL_I_ADDI,
+   EVAL_I_CMP,
+   EVAL_I_NOT,
+   EVAL_I_AND,
+   EVAL_I_OR,
+   EVAL_I_SELECT,
+   EVAL_I_CAST,
+   EVAL_I_BOUNDS,
+   EVAL_I_LOAD,
+   EVAL_I_STORE,
+   EVAL_I_LOAD_INDIRECT,
+   EVAL_I_STORE_INDIRECT,
+   EVAL_I_DEBUG_INFO,
+   EVAL_I_JUMP,
+   EVAL_I_COND,
+   EVAL_I_CASE,
+   EVAL_I_RETURN
+} eval_insn_kind_t;
+
+// Pre-decoded form of a vcode op: common integer cases are executed
+// directly and anything else falls back to the eval_op_* handler for
+// the original op
+typedef struct {
+   eval_insn_kind_t kind;
+   int              op;
+   vcode_block_t    block;
+   vcode_reg_t      result;
+   vcode_reg_t      args[2];
+   int64_t          value;
+   union {
+      int64_t       high;
+      loc_t         loc;
+   };
+} eval_insn_t;
+
+typedef struct {
+   eval_insn_t *insns;
+   unsigned     ninsns;
+   unsigned    *blocks;
+} eval_code_t;
+
+typedef struct {
+   uint32_t serial;
+   int      nargs;
+   value_t  args[MEMO_ARGS];
+   value_t  result;
+} eval_memo_t;
+
 #define EVAL_WARN(t, ...) do {                                          \
       if (state->flags & EVAL_WARN)                                     \
          warn_at(tree_loc(t), __VA_ARGS__);                             \
@@ -108,6 +166,19 @@ typedef struct {
 
 static int errors = 0;
 
+// Direct mapped cache of the results of calls to pure functions with
+// scalar arguments: a new entry replaces any older one in the same slot
+// which bounds the memory used
+static eval_memo_t *memo = NULL;
+static unsigned     memo_hits = 0;
+static unsigned     memo_misses = 0;
+
+// Translated code for registered vcode units keyed by unit serial
+static hash_t *code_cache = NULL;
+
+static eval_find_fn_t native_find = NULL;
+static eval_call_fn_t native_call = NULL;
+
 static void eval_vcode(eval_state_t *state);
 static bool eval_possible(tree_t t, eval_flags_t flags, bool top_level);
 
@@ -127,7 +198,6 @@ static void eval_load_vcode(lib_t lib, tree_t unit, eval_flags_t flags)
    }
 
    vcode_read(f);
-   fbuf_close(f);
 }
 
 static vcode_unit_t eval_find_unit(ident_t func_name, eval_flags_t flags)
@@ -603,12 +673,6 @@ static void eval_op_const_real(int op, eval_state_t *state)
    dst->real = vcode_get_real(op);
 }
 
-static void eval_op_return(int op, eval_state_t *state)
-{
-   if (vcode_count_args(op) > 0)
-      state->result = vcode_get_arg(op, 0);
-}
-
 static void eval_op_not(int op, eval_state_t *state)
 {
    value_t *dst = eval_get_reg(vcode_get_result(op), state);
@@ -893,6 +957,255 @@ static void eval_op_abs(int op, eval_state_t *state)
    }
 }
 
+static bool eval_memo_key(uint32_t serial, value_t **params, int nparams,
+                          uint32_t *hash)
+{
+   if (nparams > MEMO_ARGS)
+      return false;
+
+   uint32_t h = serial * 2654435761u;
+   for (int i = 0; i < nparams; i++) {
+      if (params[i]->kind != VALUE_INTEGER && params[i]->kind != VALUE_REAL)
+         return false;
+
+      const uint64_t bits = params[i]->integer;
+      h = (h ^ (bits >> 32) ^ bits) * 16777619u;
+   }
+
+   *hash = h % MEMO_SIZE;
+   return true;
+}
+
+static eval_memo_t *eval_memo_get(uint32_t serial, uint32_t hash,
+                                  value_t **params, int nparams)
+{
+   if (memo == NULL)
+      return NULL;
+
+   eval_memo_t *m = &(memo[hash]);
+   if (m->serial != serial || m->nargs != nparams)
+      return NULL;
+
+   for (int i = 0; i < nparams; i++) {
+      if (m->args[i].kind != params[i]->kind
+          || m->args[i].integer != params[i]->integer)
+         return NULL;
+   }
+
+   return m;
+}
+
+static void eval_memo_put(uint32_t serial, uint32_t hash, value_t **params,
+                          int nparams, value_t *result)
+{
+   if (result->kind != VALUE_INTEGER && result->kind != VALUE_REAL)
+      return;
+
+   if (memo == NULL)
+      memo = xcalloc(MEMO_SIZE * sizeof(eval_memo_t));
+
+   eval_memo_t *m = &(memo[hash]);
+   m->serial = serial;
+   m->nargs  = nparams;
+   m->result = *result;
+
+   for (int i = 0; i < nparams; i++)
+      m->args[i] = *params[i];
+}
+
+static bool eval_native_safe(void)
+{
+   // Only functions which use scalar values and variables in their own
+   // frame are run natively: anything else may depend on package state
+   // or runtime support that is not set up during elaboration
+
+   const vcode_type_t rtype = vcode_unit_result();
+   if (rtype == VCODE_INVALID_TYPE || vtype_kind(rtype) != VCODE_TYPE_INT)
+      return false;
+
+   const int nparams = vcode_count_params();
+   if (nparams > MEMO_ARGS)
+      return false;
+
+   for (int i = 0; i < nparams; i++) {
+      if (vtype_kind(vcode_param_type(i)) != VCODE_TYPE_INT)
+         return false;
+   }
+
+   const int depth = vcode_unit_depth();
+   const int nblocks = vcode_count_blocks();
+   for (int i = 0; i < nblocks; i++) {
+      vcode_select_block(i);
+
+      const int nops = vcode_count_ops();
+      for (int j = 0; j < nops; j++) {
+         switch (vcode_get_op(j)) {
+         case VCODE_OP_CONST:
+         case VCODE_OP_ADD:
+         case VCODE_OP_SUB:
+         case VCODE_OP_MUL:
+         case VCODE_OP_DIV:
+         case VCODE_OP_MOD:
+         case VCODE_OP_REM:
+         case VCODE_OP_NEG:
+         case VCODE_OP_ABS:
+         case VCODE_OP_ADDI:
+         case VCODE_OP_CMP:
+         case VCODE_OP_CAST:
+         case VCODE_OP_NOT:
+         case VCODE_OP_AND:
+         case VCODE_OP_OR:
+         case VCODE_OP_NAND:
+         case VCODE_OP_NOR:
+         case VCODE_OP_XOR:
+         case VCODE_OP_XNOR:
+         case VCODE_OP_SELECT:
+         case VCODE_OP_BOUNDS:
+         case VCODE_OP_DYNAMIC_BOUNDS:
+         case VCODE_OP_JUMP:
+         case VCODE_OP_COND:
+         case VCODE_OP_CASE:
+         case VCODE_OP_RETURN:
+         case VCODE_OP_COMMENT:
+         case VCODE_OP_DEBUG_INFO:
+            break;
+         case VCODE_OP_LOAD:
+         case VCODE_OP_STORE:
+            {
+               vcode_var_t var = vcode_get_address(j);
+               if (vcode_var_context(var) != depth || vcode_var_use_heap(var)
+                   || vtype_kind(vcode_var_type(var)) != VCODE_TYPE_INT)
+                  return false;
+            }
+            break;
+         default:
+            return false;
+         }
+      }
+   }
+
+   return true;
+}
+
+static void *eval_native_symbol(void)
+{
+   // Whether a function can be called natively is decided once per unit
+   // and the address of the compiled code kept
+
+   static hash_t *cache = NULL;
+   static char    unsafe;
+
+   const uint32_t serial = vcode_unit_serial();
+   const void *key = (void *)(uintptr_t)serial;
+
+   if (serial == 0)
+      return NULL;
+   else if (cache == NULL)
+      cache = hash_new(256, true);
+
+   void *fn = hash_get(cache, key);
+   if (fn == NULL) {
+      vcode_state_t vcode_state;
+      vcode_state_save(&vcode_state);
+
+      ident_t name = vcode_unit_name();
+      if (eval_native_safe()) {
+         ident_t unit = ident_runtil(ident_until(name, '('), '.');
+         fn = (*native_find)(unit, istr(name));
+      }
+
+      vcode_state_restore(&vcode_state);
+
+      if (fn == NULL)
+         fn = &unsafe;
+
+      hash_put(cache, key, fn);
+   }
+
+   return (fn == &unsafe) ? NULL : fn;
+}
+
+typedef struct {
+   void    *fn;
+   int      nparams;
+   int64_t  args[MEMO_ARGS];
+   int64_t  result;
+} eval_native_t;
+
+static void eval_native_thunk(void *context)
+{
+   eval_native_t *n = context;
+
+   // Arguments narrower than 64 bits are passed in the low part of a
+   // register so the compiled code can be called through a signature
+   // where every value is int64_t
+   switch (n->nparams) {
+   case 0:
+      n->result = (*(int64_t (*)(void))n->fn)();
+      break;
+   case 1:
+      n->result = (*(int64_t (*)(int64_t))n->fn)(n->args[0]);
+      break;
+   case 2:
+      n->result = (*(int64_t (*)(int64_t, int64_t))n->fn)
+         (n->args[0], n->args[1]);
+      break;
+   case 3:
+      n->result = (*(int64_t (*)(int64_t, int64_t, int64_t))n->fn)
+         (n->args[0], n->args[1], n->args[2]);
+      break;
+   case 4:
+      n->result = (*(int64_t (*)(int64_t, int64_t, int64_t, int64_t))n->fn)
+         (n->args[0], n->args[1], n->args[2], n->args[3]);
+      break;
+   default:
+      fatal_trace("cannot call native function with %d arguments",
+                  n->nparams);
+   }
+}
+
+static bool eval_native_call(value_t **params, int nparams, value_t *result)
+{
+#if defined __x86_64__ || defined __aarch64__
+   void *fn = eval_native_symbol();
+   if (fn == NULL)
+      return false;
+
+   eval_native_t n = {
+      .fn      = fn,
+      .nparams = nparams
+   };
+
+   for (int i = 0; i < nparams; i++) {
+      if (params[i]->kind != VALUE_INTEGER)
+         return false;
+      n.args[i] = params[i]->integer;
+   }
+
+   if (!(*native_call)(eval_native_thunk, &n))
+      return false;
+
+   // Only the low bits of the return register are defined
+   const vcode_type_t rtype = vcode_unit_result();
+   const int64_t low = vtype_low(rtype), high = vtype_high(rtype);
+   const int bits = bits_for_range(low, high);
+
+   int64_t value = n.result;
+   if (bits < 64) {
+      const uint64_t mask = (UINT64_C(1) << bits) - 1;
+      value = n.result & mask;
+      if (low < 0 && (value & (UINT64_C(1) << (bits - 1))))
+         value |= ~mask;
+   }
+
+   result->kind    = VALUE_INTEGER;
+   result->integer = value;
+   return true;
+#else
+   return false;
+#endif
+}
+
 static void eval_op_fcall(int op, eval_state_t *state)
 {
    vcode_state_t vcode_state;
@@ -914,10 +1227,57 @@ static void eval_op_fcall(int op, eval_state_t *state)
    }
 
    const bool nested = vcode_get_op(op) == VCODE_OP_NESTED_FCALL;
+   const vcode_reg_t result = vcode_get_result(op);
 
    vcode_select_unit(vcode);
    vcode_select_block(0);
 
+   // Calls to pure functions with the same arguments always give the
+   // same result so can be answered from the memo cache
+   uint32_t hash;
+   const uint32_t serial = vcode_unit_serial();
+   const bool memoise = !nested && vcode_unit_pure()
+      && result != VCODE_INVALID_REG
+      && eval_memo_key(serial, params, nparams, &hash);
+
+   if (memoise) {
+      eval_memo_t *m = eval_memo_get(serial, hash, params, nparams);
+      if (m != NULL) {
+         vcode_state_restore(&vcode_state);
+         *eval_get_reg(result, state) = m->result;
+         memo_hits++;
+
+         if (state->flags & EVAL_VERBOSE) {
+            const char *name = istr(vcode_get_func(op));
+            const char *nest = istr(tree_ident(state->fcall));
+            LOCAL_TEXT_BUF tb = tb_new();
+            eval_dump(tb, &(m->result), NULL);
+            notef("%s (in %s) returned %s from cache", name, nest, tb_get(tb));
+         }
+         return;
+      }
+
+      memo_misses++;
+   }
+
+   value_t native;
+   if (native_find != NULL && memoise
+       && eval_native_call(params, nparams, &native)) {
+      eval_memo_put(serial, hash, params, nparams, &native);
+      vcode_state_restore(&vcode_state);
+      *eval_get_reg(result, state) = native;
+
+      if (state->flags & EVAL_VERBOSE) {
+         const char *name = istr(vcode_get_func(op));
+         const char *nest = istr(tree_ident(state->fcall));
+         LOCAL_TEXT_BUF tb = tb_new();
+         eval_dump(tb, &native, NULL);
+         notef("%s (in %s) returned %s from native code", name, nest,
+               tb_get(tb));
+      }
+      return;
+   }
+
    context_t *context = eval_new_context(state);
    if (context == NULL)
       return;
@@ -939,11 +1299,19 @@ static void eval_op_fcall(int op, eval_state_t *state)
    };
 
    eval_vcode(&new);
+
+   if (memoise && !new.failed && !new.reported)
+      eval_memo_put(serial, hash, params, nparams,
+                    &(context->regs[new.result]));
+
    vcode_state_restore(&vcode_state);
 
    state->heap = new.heap;
    state->halloc = new.halloc;
 
+   if (new.reported)
+      state->reported = true;
+
    if (new.failed)
       state->failed = true;
    else if (vcode_get_result(op) != VCODE_INVALID_REG) {
@@ -1209,21 +1577,6 @@ static void eval_op_or(int op, eval_state_t *state)
    }
 }
 
-static void eval_op_jump(int op, eval_state_t *state)
-{
-   vcode_select_block(vcode_get_target(op, 0));
-   eval_vcode(state);
-}
-
-static void eval_op_cond(int op, eval_state_t *state)
-{
-   value_t *test = eval_get_reg(vcode_get_arg(op, 0), state);
-
-   const vcode_block_t next = vcode_get_target(op, !(test->integer));
-   vcode_select_block(next);
-   eval_vcode(state);
-}
-
 static void eval_op_undefined(int op, eval_state_t *state)
 {
    EVAL_WARN(state->fcall, "reference to object without defined "
@@ -1282,7 +1635,7 @@ static void eval_op_store_indirect(int op, eval_state_t *state)
       *(dst->pointer) = *src;
 }
 
-static void eval_op_case(int op, eval_state_t *state)
+static vcode_block_t eval_case_target(int op, eval_state_t *state)
 {
    value_t *test = eval_get_reg(vcode_get_arg(op, 0), state);
    vcode_block_t target = vcode_get_target(op, 0);
@@ -1296,8 +1649,7 @@ static void eval_op_case(int op, eval_state_t *state)
       }
    }
 
-   vcode_select_block(target);
-   eval_vcode(state);
+   return target;
 }
 
 static void eval_op_copy(int op, eval_state_t *state)
@@ -1331,8 +1683,10 @@ static void eval_op_report(int op, eval_state_t *state)
    value_t *length = eval_get_reg(vcode_get_arg(op, 2), state);
    value_t *severity = eval_get_reg(vcode_get_arg(op, 0), state);
 
-   if (state->flags & EVAL_REPORT)
+   if (state->flags & EVAL_REPORT) {
       eval_message(text, length, severity, &(state->last_loc), "Report");
+      state->reported = true;
+   }
    else
       state->failed = true;  // Cannot fold as would change runtime behaviour
 }
@@ -1348,6 +1702,7 @@ static void eval_op_assert(int op, eval_state_t *state)
       if (state->flags & EVAL_REPORT)
          eval_message(text, length, severity, &(state->last_loc), "Assertion");
       state->failed = severity->integer >= SEVERITY_ERROR;
+      state->reported = true;
    }
 }
 
@@ -1829,278 +2184,663 @@ static void eval_op_range_null(int op, eval_state_t *state)
       result->integer = right->integer > left->integer;
 }
 
-static void eval_vcode(eval_state_t *state)
+static void eval_op(int op, eval_state_t *state)
 {
-   if (++(state->iterations) >= ITER_LIMIT) {
-      EVAL_WARN(state->fcall, "iteration limit reached while evaluating %s",
-                istr(tree_ident(state->fcall)));
-      state->failed = true;
-      return;
-   }
+   switch (vcode_get_op(op)) {
+   case VCODE_OP_CONST:
+      eval_op_const(op, state);
+      break;
 
-   const int nops = vcode_count_ops();
-   for (int i = 0; i < nops && !(state->failed); i++) {
-      switch (vcode_get_op(i)) {
-      case VCODE_OP_COMMENT:
-         break;
+   case VCODE_OP_CONST_REAL:
+      eval_op_const_real(op, state);
+      break;
 
-      case VCODE_OP_CONST:
-         eval_op_const(i, state);
-         break;
+   case VCODE_OP_NOT:
+      eval_op_not(op, state);
+      break;
 
-      case VCODE_OP_CONST_REAL:
-         eval_op_const_real(i, state);
-         break;
+   case VCODE_OP_ADD:
+      eval_op_add(op, state);
+      break;
 
-      case VCODE_OP_RETURN:
-         eval_op_return(i, state);
-         return;
+   case VCODE_OP_SUB:
+      eval_op_sub(op, state);
+      break;
 
-      case VCODE_OP_NOT:
-         eval_op_not(i, state);
-         break;
+   case VCODE_OP_MUL:
+      eval_op_mul(op, state);
+      break;
 
-      case VCODE_OP_ADD:
-         eval_op_add(i, state);
-         break;
+   case VCODE_OP_DIV:
+      eval_op_div(op, state);
+      break;
 
-      case VCODE_OP_SUB:
-         eval_op_sub(i, state);
-         break;
+   case VCODE_OP_CMP:
+      eval_op_cmp(op, state);
+      break;
 
-      case VCODE_OP_MUL:
-         eval_op_mul(i, state);
-         break;
+   case VCODE_OP_CAST:
+      eval_op_cast(op, state);
+      break;
 
-      case VCODE_OP_DIV:
-         eval_op_div(i, state);
-         break;
+   case VCODE_OP_NEG:
+      eval_op_neg(op, state);
+      break;
 
-      case VCODE_OP_CMP:
-         eval_op_cmp(i, state);
-         break;
+   case VCODE_OP_FCALL:
+   case VCODE_OP_NESTED_FCALL:
+      if (state->flags & EVAL_FCALL)
+         eval_op_fcall(op, state);
+      else
+         state->failed = true;
+      break;
 
-      case VCODE_OP_CAST:
-         eval_op_cast(i, state);
-         break;
+   case VCODE_OP_BOUNDS:
+      eval_op_bounds(op, state);
+      break;
 
-      case VCODE_OP_NEG:
-         eval_op_neg(i, state);
-         break;
+   case VCODE_OP_CONST_ARRAY:
+      eval_op_const_array(op, state);
+      break;
 
-      case VCODE_OP_FCALL:
-      case VCODE_OP_NESTED_FCALL:
-         if (state->flags & EVAL_FCALL)
-            eval_op_fcall(i, state);
-         else
-            state->failed = true;
-         break;
+   case VCODE_OP_WRAP:
+      eval_op_wrap(op, state);
+      break;
 
-      case VCODE_OP_BOUNDS:
-         eval_op_bounds(i, state);
-         break;
+   case VCODE_OP_STORE:
+      eval_op_store(op, state);
+      break;
 
-      case VCODE_OP_CONST_ARRAY:
-         eval_op_const_array(i, state);
-         break;
+   case VCODE_OP_UNWRAP:
+      eval_op_unwrap(op, state);
+      break;
 
-      case VCODE_OP_WRAP:
-         eval_op_wrap(i, state);
-         break;
+   case VCODE_OP_UARRAY_LEN:
+      eval_op_uarray_len(op, state);
+      break;
 
-      case VCODE_OP_STORE:
-         eval_op_store(i, state);
-         break;
+   case VCODE_OP_MEMCMP:
+      eval_op_memcmp(op, state);
+      break;
 
-      case VCODE_OP_UNWRAP:
-         eval_op_unwrap(i, state);
-         break;
+   case VCODE_OP_AND:
+      eval_op_and(op, state);
+      break;
 
-      case VCODE_OP_UARRAY_LEN:
-         eval_op_uarray_len(i, state);
-         break;
+   case VCODE_OP_OR:
+      eval_op_or(op, state);
+      break;
 
-      case VCODE_OP_MEMCMP:
-         eval_op_memcmp(i, state);
-         break;
+   case VCODE_OP_LOAD:
+      eval_op_load(op, state);
+      break;
 
-      case VCODE_OP_AND:
-         eval_op_and(i, state);
-         break;
+   case VCODE_OP_UNDEFINED:
+      eval_op_undefined(op, state);
+      break;
 
-      case VCODE_OP_OR:
-         eval_op_or(i, state);
-         break;
+   case VCODE_OP_MOD:
+      eval_op_mod(op, state);
+      break;
 
-      case VCODE_OP_COND:
-         eval_op_cond(i, state);
-         return;
+   case VCODE_OP_REM:
+      eval_op_rem(op, state);
+      break;
 
-      case VCODE_OP_JUMP:
-         eval_op_jump(i, state);
-         return;
+   case VCODE_OP_DYNAMIC_BOUNDS:
+      eval_op_dynamic_bounds(op, state);
+      break;
 
-      case VCODE_OP_LOAD:
-         eval_op_load(i, state);
-         break;
+   case VCODE_OP_INDEX:
+      eval_op_index(op, state);
+      break;
 
-      case VCODE_OP_UNDEFINED:
-         eval_op_undefined(i, state);
-         break;
+   case VCODE_OP_COPY:
+      eval_op_copy(op, state);
+      break;
 
-      case VCODE_OP_CASE:
-         eval_op_case(i, state);
-         return;
+   case VCODE_OP_LOAD_INDIRECT:
+      eval_op_load_indirect(op, state);
+      break;
 
-      case VCODE_OP_MOD:
-         eval_op_mod(i, state);
-         break;
+   case VCODE_OP_STORE_INDIRECT:
+      eval_op_store_indirect(op, state);
+      break;
 
-      case VCODE_OP_REM:
-         eval_op_rem(i, state);
-         break;
+   case VCODE_OP_REPORT:
+      eval_op_report(op, state);
+      break;
 
-      case VCODE_OP_DYNAMIC_BOUNDS:
-         eval_op_dynamic_bounds(i, state);
-         break;
+   case VCODE_OP_ASSERT:
+      eval_op_assert(op, state);
+      break;
 
-      case VCODE_OP_INDEX:
-         eval_op_index(i, state);
-         break;
+   case VCODE_OP_SELECT:
+      eval_op_select(op, state);
+      break;
 
-      case VCODE_OP_COPY:
-         eval_op_copy(i, state);
-         break;
+   case VCODE_OP_ALLOCA:
+      eval_op_alloca(op, state);
+      break;
 
-      case VCODE_OP_LOAD_INDIRECT:
-         eval_op_load_indirect(i, state);
-         break;
+   case VCODE_OP_INDEX_CHECK:
+      eval_op_index_check(op, state);
+      break;
 
-      case VCODE_OP_STORE_INDIRECT:
-         eval_op_store_indirect(i, state);
-         break;
+   case VCODE_OP_ABS:
+      eval_op_abs(op, state);
+      break;
 
-      case VCODE_OP_REPORT:
-         eval_op_report(i, state);
-         break;
+   case VCODE_OP_IMAGE:
+      eval_op_image(op, state);
+      break;
 
-      case VCODE_OP_ASSERT:
-         eval_op_assert(i, state);
-         break;
+   case VCODE_OP_UARRAY_LEFT:
+      eval_op_uarray_left(op, state);
+      break;
 
-      case VCODE_OP_SELECT:
-         eval_op_select(i, state);
-         break;
+   case VCODE_OP_UARRAY_RIGHT:
+      eval_op_uarray_right(op, state);
+      break;
 
-      case VCODE_OP_ALLOCA:
-         eval_op_alloca(i, state);
-         break;
+   case VCODE_OP_UARRAY_DIR:
+      eval_op_uarray_dir(op, state);
+      break;
 
-      case VCODE_OP_INDEX_CHECK:
-         eval_op_index_check(i, state);
-         break;
+   case VCODE_OP_EXP:
+      eval_op_exp(op, state);
+      break;
 
-      case VCODE_OP_ABS:
-         eval_op_abs(i, state);
-         break;
+   case VCODE_OP_CONST_RECORD:
+      eval_op_const_record(op, state);
+      break;
 
-      case VCODE_OP_IMAGE:
-         eval_op_image(i, state);
-         break;
+   case VCODE_OP_RECORD_REF:
+      eval_op_record_ref(op, state);
+      break;
 
-      case VCODE_OP_HEAP_SAVE:
-      case VCODE_OP_HEAP_RESTORE:
-         break;
+   case VCODE_OP_MEMSET:
+      eval_op_memset(op, state);
+      break;
 
-      case VCODE_OP_UARRAY_LEFT:
-         eval_op_uarray_left(i, state);
-         break;
+   case VCODE_OP_BIT_SHIFT:
+      eval_op_bit_shift(op, state);
+      break;
 
-      case VCODE_OP_UARRAY_RIGHT:
-         eval_op_uarray_right(i, state);
-         break;
+   case VCODE_OP_ARRAY_SIZE:
+      eval_op_array_size(op, state);
+      break;
 
-      case VCODE_OP_UARRAY_DIR:
-         eval_op_uarray_dir(i, state);
-         break;
+   case VCODE_OP_IMAGE_MAP:
+      eval_op_image_map(op, state);
+      break;
 
-      case VCODE_OP_EXP:
-         eval_op_exp(i, state);
-         break;
+   case VCODE_OP_DEBUG_INFO:
+      eval_op_debug_info(op, state);
+      break;
 
-      case VCODE_OP_CONST_RECORD:
-         eval_op_const_record(i, state);
-         break;
+   case VCODE_OP_NULL:
+      eval_op_null(op, state);
+      break;
 
-      case VCODE_OP_RECORD_REF:
-         eval_op_record_ref(i, state);
-         break;
+   case VCODE_OP_PCALL:
+      eval_op_pcall(op, state);
+      break;
 
-      case VCODE_OP_MEMSET:
-         eval_op_memset(i, state);
-         break;
+   case VCODE_OP_NEW:
+      eval_op_new(op, state);
+      break;
 
-      case VCODE_OP_BIT_SHIFT:
-         eval_op_bit_shift(i, state);
-         break;
+   case VCODE_OP_ALL:
+      eval_op_all(op, state);
+      break;
 
-      case VCODE_OP_ARRAY_SIZE:
-         eval_op_array_size(i, state);
-         break;
+   case VCODE_OP_NULL_CHECK:
+      eval_op_null_check(op, state);
+      break;
 
-      case VCODE_OP_IMAGE_MAP:
-         eval_op_image_map(i, state);
-         break;
+   case VCODE_OP_DEALLOCATE:
+      eval_op_deallocate(op, state);
+      break;
 
-      case VCODE_OP_DEBUG_INFO:
-         eval_op_debug_info(i, state);
-         break;
+   case VCODE_OP_BIT_VEC_OP:
+      eval_op_bitvec_op(op, state);
+      break;
 
-      case VCODE_OP_NULL:
-         eval_op_null(i, state);
-         break;
+   case VCODE_OP_ADDI:
+      eval_op_addi(op, state);
+      break;
 
-      case VCODE_OP_PCALL:
-         eval_op_pcall(i, state);
-         break;
+   case VCODE_OP_PARAM_UPREF:
+      eval_op_param_upref(op, state);
+      break;
 
-      case VCODE_OP_NEW:
-         eval_op_new(i, state);
-         break;
+   case VCODE_OP_RANGE_NULL:
+      eval_op_range_null(op, state);
+      break;
 
-      case VCODE_OP_ALL:
-         eval_op_all(i, state);
-         break;
+   default:
+      vcode_dump();
+      fatal("cannot evaluate vcode op %s", vcode_op_string(vcode_get_op(op)));
+   }
+}
 
-      case VCODE_OP_NULL_CHECK:
-         eval_op_null_check(i, state);
-         break;
+static eval_code_t *eval_translate(void)
+{
+   // Flatten the blocks of the active unit into a single instruction
+   // stream with branch targets resolved to instruction indexes
 
-      case VCODE_OP_DEALLOCATE:
-         eval_op_deallocate(i, state);
-         break;
+   const int nblocks = vcode_count_blocks();
 
-      case VCODE_OP_BIT_VEC_OP:
-         eval_op_bitvec_op(i, state);
-         break;
+   eval_code_t *code = xcalloc(sizeof(eval_code_t));
+   code->blocks = xmalloc(nblocks * sizeof(unsigned));
 
-      case VCODE_OP_ADDI:
-         eval_op_addi(i, state);
-         break;
+   unsigned max = 0;
+   for (int i = 0; i < nblocks; i++) {
+      vcode_select_block(i);
+      max += vcode_count_ops();
+   }
 
-      case VCODE_OP_PARAM_UPREF:
-         eval_op_param_upref(i, state);
-         break;
+   code->insns = xmalloc(MAX(max, 1) * sizeof(eval_insn_t));
 
-      case VCODE_OP_RANGE_NULL:
-         eval_op_range_null(i, state);
-         break;
+   const int depth = vcode_unit_depth();
 
-      default:
-         vcode_dump();
-         fatal("cannot evaluate vcode op %s", vcode_op_string(vcode_get_op(i)));
+   for (int i = 0; i < nblocks; i++) {
+      vcode_select_block(i);
+      code->blocks[i] = code->ninsns;
+
+      const int nops = vcode_count_ops();
+      for (int j = 0; j < nops; j++) {
+         const vcode_op_t kind = vcode_get_op(j);
+         if (kind == VCODE_OP_COMMENT || kind == VCODE_OP_HEAP_SAVE
+             || kind == VCODE_OP_HEAP_RESTORE)
+            continue;
+
+         eval_insn_t *insn = &(code->insns[code->ninsns++]);
+         insn->kind   = EVAL_I_GENERIC;
+         insn->op     = j;
+         insn->block  = i;
+         insn->result = vcode_get_result(j);
+
+         const int nargs = vcode_count_args(j);
+         for (int k = 0; k < MIN(nargs, 2); k++)
+            insn->args[k] = vcode_get_arg(j, k);
+
+         switch (kind) {
+         case VCODE_OP_CONST:
+            insn->kind  = EVAL_I_CONST;
+            insn->value = vcode_get_value(j);
+            break;
+         case VCODE_OP_ADD:
+            insn->kind = EVAL_I_ADD;
+            break;
+         case VCODE_OP_SUB:
+            insn->kind = EVAL_I_SUB;
+            break;
+         case VCODE_OP_MUL:
+            insn->kind = EVAL_I_MUL;
+            break;
+         case VCODE_OP_ADDI:
+            insn->kind  = EVAL_I_ADDI;
+            insn->value = vcode_get_value(j);
+            break;
+         case VCODE_OP_CMP:
+            insn->kind  = EVAL_I_CMP;
+            insn->value = vcode_get_cmp(j);
+            break;
+         case VCODE_OP_NOT:
+            insn->kind = EVAL_I_NOT;
+            break;
+         case VCODE_OP_AND:
+            insn->kind = EVAL_I_AND;
+            break;
+         case VCODE_OP_OR:
+            insn->kind = EVAL_I_OR;
+            break;
+         case VCODE_OP_SELECT:
+            insn->kind  = EVAL_I_SELECT;
+            insn->value = vcode_get_arg(j, 2);
+            break;
+         case VCODE_OP_CAST:
+            {
+               const vtype_kind_t to = vtype_kind(vcode_get_type(j));
+               if (to == VCODE_TYPE_INT || to == VCODE_TYPE_OFFSET)
+                  insn->kind = EVAL_I_CAST;
+            }
+            break;
+         case VCODE_OP_BOUNDS:
+            {
+               vcode_type_t bounds = vcode_get_type(j);
+               insn->kind  = EVAL_I_BOUNDS;
+               insn->value = vtype_low(bounds);
+               insn->high  = vtype_high(bounds);
+            }
+            break;
+         case VCODE_OP_LOAD:
+         case VCODE_OP_STORE:
+            {
+               // Only variables in the frame of this unit are accessed
+               // directly: others may need the parent context created
+               vcode_var_t var = vcode_get_address(j);
+               if (vcode_var_context(var) == depth && !vcode_var_use_heap(var)) {
+                  insn->kind  = kind == VCODE_OP_LOAD ? EVAL_I_LOAD : EVAL_I_STORE;
+                  insn->value = vcode_var_index(var);
+               }
+            }
+            break;
+         case VCODE_OP_LOAD_INDIRECT:
+            insn->kind = EVAL_I_LOAD_INDIRECT;
+            break;
+         case VCODE_OP_STORE_INDIRECT:
+            insn->kind = EVAL_I_STORE_INDIRECT;
+            break;
+         case VCODE_OP_DEBUG_INFO:
+            insn->kind = EVAL_I_DEBUG_INFO;
+            insn->loc  = *vcode_get_loc(j);
+            break;
+         case VCODE_OP_JUMP:
+            insn->kind  = EVAL_I_JUMP;
+            insn->value = vcode_get_target(j, 0);
+            break;
+         case VCODE_OP_COND:
+            insn->kind  = EVAL_I_COND;
+            insn->value = vcode_get_target(j, 0);
+            insn->high  = vcode_get_target(j, 1);
+            break;
+         case VCODE_OP_CASE:
+            insn->kind = EVAL_I_CASE;
+            break;
+         case VCODE_OP_RETURN:
+            insn->kind = EVAL_I_RETURN;
+            if (nargs == 0)
+               insn->args[0] = VCODE_INVALID_REG;
+            break;
+         default:
+            break;
+         }
+      }
+   }
+
+   // Branch targets are block numbers until every block has been placed
+   for (unsigned i = 0; i < code->ninsns; i++) {
+      eval_insn_t *insn = &(code->insns[i]);
+      if (insn->kind == EVAL_I_JUMP)
+         insn->value = code->blocks[insn->value];
+      else if (insn->kind == EVAL_I_COND) {
+         insn->value = code->blocks[insn->value];
+         insn->high  = code->blocks[insn->high];
       }
    }
+
+   return code;
+}
+
+static void eval_free_code(eval_code_t *code)
+{
+   free(code->insns);
+   free(code->blocks);
+   free(code);
+}
+
+static eval_code_t *eval_get_code(bool *owned)
+{
+   // Translated code for registered units is kept so functions called
+   // many times are only translated once
+
+   const uint32_t serial = vcode_unit_serial();
+   const void *key = (void *)(uintptr_t)serial;
+
+   *owned = (serial == 0);
+
+   eval_code_t *code = NULL;
+   if (serial != 0 && code_cache != NULL
+       && (code = hash_get(code_cache, key)))
+      return code;
+
+   vcode_state_t vcode_state;
+   vcode_state_save(&vcode_state);
+   code = eval_translate();
+   vcode_state_restore(&vcode_state);
+
+   if (serial != 0) {
+      if (code_cache == NULL)
+         code_cache = hash_new(256, true);
+      hash_put(code_cache, key, code);
+   }
+
+   return code;
+}
+
+static bool eval_enter_block(eval_state_t *state)
+{
+   if (++(state->iterations) >= ITER_LIMIT) {
+      EVAL_WARN(state->fcall, "iteration limit reached while evaluating %s",
+                istr(tree_ident(state->fcall)));
+      state->failed = true;
+      return false;
+   }
+
+   return true;
+}
+
+static void eval_vcode(eval_state_t *state)
+{
+   static void *dispatch[] = {
+      [EVAL_I_GENERIC]        = &&generic,
+      [EVAL_I_CONST]          = &&const_op,
+      [EVAL_I_ADD]            = &&add,
+      [EVAL_I_SUB]            = &&sub,
+      [EVAL_I_MUL]            = &&mul,
+      [EVAL_I_ADDI]           = &&addi,
+      [EVAL_I_CMP]            = &&cmp,
+      [EVAL_I_NOT]            = &&not_op,
+      [EVAL_I_AND]            = &&and_op,
+      [EVAL_I_OR]             = &&or_op,
+      [EVAL_I_SELECT]         = &&select,
+      [EVAL_I_CAST]           = &&cast,
+      [EVAL_I_BOUNDS]         = &&bounds,
+      [EVAL_I_LOAD]           = &&load,
+      [EVAL_I_STORE]          = &&store,
+      [EVAL_I_LOAD_INDIRECT]  = &&load_indirect,
+      [EVAL_I_STORE_INDIRECT] = &&store_indirect,
+      [EVAL_I_DEBUG_INFO]     = &&debug_info,
+      [EVAL_I_JUMP]           = &&jump,
+      [EVAL_I_COND]           = &&cond,
+      [EVAL_I_CASE]           = &&case_op,
+      [EVAL_I_RETURN]         = &&return_op
+   };
+
+   if (!eval_enter_block(state))
+      return;
+
+   bool owned;
+   eval_code_t *code = eval_get_code(&owned);
+
+   value_t *regs = state->context->regs;
+   value_t *vars = state->context->vars;
+
+   // The vcode block is only selected when an instruction needs to be
+   // executed by the generic op handlers
+   vcode_block_t block = vcode_active_block();
+   const eval_insn_t *ip = &(code->insns[code->blocks[block]]);
+
+#define DISPATCH() goto *dispatch[ip->kind]
+#define NEXT() do { ip++; DISPATCH(); } while (0)
+#define BRANCH(pc) do {                        \
+      if (!eval_enter_block(state))            \
+         goto out;                             \
+      ip = &(code->insns[(pc)]);               \
+      DISPATCH();                              \
+   } while (0)
+
+   DISPATCH();
+
+ generic:
+   if (ip->block != block)
+      vcode_select_block((block = ip->block));
+   eval_op(ip->op, state);
+   if (state->failed)
+      goto out;
+   NEXT();
+
+ const_op:
+   regs[ip->result].kind    = VALUE_INTEGER;
+   regs[ip->result].integer = ip->value;
+   NEXT();
+
+ add:
+   if (regs[ip->args[0]].kind != VALUE_INTEGER)
+      goto generic;
+   regs[ip->result].kind    = VALUE_INTEGER;
+   regs[ip->result].integer =
+      regs[ip->args[0]].integer + regs[ip->args[1]].integer;
+   NEXT();
+
+ sub:
+   if (regs[ip->args[0]].kind != VALUE_INTEGER)
+      goto generic;
+   regs[ip->result].kind    = VALUE_INTEGER;
+   regs[ip->result].integer =
+      regs[ip->args[0]].integer - regs[ip->args[1]].integer;
+   NEXT();
+
+ mul:
+   if (regs[ip->args[0]].kind != VALUE_INTEGER)
+      goto generic;
+   regs[ip->result].kind    = VALUE_INTEGER;
+   regs[ip->result].integer =
+      regs[ip->args[0]].integer * regs[ip->args[1]].integer;
+   NEXT();
+
+ addi:
+   if (regs[ip->args[0]].kind != VALUE_INTEGER)
+      goto generic;
+   regs[ip->result].kind    = VALUE_INTEGER;
+   regs[ip->result].integer = regs[ip->args[0]].integer + ip->value;
+   NEXT();
+
+ cmp:
+   {
+      const value_t *lhs = &(regs[ip->args[0]]);
+      const value_t *rhs = &(regs[ip->args[1]]);
+      if (lhs->kind != VALUE_INTEGER || rhs->kind != VALUE_INTEGER)
+         goto generic;
+
+      bool result = false;
+      switch (ip->value) {
+      case VCODE_CMP_EQ:  result = lhs->integer == rhs->integer; break;
+      case VCODE_CMP_NEQ: result = lhs->integer != rhs->integer; break;
+      case VCODE_CMP_GT:  result = lhs->integer > rhs->integer; break;
+      case VCODE_CMP_GEQ: result = lhs->integer >= rhs->integer; break;
+      case VCODE_CMP_LT:  result = lhs->integer < rhs->integer; break;
+      case VCODE_CMP_LEQ: result = lhs->integer <= rhs->integer; break;
+      default: goto generic;
+      }
+
+      regs[ip->result].kind    = VALUE_INTEGER;
+      regs[ip->result].integer = result;
+   }
+   NEXT();
+
+ not_op:
+   regs[ip->result].kind    = VALUE_INTEGER;
+   regs[ip->result].integer = !(regs[ip->args[0]].integer);
+   NEXT();
+
+ and_op:
+   if (regs[ip->args[0]].kind != VALUE_INTEGER)
+      goto generic;
+   regs[ip->result].kind    = VALUE_INTEGER;
+   regs[ip->result].integer =
+      regs[ip->args[0]].integer & regs[ip->args[1]].integer;
+   NEXT();
+
+ or_op:
+   if (regs[ip->args[0]].kind != VALUE_INTEGER)
+      goto generic;
+   regs[ip->result].kind    = VALUE_INTEGER;
+   regs[ip->result].integer =
+      regs[ip->args[0]].integer | regs[ip->args[1]].integer;
+   NEXT();
+
+ select:
+   if (regs[ip->args[0]].kind != VALUE_INTEGER)
+      goto generic;
+   regs[ip->result] = regs[ip->args[0]].integer
+      ? regs[ip->args[1]] : regs[ip->value];
+   NEXT();
+
+ cast:
+   if (regs[ip->args[0]].kind != VALUE_INTEGER)
+      goto generic;
+   regs[ip->result].kind    = VALUE_INTEGER;
+   regs[ip->result].integer = regs[ip->args[0]].integer;
+   NEXT();
+
+ bounds:
+   {
+      const value_t *reg = &(regs[ip->args[0]]);
+      if (reg->kind != VALUE_INTEGER || ip->value > ip->high)
+         goto generic;
+      else if (reg->integer < ip->value || reg->integer > ip->high)
+         goto generic;
+   }
+   NEXT();
+
+ load:
+   EVAL_ASSERT_VALID(ip->op, &(vars[ip->value]));
+   regs[ip->result] = vars[ip->value];
+   NEXT();
+
+ store:
+   vars[ip->value] = regs[ip->args[0]];
+   NEXT();
+
+ load_indirect:
+   {
+      const value_t *src = &(regs[ip->args[0]]);
+      if (src->kind != VALUE_POINTER || src->pointer->kind == VALUE_INVALID)
+         goto generic;
+      regs[ip->result] = *(src->pointer);
+   }
+   NEXT();
+
+ store_indirect:
+   {
+      const value_t *dst = &(regs[ip->args[1]]);
+      const value_t *src = &(regs[ip->args[0]]);
+      if (dst->kind != VALUE_POINTER || src->kind == VALUE_RECORD)
+         goto generic;
+      *(dst->pointer) = *src;
+   }
+   NEXT();
+
+ debug_info:
+   state->last_loc = ip->loc;
+   NEXT();
+
+ jump:
+   BRANCH(ip->value);
+
+ cond:
+   BRANCH(regs[ip->args[0]].integer ? ip->value : ip->high);
+
+ case_op:
+   if (ip->block != block)
+      vcode_select_block((block = ip->block));
+   BRANCH(code->blocks[eval_case_target(ip->op, state)]);
+
+ return_op:
+   if (ip->args[0] != VCODE_INVALID_REG)
+      state->result = ip->args[0];
+
+ out:
+   if (owned)
+      eval_free_code(code);
+
+#undef BRANCH
+#undef NEXT
+#undef DISPATCH
 }
 
 static tree_t eval_value_to_tree(value_t *value, type_t type, const loc_t *loc)
@@ -2271,3 +3011,35 @@ void reset_eval_errors(void)
 {
    errors = 0;
 }
+
+void eval_memo_stats(unsigned *hits, unsigned *misses)
+{
+   *hits   = memo_hits;
+   *misses = memo_misses;
+}
+
+void eval_free_code_cache(void)
+{
+   if (code_cache == NULL)
+      return;
+
+   hash_iter_t it = HASH_BEGIN;
+   const void *key;
+   void *value;
+   while (hash_iter(code_cache, &it, &key, &value))
+      eval_free_code(value);
+
+   hash_free(code_cache);
+   code_cache = NULL;
+}
+
+unsigned eval_code_cache_size(void)
+{
+   return code_cache == NULL ? 0 : hash_members(code_cache);
+}
+
+void eval_set_native_fns(eval_find_fn_t find, eval_call_fn_t call)
+{
+   native_find = find;
+   native_call = call;
+}
@@ -17,7 +17,9 @@
 
 #include "util.h"
 #include "fbuf.h"
+#include "mem.h"
 #include "fastlz.h"
+#include "lz4.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -27,26 +29,89 @@
 #include <fcntl.h>
 #include <unistd.h>
 
-#define SPILL_SIZE 65536
-#define BLOCK_SIZE (SPILL_SIZE - (SPILL_SIZE / 16))
+#if defined HAVE_PTHREAD && !defined __MINGW32__
+#define FBUF_THREADS 1
+#include <pthread.h>
+#else
+#define FBUF_THREADS 0
+#endif
+
+// Files start with a header naming the codec and the largest amount of
+// data in a block followed by the compressed blocks each prefixed with
+// its length. Files written before the header was added have no header
+// and are all FastLZ with 64k blocks: the first byte of the length of
+// their first block is always zero so can never be confused with the
+// magic number.
+
+#define FBUF_MAGIC    "NVCF"
+#define FBUF_VERSION  1
+#define HEADER_SIZE   12
+
+#define LEGACY_SPILL  65536
+#define LEGACY_BLOCK  (LEGACY_SPILL - (LEGACY_SPILL / 16))
+
+#define MIN_BLOCK     4096
+#define MAX_BLOCK     (16 * 1024 * 1024)
+#define DEFAULT_BLOCK (256 * 1024)
+#define MAX_THREADS   4
+
+typedef struct fbuf_job fbuf_job_t;
+typedef struct fbuf_map fbuf_map_t;
+
+// A full block waiting to be compressed by the thread pool. Blocks are
+// written to the file by the thread which owns the fbuf in the order
+// they were filled.
+struct fbuf_job {
+   fbuf_job_t *next;
+   fbuf_cs_t   codec;
+   uint8_t    *in;
+   size_t      inlen;
+   uint8_t    *out;
+   size_t      outsz;
+   int         outlen;
+   bool        done;
+};
+
+// A file mapping shared by a file opened for reading and any parts split
+// from it so every process reading the same library file shares the
+// pages through the page cache
+struct fbuf_map {
+   void     *base;
+   size_t    len;
+   unsigned  refs;
+};
 
 struct fbuf {
    fbuf_mode_t  mode;
    char        *fname;
    FILE        *file;
+   fbuf_cs_t    codec;
+   size_t       block;
    uint8_t     *wbuf;
    size_t       wpend;
+   uint8_t     *cbuf;
+   size_t       cbufsz;
    uint8_t     *rbuf;
+   uint8_t     *rspill;
+   size_t       rspillsz;
    size_t       rptr;
    size_t       ravail;
    size_t       roff;
+   size_t       rstart;
    uint8_t     *rmap;
    size_t       maplen;
+   fbuf_map_t  *map;
+   fbuf_job_t  *jobs;
+   unsigned     njobs;
+   unsigned     jhead;
+   unsigned     jpending;
    fbuf_t      *next;
    fbuf_t      *prev;
 };
 
-static fbuf_t *open_list = NULL;
+static fbuf_t    *open_list = NULL;
+static fbuf_cs_t  default_codec = FBUF_CS_LZ4;
+static size_t     default_block = DEFAULT_BLOCK;
 
 void fbuf_cleanup(void)
 {
@@ -58,6 +123,94 @@ void fbuf_cleanup(void)
    }
 }
 
+void fbuf_set_codec(fbuf_cs_t codec)
+{
+   default_codec = codec;
+}
+
+void fbuf_set_block_size(size_t block_size)
+{
+   if (block_size < MIN_BLOCK || block_size > MAX_BLOCK)
+      fatal("block size %zu is not between %d and %d bytes",
+            block_size, MIN_BLOCK, MAX_BLOCK);
+
+   default_block = block_size;
+}
+
+static uint32_t fbuf_get_be32(const uint8_t *p)
+{
+   return (uint32_t)(p[0] << 24)
+      | (uint32_t)(p[1] << 16)
+      | (uint32_t)(p[2] << 8)
+      | (uint32_t)p[3];
+}
+
+static void fbuf_put_be32(uint8_t *p, uint32_t u)
+{
+   p[0] = (u >> 24) & 0xff;
+   p[1] = (u >> 16) & 0xff;
+   p[2] = (u >> 8) & 0xff;
+   p[3] = u & 0xff;
+}
+
+static size_t fbuf_compress_bound(fbuf_cs_t codec, size_t len)
+{
+   switch (codec) {
+   case FBUF_CS_FASTLZ:
+      // FastLZ may expand the input by up to 5%
+      return MAX(len + len / 16, 66);
+   case FBUF_CS_LZ4:
+      return LZ4_compressBound(len);
+   case FBUF_CS_NONE:
+   default:
+      return len;
+   }
+}
+
+static void fbuf_alloc_read(fbuf_t *f)
+{
+   // Leave space for the bytes remaining from the previous block
+   f->rspillsz = f->block + (f->block / 16);
+   f->rspill   = xmalloc(f->rspillsz);
+   f->rbuf     = f->rspill;
+   f->rptr     = 0;
+   f->ravail   = 0;
+}
+
+static void fbuf_read_header(fbuf_t *f)
+{
+   if (f->maplen >= HEADER_SIZE && memcmp(f->rmap, FBUF_MAGIC, 4) == 0) {
+      if (f->rmap[4] != FBUF_VERSION)
+         fatal("file %s was written by an incompatible version of "
+               PACKAGE_NAME, f->fname);
+
+      f->codec = f->rmap[5];
+      f->block = fbuf_get_be32(f->rmap + 8);
+
+      if (f->codec > FBUF_CS_LZ4 || f->block < MIN_BLOCK
+          || f->block > MAX_BLOCK)
+         fatal("file %s has invalid compression format", f->fname);
+
+      f->rstart = HEADER_SIZE;
+   }
+   else {
+      f->codec  = FBUF_CS_FASTLZ;
+      f->block  = LEGACY_BLOCK;
+      f->rstart = 0;
+   }
+}
+
+static void fbuf_write_header(fbuf_t *f)
+{
+   uint8_t header[HEADER_SIZE] = FBUF_MAGIC;
+   header[4] = FBUF_VERSION;
+   header[5] = f->codec;
+   fbuf_put_be32(header + 8, f->block);
+
+   if (fwrite(header, HEADER_SIZE, 1, f->file) != 1)
+      fatal("fwrite failed");
+}
+
 fbuf_t *fbuf_open(const char *file, fbuf_mode_t mode)
 {
    fbuf_t *f = NULL;
@@ -69,13 +222,17 @@ fbuf_t *fbuf_open(const char *file, fbuf_mode_t mode)
          if (h == NULL)
             return NULL;
 
-         f = xmalloc(sizeof(struct fbuf));
+         f = xcalloc(sizeof(struct fbuf));
 
-         f->file  = h;
-         f->rmap  = NULL;
-         f->rbuf  = NULL;
-         f->wbuf  = xmalloc(SPILL_SIZE);
-         f->wpend = 0;
+         f->file   = h;
+         f->fname  = strdup(file);
+         f->codec  = default_codec;
+         f->block  = default_block;
+         f->wbuf   = xmalloc(f->block);
+         f->cbufsz = fbuf_compress_bound(f->codec, f->block);
+         f->cbuf   = xmalloc(f->cbufsz);
+
+         fbuf_write_header(f);
       }
       break;
 
@@ -93,21 +250,25 @@ fbuf_t *fbuf_open(const char *file, fbuf_mode_t mode)
 
          close(fd);
 
-         f = xmalloc(sizeof(struct fbuf));
+         f = xcalloc(sizeof(struct fbuf));
+
+         f->map = xmalloc(sizeof(fbuf_map_t));
+         f->map->base = rmap;
+         f->map->len  = buf.st_size;
+         f->map->refs = 1;
 
-         f->file   = NULL;
          f->rmap   = rmap;
-         f->rbuf   = xmalloc(SPILL_SIZE);
-         f->rptr   = 0;
-         f->roff   = 0;
-         f->ravail = 0;
          f->maplen = buf.st_size;
-         f->wbuf   = NULL;
+         f->fname  = strdup(file);
+
+         fbuf_read_header(f);
+         fbuf_alloc_read(f);
+
+         f->roff = f->rstart;
       }
       break;
    }
 
-   f->fname = strdup(file);
    f->mode  = mode;
    f->next  = open_list;
    f->prev  = NULL;
@@ -118,38 +279,256 @@ fbuf_t *fbuf_open(const char *file, fbuf_mode_t mode)
    return (open_list = f);
 }
 
+fbuf_t *fbuf_split(fbuf_t *f)
+{
+   // Anything left in the current block is padding so reading resumes
+   // at the start of the next block
+   assert(f->mode == FBUF_IN);
+
+   fbuf_t *split = xcalloc(sizeof(struct fbuf));
+
+   // Library files are only ever replaced by renaming a new file over
+   // them so the rest of the mapping stays valid after the original is
+   // closed
+   split->maplen = f->maplen - f->roff;
+   split->rmap   = f->rmap + f->roff;
+   split->map    = f->map;
+   split->codec  = f->codec;
+   split->block  = f->block;
+   split->fname  = strdup(f->fname);
+   split->mode   = FBUF_IN;
+   split->next   = open_list;
+   split->prev   = NULL;
+
+   split->map->refs++;
+
+   fbuf_alloc_read(split);
+
+   if (open_list != NULL)
+      open_list->prev = split;
+
+   return (open_list = split);
+}
+
 const char *fbuf_file_name(fbuf_t *f)
 {
    return f->fname;
 }
 
+static int fbuf_compress(fbuf_cs_t codec, const uint8_t *in, size_t len,
+                         uint8_t *out, size_t outsz)
+{
+   switch (codec) {
+   case FBUF_CS_FASTLZ:
+      return fastlz_compress_level(2, in, len, out);
+   case FBUF_CS_LZ4:
+      return LZ4_compress_default((const char *)in, (char *)out, len, outsz);
+   case FBUF_CS_NONE:
+   default:
+      assert(len <= outsz);
+      memcpy(out, in, len);
+      return len;
+   }
+}
+
+static void fbuf_write_block(fbuf_t *f, const uint8_t *data, int len)
+{
+   assert((len > 0) && (len <= (int)f->cbufsz));
+
+   uint8_t blksz[4];
+   fbuf_put_be32(blksz, len);
+
+   if (fwrite(blksz, 4, 1, f->file) != 1)
+      fatal("fwrite failed");
+
+   if (fwrite(data, len, 1, f->file) != 1)
+      fatal("fwrite failed");
+}
+
+#if FBUF_THREADS
+
+static pthread_mutex_t  pool_lock;
+static pthread_cond_t   pool_work_cv;
+static pthread_cond_t   pool_done_cv;
+static fbuf_job_t      *pool_queue = NULL;
+static fbuf_job_t      *pool_tail = NULL;
+static pid_t            pool_pid = 0;
+static unsigned         pool_threads = 0;
+
+static void *fbuf_worker_thread(void *arg)
+{
+   for (;;) {
+      pthread_mutex_lock(&pool_lock);
+      while (pool_queue == NULL)
+         pthread_cond_wait(&pool_work_cv, &pool_lock);
+
+      fbuf_job_t *job = pool_queue;
+      if ((pool_queue = job->next) == NULL)
+         pool_tail = NULL;
+      pthread_mutex_unlock(&pool_lock);
+
+      const int ret = fbuf_compress(job->codec, job->in, job->inlen,
+                                    job->out, job->outsz);
+
+      pthread_mutex_lock(&pool_lock);
+      job->outlen = ret;
+      job->done   = true;
+      pthread_cond_broadcast(&pool_done_cv);
+      pthread_mutex_unlock(&pool_lock);
+   }
+
+   return NULL;
+}
+
+static bool fbuf_pool_start(void)
+{
+   // The pool is started the first time a file fills a block and again
+   // in a child process after fork as only the calling thread survives
+   if (pool_pid == getpid())
+      return pool_threads > 0;
+
+   pool_pid     = getpid();
+   pool_queue   = NULL;
+   pool_tail    = NULL;
+   pool_threads = 0;
+
+   const long nprocs = sysconf(_SC_NPROCESSORS_ONLN);
+   if (nprocs < 2)
+      return false;
+
+   pthread_mutex_init(&pool_lock, NULL);
+   pthread_cond_init(&pool_work_cv, NULL);
+   pthread_cond_init(&pool_done_cv, NULL);
+
+   const unsigned nthreads = MIN(nprocs - 1, MAX_THREADS);
+   for (unsigned i = 0; i < nthreads; i++) {
+      pthread_t thread;
+      if (pthread_create(&thread, NULL, fbuf_worker_thread, NULL))
+         break;
+
+      pthread_detach(thread);
+      pool_threads++;
+   }
+
+   return pool_threads > 0;
+}
+
+static void fbuf_retire_job(fbuf_t *f)
+{
+   assert(f->jpending > 0);
+   fbuf_job_t *job = &(f->jobs[f->jhead]);
+
+   pthread_mutex_lock(&pool_lock);
+   while (!job->done)
+      pthread_cond_wait(&pool_done_cv, &pool_lock);
+   pthread_mutex_unlock(&pool_lock);
+
+   fbuf_write_block(f, job->out, job->outlen);
+
+   f->jhead = (f->jhead + 1) % f->njobs;
+   f->jpending--;
+}
+
+static void fbuf_submit_job(fbuf_t *f)
+{
+   if (f->jobs == NULL) {
+      // Enough blocks in flight to keep every thread busy while the
+      // oldest is written out
+      f->njobs = pool_threads * 2;
+      f->jobs  = xcalloc(f->njobs * sizeof(fbuf_job_t));
+      for (unsigned i = 0; i < f->njobs; i++) {
+         f->jobs[i].codec = f->codec;
+         f->jobs[i].in    = xmalloc(f->block);
+         f->jobs[i].outsz = f->cbufsz;
+         f->jobs[i].out   = xmalloc(f->cbufsz);
+      }
+   }
+
+   if (f->jpending == f->njobs)
+      fbuf_retire_job(f);
+
+   fbuf_job_t *job = &(f->jobs[(f->jhead + f->jpending) % f->njobs]);
+
+   // The filled buffer is handed to the job in exchange for its free one
+   uint8_t *tmp = job->in;
+   job->in    = f->wbuf;
+   job->inlen = f->wpend;
+   job->done  = false;
+   job->next  = NULL;
+   f->wbuf    = tmp;
+
+   pthread_mutex_lock(&pool_lock);
+   if (pool_tail == NULL)
+      pool_queue = pool_tail = job;
+   else
+      pool_tail = (pool_tail->next = job);
+   pthread_cond_signal(&pool_work_cv);
+   pthread_mutex_unlock(&pool_lock);
+
+   f->jpending++;
+}
+
+static void fbuf_drain_jobs(fbuf_t *f)
+{
+   while (f->jpending > 0)
+      fbuf_retire_job(f);
+}
+
+static void fbuf_free_jobs(fbuf_t *f)
+{
+   for (unsigned i = 0; i < f->njobs; i++) {
+      free(f->jobs[i].in);
+      free(f->jobs[i].out);
+   }
+   free(f->jobs);
+}
+
+#else  // FBUF_THREADS
+
+static void fbuf_drain_jobs(fbuf_t *f)
+{
+   assert(f->jpending == 0);
+}
+
+static void fbuf_free_jobs(fbuf_t *f)
+{
+   assert(f->jobs == NULL);
+}
+
+#endif  // FBUF_THREADS
+
 static void fbuf_maybe_flush(fbuf_t *f, size_t more, bool finish)
 {
-   assert(more <= BLOCK_SIZE);
-   if (f->wpend + more > BLOCK_SIZE) {
-      if (f->wpend < 16) {
+   assert(more <= f->block);
+   if (f->wpend + more > f->block) {
+      if (f->wpend < 16 && f->codec == FBUF_CS_FASTLZ) {
          // Write dummy bytes at end to meet fastlz block size requirement
          assert(finish);
          f->wpend = 16;
       }
 
-      uint8_t out[SPILL_SIZE];
-      const int ret = fastlz_compress_level(2, f->wbuf, f->wpend, out);
-
-      assert((ret > 0) && (ret < SPILL_SIZE));
-
-      const uint8_t blksz[4] = {
-         (ret >> 24) & 0xff,
-         (ret >> 16) & 0xff,
-         (ret >> 8) & 0xff,
-         ret & 0xff
-      };
+#if FBUF_THREADS
+      // Full blocks are compressed in the background but the last block
+      // before an offset is taken or the file is closed is compressed
+      // here as the caller must wait for it anyway. Close to the memory
+      // budget each block is written out before the next is filled.
+      if (!finish && f->codec != FBUF_CS_NONE && !mem_constrained()
+          && fbuf_pool_start()) {
+         fbuf_submit_job(f);
+         f->wpend = 0;
+         return;
+      }
+#endif
 
-      if (fwrite(blksz, 4, 1, f->file) != 1)
-         fatal("fwrite failed");
+      fbuf_drain_jobs(f);
 
-      if (fwrite(out, ret, 1, f->file) != 1)
-         fatal("fwrite failed");
+      if (f->codec == FBUF_CS_NONE)
+         fbuf_write_block(f, f->wbuf, f->wpend);
+      else {
+         const int ret = fbuf_compress(f->codec, f->wbuf, f->wpend,
+                                       f->cbuf, f->cbufsz);
+         fbuf_write_block(f, f->cbuf, ret);
+      }
 
       f->wpend = 0;
    }
@@ -157,20 +536,17 @@ static void fbuf_maybe_flush(fbuf_t *f, size_t more, bool finish)
 
 static void fbuf_maybe_read(fbuf_t *f, size_t more)
 {
-   assert(more <= BLOCK_SIZE);
+   assert(more <= f->block);
    if (f->rptr + more > f->ravail) {
       const size_t overlap = f->ravail - f->rptr;
-      memcpy(f->rbuf, f->rbuf + f->rptr, overlap);
+      memmove(f->rspill, f->rbuf + f->rptr, overlap);
 
-      const uint8_t *blksz_raw = f->rmap + f->roff;
+      if (f->roff + sizeof(uint32_t) > f->maplen)
+         fatal_trace("read past end of compressed file %s", f->fname);
 
-      const uint32_t blksz =
-         (uint32_t)(blksz_raw[0] << 24)
-         | (uint32_t)(blksz_raw[1] << 16)
-         | (uint32_t)(blksz_raw[2] << 8)
-         | (uint32_t)blksz_raw[3];
+      const uint32_t blksz = fbuf_get_be32(f->rmap + f->roff);
 
-      if (blksz > SPILL_SIZE)
+      if (blksz > fbuf_compress_bound(f->codec, f->block))
          fatal("file %s has invalid compression format", f->fname);
 
       f->roff += sizeof(uint32_t);
@@ -178,30 +554,107 @@ static void fbuf_maybe_read(fbuf_t *f, size_t more)
       if (f->roff + blksz > f->maplen)
          fatal_trace("read past end of compressed file %s", f->fname);
 
-      const int ret = fastlz_decompress(f->rmap + f->roff,
-                                        blksz,
-                                        f->rbuf + overlap,
-                                        SPILL_SIZE - overlap);
+      const uint8_t *in = f->rmap + f->roff;
+      const size_t space = f->rspillsz - overlap;
+      int ret = 0;
+      switch (f->codec) {
+      case FBUF_CS_FASTLZ:
+         ret = fastlz_decompress(in, blksz, f->rspill + overlap, space);
+         break;
+      case FBUF_CS_LZ4:
+         ret = LZ4_decompress_safe((const char *)in,
+                                   (char *)f->rspill + overlap,
+                                   blksz, space);
+         break;
+      case FBUF_CS_NONE:
+         if (overlap == 0) {
+            // Read directly from the mapped file
+            f->rbuf   = (uint8_t *)in;
+            f->roff  += blksz;
+            f->ravail = blksz;
+            f->rptr   = 0;
+            return;
+         }
+         else if (blksz <= space) {
+            memcpy(f->rspill + overlap, in, blksz);
+            ret = blksz;
+         }
+         break;
+      }
 
-      if (ret == 0)
+      if (ret <= 0)
          fatal("file %s has invalid compression format", f->fname);
 
+      f->rbuf   = f->rspill;
       f->roff  += blksz;
       f->ravail = overlap + ret;
       f->rptr   = 0;
    }
 }
 
+size_t fbuf_tell(fbuf_t *f)
+{
+   // Flush any pending output so the next write starts a new block
+   // whose offset can be passed to fbuf_seek when reading
+   assert(f->mode == FBUF_OUT);
+
+   if (f->wpend > 0)
+      fbuf_maybe_flush(f, f->block, true);
+
+   fbuf_drain_jobs(f);
+
+   const long pos = ftell(f->file);
+   if (pos < 0)
+      fatal_errno("ftell");
+
+   return pos;
+}
+
+void fbuf_seek(fbuf_t *f, size_t offset)
+{
+   assert(f->mode == FBUF_IN);
+
+   if (offset >= f->maplen)
+      fatal_trace("seek past end of compressed file %s", f->fname);
+
+   f->roff   = offset;
+   f->rptr   = 0;
+   f->ravail = 0;
+}
+
+size_t fbuf_last_block(fbuf_t *f)
+{
+   // Only the block headers need to be read to find the last one
+   assert(f->mode == FBUF_IN);
+
+   size_t offset = f->rstart, last = f->rstart;
+   while (offset + sizeof(uint32_t) <= f->maplen) {
+      last = offset;
+      offset += sizeof(uint32_t) + fbuf_get_be32(f->rmap + offset);
+   }
+
+   if (offset != f->maplen)
+      fatal("file %s has invalid compression format", f->fname);
+
+   return last;
+}
+
 void fbuf_close(fbuf_t *f)
 {
-   if (f->rmap != NULL) {
-      unmap_file((void *)f->rmap, f->maplen);
-      free(f->rbuf);
+   if (f->map != NULL) {
+      if (--(f->map->refs) == 0) {
+         unmap_file(f->map->base, f->map->len);
+         free(f->map);
+      }
+      free(f->rspill);
    }
 
    if (f->wbuf != NULL) {
-      fbuf_maybe_flush(f, BLOCK_SIZE, true);
+      fbuf_maybe_flush(f, f->block, true);
+      fbuf_drain_jobs(f);
+      fbuf_free_jobs(f);
       free(f->wbuf);
+      free(f->cbuf);
    }
 
    if (f->file != NULL)
@@ -258,11 +711,32 @@ void write_u8(uint8_t u, fbuf_t *f)
    *(f->wbuf + f->wpend++) = u;
 }
 
+void write_uint(uint64_t u, fbuf_t *f)
+{
+   // Seven bits per byte with the top bit set on all but the last
+   fbuf_maybe_flush(f, 10, false);
+   do {
+      uint8_t byte = u & 0x7f;
+      u >>= 7;
+      if (u != 0)
+         byte |= 0x80;
+      *(f->wbuf + f->wpend++) = byte;
+   } while (u != 0);
+}
+
 void write_raw(const void *buf, size_t len, fbuf_t *f)
 {
-   fbuf_maybe_flush(f, len, false);
-   memcpy(f->wbuf + f->wpend, buf, len);
-   f->wpend += len;
+   // Anything larger than a block is split at block boundaries and
+   // read_raw must use the same chunks
+   const uint8_t *p = buf;
+   while (len > 0) {
+      const size_t chunk = MIN(len, f->block);
+      fbuf_maybe_flush(f, chunk, false);
+      memcpy(f->wbuf + f->wpend, p, chunk);
+      f->wpend += chunk;
+      p += chunk;
+      len -= chunk;
+   }
 }
 
 void write_double(double d, fbuf_t *f)
@@ -300,6 +774,21 @@ uint8_t read_u8(fbuf_t *f)
    return *(f->rbuf + f->rptr++);
 }
 
+uint64_t read_uint(fbuf_t *f)
+{
+   uint64_t val = 0;
+   uint8_t byte;
+   int shift = 0;
+   do {
+      fbuf_maybe_read(f, 1);
+      byte = *(f->rbuf + f->rptr++);
+      val |= (uint64_t)(byte & 0x7f) << shift;
+      shift += 7;
+   } while (byte & 0x80);
+
+   return val;
+}
+
 uint64_t read_u64(fbuf_t *f)
 {
    fbuf_maybe_read(f, 8);
@@ -318,9 +807,15 @@ uint64_t read_u64(fbuf_t *f)
 
 void read_raw(void *buf, size_t len, fbuf_t *f)
 {
-   fbuf_maybe_read(f, len);
-   memcpy(buf, f->rbuf + f->rptr, len);
-   f->rptr += len;
+   uint8_t *p = buf;
+   while (len > 0) {
+      const size_t chunk = MIN(len, f->block);
+      fbuf_maybe_read(f, chunk);
+      memcpy(p, f->rbuf + f->rptr, chunk);
+      f->rptr += chunk;
+      p += chunk;
+      len -= chunk;
+   }
 }
 
 double read_double(fbuf_t *f)
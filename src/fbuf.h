@@ -31,15 +31,36 @@ typedef enum {
    FBUF_OUT,
 } fbuf_mode_t;
 
+typedef enum {
+   FBUF_CS_NONE,
+   FBUF_CS_FASTLZ,
+   FBUF_CS_LZ4
+} fbuf_cs_t;
+
 fbuf_t *fbuf_open(const char *file, fbuf_mode_t mode);
 void fbuf_close(fbuf_t *f);
 void fbuf_cleanup(void);
 const char *fbuf_file_name(fbuf_t *f);
 
+// Codec and largest block of data for files subsequently opened for
+// writing: the reader takes both from the file header
+void fbuf_set_codec(fbuf_cs_t codec);
+void fbuf_set_block_size(size_t block_size);
+
+// Reads the compressed blocks after the current one from the same
+// mapping as the original which stays valid until both are closed
+fbuf_t *fbuf_split(fbuf_t *f);
+
+// Random access to the start of a compressed block
+size_t fbuf_tell(fbuf_t *f);
+void fbuf_seek(fbuf_t *f, size_t offset);
+size_t fbuf_last_block(fbuf_t *f);
+
 void write_u32(uint32_t u, fbuf_t *f);
 void write_u16(uint16_t s, fbuf_t *f);
 void write_u64(uint64_t i, fbuf_t *f);
 void write_u8(uint8_t u, fbuf_t *f);
+void write_uint(uint64_t u, fbuf_t *f);
 void write_raw(const void *buf, size_t len, fbuf_t *f);
 void write_double(double d, fbuf_t *f);
 
@@ -47,6 +68,7 @@ uint32_t read_u32(fbuf_t *f);
 uint16_t read_u16(fbuf_t *f);
 uint64_t read_u64(fbuf_t *f);
 uint8_t read_u8(fbuf_t *f);
+uint64_t read_uint(fbuf_t *f);
 void read_raw(void *buf, size_t len, fbuf_t *f);
 double read_double(fbuf_t *f);
 
@@ -24,60 +24,148 @@
 #include <assert.h>
 #include <stdlib.h>
 
+// Groups are nodes of a treap ordered by first net. Groups never overlap
+// so the group containing a net, or the next group after it, is found in
+// logarithmic time regardless of how many nets the groups span. The
+// priorities come from a fixed sequence so the shape of the tree and
+// hence the time taken is the same on every run.
+
+typedef struct group_node group_node_t;
+
+struct group_node {
+   group_node_t *left;
+   group_node_t *right;
+   uint32_t      prio;
+   groupid_t     gid;
+   netid_t       first;
+   unsigned      length;
+};
+
 typedef struct {
-   group_t   *groups;
-   group_t   *free_list;
-   groupid_t  next_gid;
-   group_t  **lookup;
-   int        nnets;
+   group_node_t *root;
+   group_node_t *free_list;
+   groupid_t     next_gid;
+   unsigned      ngroups;
+   uint32_t      seed;
+   int           nnets;
 } group_nets_ctx_t;
 
 static void group_target(tree_t t, group_nets_ctx_t *ctx);
 
+static void group_split(group_node_t *t, netid_t key,
+                        group_node_t **l, group_node_t **r)
+{
+   // Nodes with first less than key go to the left
+
+   while (t != NULL) {
+      if (t->first < key) {
+         *l = t;
+         l = &(t->right);
+         t = t->right;
+      }
+      else {
+         *r = t;
+         r = &(t->left);
+         t = t->left;
+      }
+   }
+
+   *l = *r = NULL;
+}
+
+static group_node_t *group_merge(group_node_t *l, group_node_t *r)
+{
+   group_node_t *root = NULL, **where = &root;
+
+   while (l != NULL && r != NULL) {
+      if (l->prio > r->prio) {
+         *where = l;
+         where = &(l->right);
+         l = l->right;
+      }
+      else {
+         *where = r;
+         where = &(r->left);
+         r = r->left;
+      }
+   }
+
+   *where = (l != NULL) ? l : r;
+   return root;
+}
+
+static group_node_t *group_find(group_nets_ctx_t *ctx, netid_t first,
+                                unsigned length)
+{
+   // Return the group containing first, or if there is none the first
+   // group starting after it within length nets
+
+   group_node_t *floor = NULL, *ceil = NULL;
+   for (group_node_t *it = ctx->root; it != NULL; ) {
+      if (it->first <= first) {
+         floor = it;
+         it = it->right;
+      }
+      else {
+         ceil = it;
+         it = it->left;
+      }
+   }
+
+   if (floor != NULL && first < floor->first + floor->length)
+      return floor;
+   else if (ceil != NULL && ceil->first < first + length)
+      return ceil;
+   else
+      return NULL;
+}
+
 static groupid_t group_alloc(group_nets_ctx_t *ctx,
                              netid_t first, unsigned length)
 {
-   group_t *g;
+   group_node_t *g;
    if (ctx->free_list != NULL) {
       g = ctx->free_list;
-      ctx->free_list = g->next;
+      ctx->free_list = g->left;
    }
    else
-      g = xmalloc(sizeof(group_t));
+      g = xmalloc(sizeof(group_node_t));
+
+   ctx->seed ^= ctx->seed << 13;
+   ctx->seed ^= ctx->seed >> 17;
+   ctx->seed ^= ctx->seed << 5;
 
-   g->next   = ctx->groups;
+   g->left   = NULL;
+   g->right  = NULL;
+   g->prio   = ctx->seed;
    g->gid    = ctx->next_gid++;
    g->first  = first;
    g->length = length;
 
-   ctx->groups = g;
-
-   for (netid_t i = first; i < first + length; i++)
-      ctx->lookup[i] = g;
+   group_node_t *l, *r;
+   group_split(ctx->root, first, &l, &r);
+   ctx->root = group_merge(group_merge(l, g), r);
+   ctx->ngroups++;
 
    return g->gid;
 }
 
-static void group_unlink(group_nets_ctx_t *ctx, group_t *where)
+static void group_unlink(group_nets_ctx_t *ctx, group_node_t *where)
 {
-   where->gid = GROUPID_INVALID;
+   group_node_t *l, *m, *r;
+   group_split(ctx->root, where->first, &l, &m);
+   group_split(m, where->first + 1, &m, &r);
+   assert(m == where);
 
-   if (where == ctx->groups)
-      ctx->groups = where->next;
-   else {
-      for (group_t *it = ctx->groups; it != NULL; it = it->next) {
-         if (it->next == where) {
-            it->next = where->next;
-            return;
-         }
-      }
-      fatal_trace("unlink group not in list");
-   }
+   ctx->root = group_merge(l, r);
+   ctx->ngroups--;
+
+   where->gid = GROUPID_INVALID;
 }
 
-static void group_reuse(group_nets_ctx_t *ctx, group_t *group)
+static void group_reuse(group_nets_ctx_t *ctx, group_node_t *group)
 {
-   group->next = ctx->free_list;
+   group->left = ctx->free_list;
    ctx->free_list = group;
 }
 
@@ -87,25 +175,25 @@ static groupid_t group_add(group_nets_ctx_t *ctx, netid_t first, int length)
    assert(first < ctx->nnets);
    assert(first + length <= ctx->nnets);
 
-   for (netid_t i = first; i < first + length; i++) {
-      group_t *it = ctx->lookup[i];
-      if (it == NULL || it->gid == GROUPID_INVALID)
-         continue;
+   // The remainder of a range extending past the end of an existing group
+   // is handled by another iteration rather than recursion as it may span
+   // any number of groups
 
-      if ((it->first == first) && (it->length == length)) {
-         // Exactly matches
-         return it->gid;
-      }
-      else if (it->first >= first + length) {
-         // Disjoint, to the right
+   bool split = false;
+   for (;;) {
+      group_node_t *it = group_find(ctx, first, length);
+      if (it == NULL) {
+         const groupid_t gid = group_alloc(ctx, first, length);
+         return split ? GROUPID_INVALID : gid;
       }
-      else if (first >= it->first + it->length) {
-         // Disjoint, to the left
+      else if ((it->first == first) && (it->length == length)) {
+         // Exactly matches
+         return split ? GROUPID_INVALID : it->gid;
       }
       else if ((first == it->first) && (length > it->length)) {
          // Overlaps on left
-         group_add(ctx, first + it->length, length - it->length);
-         return GROUPID_INVALID;
+         first  += it->length;
+         length -= it->length;
       }
       else if ((first > it->first)
                && (first + length == it->first + it->length)) {
@@ -129,9 +217,8 @@ static groupid_t group_add(group_nets_ctx_t *ctx, netid_t first, int length)
                && (first + length > it->first + it->length)) {
          // Contains in middle
          group_add(ctx, first, it->first - first);
-         group_add(ctx, it->first + it->length,
-                   first + length - it->first - it->length);
-         return GROUPID_INVALID;
+         length = first + length - it->first - it->length;
+         first  = it->first + it->length;
       }
       else if ((first == it->first)
                && (first + length < it->first + it->length)) {
@@ -159,21 +246,22 @@ static groupid_t group_add(group_nets_ctx_t *ctx, netid_t first, int length)
       }
       else if ((first > it->first) && (it->first + it->length > first)) {
          // Split right
+         const netid_t it_first = it->first;
+         const netid_t it_end = it->first + it->length;
          group_unlink(ctx, it);
-         group_add(ctx, it->first, first - it->first);
-         group_add(ctx, first, it->first + it->length - first);
-         group_add(ctx, it->first + it->length,
-                   first + length - it->first - it->length);
+         group_add(ctx, it_first, first - it_first);
+         group_add(ctx, first, it_end - first);
          group_reuse(ctx, it);
-         return GROUPID_INVALID;
+         length = first + length - it_end;
+         first  = it_end;
       }
       else
          fatal("unhandled case in group_add: first=%d length=%d "
                "it->first=%d it->length=%d", first, length,
                it->first, it->length);
-   }
 
-   return group_alloc(ctx, first, length);
+      split = true;
+   }
 }
 
 static bool group_contains_record(type_t type)
@@ -487,42 +575,82 @@ static void group_nets_visit_fn(tree_t t, void *_ctx)
    }
 }
 
-static void group_write_netdb(tree_t top, group_nets_ctx_t *ctx)
+static void group_collect_node(group_node_t *t, group_node_t **list,
+                               unsigned *n)
 {
-   char *name = xasprintf("_%s.netdb", istr(tree_ident(top)));
+   while (t != NULL) {
+      group_collect_node(t->left, list, n);
+      list[(*n)++] = t;
+      t = t->right;
+   }
+}
 
-   fbuf_t *f = lib_fbuf_open(lib_work(), name, FBUF_OUT);
-   if (f == NULL)
-      fatal("failed to create net database file %s", name);
+static int group_gid_cmp(const void *a, const void *b)
+{
+   const group_node_t *l = *(group_node_t * const *)a;
+   const group_node_t *r = *(group_node_t * const *)b;
+   return (l->gid < r->gid) - (l->gid > r->gid);
+}
+
+static group_node_t **group_collect(group_nets_ctx_t *ctx)
+{
+   // Return all the groups most recently allocated first
 
-   free(name);
+   const size_t max = MAX(ctx->ngroups, 1);
+   group_node_t **list = xmalloc(max * sizeof(group_node_t *));
+   unsigned n = 0;
+   group_collect_node(ctx->root, list, &n);
+   assert(n == ctx->ngroups);
 
-   for (group_t *it = ctx->groups; it != NULL; it = it->next) {
-      write_u32(it->gid, f);
-      write_u32(it->first, f);
-      write_u32(it->length, f);
+   qsort(list, n, sizeof(group_node_t *), group_gid_cmp);
+   return list;
+}
+
+static void group_write_netdb(tree_t top, group_nets_ctx_t *ctx)
+{
+   group_node_t **list = group_collect(ctx);
+   group_t *groups = xmalloc(MAX(ctx->ngroups, 1) * sizeof(group_t));
+   for (unsigned i = 0; i < ctx->ngroups; i++) {
+      groups[i].next   = NULL;
+      groups[i].gid    = list[i]->gid;
+      groups[i].first  = list[i]->first;
+      groups[i].length = list[i]->length;
    }
-   write_u32(GROUPID_INVALID, f);
+   free(list);
 
-   fbuf_close(f);
+   netdb_write(top, groups, ctx->ngroups);
+   free(groups);
 }
 
-static void group_free_list(group_t *list)
+static void group_free_tree(group_node_t *t)
 {
-   while (list != NULL) {
-      group_t *tmp = list->next;
-      free(list);
-      list = tmp;
+   while (t != NULL) {
+      group_free_tree(t->left);
+      group_node_t *tmp = t->right;
+      free(t);
+      t = tmp;
+   }
+}
+
+static void group_free_context(group_nets_ctx_t *ctx)
+{
+   group_free_tree(ctx->root);
+
+   while (ctx->free_list != NULL) {
+      group_node_t *tmp = ctx->free_list->left;
+      free(ctx->free_list);
+      ctx->free_list = tmp;
    }
 }
 
 static void group_init_context(group_nets_ctx_t *ctx, int nnets)
 {
-   ctx->groups    = NULL;
+   ctx->root      = NULL;
+   ctx->free_list = NULL;
    ctx->next_gid  = 0;
-   ctx->lookup    = xcalloc(nnets * sizeof(group_t *));
+   ctx->ngroups   = 0;
+   ctx->seed      = 2463534242;
    ctx->nnets     = nnets;
-   ctx->free_list = NULL;
 }
 
 void group_nets(tree_t top)
@@ -536,15 +664,9 @@ void group_nets(tree_t top)
    group_write_netdb(top, &ctx);
 
    if (opt_get_int("verbose")) {
-      int ngroups = 0;
-      for (group_t *it = ctx.groups; it != NULL; it = it->next)
-         ngroups++;
-
-      notef("%d nets, %d groups", nnets, ngroups);
-      notef("nets:groups ratio %.3f", (float)nnets / (float)ngroups);
+      notef("%d nets, %u groups", nnets, ctx.ngroups);
+      notef("nets:groups ratio %.3f", (float)nnets / (float)ctx.ngroups);
    }
 
-   group_free_list(ctx.groups);
-   group_free_list(ctx.free_list);
-   free(ctx.lookup);
+   group_free_context(&ctx);
 }
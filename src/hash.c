@@ -1,5 +1,5 @@
 //
-//  Copyright (C) 2013-2014  Nick Gasson
+//  Copyright (C) 2013-2018  Nick Gasson
 //
 //  This program is free software: you can redistribute it and/or modify
 //  it under the terms of the GNU General Public License as published by
@@ -21,114 +21,314 @@
 #include <string.h>
 #include <assert.h>
 
-struct hash {
+// Robin Hood hashing with linear probing: an entry is never further
+// from its home slot than the entry it would displace, so a search can
+// stop as soon as it reaches an entry closer to home than itself and
+// deletion shifts the rest of the run back rather than leaving a
+// tombstone. The table doubles when three quarters full but entries are
+// moved from the old table a few at a time by later updates so no
+// single put has to rebuild the whole table.
+
+#define MIGRATE_STEPS 8
+
+typedef struct {
    unsigned     size;
    unsigned     members;
-   bool         replace;
-   void       **values;
+   uint32_t    *dist;   // Zero if empty otherwise distance from home + 1
    const void **keys;
+   void       **values;
+} hash_table_t;
+
+struct hash {
+   hash_kind_t   kind;
+   bool          replace;
+   hash_table_t  cur;
+   hash_table_t  old;
+   unsigned      cursor;
 };
 
-static inline int hash_slot(hash_t *h, const void *key)
+static uint32_t hash_mix(uint32_t a)
 {
-   assert(key != NULL);
-
-   uintptr_t uptr = (uintptr_t)key;
-
-   // Bottom two bits will always be zero with 32-bit pointers
-   uptr >>= 2;
-
    // Hash function from here:
    //   http://burtleburtle.net/bob/hash/integer.html
 
-   uint32_t a = (uint32_t)uptr;
    a = (a ^ 61) ^ (a >> 16);
    a = a + (a << 3);
    a = a ^ (a >> 4);
    a = a * UINT32_C(0x27d4eb2d);
    a = a ^ (a >> 15);
+   return a;
+}
 
-   return a & (h->size - 1);
+static inline unsigned hash_slot(hash_t *h, const hash_table_t *t,
+                                 const void *key)
+{
+   uint32_t hash;
+   switch (h->kind) {
+   case HASH_STR:
+      {
+         // FNV-1a
+         hash = UINT32_C(2166136261);
+         for (const char *p = key; *p != '\0'; p++)
+            hash = (hash ^ (unsigned char)*p) * UINT32_C(16777619);
+      }
+      break;
+   case HASH_INT:
+      hash = hash_mix((uintptr_t)key);
+      break;
+   case HASH_PTR:
+   default:
+      // Bottom two bits will always be zero with 32-bit pointers
+      assert(key != NULL);
+      hash = hash_mix((uintptr_t)key >> 2);
+      break;
+   }
+
+   return hash & (t->size - 1);
 }
 
-hash_t *hash_new(int size, bool replace)
+static inline bool hash_key_eq(hash_t *h, const void *a, const void *b)
 {
-   struct hash *h = xmalloc(sizeof(struct hash));
-   h->size    = next_power_of_2(size);
-   h->members = 0;
-   h->replace = replace;
+   if (h->kind == HASH_STR)
+      return a == b || strcmp(a, b) == 0;
+   else
+      return a == b;
+}
 
-   char *mem = xcalloc(h->size * 2 * sizeof(void *));
-   h->values = (void **)mem;
-   h->keys   = (const void **)(mem + (h->size * sizeof(void *)));
+static void hash_table_init(hash_table_t *t, unsigned size)
+{
+   t->size    = size;
+   t->members = 0;
 
-   return h;
+   char *mem = xcalloc(size * (2 * sizeof(void *) + sizeof(uint32_t)));
+   t->values = (void **)mem;
+   t->keys   = (const void **)(mem + (size * sizeof(void *)));
+   t->dist   = (uint32_t *)(mem + (2 * size * sizeof(void *)));
 }
 
-void hash_free(hash_t *h)
+static void hash_table_free(hash_table_t *t)
 {
-   free(h->values);
-   free(h);
+   free(t->values);
+   t->values  = NULL;
+   t->keys    = NULL;
+   t->dist    = NULL;
+   t->size    = 0;
+   t->members = 0;
 }
 
-bool hash_put(hash_t *h, const void *key, void *value)
+static void hash_table_insert(hash_t *h, hash_table_t *t,
+                              const void *key, void *value)
 {
-   if (unlikely(h->members >= h->size / 2)) {
-      // Rebuild the hash table with a larger size
-      // This is expensive so a conservative initial size should be chosen
+   const unsigned mask = t->size - 1;
+   unsigned slot = hash_slot(h, t, key);
+   uint32_t dist = 1;
+   bool carrying = false;
 
-      const int old_size = h->size;
-      h->size *= 2;
+   // Entries with the same home slot are contiguous so a new entry goes
+   // after any with an equal key but a displaced entry must shift the
+   // rest of its group along to keep duplicates in insertion order
+   for (;; slot = (slot + 1) & mask, dist++) {
+      if (t->dist[slot] == 0) {
+         t->keys[slot]   = key;
+         t->values[slot] = value;
+         t->dist[slot]   = dist;
+         t->members++;
+         return;
+      }
+      else if (t->dist[slot] < dist || (carrying && t->dist[slot] == dist)) {
+         // Take the slot from the entry closer to its home and carry
+         // on looking for a place for that one
+         const void *tkey = t->keys[slot];
+         void *tvalue = t->values[slot];
+         const uint32_t tdist = t->dist[slot];
 
-      const void **old_keys = h->keys;
-      void **old_values = h->values;
+         t->keys[slot]   = key;
+         t->values[slot] = value;
+         t->dist[slot]   = dist;
 
-      char *mem = xcalloc(h->size * 2 * sizeof(void *));
-      h->values = (void **)mem;
-      h->keys   = (const void **)(mem + (h->size * sizeof(void *)));
+         key   = tkey;
+         value = tvalue;
+         dist  = tdist;
 
-      h->members = 0;
+         carrying = true;
+      }
+   }
+}
 
-      for (int i = 0; i < old_size; i++) {
-         if (old_keys[i] != NULL)
-            hash_put(h, old_keys[i], old_values[i]);
+static int hash_table_find(hash_t *h, hash_table_t *t, const void *key,
+                           int *n)
+{
+   if (t->members == 0)
+      return -1;
+
+   const unsigned mask = t->size - 1;
+   unsigned slot = hash_slot(h, t, key);
+
+   for (uint32_t dist = 1; t->dist[slot] >= dist;
+        slot = (slot + 1) & mask, dist++) {
+      if (t->dist[slot] == dist && hash_key_eq(h, t->keys[slot], key)) {
+         if (*n == 0)
+            return slot;
+         else
+            --(*n);
+      }
+   }
+
+   return -1;
+}
+
+static void hash_table_delete(hash_table_t *t, unsigned slot)
+{
+   const unsigned mask = t->size - 1;
+
+   for (;;) {
+      const unsigned next = (slot + 1) & mask;
+      if (t->dist[next] <= 1) {
+         t->dist[slot]   = 0;
+         t->keys[slot]   = NULL;
+         t->values[slot] = NULL;
+         break;
       }
 
-      free(old_values);
+      t->keys[slot]   = t->keys[next];
+      t->values[slot] = t->values[next];
+      t->dist[slot]   = t->dist[next] - 1;
+
+      slot = next;
    }
 
-   int slot = hash_slot(h, key);
+   t->members--;
+}
+
+static void hash_migrate(hash_t *h, unsigned steps)
+{
+   // Entries shifted back by a deletion can wrap round behind the
+   // cursor so it keeps cycling until the old table is empty
+   hash_table_t *old = &(h->old);
+
+   for (; steps > 0 && old->members > 0; steps--) {
+      const unsigned slot = h->cursor;
+      if (old->dist[slot] == 0)
+         h->cursor = (slot + 1) & (old->size - 1);
+      else {
+         hash_table_insert(h, &(h->cur), old->keys[slot], old->values[slot]);
+         hash_table_delete(old, slot);
+      }
+   }
+
+   if (old->size > 0 && old->members == 0)
+      hash_table_free(old);
+}
+
+static void hash_grow(hash_t *h, unsigned size)
+{
+   // Any earlier migration must be finished first
+   if (h->old.size > 0)
+      hash_migrate(h, UINT_MAX);
+
+   h->old = h->cur;
+   hash_table_init(&(h->cur), size);
 
-   for (; ; slot = (slot + 1) & (h->size - 1)) {
-      if ((h->keys[slot] == key) && h->replace) {
-         h->values[slot] = value;
+   // Starting from an empty slot means no group of equal keys wraps
+   // round behind the cursor and they are moved in order
+   for (h->cursor = 0; h->old.dist[h->cursor] != 0; h->cursor++)
+      ;
+
+   // A later duplicate could be put in the new table before an earlier
+   // one was moved so only tables with unique keys migrate lazily
+   if (!h->replace)
+      hash_migrate(h, UINT_MAX);
+}
+
+hash_t *hash_new_kind(int size, bool replace, hash_kind_t kind)
+{
+   struct hash *h = xcalloc(sizeof(struct hash));
+   h->kind    = kind;
+   h->replace = replace;
+
+   hash_table_init(&(h->cur), next_power_of_2(MAX(size, 2)));
+
+   return h;
+}
+
+hash_t *hash_new(int size, bool replace)
+{
+   return hash_new_kind(size, replace, HASH_PTR);
+}
+
+void hash_free(hash_t *h)
+{
+   hash_table_free(&(h->cur));
+   hash_table_free(&(h->old));
+   free(h);
+}
+
+void hash_reserve(hash_t *h, unsigned count)
+{
+   if (h->old.size > 0)
+      hash_migrate(h, UINT_MAX);
+
+   if (count < h->cur.size - h->cur.size / 4)
+      return;
+
+   unsigned size = h->cur.size;
+   while (count >= size - size / 4)
+      size *= 2;
+
+   hash_grow(h, size);
+   hash_migrate(h, UINT_MAX);
+}
+
+bool hash_put(hash_t *h, const void *key, void *value)
+{
+   hash_migrate(h, MIGRATE_STEPS);
+
+   if (h->replace) {
+      int n = 0, slot;
+      if ((slot = hash_table_find(h, &(h->cur), key, &n)) >= 0) {
+         h->cur.values[slot] = value;
          return true;
       }
-      else if (h->keys[slot] == NULL) {
-         h->values[slot] = value;
-         h->keys[slot] = key;
-         h->members++;
-         break;
+      else if ((slot = hash_table_find(h, &(h->old), key, &n)) >= 0) {
+         h->old.values[slot] = value;
+         return true;
       }
    }
 
+   const unsigned members = h->cur.members + h->old.members;
+   if (unlikely(members >= h->cur.size - h->cur.size / 4))
+      hash_grow(h, h->cur.size * 2);
+
+   hash_table_insert(h, &(h->cur), key, value);
    return false;
 }
 
-void *hash_get_nth(hash_t *h, const void *key, int *n)
+bool hash_delete(hash_t *h, const void *key)
 {
-   int slot = hash_slot(h, key);
+   hash_migrate(h, MIGRATE_STEPS);
 
-   for (; ; slot = (slot + 1) & (h->size - 1)) {
-      if (h->keys[slot] == key) {
-         if (*n == 0)
-            return h->values[slot];
-         else
-            --(*n);
-      }
-      else if (h->keys[slot] == NULL)
-         return NULL;
+   int n = 0, slot;
+   if ((slot = hash_table_find(h, &(h->cur), key, &n)) >= 0) {
+      hash_table_delete(&(h->cur), slot);
+      return true;
+   }
+   else if ((slot = hash_table_find(h, &(h->old), key, &n)) >= 0) {
+      hash_table_delete(&(h->old), slot);
+      return true;
    }
+   else
+      return false;
+}
+
+void *hash_get_nth(hash_t *h, const void *key, int *n)
+{
+   int slot;
+   if ((slot = hash_table_find(h, &(h->cur), key, n)) >= 0)
+      return h->cur.values[slot];
+   else if ((slot = hash_table_find(h, &(h->old), key, n)) >= 0)
+      return h->old.values[slot];
+   else
+      return NULL;
 }
 
 void *hash_get(hash_t *h, const void *key)
@@ -137,11 +337,32 @@ void *hash_get(hash_t *h, const void *key)
    return hash_get_nth(h, key, &n);
 }
 
+bool hash_put_int(hash_t *h, uint32_t key, void *value)
+{
+   assert(h->kind == HASH_INT);
+   return hash_put(h, (void *)(uintptr_t)key, value);
+}
+
+void *hash_get_int(hash_t *h, uint32_t key)
+{
+   assert(h->kind == HASH_INT);
+   return hash_get(h, (void *)(uintptr_t)key);
+}
+
+bool hash_delete_int(hash_t *h, uint32_t key)
+{
+   assert(h->kind == HASH_INT);
+   return hash_delete(h, (void *)(uintptr_t)key);
+}
+
 void hash_replace(hash_t *h, void *value, void *with)
 {
-   for (int i = 0; i < h->size; i++) {
-      if (h->values[i] == value)
-         h->values[i] = with;
+   hash_table_t *tables[] = { &(h->cur), &(h->old) };
+   for (int i = 0; i < ARRAY_LEN(tables); i++) {
+      for (unsigned j = 0; j < tables[i]->size; j++) {
+         if (tables[i]->dist[j] != 0 && tables[i]->values[j] == value)
+            tables[i]->values[j] = with;
+      }
    }
 }
 
@@ -149,11 +370,19 @@ bool hash_iter(hash_t *h, hash_iter_t *now, const void **key, void **value)
 {
    assert(*now != HASH_END);
 
-   while (*now < h->size) {
-      const unsigned old = (*now)++;
-      if (h->keys[old] != NULL) {
-         *key   = h->keys[old];
-         *value = h->values[old];
+   // Slots in the current table are numbered before the old table
+   while (*now < h->cur.size + h->old.size) {
+      const unsigned index = (*now)++;
+      hash_table_t *t = &(h->cur);
+      unsigned slot = index;
+      if (slot >= h->cur.size) {
+         t = &(h->old);
+         slot -= h->cur.size;
+      }
+
+      if (t->dist[slot] != 0) {
+         *key   = t->keys[slot];
+         *value = t->values[slot];
          return true;
       }
    }
@@ -164,5 +393,5 @@ bool hash_iter(hash_t *h, hash_iter_t *now, const void **key, void **value)
 
 unsigned hash_members(hash_t *h)
 {
-   return h->members;
+   return h->cur.members + h->old.members;
 }
@@ -1,5 +1,5 @@
 //
-//  Copyright (C) 2013-2015  Nick Gasson
+//  Copyright (C) 2013-2018  Nick Gasson
 //
 //  This program is free software: you can redistribute it and/or modify
 //  it under the terms of the GNU General Public License as published by
@@ -29,11 +29,26 @@ typedef unsigned hash_iter_t;
 #define HASH_BEGIN 0
 #define HASH_END   UINT_MAX
 
+// Pointers including ident_t are compared by address, strings by their
+// characters and integer keys by value. String keys are not copied and
+// must remain valid while in the table.
+typedef enum {
+   HASH_PTR,
+   HASH_STR,
+   HASH_INT
+} hash_kind_t;
+
 hash_t *hash_new(int size, bool replace);
+hash_t *hash_new_kind(int size, bool replace, hash_kind_t kind);
 void hash_free(hash_t *h);
+void hash_reserve(hash_t *h, unsigned count);
 bool hash_put(hash_t *h, const void *key, void *value);
 void *hash_get(hash_t *h, const void *key);
 void *hash_get_nth(hash_t *h, const void *key, int *n);
+bool hash_delete(hash_t *h, const void *key);
+bool hash_put_int(hash_t *h, uint32_t key, void *value);
+void *hash_get_int(hash_t *h, uint32_t key);
+bool hash_delete_int(hash_t *h, uint32_t key);
 void hash_replace(hash_t *h, void *value, void *with);
 bool hash_iter(hash_t *h, hash_iter_t *now, const void **key, void **value);
 unsigned hash_members(hash_t *h);
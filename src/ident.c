@@ -18,6 +18,7 @@
 #include "util.h"
 #include "fbuf.h"
 #include "ident.h"
+#include "mem.h"
 
 #include <assert.h>
 #include <stdbool.h>
@@ -26,26 +27,20 @@
 #include <stdint.h>
 #include <ctype.h>
 
-#define MAP_DEPTH 3
+// Identifiers are interned in a hash table keyed by their characters
+// so equal strings always give the same ident_t. The characters are
+// stored terminated after the header so istr need not copy them.
 
-typedef struct clist clist_t;
-typedef struct trie  trie_t;
+#define INITIAL_SIZE   4096
+#define ARENA_SIZE     (256 * 1024)
+#define PREFIX_CACHE   1024
 
-struct clist {
-   char     value;
-   trie_t  *down;
-   clist_t *left;
-   clist_t *right;
-};
-
-struct trie {
-   char      value;
-   uint16_t  write_gen;
-   uint16_t  depth;
+struct ident {
+   uint32_t  hash;
+   uint32_t  length;
    uint32_t  write_index;
-   trie_t   *up;
-   clist_t  *list;
-   trie_t   *map[0];
+   uint16_t  write_gen;
+   char      bytes[0];
 };
 
 struct ident_rd_ctx {
@@ -53,6 +48,8 @@ struct ident_rd_ctx {
    size_t   cache_sz;
    size_t   cache_alloc;
    ident_t *cache;
+   char    *buf;
+   size_t   buf_alloc;
 };
 
 struct ident_wr_ctx {
@@ -62,120 +59,124 @@ struct ident_wr_ctx {
 };
 
 typedef struct {
-   trie_t  trie;
-   trie_t *map[256];
-} root_t;
-
-static root_t root = {
-   {
-      .value       = '\0',
-      .write_gen   = 0,
-      .write_index = 0,
-      .depth       = 1,
-      .up          = NULL
+   ident_t a;
+   ident_t b;
+   char    sep;
+   ident_t result;
+} prefix_cache_t;
+
+static ident_t        *table = NULL;
+static uint32_t        table_size = 0;
+static uint32_t        table_members = 0;
+static char           *arena_ptr = NULL;
+static size_t          arena_left = 0;
+static size_t          arena_bytes = 0;
+static prefix_cache_t  prefix_cache[PREFIX_CACHE];
+
+static struct {
+   struct ident ident;
+   char         nul;
+} empty_ident = { { .hash = 2166136261u, .length = 0 }, '\0' };
+
+static uint32_t ident_hash(const char *str, size_t len)
+{
+   // FNV-1a
+   uint32_t hash = 2166136261u;
+   for (const char *end = str + len; str < end; str++)
+      hash = (hash ^ (unsigned char)*str) * 16777619u;
+   return hash;
+}
+
+static ident_t ident_alloc(const char *str, size_t len, uint32_t hash)
+{
+   const size_t size =
+      (sizeof(struct ident) + len + 1 + sizeof(void *) - 1)
+      & ~(sizeof(void *) - 1);
+
+   if (size > arena_left) {
+      const size_t chunk = MAX(size, ARENA_SIZE);
+      arena_ptr  = xmalloc(chunk);
+      arena_left = chunk;
+      arena_bytes += chunk;
    }
-};
 
-static trie_t *alloc_node(char ch, trie_t *prev)
-{
-   const size_t mapsz = (prev->depth < MAP_DEPTH) ? 256 * sizeof(trie_t *) : 0;
-
-   trie_t *t = xmalloc(sizeof(trie_t) + mapsz);
-   t->value     = ch;
-   t->depth     = prev->depth + 1;
-   t->up        = prev;
-   t->write_gen = 0;
-   t->list      = NULL;
-
-   if (mapsz > 0)
-      memset(t->map, '\0', mapsz);
+   ident_t ident = (ident_t)arena_ptr;
+   arena_ptr  += size;
+   arena_left -= size;
 
-   if (prev->depth <= MAP_DEPTH)
-      prev->map[(unsigned char)ch] = t;
-   else {
-      clist_t *c = xmalloc(sizeof(clist_t));
-      c->value    = ch;
-      c->down     = t;
-      c->left     = NULL;
-      c->right    = NULL;
-
-      clist_t *it, **where;
-      for (it = prev->list, where = &(prev->list);
-           it != NULL;
-           where = (ch < it->value ? &(it->left) : &(it->right)),
-              it = *where)
-         ;
+   ident->hash        = hash;
+   ident->length      = len;
+   ident->write_index = 0;
+   ident->write_gen   = 0;
 
-      *where = c;
-   }
+   memcpy(ident->bytes, str, len);
+   ident->bytes[len] = '\0';
 
-   return t;
+   return ident;
 }
 
-static void build_trie(const char *str, trie_t *prev, trie_t **end)
+static void ident_grow_table(void)
 {
-   assert(*str != '\0');
-   assert(prev != NULL);
-
-   trie_t *t = alloc_node(*str, prev);
+   const uint32_t old_size = table_size;
+   ident_t *old_table = table;
 
-   if (*(++str) == '\0')
-      *end = t;
-   else
-      build_trie(str, t, end);
-}
+   table_size = (old_size == 0) ? INITIAL_SIZE : old_size * 2;
+   table = xcalloc(table_size * sizeof(ident_t));
 
-static clist_t *search_node(trie_t *t, char ch)
-{
-   clist_t *it;
-   for (it = t->list;
-        (it != NULL) && (it->value != ch);
-        it = (ch < it->value ? it->left : it->right))
-      ;
+   for (uint32_t i = 0; i < old_size; i++) {
+      ident_t ident = old_table[i];
+      if (ident != NULL) {
+         uint32_t slot = ident->hash & (table_size - 1);
+         while (table[slot] != NULL)
+            slot = (slot + 1) & (table_size - 1);
+         table[slot] = ident;
+      }
+   }
 
-   return it;
+   free(old_table);
 }
 
-static bool search_trie(const char **str, trie_t *t, trie_t **end)
+static ident_t ident_lookup(const char *str, size_t len, bool create)
 {
-   assert(**str != '\0');
-   assert(t != NULL);
+   if (len == 0)
+      return &(empty_ident.ident);
 
-   trie_t *next = NULL;
+   if (unlikely(table_members >= table_size / 2))
+      ident_grow_table();
 
-   if (t->depth <= MAP_DEPTH)
-      next = t->map[(unsigned char)**str];
-   else {
-      clist_t *it = search_node(t, **str);
-      next = (it != NULL) ? it->down : NULL;
-   }
+   const uint32_t hash = ident_hash(str, len);
 
-   if (next == NULL) {
-      *end = t;
-      return false;
+   uint32_t slot = hash & (table_size - 1);
+   for (;; slot = (slot + 1) & (table_size - 1)) {
+      ident_t ident = table[slot];
+      if (ident == NULL)
+         break;
+      else if (ident->hash == hash && ident->length == len
+               && memcmp(ident->bytes, str, len) == 0)
+         return ident;
    }
-   else {
-      (*str)++;
 
-      if (**str == '\0') {
-         *end = next;
-         return true;
-      }
-      else
-         return search_trie(str, next, end);
-   }
+   if (!create)
+      return NULL;
+
+   table_members++;
+   return (table[slot] = ident_alloc(str, len, hash));
 }
 
 ident_t ident_new(const char *str)
 {
    assert(str != NULL);
-   assert(*str != '\0');
 
-   trie_t *result;
-   if (!search_trie(&str, &(root.trie), &result))
-      build_trie(str, result, &result);
+   return ident_new_n(str, strlen(str));
+}
+
+ident_t ident_new_n(const char *str, size_t len)
+{
+   assert(str != NULL);
+   assert(len > 0);
+   assert(memchr(str, '\0', len) == NULL);
 
-   return result;
+   return ident_lookup(str, len, true);
 }
 
 bool ident_interned(const char *str)
@@ -183,23 +184,22 @@ bool ident_interned(const char *str)
    assert(str != NULL);
    assert(*str != '\0');
 
-   trie_t *result;
-   return search_trie(&str, &(root.trie), &result);
+   return ident_lookup(str, strlen(str), false) != NULL;
 }
 
 const char *istr(ident_t ident)
 {
    if (ident == NULL)
       return NULL;
+   else
+      return ident->bytes;
+}
 
-   char *p = get_fmt_buf(ident->depth) + ident->depth - 1;
-   *p = '\0';
-
-   trie_t *it;
-   for (it = ident; it->value != '\0'; it = it->up)
-      *(--p) = it->value;
-
-   return p;
+void ident_mem_stats(void)
+{
+   const size_t bytes = arena_bytes + table_size * sizeof(ident_t)
+      + sizeof(prefix_cache);
+   mem_record("idents", NULL, table_members, bytes);
 }
 
 ident_wr_ctx_t ident_write_begin(fbuf_t *f)
@@ -230,7 +230,7 @@ void ident_write(ident_t ident, ident_wr_ctx_t ctx)
       write_u32(ident->write_index, ctx->file);
    else {
       write_u32(UINT32_MAX, ctx->file);
-      write_raw(istr(ident), ident->depth, ctx->file);
+      write_raw(ident->bytes, ident->length + 1, ctx->file);
 
       ident->write_gen   = ctx->generation;
       ident->write_index = ctx->next_index++;
@@ -246,6 +246,8 @@ ident_rd_ctx_t ident_read_begin(fbuf_t *f)
    ctx->cache_alloc = 256;
    ctx->cache_sz    = 0;
    ctx->cache       = xmalloc(ctx->cache_alloc * sizeof(ident_t));
+   ctx->buf_alloc   = 128;
+   ctx->buf         = xmalloc(ctx->buf_alloc);
 
    return ctx;
 }
@@ -253,9 +255,16 @@ ident_rd_ctx_t ident_read_begin(fbuf_t *f)
 void ident_read_end(ident_rd_ctx_t ctx)
 {
    free(ctx->cache);
+   free(ctx->buf);
    free(ctx);
 }
 
+void ident_read_switch(ident_rd_ctx_t ctx, fbuf_t *f)
+{
+   // Continue reading the same stream of identifiers from another file
+   ctx->file = f;
+}
+
 ident_t ident_read(ident_rd_ctx_t ctx)
 {
    const uint32_t index = read_u32(ctx->file);
@@ -265,28 +274,22 @@ ident_t ident_read(ident_rd_ctx_t ctx)
          ctx->cache = xrealloc(ctx->cache, ctx->cache_alloc * sizeof(ident_t));
       }
 
-      trie_t *p = &(root.trie);
+      size_t len = 0;
       char ch;
       while ((ch = read_u8(ctx->file)) != '\0') {
-         trie_t *next = NULL;
-         if (p->depth <= MAP_DEPTH)
-            next = p->map[(unsigned char)ch];
-         else {
-            clist_t *it = search_node(p, ch);
-            next = (it != NULL) ? it->down : NULL;
+         if (len == ctx->buf_alloc) {
+            ctx->buf_alloc *= 2;
+            ctx->buf = xrealloc(ctx->buf, ctx->buf_alloc);
          }
-
-         if (next != NULL)
-            p = next;
-         else
-            p = alloc_node(ch, p);
+         ctx->buf[len++] = ch;
       }
 
-      if (p == &(root.trie))
+      if (len == 0)
          return NULL;
       else {
-         ctx->cache[ctx->cache_sz++] = p;
-         return p;
+         ident_t ident = ident_lookup(ctx->buf, len, true);
+         ctx->cache[ctx->cache_sz++] = ident;
+         return ident;
       }
    }
    else if (likely(index < ctx->cache_sz))
@@ -300,20 +303,15 @@ ident_t ident_uniq(const char *prefix)
 {
    static int counter = 0;
 
-   const char *start = prefix;
-   trie_t *end;
-   if (search_trie(&start, &(root.trie), &end)) {
+   if (ident_interned(prefix)) {
       const size_t len = strlen(prefix) + 16;
       char buf[len];
       snprintf(buf, len, "%s%d", prefix, counter++);
 
       return ident_new(buf);
    }
-   else {
-      trie_t *result;
-      build_trie(start, end, &result);
-      return result;
-   }
+   else
+      return ident_new(prefix);
 }
 
 ident_t ident_prefix(ident_t a, ident_t b, char sep)
@@ -323,24 +321,28 @@ ident_t ident_prefix(ident_t a, ident_t b, char sep)
    else if (b == NULL)
       return a;
 
-   trie_t *result;
+   // Hierarchical names are built from the same few prefixes repeatedly
+   const uintptr_t key = ((uintptr_t)a >> 3) ^ ((uintptr_t)b >> 2) ^ sep;
+   prefix_cache_t *pc = &(prefix_cache[(key ^ (key >> 12)) % PREFIX_CACHE]);
+   if (pc->a == a && pc->b == b && pc->sep == sep)
+      return pc->result;
 
-   if (sep != '\0') {
-      // Append separator
-      const char sep_str[] = { sep, '\0' };
-      const char *p_sep_str = sep_str;
-      if (!search_trie(&p_sep_str, a, &result))
-         build_trie(p_sep_str, result, &result);
-   }
-   else
-      result = a;
+   const size_t len = a->length + b->length + (sep != '\0');
+   char buf[len];
+   char *p = buf;
+
+   memcpy(p, a->bytes, a->length);
+   p += a->length;
+   if (sep != '\0')
+      *p++ = sep;
+   memcpy(p, b->bytes, b->length);
 
-   // Append b
-   const char *bstr = istr(b);
-   if (!search_trie(&bstr, result, &result))
-      build_trie(bstr, result, &result);
+   pc->a      = a;
+   pc->b      = b;
+   pc->sep    = sep;
+   pc->result = ident_lookup(buf, len, true);
 
-   return result;
+   return pc->result;
 }
 
 ident_t ident_strip(ident_t a, ident_t b)
@@ -348,47 +350,54 @@ ident_t ident_strip(ident_t a, ident_t b)
    assert(a != NULL);
    assert(b != NULL);
 
-   while (a->value == b->value && b->value != '\0') {
-      a = a->up;
-      b = b->up;
-   }
+   if (b->length > a->length)
+      return NULL;
 
-   return (b->value == '\0' ? a : NULL);
+   const size_t len = a->length - b->length;
+   if (memcmp(a->bytes + len, b->bytes, b->length) != 0)
+      return NULL;
+
+   return ident_lookup(a->bytes, len, true);
 }
 
 char ident_char(ident_t i, unsigned n)
 {
-   if (i == NULL)
+   if (i == NULL || n >= i->length)
       return '\0';
-   else if (n == 0)
-      return i->value;
    else
-      return ident_char(i->up, n - 1);
+      return i->bytes[i->length - 1 - n];
 }
 
 size_t ident_len(ident_t i)
 {
-   if (i == NULL || i->value == '\0')
+   if (i == NULL)
       return 0;
    else
-      return ident_len(i->up) + 1;
+      return i->length;
 }
 
 ident_t ident_suffix_until(ident_t i, char c, ident_t shared, char escape)
 {
    assert(i != NULL);
 
+   // Only the characters after shared and its following separator are
+   // searched if shared is a prefix of i
+   size_t stop = 0;
+   if (shared != NULL && shared->length < i->length
+       && memcmp(i->bytes, shared->bytes, shared->length) == 0)
+      stop = shared->length + 1;
+
    bool escaping = false;
-   ident_t r = i;
-   while (i->value != '\0' && i->up != shared) {
-      if (!escaping && i->value == c)
-         r = i->up;
-      else if (i->value == escape)
+   size_t r = i->length;
+   for (size_t k = i->length; k > stop; k--) {
+      const char ch = i->bytes[k - 1];
+      if (!escaping && ch == c)
+         r = k - 1;
+      else if (ch == escape)
          escaping = !escaping;
-      i = i->up;
    }
 
-   return r;
+   return (r == i->length) ? i : ident_lookup(i->bytes, r, true);
 }
 
 ident_t ident_until(ident_t i, char c)
@@ -396,78 +405,63 @@ ident_t ident_until(ident_t i, char c)
    return ident_suffix_until(i, c, NULL, '\0');
 }
 
-ident_t ident_runtil(ident_t i, char c)
+static const char *ident_last(ident_t i, char c)
 {
-   assert(i != NULL);
-
-   for (ident_t r = i; r->value != '\0'; r = r->up) {
-      if (r->value == c)
-         return r->up;
+   for (const char *p = i->bytes + i->length - 1; p >= i->bytes; p--) {
+      if (*p == c)
+         return p;
    }
 
-   return i;
+   return NULL;
 }
 
-ident_t ident_from(ident_t i, char c)
+ident_t ident_runtil(ident_t i, char c)
 {
    assert(i != NULL);
 
-   char buf[i->depth + 1];
-   char *p = buf + i->depth;
-   *p-- = '\0';
+   const char *last = ident_last(i, c);
+   if (last == NULL)
+      return i;
+   else
+      return ident_lookup(i->bytes, last - i->bytes, true);
+}
 
-   char *from = NULL;
-   while (i->value != '\0') {
-      if (i->value == c)
-         from = p + 1;
-      *p-- = i->value;
-      i = i->up;
-   }
+ident_t ident_from(ident_t i, char c)
+{
+   assert(i != NULL);
 
-   return (from == NULL) ? NULL : ident_new(from);
+   const char *first = memchr(i->bytes, c, i->length);
+   return (first == NULL) ? NULL : ident_new(first + 1);
 }
 
 ident_t ident_rfrom(ident_t i, char c)
 {
    assert(i != NULL);
 
-   char buf[i->depth + 1];
-   char *p = buf + i->depth;
-   *p-- = '\0';
-
-   while (i->value != '\0') {
-      if (i->value == c)
-         return ident_new(p + 1);
-      *p-- = i->value;
-      i = i->up;
-   }
-
-   return NULL;
+   const char *last = ident_last(i, c);
+   return (last == NULL) ? NULL : ident_new(last + 1);
 }
 
 bool icmp(ident_t i, const char *s)
 {
    assert(i != NULL);
 
-   trie_t *result;
-   if (!search_trie(&s, &(root.trie), &result))
-      return false;
-   else
-      return result == i;
+   return strcmp(i->bytes, s) == 0;
 }
 
-static bool ident_glob_walk(const trie_t *i, const char *g,
+static bool ident_glob_walk(const char *s, const char *i, const char *g,
                             const char *const end)
 {
-   if (i->value == '\0')
+   // Matches backwards from the end of both strings
+   if (i < s)
       return (g < end);
    else if (g < end)
       return false;
    else if (*g == '*')
-      return ident_glob_walk(i->up, g, end)
-         || ident_glob_walk(i->up, g - 1, end);
-   else if (i->value == *g)
-      return ident_glob_walk(i->up, g - 1, end);
+      return ident_glob_walk(s, i - 1, g, end)
+         || ident_glob_walk(s, i - 1, g - 1, end);
+   else if (*i == *g)
+      return ident_glob_walk(s, i - 1, g - 1, end);
    else
       return false;
 }
@@ -479,38 +473,27 @@ bool ident_glob(ident_t i, const char *glob, int length)
    if (length < 0)
       length = strlen(glob);
 
-   return ident_glob_walk(i, glob + length - 1, glob);
+   return ident_glob_walk(i->bytes, i->bytes + i->length - 1,
+                          glob + length - 1, glob);
 }
 
 bool ident_contains(ident_t i, const char *search)
 {
    assert(i != NULL);
 
-   for (ident_t r = i; r->value != '\0'; r = r->up) {
-      for (const char *p = search; *p != '\0'; p++) {
-         if (r->value == *p)
-            return true;
-      }
-   }
-
-   return false;
+   return strpbrk(i->bytes, search) != NULL;
 }
 
 ident_t ident_downcase(ident_t i)
 {
-   // TODO: this could be implemented more efficiently
-
    if (i == NULL)
       return NULL;
 
-   char *p = get_fmt_buf(i->depth) + i->depth - 1;
-   *p = '\0';
-
-   trie_t *it;
-   for (it = i; it->value != '\0'; it = it->up)
-      *(--p) = tolower((int)it->value);
+   char buf[i->length];
+   for (size_t k = 0; k < i->length; k++)
+      buf[k] = tolower((int)i->bytes[k]);
 
-   return ident_new(p);
+   return ident_lookup(buf, i->length, true);
 }
 
 void ident_list_add(ident_list_t **list, ident_t i)
@@ -28,6 +28,9 @@ typedef struct ident_rd_ctx *ident_rd_ctx_t;
 // Intern a string as an identifier.
 ident_t ident_new(const char *str);
 
+// Intern the first len characters of str which need not be terminated.
+ident_t ident_new_n(const char *str, size_t len);
+
 // True if the given string was already interned.
 bool ident_interned(const char *str);
 
@@ -48,6 +51,9 @@ char ident_char(ident_t i, unsigned n);
 // Number of characters in the identifier
 size_t ident_len(ident_t i);
 
+// Record the number of identifiers and the memory they use
+void ident_mem_stats(void);
+
 // Return the prefix of i that does not include c
 ident_t ident_until(ident_t i, char c);
 
@@ -89,6 +95,7 @@ void ident_write_end(ident_wr_ctx_t ctx);
 ident_rd_ctx_t ident_read_begin(fbuf_t *f);
 ident_t ident_read(ident_rd_ctx_t ctx);
 void ident_read_end(ident_rd_ctx_t ctx);
+void ident_read_switch(ident_rd_ctx_t ctx, fbuf_t *f);
 
 typedef struct ident_list ident_list_t;
 
@@ -19,6 +19,7 @@
 #include "lib.h"
 #include "tree.h"
 #include "common.h"
+#include "hash.h"
 
 #include <assert.h>
 #include <limits.h>
@@ -30,6 +31,7 @@
 #include <errno.h>
 #include <time.h>
 #include <fcntl.h>
+#include <signal.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/time.h>
@@ -40,6 +42,13 @@ typedef struct lib_index   lib_index_t;
 typedef struct lib_list    lib_list_t;
 typedef struct lib_map     lib_map_t;
 
+// Marks an index which records the modification time and source hash
+// of each unit: an older index starts with the entry count which cannot
+// be this large or with the magic number for an index which only has
+// the modification time
+#define INDEX_MAGIC       0x4e564959
+#define INDEX_MAGIC_MTIME 0x4e564958
+
 struct lib_unit {
    tree_t        top;
    tree_kind_t   kind;
@@ -51,16 +60,26 @@ struct lib_unit {
 struct lib_index {
    ident_t      name;
    tree_kind_t  kind;
+   lib_mtime_t  mtime;      // Zero if not known
+   uint64_t     src_hash;   // Source file contents when analysed or zero
    lib_index_t *next;
 };
 
+typedef struct {
+   lib_mtime_t mtime;
+   off_t       size;
+   uint64_t    hash;
+} src_hash_t;
+
 struct lib {
    char         path[PATH_MAX];
    ident_t      name;
    unsigned     n_units;
    unsigned     units_alloc;
    lib_unit_t  *units;
+   hash_t      *unit_map;    // Position in units plus one
    lib_index_t *index;
+   hash_t      *index_map;
    int          lock_fd;
 };
 
@@ -77,6 +96,7 @@ struct search_path {
 static lib_t          work = NULL;
 static lib_list_t    *loaded = NULL;
 static search_path_t *search_paths = NULL;
+static hash_t        *src_hashes = NULL;
 
 static const char *lib_file_path(lib_t lib, const char *name);
 
@@ -112,14 +132,112 @@ static ident_t upcase_name(const char * name)
    return i;
 }
 
+static lib_index_t *lib_find_in_index(lib_t lib, ident_t name)
+{
+   return hash_get(lib->index_map, name);
+}
+
+static lib_index_t *lib_add_to_index(lib_t lib, ident_t name,
+                                     tree_kind_t kind)
+{
+   lib_index_t *in = xmalloc(sizeof(lib_index_t));
+   in->name     = name;
+   in->kind     = kind;
+   in->mtime    = 0;
+   in->src_hash = 0;
+   in->next     = lib->index;
+
+   lib->index = in;
+   hash_put(lib->index_map, name, in);
+   return in;
+}
+
+static void lib_read_index(lib_t lib)
+{
+   // Entries already in memory take precedence over those on disk so
+   // this can also merge in units saved by another process
+
+   fbuf_t *f = lib_fbuf_open(lib, "_index", FBUF_IN);
+   if (f == NULL)
+      return;
+
+   ident_rd_ctx_t ictx = ident_read_begin(f);
+
+   int entries = read_u32(f);
+   const bool have_hash = (entries == INDEX_MAGIC);
+   const bool have_mtime = have_hash || (entries == INDEX_MAGIC_MTIME);
+   if (have_mtime)
+      entries = read_u32(f);
+
+   for (int i = 0; i < entries; i++) {
+      ident_t name = ident_read(ictx);
+      tree_kind_t kind = read_u16(f);
+      assert(kind < T_LAST_TREE_KIND);
+
+      const lib_mtime_t mtime = have_mtime ? read_u64(f) : 0;
+      const uint64_t src_hash = have_hash ? read_u64(f) : 0;
+
+      if (lib_find_in_index(lib, name) == NULL) {
+         lib_index_t *in = lib_add_to_index(lib, name, kind);
+         in->mtime    = mtime;
+         in->src_hash = src_hash;
+      }
+   }
+
+   ident_read_end(ictx);
+   fbuf_close(f);
+}
+
+static void lib_remove_stale_temps(lib_t lib)
+{
+   // A process killed between lib_open_temp and lib_rename_temp leaves
+   // its temporary file behind which is removed once that process has
+   // exited
+
+#ifndef __MINGW32__
+   DIR *d = opendir(lib->path);
+   if (d == NULL)
+      return;
+
+   struct dirent *e;
+   while ((e = readdir(d))) {
+      if (e->d_name[0] != '.')
+         continue;
+
+      const char *dot = strrchr(e->d_name, '.');
+      if (dot == e->d_name || dot[1] == '\0')
+         continue;
+
+      char *eptr = NULL;
+      const long pid = strtol(dot + 1, &eptr, 10);
+      if (*eptr != '\0' || pid <= 0 || pid == getpid())
+         continue;
+
+      if (kill(pid, 0) == 0 || errno != ESRCH)
+         continue;
+
+      char path[PATH_MAX];
+      checked_sprintf(path, sizeof(path), "%s" PATH_SEP "%s",
+                      lib->path, e->d_name);
+      if (unlink(path) != 0 && errno != ENOENT)
+         warnf("failed to remove stale temporary file %s: %s",
+               path, strerror(errno));
+   }
+
+   closedir(d);
+#endif
+}
+
 static lib_t lib_init(const char *name, const char *rpath, int lock_fd)
 {
    struct lib *l = xmalloc(sizeof(struct lib));
-   l->n_units = 0;
-   l->units   = NULL;
-   l->name    = upcase_name(name);
-   l->index   = NULL;
-   l->lock_fd = lock_fd;
+   l->n_units   = 0;
+   l->units     = NULL;
+   l->unit_map  = hash_new(64, true);
+   l->name      = upcase_name(name);
+   l->index     = NULL;
+   l->index_map = hash_new(64, true);
+   l->lock_fd   = lock_fd;
 
    if (rpath == NULL)
       l->path[0] = '\0';
@@ -139,27 +257,10 @@ static lib_t lib_init(const char *name, const char *rpath, int lock_fd)
       file_read_lock(l->lock_fd);
    }
 
-   fbuf_t *f = lib_fbuf_open(l, "_index", FBUF_IN);
-   if (f != NULL) {
-      ident_rd_ctx_t ictx = ident_read_begin(f);
+   lib_read_index(l);
 
-      const int entries = read_u32(f);
-      for (int i = 0; i < entries; i++) {
-         ident_t name = ident_read(ictx);
-         tree_kind_t kind = read_u16(f);
-         assert(kind < T_LAST_TREE_KIND);
-
-         lib_index_t *in = xmalloc(sizeof(lib_index_t));
-         in->name = name;
-         in->kind = kind;
-         in->next = l->index;
-
-         l->index = in;
-      }
-
-      ident_read_end(ictx);
-      fbuf_close(f);
-   }
+   if (rpath != NULL)
+      lib_remove_stale_temps(l);
 
    if (l->lock_fd != -1)
       file_unlock(l->lock_fd);
@@ -167,17 +268,6 @@ static lib_t lib_init(const char *name, const char *rpath, int lock_fd)
    return l;
 }
 
-static lib_index_t *lib_find_in_index(lib_t lib, ident_t name)
-{
-   lib_index_t *it;
-   for (it = lib->index;
-        (it != NULL) && (it->name != name);
-        it = it->next)
-      ;
-
-   return it;
-}
-
 static lib_unit_t *lib_put_aux(lib_t lib, tree_t unit,
                                tree_rd_ctx_t ctx, bool dirty,
                                lib_mtime_t mtime)
@@ -188,12 +278,10 @@ static lib_unit_t *lib_put_aux(lib_t lib, tree_t unit,
    lib_unit_t *where = NULL;
    ident_t name = tree_ident(unit);
 
-   for (unsigned i = 0; (where == NULL) && (i < lib->n_units); i++) {
-      if (tree_ident(lib->units[i].top) == tree_ident(unit))
-         where = &(lib->units[i]);
-   }
-
-   if (where == NULL) {
+   const uintptr_t pos = (uintptr_t)hash_get(lib->unit_map, name);
+   if (pos > 0)
+      where = &(lib->units[pos - 1]);
+   else {
       if (lib->n_units == 0) {
          lib->units_alloc = 16;
          lib->units = xmalloc(sizeof(lib_unit_t) * lib->units_alloc);
@@ -205,6 +293,7 @@ static lib_unit_t *lib_put_aux(lib_t lib, tree_t unit,
       }
 
       where = &(lib->units[lib->n_units++]);
+      hash_put(lib->unit_map, name, (void *)(uintptr_t)lib->n_units);
    }
 
    where->top      = unit;
@@ -214,14 +303,8 @@ static lib_unit_t *lib_put_aux(lib_t lib, tree_t unit,
    where->kind     = tree_kind(unit);
 
    lib_index_t *it = lib_find_in_index(lib, name);
-   if (it == NULL) {
-      lib_index_t *new = xmalloc(sizeof(lib_index_t));
-      new->name = name;
-      new->kind = tree_kind(unit);
-      new->next = lib->index;
-
-      lib->index = new;
-   }
+   if (it == NULL)
+      lib_add_to_index(lib, name, tree_kind(unit));
    else
       it->kind = tree_kind(unit);
 
@@ -502,6 +585,8 @@ void lib_free(lib_t lib)
 
    if (lib->units != NULL)
       free(lib->units);
+   hash_free(lib->unit_map);
+   hash_free(lib->index_map);
    free(lib);
 }
 
@@ -537,6 +622,67 @@ void lib_destroy(lib_t lib)
       perror("rmdir");
 }
 
+void lib_reopen_locks(void)
+{
+   // A lock is shared with every process which inherits the descriptor
+   // so a child must open its own to exclude its siblings
+
+   for (lib_list_t *it = loaded; it != NULL; it = it->next) {
+      lib_t lib = it->item;
+      if (lib->lock_fd == -1)
+         continue;
+
+      close(lib->lock_fd);
+
+      const char *lock_path = lib_file_path(lib, "_NVC_LIB");
+      if ((lib->lock_fd = open(lock_path, O_RDONLY)) < 0)
+         fatal_errno("lib_reopen_locks: %s", lock_path);
+   }
+}
+
+void lib_forget(lib_t lib)
+{
+   // Units already returned stay valid but the next request reads the
+   // unit again in case another process has saved it since
+
+   assert(lib != NULL);
+
+   unsigned p = 0;
+   for (unsigned i = 0; i < lib->n_units; i++) {
+      if (lib->units[i].dirty)
+         lib->units[p++] = lib->units[i];
+      else if (lib->units[i].read_ctx != NULL)
+         tree_read_end(lib->units[i].read_ctx);
+   }
+   lib->n_units = p;
+
+   hash_free(lib->unit_map);
+   lib->unit_map = hash_new(64, true);
+
+   while (lib->index != NULL) {
+      lib_index_t *tmp = lib->index->next;
+      free(lib->index);
+      lib->index = tmp;
+   }
+
+   hash_free(lib->index_map);
+   lib->index_map = hash_new(64, true);
+
+   for (unsigned i = 0; i < lib->n_units; i++) {
+      ident_t name = tree_ident(lib->units[i].top);
+      hash_put(lib->unit_map, name, (void *)(uintptr_t)(i + 1));
+      lib_add_to_index(lib, name, lib->units[i].kind);
+   }
+
+   if (lib->lock_fd != -1)
+      file_read_lock(lib->lock_fd);
+
+   lib_read_index(lib);
+
+   if (lib->lock_fd != -1)
+      file_unlock(lib->lock_fd);
+}
+
 lib_t lib_work(void)
 {
    assert(work != NULL);
@@ -580,6 +726,58 @@ static lib_mtime_t lib_stat_mtime(struct stat *st)
    return mt;
 }
 
+static uint64_t lib_hash_source(ident_t file)
+{
+   // FNV-1a over the file contents or zero if it cannot be read
+
+   if (file == NULL)
+      return 0;
+
+   const int fd = open(istr(file), O_RDONLY);
+   if (fd < 0)
+      return 0;
+
+   struct stat st;
+   if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+      close(fd);
+      return 0;
+   }
+
+   // The source is only read again if it changed since it was last
+   // hashed by this process
+   if (src_hashes == NULL)
+      src_hashes = hash_new(64, true);
+
+   const lib_mtime_t mtime = lib_stat_mtime(&st);
+
+   src_hash_t *sh = hash_get(src_hashes, file);
+   if (sh != NULL && sh->mtime == mtime && sh->size == st.st_size) {
+      close(fd);
+      return sh->hash;
+   }
+
+   uint64_t hash = UINT64_C(14695981039346656037);
+   if (st.st_size > 0) {
+      const uint8_t *map = map_file(fd, st.st_size);
+      for (off_t i = 0; i < st.st_size; i++)
+         hash = (hash ^ map[i]) * UINT64_C(1099511628211);
+      unmap_file((void *)map, st.st_size);
+   }
+
+   close(fd);
+
+   if (sh == NULL) {
+      sh = xmalloc(sizeof(src_hash_t));
+      hash_put(src_hashes, file, sh);
+   }
+
+   sh->mtime = mtime;
+   sh->size  = st.st_size;
+   sh->hash  = hash;
+
+   return hash;
+}
+
 static lib_unit_t *lib_get_aux(lib_t lib, ident_t ident)
 {
    assert(lib != NULL);
@@ -593,46 +791,35 @@ static lib_unit_t *lib_get_aux(lib_t lib, ident_t ident)
    }
 
    // Search in the list of already loaded units
-   for (unsigned n = 0; n < lib->n_units; n++) {
-      if (tree_ident(lib->units[n].top) == ident)
-         return &(lib->units[n]);
-   }
+   const uintptr_t pos = (uintptr_t)hash_get(lib->unit_map, ident);
+   if (pos > 0)
+      return &(lib->units[pos - 1]);
 
    if (*(lib->path) == '\0')   // Temporary library
       return NULL;
 
    assert(lib->lock_fd != -1);   // Should not be called in unit tests
-   file_read_lock(lib->lock_fd);
 
-   // Otherwise search in the filesystem
-   DIR *d = opendir(lib->path);
-   if (d == NULL)
-      fatal("%s: %s", lib->path, strerror(errno));
+   // Otherwise open the file named after the unit: this does not need
+   // the index so also finds a unit saved without an index entry. No
+   // lock is needed as units are always renamed into place complete.
+   char path[PATH_MAX];
+   lib_realpath(lib, istr(ident), path, sizeof(path));
 
    lib_unit_t *unit = NULL;
-   const char *search = istr(ident);
-   struct dirent *e;
-   while ((e = readdir(d))) {
-      if (strcmp(e->d_name, search) == 0) {
-         fbuf_t *f = lib_fbuf_open(lib, e->d_name, FBUF_IN);
-         tree_rd_ctx_t ctx = tree_read_begin(f, lib_file_path(lib, e->d_name));
-         tree_t top = tree_read(ctx);
-         fbuf_close(f);
-
-         struct stat st;
-         if (stat(lib_file_path(lib, e->d_name), &st) < 0)
-            fatal_errno("%s", e->d_name);
-
-         lib_mtime_t mt = lib_stat_mtime(&st);
+   struct stat st;
+   if (stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+      fbuf_t *f = fbuf_open(path, FBUF_IN);
+      if (f == NULL)
+         fatal_errno("%s", path);
+
+      tree_rd_ctx_t ctx = tree_read_begin(f, path);
+      tree_t top = tree_read(ctx);
+      fbuf_close(f);
 
-         unit = lib_put_aux(lib, top, ctx, false, mt);
-         break;
-      }
+      unit = lib_put_aux(lib, top, ctx, false, lib_stat_mtime(&st));
    }
 
-   closedir(d);
-   file_unlock(lib->lock_fd);
-
    if (unit == NULL && lib_find_in_index(lib, ident) != NULL)
       fatal("library %s corrupt: unit %s present in index but missing "
             "on disk", istr(lib->name), istr(ident));
@@ -642,15 +829,23 @@ static lib_unit_t *lib_get_aux(lib_t lib, ident_t ident)
 
 lib_mtime_t lib_mtime(lib_t lib, ident_t ident)
 {
+   // Avoid reading the unit if the index has the time it was saved
+   const uintptr_t pos = (uintptr_t)hash_get(lib->unit_map, ident);
+   if (pos == 0) {
+      lib_index_t *it = lib_find_in_index(lib, ident);
+      if (it != NULL && it->mtime != 0)
+         return it->mtime;
+   }
+
    lib_unit_t *lu = lib_get_aux(lib, ident);
    assert(lu != NULL);
    return lu->mtime;
 }
 
-bool lib_stat(lib_t lib, const char *name, lib_mtime_t *mt)
+bool lib_stat_file(const char *path, lib_mtime_t *mt)
 {
    struct stat buf;
-   if (stat(lib_file_path(lib, name), &buf) == 0) {
+   if (stat(path, &buf) == 0) {
       if (mt != NULL)
          *mt = lib_stat_mtime(&buf);
       return true;
@@ -659,6 +854,11 @@ bool lib_stat(lib_t lib, const char *name, lib_mtime_t *mt)
       return false;
 }
 
+bool lib_stat(lib_t lib, const char *name, lib_mtime_t *mt)
+{
+   return lib_stat_file(lib_file_path(lib, name), mt);
+}
+
 tree_t lib_get(lib_t lib, ident_t ident)
 {
    lib_unit_t *lu = lib_get_aux(lib, ident);
@@ -685,8 +885,14 @@ tree_t lib_get_check_stale(lib_t lib, ident_t ident)
       if (!opt_get_int("ignore-time")) {
          const loc_t *loc = tree_loc(lu->top);
 
+         // A source file which is newer but has the same contents as
+         // when the unit was analysed has only been touched or restored
+         lib_index_t *it = lib_find_in_index(lib, tree_ident(lu->top));
+
          struct stat st;
-         if (stat(istr(loc->file), &st) == 0 && lu->mtime < lib_stat_mtime(&st))
+         if (stat(istr(loc->file), &st) == 0 && lu->mtime < lib_stat_mtime(&st)
+             && (it == NULL || it->src_hash == 0
+                 || it->src_hash != lib_hash_source(loc->file)))
             fatal("design unit %s is older than its source file %s and must "
                   "be reanalysed\n(You can use the --ignore-time option to "
                   "skip this check)", istr(ident), istr(loc->file));
@@ -704,47 +910,101 @@ ident_t lib_name(lib_t lib)
    return lib->name;
 }
 
+static fbuf_t *lib_open_temp(lib_t lib, const char *name, char **tmp)
+{
+   // Hidden so it is never mistaken for a unit
+   *tmp = xasprintf(".%s.%d", name, getpid());
+
+   fbuf_t *f = lib_fbuf_open(lib, *tmp, FBUF_OUT);
+   if (f == NULL)
+      fatal("failed to create %s in library %s", name, istr(lib->name));
+
+   return f;
+}
+
+static void lib_rename_temp(lib_t lib, char *tmp, const char *name)
+{
+   // Readers which already opened the old file keep their mapping of
+   // it and any later reader sees the complete new file
+   char from[PATH_MAX];
+   lib_realpath(lib, tmp, from, sizeof(from));
+
+   if (rename(from, lib_file_path(lib, name)) != 0)
+      fatal_errno("rename %s", from);
+
+   free(tmp);
+}
+
 void lib_save(lib_t lib)
 {
    assert(lib != NULL);
 
    assert(lib->lock_fd != -1);   // Should not be called in unit tests
-   file_write_lock(lib->lock_fd);
+
+   // Each unit is written to a temporary file and renamed into place
+   // so only the index update needs to exclude other processes
+
+   ident_t last_file = NULL;
+   uint64_t last_hash = 0;
 
    for (unsigned n = 0; n < lib->n_units; n++) {
       if (lib->units[n].dirty) {
-         const char *name = istr(tree_ident(lib->units[n].top));
-         fbuf_t *f = lib_fbuf_open(lib, name, FBUF_OUT);
-         if (f == NULL)
-            fatal("failed to create %s in library %s", name, istr(lib->name));
+         ident_t name_i = tree_ident(lib->units[n].top);
+         const char *name = istr(name_i);
+
+         char *tmp;
+         fbuf_t *f = lib_open_temp(lib, name, &tmp);
          tree_wr_ctx_t ctx = tree_write_begin(f);
          tree_write(lib->units[n].top, ctx);
          tree_write_end(ctx);
          fbuf_close(f);
 
+         lib_rename_temp(lib, tmp, name);
+
          lib->units[n].dirty = false;
+
+         struct stat st;
+         if (stat(lib_file_path(lib, name), &st) != 0)
+            fatal_errno("%s", name);
+
+         // Units are usually saved together with others from the
+         // same source file
+         ident_t file = tree_loc(lib->units[n].top)->file;
+         if (file != last_file) {
+            last_file = file;
+            last_hash = lib_hash_source(file);
+         }
+
+         lib_index_t *it = lib_find_in_index(lib, name_i);
+         assert(it != NULL);
+         it->mtime    = lib_stat_mtime(&st);
+         it->src_hash = last_hash;
       }
    }
 
-   lib_index_t *it;
-   int index_sz = 0;
-   for (it = lib->index; it != NULL; it = it->next, ++index_sz)
-      ;
+   file_write_lock(lib->lock_fd);
 
-   fbuf_t *f = lib_fbuf_open(lib, "_index", FBUF_OUT);
-   if (f == NULL)
-      fatal("failed to create library %s index", istr(lib->name));
+   // Another process may have added units since the index was read
+   lib_read_index(lib);
+
+   char *tmp;
+   fbuf_t *f = lib_open_temp(lib, "_index", &tmp);
 
    ident_wr_ctx_t ictx = ident_write_begin(f);
 
-   write_u32(index_sz, f);
-   for (it = lib->index; it != NULL; it = it->next) {
+   write_u32(INDEX_MAGIC, f);
+   write_u32(lib_index_size(lib), f);
+   for (lib_index_t *it = lib->index; it != NULL; it = it->next) {
       ident_write(it->name, ictx);
       write_u16(it->kind, f);
+      write_u64(it->mtime, f);
+      write_u64(it->src_hash, f);
    }
 
    ident_write_end(ictx);
    fbuf_close(f);
+
+   lib_rename_temp(lib, tmp, "_index");
    file_unlock(lib->lock_fd);
 }
 
@@ -752,13 +1012,8 @@ int lib_index_kind(lib_t lib, ident_t ident)
 {
    assert(lib != NULL);
 
-   lib_index_t *it;
-   for (it = lib->index; it != NULL; it = it->next) {
-      if (it->name == ident)
-         return it->kind;
-   }
-
-   return T_LAST_TREE_KIND;
+   lib_index_t *it = lib_find_in_index(lib, ident);
+   return (it == NULL) ? T_LAST_TREE_KIND : it->kind;
 }
 
 void lib_walk_index(lib_t lib, lib_index_fn_t fn, void *context)
@@ -45,8 +45,11 @@ void lib_mkdir(lib_t lib, const char *name);
 const char *lib_enum_search_paths(void **token);
 void lib_add_search_path(const char *path);
 bool lib_stat(lib_t lib, const char *name, lib_mtime_t *mt);
+bool lib_stat_file(const char *path, lib_mtime_t *mt);
 void lib_add_map(const char *name, const char *path);
 void lib_delete(lib_t lib, const char *name);
+void lib_reopen_locks(void);
+void lib_forget(lib_t lib);
 
 lib_t lib_work(void);
 void lib_set_work(lib_t lib);
@@ -21,6 +21,7 @@
 #include "common.h"
 #include "rt/rt.h"
 #include "hash.h"
+#include "mem.h"
 
 #include <assert.h>
 #include <stdlib.h>
@@ -38,7 +39,8 @@ typedef enum {
    INSTANCE_NAME
 } name_attr_t;
 
-#define MAX_CASE_ARCS 32
+#define MAX_CASE_ARCS  32
+#define MAX_CASE_TABLE 4096
 
 typedef struct case_arc   case_arc_t;
 typedef struct case_state case_state_t;
@@ -65,6 +67,13 @@ struct case_state {
    case_arc_t    arcs[MAX_CASE_ARCS];
 };
 
+// Choice of a case statement with its selector packed into an integer
+typedef struct {
+   int64_t key;
+   tree_t  stmts;
+   tree_t  name;
+} case_choice_t;
+
 typedef enum {
    LOWER_NORMAL,
    LOWER_THUNK
@@ -80,6 +89,9 @@ static const char  *verbose = NULL;
 static bool         tmp_alloc_used = false;
 static lower_mode_t mode = LOWER_NORMAL;
 static hash_t      *vcode_objs = NULL;
+static hash_t      *unique_names = NULL;
+static unsigned     checks_elided = 0;
+static unsigned     checks_total = 0;
 
 static vcode_reg_t lower_expr(tree_t expr, expr_ctx_t ctx);
 static vcode_reg_t lower_reify_expr(tree_t expr);
@@ -336,15 +348,58 @@ static vcode_type_t lower_array_type(type_t type)
       return vtype_uarray(array_dimension(type), elem_type, elem_bounds);
 }
 
+static ident_t lower_unique_suffix(const char *key)
+{
+   // Derive a unique suffix from a hash of the key rather than the address
+   // of the object so the same names are generated each time a design is
+   // elaborated and the generated code can be cached. The key identifies
+   // the declaration so an object read again from a library gets the
+   // same suffix as before.
+
+   if (unique_names == NULL)
+      unique_names = hash_new(256, true);
+
+   ident_t key_i = ident_new(key);
+
+   uint64_t id = hash_bytes(key, strlen(key), 0);
+   for (;;) {
+      char buf[32];
+      checked_sprintf(buf, sizeof(buf), "%"PRIx64, id);
+
+      ident_t suffix = ident_new(buf);
+      ident_t prev = hash_get(unique_names, suffix);
+      if (prev == NULL) {
+         hash_put(unique_names, suffix, key_i);
+         return suffix;
+      }
+      else if (prev == key_i)
+         return suffix;
+
+      id++;   // Different key with the same hash
+   }
+}
+
 static ident_t lower_record_unique_name(type_t type)
 {
    // If a record type is not qualified with a package name then add a unique
    // suffix to its type name to avoid collisions
    ident_t name = type_ident(type);
    if (ident_until(name, '.') == name) {
-      char buf[32];
-      checked_sprintf(buf, sizeof(buf), "%"PRIxPTR, (uintptr_t)type);
-      return ident_prefix(name, ident_new(buf), '@');
+      // Types with the same name declared in different places must
+      // have different suffixes so the key includes where the first
+      // field or declaration is
+      tree_t first = NULL;
+      if (type_kind(type) == T_RECORD && type_fields(type) > 0)
+         first = type_field(type, 0);
+      else if (type_kind(type) == T_PROTECTED && type_decls(type) > 0)
+         first = type_decl(type, 0);
+
+      const loc_t *loc = first ? tree_loc(first) : NULL;
+      char *key LOCAL = xasprintf("%s:%d:%d:%s",
+                                  loc && loc->file ? istr(loc->file) : "",
+                                  loc ? loc->first_line : 0,
+                                  loc ? loc->first_column : 0, istr(name));
+      return ident_prefix(name, lower_unique_suffix(key), '@');
    }
    else
       return name;
@@ -596,6 +651,18 @@ static void lower_check_scalar_bounds(vcode_reg_t value, type_t type,
    }
 }
 
+static bool lower_elide_bounds(tree_t stmt)
+{
+   // The bounds checker proved the assigned value is always in range
+   checks_total++;
+   if (tree_attr_int(stmt, elide_bounds_i, 0)) {
+      checks_elided++;
+      return true;
+   }
+   else
+      return false;
+}
+
 static bool lower_have_signal(vcode_reg_t reg)
 {
    const vtype_kind_t reg_kind = vcode_reg_kind(reg);
@@ -902,7 +969,12 @@ static ident_t lower_mangle_func(tree_t decl, vcode_unit_t context)
       else if (lib_loaded(ident_until(name, '.')))
          save_mangled_name = true;   // Subprogram in package
       else {
-         prefix = xasprintf("p%"PRIxPTR"__", (uintptr_t)decl);
+         const loc_t *loc = tree_loc(decl);
+         char *key LOCAL = xasprintf("%s:%d:%d:%s",
+                                     loc->file ? istr(loc->file) : "",
+                                     loc->first_line, loc->first_column,
+                                     istr(name));
+         prefix = xasprintf("p%s__", istr(lower_unique_suffix(key)));
          save_mangled_name = false;
       }
    }
@@ -1830,7 +1902,10 @@ static vcode_reg_t lower_array_ref_offset(tree_t ref, vcode_reg_t array)
 
       vcode_reg_t offset = lower_reify_expr(tree_value(p));
 
-      if (!elide_bounds)
+      checks_total++;
+      if (elide_bounds)
+         checks_elided++;
+      else
          lower_check_array_bounds(value_type, i,
                                   (alias ? VCODE_INVALID_REG : array), offset,
                                   tree_value(p), NULL);
@@ -2416,6 +2491,93 @@ static vcode_reg_t lower_record_aggregate(tree_t expr, bool nest,
    }
 }
 
+static bool lower_can_use_template(tree_t agg, type_t type)
+{
+   // A one dimensional aggregate with constant bounds where any values
+   // which are not constant are given by position or name can be
+   // copied from a constant template and patched afterwards
+
+   if (array_dimension(type) > 1 || !lower_const_bounds(type))
+      return false;
+
+   type_t elem = type_elem(type);
+   if (!type_is_integer(elem) && !type_is_enum(elem))
+      return false;
+
+   const int nassocs = tree_assocs(agg);
+   for (int i = 0; i < nassocs; i++) {
+      tree_t a = tree_assoc(agg, i);
+      switch (tree_subkind(a)) {
+      case A_NAMED:
+         if (!lower_is_const(tree_name(a)))
+            return false;
+         break;
+
+      case A_RANGE:
+         {
+            range_t r = tree_range(a, 0);
+            if (!lower_is_const(r.left) || !lower_is_const(r.right))
+               return false;
+            else if (!lower_is_const(tree_value(a)))
+               return false;
+         }
+         break;
+
+      case A_OTHERS:
+         if (!lower_is_const(tree_value(a)))
+            return false;
+         break;
+
+      default:
+         break;
+      }
+   }
+
+   return lower_array_const_size(type) > 0;
+}
+
+static vcode_reg_t lower_template_aggregate(tree_t agg, type_t type)
+{
+   int nvals;
+   vcode_reg_t *values LOCAL =
+      lower_const_array_aggregate(agg, type, 0, &nvals);
+
+   emit_comment("Begin template aggregate line %d", tree_loc(agg)->first_line);
+
+   vcode_reg_t *consts LOCAL = xmalloc(nvals * sizeof(vcode_reg_t));
+   for (int i = 0; i < nvals; i++) {
+      values[i] = lower_reify(values[i]);
+
+      int64_t value;
+      if (vcode_reg_const(values[i], &value))
+         consts[i] = emit_const(vcode_reg_type(values[i]), value);
+      else {
+         const int64_t low = vtype_low(vcode_reg_bounds(values[i]));
+         consts[i] = emit_const(vcode_reg_type(values[i]), low);
+      }
+   }
+
+   type_t elem = type_elem(type);
+   vcode_reg_t len_reg = emit_const(vtype_offset(), nvals);
+   vcode_reg_t mem_reg =
+      emit_alloca(lower_type(elem), lower_bounds(elem), len_reg);
+
+   vcode_reg_t template_reg =
+      emit_const_array(lower_type(type), consts, nvals, true);
+   emit_copy(mem_reg, template_reg, len_reg);
+
+   for (int i = 0; i < nvals; i++) {
+      int64_t value;
+      if (vcode_reg_const(values[i], &value))
+         continue;
+
+      vcode_reg_t ptr_reg = emit_add(mem_reg, emit_const(vtype_offset(), i));
+      emit_store_indirect(values[i], ptr_reg);
+   }
+
+   return mem_reg;
+}
+
 static vcode_reg_t lower_aggregate(tree_t expr, expr_ctx_t ctx)
 {
    type_t type = tree_type(expr);
@@ -2432,6 +2594,8 @@ static vcode_reg_t lower_aggregate(tree_t expr, expr_ctx_t ctx)
 
       return emit_const_array(lower_type(type), values, nvals, true);
    }
+   else if (lower_can_use_template(expr, type))
+      return lower_template_aggregate(expr, type);
    else
       return lower_dyn_aggregate(expr, type);
 }
@@ -3260,7 +3424,7 @@ static void lower_var_assign(tree_t stmt)
       vcode_reg_t value_reg = lower_expr(value, EXPR_RVALUE);
       vcode_reg_t loaded_value = lower_reify(value_reg);
       vcode_var_t var = VCODE_INVALID_VAR;
-      if (is_scalar)
+      if (is_scalar && !lower_elide_bounds(stmt))
          lower_check_scalar_bounds(loaded_value, type, stmt, NULL);
       if (is_var_decl
           && (var = lower_get_var(tree_ref(target))) != VCODE_INVALID_VAR)
@@ -3302,6 +3466,61 @@ static void lower_var_assign(tree_t stmt)
    lower_cleanup_temp_objects(saved_heap);
 }
 
+static bool lower_signal_assign_elem(tree_t a, tree_t *decl,
+                                     int64_t *index)
+{
+   if (tree_subkind(a) != A_POS)
+      return false;
+
+   tree_t value = tree_value(a);
+   if (tree_kind(value) != T_ARRAY_REF || tree_params(value) != 1)
+      return false;
+
+   tree_t prefix = tree_value(value);
+   if (tree_kind(prefix) != T_REF)
+      return false;
+
+   type_t type = tree_type(prefix);
+   if (!lower_const_bounds(type) || array_dimension(type) > 1
+       || !type_is_scalar(type_elem(type)))
+      return false;
+
+   if (!folded_int(tree_value(tree_param(value, 0)), index))
+      return false;
+
+   if (range_of(type, 0).kind == RANGE_DOWNTO)
+      *index = -*index;
+
+   *decl = tree_ref(prefix);
+   return true;
+}
+
+static int lower_signal_assign_run(tree_t target, int first)
+{
+   // Count the associations in an aggregate target starting at first
+   // which name adjacent elements of the same signal: their nets are
+   // contiguous so they can be driven by a single transaction
+
+   tree_t decl0;
+   int64_t index0;
+   if (!lower_signal_assign_elem(tree_assoc(target, first), &decl0, &index0))
+      return 1;
+
+   const int nassocs = tree_assocs(target);
+   int length = 1;
+   for (; first + length < nassocs; length++) {
+      tree_t decl;
+      int64_t index;
+      if (!lower_signal_assign_elem(tree_assoc(target, first + length),
+                                    &decl, &index))
+         break;
+      else if (decl != decl0 || index != index0 + length)
+         break;
+   }
+
+   return length;
+}
+
 static void lower_signal_assign(tree_t stmt)
 {
    const int saved_heap = emit_heap_save();
@@ -3343,7 +3562,7 @@ static void lower_signal_assign(tree_t stmt)
 
       vcode_reg_t rhs = lower_expr(wvalue, EXPR_RVALUE);
 
-      if (type_is_scalar(target_type))
+      if (type_is_scalar(target_type) && !lower_elide_bounds(stmt))
          lower_check_scalar_bounds(lower_reify(rhs), target_type, wvalue, NULL);
       else if (type_is_array(target_type))
          lower_check_array_sizes(wvalue, target_type, tree_type(wvalue),
@@ -3372,8 +3591,19 @@ static void lower_signal_assign(tree_t stmt)
          rhs = lower_array_data(rhs);
 
       for (int i = 0; i < nparts; i++) {
+         const int run = (aggregate && type_is_scalar(part_type))
+            ? lower_signal_assign_run(target, i) : 1;
+
          if (nets[i] == VCODE_INVALID_REG)
             ;
+         else if (run > 1) {
+            emit_sched_waveform(nets_raw[i], emit_const(vtype_offset(), run),
+                                rhs, reject, after);
+
+            if (i + run < nparts)
+               rhs = emit_addi(rhs, run);
+            i += run - 1;
+         }
          else if (type_is_array(part_type)) {
             assert(i == 0);
             vcode_reg_t data_reg = lower_array_data(rhs);
@@ -3723,8 +3953,234 @@ static void lower_loop_control(tree_t stmt, loop_stack_t *loops)
    vcode_select_block(false_bb);
 }
 
+static bool lower_case_const_assign(tree_t stmts, tree_t *target,
+                                    int64_t *value)
+{
+   if (tree_kind(stmts) != T_BLOCK || tree_stmts(stmts) != 1)
+      return false;
+
+   tree_t s = tree_stmt(stmts, 0);
+   if (tree_kind(s) != T_VAR_ASSIGN
+       || tree_attr_int(s, stmt_tag_i, -1) != -1)
+      return false;
+
+   tree_t t = tree_target(s);
+   if (tree_kind(t) != T_REF || tree_kind(tree_ref(t)) != T_VAR_DECL
+       || !type_is_scalar(tree_type(t)))
+      return false;
+   else if (*target != NULL && tree_ref(*target) != tree_ref(t))
+      return false;
+
+   unsigned pos;
+   tree_t v = tree_value(s);
+   if (folded_enum(v, &pos))
+      *value = pos;
+   else if (!folded_int(v, value))
+      return false;
+
+   *target = t;
+   return true;
+}
+
+static bool lower_case_table(vcode_reg_t key_reg, const case_choice_t *choices,
+                             int nchoices, tree_t others, int64_t nkeys)
+{
+   // A case statement where every alternative only assigns a constant to
+   // the same variable becomes a load from a table indexed by the key
+
+   if (nkeys > MAX_CASE_TABLE)
+      return false;
+
+   tree_t target = NULL;
+   int64_t others_value = 0;
+   if (others != NULL && !lower_case_const_assign(others, &target,
+                                                  &others_value))
+      return false;
+
+   int64_t *values LOCAL = xmalloc(MAX(nchoices, 1) * sizeof(int64_t));
+   for (int i = 0; i < nchoices; i++) {
+      if (!lower_case_const_assign(choices[i].stmts, &target, &(values[i])))
+         return false;
+   }
+
+   if (target == NULL)
+      return false;
+   else if (others == NULL)
+      others_value = values[0];   // Any other key is unreachable
+
+   vcode_type_t vtype = lower_type(tree_type(target));
+   vcode_reg_t *table LOCAL = xmalloc(nkeys * sizeof(vcode_reg_t));
+
+   vcode_reg_t others_reg = emit_const(vtype, others_value);
+   for (int64_t i = 0; i < nkeys; i++)
+      table[i] = others_reg;
+
+   for (int i = 0; i < nchoices; i++)
+      table[choices[i].key] = emit_const(vtype, values[i]);
+
+   vcode_reg_t table_reg =
+      emit_const_array(vtype_pointer(vtype), table, nkeys, true);
+   vcode_reg_t value_reg = lower_reify(emit_add(table_reg, key_reg));
+
+   vcode_var_t var = lower_get_var(tree_ref(target));
+   if (var != VCODE_INVALID_VAR)
+      emit_store(value_reg, var);
+   else
+      emit_store_indirect(value_reg, lower_expr(target, EXPR_LVALUE));
+
+   return true;
+}
+
+static int lower_case_choice_cmp(const void *a, const void *b)
+{
+   const case_choice_t *l = a, *r = b;
+   return l->key < r->key ? -1 : (l->key > r->key ? 1 : 0);
+}
+
+static void lower_case_dispatch(vcode_reg_t key_reg, case_choice_t *choices,
+                                int nchoices, tree_t others, int64_t nkeys,
+                                loop_stack_t *loops)
+{
+   qsort(choices, nchoices, sizeof(case_choice_t), lower_case_choice_cmp);
+
+   for (int i = 1; i < nchoices; i++) {
+      if (choices[i].key == choices[i - 1].key)
+         fatal_at(tree_loc(choices[i].name),
+                  "duplicate choice in case statement");
+   }
+
+   if (lower_case_table(key_reg, choices, nchoices, others, nkeys))
+      return;
+
+   vcode_block_t start_bb  = vcode_active_block();
+   vcode_block_t exit_bb   = emit_block();
+   vcode_block_t others_bb = exit_bb;
+
+   vcode_block_t *blocks LOCAL =
+      xmalloc(MAX(nchoices, 1) * sizeof(vcode_block_t));
+   vcode_reg_t *cases LOCAL = xmalloc(MAX(nchoices, 1) * sizeof(vcode_reg_t));
+
+   // Each alternative is lowered once however many choices select it
+   hash_t *stmt_bb = hash_new(nchoices * 2 + 1, true);
+
+   for (int i = 0; i < nchoices; i++) {
+      void *bb = hash_get(stmt_bb, choices[i].stmts);
+      if (bb == NULL) {
+         blocks[i] = emit_block();
+         hash_put(stmt_bb, choices[i].stmts,
+                  (void *)(uintptr_t)(blocks[i] + 1));
+
+         vcode_select_block(blocks[i]);
+         lower_stmt(choices[i].stmts, loops);
+         if (!vcode_block_finished())
+            emit_jump(exit_bb);
+      }
+      else
+         blocks[i] = (uintptr_t)bb - 1;
+   }
+
+   hash_free(stmt_bb);
+
+   if (others != NULL) {
+      others_bb = emit_block();
+      vcode_select_block(others_bb);
+      lower_stmt(others, loops);
+      if (!vcode_block_finished())
+         emit_jump(exit_bb);
+   }
+
+   vcode_select_block(start_bb);
+
+   for (int i = 0; i < nchoices; i++)
+      cases[i] = emit_const(vtype_offset(), choices[i].key);
+
+   emit_case(key_reg, others_bb, cases, blocks, nchoices);
+
+   vcode_select_block(exit_bb);
+}
+
+static bool lower_case_scalar_table(tree_t stmt)
+{
+   type_t type = tree_type(tree_value(stmt));
+
+   int64_t low, high;
+   if (!folded_bounds(range_of(type, 0), &low, &high)
+       || high - low >= MAX_CASE_TABLE)
+      return false;
+
+   const int nassocs = tree_assocs(stmt);
+
+   int nchoices = 0, max_choices = 16;
+   case_choice_t *choices LOCAL =
+      xmalloc(max_choices * sizeof(case_choice_t));
+   tree_t others = NULL;
+
+   for (int i = 0; i < nassocs; i++) {
+      tree_t a = tree_assoc(stmt, i);
+      switch (tree_subkind(a)) {
+      case A_OTHERS:
+         others = tree_value(a);
+         break;
+
+      case A_NAMED:
+         {
+            case_choice_t c = {
+               .key   = assume_int(tree_name(a)) - low,
+               .stmts = tree_value(a),
+               .name  = tree_name(a)
+            };
+            ARRAY_APPEND(choices, c, nchoices, max_choices);
+         }
+         break;
+
+      case A_RANGE:
+         {
+            int64_t rlow, rhigh;
+            range_bounds(tree_range(a, 0), &rlow, &rhigh);
+
+            for (int64_t j = rlow; j <= rhigh; j++) {
+               case_choice_t c = {
+                  .key   = j - low,
+                  .stmts = tree_value(a),
+                  .name  = tree_range(a, 0).left
+               };
+               ARRAY_APPEND(choices, c, nchoices, max_choices);
+            }
+         }
+         break;
+      }
+   }
+
+   for (int i = 0; i < nchoices; i++) {
+      if (choices[i].key < 0 || choices[i].key > high - low)
+         return false;
+   }
+
+   // Only build the key once it is known the table can be used
+   tree_t target = NULL;
+   int64_t value;
+   if (others != NULL && !lower_case_const_assign(others, &target, &value))
+      return false;
+   for (int i = 0; i < nchoices; i++) {
+      if (!lower_case_const_assign(choices[i].stmts, &target, &value))
+         return false;
+   }
+
+   vcode_reg_t value_reg = lower_reify_expr(tree_value(stmt));
+   vcode_reg_t cast_reg  =
+      emit_cast(vtype_offset(), VCODE_INVALID_TYPE, value_reg);
+   vcode_reg_t key_reg   =
+      emit_sub(cast_reg, emit_const(vtype_offset(), low));
+
+   return lower_case_table(key_reg, choices, nchoices, others,
+                           high - low + 1);
+}
+
 static void lower_case_scalar(tree_t stmt, loop_stack_t *loops)
 {
+   if (lower_case_scalar_table(stmt))
+      return;
+
    const int nassocs = tree_assocs(stmt);
 
    vcode_block_t start_bb = vcode_active_block();
@@ -3977,10 +4433,86 @@ static void lower_case_cleanup(case_state_t *state, bool root)
       free(state);
 }
 
+static bool lower_case_packed(tree_t stmt, loop_stack_t *loops)
+{
+   // A short enough array of enumeration elements is packed into an
+   // integer key with one digit per element so the whole selector is
+   // compared with a single switch rather than one for each element
+
+   type_t type = tree_type(tree_value(stmt));
+   type_t elem = type_base_recur(type_elem(type));
+   if (type_kind(elem) != T_ENUM)
+      return false;
+
+   int64_t length;
+   if (!folded_length(range_of(type, 0), &length))
+      return false;
+
+   const int64_t radix = type_enum_literals(elem);
+
+   int64_t nkeys = 1;
+   for (int64_t i = 0; i < length; i++) {
+      if (nkeys > INT64_MAX / radix)
+         return false;
+      nkeys *= radix;
+   }
+
+   const int nassocs = tree_assocs(stmt);
+
+   case_choice_t *choices LOCAL =
+      xmalloc(MAX(nassocs, 1) * sizeof(case_choice_t));
+   int nchoices = 0;
+   tree_t others = NULL;
+
+   for (int i = 0; i < nassocs; i++) {
+      tree_t a = tree_assoc(stmt, i);
+      switch (tree_subkind(a)) {
+      case A_NAMED:
+         {
+            tree_t name = tree_name(a);
+            int64_t key = 0;
+            for (int64_t j = 0; j < length; j++)
+               key = key * radix + lower_case_find_choice_element(name, j);
+
+            case_choice_t *c = &(choices[nchoices++]);
+            c->key   = key;
+            c->stmts = tree_value(a);
+            c->name  = name;
+         }
+         break;
+
+      case A_OTHERS:
+         others = tree_value(a);
+         break;
+
+      default:
+         assert(false);
+      }
+   }
+
+   vcode_reg_t val = lower_expr(tree_value(stmt), EXPR_RVALUE);
+   vcode_reg_t data_ptr = lower_array_data(val);
+
+   vcode_reg_t radix_reg = emit_const(vtype_offset(), radix);
+   vcode_reg_t key_reg = emit_const(vtype_offset(), 0);
+   for (int64_t i = 0; i < length; i++) {
+      vcode_reg_t elem_reg = lower_reify(emit_addi(data_ptr, i));
+      vcode_reg_t cast_reg =
+         emit_cast(vtype_offset(), VCODE_INVALID_TYPE, elem_reg);
+      key_reg = emit_add(emit_mul(key_reg, radix_reg), cast_reg);
+   }
+
+   lower_case_dispatch(key_reg, choices, nchoices, others, nkeys, loops);
+   return true;
+}
+
 static void lower_case_array(tree_t stmt, loop_stack_t *loops)
 {
-   // Case staments on arrays are implemented by building a decision tree
-   // where each state is mapped to a basic block
+   if (lower_case_packed(stmt, loops))
+      return;
+
+   // Other case staments on arrays are implemented by building a
+   // decision tree where each state is mapped to a basic block
 
    vcode_block_t exit_bb   = emit_block();
    vcode_block_t others_bb = exit_bb;
@@ -4491,6 +5023,8 @@ static void lower_finished(void)
 {
    vcode_opt();
 
+   phase_add_ops(vcode_count_unit_ops());
+
    if (verbose != NULL) {
       if (*verbose == '\0' || strstr(istr(vcode_unit_name()), verbose) != NULL)
          vcode_dump();
@@ -4920,6 +5454,8 @@ static void lower_driver_fn(tree_t t, void *_ctx)
 
 static void lower_process(tree_t proc, vcode_unit_t context)
 {
+   phase_begin("lower");
+
    vcode_unit_t vu = emit_process(tree_ident(proc), context);
    emit_debug_info(tree_loc(proc));
 
@@ -4942,6 +5478,10 @@ static void lower_process(tree_t proc, vcode_unit_t context)
    emit_return(VCODE_INVALID_REG);
 
    lower_finished();
+
+   phase_end(tree_ident(proc));
+
+   mem_check("lowering %s", istr(tree_ident(proc)));
 }
 
 static vcode_unit_t lower_elab(tree_t unit)
@@ -5096,3 +5636,9 @@ vcode_unit_t lower_func(tree_t body)
 
    return vu;
 }
+
+void lower_bounds_stats(unsigned *elided, unsigned *total)
+{
+   *elided = checks_elided;
+   *total  = checks_total;
+}
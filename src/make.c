@@ -18,6 +18,7 @@
 #include "common.h"
 #include "phase.h"
 #include "util.h"
+#include "hash.h"
 
 #include <limits.h>
 #include <unistd.h>
@@ -29,6 +30,10 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#ifndef __MINGW32__
+#include <sys/wait.h>
+#endif
+
 typedef enum {
    MAKE_TREE,
    MAKE_LIB,
@@ -45,15 +50,29 @@ typedef enum {
    RULE_ELABORATE
 } rule_kind_t;
 
+typedef enum {
+   BUILD_WAITING,
+   BUILD_RUNNING,
+   BUILD_CURRENT,    // Outputs were already up to date
+   BUILD_DONE,
+   BUILD_FAILED
+} build_state_t;
+
 struct rule {
-   rule_t       *next;
-   rule_kind_t   kind;
-   ident_list_t *outputs;
-   ident_list_t *inputs;
-   ident_t       source;
+   rule_t        *next;
+   rule_kind_t    kind;
+   ident_list_t  *outputs;
+   ident_list_t  *inputs;
+   ident_t        source;
+   rule_t       **deps;     // Rules for the other inputs when building
+   unsigned       ndeps;
+   unsigned       max_deps;
+   build_state_t  state;
+   int            pid;
 };
 
 static ident_t make_tag_i;
+static int     make_generation = 0;
 
 static lib_t make_get_lib(ident_t name)
 {
@@ -78,19 +97,17 @@ static const char *make_product(tree_t t, make_product_t product)
       checked_sprintf(buf, PATH_MAX, "%s/_%s.vcode", path, istr(name));
       break;
 
+   // These must match the files written by the code generator or the
+   // rules are always out of date with --build: the elaborated design is
+   // linked into _NAME.so like any other unit and the import library
+   // for Windows is _NAME.lib
    case MAKE_SO:
-      checked_sprintf(buf, PATH_MAX, "%s/_%s.so", path, istr(name));
+   case MAKE_FINAL_SO:
+      checked_sprintf(buf, PATH_MAX, "%s/_%s." DLL_EXT, path, istr(name));
       break;
 
    case MAKE_IMPLIB:
-      checked_sprintf(buf, PATH_MAX, "%s/_%s.a", path, istr(name));
-      break;
-
-   case MAKE_FINAL_SO:
-      {
-         ident_t base = ident_runtil(name, '.');
-         checked_sprintf(buf, PATH_MAX, "%s/_%s.final.so", path, istr(base));
-      }
+      checked_sprintf(buf, PATH_MAX, "%s/_%s.lib", path, istr(name));
       break;
 
    case MAKE_LIB:
@@ -135,12 +152,10 @@ static rule_t *make_rule_for_source(rule_t **all, rule_kind_t kind,
          return it;
    }
 
-   rule_t *new = xmalloc(sizeof(rule_t));
-   new->inputs  = NULL;
-   new->outputs = NULL;
-   new->kind    = kind;
-   new->next    = *all;
-   new->source  = ident;
+   rule_t *new = xcalloc(sizeof(rule_t));
+   new->kind   = kind;
+   new->next   = *all;
+   new->source = ident;
 
    *all = new;
    return new;
@@ -152,6 +167,7 @@ static void make_free_rules(rule_t *list)
       rule_t *tmp = list->next;
       ident_list_free(list->inputs);
       ident_list_free(list->outputs);
+      free(list->deps);
       free(list);
       list = tmp;
    }
@@ -189,10 +205,12 @@ static char *make_elab_name(tree_t t)
 
 static void make_rule(tree_t t, rule_t **rules)
 {
-   if (tree_attr_int(t, make_tag_i, 0))
+   // The tag holds the generation of the last call to visit the unit
+   // as the same trees may be visited again by a later build
+   if (tree_attr_int(t, make_tag_i, 0) == make_generation)
       return;
    else
-      tree_add_attr_int(t, make_tag_i, 1);
+      tree_add_attr_int(t, make_tag_i, make_generation);
 
    lib_t work = make_get_lib(tree_ident(t));
    if (work != lib_work())
@@ -232,7 +250,9 @@ static void make_rule(tree_t t, rule_t **rules)
       case T_PACK_BODY:
          make_rule_add_output(r, make_product(t, MAKE_VCODE));
          make_rule_add_output(r, make_product(t, MAKE_SO));
+#ifdef IMPLIB_REQUIRED
          make_rule_add_output(r, make_product(t, MAKE_IMPLIB));
+#endif
       }
       // Fall-through
 
@@ -389,17 +409,23 @@ static void make_add_target(ident_t name, int kind, void *context)
    *(*outp)++ = lib_get(lib_work(), name);
 }
 
+static tree_t *make_all_units(int *count)
+{
+   lib_t work = lib_work();
+   *count = lib_index_size(work);
+   tree_t *targets = xmalloc(*count * sizeof(tree_t));
+   tree_t *outp = targets;
+   lib_walk_index(work, make_add_target, &outp);
+   return targets;
+}
+
 void make(tree_t *targets, int count, FILE *out)
 {
    make_tag_i = ident_new("make_tag");
+   make_generation++;
 
-   if (count == 0) {
-      lib_t work = lib_work();
-      count = lib_index_size(work);
-      targets = xmalloc(count * sizeof(tree_t));
-      tree_t *outp = targets;
-      lib_walk_index(work, make_add_target, &outp);
-   }
+   if (count == 0)
+      targets = make_all_units(&count);
 
    make_header(targets, count, out);
 
@@ -425,3 +451,223 @@ void make(tree_t *targets, int count, FILE *out)
 
    free(targets);
 }
+
+static bool make_is_output(rule_t *r, ident_t name)
+{
+   for (ident_list_t *it = r->outputs; it != NULL; it = it->next) {
+      if (it->ident == name)
+         return true;
+   }
+
+   return false;
+}
+
+static void make_link_deps(rule_t *rules)
+{
+   hash_t *producer = hash_new(256, true);
+
+   for (rule_t *r = rules; r != NULL; r = r->next) {
+      for (ident_list_t *it = r->outputs; it != NULL; it = it->next)
+         hash_put(producer, it->ident, r);
+   }
+
+   for (rule_t *r = rules; r != NULL; r = r->next) {
+      for (ident_list_t *it = r->inputs; it != NULL; it = it->next) {
+         rule_t *dep = hash_get(producer, it->ident);
+         if (dep == NULL || dep == r)
+            continue;
+
+         bool dup = false;
+         for (unsigned i = 0; i < r->ndeps && !dup; i++)
+            dup = (r->deps[i] == dep);
+
+         if (!dup) {
+            if (r->deps == NULL) {
+               r->max_deps = 4;
+               r->deps = xmalloc(r->max_deps * sizeof(rule_t *));
+            }
+            ARRAY_APPEND(r->deps, dep, r->ndeps, r->max_deps);
+         }
+      }
+   }
+
+   hash_free(producer);
+}
+
+static bool make_out_of_date(rule_t *r)
+{
+   // The same test as make: an output is missing or older than one of
+   // the inputs
+
+   lib_mtime_t oldest = UINT64_MAX;
+   for (ident_list_t *it = r->outputs; it != NULL; it = it->next) {
+      lib_mtime_t mt;
+      if (!lib_stat_file(istr(it->ident), &mt))
+         return true;
+      oldest = MIN(oldest, mt);
+   }
+
+   for (ident_list_t *it = r->inputs; it != NULL; it = it->next) {
+      if (make_is_output(r, it->ident))
+         continue;
+
+      lib_mtime_t mt;
+      if (!lib_stat_file(istr(it->ident), &mt) || mt > oldest)
+         return true;
+   }
+
+   return false;
+}
+
+#ifndef __MINGW32__
+static void make_start_job(rule_t *r, make_job_fn_t fn)
+{
+   const char *command = (r->kind == RULE_ANALYSE) ? "-a" : "-e";
+
+   printf("nvc %s %s\n", command, istr(r->source));
+   fflush(NULL);
+
+   const pid_t pid = fork();
+   if (pid < 0)
+      fatal_errno("fork");
+   else if (pid == 0) {
+      // Units in other libraries stay loaded from the parent but those
+      // in the work library may have been replaced by an earlier job
+      lib_reopen_locks();
+      lib_forget(lib_work());
+      exit((*fn)(command, istr(r->source)));
+   }
+
+   r->pid   = pid;
+   r->state = BUILD_RUNNING;
+}
+
+static void make_wait_job(rule_t *rules)
+{
+   int status;
+   const pid_t pid = waitpid(-1, &status, 0);
+   if (pid < 0)
+      fatal_errno("waitpid");
+
+   for (rule_t *r = rules; r != NULL; r = r->next) {
+      if (r->state == BUILD_RUNNING && r->pid == pid) {
+         const bool failed = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+         r->state = failed ? BUILD_FAILED : BUILD_DONE;
+         return;
+      }
+   }
+}
+#endif  // __MINGW32__
+
+static bool make_start_ready(rule_t *rules, make_job_fn_t fn, int jobs,
+                             int *running, bool force)
+{
+   // Settle or start every rule whose dependencies have all finished
+   // and return true if any rule changed state. With force set the
+   // first waiting rule is started regardless as its dependencies must
+   // be circular.
+
+   bool progress = false;
+   for (rule_t *r = rules; r != NULL && *running < jobs; r = r->next) {
+      if (r->state != BUILD_WAITING)
+         continue;
+
+      bool ready = true, failed = false, rebuilt = false;
+      for (unsigned i = 0; i < r->ndeps; i++) {
+         switch (r->deps[i]->state) {
+         case BUILD_WAITING:
+         case BUILD_RUNNING:
+            ready = false;
+            break;
+         case BUILD_FAILED:
+            failed = true;
+            break;
+         case BUILD_DONE:
+            rebuilt = true;
+            break;
+         case BUILD_CURRENT:
+            break;
+         }
+      }
+
+      if (failed) {
+         warnf("skipping %s as a unit it depends on failed to build",
+               istr(r->source));
+         r->state = BUILD_FAILED;
+      }
+      else if (!ready && !force)
+         continue;
+      else if (!rebuilt && !make_out_of_date(r))
+         r->state = BUILD_CURRENT;
+      else {
+         if (!ready)
+            warnf("ignoring circular dependency of %s", istr(r->source));
+#ifndef __MINGW32__
+         make_start_job(r, fn);
+         (*running)++;
+#else
+         fatal("--build is not supported on this platform");
+#endif
+      }
+
+      progress = true;
+      if (force)
+         break;
+   }
+
+   return progress;
+}
+
+int make_build(tree_t *targets, int count, int jobs, make_job_fn_t fn)
+{
+   // Run the rules the generated makefile would contain in the order
+   // make would, each forked from this process so that the libraries
+   // read to find the dependencies do not have to be read again
+
+   make_tag_i = ident_new("make_tag");
+   make_generation++;
+
+   tree_t *all = NULL;
+   if (count == 0)
+      targets = all = make_all_units(&count);
+
+   rule_t *rules = NULL;
+   for (int i = 0; i < count; i++)
+      make_rule(targets[i], &rules);
+
+   make_link_deps(rules);
+
+   int running = 0;
+   for (;;) {
+      const bool progress =
+         make_start_ready(rules, fn, jobs, &running, false);
+
+#ifndef __MINGW32__
+      if (running > 0) {
+         make_wait_job(rules);
+         running--;
+         continue;
+      }
+#endif
+
+      if (!progress && !make_start_ready(rules, fn, jobs, &running, true))
+         break;
+   }
+
+   int status = EXIT_SUCCESS;
+   unsigned built = 0;
+   for (rule_t *r = rules; r != NULL; r = r->next) {
+      if (r->state == BUILD_FAILED)
+         status = EXIT_FAILURE;
+      else if (r->state == BUILD_DONE)
+         built++;
+   }
+
+   if (built == 0 && status == EXIT_SUCCESS)
+      notef("all units are up to date");
+
+   make_free_rules(rules);
+   free(all);
+
+   return status;
+}
@@ -0,0 +1,257 @@
+//
+//  Copyright (C) 2018  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "util.h"
+#include "mem.h"
+#include "ident.h"
+#include "object.h"
+#include "vcode.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#define MAX_TOP 5
+
+typedef struct {
+   const char *group;
+   const char *item;
+   size_t      count;
+   size_t      bytes;
+   unsigned    order;
+} mem_line_t;
+
+static bool             enabled = false;
+static bool             reporting = false;
+static bool             constrained = false;
+static size_t           budget_kb = 0;
+static unsigned         peak_rss = 0;
+static unsigned         sampled_rss = 0;
+static mem_source_fn_t *sources = NULL;
+static unsigned         nsources = 0;
+static unsigned         max_sources = 8;
+static mem_line_t      *lines = NULL;
+static unsigned         nlines = 0;
+static unsigned         max_lines = 64;
+
+static void mem_sample(bool force)
+{
+   nvc_rusage_t ru;
+   nvc_rusage_total(&ru);
+   peak_rss = MAX(peak_rss, ru.rss);
+
+   // Sources are only walked again once the peak has grown noticeably
+   // so frequent checks stay cheap
+   const unsigned step = sampled_rss / 32;
+   if (force || sampled_rss == 0 || peak_rss > sampled_rss + step) {
+      for (unsigned i = 0; i < nsources; i++)
+         (*sources[i])();
+
+      sampled_rss = peak_rss;
+   }
+}
+
+static void mem_init(void)
+{
+   if (enabled)
+      return;
+
+   sources = xmalloc(max_sources * sizeof(mem_source_fn_t));
+   lines   = xmalloc(max_lines * sizeof(mem_line_t));
+   enabled = true;
+
+   mem_add_source(object_mem_stats);
+   mem_add_source(ident_mem_stats);
+   mem_add_source(vcode_mem_stats);
+}
+
+static int mem_line_cmp(const void *a, const void *b)
+{
+   // Groups in the order they were first recorded with the largest
+   // items first within each group
+   const mem_line_t *l = a, *r = b;
+   if (l->order != r->order)
+      return l->order < r->order ? -1 : 1;
+   else if (l->bytes != r->bytes)
+      return l->bytes < r->bytes ? 1 : -1;
+   else
+      return 0;
+}
+
+static void mem_print(FILE *f)
+{
+   mem_line_t *sorted LOCAL = xmalloc(MAX(nlines, 1) * sizeof(mem_line_t));
+   memcpy(sorted, lines, nlines * sizeof(mem_line_t));
+   qsort(sorted, nlines, sizeof(mem_line_t), mem_line_cmp);
+
+   fprintf(f, "%-32s %10s %10s\n", "memory", "count", "peak kB");
+
+   size_t total = 0;
+   for (unsigned i = 0; i < nlines; ) {
+      size_t count = 0, bytes = 0;
+      unsigned n = i;
+      for (; n < nlines && sorted[n].order == sorted[i].order; n++) {
+         count += sorted[n].count;
+         bytes += sorted[n].bytes;
+      }
+
+      fprintf(f, "%-32s %10zu %10zu\n", sorted[i].group, count,
+              bytes / 1024);
+
+      for (unsigned j = i; j < MIN(n, i + MAX_TOP); j++) {
+         if (sorted[j].item != NULL)
+            fprintf(f, "  %-30s %10zu %10zu\n", sorted[j].item,
+                    sorted[j].count, sorted[j].bytes / 1024);
+      }
+
+      total += bytes;
+      i = n;
+   }
+
+   fprintf(f, "%-32s %10s %10zu\n", "total recorded", "", total / 1024);
+   fprintf(f, "%-32s %10s %10u\n", "peak resident set", "", peak_rss);
+}
+
+static void mem_report(void)
+{
+   if (!reporting)
+      return;
+
+   mem_sample(true);
+
+   fflush(stdout);
+   mem_print(stderr);
+}
+
+void mem_report_enable(void)
+{
+   mem_init();
+
+   if (!reporting) {
+      atexit(mem_report);
+      reporting = true;
+   }
+}
+
+void mem_set_budget(size_t bytes)
+{
+   mem_init();
+   budget_kb = MAX(bytes / 1024, 1);
+}
+
+bool mem_enabled(void)
+{
+   return enabled;
+}
+
+bool mem_constrained(void)
+{
+   return constrained;
+}
+
+void mem_add_source(mem_source_fn_t fn)
+{
+   if (!enabled)
+      return;
+
+   for (unsigned i = 0; i < nsources; i++) {
+      if (sources[i] == fn)
+         return;
+   }
+
+   ARRAY_APPEND(sources, fn, nsources, max_sources);
+   sampled_rss = 0;
+}
+
+void mem_remove_source(mem_source_fn_t fn)
+{
+   for (unsigned i = 0; i < nsources; i++) {
+      if (sources[i] == fn) {
+         (*fn)();
+         sources[i] = sources[--nsources];
+         return;
+      }
+   }
+}
+
+void mem_record(const char *group, const char *item, size_t count,
+                size_t bytes)
+{
+   // Group and item names must remain valid until the report is printed
+   assert(enabled);
+
+   for (unsigned i = 0; i < nlines; i++) {
+      mem_line_t *l = &(lines[i]);
+      if (strcmp(l->group, group) != 0)
+         continue;
+      else if ((l->item == NULL) != (item == NULL))
+         continue;
+      else if (item != NULL && strcmp(l->item, item) != 0)
+         continue;
+
+      l->count = MAX(l->count, count);
+      l->bytes = MAX(l->bytes, bytes);
+      return;
+   }
+
+   if (count == 0 && bytes == 0)
+      return;
+
+   unsigned order = nlines;
+   for (unsigned i = 0; i < nlines && order == nlines; i++) {
+      if (strcmp(lines[i].group, group) == 0)
+         order = lines[i].order;
+   }
+
+   mem_line_t l = { group, item, count, bytes, order };
+   ARRAY_APPEND(lines, l, nlines, max_lines);
+}
+
+void mem_check(const char *fmt, ...)
+{
+   if (!enabled)
+      return;
+
+   mem_sample(false);
+
+   if (budget_kb == 0 || peak_rss < budget_kb / 4 * 3)
+      return;
+   else if (constrained && peak_rss <= budget_kb)
+      return;
+
+   va_list ap;
+   va_start(ap, fmt);
+   char *where LOCAL = xvasprintf(fmt, ap);
+   va_end(ap);
+
+   if (peak_rss > budget_kb) {
+      // The breakdown is printed here as the report at exit may not run
+      reporting = false;
+      mem_sample(true);
+      fflush(stdout);
+      mem_print(stderr);
+      fatal("peak memory use of %ukB after %s exceeds the budget of %zukB",
+            peak_rss, where, budget_kb);
+   }
+   else if (!constrained) {
+      warnf("peak memory use of %ukB after %s is close to the budget of "
+            "%zukB: switching to strategies which use less memory",
+            peak_rss, where, budget_kb);
+      constrained = true;
+   }
+}
@@ -0,0 +1,51 @@
+//
+//  Copyright (C) 2018  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _MEM_H
+#define _MEM_H
+
+#include "util.h"
+
+// Accounting for where memory goes during elaboration and simulation.
+// Each module holding a large share of memory provides a source which
+// records the number of objects it holds and their size in bytes under
+// a group name and optional item name. Sources are sampled at each
+// check point and the report shows the largest count and size seen for
+// each line.
+//
+// With a budget the peak resident set size is compared against the
+// limit at each check point. Past three quarters of the budget the
+// tools switch to strategies which use less memory at some cost in
+// speed and past the budget they stop with a breakdown of the usage.
+
+typedef void (*mem_source_fn_t)(void);
+
+void mem_report_enable(void);
+void mem_set_budget(size_t bytes);
+bool mem_enabled(void);
+bool mem_constrained(void);
+
+void mem_add_source(mem_source_fn_t fn);
+void mem_remove_source(mem_source_fn_t fn);
+void mem_record(const char *group, const char *item, size_t count,
+                size_t bytes);
+
+// The message names the work just done for example "lowering :top"
+void mem_check(const char *fmt, ...)
+   __attribute__((format(printf, 1, 2)));
+
+#endif  // _MEM_H
@@ -17,9 +17,11 @@
 
 #include "util.h"
 #include "phase.h"
+#include "mem.h"
 #include "common.h"
 #include "vcode.h"
 #include "rt/rt.h"
+#include "rt/cover.h"
 
 #include <unistd.h>
 #include <getopt.h>
@@ -28,6 +30,12 @@
 #include <ctype.h>
 #include <assert.h>
 
+#ifndef __MINGW32__
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
 const char *copy_string =
    "Copyright (C) 2011-2018  Nick Gasson\n"
    "This program comes with ABSOLUTELY NO WARRANTY. This is free software, "
@@ -88,7 +96,8 @@ static unsigned parse_relax(const char *str)
 static int scan_cmd(int start, int argc, char **argv)
 {
    const char *commands[] = {
-      "-a", "-e", "-r", "--codegen", "--dump", "--make", "--syntax", "--list"
+      "-a", "-e", "-r", "--codegen", "--dump", "--make", "--syntax", "--list",
+      "--cover-merge"
    };
 
    for (int i = start; i < argc; i++) {
@@ -101,6 +110,233 @@ static int scan_cmd(int start, int argc, char **argv)
    return argc;
 }
 
+static int parse_int(const char *str)
+{
+   char *eptr = NULL;
+   int n = strtol(str, &eptr, 0);
+   if ((eptr == NULL) || (*eptr != '\0'))
+      fatal("invalid integer: %s", str);
+   return n;
+}
+
+static size_t parse_size(const char *str)
+{
+   char *eptr = NULL;
+   size_t n = strtoul(str, &eptr, 0);
+   if (eptr == str)
+      fatal("invalid size: %s", str);
+   else if (*eptr == 'k' || *eptr == 'K')
+      n *= 1024, eptr++;
+   else if (*eptr == 'm' || *eptr == 'M')
+      n *= 1024 * 1024, eptr++;
+   else if (*eptr == 'g' || *eptr == 'G')
+      n *= 1024 * 1024 * 1024, eptr++;
+
+   if (*eptr != '\0')
+      fatal("invalid size: %s", str);
+
+   return n;
+}
+
+static fbuf_cs_t parse_lib_codec(const char *str)
+{
+   if (strcmp(str, "lz4") == 0)
+      return FBUF_CS_LZ4;
+   else if (strcmp(str, "fastlz") == 0)
+      return FBUF_CS_FASTLZ;
+   else if (strcmp(str, "none") == 0)
+      return FBUF_CS_NONE;
+   else
+      fatal("invalid library codec %s: must be one of lz4, fastlz, none",
+            str);
+}
+
+static phase_report_t parse_phase_report(const char *str)
+{
+   if (str == NULL || strcmp(str, "text") == 0)
+      return PHASE_REPORT_TEXT;
+   else if (strcmp(str, "json") == 0)
+      return PHASE_REPORT_JSON;
+   else
+      fatal("invalid phase report format %s: must be one of text, json",
+            str);
+}
+
+static int analyse_files(char **files, int nfiles, bool verbose)
+{
+   size_t unit_list_sz = 32;
+   tree_t *units LOCAL = xmalloc(sizeof(tree_t) * unit_list_sz);
+   int n_units = 0;
+
+   for (int i = 0; i < nfiles; i++) {
+      input_from_file(files[i]);
+
+      for (;;) {
+         phase_begin("parse");
+         tree_t unit = parse();
+         phase_end(unit ? tree_ident(unit) : NULL);
+
+         if (unit == NULL)
+            break;
+
+         phase_begin("sem");
+         const bool ok = sem_check(unit);
+         phase_end(tree_ident(unit));
+
+         if (!ok)
+            break;
+
+         ARRAY_APPEND(units, unit, n_units, unit_list_sz);
+      }
+   }
+
+   if (verbose) {
+      unsigned hits, misses;
+      sem_overload_stats(&hits, &misses);
+      notef("%u of %u function calls reused cached overload candidates",
+            hits, hits + misses);
+   }
+
+   for (int i = 0; i < n_units; i++) {
+      // Delete any stale vcode to prevent problems in constant folding
+      char *vcode LOCAL = vcode_file_name(tree_ident(units[i]));
+      lib_delete(lib_work(), vcode);
+
+      phase_begin("simplify");
+      simplify(units[i], 0);
+      phase_end(tree_ident(units[i]));
+
+      phase_begin("bounds");
+      bounds_check(units[i]);
+      phase_end(tree_ident(units[i]));
+   }
+
+   if (parse_errors() + sem_errors() + bounds_errors() > 0)
+      return EXIT_FAILURE;
+
+   phase_begin("save");
+   lib_save(lib_work());
+   phase_end(NULL);
+
+   for (int i = 0; i < n_units; i++) {
+      const tree_kind_t kind = tree_kind(units[i]);
+      const bool need_cgen = kind == T_PACK_BODY
+         || (kind == T_PACKAGE && pack_needs_cgen(units[i]));
+      if (need_cgen) {
+         ident_t unit_name = tree_ident(units[i]);
+
+         phase_begin("lower");
+         vcode_unit_t vu = lower_unit(units[i]);
+         char *name LOCAL = vcode_file_name(unit_name);
+         fbuf_t *fbuf = lib_fbuf_open(lib_work(), name, FBUF_OUT);
+         vcode_write(vu, fbuf);
+         fbuf_close(fbuf);
+         phase_end(unit_name);
+
+         phase_begin("cgen");
+         cgen(units[i], vu);
+         phase_end(unit_name);
+      }
+   }
+
+   return EXIT_SUCCESS;
+}
+
+#ifndef __MINGW32__
+static void wait_analysis(pid_t *pids, bool *failed, int nfiles)
+{
+   int status;
+   const pid_t pid = waitpid(-1, &status, 0);
+   if (pid < 0)
+      fatal_errno("waitpid");
+
+   for (int i = 0; i < nfiles; i++) {
+      if (pids[i] == pid) {
+         pids[i] = -1;
+         failed[i] = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+         return;
+      }
+   }
+}
+#endif  // __MINGW32__
+
+static int analyse_parallel(char **files, int nfiles, int jobs,
+                            bool verbose)
+{
+   // Each file is analysed in a child process once every file it depends
+   // on has been saved to the work library: the entry in pids is zero
+   // before the file is started and -1 after it has finished
+
+#ifndef __MINGW32__
+   depend_t *after LOCAL =
+      depend_scan(files, nfiles, lib_name(lib_work()));
+   pid_t *pids LOCAL = xcalloc(nfiles * sizeof(pid_t));
+   bool *failed LOCAL = xcalloc(nfiles * sizeof(bool));
+
+   int running = 0, finished = 0;
+   while (finished < nfiles) {
+      for (int i = 0; i < nfiles && running < jobs; i++) {
+         if (pids[i] != 0)
+            continue;
+
+         bool ready = true, blocked = false;
+         for (int j = 0; j < nfiles; j++) {
+            const depend_t dep = after[i * nfiles + j];
+            if (dep != DEPEND_NONE)
+               ready = ready && pids[j] == -1;
+            if (dep == DEPEND_USE)
+               blocked = blocked || failed[j];
+         }
+
+         if (blocked) {
+            // Serial analysis would have stopped before saving this file
+            warnf("skipping %s as a file it depends on failed analysis",
+                  files[i]);
+            pids[i] = -1;
+            failed[i] = true;
+            finished++;
+            continue;
+         }
+         else if (!ready)
+            continue;
+
+         fflush(NULL);
+
+         const pid_t pid = fork();
+         if (pid < 0)
+            fatal_errno("fork");
+         else if (pid == 0) {
+            lib_reopen_locks();
+            exit(analyse_files(&(files[i]), 1, verbose));
+         }
+
+         pids[i] = pid;
+         running++;
+      }
+
+      // Files only depend on those before them so the first unfinished
+      // file is always either running or ready to start
+      if (running > 0) {
+         wait_analysis(pids, failed, nfiles);
+         running--;
+         finished++;
+      }
+   }
+
+   // Merge the units saved by the children into our copy of the index
+   lib_save(lib_work());
+
+   for (int i = 0; i < nfiles; i++) {
+      if (failed[i])
+         return EXIT_FAILURE;
+   }
+
+   return EXIT_SUCCESS;
+#else
+   fatal("--jobs is not supported for analysis on this platform");
+#endif
+}
+
 static int analyse(int argc, char **argv)
 {
    static struct option long_options[] = {
@@ -109,12 +345,15 @@ static int analyse(int argc, char **argv)
       { "dump-vcode",      optional_argument, 0, 'v' },
       { "prefer-explicit", no_argument,       0, 'p' },   // DEPRECATED
       { "relax",           required_argument, 0, 'R' },
+      { "jobs",            required_argument, 0, 'j' },
+      { "verbose",         no_argument,       0, 'V' },
       { 0, 0, 0, 0 }
    };
 
    const int next_cmd = scan_cmd(2, argc, argv);
-   int c, index = 0;
-   const char *spec = "";
+   int c, index = 0, jobs = 1;
+   bool verbose = false;
+   const char *spec = "j:V";
    while ((c = getopt_long(next_cmd, argv, spec, long_options, &index)) != -1) {
       switch (c) {
       case 0:
@@ -139,50 +378,28 @@ static int analyse(int argc, char **argv)
       case 'R':
          set_relax_rules(parse_relax(optarg));
          break;
+      case 'j':
+         if ((jobs = parse_int(optarg)) < 1)
+            fatal("invalid number of jobs %s", optarg);
+         break;
+      case 'V':
+         verbose = true;
+         break;
       default:
          abort();
       }
    }
 
-   size_t unit_list_sz = 32;
-   tree_t *units LOCAL = xmalloc(sizeof(tree_t) * unit_list_sz);
-   int n_units = 0;
+   const int nfiles = next_cmd - optind;
 
-   for (int i = optind; i < next_cmd; i++) {
-      input_from_file(argv[i]);
+   phase_begin("analyse");
+   const int status = (jobs > 1 && nfiles > 1)
+      ? analyse_parallel(argv + optind, nfiles, jobs, verbose)
+      : analyse_files(argv + optind, nfiles, verbose);
+   phase_end(NULL);
 
-      tree_t unit;
-      while ((unit = parse()) && sem_check(unit))
-         ARRAY_APPEND(units, unit, n_units, unit_list_sz);
-   }
-
-   for (int i = 0; i < n_units; i++) {
-      // Delete any stale vcode to prevent problems in constant folding
-      char *vcode LOCAL = vcode_file_name(tree_ident(units[i]));
-      lib_delete(lib_work(), vcode);
-
-      simplify(units[i], 0);
-      bounds_check(units[i]);
-   }
-
-   if (parse_errors() + sem_errors() + bounds_errors() > 0)
-      return EXIT_FAILURE;
-
-   lib_save(lib_work());
-
-   for (int i = 0; i < n_units; i++) {
-      const tree_kind_t kind = tree_kind(units[i]);
-      const bool need_cgen = kind == T_PACK_BODY
-         || (kind == T_PACKAGE && pack_needs_cgen(units[i]));
-      if (need_cgen) {
-         vcode_unit_t vu = lower_unit(units[i]);
-         char *name LOCAL = vcode_file_name(tree_ident(units[i]));
-         fbuf_t *fbuf = lib_fbuf_open(lib_work(), name, FBUF_OUT);
-         vcode_write(vu, fbuf);
-         fbuf_close(fbuf);
-         cgen(units[i], vu);
-      }
-   }
+   if (status != EXIT_SUCCESS)
+      return status;
 
    argc -= next_cmd - 1;
    argv += next_cmd - 1;
@@ -192,12 +409,18 @@ static int analyse(int argc, char **argv)
 
 static void elab_verbose(bool verbose, const char *fmt, ...)
 {
-   if (verbose) {
-      va_list ap;
-      va_start(ap, fmt);
-      char *msg LOCAL = xvasprintf(fmt, ap);
-      va_end(ap);
+   if (!verbose && !mem_enabled())
+      return;
+
+   va_list ap;
+   va_start(ap, fmt);
+   char *msg LOCAL = xvasprintf(fmt, ap);
+   va_end(ap);
+
+   // Each step is also a point to check the memory budget
+   mem_check("%s", msg);
 
+   if (verbose) {
       static nvc_rusage_t last_ru;
 
       nvc_rusage_t ru;
@@ -237,22 +460,40 @@ static void set_top_level(char **argv, int next_cmd)
    }
 }
 
+static cover_mode_t parse_cover_mode(const char *str)
+{
+   if (str == NULL || strcmp(str, "count") == 0)
+      return COVER_COUNT;
+   else if (strcmp(str, "hit") == 0)
+      return COVER_HIT;
+   else
+      fatal("invalid coverage mode %s: must be one of count, hit", str);
+}
+
 static int elaborate(int argc, char **argv)
 {
    static struct option long_options[] = {
       { "disable-opt", no_argument,       0, 'o' },    // DEPRECATED
       { "dump-llvm",   no_argument,       0, 'd' },
+      { "debug-info",  no_argument,       0, 'D' },
       { "dump-vcode",  optional_argument, 0, 'v' },
       { "native",      no_argument,       0, 'n' },    // DEPRECATED
-      { "cover",       no_argument,       0, 'c' },
+      { "cover",       optional_argument, 0, 'c' },
       { "verbose",     no_argument,       0, 'V' },
+      { "jobs",        required_argument, 0, 'j' },
+      { "cache",       no_argument,       0, 'C' },
+      { "jit",         no_argument,       0, 'J' },
+      { "pgo-collect", no_argument,       0, 'P' },
+      { "pgo-use",     required_argument, 0, 'u' },
+      { "eval-native", no_argument,       0, 'E' },
+      { "bundle",      no_argument,       0, 'B' },
       { 0, 0, 0, 0 }
    };
 
    const int next_cmd = scan_cmd(2, argc, argv);
    bool verbose = false;
    int c, index = 0;
-   const char *spec = "Vg:O:";
+   const char *spec = "Vg:O:j:";
    while ((c = getopt_long(next_cmd, argv, spec, long_options, &index)) != -1) {
       switch (c) {
       case 'o':
@@ -271,6 +512,9 @@ static int elaborate(int argc, char **argv)
       case 'd':
          opt_set_int("dump-llvm", 1);
          break;
+      case 'D':
+         opt_set_int("debug-info", 1);
+         break;
       case 'v':
          opt_set_str("dump-vcode", optarg ?: "");
          break;
@@ -278,7 +522,25 @@ static int elaborate(int argc, char **argv)
          warnf("--native is now a global option: place before the -e command");
          break;
       case 'c':
-         opt_set_int("cover", 1);
+         opt_set_int("cover", parse_cover_mode(optarg));
+         break;
+      case 'C':
+         opt_set_int("cgen-cache", 1);
+         break;
+      case 'J':
+         opt_set_int("jit", 1);
+         break;
+      case 'P':
+         opt_set_int("pgo-collect", 1);
+         break;
+      case 'u':
+         opt_set_str("pgo-use", optarg);
+         break;
+      case 'E':
+         opt_set_int("eval-native", 1);
+         break;
+      case 'B':
+         opt_set_int("bundle", 1);
          break;
       case 'V':
          verbose = true;
@@ -287,6 +549,14 @@ static int elaborate(int argc, char **argv)
       case 'g':
          parse_generic(optarg);
          break;
+      case 'j':
+         {
+            const int jobs = parse_int(optarg);
+            if (jobs < 1)
+               fatal("invalid number of jobs %s", optarg);
+            opt_set_int("cgen-jobs", jobs);
+         }
+         break;
       case 0:
          // Set a flag
          break;
@@ -299,34 +569,109 @@ static int elaborate(int argc, char **argv)
 
    set_top_level(argv, next_cmd);
 
+   if (opt_get_int("pgo-collect") && opt_get_str("pgo-use") != NULL)
+      fatal("--pgo-collect and --pgo-use cannot be used together");
+
+   if (opt_get_int("jit")
+       && (next_cmd == argc || strcmp(argv[next_cmd], "-r") != 0))
+      warnf("--jit has no effect unless the design is run by the same "
+            "command using -r");
+
+#ifdef __MINGW32__
+   if (opt_get_int("bundle")) {
+      warnf("--bundle is not supported on this platform");
+      opt_set_int("bundle", 0);
+   }
+#endif
+
+   if (opt_get_int("bundle") && opt_get_int("jit")) {
+      warnf("--bundle has no effect with --jit");
+      opt_set_int("bundle", 0);
+   }
+
+   if (opt_get_int("eval-native"))
+      eval_set_native_fns(jit_find_native, rt_sandbox_call);
+
+   phase_begin("elaborate");
    elab_verbose(verbose, "initialising");
 
+   phase_begin("load");
    tree_t unit = lib_get(lib_work(), top_level);
    if (unit == NULL)
       fatal("cannot find unit %s in library %s",
             istr(top_level), istr(lib_name(lib_work())));
+   phase_end(top_level);
 
    elab_verbose(verbose, "loading top-level unit");
 
+   phase_begin("elab");
    tree_t e = elab(unit);
+   phase_end(top_level);
+
    if (e == NULL)
       return EXIT_FAILURE;
 
    elab_verbose(verbose, "elaborating design");
 
+   if (verbose) {
+      unsigned hits, misses;
+      eval_memo_stats(&hits, &misses);
+      notef("%u of %u constant function calls reused a cached result",
+            hits, hits + misses);
+
+      elab_memo_stats(&hits, &misses);
+      notef("%u of %u instances reused an elaborated architecture",
+            hits, hits + misses);
+   }
+
+   ident_t name = tree_ident(e);
+
+   phase_begin("group");
    group_nets(e);
+   phase_end(name);
    elab_verbose(verbose, "grouping nets");
 
+   phase_begin("cycle");
+   cycle_regions(e);
+   phase_end(name);
+   elab_verbose(verbose, "levelising processes");
+
+   // The runtime checks this before loading any package
+   if (opt_get_int("bundle"))
+      tree_add_attr_int(e, bundle_i, 1);
+
    // Save the library now so the code generator can attach temporary
    // meta data to trees
+   phase_begin("save");
    lib_save(lib_work());
+   phase_end(NULL);
    elab_verbose(verbose, "saving library");
 
+   // Copies made while elaborating are no longer reachable once the
+   // design is saved
+   if (mem_constrained())
+      tree_gc();
+
+   phase_begin("lower");
    vcode_unit_t vu = lower_unit(e);
+   phase_end(name);
    elab_verbose(verbose, "generating intermediate code");
 
+   if (mem_constrained())
+      tree_gc();
+
+   if (verbose) {
+      unsigned elided, total;
+      lower_bounds_stats(&elided, &total);
+      notef("%u of %u bounds checks removed by static range analysis",
+            elided, total);
+   }
+
+   phase_begin("cgen");
    cgen(e, vu);
+   phase_end(name);
    elab_verbose(verbose, "generating LLVM");
+   phase_end(top_level);
 
    argc -= next_cmd - 1;
    argv += next_cmd - 1;
@@ -404,15 +749,6 @@ static uint64_t parse_time(const char *str)
    return base * mult;
 }
 
-static int parse_int(const char *str)
-{
-   char *eptr = NULL;
-   int n = strtol(str, &eptr, 0);
-   if ((eptr == NULL) || (*eptr != '\0'))
-      fatal("invalid integer: %s", str);
-   return n;
-}
-
 static rt_severity_t parse_severity(const char *str)
 {
    if (strcasecmp(str, "note") == 0)
@@ -427,6 +763,233 @@ static rt_severity_t parse_severity(const char *str)
       fatal("invalid severity level: %s", str);
 }
 
+typedef enum { LXT, FST, VCD, NVT } wave_fmt_t;
+
+typedef struct {
+   char     *name;
+   uint64_t  stop_time;
+   int       stop_delta;
+   int       exit_severity;
+   char     *wave_fname;
+   char     *restore_fname;
+   int       pid;
+} sweep_entry_t;
+
+static const char *wave_fmt_name[] = { "LXT", "FST", "VCD", "NVT" };
+static const char *wave_fmt_ext[]  = { "lxt", "fst", "vcd", "nvt" };
+
+static void start_wave(wave_fmt_t fmt, const char *fname, tree_t e)
+{
+   switch (fmt) {
+   case LXT:
+      lxt_init(fname, e);
+      break;
+   case VCD:
+      vcd_init(fname, e);
+      break;
+   case FST:
+      fst_init(fname, e);
+      break;
+   case NVT:
+      nvt_init(fname, e);
+      break;
+   }
+}
+
+static sweep_entry_t *read_sweep_file(const char *fname, uint64_t stop_time,
+                                      int *count)
+{
+   // Each line names a run followed by KEY=VALUE overrides
+
+   FILE *f = fopen(fname, "r");
+   if (f == NULL)
+      fatal_errno("cannot open %s", fname);
+
+   size_t nentries = 0, max_entries = 16;
+   sweep_entry_t *entries = xmalloc(max_entries * sizeof(sweep_entry_t));
+
+   int lineno = 0;
+   char line[1024];
+   while (fgets(line, sizeof(line), f) != NULL) {
+      lineno++;
+
+      char *comment = strchr(line, '#');
+      if (comment != NULL)
+         *comment = '\0';
+
+      char *token = strtok(line, " \t\r\n");
+      if (token == NULL)
+         continue;
+
+      sweep_entry_t s = {
+         .name          = xstrdup(token),
+         .stop_time     = stop_time,
+         .stop_delta    = -1,
+         .exit_severity = -1
+      };
+
+      for (size_t i = 0; i < nentries; i++) {
+         if (strcmp(entries[i].name, s.name) == 0)
+            fatal("%s:%d: duplicate sweep entry %s", fname, lineno, s.name);
+      }
+
+      while ((token = strtok(NULL, " \t\r\n")) != NULL) {
+         char *eq = strchr(token, '=');
+         if (eq == NULL)
+            fatal("%s:%d: expected KEY=VALUE but found %s",
+                  fname, lineno, token);
+
+         *eq = '\0';
+         const char *value = eq + 1;
+
+         if (strcmp(token, "stop-time") == 0)
+            s.stop_time = parse_time(value);
+         else if (strcmp(token, "stop-delta") == 0)
+            s.stop_delta = parse_int(value);
+         else if (strcmp(token, "exit-severity") == 0)
+            s.exit_severity = parse_severity(value);
+         else if (strcmp(token, "wave") == 0)
+            s.wave_fname = xstrdup(value);
+         else if (strcmp(token, "restore") == 0)
+            s.restore_fname = xstrdup(value);
+         else
+            fatal("%s:%d: invalid sweep option %s", fname, lineno, token);
+      }
+
+      ARRAY_APPEND(entries, s, nentries, max_entries);
+   }
+
+   fclose(f);
+
+   if (nentries == 0)
+      fatal("%s: no sweep entries", fname);
+
+   *count = nentries;
+   return entries;
+}
+
+#ifndef __MINGW32__
+static void run_sweep_entry(tree_t e, const sweep_entry_t *s,
+                            wave_fmt_t wave_fmt, bool wave_all)
+{
+   // Called in a child process after the design has been initialised
+
+   phase_restart_usage();
+
+   char *log LOCAL = xasprintf("%s.log", s->name);
+   const int fd = open(log, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   if (fd < 0)
+      fatal_errno("cannot create %s", log);
+
+   if (dup2(fd, STDOUT_FILENO) < 0 || dup2(fd, STDERR_FILENO) < 0)
+      fatal_errno("dup2");
+   close(fd);
+
+   if (s->wave_fname != NULL)
+      start_wave(wave_fmt, s->wave_fname, e);
+   else if (wave_all) {
+      char *tmp LOCAL = xasprintf("%s.%s", s->name, wave_fmt_ext[wave_fmt]);
+      start_wave(wave_fmt, tmp, e);
+   }
+
+   char *cover_dir LOCAL = xasprintf("%s.cover", s->name);
+   cover_set_report_dir(cover_dir);
+
+   if (s->stop_delta >= 0)
+      opt_set_int("stop-delta", s->stop_delta);
+
+   if (s->exit_severity >= 0)
+      rt_set_exit_severity(s->exit_severity);
+
+   if (s->restore_fname != NULL)
+      rt_restore(s->restore_fname);
+
+   rt_run_sim(s->stop_time);
+   rt_end_of_tool(e);
+
+   exit(EXIT_SUCCESS);
+}
+
+static void wait_sweep_entry(sweep_entry_t *entries, int nentries,
+                             int *running, int *failed)
+{
+   int status;
+   const pid_t pid = waitpid(-1, &status, 0);
+   if (pid < 0)
+      fatal_errno("waitpid");
+
+   for (int i = 0; i < nentries; i++) {
+      if (entries[i].pid != pid)
+         continue;
+
+      entries[i].pid = 0;
+      (*running)--;
+
+      if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+         notef("sweep %s passed", entries[i].name);
+      else {
+         if (WIFSIGNALED(status))
+            warnf("sweep %s killed by signal %d", entries[i].name,
+                  WTERMSIG(status));
+         else
+            warnf("sweep %s failed with status %d", entries[i].name,
+                  WEXITSTATUS(status));
+         (*failed)++;
+      }
+      return;
+   }
+}
+#endif  // __MINGW32__
+
+static int run_sweep(tree_t e, const char *fname, int jobs,
+                     uint64_t stop_time, wave_fmt_t wave_fmt, bool wave_all)
+{
+   // Fork a child for each entry in the sweep file after the design has
+   // been loaded and initialised so the children share the generated
+   // code and kernel data structures copy-on-write
+
+#ifndef __MINGW32__
+   int nentries;
+   sweep_entry_t *entries = read_sweep_file(fname, stop_time, &nentries);
+
+   int running = 0, failed = 0;
+   for (int i = 0; i < nentries; i++) {
+      while (running >= jobs)
+         wait_sweep_entry(entries, nentries, &running, &failed);
+
+      fflush(NULL);
+
+      const pid_t pid = fork();
+      if (pid < 0)
+         fatal_errno("fork");
+      else if (pid == 0)
+         run_sweep_entry(e, &(entries[i]), wave_fmt, wave_all);
+
+      entries[i].pid = pid;
+      running++;
+   }
+
+   while (running > 0)
+      wait_sweep_entry(entries, nentries, &running, &failed);
+
+   notef("%d of %d sweep runs passed", nentries - failed, nentries);
+
+   for (int i = 0; i < nentries; i++) {
+      free(entries[i].name);
+      free(entries[i].wave_fname);
+      free(entries[i].restore_fname);
+   }
+   free(entries);
+
+   // The parent never runs the simulation so skips rt_end_of_tool which
+   // would write an empty coverage report
+
+   return failed > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+#else
+   fatal("--sweep is not supported on this platform");
+#endif
+}
+
 static int run(int argc, char **argv)
 {
    static struct option long_options[] = {
@@ -434,12 +997,33 @@ static int run(int argc, char **argv)
       { "profile",       no_argument,       0, 'p' },
       { "stop-time",     required_argument, 0, 's' },
       { "stats",         no_argument,       0, 'S' },
+      { "stats-json",    required_argument, 0, 'J' },
       { "wave",          optional_argument, 0, 'w' },
       { "stop-delta",    required_argument, 0, 'd' },
       { "format",        required_argument, 0, 'f' },
       { "include",       required_argument, 0, 'i' },
       { "exclude",       required_argument, 0, 'e' },
       { "exit-severity", required_argument, 0, 'x' },
+      { "threads",       required_argument, 0, 'H' },
+      { "checkpoint-at", required_argument, 0, 'C' },
+      { "checkpoint-file", required_argument, 0, 'F' },
+      { "restore",       required_argument, 0, 'R' },
+      { "sample-profile", required_argument, 0, 'P' },
+      { "sweep",         required_argument, 0, 'W' },
+      { "jobs",          required_argument, 0, 'j' },
+      { "cycle-based",   no_argument,       0, 'c' },
+      { "partition",     required_argument, 0, 'D' },
+      { "node",          required_argument, 0, 'N' },
+      { "connect",       required_argument, 0, 'K' },
+      { "no-wave-thread", no_argument,      0, 'Q' },
+      { "wave-from",     required_argument, 0, 'A' },
+      { "wave-to",       required_argument, 0, 'B' },
+      { "wave-depth",    required_argument, 0, 'E' },
+      { "fst-chunk",     required_argument, 0, 'G' },
+      { "fst-compress",  required_argument, 0, 'Z' },
+      { "no-fst-parallel", no_argument,     0, 'U' },
+      { "pgo-collect",   optional_argument, 0, 'M' },
+      { "cosim",         required_argument, 0, 'X' },
 #if ENABLE_VHPI
       { "load",          required_argument, 0, 'l' },
       { "vhpi-trace",    no_argument,       0, 'T' },
@@ -447,9 +1031,23 @@ static int run(int argc, char **argv)
       { 0, 0, 0, 0 }
    };
 
-   enum { LXT, FST, VCD} wave_fmt = FST;
+   wave_fmt_t wave_fmt = FST;
 
    uint64_t stop_time = UINT64_MAX;
+   uint64_t checkpoint_time = UINT64_MAX;
+   uint64_t wave_from = 0;
+   uint64_t wave_to = UINT64_MAX;
+   bool wave_on_assert = false;
+   const char *checkpoint_fname = NULL;
+   const char *restore_fname = NULL;
+   const char *sample_fname = NULL;
+   const char *sweep_fname = NULL;
+   const char *pgo_fname = NULL;
+   const char *partition_fname = NULL;
+   const char *connect_addr = NULL;
+   const char *cosim_fname = NULL;
+   int node = 0;
+   int jobs = 1;
    const char *wave_fname = NULL;
    const char *vhpi_plugins = NULL;
 
@@ -462,7 +1060,7 @@ static int run(int argc, char **argv)
    const int next_cmd = scan_cmd(2, argc, argv);
 
    int c, index = 0;
-   const char *spec = "w::l:";
+   const char *spec = "w::l:j:";
    while ((c = getopt_long(next_cmd, argv, spec, long_options, &index)) != -1) {
       switch (c) {
       case 0:
@@ -489,12 +1087,17 @@ static int run(int argc, char **argv)
             wave_fmt = FST;
          else if (strcmp(optarg, "lxt") == 0)
             wave_fmt = LXT;
+         else if (strcmp(optarg, "nvt") == 0)
+            wave_fmt = NVT;
          else
             fatal("invalid waveform format: %s", optarg);
          break;
       case 'S':
          opt_set_int("rt-stats", 1);
          break;
+      case 'J':
+         opt_set_str("rt-stats-json", optarg);
+         break;
       case 'w':
          if (optarg == NULL)
             wave_fname = "";
@@ -516,13 +1119,133 @@ static int run(int argc, char **argv)
       case 'x':
          rt_set_exit_severity(parse_severity(optarg));
          break;
+      case 'H':
+         {
+            const int nthreads = parse_int(optarg);
+            if (nthreads < 1)
+               fatal("invalid number of threads %s", optarg);
+            opt_set_int("rt-threads", nthreads);
+         }
+         break;
+      case 'C':
+         checkpoint_time = parse_time(optarg);
+         break;
+      case 'F':
+         checkpoint_fname = optarg;
+         break;
+      case 'R':
+         restore_fname = optarg;
+         break;
+      case 'P':
+         sample_fname = optarg;
+         break;
+      case 'W':
+         sweep_fname = optarg;
+         break;
+      case 'j':
+         if ((jobs = parse_int(optarg)) < 1)
+            fatal("invalid number of jobs %s", optarg);
+         break;
+      case 'c':
+         opt_set_int("rt-cycle-based", 1);
+         break;
+      case 'D':
+         partition_fname = optarg;
+         break;
+      case 'N':
+         if ((node = parse_int(optarg)) < 0)
+            fatal("invalid node number %s", optarg);
+         break;
+      case 'K':
+         connect_addr = optarg;
+         break;
+      case 'Q':
+         opt_set_int("rt-wave-thread", 0);
+         break;
+      case 'A':
+         if (strcmp(optarg, "assert") == 0)
+            wave_on_assert = true;
+         else
+            wave_from = parse_time(optarg);
+         break;
+      case 'B':
+         wave_to = parse_time(optarg);
+         break;
+      case 'E':
+         {
+            const int depth = parse_int(optarg);
+            if (depth < 1)
+               fatal("invalid waveform depth %s", optarg);
+            wave_set_depth(depth);
+         }
+         break;
+      case 'G':
+         {
+            const int mb = parse_int(optarg);
+            if (mb < 1 || mb > 2048)
+               fatal("invalid FST chunk size %s", optarg);
+            opt_set_int("fst-chunk", mb);
+         }
+         break;
+      case 'Z':
+         if (strcmp(optarg, "lz4") == 0)
+            opt_set_int("fst-pack", FST_PACK_LZ4);
+         else if (strcmp(optarg, "fastlz") == 0)
+            opt_set_int("fst-pack", FST_PACK_FASTLZ);
+         else {
+            const int level = parse_int(optarg);
+            if (level < 1 || level > 9)
+               fatal("invalid FST compression %s", optarg);
+            opt_set_int("fst-pack", FST_PACK_ZLIB);
+            opt_set_int("fst-level", level);
+         }
+         break;
+      case 'U':
+         opt_set_int("fst-parallel", 0);
+         break;
+      case 'M':
+         pgo_fname = optarg ?: "";
+         break;
+      case 'X':
+         cosim_fname = optarg;
+         break;
       default:
          abort();
       }
    }
 
+   if ((checkpoint_time != UINT64_MAX) != (checkpoint_fname != NULL))
+      fatal("--checkpoint-at and --checkpoint-file must be used together");
+
+   if (sweep_fname != NULL) {
+      if (checkpoint_fname != NULL)
+         fatal("--checkpoint-at cannot be used with --sweep");
+      else if (opt_get_int("rt-threads") > 1)
+         fatal("--threads cannot be used with --sweep");
+   }
+   else if (jobs > 1)
+      fatal("--jobs can only be used with --sweep");
+
+   if ((partition_fname != NULL) != (connect_addr != NULL))
+      fatal("--partition and --connect must be used together");
+   else if (partition_fname != NULL) {
+      if (sweep_fname != NULL)
+         fatal("--partition cannot be used with --sweep");
+      else if (checkpoint_fname != NULL || restore_fname != NULL)
+         fatal("--partition cannot be used with checkpoints");
+   }
+
+   if (cosim_fname != NULL) {
+      if (sweep_fname != NULL)
+         fatal("--cosim cannot be used with --sweep");
+      else if (restore_fname != NULL)
+         fatal("--cosim cannot be used with --restore");
+   }
+
    set_top_level(argv, next_cmd);
 
+   phase_begin("run");
+
    ident_t ename = ident_prefix(top_level, ident_new("elab"), '.');
    tree_t e = lib_get(lib_work(), ename);
    if (e == NULL)
@@ -531,39 +1254,75 @@ static int run(int argc, char **argv)
       fatal("%s not suitable top level", istr(top_level));
 
    if (wave_fname != NULL) {
-      const char *name_map[] = { "LXT", "FST", "VCD" };
-      const char *ext_map[]  = { "lxt", "fst", "vcd" };
       char *tmp LOCAL = NULL;
 
-      if (*wave_fname == '\0') {
-         tmp = xasprintf("%s.%s", top_level_orig, ext_map[wave_fmt]);
-         wave_fname = tmp;
-         notef("writing %s waveform data to %s", name_map[wave_fmt], tmp);
+      wave_include_file(argv[optind]);
+
+      if (sweep_fname != NULL) {
+         if (*wave_fname != '\0')
+            fatal("--wave cannot name a file with --sweep");
       }
+      else {
+         if (*wave_fname == '\0') {
+            tmp = xasprintf("%s.%s", top_level_orig, wave_fmt_ext[wave_fmt]);
+            wave_fname = tmp;
+            notef("writing %s waveform data to %s",
+                  wave_fmt_name[wave_fmt], tmp);
+         }
 
-      wave_include_file(argv[optind]);
+         start_wave(wave_fmt, wave_fname, e);
+      }
+   }
 
-      switch (wave_fmt) {
-      case LXT:
-         lxt_init(wave_fname, e);
-         break;
-      case VCD:
-         vcd_init(wave_fname, e);
-         break;
-      case FST:
-         fst_init(wave_fname, e);
-         break;
+   if (sample_fname != NULL)
+      rt_set_profile_file(sample_fname);
+
+   if (pgo_fname != NULL) {
+      if (*pgo_fname == '\0') {
+         char *tmp LOCAL = xasprintf("%s.pgo", top_level_orig);
+         opt_set_str("rt-pgo-collect", tmp);
       }
+      else
+         opt_set_str("rt-pgo-collect", pgo_fname);
    }
 
+   if (partition_fname != NULL)
+      dist_init(e, partition_fname, node, connect_addr);
+
+   if (wave_to <= wave_from)
+      fatal("--wave-to must be later than --wave-from");
+
+   rt_set_wave_window(wave_from, wave_to, wave_on_assert);
+
    rt_start_of_tool(e);
 
+   if (cosim_fname != NULL)
+      cosim_init(e, cosim_fname);
+
    if (vhpi_plugins != NULL)
       vhpi_load_plugins(e, vhpi_plugins);
 
    rt_restart(e);
-   rt_run_sim(stop_time);
-   rt_end_of_tool(e);
+
+   if (restore_fname != NULL)
+      rt_restore(restore_fname);
+
+   int status = EXIT_SUCCESS;
+   if (sweep_fname != NULL)
+      status = run_sweep(e, sweep_fname, jobs, stop_time, wave_fmt,
+                         wave_fname != NULL);
+   else {
+      if (checkpoint_fname != NULL)
+         rt_set_checkpoint(checkpoint_time, checkpoint_fname);
+
+      rt_run_sim(stop_time);
+      rt_end_of_tool(e);
+   }
+
+   phase_end(top_level);
+
+   if (status != EXIT_SUCCESS)
+      return status;
 
    argc -= next_cmd - 1;
    argv += next_cmd - 1;
@@ -571,17 +1330,26 @@ static int run(int argc, char **argv)
    return argc > 1 ? process_command(argc, argv) : EXIT_SUCCESS;
 }
 
+static int make_job(const char *command, const char *arg)
+{
+   char *argv[] = { (char *)PACKAGE, (char *)command, (char *)arg, NULL };
+   return process_command(3, argv);
+}
+
 static int make_cmd(int argc, char **argv)
 {
    static struct option long_options[] = {
-      { "deps-only", no_argument, 0, 'd' },
-      { "posix",     no_argument, 0, 'p' },
+      { "deps-only", no_argument,       0, 'd' },
+      { "posix",     no_argument,       0, 'p' },
+      { "build",     no_argument,       0, 'b' },
+      { "jobs",      required_argument, 0, 'j' },
       { 0, 0, 0, 0 }
    };
 
    const int next_cmd = scan_cmd(2, argc, argv);
-   int c, index = 0;
-   const char *spec = "";
+   int c, index = 0, jobs = 1;
+   bool build = false;
+   const char *spec = "j:";
    while ((c = getopt_long(next_cmd, argv, spec, long_options, &index)) != -1) {
       switch (c) {
       case 0:
@@ -595,11 +1363,21 @@ static int make_cmd(int argc, char **argv)
       case 'p':
          opt_set_int("make-posix", 1);
          break;
+      case 'b':
+         build = true;
+         break;
+      case 'j':
+         if ((jobs = parse_int(optarg)) < 1)
+            fatal("invalid number of jobs %s", optarg);
+         break;
       default:
          abort();
       }
    }
 
+   if (jobs > 1 && !build)
+      fatal("--jobs requires --build");
+
    const int count = next_cmd - optind;
    tree_t *targets = xmalloc(count * sizeof(tree_t));
 
@@ -615,7 +1393,56 @@ static int make_cmd(int argc, char **argv)
       }
    }
 
-   make(targets, count, stdout);
+   if (build) {
+      const int status = make_build(targets, count, jobs, make_job);
+      free(targets);
+
+      if (status != EXIT_SUCCESS)
+         return status;
+   }
+   else
+      make(targets, count, stdout);
+
+   argc -= next_cmd - 1;
+   argv += next_cmd - 1;
+
+   return argc > 1 ? process_command(argc, argv) : EXIT_SUCCESS;
+}
+
+static int cover_merge_cmd(int argc, char **argv)
+{
+   static struct option long_options[] = {
+      { "output", required_argument, 0, 'o' },
+      { "jobs",   required_argument, 0, 'j' },
+      { 0, 0, 0, 0 }
+   };
+
+   const int next_cmd = scan_cmd(2, argc, argv);
+   int c, index = 0, jobs = MAX(sysconf(_SC_NPROCESSORS_ONLN), 1);
+   const char *spec = "o:j:";
+   while ((c = getopt_long(next_cmd, argv, spec, long_options, &index)) != -1) {
+      switch (c) {
+      case 0:
+         // Set a flag
+         break;
+      case '?':
+         fatal("unrecognised cover-merge option %s", argv[optind - 1]);
+      case 'o':
+         cover_set_report_dir(optarg);
+         break;
+      case 'j':
+         if ((jobs = parse_int(optarg)) < 1)
+            fatal("invalid number of jobs %s", optarg);
+         break;
+      default:
+         abort();
+      }
+   }
+
+   if (optind == next_cmd)
+      fatal("missing coverage database to merge");
+
+   cover_merge(argv + optind, next_cmd - optind, jobs);
 
    argc -= next_cmd - 1;
    argv += next_cmd - 1;
@@ -759,22 +1586,40 @@ static int dump_cmd(int argc, char **argv)
 static void set_default_opts(void)
 {
    opt_set_int("rt-stats", 0);
+   opt_set_str("rt-stats-json", NULL);
+   opt_set_str("rt-pgo-collect", NULL);
    opt_set_int("rt_trace_en", 0);
    opt_set_int("vhpi_trace_en", 0);
    opt_set_int("dump-llvm", 0);
+   opt_set_int("debug-info", 0);
    opt_set_int("optimise", 2);
+   opt_set_int("cgen-jobs", 0);
+   opt_set_int("cgen-cache", 0);
+   opt_set_int("jit", 0);
+   opt_set_int("eval-native", 0);
+   opt_set_int("bundle", 0);
+   opt_set_int("pgo-collect", 0);
+   opt_set_str("pgo-use", NULL);
    opt_set_int("bootstrap", 0);
    opt_set_int("cover", 0);
    opt_set_int("stop-delta", 1000);
    opt_set_int("unit-test", 0);
    opt_set_int("make-deps-only", 0);
    opt_set_int("make-posix", 0);
+   opt_set_int("vcode-opt", 1);
    opt_set_str("dump-vcode", NULL);
    opt_set_int("relax", 0);
    opt_set_int("ignore-time", 0);
    opt_set_int("force-init", 0);
    opt_set_int("verbose", 0);
    opt_set_int("rt_profile", 0);
+   opt_set_int("rt-threads", 1);
+   opt_set_int("rt-cycle-based", 0);
+   opt_set_int("rt-wave-thread", 1);
+   opt_set_int("fst-parallel", 1);
+   opt_set_int("fst-chunk", 0);
+   opt_set_int("fst-pack", FST_PACK_ZLIB);
+   opt_set_int("fst-level", 4);
 }
 
 static void usage(void)
@@ -785,6 +1630,8 @@ static void usage(void)
           " -a [OPTION]... FILE...\t\tAnalyse FILEs into work library\n"
           " -e [OPTION]... UNIT\t\tElaborate and generate code for UNIT\n"
           " -r [OPTION]... UNIT\t\tExecute previously elaborated UNIT\n"
+          " --cover-merge [OPTION]... FILE...\n"
+          "\t\t\t\tMerge coverage databases and report\n"
           " --dump [OPTION]... UNIT\tPrint out previously analysed UNIT\n"
           " --list\t\t\t\tPrint all units in the library\n"
           " --make [OPTION]... [UNIT]...\tGenerate makefile to rebuild UNITs\n"
@@ -795,42 +1642,79 @@ static void usage(void)
           " -h, --help\t\tDisplay this message and exit\n"
           "     --ignore-time\tSkip source file timestamp check\n"
           " -L PATH\t\tAdd PATH to library search paths\n"
+          "     --lib-block=SIZE\tCompress library files in SIZE blocks\n"
+          "     --lib-codec=CODEC\tCompress library files with CODEC\n"
           "     --map=LIB:PATH\tMap library LIB to PATH\n"
+          "     --mem-budget=SIZE\tLimit peak memory use to SIZE bytes\n"
+          "     --mem-report\tReport where memory is used at exit\n"
           "     --messages=STYLE\tSelect full or compact message format\n"
           "     --native\t\tGenerate native code shared library\n"
+          "     --phase-report[=FMT]\tReport resources used by each phase\n"
           "     --std=REV\t\tVHDL standard revision to use\n"
           " -v, --version\t\tDisplay version and copyright information\n"
           "     --work=NAME\tUse NAME as the work library\n"
           "\n"
           "Analyse options:\n"
           "     --bootstrap\tAllow compilation of STANDARD package\n"
+          " -j, --jobs=N\t\tAnalyse up to N independent files in parallel\n"
           "     --relax=RULES\tDisable certain pedantic rule checks\n"
+          " -V, --verbose\t\tReport how often overload resolution is reused\n"
           "\n"
           "Elaborate options:\n"
-          "     --cover\t\tEnable code coverage reporting\n"
+          "     --bundle\t\tLink packages into the design library\n"
+          "     --cache\t\tReuse code for units unchanged since last time\n"
+          "     --cover[=MODE]\tEnable code coverage reporting: MODE is count\n"
+          "\t\t\t(default) or hit\n"
+          "     --debug-info\tMap generated code to VHDL source lines\n"
           "     --dump-llvm\tPrint generated LLVM IR\n"
           "     --dump-vcode\tPrint generated intermediate code\n"
+          "     --eval-native\tCall compiled package functions when folding\n"
           " -g NAME=VALUE\t\tSet top level generic NAME to VALUE\n"
+          " -j, --jobs=N\t\tGenerate code using up to N threads\n"
+          "     --jit\t\tCompile processes in memory when first run\n"
           " -O0, -O1, -O2, -O3\tSet optimisation level (default is -O2)\n"
+          "     --pgo-collect\tCount executions of each block of code\n"
+          "     --pgo-use=FILE\tOptimise using counts from FILE\n"
           " -V, --verbose\t\tPrint resource usage at each step\n"
           "\n"
           "Run options:\n"
+          "     --checkpoint-at=T\tSave simulation state at time T\n"
+          "     --checkpoint-file=FILE\tFile to save simulation state in\n"
+          "     --connect=HOST:PORT\tAddress of node zero with --partition\n"
+          "     --cosim=FILE\tRun with a foreign model attached to FILE\n"
+          "     --cycle-based\tEvaluate combinational logic without deltas\n"
           "     --exclude=GLOB\tExclude signals matching GLOB from wave dump\n"
           "     --exit-severity=S\tExit after assertion failure of severity S\n"
-          "     --format=FMT\tWaveform format is either fst or vcd\n"
+          "     --format=FMT\tWaveform format is one of fst, vcd or nvt\n"
+          "     --fst-chunk=MB\tFlush FST data after MB megabytes\n"
+          "     --fst-compress=C\tCompress FST with lz4, fastlz or zlib level C\n"
           "     --include=GLOB\tInclude signals matching GLOB in wave dump\n"
+          " -j, --jobs=N\t\tRun up to N sweep entries in parallel\n"
 #ifdef ENABLE_VHPI
           "     --load=PLUGIN\tLoad VHPI plugin at startup\n"
 #endif
+          "     --no-fst-parallel\tCompress FST data on the writing thread\n"
+          "     --no-wave-thread\tWrite waveform data on the simulation thread\n"
+          "     --node=N\t\tRun the processes assigned to node N\n"
+          "     --partition=FILE\tSplit processes between nodes from FILE\n"
+          "     --pgo-collect=FILE\tWrite block counts to FILE\n"
           "     --profile\t\tColect profiling data during run\n"
+          "     --restore=FILE\tResume from state saved with --checkpoint-at\n"
+          "     --sample-profile=FILE\tWrite sampled call stacks to FILE\n"
           "     --stats\t\tPrint statistics at end of run\n"
+          "     --stats-json=FILE\tWrite kernel statistics to FILE as JSON\n"
           "     --stop-delta=N\tStop after N delta cycles (default %d)\n"
           "     --stop-time=T\tStop after simulation time T (e.g. 5ns)\n"
+          "     --sweep=FILE\tRun once for each entry in FILE\n"
+          "     --threads=N\tRun processes in parallel on N threads\n"
           "     --trace\t\tTrace simulation events\n"
 #ifdef ENABLE_VHPI
           "     --vhpi-trace\tTrace VHPI calls and events\n"
 #endif
           " -w, --wave=FILE\tWrite waveform data; file name is optional\n"
+          "     --wave-depth=N\tOnly dump signals N levels from the top\n"
+          "     --wave-from=T\tStart waveform capture at time T or assert\n"
+          "     --wave-to=T\tStop waveform capture at time T\n"
           "\n"
           "Dump options:\n"
           " -e, --elab\t\tDump an elaborated unit\n"
@@ -838,8 +1722,14 @@ static void usage(void)
           "     --nets\t\tShow mapping from signals to nets\n"
           "\n"
           "Make options:\n"
+          "     --build\t\tRun the out of date rules instead\n"
           "     --deps-only\tOutput dependencies without actions\n"
+          " -j, --jobs=N\t\tRun up to N rules in parallel with --build\n"
           "     --posix\t\tStrictly POSIX compliant makefile\n"
+          "\n"
+          "Coverage merge options:\n"
+          " -j, --jobs=N\t\tRead databases using N threads\n"
+          " -o, --output=DIR\tWrite the merged report to DIR\n"
           "\n",
           PACKAGE,
           opt_get_int("stop-delta"));
@@ -924,6 +1814,7 @@ static int process_command(int argc, char **argv)
       { "make",    no_argument, 0, 'm' },
       { "syntax",  no_argument, 0, 's' },
       { "list",    no_argument, 0, 'l' },
+      { "cover-merge", no_argument, 0, 'C' },
       { 0, 0, 0, 0 }
    };
 
@@ -949,6 +1840,8 @@ static int process_command(int argc, char **argv)
       return syntax_cmd(argc, argv);
    case 'l':
       return list_cmd(argc, argv);
+   case 'C':
+      return cover_merge_cmd(argc, argv);
    default:
       fatal("missing command, try %s --help for usage", PACKAGE);
       return EXIT_FAILURE;
@@ -981,6 +1874,11 @@ int main(int argc, char **argv)
       { "map",         required_argument, 0, 'p' },
       { "ignore-time", no_argument,       0, 'i' },
       { "force-init",  no_argument,       0, 'f' },
+      { "lib-codec",   required_argument, 0, 'Z' },
+      { "lib-block",   required_argument, 0, 'B' },
+      { "phase-report", optional_argument, 0, 'P' },
+      { "mem-report",  no_argument,       0, 'R' },
+      { "mem-budget",  required_argument, 0, 'G' },
       { 0, 0, 0, 0 }
    };
 
@@ -1025,6 +1923,21 @@ int main(int argc, char **argv)
       case 'f':
          opt_set_int("force-init", 1);
          break;
+      case 'Z':
+         fbuf_set_codec(parse_lib_codec(optarg));
+         break;
+      case 'B':
+         fbuf_set_block_size(parse_size(optarg));
+         break;
+      case 'P':
+         phase_report_enable(parse_phase_report(optarg));
+         break;
+      case 'R':
+         mem_report_enable();
+         break;
+      case 'G':
+         mem_set_budget(parse_size(optarg));
+         break;
       case 'n':
          warnf("the --native option is deprecated and has no effect");
          break;
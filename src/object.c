@@ -16,15 +16,17 @@
 //
 
 #include "object.h"
+#include "mem.h"
 #include "common.h"
+#include "hash.h"
 
 #include <string.h>
 #include <stdlib.h>
 
-DEFINE_ARRAY(tree);
-DEFINE_ARRAY(netid);
-DEFINE_ARRAY(type);
-DEFINE_ARRAY(range);
+DEFINE_PACKED_ARRAY(tree);
+DEFINE_PACKED_ARRAY(netid);
+DEFINE_PACKED_ARRAY(type);
+DEFINE_PACKED_ARRAY(range);
 
 static const char *item_text_map[] = {
    "I_IDENT",    "I_VALUE",     "I_SEVERITY", "I_MESSAGE",    "I_TARGET",
@@ -42,9 +44,55 @@ static const char *item_text_map[] = {
 static object_class_t *classes[4];
 static uint32_t        format_digest;
 static generation_t    next_generation = 1;
-static object_t      **all_objects = NULL;
-static size_t          max_objects = 256;   // Grows at runtime
-static size_t          n_objects_alloc = 0;
+static object_arena_t **all_arenas = NULL;
+static unsigned         n_arenas = 0;
+static unsigned         max_arenas = 16;
+static object_arena_t  *current_arena = NULL;
+static size_t           n_objects_alloc = 0;
+static size_t           n_arena_chunks = 0;
+static uint64_t         n_objects_total = 0;
+static hash_t          *deferred_map = NULL;
+
+static inline void object_check_deferred(object_t *object,
+                                         const tree_array_t *a)
+{
+   // Deferred items are NULL until read in as a whole
+   if (unlikely(tree_array_count(a) > 0 && a->items[0] == NULL))
+      object_read_deferred(object);
+}
+
+static bool object_is_deferred(const object_class_t *class,
+                               const object_t *object, imask_t mask)
+{
+   // Only the top level unit in a file has items deferred
+   return object->index == 0 && (mask & class->deferred_item)
+      && object->kind == class->deferred_kind;
+}
+
+static object_rd_ctx_t *object_take_deferred(object_t *object)
+{
+   // The map is released once the last deferred read is taken from it
+   if (deferred_map == NULL)
+      return NULL;
+
+   object_rd_ctx_t *ctx = hash_get(deferred_map, object);
+   if (ctx != NULL && hash_delete(deferred_map, object)
+       && hash_members(deferred_map) == 0) {
+      hash_free(deferred_map);
+      deferred_map = NULL;
+   }
+
+   return ctx;
+}
+
+static void object_free_deferred(object_rd_ctx_t *ctx)
+{
+   fbuf_close(ctx->file);
+   ident_read_end(ctx->ident_ctx);
+   free(ctx->store);
+   free(ctx->db_fname);
+   free(ctx);
+}
 
 void object_lookup_failed(const char *name, const char **kind_text_map,
                           int kind, imask_t mask)
@@ -105,6 +153,9 @@ void object_change_kind(const object_class_t *class, object_t *object, int kind)
          memset(&(object->items[np++]), '\0', sizeof(item_t));
    }
 
+   class->live_count[object->kind]--;
+   class->live_count[kind]++;
+
    object->kind = kind;
 }
 
@@ -113,6 +164,7 @@ static void object_init(object_class_t *class)
    class->object_size   = xmalloc(class->last_kind * sizeof(size_t));
    class->object_nitems = xmalloc(class->last_kind * sizeof(int));
    class->item_lookup   = xmalloc(class->last_kind * sizeof(int) * 64);
+   class->live_count    = xcalloc(class->last_kind * sizeof(size_t));
 
    assert(class->last_kind < (1 << (sizeof(uint8_t) * 8)));
 
@@ -129,6 +181,8 @@ static void object_init(object_class_t *class)
          (uint32_t)(class->has_map[i] >> 32) * UINT32_C(2654435761);
       format_digest +=
          (uint32_t)(class->has_map[i]) * UINT32_C(2654435761);
+      if (i == class->deferred_kind)
+         format_digest += (uint32_t)class->deferred_item * UINT32_C(40503);
 
       int n = 0;
       for (int j = 0; j < 64; j++) {
@@ -177,7 +231,7 @@ void object_one_time_init(void)
 
       // Increment this each time a incompatible change is made to the
       // on-disk format not expressed in the tree and type items table
-      const uint32_t format_fudge = 12;
+      const uint32_t format_fudge = 13;
 
       format_digest += format_fudge * UINT32_C(2654435761);
 
@@ -185,6 +239,41 @@ void object_one_time_init(void)
    }
 }
 
+void object_new_arena(void)
+{
+   object_arena_t *a = xcalloc(sizeof(object_arena_t));
+   a->max_objects = 256;
+   a->objects     = xmalloc(a->max_objects * sizeof(object_t *));
+   a->max_chunks  = 4;
+   a->chunks      = xmalloc(a->max_chunks * sizeof(void *));
+
+   if (all_arenas == NULL)
+      all_arenas = xmalloc(max_arenas * sizeof(object_arena_t *));
+
+   ARRAY_APPEND(all_arenas, a, n_arenas, max_arenas);
+
+   current_arena = a;
+}
+
+static void *object_arena_alloc(object_arena_t *a, size_t size)
+{
+   size = (size + sizeof(double) - 1) & ~(sizeof(double) - 1);
+
+   if (unlikely(a->alloc_ptr + size > a->alloc_limit)) {
+      const size_t chunksz = MAX(ARENA_CHUNK_SIZE, size);
+      char *chunk = xmalloc(chunksz);
+      ARRAY_APPEND(a->chunks, chunk, a->n_chunks, a->max_chunks);
+      n_arena_chunks++;
+
+      a->alloc_ptr   = chunk;
+      a->alloc_limit = chunk + chunksz;
+   }
+
+   void *ptr = a->alloc_ptr;
+   a->alloc_ptr += size;
+   return ptr;
+}
+
 object_t *object_new(const object_class_t *class, int kind)
 {
    if (unlikely(kind >= class->last_kind))
@@ -192,39 +281,55 @@ object_t *object_new(const object_class_t *class, int kind)
 
    object_one_time_init();
 
-   object_t *object = xcalloc(class->object_size[kind]);
+   if (unlikely(current_arena == NULL))
+      object_new_arena();
+
+   object_arena_t *a = current_arena;
+   object_t *object = object_arena_alloc(a, class->object_size[kind]);
+   memset(object, '\0', class->object_size[kind]);
 
    object->kind  = kind;
    object->tag   = class->tag;
    object->index = UINT32_MAX;
 
-   if (unlikely(all_objects == NULL))
-      all_objects = xmalloc(sizeof(object_t *) * max_objects);
-
-   ARRAY_APPEND(all_objects, object, n_objects_alloc, max_objects);
+   ARRAY_APPEND(a->objects, object, a->n_objects, a->max_objects);
+   n_objects_alloc++;
+   n_objects_total++;
+   class->live_count[kind]++;
 
    return object;
 }
 
 static void object_sweep(object_t *object)
 {
+   // The object itself is freed along with the rest of its arena
    const object_class_t *class = classes[object->tag];
 
+   class->live_count[object->kind]--;
+
+   // A unit collected before its deferred items were read no longer
+   // needs the saved reader state
+   if (object->index == 0 && object->kind == class->deferred_kind) {
+      object_rd_ctx_t *ctx = object_take_deferred(object);
+      if (ctx != NULL)
+         object_free_deferred(ctx);
+   }
+
    const imask_t has = class->has_map[object->kind];
    const int nitems = class->object_nitems[object->kind];
    imask_t mask = 1;
    for (int n = 0; n < nitems; mask <<= 1) {
       if (has & mask) {
          if (ITEM_TREE_ARRAY & mask)
-            free(object->items[n].tree_array.items);
+            tree_array_free(&(object->items[n].tree_array));
          else if (ITEM_TYPE_ARRAY & mask)
-            free(object->items[n].type_array.items);
+            type_array_free(&(object->items[n].type_array));
          else if (ITEM_NETID_ARRAY & mask)
-            free(object->items[n].netid_array.items);
+            netid_array_free(&(object->items[n].netid_array));
          else if (ITEM_ATTRS & mask)
-            free(object->items[n].attrs.table);
+            free(object->items[n].attrs);
          else if (ITEM_RANGE_ARRAY & mask)
-            free(object->items[n].range_array.items);
+            range_array_free(&(object->items[n].range_array));
          else if (ITEM_TEXT_BUF & mask) {
             if (object->items[n].text_buf != NULL)
                tb_free(object->items[n].text_buf);
@@ -232,8 +337,23 @@ static void object_sweep(object_t *object)
          n++;
       }
    }
+}
 
-   free(object);
+static void object_free_arena(object_arena_t *a)
+{
+   for (unsigned i = 0; i < a->n_objects; i++)
+      object_sweep(a->objects[i]);
+
+   for (unsigned i = 0; i < a->n_chunks; i++)
+      free(a->chunks[i]);
+   n_arena_chunks -= a->n_chunks;
+
+   if (current_arena == a)
+      current_arena = NULL;
+
+   free(a->chunks);
+   free(a->objects);
+   free(a);
 }
 
 void object_gc(void)
@@ -242,52 +362,103 @@ void object_gc(void)
    const generation_t base_gen = next_generation;
 
    // Mark
-   for (unsigned i = 0; i < n_objects_alloc; i++) {
-      assert(all_objects[i] != NULL);
-
-      const object_class_t *class = classes[all_objects[i]->tag];
+   for (unsigned i = 0; i < n_arenas; i++) {
+      object_arena_t *a = all_arenas[i];
+      for (unsigned j = 0; j < a->n_objects; j++) {
+         object_t *object = a->objects[j];
+         const object_class_t *class = classes[object->tag];
+
+         bool top_level = false;
+         for (int k = 0; (k < class->gc_num_roots) && !top_level; k++) {
+            if (class->gc_roots[k] == object->kind)
+               top_level = true;
+         }
 
-      bool top_level = false;
-      for (int j = 0; (j < class->gc_num_roots) && !top_level; j++) {
-         if (class->gc_roots[j] == all_objects[i]->kind)
-            top_level = true;
+         if (top_level) {
+            object_visit_ctx_t ctx = {
+               .count      = 0,
+               .postorder  = NULL,
+               .preorder   = NULL,
+               .context    = NULL,
+               .kind       = T_LAST_TREE_KIND,
+               .generation = next_generation++,
+               .deep       = true
+            };
+
+            object_visit(object, &ctx);
+         }
       }
+   }
 
-      if (top_level) {
-         object_visit_ctx_t ctx = {
-            .count      = 0,
-            .postorder  = NULL,
-            .preorder   = NULL,
-            .context    = NULL,
-            .kind       = T_LAST_TREE_KIND,
-            .generation = next_generation++,
-            .deep       = true
-         };
-
-         object_visit(all_objects[i], &ctx);
+   // Sweep: an arena with no reachable objects is released as a whole
+   // and otherwise only the storage owned by its dead objects is freed
+   size_t live = 0;
+   unsigned nlive_arenas = 0, nfreed_arenas = 0;
+   for (unsigned i = 0; i < n_arenas; i++) {
+      object_arena_t *a = all_arenas[i];
+
+      unsigned p = 0;
+      for (unsigned j = 0; j < a->n_objects; j++) {
+         if (a->objects[j]->generation >= base_gen)
+            p++;
       }
-   }
 
-   // Sweep
-   for (unsigned i = 0; i < n_objects_alloc; i++) {
-      object_t *object = all_objects[i];
-      if (object->generation < base_gen) {
-         object_sweep(object);
-         all_objects[i] = NULL;
+      if (p == 0 && a != current_arena) {
+         object_free_arena(a);
+         nfreed_arenas++;
       }
-   }
+      else {
+         p = 0;
+         for (unsigned j = 0; j < a->n_objects; j++) {
+            object_t *object = a->objects[j];
+            if (object->generation < base_gen)
+               object_sweep(object);
+            else
+               a->objects[p++] = object;
+         }
 
-   // Compact
-   size_t p = 0;
-   for (unsigned i = 0; i < n_objects_alloc; i++) {
-      if (all_objects[i] != NULL)
-         all_objects[p++] = all_objects[i];
+         a->n_objects = p;
+         all_arenas[nlive_arenas++] = a;
+         live += p;
+      }
    }
 
    if ((getenv("NVC_GC_VERBOSE") != NULL) || is_debugger_running())
-      notef("GC: freed %zu objects; %zu allocated", n_objects_alloc - p, p);
+      notef("GC: freed %zu objects and %u arenas; %zu allocated",
+            n_objects_alloc - live, nfreed_arenas, live);
+
+   n_arenas = nlive_arenas;
+   n_objects_alloc = live;
+}
+
+void object_counts(uint64_t *total, size_t *live)
+{
+   *total = n_objects_total;
+   *live  = n_objects_alloc;
+}
+
+void object_mem_stats(void)
+{
+   // Objects are counted at their allocated size which excludes storage
+   // for arrays and other items held outside the arena
+   size_t live_bytes = 0;
+   for (size_t i = 0; i < ARRAY_LEN(classes); i++) {
+      const object_class_t *class = classes[i];
+      if (class == NULL)
+         continue;
+
+      for (int j = 0; j < class->last_kind; j++) {
+         const size_t count = class->live_count[j];
+         const size_t bytes = count * class->object_size[j];
+         mem_record(class->name, class->kind_text_map[j], count, bytes);
+         live_bytes += bytes;
+      }
+   }
 
-   n_objects_alloc = p;
+   // Space in arena chunks taken by unreachable objects or not yet used
+   const size_t chunk_bytes = n_arena_chunks * ARENA_CHUNK_SIZE;
+   mem_record("arena overhead", NULL, n_arena_chunks,
+              chunk_bytes - MIN(live_bytes, chunk_bytes));
 }
 
 void object_visit(object_t *object, object_visit_ctx_t *ctx)
@@ -322,13 +493,17 @@ void object_visit(object_t *object, object_visit_ctx_t *ctx)
          else if (ITEM_TREE & mask)
             object_visit((object_t *)object->items[i].tree, ctx);
          else if (ITEM_TREE_ARRAY & mask) {
+            // A deep visit is only used to mark live objects and no
+            // deferred item has been read in yet so cannot be live
             tree_array_t *a = &(object->items[i].tree_array);
-            for (unsigned j = 0; j < a->count; j++)
+            if (!ctx->deep)
+               object_check_deferred(object, a);
+            for (unsigned j = 0; j < tree_array_count(a); j++)
                object_visit((object_t *)a->items[j], ctx);
          }
          else if (ITEM_TYPE_ARRAY & mask) {
             type_array_t *a = &(object->items[i].type_array);
-            for (unsigned j = 0; j < a->count; j++)
+            for (unsigned j = 0; j < type_array_count(a); j++)
                object_visit((object_t *)a->items[j], ctx);
          }
          else if (ITEM_TYPE & mask)
@@ -341,7 +516,7 @@ void object_visit(object_t *object, object_visit_ctx_t *ctx)
             ;
          else if (ITEM_RANGE_ARRAY & mask) {
             range_array_t *a = &(object->items[i].range_array);
-            for (unsigned j = 0; j < a->count; j++) {
+            for (unsigned j = 0; j < range_array_count(a); j++) {
                object_visit((object_t *)a->items[j].left, ctx);
                object_visit((object_t *)a->items[j].right, ctx);
             }
@@ -351,8 +526,8 @@ void object_visit(object_t *object, object_visit_ctx_t *ctx)
          else if (ITEM_TEXT_BUF & mask)
             ;
          else if (ITEM_ATTRS & mask) {
-            attr_tab_t *attrs = &(object->items[i].attrs);
-            for (unsigned j = 0; j < attrs->num; j++) {
+            attr_tab_t *attrs = object->items[i].attrs;
+            for (unsigned j = 0; attrs != NULL && j < attrs->num; j++) {
                switch (attrs->table[j].kind) {
                case A_TREE:
                   object_visit((object_t *)attrs->table[j].tval, ctx);
@@ -405,18 +580,22 @@ object_t *object_rewrite(object_t *object, object_rewrite_ctx_t *ctx)
                (tree_t)object_rewrite((object_t *)object->items[n].tree, ctx);
          else if (ITEM_TREE_ARRAY & mask) {
             tree_array_t *a = &(object->items[n].tree_array);
+            object_check_deferred(object, a);
 
-            for (size_t i = 0; i < a->count; i++)
-               a->items[i] =
-                  (tree_t)object_rewrite((object_t *)a->items[i], ctx);
+            // The rewrite function may append to this array and move
+            // its storage so the result must be stored afterwards
+            for (size_t i = 0; i < tree_array_count(a); i++) {
+               object_t *new = object_rewrite((object_t *)a->items[i], ctx);
+               a->items[i] = (tree_t)new;
+            }
 
             // If an item was rewritten to NULL then delete it
             size_t n = 0;
-            for (size_t i = 0; i < a->count; i++) {
+            for (size_t i = 0; i < tree_array_count(a); i++) {
                if (a->items[i] != NULL)
                   a->items[n++] = a->items[i];
             }
-            a->count = n;
+            tree_array_resize(a, n, 0);
          }
          else if (ITEM_TYPE & mask)
             type_item = n;
@@ -428,12 +607,12 @@ object_t *object_rewrite(object_t *object, object_rewrite_ctx_t *ctx)
             ;
          else if (ITEM_TYPE_ARRAY & mask) {
             type_array_t *a = &(object->items[n].type_array);
-            for (unsigned i = 0; i < a->count; i++)
+            for (unsigned i = 0; i < type_array_count(a); i++)
                (void)object_rewrite((object_t *)a->items[i], ctx);
          }
          else if (ITEM_RANGE_ARRAY & mask) {
             range_array_t *a = &(object->items[n].range_array);
-            for (unsigned i = 0; i < a->count; i++) {
+            for (unsigned i = 0; i < range_array_count(a); i++) {
                a->items[i].left =
                   (tree_t)object_rewrite((object_t *)a->items[i].left, ctx);
                a->items[i].right =
@@ -515,6 +694,7 @@ void object_write(object_t *object, object_wr_ctx_t *ctx)
 
    const object_class_t *class = classes[object->tag];
 
+   const tree_array_t *deferred = NULL;
    const imask_t has = class->has_map[object->kind];
    const int nitems = class->object_nitems[object->kind];
    imask_t mask = 1;
@@ -528,14 +708,19 @@ void object_write(object_t *object, object_wr_ctx_t *ctx)
             object_write((object_t *)object->items[n].type, ctx);
          else if (ITEM_TREE_ARRAY & mask) {
             const tree_array_t *a = &(object->items[n].tree_array);
-            write_u32(a->count, ctx->file);
-            for (unsigned i = 0; i < a->count; i++)
-               object_write((object_t *)a->items[i], ctx);
+            object_check_deferred(object, a);
+            write_u32(tree_array_count(a), ctx->file);
+            if (object_is_deferred(class, object, mask))
+               deferred = a;
+            else {
+               for (unsigned i = 0; i < tree_array_count(a); i++)
+                  object_write((object_t *)a->items[i], ctx);
+            }
          }
          else if (ITEM_TYPE_ARRAY & mask) {
             const type_array_t *a = &(object->items[n].type_array);
-            write_u16(a->count, ctx->file);
-            for (unsigned i = 0; i < a->count; i++)
+            write_u16(type_array_count(a), ctx->file);
+            for (unsigned i = 0; i < type_array_count(a); i++)
                object_write((object_t *)a->items[i], ctx);
          }
          else if (ITEM_INT64 & mask)
@@ -543,17 +728,30 @@ void object_write(object_t *object, object_wr_ctx_t *ctx)
          else if (ITEM_INT32 & mask)
             write_u32(object->items[n].ival, ctx->file);
          else if (ITEM_NETID_ARRAY & mask) {
+            // Nets are almost always allocated in consecutive runs so
+            // are stored as the first net and length of each run
             const netid_array_t *a = &(object->items[n].netid_array);
-            write_u32(a->count, ctx->file);
-            for (unsigned i = 0; i < a->count; i++)
-               write_u32(a->items[i], ctx->file);
+            const unsigned count = netid_array_count(a);
+            write_u32(count, ctx->file);
+            for (unsigned i = 0, len; i < count; i += len) {
+               const netid_t first = a->items[i];
+               for (len = 1; i + len < count; len++) {
+                  const netid_t expect =
+                     (first == NETID_INVALID) ? first : first + len;
+                  if (a->items[i + len] != expect)
+                     break;
+               }
+               write_u32(first, ctx->file);
+               write_u32(len, ctx->file);
+            }
          }
          else if (ITEM_DOUBLE & mask)
             write_double(object->items[n].dval, ctx->file);
          else if (ITEM_ATTRS & mask) {
-            const attr_tab_t *attrs = &(object->items[n].attrs);
-            write_u16(attrs->num, ctx->file);
-            for (unsigned i = 0; i < attrs->num; i++) {
+            const attr_tab_t *attrs = object->items[n].attrs;
+            const unsigned nattrs = (attrs == NULL) ? 0 : attrs->num;
+            write_u16(nattrs, ctx->file);
+            for (unsigned i = 0; i < nattrs; i++) {
                write_u16(attrs->table[i].kind, ctx->file);
                ident_write(attrs->table[i].name, ctx->ident_ctx);
 
@@ -577,8 +775,8 @@ void object_write(object_t *object, object_wr_ctx_t *ctx)
          }
          else if (ITEM_RANGE_ARRAY & mask) {
             range_array_t *a = &(object->items[n].range_array);
-            write_u16(a->count, ctx->file);
-            for (unsigned i = 0; i < a->count; i++) {
+            write_u16(range_array_count(a), ctx->file);
+            for (unsigned i = 0; i < range_array_count(a); i++) {
                write_u8(a->items[i].kind, ctx->file);
                object_write((object_t *)a->items[i].left, ctx);
                object_write((object_t *)a->items[i].right, ctx);
@@ -591,6 +789,14 @@ void object_write(object_t *object, object_wr_ctx_t *ctx)
          n++;
       }
    }
+
+   if (deferred != NULL) {
+      // Start a new block so the reader can stop here and later resume
+      // from a copy of the remaining blocks
+      (void)fbuf_tell(ctx->file);
+      for (unsigned i = 0; i < tree_array_count(deferred); i++)
+         object_write((object_t *)deferred->items[i], ctx);
+   }
 }
 
 object_wr_ctx_t *object_write_begin(fbuf_t *f)
@@ -613,6 +819,47 @@ void object_write_end(object_wr_ctx_t *ctx)
    free(ctx);
 }
 
+static void object_defer_read(object_t *object, object_rd_ctx_t *ctx)
+{
+   // The rest of the file is kept compressed in memory along with the
+   // state needed to resolve back references and identifiers
+   object_rd_ctx_t *saved = xmalloc(sizeof(object_rd_ctx_t));
+   *saved = *ctx;
+   saved->file     = fbuf_split(ctx->file);
+   saved->db_fname = xstrdup(ctx->db_fname);
+
+   ident_read_switch(saved->ident_ctx, saved->file);
+
+   ctx->ident_ctx = NULL;
+   ctx->store     = NULL;
+
+   if (deferred_map == NULL)
+      deferred_map = hash_new(64, true);
+   hash_put(deferred_map, object, saved);
+}
+
+void object_read_deferred(object_t *object)
+{
+   object_rd_ctx_t *ctx = object_take_deferred(object);
+   assert(ctx != NULL);
+
+   const object_class_t *class = classes[object->tag];
+   const int tzc = __builtin_ctzll(class->deferred_item);
+   const int n = class->item_lookup[(object->kind * 64) + tzc];
+   tree_array_t *a = &(object->items[n].tree_array);
+
+   // New objects belong to the same arena as the rest of the unit
+   object_arena_t *saved_arena = current_arena;
+   current_arena = ctx->arena;
+
+   for (unsigned i = 0; i < tree_array_count(a); i++)
+      a->items[i] = (tree_t)object_read(ctx, OBJECT_TAG_TREE);
+
+   current_arena = saved_arena;
+
+   object_free_deferred(ctx);
+}
+
 object_t *object_read(object_rd_ctx_t *ctx, int tag)
 {
    uint16_t marker = read_u16(ctx->file);
@@ -644,6 +891,7 @@ object_t *object_read(object_rd_ctx_t *ctx, int tag)
    }
    ctx->store[object->index] = object;
 
+   bool deferred = false;
    const imask_t has = class->has_map[object->kind];
    const int nitems = class->object_nitems[object->kind];
    imask_t mask = 1;
@@ -658,13 +906,17 @@ object_t *object_read(object_rd_ctx_t *ctx, int tag)
          else if (ITEM_TREE_ARRAY & mask) {
             tree_array_t *a = &(object->items[n].tree_array);
             tree_array_resize(a, read_u32(ctx->file), 0);
-            for (unsigned i = 0; i < a->count; i++)
-               a->items[i] = (tree_t)object_read(ctx, OBJECT_TAG_TREE);
+            if (object_is_deferred(class, object, mask))
+               deferred = tree_array_count(a) > 0;
+            else {
+               for (unsigned i = 0; i < tree_array_count(a); i++)
+                  a->items[i] = (tree_t)object_read(ctx, OBJECT_TAG_TREE);
+            }
          }
          else if (ITEM_TYPE_ARRAY & mask) {
             type_array_t *a = &(object->items[n].type_array);
             type_array_resize(a, read_u16(ctx->file), 0);
-            for (unsigned i = 0; i < a->count; i++)
+            for (unsigned i = 0; i < type_array_count(a); i++)
                a->items[i] = (type_t)object_read(ctx, OBJECT_TAG_TYPE);
          }
          else if (ITEM_INT64 & mask)
@@ -675,7 +927,7 @@ object_t *object_read(object_rd_ctx_t *ctx, int tag)
             range_array_t *a = &(object->items[n].range_array);
             range_array_resize(a, read_u16(ctx->file), 0);
 
-            for (unsigned i = 0; i < a->count; i++) {
+            for (unsigned i = 0; i < range_array_count(a); i++) {
                a->items[i].kind  = read_u8(ctx->file);
                a->items[i].left  =
                   (tree_t)object_read(ctx, OBJECT_TAG_TREE);
@@ -687,22 +939,33 @@ object_t *object_read(object_rd_ctx_t *ctx, int tag)
             ;
          else if (ITEM_NETID_ARRAY & mask) {
             netid_array_t *a = &(object->items[n].netid_array);
-            netid_array_resize(a, read_u32(ctx->file), 0xff);
-            for (unsigned i = 0; i < a->count; i++)
-               a->items[i] = read_u32(ctx->file);
+            const unsigned count = read_u32(ctx->file);
+            netid_array_resize(a, count, 0xff);
+            for (unsigned i = 0; i < count; ) {
+               const netid_t first = read_u32(ctx->file);
+               const unsigned len = read_u32(ctx->file);
+               if (len == 0 || i + len > count)
+                  fatal("%s: corrupt net range",
+                        fbuf_file_name(ctx->file));
+
+               for (unsigned j = 0; j < len; j++, i++)
+                  a->items[i] = (first == NETID_INVALID) ? first : first + j;
+            }
          }
          else if (ITEM_DOUBLE & mask)
             object->items[n].dval = read_double(ctx->file);
          else if (ITEM_ATTRS & mask) {
-            attr_tab_t *attrs = &(object->items[n].attrs);
-
-            attrs->num = read_u16(ctx->file);
-            if (attrs->num > 0) {
-               attrs->alloc = next_power_of_2(attrs->num);
-               attrs->table = xmalloc(sizeof(attr_t) * attrs->alloc);
+            const unsigned nattrs = read_u16(ctx->file);
+            attr_tab_t *attrs = NULL;
+            if (nattrs > 0) {
+               const unsigned alloc = next_power_of_2(nattrs);
+               attrs = xmalloc(sizeof(attr_tab_t) + sizeof(attr_t) * alloc);
+               attrs->alloc = alloc;
+               attrs->num   = nattrs;
             }
+            object->items[n].attrs = attrs;
 
-            for (unsigned i = 0; i < attrs->num; i++) {
+            for (unsigned i = 0; i < nattrs; i++) {
                attrs->table[i].kind = read_u16(ctx->file);
                attrs->table[i].name = ident_read(ctx->ident_ctx);
 
@@ -731,6 +994,9 @@ object_t *object_read(object_rd_ctx_t *ctx, int tag)
       }
    }
 
+   if (deferred)
+      object_defer_read(object, ctx);
+
    return object;
 }
 
@@ -759,6 +1025,11 @@ object_rd_ctx_t *object_read_begin(fbuf_t *f, const char *fname)
    ctx->n_objects = 0;
    ctx->db_fname  = xstrdup(fname);
 
+   // Each unit read from a library gets its own arena
+   ctx->saved_arena = current_arena;
+   object_new_arena();
+   ctx->arena = current_arena;
+
    return ctx;
 }
 
@@ -766,6 +1037,8 @@ void object_read_end(object_rd_ctx_t *ctx)
 {
    if (ctx->ident_ctx != NULL)
       ident_read_end(ctx->ident_ctx);
+   current_arena = ctx->saved_arena;
+
    free(ctx->store);
    free(ctx->db_fname);
    free(ctx);
@@ -810,13 +1083,14 @@ bool object_copy_mark(object_t *object, object_copy_ctx_t *ctx)
             ;
          else if (ITEM_TREE_ARRAY & mask) {
             tree_array_t *a = &(object->items[n].tree_array);
-            for (unsigned i = 0; i < a->count; i++)
+            object_check_deferred(object, a);
+            for (unsigned i = 0; i < tree_array_count(a); i++)
                marked = object_copy_mark((object_t *)a->items[i], ctx)
                   || marked;
          }
          else if (ITEM_TYPE_ARRAY & mask) {
             type_array_t *a = &(object->items[n].type_array);
-            for (unsigned i = 0; i < a->count; i++)
+            for (unsigned i = 0; i < type_array_count(a); i++)
                marked = object_copy_mark((object_t *)a->items[i], ctx)
                   || marked;
          }
@@ -828,7 +1102,7 @@ bool object_copy_mark(object_t *object, object_copy_ctx_t *ctx)
             ;
          else if (ITEM_RANGE_ARRAY & mask) {
             range_array_t *a = &(object->items[n].range_array);
-            for (unsigned i = 0; i < a->count; i++) {
+            for (unsigned i = 0; i < range_array_count(a); i++) {
                marked = object_copy_mark((object_t *)a->items[i].left, ctx)
                   || marked;
                marked = object_copy_mark((object_t *)a->items[i].right, ctx)
@@ -898,9 +1172,9 @@ object_t *object_copy_sweep(object_t *object, object_copy_ctx_t *ctx)
             const tree_array_t *from = &(object->items[n].tree_array);
             tree_array_t *to = &(copy->items[n].tree_array);
 
-            tree_array_resize(to, from->count, 0);
+            tree_array_resize(to, tree_array_count(from), 0);
 
-            for (size_t i = 0; i < from->count; i++)
+            for (size_t i = 0; i < tree_array_count(from); i++)
                to->items[i] = (tree_t)
                   object_copy_sweep((object_t *)from->items[i], ctx);
          }
@@ -913,27 +1187,26 @@ object_t *object_copy_sweep(object_t *object, object_copy_ctx_t *ctx)
             const netid_array_t *from = &(object->items[n].netid_array);
             netid_array_t *to = &(copy->items[n].netid_array);
 
-            netid_array_resize(to, from->count, 0xff);
+            netid_array_resize(to, netid_array_count(from), 0xff);
 
-            for (unsigned i = 0; i < from->count; i++)
+            for (unsigned i = 0; i < netid_array_count(from); i++)
                to->items[i] = from->items[i];
          }
          else if (ITEM_ATTRS & mask) {
-            if ((copy->items[n].attrs.num = object->items[n].attrs.num) > 0) {
-               copy->items[n].attrs.alloc = object->items[n].attrs.alloc;
-               copy->items[n].attrs.table =
-                  xmalloc(sizeof(attr_t) * copy->items[n].attrs.alloc);
-               for (unsigned i = 0; i < object->items[n].attrs.num; i++)
-                  copy->items[n].attrs.table[i] =
-                     object->items[n].attrs.table[i];
+            const attr_tab_t *from = object->items[n].attrs;
+            if (from != NULL && from->num > 0) {
+               const size_t size =
+                  sizeof(attr_tab_t) + sizeof(attr_t) * from->alloc;
+               copy->items[n].attrs = xmalloc(size);
+               memcpy(copy->items[n].attrs, from, size);
             }
          }
          else if (ITEM_RANGE_ARRAY & mask) {
             const range_array_t *from = &(object->items[n].range_array);
             range_array_t *to = &(copy->items[n].range_array);
-            range_array_resize(to, from->count, 0);
+            range_array_resize(to, range_array_count(from), 0);
 
-            for (unsigned i = 0; i < from->count; i++) {
+            for (unsigned i = 0; i < range_array_count(from); i++) {
                to->items[i].kind = from->items[i].kind;
                to->items[i].left = (tree_t)
                   object_copy_sweep((object_t *)from->items[i].left, ctx);
@@ -945,9 +1218,9 @@ object_t *object_copy_sweep(object_t *object, object_copy_ctx_t *ctx)
             const type_array_t *from = &(object->items[n].type_array);
             type_array_t *to = &(copy->items[n].type_array);
 
-            type_array_resize(to, from->count, 0);
+            type_array_resize(to, type_array_count(from), 0);
 
-            for (unsigned i = 0; i < from->count; i++)
+            for (unsigned i = 0; i < type_array_count(from); i++)
                to->items[i] = (type_t)
                   object_copy_sweep((object_t *)from->items[i], ctx);
          }
@@ -977,9 +1250,9 @@ void object_replace(object_t *t, object_t *a)
             const type_array_t *from = &(a->items[n].type_array);
             type_array_t *to = &(t->items[n].type_array);
 
-            type_array_resize(to, from->count, 0);
+            type_array_resize(to, type_array_count(from), 0);
 
-            for (unsigned i = 0; i < from->count; i++)
+            for (unsigned i = 0; i < type_array_count(from); i++)
                to->items[i] = from->items[i];
          }
          else if (ITEM_TYPE & mask)
@@ -989,19 +1262,21 @@ void object_replace(object_t *t, object_t *a)
          else if (ITEM_TREE_ARRAY & mask) {
             const tree_array_t *from = &(a->items[n].tree_array);
             tree_array_t *to = &(t->items[n].tree_array);
+            object_check_deferred(a, from);
+            object_check_deferred(t, to);
 
-            tree_array_resize(to, from->count, 0);
+            tree_array_resize(to, tree_array_count(from), 0);
 
-            for (size_t i = 0; i < from->count; i++)
+            for (size_t i = 0; i < tree_array_count(from); i++)
                to->items[i] = from->items[i];
          }
          else if (ITEM_RANGE_ARRAY & mask) {
             const range_array_t *from = &(a->items[n].range_array);
             range_array_t *to = &(t->items[n].range_array);
 
-            range_array_resize(to, from->count, 0);
+            range_array_resize(to, range_array_count(from), 0);
 
-            for (unsigned i = 0; i < from->count; i++)
+            for (unsigned i = 0; i < range_array_count(from); i++)
                to->items[i] = from->items[i];
          }
          else if (ITEM_TEXT_BUF & mask)
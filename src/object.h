@@ -106,11 +106,11 @@ typedef uint64_t imask_t;
 #define OBJECT_TAG_TREE  0
 #define OBJECT_TAG_TYPE  1
 
-DECLARE_ARRAY(netid);
-DECLARE_ARRAY(range);
-DECLARE_ARRAY(tree);
-DECLARE_ARRAY(type);
-DECLARE_ARRAY(ident);
+DECLARE_PACKED_ARRAY(netid);
+DECLARE_PACKED_ARRAY(range);
+DECLARE_PACKED_ARRAY(tree);
+DECLARE_PACKED_ARRAY(type);
+DECLARE_PACKED_ARRAY(ident);
 
 #define lookup_item(class, t, mask) ({                                  \
          assert((t) != NULL);                                           \
@@ -150,9 +150,11 @@ typedef struct {
 typedef struct {
    uint16_t  alloc;
    uint16_t  num;
-   attr_t   *table;
+   attr_t    table[0];
 } attr_tab_t;
 
+// Every item is a single word so an object is only as large as the
+// header plus one word for each item in its kind's mask
 typedef union {
    ident_t        ident;
    tree_t         tree;
@@ -166,7 +168,7 @@ typedef union {
    range_array_t  range_array;
    text_buf_t    *text_buf;
    type_array_t   type_array;
-   attr_tab_t     attrs;
+   attr_tab_t    *attrs;
    ident_array_t  ident_array;
 } item_t;
 
@@ -217,11 +219,29 @@ typedef struct {
    const int               last_kind;
    const int               gc_roots[6];
    const int               gc_num_roots;
+   const int               deferred_kind;
+   const imask_t           deferred_item;
    int                    *object_nitems;
    size_t                 *object_size;
    int                    *item_lookup;
+   size_t                 *live_count;
 } object_class_t;
 
+// Objects are allocated from an arena which is only freed as a whole
+// once none of its objects are reachable
+#define ARENA_CHUNK_SIZE (64 * 1024)
+
+typedef struct {
+   object_t **objects;
+   unsigned   n_objects;
+   unsigned   max_objects;
+   char      *alloc_ptr;
+   char      *alloc_limit;
+   void     **chunks;
+   unsigned   n_chunks;
+   unsigned   max_chunks;
+} object_arena_t;
+
 typedef struct {
    fbuf_t         *file;
    ident_wr_ctx_t  ident_ctx;
@@ -236,6 +256,8 @@ typedef struct {
    object_t      **store;
    unsigned        store_sz;
    char           *db_fname;
+   object_arena_t *arena;
+   object_arena_t *saved_arena;
 } object_rd_ctx_t;
 
 __attribute__((noreturn))
@@ -249,6 +271,10 @@ void object_change_kind(const object_class_t *class,
 object_t *object_new(const object_class_t *class, int kind);
 void object_one_time_init(void);
 void object_gc(void);
+void object_counts(uint64_t *total, size_t *live);
+void object_mem_stats(void);
+void object_new_arena(void);
+void object_read_deferred(object_t *object);
 void object_visit(object_t *object, object_visit_ctx_t *ctx);
 object_t *object_rewrite(object_t *object, object_rewrite_ctx_t *ctx);
 unsigned object_next_generation(void);
@@ -55,15 +55,14 @@ struct cond_state {
    loc_t         loc;
 };
 
-static const char   *perm_linebuf = NULL;
 static ident_t       perm_file_name = NULL;
-static int           n_token_next_start = 0;
 static int           n_row = 0;
-static bool          last_was_newline = true;
+static size_t        line_start;
+static size_t        line_scanned;
 static loc_t         start_loc;
 static loc_t         last_loc;
-static const char   *read_ptr;
 static const char   *file_start;
+static char         *scan_start;
 static size_t        file_sz;
 static int           n_errors = 0;
 static const char   *hint_str = NULL;
@@ -79,6 +78,7 @@ static cond_state_t *cond_state = NULL;
 
 loc_t yylloc;
 int yylex(void);
+void begin_input(char *buf, size_t size);
 
 #define scan(...) _scan(1, __VA_ARGS__, -1)
 #define expect(...) _expect(1, __VA_ARGS__, -1)
@@ -721,14 +721,14 @@ static bool p_cond_analysis_relation(void)
 
    case tID:
       {
-         char *name = last_lval.s;
+         ident_t name = last_lval.ident;
          token_t rel = one_of(tEQ, tNEQ, tLT, tLE, tGT, tGE);
 
          if (consume(tSTRING)) {
-            const char *value = get_cond_analysis_identifier(name);
+            const char *value = get_cond_analysis_identifier(istr(name));
             if (value == NULL)
                parse_error(CURRENT_LOC, "undefined conditional analysis "
-                           "identifier %s", name);
+                           "identifier %s", istr(name));
             else {
                char *cmp = last_lval.s + 1;
                cmp[strlen(cmp) - 1] = '\0';
@@ -759,8 +759,6 @@ static bool p_cond_analysis_relation(void)
 
             free(last_lval.s);
          }
-
-         free(name);
       }
       break;
    }
@@ -802,12 +800,8 @@ static ident_t p_identifier(void)
 {
    // basic_identifier | extended_identifier
 
-   if (consume(tID)) {
-      char *s = last_lval.s;
-      ident_t i = ident_new(s);
-      free(s);
-      return i;
-   }
+   if (consume(tID))
+      return last_lval.ident;
    else
       return ident_new("error");
 }
@@ -5789,52 +5783,40 @@ static tree_t p_design_unit(void)
    return unit;
 }
 
-void begin_token(char *tok)
+void begin_token(char *tok, int length)
 {
-   const char *newline = strrchr(tok, '\n');
-   int n_token_start, n_token_length;
-   if (newline != NULL) {
-      n_token_start = 0;
-      n_token_length = strlen(tok) - (newline - tok);
-      n_token_next_start = n_token_length - 1;
+   // The lexer scans the file in place so the position of the token is
+   // its offset from the start of the buffer: count the lines from the
+   // end of the last scan here rather than in the token actions as the
+   // same text may be seen twice if a rule is rejected
+   const size_t offset = tok - scan_start;
+   while (line_scanned < offset) {
+      const char *nl = memchr(file_start + line_scanned, '\n',
+                              offset - line_scanned);
+      if (nl == NULL)
+         line_scanned = offset;
+      else {
+         n_row++;
+         line_start = line_scanned = nl - file_start + 1;
+      }
    }
-   else {
-      n_token_start = n_token_next_start;
-      n_token_length = strlen(tok);
-      n_token_next_start += n_token_length;
+
+   int last_line = n_row;
+   size_t last_start = line_start;
+   for (const char *p = tok; (p = memchr(p, '\n', tok + length - p)); ) {
+      last_line++;
+      last_start = ++p - scan_start;
    }
 
-   const int last_col = n_token_start + n_token_length - 1;
+   const int first_col = offset - line_start;
+   const int last_col  = MAX((int)(offset + length - last_start), 1) - 1;
 
    yylloc.first_line   = MIN(n_row, LINE_INVALID);
-   yylloc.first_column = MIN(n_token_start, COLUMN_INVALID);
-   yylloc.last_line    = MIN(n_row, LINE_INVALID);
+   yylloc.first_column = MIN(first_col, COLUMN_INVALID);
+   yylloc.last_line    = MIN(last_line, LINE_INVALID);
    yylloc.last_column  = MIN(last_col, COLUMN_INVALID);
    yylloc.file         = perm_file_name;
-   yylloc.linebuf      = perm_linebuf;
-}
-
-int get_next_char(char *b, int max_buffer)
-{
-   if (last_was_newline) {
-      n_row += 1;
-      perm_linebuf = read_ptr;
-      last_was_newline = false;
-   }
-
-   const bool eof = read_ptr >= file_start + file_sz;
-   if (eof)
-      return 0;
-   else
-      *b = *read_ptr++;
-
-   if (perm_linebuf == NULL)
-      perm_linebuf = read_ptr;
-
-   if (*b == '\n')
-      last_was_newline = true;
-
-   return *b == 0 ? 0 : 1;
+   yylloc.linebuf      = file_start + line_start;
 }
 
 void input_from_file(const char *file)
@@ -5852,16 +5834,22 @@ void input_from_file(const char *file)
 
    file_sz = buf.st_size;
 
+   // The lexer writes into the buffer it scans so error messages print
+   // the source line from a separate read-only mapping
    if (file_sz > 0)
       file_start = map_file(fd, file_sz);
    else
       file_start = NULL;
 
-   read_ptr           = file_start;
-   last_was_newline   = true;
-   perm_file_name     = ident_new(file);
-   n_row              = 0;
-   n_token_next_start = 0;
+   scan_start = map_file_padded(fd, file_sz, 2);
+   begin_input(scan_start, file_sz);
+
+   close(fd);
+
+   perm_file_name = ident_new(file);
+   n_row          = 1;
+   line_start     = 0;
+   line_scanned   = 0;
 
    if (tokenq == NULL) {
       tokenq_sz = 128;
@@ -5879,6 +5867,8 @@ tree_t parse(void)
    if (peek() == tEOF)
       return NULL;
 
+   tree_new_arena();
+
    tree_t unit = p_design_unit();
 
    while (cond_state != NULL) {
@@ -0,0 +1,313 @@
+//
+//  Copyright (C) 2018  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "util.h"
+#include "phase.h"
+#include "hash.h"
+#include "object.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define MAX_DEPTH 16
+#define MAX_TOP   5
+
+typedef struct {
+   ident_t  what;
+   uint64_t wall_us;
+   uint64_t ops;
+} phase_item_t;
+
+typedef struct {
+   const char   *name;
+   unsigned      depth;
+   unsigned      calls;
+   uint64_t      wall_us;
+   uint64_t      cpu_ms;
+   int64_t       rss_kb;
+   uint64_t      objects;
+   size_t        live;
+   uint64_t      ops;
+   phase_item_t *items;
+   unsigned      nitems;
+   unsigned      max_items;
+   hash_t       *item_map;
+} phase_t;
+
+typedef struct {
+   unsigned     phase;
+   int          outer;      // Enclosing frame for the same phase or -1
+   uint64_t     start_us;
+   uint64_t     inner_us;   // Time in nested frames for the same phase
+   uint64_t     ops;
+   nvc_rusage_t ru;
+   uint64_t     objects;
+} phase_frame_t;
+
+static bool           enabled = false;
+static phase_report_t report_style;
+static phase_t       *phases = NULL;
+static unsigned       nphases = 0;
+static unsigned       max_phases = 16;
+static phase_frame_t  stack[MAX_DEPTH];
+static int            depth = 0;
+
+static unsigned phase_get(const char *name)
+{
+   for (unsigned i = 0; i < nphases; i++) {
+      if (strcmp(phases[i].name, name) == 0)
+         return i;
+   }
+
+   // Phases are reported in the order they first run indented below
+   // the phase which was active at the time
+   phase_t p = {
+      .name     = name,
+      .depth    = depth > 0 ? phases[stack[depth - 1].phase].depth + 1 : 0,
+      .item_map = hash_new_kind(64, true, HASH_PTR)
+   };
+   ARRAY_APPEND(phases, p, nphases, max_phases);
+
+   return nphases - 1;
+}
+
+static void phase_credit(phase_t *p, ident_t what, uint64_t us,
+                         uint64_t ops)
+{
+   const uintptr_t n = (uintptr_t)hash_get(p->item_map, what);
+   if (n == 0) {
+      if (p->items == NULL) {
+         p->max_items = 16;
+         p->items = xmalloc(p->max_items * sizeof(phase_item_t));
+      }
+
+      phase_item_t item = { what, us, ops };
+      ARRAY_APPEND(p->items, item, p->nitems, p->max_items);
+      hash_put(p->item_map, what, (void *)(uintptr_t)p->nitems);
+   }
+   else {
+      p->items[n - 1].wall_us += us;
+      p->items[n - 1].ops     += ops;
+   }
+}
+
+void phase_begin(const char *name)
+{
+   if (!enabled)
+      return;
+
+   if (depth == MAX_DEPTH)
+      fatal_trace("too many nested phases");
+
+   phase_frame_t *f = &(stack[depth]);
+   f->phase    = phase_get(name);
+   f->outer    = -1;
+   f->inner_us = 0;
+   f->ops      = 0;
+
+   for (int i = depth - 1; i >= 0 && f->outer == -1; i--) {
+      if (stack[i].phase == f->phase)
+         f->outer = i;
+   }
+
+   if (f->outer == -1) {
+      size_t live;
+      nvc_rusage_total(&(f->ru));
+      object_counts(&(f->objects), &live);
+   }
+
+   f->start_us = get_timestamp_us();
+   depth++;
+}
+
+void phase_end(ident_t what)
+{
+   if (!enabled)
+      return;
+
+   assert(depth > 0);
+   phase_frame_t *f = &(stack[--depth]);
+   phase_t *p = &(phases[f->phase]);
+
+   const uint64_t elapsed = get_timestamp_us() - f->start_us;
+
+   if (f->outer == -1) {
+      nvc_rusage_t ru;
+      nvc_rusage_total(&ru);
+
+      uint64_t objects;
+      object_counts(&objects, &(p->live));
+
+      p->calls++;
+      p->wall_us += elapsed;
+      p->cpu_ms  += ru.ms - f->ru.ms;
+      p->rss_kb  += (int)ru.rss - (int)f->ru.rss;
+      p->objects += objects - f->objects;
+   }
+   else
+      stack[f->outer].inner_us += elapsed;
+
+   if (what != NULL)
+      phase_credit(p, what, elapsed - MIN(f->inner_us, elapsed), f->ops);
+}
+
+void phase_restart_usage(void)
+{
+   if (!enabled)
+      return;
+
+   for (int i = 0; i < depth; i++) {
+      if (stack[i].outer == -1)
+         nvc_rusage_total(&(stack[i].ru));
+   }
+}
+
+void phase_add_ops(unsigned count)
+{
+   if (enabled && depth > 0) {
+      stack[depth - 1].ops += count;
+      phases[stack[depth - 1].phase].ops += count;
+   }
+}
+
+static int phase_item_cmp(const void *a, const void *b)
+{
+   const phase_item_t *l = a, *r = b;
+   if (l->wall_us != r->wall_us)
+      return l->wall_us < r->wall_us ? 1 : -1;
+   else
+      return 0;
+}
+
+static void phase_json_string(FILE *f, const char *str)
+{
+   fputc('"', f);
+   for (const char *p = str; *p != '\0'; p++) {
+      if (*p == '"' || *p == '\\')
+         fprintf(f, "\\%c", *p);
+      else if ((unsigned char)*p < 0x20)
+         fprintf(f, "\\u%04x", *p);
+      else
+         fputc(*p, f);
+   }
+   fputc('"', f);
+}
+
+static void phase_print_json(FILE *f)
+{
+   fprintf(f, "{\n  \"phases\": [");
+
+   bool first = true;
+   for (unsigned i = 0; i < nphases; i++) {
+      const phase_t *p = &(phases[i]);
+      if (p->calls == 0)
+         continue;
+
+      fprintf(f, "%s\n    {\n      \"name\": ", first ? "" : ",");
+      first = false;
+      phase_json_string(f, p->name);
+      fprintf(f, ",\n      \"depth\": %u,\n", p->depth);
+      fprintf(f, "      \"calls\": %u,\n", p->calls);
+      fprintf(f, "      \"wall_us\": %"PRIu64",\n", p->wall_us);
+      fprintf(f, "      \"cpu_ms\": %"PRIu64",\n", p->cpu_ms);
+      fprintf(f, "      \"rss_delta_kb\": %"PRIi64",\n", p->rss_kb);
+      fprintf(f, "      \"objects\": %"PRIu64",\n", p->objects);
+      fprintf(f, "      \"live_objects\": %zu,\n", p->live);
+      fprintf(f, "      \"vcode_ops\": %"PRIu64",\n", p->ops);
+      fprintf(f, "      \"contributors\": %u,\n", p->nitems);
+      fprintf(f, "      \"top\": [");
+
+      for (unsigned j = 0; j < MIN(p->nitems, MAX_TOP); j++) {
+         fprintf(f, "%s\n        { \"name\": ", j == 0 ? "" : ",");
+         phase_json_string(f, istr(p->items[j].what));
+         fprintf(f, ", \"wall_us\": %"PRIu64", \"vcode_ops\": %"PRIu64" }",
+                 p->items[j].wall_us, p->items[j].ops);
+      }
+
+      fprintf(f, "%s]\n    }", p->nitems > 0 ? "\n      " : "");
+   }
+
+   fprintf(f, "%s]\n}\n", first ? "" : "\n  ");
+}
+
+static void phase_print_text(FILE *f)
+{
+   fprintf(f, "%-24s %6s %10s %8s %9s %10s %10s\n", "phase", "calls",
+           "wall ms", "cpu ms", "rss kB", "objects", "ops");
+
+   for (unsigned i = 0; i < nphases; i++) {
+      const phase_t *p = &(phases[i]);
+      if (p->calls == 0)
+         continue;
+
+      fprintf(f, "%*s%-*s %6u %10.1f %8"PRIu64" %+9"PRIi64" %10"PRIu64
+              " %10"PRIu64"\n", p->depth * 2, "", 24 - p->depth * 2,
+              p->name, p->calls, p->wall_us / 1000.0, p->cpu_ms,
+              p->rss_kb, p->objects, p->ops);
+
+      // Contributors are listed below with only their own time
+      for (unsigned j = 0; j < MIN(p->nitems, MAX_TOP); j++)
+         fprintf(f, "%*s%-*s %6s %10.1f %8s %9s %10s %10"PRIu64"\n",
+                 p->depth * 2 + 2, "", 22 - p->depth * 2,
+                 istr(p->items[j].what), "", p->items[j].wall_us / 1000.0,
+                 "", "", "", p->items[j].ops);
+   }
+}
+
+static void phase_report(void)
+{
+   if (!enabled)
+      return;
+
+   // Phases still running after an error are counted up to the exit
+   while (depth > 0)
+      phase_end(NULL);
+
+   for (unsigned i = 0; i < nphases; i++) {
+      phase_t *p = &(phases[i]);
+      qsort(p->items, p->nitems, sizeof(phase_item_t), phase_item_cmp);
+      hash_free(p->item_map);
+      p->item_map = NULL;
+   }
+
+   fflush(stdout);
+
+   if (report_style == PHASE_REPORT_JSON)
+      phase_print_json(stderr);
+   else
+      phase_print_text(stderr);
+
+   for (unsigned i = 0; i < nphases; i++)
+      free(phases[i].items);
+   free(phases);
+   phases  = NULL;
+   nphases = 0;
+   enabled = false;
+}
+
+void phase_report_enable(phase_report_t style)
+{
+   if (!enabled) {
+      phases = xmalloc(max_phases * sizeof(phase_t));
+      atexit(phase_report);
+   }
+
+   report_style = style;
+   enabled      = true;
+}
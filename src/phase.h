@@ -38,10 +38,29 @@ bool sem_check(tree_t t);
 int sem_errors(void);
 void reset_sem_errors(void);
 
+// Number of function calls which did and did not reuse the overload
+// candidates found for an earlier call
+void sem_overload_stats(unsigned *hits, unsigned *misses);
+
 // The number of errors found while constant folding
 int eval_errors(void);
 void reset_eval_errors(void);
 
+// Number of calls to pure functions answered from or added to the cache
+void eval_memo_stats(unsigned *hits, unsigned *misses);
+
+// Code translated for functions called while folding is kept until
+// the end of elaboration
+void eval_free_code_cache(void);
+unsigned eval_code_cache_size(void);
+
+// Call compiled code for pure functions in analysed packages instead of
+// interpreting them: find returns the address of a function and call
+// runs it returning false if it failed a check or made a report
+typedef void *(*eval_find_fn_t)(ident_t unit, const char *symbol);
+typedef bool (*eval_call_fn_t)(void (*fn)(void *), void *context);
+void eval_set_native_fns(eval_find_fn_t find, eval_call_fn_t call);
+
 // Rewrite to simpler forms
 void simplify(tree_t top, eval_flags_t flags);
 
@@ -61,6 +80,9 @@ tree_t elab(tree_t top);
 // Set the value of a top-level generic
 void elab_set_generic(const char *name, const char *value);
 
+// Number of instances which reused an earlier identical instance
+void elab_memo_stats(unsigned *hits, unsigned *misses);
+
 // Generate LLVM bitcode for a design unit
 void cgen(tree_t top, vcode_unit_t vu);
 
@@ -73,9 +95,31 @@ void dump_nets(tree_t top);
 // Groups nets which never have sub-elements assigned.
 void group_nets(tree_t top);
 
+// Levelise combinational processes for cycle-based evaluation
+void cycle_regions(tree_t top);
+
 // Generate a makefile for the givein unit
 void make(tree_t *targets, int count, FILE *out);
 
+// Run a command from the generated makefile in a child process: the
+// command is -a or -e and the argument is the file or unit name
+typedef int (*make_job_fn_t)(const char *command, const char *arg);
+
+// Run the makefile rules which are out of date for the given units
+// with up to jobs commands at once and return the exit status
+int make_build(tree_t *targets, int count, int jobs, make_job_fn_t fn);
+
+typedef enum {
+   DEPEND_NONE,
+   DEPEND_ORDER,   // Redeclares a unit used or declared by the other file
+   DEPEND_USE      // Uses a unit declared by the other file
+} depend_t;
+
+// Scan source files for the design units they declare and use in the
+// work library: entry [i * nfiles + j] of the result says whether file i
+// must be analysed after file j
+depend_t *depend_scan(char **files, int nfiles, ident_t work);
+
 // Set parser input file
 void input_from_file(const char *file);
 
@@ -95,4 +139,28 @@ vcode_unit_t lower_thunk(tree_t fcall);
 // Lower an isolated function body
 vcode_unit_t lower_func(tree_t body);
 
+// Number of bounds checks removed by static range analysis
+void lower_bounds_stats(unsigned *elided, unsigned *total);
+
+typedef enum {
+   PHASE_REPORT_TEXT,
+   PHASE_REPORT_JSON
+} phase_report_t;
+
+// Print the time and memory used by each phase at exit. A phase may be
+// entered many times and its totals accumulate. Phases may nest: a
+// phase entered again while already active only adds the time to the
+// unit or process passed to phase_end so each phase can show its
+// largest contributors.
+void phase_report_enable(phase_report_t style);
+void phase_begin(const char *name);
+void phase_end(ident_t what);
+
+// Count vcode ops generated in the innermost active phase
+void phase_add_ops(unsigned count);
+
+// A forked child starts with no CPU time of its own so the phases
+// which are active measure from here instead
+void phase_restart_usage(void);
+
 #endif  // _PHASE_H
@@ -53,6 +53,7 @@ rt_alloc_stack_t rt_alloc_stack_new(size_t size, const char *name)
    s->item_sz   = size;
    s->name      = name;
    s->chunks    = NULL;
+   s->slow_allocs = 0;
 
    rt_alloc_add_objects(s, INIT_ITEMS);
 
@@ -79,6 +80,7 @@ void rt_alloc_stack_destroy(rt_alloc_stack_t s)
 void *rt_alloc_slow(rt_alloc_stack_t s)
 {
    if (s->stack_top == 0) {
+      s->slow_allocs++;
       s->stack_sz *= 2;
       s->stack = xrealloc(s->stack, sizeof(void *) * s->stack_sz);
 
@@ -31,6 +31,7 @@ struct rt_alloc_stack {
    size_t      item_sz;
    const char *name;
    rt_chunk_t *chunks;
+   unsigned    slow_allocs;
 };
 
 typedef struct rt_alloc_stack *rt_alloc_stack_t;
@@ -0,0 +1,266 @@
+//
+//  Copyright (C) 2018  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "util.h"
+#include "rt.h"
+#include "tree.h"
+#include "common.h"
+#include "cosimapi.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+
+// Connects the kernel to a foreign model through the channel described
+// in cosimapi.h. Changes to watched signals are sent from an event
+// callback as they happen. A timeout at each quantum boundary sends a
+// sync marker, waits for the model to acknowledge the previous boundary,
+// and forces any values it sent in response. If no watched signal
+// changed in the last quantum and nothing the model sent would change a
+// signal the boundaries stop until the next change to a watched signal
+// so the simulation can finish when the design is idle.
+
+typedef struct {
+   tree_t    decl;
+   uint64_t *values;
+   unsigned  count;
+   bool      forced;
+} cosim_signal_t;
+
+typedef struct {
+   int       signal;
+   uint64_t *values;
+} cosim_held_t;
+
+static cosim_t        *channel = NULL;
+static cosim_signal_t *signals = NULL;
+static cosim_held_t   *held = NULL;
+static unsigned        n_held = 0;
+static unsigned        max_held = 0;
+static uint64_t        quantum;
+static uint64_t        prev_sync;
+static bool            armed;
+static unsigned        changes;
+
+static tree_t cosim_find_signal(tree_t top, const char *name)
+{
+   // Names in the elaborated design are always lower case
+
+   char *lower LOCAL = xstrdup(name);
+   for (char *p = lower; *p != '\0'; p++)
+      *p = tolower((int)*p);
+
+   ident_t id = ident_new(lower);
+
+   const int ndecls = tree_decls(top);
+   for (int i = 0; i < ndecls; i++) {
+      tree_t d = tree_decl(top, i);
+      if (tree_kind(d) == T_SIGNAL_DECL && tree_ident(d) == id)
+         return d;
+   }
+
+   fatal("co-simulation signal %s not found in elaborated design", name);
+}
+
+static void cosim_boundary(uint64_t now, void *user);
+
+static void cosim_arm(uint64_t now)
+{
+   const uint64_t next = (now / quantum + 1) * quantum;
+   rt_set_timeout_cb(next - now, cosim_boundary, NULL);
+   armed = true;
+}
+
+static void cosim_event_cb(uint64_t now, tree_t decl, watch_t *w, void *user)
+{
+   cosim_signal_t *s = user;
+   rt_signal_value(decl, s->values, s->count);
+   cosim_put_change(channel, s - signals, now, s->values);
+
+   changes++;
+
+   if (!armed && !cosim_closed(channel))
+      cosim_arm(now);
+}
+
+static bool cosim_differs(cosim_signal_t *s, const uint64_t *values)
+{
+   if (!s->forced)
+      return true;
+
+   rt_signal_value(s->decl, s->values, s->count);
+   return memcmp(s->values, values, s->count * sizeof(uint64_t)) != 0;
+}
+
+static bool cosim_force(int signal, const uint64_t *values)
+{
+   cosim_signal_t *s = &(signals[signal]);
+   const bool differs = cosim_differs(s, values);
+
+   rt_force_signal(s->decl, values, s->count, true);
+   s->forced = true;
+
+   return differs;
+}
+
+static unsigned cosim_apply(uint64_t upto)
+{
+   // Force values sent by the model in response to syncs up to and
+   // including upto in the order they were sent and return how many
+   // changed a signal
+
+   unsigned count = 0;
+   for (unsigned i = 0; i < n_held; i++)
+      count += cosim_force(held[i].signal, held[i].values);
+   n_held = 0;
+
+   int signal;
+   const uint64_t *values;
+   unsigned nvalues;
+   while (cosim_get_drive(channel, upto, &signal, &values, &nvalues))
+      count += cosim_force(signal, values);
+
+   return count;
+}
+
+static void cosim_hold(uint64_t upto)
+{
+   // Take the values sent in response to a boundary in an idle quantum
+   // so the boundaries can stop if none of them change anything
+
+   int signal;
+   const uint64_t *values;
+   unsigned nvalues;
+   while (cosim_get_drive(channel, upto, &signal, &values, &nvalues)) {
+      cosim_signal_t *s = &(signals[signal]);
+      if (!cosim_differs(s, values))
+         continue;
+
+      if (n_held == max_held) {
+         max_held = MAX(max_held * 2, 16);
+         held = xrealloc(held, max_held * sizeof(cosim_held_t));
+         for (unsigned i = n_held; i < max_held; i++)
+            held[i].values = NULL;
+      }
+
+      cosim_held_t *h = &(held[n_held++]);
+      h->signal = signal;
+      h->values = xrealloc(h->values, nvalues * sizeof(uint64_t));
+      memcpy(h->values, values, nvalues * sizeof(uint64_t));
+   }
+}
+
+static void cosim_boundary(uint64_t now, void *user)
+{
+   armed = false;
+
+   if (cosim_closed(channel))
+      return;
+
+   // Let the model start on this quantum before waiting for it to
+   // finish the previous one
+   cosim_put_sync(channel, now);
+
+   const uint64_t prev = prev_sync;
+   prev_sync = now;
+
+   if (!cosim_wait_ack(channel, prev))
+      return;
+
+   const unsigned applied = cosim_apply(prev);
+
+   if (changes > 0 || applied > 0) {
+      changes = 0;
+      cosim_arm(now);
+   }
+   else if (cosim_wait_ack(channel, now)) {
+      cosim_hold(now);
+      if (n_held > 0)
+         cosim_arm(now);
+   }
+}
+
+static void cosim_start_cb(void *user)
+{
+   const int nsignals = cosim_signals(channel);
+   for (int i = 0; i < nsignals; i++) {
+      cosim_signal_t *s = &(signals[i]);
+      if (cosim_mode(channel, i) != COSIM_WATCH)
+         continue;
+
+      rt_set_event_cb(s->decl, cosim_event_cb, s, false);
+
+      rt_signal_value(s->decl, s->values, s->count);
+      cosim_put_change(channel, i, 0, s->values);
+   }
+
+   cosim_put_sync(channel, 0);
+
+   prev_sync = 0;
+   changes   = 0;
+   cosim_arm(0);
+}
+
+static void cosim_end_cb(void *user)
+{
+   const int nsignals = cosim_signals(channel);
+   for (int i = 0; i < nsignals; i++)
+      free(signals[i].values);
+   free(signals);
+
+   for (unsigned i = 0; i < max_held; i++)
+      free(held[i].values);
+   free(held);
+
+   cosim_put_end(channel);
+   cosim_detach(channel);
+
+   channel  = NULL;
+   signals  = NULL;
+   held     = NULL;
+   n_held   = 0;
+   max_held = 0;
+}
+
+void cosim_init(tree_t top, const char *file)
+{
+   channel = cosim_attach(file);
+   quantum = cosim_quantum(channel);
+
+   const int nsignals = cosim_signals(channel);
+   signals = xmalloc(nsignals * sizeof(cosim_signal_t));
+
+   for (int i = 0; i < nsignals; i++) {
+      tree_t decl = cosim_find_signal(top, cosim_name(channel, i));
+
+      cosim_signal_t *s = &(signals[i]);
+      s->decl   = decl;
+      s->count  = tree_nets(decl);
+      s->values = xmalloc(s->count * sizeof(uint64_t));
+      s->forced = false;
+
+      cosim_set_count(channel, i, s->count);
+   }
+
+   cosim_ready(channel);
+
+   rt_set_global_cb(RT_START_OF_SIMULATION, cosim_start_cb, NULL);
+   rt_set_global_cb(RT_END_OF_SIMULATION, cosim_end_cb, NULL);
+
+   notef("connected to co-simulation model with %d signals", nsignals);
+}
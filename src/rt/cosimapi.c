@@ -0,0 +1,647 @@
+//
+//  Copyright (C) 2018  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "util.h"
+#include "cosimapi.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+
+#ifndef __MINGW32__
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#endif
+
+// The channel file starts with a header followed by the signal table
+// and then the data for the two rings. Each ring has a head counter
+// written only by the producer and a tail counter written only by the
+// consumer, both giving a total number of bytes, on separate cache
+// lines. Records are a multiple of eight bytes and never wrap around
+// the end of the ring: if a record does not fit in the space left the
+// producer skips to the start, writing a padding record if there is
+// room for its header. A side waiting for the other spins briefly and
+// then sleeps, checking that the other process is still alive.
+
+#define COSIM_MAGIC     0x4d49534e   // "NSIM"
+#define COSIM_VERSION   1
+#define COSIM_MAX_NAME  256
+#define COSIM_DEF_RING  (1 << 20)
+#define COSIM_MIN_RING  4096
+#define COSIM_SPINS     1000
+#define COSIM_RETRIES   100
+#define COSIM_LINE      64
+
+typedef enum {
+   COSIM_R_CHANGE,
+   COSIM_R_SYNC,
+   COSIM_R_END,
+   COSIM_R_DRIVE,
+   COSIM_R_PAD
+} cosim_rec_kind_t;
+
+typedef struct {
+   uint32_t kind;
+   uint32_t signal;
+   uint64_t when;
+   uint32_t count;
+   uint32_t pad;
+} cosim_rec_t;
+
+typedef struct {
+   uint64_t head;
+   uint8_t  pad1[COSIM_LINE - sizeof(uint64_t)];
+   uint64_t tail;
+   uint8_t  pad2[COSIM_LINE - sizeof(uint64_t)];
+} cosim_ring_t;
+
+typedef struct {
+   char     name[COSIM_MAX_NAME];
+   uint32_t mode;
+   uint32_t count;
+} cosim_slot_t;
+
+typedef struct {
+   uint32_t     magic;
+   uint32_t     version;
+   uint64_t     quantum;
+   uint32_t     nsignals;
+   uint32_t     ring_size;
+   int32_t      model_pid;
+   int32_t      sim_pid;
+   uint32_t     attached;
+   uint32_t     closed;
+   uint64_t     horizon;
+   uint8_t      pad[COSIM_LINE - 48];
+   cosim_ring_t to_model;
+   cosim_ring_t to_sim;
+} cosim_header_t;
+
+typedef struct {
+   cosim_ring_t *ctl;
+   uint8_t      *data;
+   uint64_t      mask;
+   size_t        pending;
+} cosim_port_t;
+
+struct cosim {
+   char           *file;
+   bool            model;
+   uint8_t        *map;
+   size_t          size;
+   cosim_header_t *header;
+   cosim_slot_t   *slots;
+   cosim_port_t    in;
+   cosim_port_t    out;
+   uint64_t        quantum;
+   size_t          ring_size;
+   cosim_slot_t   *new_slots;
+   unsigned        new_count;
+   uint64_t        last_sync;
+   bool            ended;
+};
+
+static size_t cosim_align(size_t size)
+{
+   return (size + COSIM_LINE - 1) & ~(size_t)(COSIM_LINE - 1);
+}
+
+static size_t cosim_rec_size(unsigned count)
+{
+   return sizeof(cosim_rec_t) + count * sizeof(uint64_t);
+}
+
+static size_t cosim_layout(unsigned nsignals, size_t ring_size)
+{
+   return cosim_align(sizeof(cosim_header_t))
+      + cosim_align(nsignals * sizeof(cosim_slot_t)) + 2 * ring_size;
+}
+
+#ifndef __MINGW32__
+
+static void cosim_pause(cosim_t *c, unsigned *spins)
+{
+   if (++(*spins) < COSIM_SPINS) {
+      sched_yield();
+      return;
+   }
+
+   usleep(50);
+
+   if ((*spins % COSIM_SPINS) == 0) {
+      const pid_t pid = c->model ? c->header->sim_pid : c->header->model_pid;
+      if (pid > 0 && kill(pid, 0) != 0 && errno == ESRCH)
+         fatal("co-simulation %s has exited",
+               c->model ? "simulator" : "model");
+   }
+}
+
+static void cosim_map(cosim_t *c, int fd, unsigned nsignals, size_t ring_size)
+{
+   c->map = mmap(NULL, c->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   if (c->map == MAP_FAILED)
+      fatal_errno("cannot map %s", c->file);
+
+   c->header = (cosim_header_t *)c->map;
+   c->slots  = (cosim_slot_t *)(c->map + cosim_align(sizeof(cosim_header_t)));
+
+   uint8_t *rings = (uint8_t *)c->slots
+      + cosim_align(nsignals * sizeof(cosim_slot_t));
+
+   cosim_port_t to_model = {
+      .ctl  = &(c->header->to_model),
+      .data = rings,
+      .mask = ring_size - 1
+   };
+
+   cosim_port_t to_sim = {
+      .ctl  = &(c->header->to_sim),
+      .data = rings + ring_size,
+      .mask = ring_size - 1
+   };
+
+   c->in  = c->model ? to_model : to_sim;
+   c->out = c->model ? to_sim : to_model;
+}
+
+static void *cosim_reserve(cosim_t *c, cosim_rec_kind_t kind, int signal,
+                           uint64_t when, unsigned count)
+{
+   // Returns a pointer to the values of a new record which becomes
+   // visible to the other side with cosim_commit
+
+   cosim_port_t *p = &(c->out);
+
+   const size_t need = cosim_rec_size(count);
+   const size_t capacity = p->mask + 1;
+   assert(need <= capacity / 2);
+
+   const uint64_t head = p->ctl->head;
+   const size_t rem = capacity - (head & p->mask);
+   const size_t skip = (rem < need) ? rem : 0;
+
+   unsigned spins = 0;
+   while (head + skip + need
+          - __atomic_load_n(&(p->ctl->tail), __ATOMIC_ACQUIRE) > capacity) {
+      if (__atomic_load_n(&(c->header->closed), __ATOMIC_ACQUIRE))
+         return NULL;
+      cosim_pause(c, &spins);
+   }
+
+   if (skip >= sizeof(cosim_rec_t)) {
+      cosim_rec_t *pad = (cosim_rec_t *)(p->data + (head & p->mask));
+      pad->kind = COSIM_R_PAD;
+   }
+
+   cosim_rec_t *r = (cosim_rec_t *)(p->data + ((head + skip) & p->mask));
+   r->kind   = kind;
+   r->signal = signal;
+   r->when   = when;
+   r->count  = count;
+   r->pad    = 0;
+
+   p->pending = skip + need;
+   return r + 1;
+}
+
+static void cosim_commit(cosim_t *c)
+{
+   cosim_port_t *p = &(c->out);
+   __atomic_store_n(&(p->ctl->head), p->ctl->head + p->pending,
+                    __ATOMIC_RELEASE);
+   p->pending = 0;
+}
+
+static void cosim_put(cosim_t *c, cosim_rec_kind_t kind, int signal,
+                      uint64_t when, const uint64_t *values, unsigned count)
+{
+   void *data = cosim_reserve(c, kind, signal, when, count);
+   if (data != NULL) {
+      if (count > 0)
+         memcpy(data, values, count * sizeof(uint64_t));
+      cosim_commit(c);
+   }
+}
+
+static const cosim_rec_t *cosim_peek(cosim_t *c)
+{
+   // Returns the next record without removing it or NULL if the ring
+   // is empty
+
+   cosim_port_t *p = &(c->in);
+   const size_t capacity = p->mask + 1;
+
+   for (;;) {
+      const uint64_t tail = p->ctl->tail;
+      if (tail == __atomic_load_n(&(p->ctl->head), __ATOMIC_ACQUIRE))
+         return NULL;
+
+      const size_t rem = capacity - (tail & p->mask);
+      const cosim_rec_t *r = (cosim_rec_t *)(p->data + (tail & p->mask));
+      if (rem < sizeof(cosim_rec_t) || r->kind == COSIM_R_PAD)
+         __atomic_store_n(&(p->ctl->tail), tail + rem, __ATOMIC_RELEASE);
+      else
+         return r;
+   }
+}
+
+static void cosim_take(cosim_t *c, const cosim_rec_t *r)
+{
+   // The record is removed by the next call to cosim_consume so its
+   // values can be used in place until then
+   c->in.pending = cosim_rec_size(r->count);
+}
+
+static void cosim_consume(cosim_t *c)
+{
+   cosim_port_t *p = &(c->in);
+   if (p->pending > 0) {
+      __atomic_store_n(&(p->ctl->tail), p->ctl->tail + p->pending,
+                       __ATOMIC_RELEASE);
+      p->pending = 0;
+   }
+}
+
+#endif  // __MINGW32__
+
+cosim_t *cosim_create(const char *file, uint64_t quantum, size_t ring_size)
+{
+   if (quantum == 0)
+      fatal("co-simulation quantum must be greater than zero");
+
+   if (ring_size == 0)
+      ring_size = COSIM_DEF_RING;
+   else if (ring_size < COSIM_MIN_RING)
+      ring_size = COSIM_MIN_RING;
+   else if (ring_size > INT32_MAX / 2 + 1)
+      fatal("co-simulation ring size %zu is too large", ring_size);
+   else
+      ring_size = next_power_of_2(ring_size);
+
+   cosim_t *c = xcalloc(sizeof(cosim_t));
+   c->file      = xstrdup(file);
+   c->model     = true;
+   c->quantum   = quantum;
+   c->ring_size = ring_size;
+   return c;
+}
+
+int cosim_add(cosim_t *c, const char *name, cosim_mode_t mode)
+{
+   assert(c->model && c->map == NULL);
+
+   if (strlen(name) >= COSIM_MAX_NAME)
+      fatal("co-simulation signal name %s is too long", name);
+
+   c->new_slots = xrealloc(c->new_slots,
+                           (c->new_count + 1) * sizeof(cosim_slot_t));
+
+   cosim_slot_t *s = &(c->new_slots[c->new_count]);
+   memset(s, '\0', sizeof(cosim_slot_t));
+   strcpy(s->name, name);
+   s->mode = mode;
+
+   return c->new_count++;
+}
+
+void cosim_start(cosim_t *c)
+{
+#ifndef __MINGW32__
+   assert(c->model && c->map == NULL);
+
+   const int fd = open(c->file, O_RDWR | O_CREAT | O_TRUNC, 0600);
+   if (fd < 0)
+      fatal_errno("cannot create %s", c->file);
+
+   c->size = cosim_layout(c->new_count, c->ring_size);
+   if (ftruncate(fd, c->size) != 0)
+      fatal_errno("cannot resize %s", c->file);
+
+   cosim_map(c, fd, c->new_count, c->ring_size);
+   close(fd);
+
+   memcpy(c->slots, c->new_slots, c->new_count * sizeof(cosim_slot_t));
+
+   cosim_header_t *h = c->header;
+   h->version   = COSIM_VERSION;
+   h->quantum   = c->quantum;
+   h->nsignals  = c->new_count;
+   h->ring_size = c->ring_size;
+   h->model_pid = getpid();
+
+   __atomic_store_n(&(h->magic), COSIM_MAGIC, __ATOMIC_RELEASE);
+
+   // The simulator may take a long time to elaborate so there is no
+   // limit on how long to wait here
+   while (!__atomic_load_n(&(h->attached), __ATOMIC_ACQUIRE))
+      usleep(10000);
+
+   free(c->new_slots);
+   c->new_slots = NULL;
+#else
+   fatal("co-simulation is not supported on this platform");
+#endif
+}
+
+unsigned cosim_count(cosim_t *c, int signal)
+{
+   assert(signal >= 0 && signal < c->header->nsignals);
+   return c->slots[signal].count;
+}
+
+bool cosim_next(cosim_t *c, cosim_event_t *ev)
+{
+#ifndef __MINGW32__
+   assert(c->model);
+
+   if (c->ended)
+      return false;
+
+   cosim_consume(c);
+
+   const cosim_rec_t *r;
+   unsigned spins = 0;
+   while ((r = cosim_peek(c)) == NULL)
+      cosim_pause(c, &spins);
+
+   cosim_take(c, r);
+
+   switch (r->kind) {
+   case COSIM_R_CHANGE:
+      ev->kind   = COSIM_CHANGE;
+      ev->signal = r->signal;
+      ev->when   = r->when;
+      ev->values = (const uint64_t *)(r + 1);
+      ev->count  = r->count;
+      return true;
+
+   case COSIM_R_SYNC:
+      c->last_sync = r->when;
+      ev->kind   = COSIM_SYNC;
+      ev->signal = -1;
+      ev->when   = r->when;
+      ev->values = NULL;
+      ev->count  = 0;
+      return true;
+
+   case COSIM_R_END:
+      cosim_consume(c);
+      c->ended = true;
+      return false;
+
+   default:
+      fatal("corrupt record in co-simulation channel %s", c->file);
+   }
+#else
+   return false;
+#endif
+}
+
+void cosim_drive(cosim_t *c, int signal, const uint64_t *values)
+{
+#ifndef __MINGW32__
+   assert(c->model);
+   assert(signal >= 0 && signal < c->header->nsignals);
+
+   const cosim_slot_t *s = &(c->slots[signal]);
+   if (s->mode != COSIM_DRIVE)
+      fatal("co-simulation signal %s was not added for driving", s->name);
+
+   cosim_put(c, COSIM_R_DRIVE, signal, c->last_sync, values, s->count);
+#endif
+}
+
+void cosim_ack(cosim_t *c, uint64_t when)
+{
+   assert(c->model);
+   __atomic_store_n(&(c->header->horizon), when + 1, __ATOMIC_RELEASE);
+}
+
+void cosim_close(cosim_t *c)
+{
+#ifndef __MINGW32__
+   if (c->map != NULL) {
+      __atomic_store_n(&(c->header->closed), 1, __ATOMIC_RELEASE);
+      munmap(c->map, c->size);
+
+      if (c->model)
+         unlink(c->file);
+   }
+#endif
+
+   free(c->new_slots);
+   free(c->file);
+   free(c);
+}
+
+cosim_t *cosim_attach(const char *file)
+{
+#ifndef __MINGW32__
+   // The model may not have created the channel yet
+
+   int fd = -1;
+   for (int retry = 0; ; retry++) {
+      if (fd == -1)
+         fd = open(file, O_RDWR);
+
+      if (fd != -1) {
+         uint32_t magic = 0;
+         if (pread(fd, &magic, sizeof(magic), 0) == sizeof(magic)
+             && magic == COSIM_MAGIC)
+            break;
+      }
+
+      if (retry == COSIM_RETRIES) {
+         if (fd == -1)
+            fatal_errno("cannot open co-simulation channel %s", file);
+         else
+            fatal("%s is not a co-simulation channel", file);
+      }
+
+      usleep(100000);
+   }
+
+   cosim_header_t h;
+   if (pread(fd, &h, sizeof(h), 0) != sizeof(h))
+      fatal_errno("cannot read %s", file);
+
+   if (h.version != COSIM_VERSION)
+      fatal("%s was created for co-simulation channel version %u",
+            file, h.version);
+   else if (h.model_pid > 0 && kill(h.model_pid, 0) != 0 && errno == ESRCH)
+      fatal("the model that created %s is no longer running", file);
+   else if (h.attached)
+      fatal("another simulation is already attached to %s", file);
+
+   cosim_t *c = xcalloc(sizeof(cosim_t));
+   c->file      = xstrdup(file);
+   c->model     = false;
+   c->size      = cosim_layout(h.nsignals, h.ring_size);
+   c->quantum   = h.quantum;
+   c->ring_size = h.ring_size;
+
+   cosim_map(c, fd, h.nsignals, h.ring_size);
+   close(fd);
+
+   return c;
+#else
+   fatal("co-simulation is not supported on this platform");
+#endif
+}
+
+void cosim_detach(cosim_t *c)
+{
+   assert(!c->model);
+
+#ifndef __MINGW32__
+   munmap(c->map, c->size);
+#endif
+
+   free(c->file);
+   free(c);
+}
+
+int cosim_signals(cosim_t *c)
+{
+   return c->header->nsignals;
+}
+
+uint64_t cosim_quantum(cosim_t *c)
+{
+   return c->quantum;
+}
+
+const char *cosim_name(cosim_t *c, int signal)
+{
+   assert(signal >= 0 && signal < c->header->nsignals);
+   return c->slots[signal].name;
+}
+
+cosim_mode_t cosim_mode(cosim_t *c, int signal)
+{
+   assert(signal >= 0 && signal < c->header->nsignals);
+   return c->slots[signal].mode;
+}
+
+void cosim_set_count(cosim_t *c, int signal, unsigned count)
+{
+   assert(!c->model);
+   assert(signal >= 0 && signal < c->header->nsignals);
+
+   if (cosim_rec_size(count) > c->ring_size / 2)
+      fatal("signal %s is too large for co-simulation channel %s",
+            c->slots[signal].name, c->file);
+
+   c->slots[signal].count = count;
+}
+
+void cosim_ready(cosim_t *c)
+{
+#ifndef __MINGW32__
+   assert(!c->model);
+
+   c->header->sim_pid = getpid();
+   __atomic_store_n(&(c->header->attached), 1, __ATOMIC_RELEASE);
+#endif
+}
+
+void cosim_put_change(cosim_t *c, int signal, uint64_t when,
+                      const uint64_t *values)
+{
+#ifndef __MINGW32__
+   assert(!c->model);
+   cosim_put(c, COSIM_R_CHANGE, signal, when, values,
+             c->slots[signal].count);
+#endif
+}
+
+void cosim_put_sync(cosim_t *c, uint64_t when)
+{
+#ifndef __MINGW32__
+   assert(!c->model);
+   cosim_put(c, COSIM_R_SYNC, -1, when, NULL, 0);
+#endif
+}
+
+void cosim_put_end(cosim_t *c)
+{
+#ifndef __MINGW32__
+   assert(!c->model);
+   cosim_put(c, COSIM_R_END, -1, 0, NULL, 0);
+#endif
+}
+
+bool cosim_wait_ack(cosim_t *c, uint64_t when)
+{
+#ifndef __MINGW32__
+   assert(!c->model);
+
+   unsigned spins = 0;
+   while (__atomic_load_n(&(c->header->horizon), __ATOMIC_ACQUIRE) <= when) {
+      if (cosim_closed(c))
+         return false;
+      cosim_pause(c, &spins);
+   }
+#endif
+
+   return true;
+}
+
+bool cosim_get_drive(cosim_t *c, uint64_t upto, int *signal,
+                     const uint64_t **values, unsigned *count)
+{
+#ifndef __MINGW32__
+   assert(!c->model);
+
+   cosim_consume(c);
+
+   const cosim_rec_t *r = cosim_peek(c);
+   if (r == NULL || r->when > upto)
+      return false;
+   else if (r->kind != COSIM_R_DRIVE || r->signal >= c->header->nsignals)
+      fatal("corrupt record in co-simulation channel %s", c->file);
+
+   cosim_take(c, r);
+
+   *signal = r->signal;
+   *values = (const uint64_t *)(r + 1);
+   *count  = r->count;
+   return true;
+#else
+   return false;
+#endif
+}
+
+bool cosim_pending(cosim_t *c)
+{
+#ifndef __MINGW32__
+   cosim_consume(c);
+   return cosim_peek(c) != NULL;
+#else
+   return false;
+#endif
+}
+
+bool cosim_closed(cosim_t *c)
+{
+   return __atomic_load_n(&(c->header->closed), __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,102 @@
+//
+//  Copyright (C) 2018  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _COSIMAPI_H
+#define _COSIMAPI_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// A co-simulation channel connects a foreign model running in its own
+// process to a simulation started with --cosim. The model creates the
+// channel file naming the signals it wants to watch or drive and the
+// time quantum at which the two sides synchronise. The file is mapped
+// by both processes and holds two single-producer single-consumer rings:
+// the simulator publishes every change to a watched signal and a sync
+// marker at each quantum boundary, and the model sends back new values
+// for the signals it drives.
+//
+// Values driven by the model in response to the sync at time T are
+// forced onto the signals at the boundary after T. The simulator only
+// waits for the model at a boundary if it has not yet acknowledged the
+// previous one so the model can process a quantum while the simulator
+// runs the next. Values are passed as an array of uint64_t with one
+// entry per scalar sub-element of the signal.
+
+typedef struct cosim cosim_t;
+
+typedef enum {
+   COSIM_WATCH,
+   COSIM_DRIVE
+} cosim_mode_t;
+
+typedef enum {
+   COSIM_CHANGE,
+   COSIM_SYNC
+} cosim_event_kind_t;
+
+typedef struct {
+   cosim_event_kind_t  kind;
+   int                 signal;
+   uint64_t            when;
+   const uint64_t     *values;
+   unsigned            count;
+} cosim_event_t;
+
+// Model side: signals are named by their full path in the elaborated
+// design such as :top:uut:data
+cosim_t *cosim_create(const char *file, uint64_t quantum, size_t ring_size);
+int cosim_add(cosim_t *c, const char *name, cosim_mode_t mode);
+void cosim_start(cosim_t *c);
+unsigned cosim_count(cosim_t *c, int signal);
+
+// Blocks until the next event and returns false at the end of the
+// simulation. The values are only valid until the next call.
+bool cosim_next(cosim_t *c, cosim_event_t *ev);
+
+// Values are applied in the same order they were sent and must all be
+// sent before acknowledging the sync event they respond to
+void cosim_drive(cosim_t *c, int signal, const uint64_t *values);
+void cosim_ack(cosim_t *c, uint64_t when);
+void cosim_close(cosim_t *c);
+
+// Simulator side
+cosim_t *cosim_attach(const char *file);
+void cosim_detach(cosim_t *c);
+int cosim_signals(cosim_t *c);
+uint64_t cosim_quantum(cosim_t *c);
+const char *cosim_name(cosim_t *c, int signal);
+cosim_mode_t cosim_mode(cosim_t *c, int signal);
+void cosim_set_count(cosim_t *c, int signal, unsigned count);
+void cosim_ready(cosim_t *c);
+void cosim_put_change(cosim_t *c, int signal, uint64_t when,
+                      const uint64_t *values);
+void cosim_put_sync(cosim_t *c, uint64_t when);
+void cosim_put_end(cosim_t *c);
+
+// Returns false if the model closed the channel instead
+bool cosim_wait_ack(cosim_t *c, uint64_t when);
+
+// Returns the next value sent in response to a sync at or before upto
+// without blocking
+bool cosim_get_drive(cosim_t *c, uint64_t upto, int *signal,
+                     const uint64_t **values, unsigned *count);
+bool cosim_pending(cosim_t *c);
+bool cosim_closed(cosim_t *c);
+
+#endif  // _COSIMAPI_H
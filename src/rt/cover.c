@@ -17,11 +17,18 @@
 
 #include "util.h"
 #include "cover.h"
+#include "fbuf.h"
+#include "rt.h"
 
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <sys/stat.h>
+
+#if RT_MULTITHREAD
+#include <pthread.h>
+#endif
 
 #if 0
 #define CSS_DIR "/home/nick/nvc/data/"
@@ -32,6 +39,12 @@
 #define PERCENT_RED    50.0f
 #define PERCENT_ORANGE 90.0f
 
+// Each report directory also has a binary file with the counts for
+// every tag which --cover-merge can add together without the source
+#define COVER_DB_FILE    "coverage.ncdb"
+#define COVER_DB_MAGIC   0x4244434e   // "NCDB"
+#define COVER_DB_VERSION 2
+
 typedef struct cover_hl cover_hl_t;
 typedef struct cover_file cover_file_t;
 
@@ -84,6 +97,34 @@ typedef struct {
    const int32_t *conds;
 } report_ctx_t;
 
+// The header is followed by the name of the elaborated unit and then
+// the statement and condition arrays
+typedef struct {
+   uint64_t hash;
+   uint32_t nstmts;
+   uint32_t nconds;
+   uint32_t runs;
+   char    *name;
+} cover_db_t;
+
+typedef struct {
+   char          **files;
+   int             nfiles;
+   int             next;
+   const char     *first;
+   uint64_t        hash;
+   uint32_t        nstmts;
+   uint32_t        nconds;
+} merge_ctx_t;
+
+typedef struct {
+   merge_ctx_t *ctx;
+   int32_t     *stmts;
+   int32_t     *conds;
+   int32_t     *buf;
+   uint32_t     runs;
+} merge_shard_t;
+
 static ident_t       stmt_tag_i;
 static ident_t       cond_tag_i;
 static ident_t       sub_cond_i;
@@ -91,6 +132,12 @@ static ident_t       builtin_i;
 static ident_t       std_bool_i;
 static cover_file_t *files;
 static cover_stats_t stats;
+static char         *report_dir = NULL;
+static uint32_t      report_runs = 1;
+
+#if RT_MULTITHREAD
+static pthread_mutex_t merge_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
 
 static void cover_tag_conditions(tree_t t, cover_tag_ctx_t *ctx, int branch)
 {
@@ -165,7 +212,7 @@ static void cover_tag_visit_fn(tree_t t, void *context)
    }
 }
 
-void cover_tag(tree_t top)
+void cover_tag(tree_t top, cover_mode_t mode)
 {
    stmt_tag_i = ident_new("stmt_tag");
    cond_tag_i = ident_new("cond_tag");
@@ -182,6 +229,7 @@ void cover_tag(tree_t top)
 
    tree_add_attr_int(top, ident_new("stmt_tags"), ctx.next_stmt_tag);
    tree_add_attr_int(top, ident_new("cond_tags"), ctx.next_cond_tag);
+   tree_add_attr_int(top, ident_new("cover_mode"), mode);
 }
 
 static void cover_append_line(cover_file_t *f, const char *buf)
@@ -536,6 +584,74 @@ static void cover_index(ident_t name, const char *dir)
    fclose(fp);
 }
 
+static void cover_hash_visit_fn(tree_t t, void *context)
+{
+   uint64_t *hash = context;
+
+   if (!cover_is_stmt(t))
+      return;
+
+   const int cond_tag = cover_has_conditions(t)
+      ? tree_attr_int(tree_value(t), cond_tag_i, -1) : -1;
+
+   const loc_t *loc = tree_loc(t);
+   const int32_t data[] = {
+      tree_attr_int(t, stmt_tag_i, -1), cond_tag,
+      loc->first_line, loc->first_column
+   };
+   *hash = hash_bytes(data, sizeof(data), *hash);
+
+   if (loc->file != NULL) {
+      const char *file = istr(loc->file);
+      *hash = hash_bytes(file, strlen(file), *hash);
+   }
+}
+
+static uint64_t cover_design_hash(tree_t top)
+{
+   // Identifies the tagging of the design so counts from runs of a
+   // different elaboration are never added together
+   uint64_t hash = tree_attr_int(top, ident_new("stmt_tags"), 0);
+   tree_visit(top, cover_hash_visit_fn, &hash);
+   return hash;
+}
+
+static void cover_write_db(tree_t top, const char *dir, const int32_t *stmts,
+                           const int32_t *conds)
+{
+   const char *name = istr(tree_ident(top));
+   const size_t namelen = strlen(name);
+   const int nstmts = tree_attr_int(top, ident_new("stmt_tags"), 0);
+   const int nconds = tree_attr_int(top, ident_new("cond_tags"), 0);
+
+   char *buf LOCAL = xasprintf("%s" PATH_SEP COVER_DB_FILE, dir);
+   fbuf_t *f = lib_fbuf_open(lib_work(), buf, FBUF_OUT);
+   if (f == NULL)
+      fatal_errno("failed to create %s", buf);
+
+   write_u32(COVER_DB_MAGIC, f);
+   write_u32(COVER_DB_VERSION, f);
+   write_u64(cover_design_hash(top), f);
+   write_u32(nstmts, f);
+   write_u32(nconds, f);
+   write_u32(report_runs, f);
+   write_u32(namelen, f);
+   write_raw(name, namelen, f);
+
+   for (int i = 0; i < nstmts; i++)
+      write_u32(stmts[i], f);
+   for (int i = 0; i < nconds; i++)
+      write_u32(conds[i], f);
+
+   fbuf_close(f);
+}
+
+void cover_set_report_dir(const char *dir)
+{
+   free(report_dir);
+   report_dir = dir ? xstrdup(dir) : NULL;
+}
+
 void cover_report(tree_t top, const int32_t *stmts, const int32_t *conds)
 {
    stmt_tag_i = ident_new("stmt_tag");
@@ -551,7 +667,8 @@ void cover_report(tree_t top, const int32_t *stmts, const int32_t *conds)
 
    ident_t name = ident_strip(tree_ident(top), ident_new(".elab"));
 
-   char *dir LOCAL = xasprintf("%s.cover", istr(name));
+   char *dir LOCAL = report_dir ? xstrdup(report_dir)
+      : xasprintf("%s.cover", istr(name));
 
    lib_t work = lib_work();
    lib_mkdir(work, dir);
@@ -560,6 +677,7 @@ void cover_report(tree_t top, const int32_t *stmts, const int32_t *conds)
       cover_report_file(f, dir);
 
    cover_index(name, dir);
+   cover_write_db(top, dir, stmts, conds);
 
    char output[PATH_MAX];
    lib_realpath(work, dir, output, sizeof(output));
@@ -575,3 +693,228 @@ void cover_report(tree_t top, const int32_t *stmts, const int32_t *conds)
             stats.hit_conds, stats.total_conds);
    notef("%s", buf);
 }
+
+static void cover_add_counts(int32_t *restrict dst, const int32_t *restrict src,
+                             size_t count)
+{
+   // Written so the compiler can vectorise it: counts saturate rather
+   // than wrap around when many long runs are merged
+   for (size_t i = 0; i < count; i++) {
+      const uint32_t sum = (uint32_t)dst[i] + (uint32_t)src[i];
+      dst[i] = sum > INT32_MAX ? INT32_MAX : sum;
+   }
+}
+
+static void cover_or_masks(int32_t *restrict dst, const int32_t *restrict src,
+                           size_t count)
+{
+   for (size_t i = 0; i < count; i++)
+      dst[i] |= src[i];
+}
+
+static void cover_lock(void)
+{
+   // The list of open files in fbuf is not thread safe
+#if RT_MULTITHREAD
+   pthread_mutex_lock(&merge_lock);
+#endif
+}
+
+static void cover_unlock(void)
+{
+#if RT_MULTITHREAD
+   pthread_mutex_unlock(&merge_lock);
+#endif
+}
+
+static char *cover_db_path(const char *path)
+{
+   // A report directory names the database inside it
+   struct stat st;
+   if (stat(path, &st) == 0 && S_ISDIR(st.st_mode))
+      return xasprintf("%s" PATH_SEP COVER_DB_FILE, path);
+   else
+      return xstrdup(path);
+}
+
+static fbuf_t *cover_open_db(const char *path, cover_db_t *db)
+{
+   struct stat st;
+   if (stat(path, &st) != 0)
+      fatal_errno("cannot open coverage database %s", path);
+   else if (!S_ISREG(st.st_mode) || st.st_size == 0)
+      fatal("%s is not a coverage database", path);
+
+   cover_lock();
+   fbuf_t *f = fbuf_open(path, FBUF_IN);
+   cover_unlock();
+
+   if (f == NULL)
+      fatal_errno("cannot open coverage database %s", path);
+   else if (read_u32(f) != COVER_DB_MAGIC || read_u32(f) != COVER_DB_VERSION)
+      fatal("%s is not a coverage database written by this version of "
+            PACKAGE_NAME, path);
+
+   db->hash   = read_u64(f);
+   db->nstmts = read_u32(f);
+   db->nconds = read_u32(f);
+   db->runs   = read_u32(f);
+
+   const uint32_t namelen = read_u32(f);
+   db->name = xmalloc(namelen + 1);
+   read_raw(db->name, namelen, f);
+   db->name[namelen] = '\0';
+
+   return f;
+}
+
+static void cover_close_db(fbuf_t *f, cover_db_t *db)
+{
+   cover_lock();
+   fbuf_close(f);
+   cover_unlock();
+
+   free(db->name);
+   db->name = NULL;
+}
+
+static void cover_read_counts(fbuf_t *f, int32_t *buf, size_t count)
+{
+   for (size_t i = 0; i < count; i++)
+      buf[i] = read_u32(f);
+}
+
+static void cover_merge_file(merge_shard_t *shard, const char *file)
+{
+   merge_ctx_t *ctx = shard->ctx;
+
+   char *path LOCAL = cover_db_path(file);
+
+   cover_db_t db;
+   fbuf_t *f = cover_open_db(path, &db);
+
+   if (db.hash != ctx->hash || db.nstmts != ctx->nstmts
+       || db.nconds != ctx->nconds)
+      fatal("coverage database %s is for a different design to %s",
+            path, ctx->first);
+
+   cover_read_counts(f, shard->buf, db.nstmts);
+   cover_add_counts(shard->stmts, shard->buf, db.nstmts);
+
+   cover_read_counts(f, shard->buf, db.nconds);
+   cover_or_masks(shard->conds, shard->buf, db.nconds);
+
+   shard->runs += db.runs;
+
+   cover_close_db(f, &db);
+}
+
+static void *cover_merge_thread(void *arg)
+{
+   merge_shard_t *shard = arg;
+   merge_ctx_t *ctx = shard->ctx;
+
+   int next;
+   while ((next = __atomic_fetch_add(&(ctx->next), 1, __ATOMIC_RELAXED))
+          < ctx->nfiles)
+      cover_merge_file(shard, ctx->files[next]);
+
+   return NULL;
+}
+
+void cover_merge(char **files, int nfiles, int jobs)
+{
+   stmt_tag_i = ident_new("stmt_tag");
+   cond_tag_i = ident_new("cond_tag");
+   sub_cond_i = ident_new("sub_cond");
+
+   assert(nfiles > 0);
+
+   // The first database names the elaborated design which must still
+   // be in the work library to find the source of each tag
+
+   char *first LOCAL = cover_db_path(files[0]);
+
+   cover_db_t db;
+   fbuf_t *f = cover_open_db(first, &db);
+
+   ident_t name = ident_new(db.name);
+
+   merge_ctx_t ctx = {
+      .files  = files,
+      .nfiles = nfiles,
+      .first  = first,
+      .hash   = db.hash,
+      .nstmts = db.nstmts,
+      .nconds = db.nconds
+   };
+
+   cover_close_db(f, &db);
+
+   tree_t top = lib_get(lib_work(), name);
+   if (top == NULL)
+      fatal("%s not elaborated", istr(name));
+
+   if (cover_design_hash(top) != ctx.hash)
+      fatal("%s has been elaborated again since %s was written",
+            istr(name), first);
+
+#if RT_MULTITHREAD
+   jobs = MAX(MIN(jobs, nfiles), 1);
+#else
+   jobs = 1;
+#endif
+
+   const size_t bufsz = MAX(MAX(ctx.nstmts, ctx.nconds), 1);
+
+   merge_shard_t *shards = xmalloc(jobs * sizeof(merge_shard_t));
+   for (int i = 0; i < jobs; i++) {
+      shards[i].ctx   = &ctx;
+      shards[i].stmts = xcalloc(MAX(ctx.nstmts, 1) * sizeof(int32_t));
+      shards[i].conds = xcalloc(MAX(ctx.nconds, 1) * sizeof(int32_t));
+      shards[i].buf   = xmalloc(bufsz * sizeof(int32_t));
+      shards[i].runs  = 0;
+   }
+
+#if RT_MULTITHREAD
+   pthread_t *threads = xmalloc(jobs * sizeof(pthread_t));
+   for (int i = 1; i < jobs; i++) {
+      if (pthread_create(&threads[i], NULL, cover_merge_thread, &shards[i]))
+         fatal_errno("pthread_create");
+   }
+
+   cover_merge_thread(&shards[0]);
+
+   for (int i = 1; i < jobs; i++) {
+      if (pthread_join(threads[i], NULL))
+         fatal_errno("pthread_join");
+   }
+   free(threads);
+#else
+   cover_merge_thread(&shards[0]);
+#endif
+
+   for (int i = 1; i < jobs; i++) {
+      cover_add_counts(shards[0].stmts, shards[i].stmts, ctx.nstmts);
+      cover_or_masks(shards[0].conds, shards[i].conds, ctx.nconds);
+      shards[0].runs += shards[i].runs;
+   }
+
+   notef("merged coverage from %u runs of %s", shards[0].runs, istr(name));
+
+   // Do not overwrite the report from a single run by default
+   if (report_dir == NULL) {
+      ident_t base = ident_strip(tree_ident(top), ident_new(".elab"));
+      report_dir = xasprintf("%s.merged.cover", istr(base));
+   }
+
+   report_runs = shards[0].runs;
+   cover_report(top, shards[0].stmts, shards[0].conds);
+
+   for (int i = 0; i < jobs; i++) {
+      free(shards[i].stmts);
+      free(shards[i].conds);
+      free(shards[i].buf);
+   }
+   free(shards);
+}
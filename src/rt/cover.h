@@ -21,7 +21,18 @@
 #include "util.h"
 #include "tree.h"
 
-void cover_tag(tree_t top);
+typedef enum {
+   COVER_NONE,
+   COVER_COUNT,   // 32-bit execution counts
+   COVER_HIT      // One byte set when a statement or condition is hit
+} cover_mode_t;
+
+// Bytes for each condition tag with COVER_HIT: two for each sub-condition
+#define COVER_HIT_BYTES 32
+
+void cover_tag(tree_t top, cover_mode_t mode);
 void cover_report(tree_t top, const int32_t *stmts, const int32_t *conds);
+void cover_set_report_dir(const char *dir);
+void cover_merge(char **files, int nfiles, int jobs);
 
 #endif  // _COVER_H
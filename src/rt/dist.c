@@ -0,0 +1,576 @@
+//
+//  Copyright (C) 2018  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "util.h"
+#include "rt.h"
+#include "tree.h"
+#include "common.h"
+#include "globset.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+
+#ifndef __MINGW32__
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+
+// Each node runs the same elaborated design but only executes the
+// processes assigned to it by the partition file. Node zero accepts a
+// TCP connection from every other node and before each simulation cycle
+// collects the next event time of every node and the values of any
+// signals they changed in the last cycle. It then sends back the global
+// decision, which is a delta cycle if any node has one pending or
+// changed a signal and otherwise the earliest next event time, along
+// with the changes from all the other nodes. Each node applies remote
+// changes by forcing the signal in the following delta cycle so the
+// nodes advance in lockstep and never run ahead of each other.
+//
+// A process therefore sees a change made on another node one delta
+// cycle later than a change made by a process on the same node. Designs
+// where this matters, such as a clock generated on one node and a delta
+// delayed copy of it compared on another, must keep those processes on
+// the same node.
+//
+// All integers on the wire are big-endian and each change is sent as
+// the group number, the size of one element and the number of elements
+// followed by the values with each element also big-endian so nodes
+// with a different byte order can take part in the same simulation.
+
+#define DIST_MAGIC   0x4e564344   // "NVCD"
+#define DIST_RETRIES 100
+
+#define DIST_F_DELTA (1 << 0)
+#define DIST_F_STOP  (1 << 1)
+
+#define DIST_HELLO_SIZE  16
+#define DIST_HEADER_SIZE 16
+#define DIST_CHANGE_SIZE 12
+
+typedef struct {
+   uint32_t magic;
+   uint32_t node;
+   uint32_t nnodes;
+   uint32_t nnets;
+} dist_hello_t;
+
+typedef struct {
+   uint64_t when;
+   uint32_t flags;
+   uint32_t nbytes;
+} dist_header_t;
+
+typedef struct {
+   uint8_t *buf;
+   size_t   len;
+   size_t   alloc;
+} dist_buf_t;
+
+typedef struct {
+   int           fd;
+   dist_header_t header;
+   dist_buf_t    in;
+} dist_peer_t;
+
+static int          this_node = -1;
+static int          n_nodes = 0;
+static glob_set_t  *rules = NULL;
+static int         *rule_nodes = NULL;
+static dist_peer_t *peers = NULL;
+static dist_buf_t   out;
+static dist_buf_t   values;
+
+static void dist_put_u32(uint8_t *p, uint32_t u)
+{
+   p[0] = u >> 24;
+   p[1] = u >> 16;
+   p[2] = u >> 8;
+   p[3] = u;
+}
+
+static void dist_swap_values(uint8_t *p, uint32_t size, uint32_t count)
+{
+   // Converts between host and network byte order in both directions
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+   if (size == 1)
+      return;
+
+   for (uint32_t i = 0; i < count; i++, p += size) {
+      for (uint32_t lo = 0, hi = size - 1; lo < hi; lo++, hi--) {
+         const uint8_t tmp = p[lo];
+         p[lo] = p[hi];
+         p[hi] = tmp;
+      }
+   }
+#endif
+}
+
+static void dist_buf_reserve(dist_buf_t *b, size_t len)
+{
+   if (b->len + len > b->alloc) {
+      b->alloc = MAX(b->alloc * 2, b->len + len);
+      b->alloc = MAX(b->alloc, 1024);
+      b->buf = xrealloc(b->buf, b->alloc);
+   }
+}
+
+static void dist_read_partition(const char *fname)
+{
+   // Each line gives a node number and a glob matched against the names
+   // of the processes it should run
+
+   FILE *f = fopen(fname, "r");
+   if (f == NULL)
+      fatal_errno("cannot open %s", fname);
+
+   int lineno = 0;
+   char line[1024];
+   while (!feof(f) && (lineno++, fgets(line, sizeof(line), f) != NULL)) {
+      // Erase comments
+      bool comment = false;
+      for (char *p = line; *p != '\0'; p++) {
+         if (*p == '#')
+            comment = true;
+         if (comment || (*p == '\r') || (*p == '\n'))
+            *p = '\0';
+      }
+
+      int node;
+      char glob[1024];
+      const int n = sscanf(line, " %d %1023s ", &node, glob);
+      if (n == EOF)
+         continue;
+      else if (n != 2 || node < 0)
+         fatal("%s:%d: expected node number followed by a process name",
+               fname, lineno);
+
+      if (rules == NULL)
+         rules = glob_set_new();
+
+      const int index = glob_set_add(rules, glob);
+      rule_nodes = xrealloc(rule_nodes, (index + 1) * sizeof(int));
+      rule_nodes[index] = node;
+
+      n_nodes = MAX(n_nodes, node + 1);
+   }
+
+   fclose(f);
+
+   if (n_nodes < 2)
+      fatal("%s: partition must name at least two nodes", fname);
+}
+
+#ifndef __MINGW32__
+
+static void dist_write_all(int fd, const void *data, size_t len)
+{
+   const uint8_t *p = data;
+   while (len > 0) {
+      const ssize_t n = write(fd, p, len);
+      if (n < 0 && errno == EINTR)
+         continue;
+      else if (n <= 0)
+         fatal_errno("lost connection to simulation node");
+
+      p += n;
+      len -= n;
+   }
+}
+
+static void dist_read_all(int fd, void *data, size_t len)
+{
+   uint8_t *p = data;
+   while (len > 0) {
+      const ssize_t n = read(fd, p, len);
+      if (n < 0 && errno == EINTR)
+         continue;
+      else if (n < 0)
+         fatal_errno("lost connection to simulation node");
+      else if (n == 0)
+         fatal("lost connection to simulation node");
+
+      p += n;
+      len -= n;
+   }
+}
+
+static void dist_put_u64(uint8_t *p, uint64_t u)
+{
+   dist_put_u32(p, u >> 32);
+   dist_put_u32(p + 4, u);
+}
+
+static uint32_t dist_get_u32(const uint8_t *p)
+{
+   return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16)
+      | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint64_t dist_get_u64(const uint8_t *p)
+{
+   return ((uint64_t)dist_get_u32(p) << 32) | dist_get_u32(p + 4);
+}
+
+static void dist_write_hello(int fd, const dist_hello_t *hello)
+{
+   uint8_t buf[DIST_HELLO_SIZE];
+   dist_put_u32(buf, hello->magic);
+   dist_put_u32(buf + 4, hello->node);
+   dist_put_u32(buf + 8, hello->nnodes);
+   dist_put_u32(buf + 12, hello->nnets);
+   dist_write_all(fd, buf, sizeof(buf));
+}
+
+static void dist_read_hello(int fd, dist_hello_t *hello)
+{
+   uint8_t buf[DIST_HELLO_SIZE];
+   dist_read_all(fd, buf, sizeof(buf));
+   hello->magic  = dist_get_u32(buf);
+   hello->node   = dist_get_u32(buf + 4);
+   hello->nnodes = dist_get_u32(buf + 8);
+   hello->nnets  = dist_get_u32(buf + 12);
+}
+
+static void dist_write_header(int fd, const dist_header_t *header)
+{
+   uint8_t buf[DIST_HEADER_SIZE];
+   dist_put_u64(buf, header->when);
+   dist_put_u32(buf + 8, header->flags);
+   dist_put_u32(buf + 12, header->nbytes);
+   dist_write_all(fd, buf, sizeof(buf));
+}
+
+static void dist_read_header(int fd, dist_header_t *header)
+{
+   uint8_t buf[DIST_HEADER_SIZE];
+   dist_read_all(fd, buf, sizeof(buf));
+   header->when   = dist_get_u64(buf);
+   header->flags  = dist_get_u32(buf + 8);
+   header->nbytes = dist_get_u32(buf + 12);
+}
+
+static struct addrinfo *dist_resolve(const char *address, bool server)
+{
+   char *host LOCAL = xstrdup(address);
+   char *port = strrchr(host, ':');
+   if (port == NULL)
+      fatal("expected HOST:PORT but have %s", address);
+   *port++ = '\0';
+
+   struct addrinfo hints;
+   memset(&hints, '\0', sizeof(hints));
+   hints.ai_family   = AF_UNSPEC;
+   hints.ai_socktype = SOCK_STREAM;
+   hints.ai_flags    = server ? AI_PASSIVE : 0;
+
+   struct addrinfo *result;
+   const int rc = getaddrinfo(*host == '\0' ? NULL : host, port,
+                              &hints, &result);
+   if (rc != 0)
+      fatal("cannot resolve %s: %s", address, gai_strerror(rc));
+
+   return result;
+}
+
+static void dist_nodelay(int fd)
+{
+   // Messages are small and each one waits for a reply
+   const int one = 1;
+   setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+static void dist_accept(const char *address, int nnets)
+{
+   struct addrinfo *ai = dist_resolve(address, true);
+
+   const int sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+   if (sock < 0)
+      fatal_errno("socket");
+
+   const int one = 1;
+   setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+   if (bind(sock, ai->ai_addr, ai->ai_addrlen) != 0)
+      fatal_errno("cannot bind to %s", address);
+
+   freeaddrinfo(ai);
+
+   if (listen(sock, n_nodes) != 0)
+      fatal_errno("listen");
+
+   for (int i = 1; i < n_nodes; i++) {
+      const int fd = accept(sock, NULL, NULL);
+      if (fd < 0)
+         fatal_errno("accept");
+
+      dist_hello_t hello;
+      dist_read_hello(fd, &hello);
+
+      if (hello.magic != DIST_MAGIC)
+         fatal("unexpected connection to %s", address);
+      else if (hello.nnodes != n_nodes)
+         fatal("node %u expects %u nodes but partition has %d",
+               hello.node, hello.nnodes, n_nodes);
+      else if (hello.node == 0 || hello.node >= n_nodes)
+         fatal("invalid node number %u", hello.node);
+      else if (peers[hello.node].fd != -1)
+         fatal("node %u connected more than once", hello.node);
+      else if (hello.nnets != nnets)
+         fatal("node %u was elaborated from a different design", hello.node);
+
+      dist_nodelay(fd);
+      peers[hello.node].fd = fd;
+   }
+
+   close(sock);
+}
+
+static void dist_connect(const char *address, int nnets)
+{
+   // Node zero may not have started listening yet
+
+   int fd = -1;
+   for (int retry = 0; fd == -1; retry++) {
+      struct addrinfo *ai = dist_resolve(address, false);
+
+      fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+      if (fd < 0)
+         fatal_errno("socket");
+
+      if (connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+         if (retry == DIST_RETRIES)
+            fatal_errno("cannot connect to %s", address);
+
+         close(fd);
+         fd = -1;
+         usleep(100000);
+      }
+
+      freeaddrinfo(ai);
+   }
+
+   dist_nodelay(fd);
+
+   const dist_hello_t hello = {
+      .magic  = DIST_MAGIC,
+      .node   = this_node,
+      .nnodes = n_nodes,
+      .nnets  = nnets
+   };
+   dist_write_hello(fd, &hello);
+
+   peers[0].fd = fd;
+}
+
+static void dist_read_message(dist_peer_t *p)
+{
+   dist_read_header(p->fd, &(p->header));
+
+   p->in.len = 0;
+   dist_buf_reserve(&(p->in), p->header.nbytes);
+   dist_read_all(p->fd, p->in.buf, p->header.nbytes);
+   p->in.len = p->header.nbytes;
+}
+
+static void dist_apply(const dist_buf_t *b, dist_apply_fn_t fn)
+{
+   // The message may still be forwarded to other nodes so the values
+   // are converted to host byte order in a separate buffer
+   size_t pos = 0;
+   while (pos + DIST_CHANGE_SIZE <= b->len) {
+      const uint32_t gid   = dist_get_u32(b->buf + pos);
+      const uint32_t size  = dist_get_u32(b->buf + pos + 4);
+      const uint32_t count = dist_get_u32(b->buf + pos + 8);
+      pos += DIST_CHANGE_SIZE;
+
+      const size_t len = (size_t)size * count;
+      if (pos + len > b->len)
+         fatal("truncated message from simulation node");
+
+      values.len = 0;
+      dist_buf_reserve(&values, len);
+      memcpy(values.buf, b->buf + pos, len);
+      dist_swap_values(values.buf, size, count);
+
+      (*fn)(gid, values.buf, len);
+      pos += len;
+   }
+
+   if (pos != b->len)
+      fatal("truncated message from simulation node");
+}
+
+#endif  // __MINGW32__
+
+void dist_init(tree_t top, const char *partition, int node,
+               const char *address)
+{
+#ifndef __MINGW32__
+   dist_read_partition(partition);
+
+   if (node < 0 || node >= n_nodes)
+      fatal("node %d is not named in %s", node, partition);
+
+   this_node = node;
+
+   peers = xmalloc(n_nodes * sizeof(dist_peer_t));
+   for (int i = 0; i < n_nodes; i++) {
+      peers[i].fd     = -1;
+      peers[i].in.buf = NULL;
+      peers[i].in.len = peers[i].in.alloc = 0;
+   }
+
+   const int nnets = tree_attr_int(top, nnets_i, 0);
+
+   if (this_node == 0)
+      dist_accept(address, nnets);
+   else
+      dist_connect(address, nnets);
+
+   notef("node %d of %d connected", this_node, n_nodes);
+#else
+   fatal("distributed simulation is not supported on this platform");
+#endif
+}
+
+bool dist_enabled(void)
+{
+   return this_node >= 0;
+}
+
+bool dist_owns(ident_t name)
+{
+   // Processes not matched by any rule run on node zero
+
+   const int index = (rules == NULL) ? -1 : glob_set_first(rules, name);
+   if (index >= 0)
+      return rule_nodes[index] == this_node;
+
+   return this_node == 0;
+}
+
+void dist_add_change(uint32_t gid, const void *data, uint32_t size,
+                     uint32_t count)
+{
+   const size_t len = (size_t)size * count;
+   dist_buf_reserve(&out, DIST_CHANGE_SIZE + len);
+
+   uint8_t *p = out.buf + out.len;
+   dist_put_u32(p, gid);
+   dist_put_u32(p + 4, size);
+   dist_put_u32(p + 8, count);
+   memcpy(p + DIST_CHANGE_SIZE, data, len);
+   dist_swap_values(p + DIST_CHANGE_SIZE, size, count);
+
+   out.len += DIST_CHANGE_SIZE + len;
+}
+
+dist_status_t dist_sync(dist_status_t local, dist_apply_fn_t fn)
+{
+#ifndef __MINGW32__
+   dist_header_t header = {
+      .when   = local.when,
+      .flags  = (local.delta ? DIST_F_DELTA : 0)
+                | (local.stop ? DIST_F_STOP : 0),
+      .nbytes = out.len
+   };
+
+   if (this_node == 0) {
+      size_t total = out.len;
+      for (int i = 1; i < n_nodes; i++) {
+         dist_read_message(&(peers[i]));
+         header.when = MIN(header.when, peers[i].header.when);
+         header.flags |= peers[i].header.flags;
+         total += peers[i].in.len;
+      }
+
+      if (total > 0)
+         header.flags |= DIST_F_DELTA;
+
+      for (int i = 1; i < n_nodes; i++) {
+         dist_header_t reply = header;
+         reply.nbytes = total - peers[i].in.len;
+         dist_write_header(peers[i].fd, &reply);
+
+         dist_write_all(peers[i].fd, out.buf, out.len);
+         for (int j = 1; j < n_nodes; j++) {
+            if (j != i)
+               dist_write_all(peers[i].fd, peers[j].in.buf, peers[j].in.len);
+         }
+      }
+
+      for (int i = 1; i < n_nodes; i++)
+         dist_apply(&(peers[i].in), fn);
+   }
+   else {
+      dist_write_header(peers[0].fd, &header);
+      dist_write_all(peers[0].fd, out.buf, out.len);
+
+      dist_read_message(&(peers[0]));
+      header = peers[0].header;
+      dist_apply(&(peers[0].in), fn);
+   }
+
+   out.len = 0;
+
+   const dist_status_t global = {
+      .when  = header.when,
+      .delta = !!(header.flags & DIST_F_DELTA),
+      .stop  = !!(header.flags & DIST_F_STOP)
+   };
+   return global;
+#else
+   return local;
+#endif
+}
+
+void dist_shutdown(void)
+{
+   if (this_node < 0)
+      return;
+
+#ifndef __MINGW32__
+   for (int i = 0; i < n_nodes; i++) {
+      if (peers[i].fd != -1)
+         close(peers[i].fd);
+      free(peers[i].in.buf);
+   }
+#endif
+
+   if (rules != NULL)
+      glob_set_free(rules);
+
+   free(rule_nodes);
+   free(peers);
+   free(out.buf);
+   free(values.buf);
+
+   rules      = NULL;
+   rule_nodes = NULL;
+   peers      = NULL;
+   n_nodes    = 0;
+   this_node  = -1;
+
+   memset(&out, '\0', sizeof(out));
+   memset(&values, '\0', sizeof(values));
+}
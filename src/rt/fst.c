@@ -48,12 +48,14 @@ struct fst_data {
    fst_type_t    type;
    size_t        size;
    watch_t      *watch;
+   fstHandle    *slices;
 };
 
 static void fst_close(void)
 {
    fstWriterEmitTimeChange(fst_ctx, rt_now(NULL));
    fstWriterClose(fst_ctx);
+   fst_ctx = NULL;
 }
 
 static void fst_fmt_int(tree_t decl, watch_t *w, fst_data_t *data)
@@ -98,6 +100,23 @@ static void fst_fmt_chars(tree_t decl, watch_t *w, fst_data_t *data)
          fst_ctx, data->handle, buf, data->size);
 }
 
+static void fst_fmt_slices(tree_t decl, watch_t *w, fst_data_t *data)
+{
+   // Only the parts of the signal that changed are formatted unless this
+   // is the initial dump when there are no changes recorded
+
+   const int *changed;
+   const int nchanged = rt_watch_changes(w, &changed);
+   const int nslices = nchanged > 0 ? nchanged : rt_watch_groups(w);
+
+   char buf[data->size + 1];
+   for (int i = 0; i < nslices; i++) {
+      const int group = nchanged > 0 ? changed[i] : i;
+      rt_watch_group_string(w, group, data->type.map, buf, data->size + 1);
+      fstWriterEmitValueChange(fst_ctx, data->slices[group], buf);
+   }
+}
+
 static void fst_fmt_enum(tree_t decl, watch_t *w, fst_data_t *data)
 {
    uint64_t val;
@@ -292,20 +311,50 @@ static void fst_process_signal(tree_t d)
    if (type_is_array(type))
       snprintf(name + base_len, 64, "[%d:%d]\n", msb, lsb);
 
-   data->handle = fstWriterCreateVar2(
-      fst_ctx,
-      vt,
-      dir,
-      data->size,
-      name,
-      0,
-      type_pp(type),
-      FST_SVT_VHDL_SIGNAL,
-      sdt);
+   data->watch = rt_set_wave_cb(d, fst_event_cb, data);
+
+   const int ngroups = rt_watch_groups(data->watch);
+   if (type_is_array(type) && data->type.map != NULL && ngroups > 1) {
+      // A vector driven in parts has a variable for each part so a
+      // change to one part does not reformat the whole signal
+      data->fmt    = fst_fmt_slices;
+      data->slices = xmalloc(ngroups * sizeof(fstHandle));
+
+      const int step = (data->dir == RANGE_DOWNTO) ? -1 : 1;
+
+      for (int i = 0; i < ngroups; i++) {
+         int first, length;
+         rt_watch_group_range(data->watch, i, &first, &length);
+
+         const int left = msb + step * first;
+         const int right = left + step * (length - 1);
+         snprintf(name + base_len, 64, "[%d:%d]", left, right);
+
+         data->slices[i] = fstWriterCreateVar2(
+            fst_ctx,
+            vt,
+            dir,
+            length,
+            name,
+            0,
+            type_pp(type),
+            FST_SVT_VHDL_SIGNAL,
+            sdt);
+      }
+   }
+   else
+      data->handle = fstWriterCreateVar2(
+         fst_ctx,
+         vt,
+         dir,
+         data->size,
+         name,
+         0,
+         type_pp(type),
+         FST_SVT_VHDL_SIGNAL,
+         sdt);
 
    tree_add_attr_ptr(d, fst_data_i, data);
-
-   data->watch = rt_set_event_cb(d, fst_event_cb, data, true);
 }
 
 static void fst_process_hier(tree_t h)
@@ -365,11 +414,19 @@ void fst_restart(void)
       if (tree_kind(d) == T_SIGNAL_DECL) {
          fst_data_t *data = tree_attr_ptr(d, fst_data_i);
          if (likely(data != NULL))
-            fst_event_cb(0, d, data->watch, data);
+            fst_event_cb(rt_now(NULL), d, data->watch, data);
       }
    }
 }
 
+void fst_flush_stats(uint64_t *count, uint64_t *usec)
+{
+   *count = *usec = 0;
+
+   if (fst_ctx != NULL)
+      fstWriterGetFlushStats(fst_ctx, count, usec);
+}
+
 void fst_init(const char *file, tree_t top)
 {
    if ((fst_ctx = fstWriterCreate(file, 1)) == NULL)
@@ -378,9 +435,32 @@ void fst_init(const char *file, tree_t top)
    fstWriterSetFileType(fst_ctx, FST_FT_VHDL);
    fstWriterSetTimescale(fst_ctx, -15);
    fstWriterSetVersion(fst_ctx, PACKAGE_STRING);
-   fstWriterSetPackType(fst_ctx, 0);
    fstWriterSetRepackOnClose(fst_ctx, 1);
+
+   switch (opt_get_int("fst-pack")) {
+   case FST_PACK_FASTLZ:
+      fstWriterSetPackType(fst_ctx, FST_WR_PT_FASTLZ);
+      break;
+   case FST_PACK_LZ4:
+      fstWriterSetPackType(fst_ctx, FST_WR_PT_LZ4);
+      break;
+   default:
+      fstWriterSetPackType(fst_ctx, FST_WR_PT_ZLIB);
+      fstWriterSetCompressionLevel(fst_ctx, opt_get_int("fst-level"));
+      break;
+   }
+
+   const int chunk_mb = opt_get_int("fst-chunk");
+   if (chunk_mb > 0)
+      fstWriterSetBreakSize(fst_ctx, (size_t)chunk_mb << 20);
+
+   // Sections are compressed and written on a background thread when the
+   // writer was built with support for it
+#ifdef FST_WRITER_PARALLEL
+   fstWriterSetParallelMode(fst_ctx, opt_get_int("fst-parallel"));
+#else
    fstWriterSetParallelMode(fst_ctx, 0);
+#endif
 
    atexit(fst_close);
 
@@ -0,0 +1,299 @@
+//
+//  Copyright (C) 2018  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "util.h"
+#include "ident.h"
+#include "globset.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The patterns are compiled into a nondeterministic automaton with one
+// state for each prefix of each pattern: state k of a pattern has
+// matched its first k characters. A '*' matches one or more characters
+// like ident_glob so the state after it loops on any character.
+//
+// Sets of automaton states are turned into deterministic states lazily
+// as the identifiers being matched reach them, so matching takes one
+// table lookup per character once the common paths have been seen.
+
+#define MAX_DSTATES   2048
+#define MAX_DSET_INTS (4 * 1024 * 1024)
+#define DEAD          0
+#define UNKNOWN       -1
+
+typedef struct {
+   char     ch;          // Character to advance or '*' or '\0' at end
+   bool     loop;        // State after a '*'
+   int      pattern;
+} nstate_t;
+
+typedef struct {
+   int     *set;
+   unsigned count;
+   uint32_t hash;
+   int      first;       // Lowest accepting pattern or INT_MAX
+   int      next[256];
+} dstate_t;
+
+struct glob_set {
+   nstate_t  *nstates;
+   unsigned   nnstates;
+   unsigned   nstates_alloc;
+   int       *starts;
+   unsigned   npatterns;
+   unsigned   starts_alloc;
+   dstate_t **dstates;
+   unsigned   ndstates;
+   unsigned   dstates_alloc;
+   size_t     dset_ints;
+   int       *dtable;
+   unsigned   dtable_size;
+   unsigned  *mark;
+   unsigned   generation;
+   int       *scratch;
+};
+
+glob_set_t *glob_set_new(void)
+{
+   glob_set_t *g = xcalloc(sizeof(glob_set_t));
+   return g;
+}
+
+static void glob_set_flush(glob_set_t *g)
+{
+   for (unsigned i = 0; i < g->ndstates; i++) {
+      free(g->dstates[i]->set);
+      free(g->dstates[i]);
+   }
+
+   free(g->dstates);
+   free(g->dtable);
+   free(g->mark);
+   free(g->scratch);
+
+   g->dstates       = NULL;
+   g->ndstates      = 0;
+   g->dstates_alloc = 0;
+   g->dset_ints     = 0;
+   g->dtable        = NULL;
+   g->dtable_size   = 0;
+   g->mark          = NULL;
+   g->scratch       = NULL;
+}
+
+void glob_set_free(glob_set_t *g)
+{
+   glob_set_flush(g);
+   free(g->nstates);
+   free(g->starts);
+   free(g);
+}
+
+int glob_set_add(glob_set_t *g, const char *pattern)
+{
+   // Adding a pattern changes every deterministic state
+   glob_set_flush(g);
+
+   const size_t len = strlen(pattern);
+
+   if (g->npatterns == g->starts_alloc) {
+      g->starts_alloc = MAX(g->starts_alloc * 2, 16);
+      g->starts = xrealloc(g->starts, g->starts_alloc * sizeof(int));
+   }
+
+   if (g->nnstates + len + 1 > g->nstates_alloc) {
+      g->nstates_alloc = MAX(g->nstates_alloc * 2, g->nnstates + len + 1);
+      g->nstates = xrealloc(g->nstates, g->nstates_alloc * sizeof(nstate_t));
+   }
+
+   const int index = g->npatterns++;
+   g->starts[index] = g->nnstates;
+
+   for (size_t k = 0; k <= len; k++) {
+      nstate_t *n = &(g->nstates[g->nnstates++]);
+      n->ch      = pattern[k];
+      n->loop    = (k > 0 && pattern[k - 1] == '*');
+      n->pattern = index;
+   }
+
+   return index;
+}
+
+unsigned glob_set_size(glob_set_t *g)
+{
+   return g->npatterns;
+}
+
+static uint32_t glob_set_hash(const int *set, unsigned count)
+{
+   uint32_t hash = 2166136261u;
+   for (unsigned i = 0; i < count; i++)
+      hash = (hash ^ (uint32_t)set[i]) * 16777619u;
+   return hash;
+}
+
+static void glob_set_insert(glob_set_t *g, int index)
+{
+   unsigned slot = g->dstates[index]->hash & (g->dtable_size - 1);
+   while (g->dtable[slot] != UNKNOWN)
+      slot = (slot + 1) & (g->dtable_size - 1);
+
+   g->dtable[slot] = index;
+}
+
+static void glob_set_rehash(glob_set_t *g)
+{
+   free(g->dtable);
+   g->dtable_size = MAX(g->dtable_size * 2, 64);
+   g->dtable = xmalloc(g->dtable_size * sizeof(int));
+
+   for (unsigned i = 0; i < g->dtable_size; i++)
+      g->dtable[i] = UNKNOWN;
+
+   for (unsigned i = 0; i < g->ndstates; i++)
+      glob_set_insert(g, i);
+}
+
+static int glob_set_intern(glob_set_t *g, int *set, unsigned count)
+{
+   const uint32_t hash = glob_set_hash(set, count);
+
+   if (g->dtable_size > 0) {
+      unsigned slot = hash & (g->dtable_size - 1);
+      for (; g->dtable[slot] != UNKNOWN;
+           slot = (slot + 1) & (g->dtable_size - 1)) {
+         const dstate_t *d = g->dstates[g->dtable[slot]];
+         if (d->hash == hash && d->count == count
+             && memcmp(d->set, set, count * sizeof(int)) == 0)
+            return g->dtable[slot];
+      }
+   }
+
+   dstate_t *d = xmalloc(sizeof(dstate_t));
+   d->set   = xmalloc(MAX(count, 1) * sizeof(int));
+   d->count = count;
+   d->hash  = hash;
+   d->first = INT_MAX;
+
+   memcpy(d->set, set, count * sizeof(int));
+
+   for (unsigned i = 0; i < count; i++) {
+      const nstate_t *n = &(g->nstates[set[i]]);
+      if (n->ch == '\0')
+         d->first = MIN(d->first, n->pattern);
+   }
+
+   for (int i = 0; i < 256; i++)
+      d->next[i] = UNKNOWN;
+
+   if (g->ndstates == g->dstates_alloc) {
+      g->dstates_alloc = MAX(g->dstates_alloc * 2, 64);
+      g->dstates = xrealloc(g->dstates, g->dstates_alloc * sizeof(dstate_t *));
+   }
+
+   const int index = g->ndstates++;
+   g->dstates[index] = d;
+   g->dset_ints += count;
+
+   if (g->ndstates * 2 > g->dtable_size)
+      glob_set_rehash(g);
+   else
+      glob_set_insert(g, index);
+
+   return index;
+}
+
+static int glob_set_cmp(const void *a, const void *b)
+{
+   return *(const int *)a - *(const int *)b;
+}
+
+static int glob_set_step(glob_set_t *g, int from, unsigned char ch)
+{
+   const dstate_t *d = g->dstates[from];
+
+   if (++(g->generation) == 0) {
+      memset(g->mark, '\0', g->nnstates * sizeof(unsigned));
+      g->generation = 1;
+   }
+
+   unsigned count = 0;
+   for (unsigned i = 0; i < d->count; i++) {
+      const int s = d->set[i];
+      const nstate_t *n = &(g->nstates[s]);
+
+      if (n->loop && g->mark[s] != g->generation) {
+         g->mark[s] = g->generation;
+         g->scratch[count++] = s;
+      }
+
+      if (n->ch != '\0' && (n->ch == '*' || n->ch == (char)ch)
+          && g->mark[s + 1] != g->generation) {
+         g->mark[s + 1] = g->generation;
+         g->scratch[count++] = s + 1;
+      }
+   }
+
+   qsort(g->scratch, count, sizeof(int), glob_set_cmp);
+
+   return glob_set_intern(g, g->scratch, count);
+}
+
+int glob_set_first(glob_set_t *g, ident_t i)
+{
+   if (g->npatterns == 0)
+      return -1;
+
+   if (g->ndstates > MAX_DSTATES || g->dset_ints > MAX_DSET_INTS)
+      glob_set_flush(g);
+
+   if (g->ndstates == 0) {
+      g->mark       = xcalloc(g->nnstates * sizeof(unsigned));
+      g->scratch    = xmalloc(g->nnstates * sizeof(int));
+      g->generation = 0;
+
+      // The empty set is always the first state
+      int none = 0;
+      const int dead = glob_set_intern(g, &none, 0);
+      assert(dead == DEAD);
+      (void)dead;
+
+      glob_set_intern(g, g->starts, g->npatterns);
+   }
+
+   const char *p = istr(i);
+   int state = DEAD + 1;
+   for (; *p != '\0'; p++) {
+      const unsigned char ch = *p;
+
+      dstate_t *d = g->dstates[state];
+      if (d->next[ch] == UNKNOWN)
+         d->next[ch] = glob_set_step(g, state, ch);
+
+      const int next = d->next[ch];
+      if (next == DEAD)
+         return -1;
+
+      state = next;
+   }
+
+   const int first = g->dstates[state]->first;
+   return (first == INT_MAX) ? -1 : first;
+}
@@ -0,0 +1,40 @@
+//
+//  Copyright (C) 2018  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _GLOBSET_H
+#define _GLOBSET_H
+
+#include "prim.h"
+
+#include <stdbool.h>
+
+//
+// Set of wildcard patterns with the same syntax as ident_glob matched
+// against an identifier in a single pass
+//
+
+typedef struct glob_set glob_set_t;
+
+glob_set_t *glob_set_new(void);
+void glob_set_free(glob_set_t *g);
+int glob_set_add(glob_set_t *g, const char *pattern);
+unsigned glob_set_size(glob_set_t *g);
+
+// Index of the first pattern added matching i or -1 if none match
+int glob_set_first(glob_set_t *g, ident_t i);
+
+#endif  // _GLOBSET_H
@@ -0,0 +1,104 @@
+//
+//  Copyright (C) 2018  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "util.h"
+#include "kernel.h"
+
+#include <string.h>
+
+// Support functions which only read kernel state. When clang is
+// available this file is also compiled to LLVM bitcode which the code
+// generator links into each module so these can be inlined.
+
+DLLEXPORT
+void *_vec_load(void *_nids, void *where, int32_t low, int32_t high,
+                bool last)
+{
+   const int32_t *nids = _nids;
+   int offset = low;
+
+   groupid_t gid = netdb_lookup(netdb, nids[offset]);
+   netgroup_t *g = &(groups[gid]);
+   int skip = nids[offset] - g->first;
+
+   if (offset + g->length - skip > high) {
+      // If the signal data is already contiguous return a pointer to
+      // that rather than copying into the user buffer
+      void *r = unlikely(last) ? g->last_value : g->resolved;
+      return (uint8_t *)r + (skip * g->size);
+   }
+
+   uint8_t *p = where;
+   for (;;) {
+      const int to_copy = MIN(high - offset + 1, g->length - skip);
+      const int bytes   = to_copy * g->size;
+
+      const void *src = unlikely(last) ? g->last_value : g->resolved;
+
+      memcpy(p, (uint8_t *)src + (skip * g->size), bytes);
+
+      offset += g->length - skip;
+      p += bytes;
+
+      if (offset > high)
+         break;
+
+      gid = netdb_lookup(netdb, nids[offset]);
+      g = &(groups[gid]);
+      skip = nids[offset] - g->first;
+   }
+
+   // Signal data was non-contiguous so return the user buffer
+   return where;
+}
+
+DLLEXPORT
+int64_t _last_event(void *_nids, int32_t n)
+{
+   const int32_t *nids = _nids;
+
+   int64_t last = INT64_MAX;
+   int offset = 0;
+   while (offset < n) {
+      const groupid_t gid = netdb_lookup(netdb, nids[offset]);
+      const uint64_t last_event = groups_cold[gid].last_event;
+      if (last_event < now)
+         last = MIN(last, now - last_event);
+
+      offset += groups[gid].length;
+   }
+
+   return last;
+}
+
+DLLEXPORT
+bool _test_net_flag(void *_nids, int32_t n, int32_t flag)
+{
+   const int32_t *nids = _nids;
+
+   int offset = 0;
+   while (offset < n) {
+      netgroup_t *g = &(groups[netdb_lookup(netdb, nids[offset])]);
+
+      if (g->flags & flag)
+         return true;
+
+      offset += g->length;
+   }
+
+   return false;
+}
@@ -43,7 +43,26 @@
 #include <dlfcn.h>
 #endif
 
-#define TRACE_MAX 10
+// Code generated in memory by elaborating with --jit is found through
+// this rather than by loading a shared library for the top-level unit
+static ident_t         jit_unit = NULL;
+static jit_lookup_fn_t jit_lookup = NULL;
+
+// Symbol table linked into a design elaborated with --bundle
+typedef struct {
+   const char *name;
+   void       *addr;
+} bundle_sym_t;
+
+// Each package linked into the bundle with the time its shared library
+// was written when the design was elaborated
+typedef struct {
+   const char *name;
+   uint64_t    stamp;
+} bundle_unit_t;
+
+static const bundle_sym_t *bundle_syms = NULL;
+static int32_t             bundle_nsyms = 0;
 
 #ifdef __MINGW32__
 #ifdef _WIN64
@@ -58,6 +77,11 @@ static size_t nmodules = 0, max_modules = 0;
 
 #endif
 
+static int jit_bundle_cmp(const void *key, const void *elem)
+{
+   return strcmp(key, ((const bundle_sym_t *)elem)->name);
+}
+
 void *jit_find_symbol(const char *name, bool required)
 {
 #if (defined __MINGW32__ || defined __CYGWIN__) && !defined _WIN64
@@ -67,6 +91,22 @@ void *jit_find_symbol(const char *name, bool required)
 
    name = safe_symbol(name);
 
+   if (jit_lookup != NULL) {
+      void *ptr = (*jit_lookup)(name);
+      if (ptr != NULL)
+         return ptr;
+   }
+
+   if (bundle_syms != NULL) {
+      const bundle_sym_t *sym = bsearch(name, bundle_syms, bundle_nsyms,
+                                        sizeof(bundle_sym_t), jit_bundle_cmp);
+      if (sym != NULL)
+         return sym->addr;
+
+      // Symbols from the runtime library and any foreign subprograms
+      // are not in the table
+   }
+
 #ifdef __MINGW32__
 
 #ifdef _WIN64
@@ -109,6 +149,9 @@ void *jit_find_symbol(const char *name, bool required)
 
 static void jit_load_module(ident_t name)
 {
+   if (name == jit_unit)
+      return;
+
    lib_t lib = lib_find(ident_until(name, '.'), true);
 
    tree_kind_t kind = lib_index_kind(lib, name);
@@ -143,6 +186,110 @@ static void jit_load_module(ident_t name)
 #endif
 }
 
+#ifndef __MINGW32__
+static bool jit_try_load(lib_t lib, ident_t name, bool *loaded)
+{
+   // Returns false if there is a shared object for the unit which
+   // cannot be used
+
+   *loaded = false;
+
+   char *so_fname LOCAL = xasprintf("_%s." DLL_EXT, istr(name));
+
+   lib_mtime_t so_mt;
+   if (!lib_stat(lib, so_fname, &so_mt))
+      return true;
+
+   // A shared object older than the unit was compiled from an earlier
+   // version of it, for example when the unit was analysed again
+   // without code generation
+   if (lib_index_kind(lib, name) == T_LAST_TREE_KIND)
+      return false;
+   else if (so_mt < lib_mtime(lib, name))
+      return false;
+
+   char so_path[PATH_MAX];
+   lib_realpath(lib, so_fname, so_path, sizeof(so_path));
+
+   return (*loaded = (dlopen(so_path, RTLD_LAZY | RTLD_GLOBAL) != NULL));
+}
+#endif
+
+void *jit_find_native(ident_t unit, const char *symbol)
+{
+#ifdef __MINGW32__
+   return NULL;
+#else
+   lib_t lib = lib_find(ident_until(unit, '.'), false);
+   if (lib == NULL)
+      return NULL;
+
+   // The package body may refer to data in the package so that must be
+   // loaded first. If either is out of date the caller falls back to
+   // interpreting the function.
+   bool have_pack, have_body;
+   if (!jit_try_load(lib, unit, &have_pack))
+      return NULL;
+   else if (!jit_try_load(lib, ident_prefix(unit, ident_new("body"), '-'),
+                          &have_body))
+      return NULL;
+
+   if (!have_pack && !have_body)
+      return NULL;
+
+   dlerror();   // Clear any previous error
+   return dlsym(RTLD_DEFAULT, safe_symbol(symbol));
+#endif
+}
+
+#ifndef __MINGW32__
+static void jit_load_bundle(ident_t name)
+{
+   // Every package the design uses is linked into the same library so
+   // only this one needs to be loaded
+
+   lib_t lib = lib_find(ident_until(name, '.'), true);
+
+   char *so_fname LOCAL = xasprintf("_%s." DLL_EXT, istr(name));
+   char so_path[PATH_MAX];
+   lib_realpath(lib, so_fname, so_path, sizeof(so_path));
+
+   if (opt_get_int("rt_trace_en"))
+      fprintf(stderr, "TRACE (init): load bundle %s from %s\n",
+              istr(name), so_path);
+
+   void *handle = dlopen(so_path, RTLD_LAZY | RTLD_GLOBAL);
+   if (handle == NULL)
+      fatal("%s: %s", so_path, dlerror());
+
+   const int32_t *nsyms = dlsym(handle, "_nvc_bundle_nsyms");
+   bundle_syms = dlsym(handle, "_nvc_bundle_syms");
+   if (nsyms == NULL || bundle_syms == NULL)
+      fatal("%s does not contain a symbol table: the design must be "
+            "elaborated again", so_path);
+
+   bundle_nsyms = *nsyms;
+
+   const int32_t *nunits = dlsym(handle, "_nvc_bundle_nunits");
+   const bundle_unit_t *units = dlsym(handle, "_nvc_bundle_units");
+   if (nunits == NULL || units == NULL)
+      fatal("%s does not contain a unit table: the design must be "
+            "elaborated again", so_path);
+
+   for (int32_t i = 0; i < *nunits; i++) {
+      ident_t unit = ident_new(units[i].name);
+      lib_t ulib = lib_find(ident_until(unit, '.'), true);
+
+      char *unit_fname LOCAL = xasprintf("_%s." DLL_EXT, units[i].name);
+      lib_mtime_t mt;
+      if (!lib_stat(ulib, unit_fname, &mt) || mt != units[i].stamp)
+         fatal("design bundle %s is out of date as %s has been analysed "
+               "again: the design must be elaborated again", istr(name),
+               units[i].name);
+   }
+}
+#endif
+
 void jit_init(tree_t top)
 {
 #ifdef __MINGW32__
@@ -154,6 +301,13 @@ void jit_init(tree_t top)
                 nmodules, max_modules);
 #endif
 
+#ifndef __MINGW32__
+   if (tree_attr_int(top, bundle_i, 0) && tree_ident(top) != jit_unit) {
+      jit_load_bundle(tree_ident(top));
+      return;
+   }
+#endif
+
    const int ncontext = tree_contexts(top);
    for (int i = 0; i < ncontext; i++) {
       tree_t c = tree_context(top, i);
@@ -164,84 +318,141 @@ void jit_init(tree_t top)
    jit_load_module(tree_ident(top));
 }
 
-void jit_shutdown(void)
+void jit_register(ident_t unit, jit_lookup_fn_t fn)
 {
+   jit_unit   = unit;
+   jit_lookup = fn;
+}
 
+void jit_shutdown(void)
+{
+   bundle_syms  = NULL;
+   bundle_nsyms = 0;
 }
 
-void jit_trace(jit_trace_t **trace, size_t *count)
+static tree_t jit_symbol_decl(const char *name)
 {
-#ifdef HAVE_EXECINFO_H
+   // Map the symbol name of a compiled subprogram back to its declaration
 
-   void *frames[TRACE_MAX];
-   char **messages = NULL;
-   int trace_size = 0;
+   bool maybe_vhdl = false;
+   for (const char *p = name; *p != '\0'; p++) {
+      if (isupper((int)*p) || isdigit((int)*p) || *p == '_') {
+         maybe_vhdl = true;
+         continue;
+      }
+      else if (*p == '.') {
+         maybe_vhdl = p > name;
+         break;
+      }
+      else {
+         maybe_vhdl = false;
+         break;
+      }
+   }
 
-   trace_size = backtrace(frames, TRACE_MAX);
-   messages = backtrace_symbols(frames, trace_size);
+   if (!maybe_vhdl)
+      return NULL;
 
-   *count = 0;
-   *trace = xcalloc(sizeof(jit_trace_t) * trace_size);
+   ident_t mangled = ident_new(name);
+   ident_t lib_name = ident_until(mangled, '.');
 
-   for (int i = 0; i < trace_size; i++) {
-      // This hack only works for native compiled code
-      char *begin = strchr(messages[i], '(');
-      char *end = strchr(messages[i], '+');
+   lib_t lib = lib_find(lib_name, false);
+   if (lib == NULL)
+      return NULL;
 
-      if (begin == NULL || end == NULL)
-         continue;
+   ident_t decl_name = ident_until(mangled, '$');
 
-      *end = '\0';
+   ident_t unit_name = ident_runtil(decl_name, '.');
+   tree_t unit = lib_get(lib, unit_name);
+   if (unit == NULL)
+      return NULL;
 
-      bool maybe_vhdl = false;
-      for (const char *p = begin + 1; *p != '\0'; p++) {
-         if (isupper((int)*p) || isdigit((int)*p) || *p == '_') {
-            maybe_vhdl = true;
-            continue;
-         }
-         else if (*p == '.') {
-            maybe_vhdl = p > begin + 1;
-            break;
-         }
-         else {
-            maybe_vhdl = false;
-            break;
-         }
-      }
+   if (tree_kind(unit) == T_PACKAGE) {
+      unit = lib_get(lib, ident_prefix(unit_name, ident_new("body"), '-'));
+      if (unit == NULL)
+         return NULL;
+   }
 
-      if (!maybe_vhdl)
-         continue;
+   tree_t best = NULL;
+   const int ndecls = tree_decls(unit);
+   for (int i = 0; i < ndecls; i++) {
+      tree_t d = tree_decl(unit, i);
+      if (tree_attr_str(d, mangled_i) == mangled)
+         best = d;
+      else if (tree_ident(d) == decl_name && best == NULL)
+         best = d;
+   }
 
-      ident_t mangled = ident_new(begin + 1);
-      ident_t lib_name = ident_until(mangled, '.');
+   return best;
+}
 
-      lib_t lib = lib_find(lib_name, false);
-      if (lib == NULL)
-         continue;
+tree_t jit_find_decl(void *pc, const char **symbol)
+{
+   // Map an address in compiled code to its subprogram declaration and
+   // optionally the raw symbol name if the address is in a design unit
+
+   if (symbol != NULL)
+      *symbol = NULL;
+
+#ifndef __MINGW32__
+   Dl_info info;
+   if (dladdr(pc, &info) == 0 || info.dli_sname == NULL)
+      return NULL;
+
+   if (symbol != NULL && info.dli_fname != NULL) {
+      const char *base = strrchr(info.dli_fname, '/');
+      base = (base == NULL) ? info.dli_fname : base + 1;
+
+      const size_t len = strlen(base);
+      const size_t extlen = strlen("." DLL_EXT);
+      if (base[0] == '_' && len > extlen
+          && strcmp(base + len - extlen, "." DLL_EXT) == 0)
+         *symbol = info.dli_sname;
+   }
 
-      ident_t decl_name = ident_until(mangled, '$');
+   return jit_symbol_decl(info.dli_sname);
+#else
+   return NULL;
+#endif
+}
 
-      ident_t unit_name = ident_runtil(decl_name, '.');
-      tree_t unit = lib_get(lib, unit_name);
-      if (unit == NULL)
-         continue;
+int jit_backtrace(void **frames, int max)
+{
+#ifdef HAVE_EXECINFO_H
+   return backtrace(frames, max);
+#else
+   return 0;
+#endif
+}
 
-      if (tree_kind(unit) == T_PACKAGE) {
-         unit = lib_get(lib, ident_prefix(unit_name, ident_new("body"), '-'));
-         if (unit == NULL)
-            continue;
-      }
+void jit_trace_frames(void *const *frames, int nframes, jit_trace_t **trace,
+                      size_t *count)
+{
+   // The frames may come from another thread whose stack is now gone:
+   // only the return addresses are used
 
-      tree_t best = NULL;
-      const int ndecls = tree_decls(unit);
-      for (int i = 0; i < ndecls; i++) {
-         tree_t d = tree_decl(unit, i);
-         if (tree_attr_str(d, mangled_i) == mangled)
-            best = d;
-         else if (tree_ident(d) == decl_name && best == NULL)
-            best = d;
-      }
+   *count = 0;
+   *trace = NULL;
 
+#ifdef HAVE_EXECINFO_H
+   if (nframes == 0)
+      return;
+
+   char **messages = backtrace_symbols(frames, nframes);
+
+   *trace = xcalloc(sizeof(jit_trace_t) * nframes);
+
+   for (int i = 0; i < nframes; i++) {
+      // This hack only works for native compiled code
+      char *begin = strchr(messages[i], '(');
+      char *end = strchr(messages[i], '+');
+
+      if (begin == NULL || end == NULL)
+         continue;
+
+      *end = '\0';
+
+      tree_t best = jit_symbol_decl(begin + 1);
       if (best == NULL)
          continue;
 
@@ -251,9 +462,12 @@ void jit_trace(jit_trace_t **trace, size_t *count)
    }
 
    free(messages);
-
-#else
-   *count = 0;
-   *trace = NULL;
 #endif
 }
+
+void jit_trace(jit_trace_t **trace, size_t *count)
+{
+   void *frames[JIT_TRACE_MAX];
+   const int nframes = jit_backtrace(frames, JIT_TRACE_MAX);
+   jit_trace_frames(frames, nframes, trace, count);
+}
@@ -0,0 +1,69 @@
+//
+//  Copyright (C) 2018  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _RT_KERNEL_H
+#define _RT_KERNEL_H
+
+#include "rt.h"
+#include "netdb.h"
+
+// Kernel state used by the support functions in inline.c which are
+// also compiled to LLVM bitcode and inlined into generated code. Any
+// change to these definitions changes the ABI between the two.
+
+typedef struct netgroup   netgroup_t;
+typedef struct driver     driver_t;
+typedef struct sens_list  sens_list_t;
+typedef struct value      value_t;
+typedef struct watch_list watch_list_t;
+typedef struct res_memo   res_memo_t;
+
+// The fields of a group touched on every update are kept together in
+// one cache line and the rest are moved to a parallel array indexed by
+// group ID so the driver and event loops stream through less memory
+
+struct netgroup {
+   netid_t       first;
+   uint32_t      length;
+   net_flags_t   flags;
+   uint16_t      size;
+   uint16_t      n_drivers;
+   void         *resolved;
+   void         *last_value;
+   value_t      *forcing;
+   driver_t     *drivers;
+   res_memo_t   *resolution;
+   sens_list_t  *pending;
+} __attribute__((aligned(64)));
+
+typedef struct {
+   uint64_t      last_event;
+   tree_t        sig_decl;
+   watch_list_t *watching;
+} netgroup_cold_t;
+
+extern uint64_t         now;
+extern netdb_t         *netdb;
+extern netgroup_t      *groups;
+extern netgroup_cold_t *groups_cold;
+
+static inline netgroup_cold_t *rt_group_cold(const netgroup_t *g)
+{
+   return &(groups_cold[g - groups]);
+}
+
+#endif  // _RT_KERNEL_H
@@ -38,6 +38,7 @@ struct lxt_data {
    lxt_fmt_fn_t      fmt;
    range_kind_t      dir;
    const char       *map;
+   struct lt_symbol **slices;
 };
 
 static struct lt_trace *trace = NULL;
@@ -84,6 +85,27 @@ static void lxt_fmt_chars(tree_t decl, watch_t *w, lxt_data_t *data)
       lt_emit_value_string(trace, data->sym, 0, bits);
 }
 
+static void lxt_fmt_slices(tree_t decl, watch_t *w, lxt_data_t *data)
+{
+   // Only the parts of the signal that changed are emitted unless this
+   // is the initial dump when there are no changes recorded
+
+   const int *changed;
+   const int nchanged = rt_watch_changes(w, &changed);
+   const int nslices = nchanged > 0 ? nchanged : rt_watch_groups(w);
+
+   for (int i = 0; i < nslices; i++) {
+      const int group = nchanged > 0 ? changed[i] : i;
+
+      int first, length;
+      rt_watch_group_range(w, group, &first, &length);
+
+      char bits[length + 1];
+      rt_watch_group_string(w, group, data->map, bits, length + 1);
+      lt_emit_value_bit_string(trace, data->slices[group], 0, bits);
+   }
+}
+
 static void lxt_event_cb(uint64_t now, tree_t decl, watch_t *w, void *user)
 {
    if (now != last_time) {
@@ -139,6 +161,11 @@ void lxt_restart(void)
    lt_symbol_bracket_stripping(trace, 0);
    lt_set_clock_compress(trace);
 
+   // The initial values are written at the start of the capture window
+   const uint64_t now = rt_now(NULL);
+   if (now > 0)
+      lt_set_time64(trace, now);
+
    const int ndecls = tree_decls(lxt_top);
    for (int i = 0; i < ndecls; i++) {
       tree_t d = tree_decl(lxt_top, i);
@@ -208,14 +235,41 @@ void lxt_restart(void)
          }
       }
 
+      watch_t *w = rt_set_wave_cb(d, lxt_event_cb, data);
+
       char *name = lxt_fmt_name(d);
-      data->sym = lt_symbol_add(trace, name, rows, msb, lsb, flags);
+
+      const int ngroups = rt_watch_groups(w);
+      if (type_is_array(type) && flags == LT_SYM_F_BITS && ngroups > 1) {
+         // A vector driven in parts has a symbol for each part so a
+         // change to one part does not emit the whole signal
+         data->fmt    = lxt_fmt_slices;
+         data->slices = xmalloc(ngroups * sizeof(struct lt_symbol *));
+
+         const int step = (data->dir == RANGE_DOWNTO) ? -1 : 1;
+         const size_t name_len = strlen(name);
+         char slice_name[name_len + 64];
+
+         for (int i = 0; i < ngroups; i++) {
+            int first, length;
+            rt_watch_group_range(w, i, &first, &length);
+
+            const int left = msb + step * first;
+            const int right = left + step * (length - 1);
+            checked_sprintf(slice_name, sizeof(slice_name), "%s[%d:%d]",
+                            name, left, right);
+
+            data->slices[i] =
+               lt_symbol_add(trace, slice_name, rows, left, right, flags);
+         }
+      }
+      else
+         data->sym = lt_symbol_add(trace, name, rows, msb, lsb, flags);
+
       free(name);
 
       tree_add_attr_ptr(d, lxt_data_i, data);
 
-      watch_t *w = rt_set_event_cb(d, lxt_event_cb, data, true);
-
       (*data->fmt)(d, w, data);
    }
 
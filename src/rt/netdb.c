@@ -19,57 +19,248 @@
 #include "util.h"
 
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 #include <assert.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
-netdb_t *netdb_open(tree_t top)
+#define NETDB_MAGIC   0x4244544e   // "NTDB"
+#define NETDB_VERSION 1
+#define NETDB_ALIGN   4096
+
+#define ALIGN_PAGE(x) (((x) + NETDB_ALIGN - 1) & ~(uint64_t)(NETDB_ALIGN - 1))
+
+typedef struct {
+   uint32_t magic;
+   uint32_t version;
+   uint32_t nnets;
+   uint32_t max;
+   uint32_t nruns;
+   uint32_t npages;
+   uint64_t runs_off;
+   uint64_t pages_off;
+   uint64_t map_off;
+} netdb_header_t;
+
+static int netdb_group_cmp(const void *a, const void *b)
 {
-   char *name = xasprintf("_%s.netdb", istr(tree_ident(top)));
-   fbuf_t *f = lib_fbuf_open(lib_work(), name, FBUF_IN);
-   if (f == NULL)
-      fatal("failed to open net database file %s", name);
-   free(name);
+   const group_t *l = a, *r = b;
+   return (l->first > r->first) - (l->first < r->first);
+}
 
-   netdb_t *db = xmalloc(sizeof(struct netdb));
-   db->groups = NULL;
+static char *netdb_file_name(tree_t top)
+{
+   return xasprintf("_%s.netdb", istr(tree_ident(top)));
+}
+
+static unsigned netdb_npages(netid_t nnets)
+{
+   return (nnets >> NETDB_PAGE_BITS) + 1;
+}
+
+static void netdb_build(netdb_t *db, group_t *groups, unsigned ngroups)
+{
+   db->runs   = NULL;
+   db->nruns  = 0;
+   db->pages  = NULL;
+   db->map    = NULL;
    db->max    = 0;
    db->nnets  = 0;
+   db->mapped = NULL;
+   db->maplen = 0;
 
-   groupid_t gid;
-   while ((gid = read_u32(f)) != GROUPID_INVALID) {
-      group_t *g = xmalloc(sizeof(struct group));
-      g->next   = db->groups;
-      g->gid    = gid;
-      g->first  = read_u32(f);
-      g->length = read_u32(f);
-
-      db->groups = g;
-      db->max    = MAX(db->max, gid);
-      db->nnets  = MAX(db->nnets, g->first + g->length);
+   for (unsigned i = 0; i < ngroups; i++) {
+      db->max   = MAX(db->max, groups[i].gid);
+      db->nnets = MAX(db->nnets, groups[i].first + groups[i].length);
    }
 
-   fbuf_close(f);
+   qsort(groups, ngroups, sizeof(group_t), netdb_group_cmp);
 
-   db->map = xmalloc(sizeof(groupid_t) * db->nnets);
-   for (netid_t i = 0; i < db->nnets; i++)
-      db->map[i] = GROUPID_INVALID;
+   // Gaps between groups are filled with invalid runs so every net falls
+   // in exactly one run
 
-   for (group_t *it = db->groups; it != NULL; it = it->next) {
-      for (netid_t i = it->first; i < it->first + it->length; i++)
-         db->map[i] = it->gid;
+   db->runs = xmalloc((ngroups * 2 + 1) * sizeof(netdb_run_t));
+
+   netid_t next = 0;
+   for (unsigned i = 0; i < ngroups; i++) {
+      if (groups[i].first > next)
+         db->runs[(db->nruns)++] = (netdb_run_t){ next, GROUPID_INVALID };
+      db->runs[(db->nruns)++] = (netdb_run_t){ groups[i].first, groups[i].gid };
+      next = groups[i].first + groups[i].length;
    }
 
-   return db;
+   if (db->nruns == 0)
+      db->runs[(db->nruns)++] = (netdb_run_t){ 0, GROUPID_INVALID };
+
+   if (db->nnets <= NETDB_DENSE_MAX) {
+      db->map = xmalloc(sizeof(groupid_t) * MAX(db->nnets, 1));
+      db->map[0] = GROUPID_INVALID;
+      for (unsigned i = 0; i < db->nruns; i++) {
+         const netid_t end =
+            (i + 1 < db->nruns) ? db->runs[i + 1].first : db->nnets;
+         for (netid_t n = db->runs[i].first; n < end; n++)
+            db->map[n] = db->runs[i].gid;
+      }
+   }
+   else {
+      const unsigned npages = netdb_npages(db->nnets);
+      db->pages = xmalloc((npages + 1) * sizeof(unsigned));
+
+      unsigned run = 0;
+      for (unsigned p = 0; p < npages; p++) {
+         const netid_t first = (netid_t)p << NETDB_PAGE_BITS;
+         while (run + 1 < db->nruns && db->runs[run + 1].first <= first)
+            run++;
+         db->pages[p] = run;
+      }
+      db->pages[npages] = db->nruns - 1;
+   }
 }
 
-void netdb_close(netdb_t *db)
+static uint64_t netdb_write_section(FILE *f, uint64_t off,
+                                    const void *ptr, size_t size)
+{
+   static const char zero[NETDB_ALIGN];
+
+   const uint64_t pad = ALIGN_PAGE(off) - off;
+   if (pad > 0 && fwrite(zero, pad, 1, f) != 1)
+      fatal_errno("fwrite");
+   if (fwrite(ptr, size, 1, f) != 1)
+      fatal_errno("fwrite");
+
+   return off + pad;
+}
+
+void netdb_write(tree_t top, group_t *groups, unsigned ngroups)
 {
-   while (db->groups != NULL) {
-      group_t *next = db->groups->next;
-      free(db->groups);
-      db->groups = next;
+   netdb_t db;
+   netdb_build(&db, groups, ngroups);
+
+   char *name = netdb_file_name(top);
+   char path[PATH_MAX];
+   lib_realpath(lib_work(), name, path, sizeof(path));
+   free(name);
+
+   // A simulation may still have the old file mapped so write the new
+   // one alongside and rename it into place
+
+   char *tmp = xasprintf("%s.%d", path, getpid());
+   FILE *f = fopen(tmp, "wb");
+   if (f == NULL)
+      fatal_errno("failed to create net database file %s", tmp);
+
+   const size_t runs_sz   = db.nruns * sizeof(netdb_run_t);
+   const unsigned npages  = (db.pages != NULL) ? netdb_npages(db.nnets) : 0;
+   const size_t pages_sz  = (npages + 1) * sizeof(unsigned);
+   const size_t map_sz    = sizeof(groupid_t) * MAX(db.nnets, 1);
+
+   netdb_header_t header = {
+      .magic   = NETDB_MAGIC,
+      .version = NETDB_VERSION,
+      .nnets   = db.nnets,
+      .max     = db.max,
+      .nruns   = db.nruns,
+      .npages  = npages
+   };
+
+   header.runs_off = ALIGN_PAGE(sizeof(header));
+   uint64_t end = header.runs_off + runs_sz;
+   if (db.pages != NULL) {
+      header.pages_off = ALIGN_PAGE(end);
+      end = header.pages_off + pages_sz;
    }
+   if (db.map != NULL)
+      header.map_off = ALIGN_PAGE(end);
 
-   free(db->map);
+   if (fwrite(&header, sizeof(header), 1, f) != 1)
+      fatal_errno("fwrite");
+
+   uint64_t off = sizeof(header);
+   off = netdb_write_section(f, off, db.runs, runs_sz) + runs_sz;
+   if (db.pages != NULL)
+      off = netdb_write_section(f, off, db.pages, pages_sz) + pages_sz;
+   if (db.map != NULL)
+      off = netdb_write_section(f, off, db.map, map_sz) + map_sz;
+
+   if (fclose(f) != 0)
+      fatal_errno("fclose");
+
+#ifdef __MINGW32__
+   remove(path);
+#endif
+
+   if (rename(tmp, path) != 0)
+      fatal_errno("rename %s", tmp);
+
+   free(tmp);
+   free(db.runs);
+   free(db.pages);
+   free(db.map);
+}
+
+netdb_t *netdb_open(tree_t top)
+{
+   char *name = netdb_file_name(top);
+   char path[PATH_MAX];
+   lib_realpath(lib_work(), name, path, sizeof(path));
+
+   int fd = open(path, O_RDONLY);
+   if (fd < 0)
+      fatal("failed to open net database file %s", name);
+
+   struct stat st;
+   if (fstat(fd, &st) != 0)
+      fatal_errno("fstat");
+
+   if (st.st_size < sizeof(netdb_header_t))
+      fatal("net database file %s is truncated", name);
+
+   void *mapped = map_file(fd, st.st_size);
+   close(fd);
+
+   const netdb_header_t *header = mapped;
+   if (header->magic != NETDB_MAGIC || header->version != NETDB_VERSION)
+      fatal("%s: net database was created by a different version of "
+            PACKAGE_NAME " and the design should be re-elaborated", name);
+
+   const size_t runs_sz  = header->nruns * sizeof(netdb_run_t);
+   const size_t pages_sz = (header->npages + 1) * sizeof(unsigned);
+   const size_t map_sz   = sizeof(groupid_t) * MAX(header->nnets, 1);
+
+   if (header->runs_off + runs_sz > st.st_size
+       || (header->pages_off != 0
+           && header->pages_off + pages_sz > st.st_size)
+       || (header->map_off != 0 && header->map_off + map_sz > st.st_size)
+       || (header->pages_off == 0 && header->map_off == 0)
+       || header->nruns == 0)
+      fatal("net database file %s is corrupt", name);
+
+   free(name);
+
+   netdb_t *db = xmalloc(sizeof(struct netdb));
+   db->runs   = (netdb_run_t *)((char *)mapped + header->runs_off);
+   db->nruns  = header->nruns;
+   db->pages  = NULL;
+   db->map    = NULL;
+   db->nnets  = header->nnets;
+   db->max    = header->max;
+   db->mapped = mapped;
+   db->maplen = st.st_size;
+
+   if (header->pages_off != 0)
+      db->pages = (unsigned *)((char *)mapped + header->pages_off);
+   if (header->map_off != 0)
+      db->map = (groupid_t *)((char *)mapped + header->map_off);
+
+   return db;
+}
+
+void netdb_close(netdb_t *db)
+{
+   unmap_file(db->mapped, db->maplen);
    free(db);
 }
 
@@ -78,8 +269,29 @@ unsigned netdb_size(netdb_t *db)
    return db->max + 1;
 }
 
+size_t netdb_memory(netdb_t *db)
+{
+   if (db->mapped != NULL)
+      return db->maplen;
+
+   size_t bytes = db->nruns * sizeof(netdb_run_t);
+   if (db->map != NULL)
+      bytes += MAX(db->nnets, 1) * sizeof(groupid_t);
+   if (db->pages != NULL)
+      bytes += (netdb_npages(db->nnets) + 1) * sizeof(unsigned);
+
+   return bytes;
+}
+
 void netdb_walk(netdb_t *db, netdb_walk_fn_t fn)
 {
-   for (group_t *it = db->groups; it != NULL; it = it->next)
-      (*fn)(it->gid, it->first, it->length);
+   for (unsigned i = 0; i < db->nruns; i++) {
+      const netdb_run_t *r = &(db->runs[i]);
+      if (r->gid == GROUPID_INVALID)
+         continue;
+
+      const netid_t end =
+         (i + 1 < db->nruns) ? db->runs[i + 1].first : db->nnets;
+      (*fn)(r->gid, r->first, end - r->first);
+   }
 }
@@ -25,8 +25,10 @@
 
 typedef uint32_t groupid_t;
 
-#define GROUPID_INVALID UINT32_MAX
-#define NETDB_DEBUG     0
+#define GROUPID_INVALID  UINT32_MAX
+#define NETDB_DEBUG      0
+#define NETDB_PAGE_BITS  6
+#define NETDB_DENSE_MAX  (1 << 20)
 
 typedef struct netdb netdb_t;
 typedef struct group group_t;
@@ -40,30 +42,65 @@ struct group {
    unsigned  length;
 };
 
+typedef struct {
+   netid_t   first;
+   groupid_t gid;
+} netdb_run_t;
+
+// Groups are stored as runs sorted by first net covering every net with
+// gaps filled by invalid runs. Small designs also have a dense map with
+// one entry per net. Otherwise each page of nets records the index of the
+// run containing its first net so a lookup only searches the runs which
+// start within one page.
+//
+// The tables are built at elaboration time and written uncompressed with
+// each one starting on a page boundary. At run time the file is mapped
+// read-only and used in place so processes simulating the same design
+// share the pages.
+
 struct netdb {
-   group_t   *groups;
-   groupid_t *map;
-   netid_t    nnets;
-   unsigned   max;
+   netdb_run_t *runs;
+   unsigned     nruns;
+   unsigned    *pages;
+   groupid_t   *map;
+   netid_t      nnets;
+   unsigned     max;
+   void        *mapped;
+   size_t       maplen;
 };
 
 netdb_t *netdb_open(tree_t top);
+void netdb_write(tree_t top, group_t *groups, unsigned ngroups);
 void netdb_close(netdb_t *db);
 unsigned netdb_size(netdb_t *db);
+size_t netdb_memory(netdb_t *db);
 void netdb_walk(netdb_t *db, netdb_walk_fn_t fn);
 
 static inline groupid_t netdb_lookup(const netdb_t *db, netid_t nid)
 {
+   groupid_t gid;
+   if (likely(db->map != NULL))
+      gid = db->map[nid];
+   else {
+      const unsigned page = nid >> NETDB_PAGE_BITS;
+      unsigned low = db->pages[page], high = db->pages[page + 1];
+      while (low < high) {
+         const unsigned mid = (low + high + 1) / 2;
+         if (db->runs[mid].first <= nid)
+            low = mid;
+         else
+            high = mid - 1;
+      }
+      gid = db->runs[low].gid;
+   }
+
 #if NETDB_DEBUG
    assert(nid < db->nnets);
-   groupid_t gid = db->map[nid];
-   if (likely(gid != GROUPID_INVALID))
-      return gid;
-   else
+   if (unlikely(gid == GROUPID_INVALID))
       fatal_trace("net %d not in database", nid);
-#else
-   return db->map[nid];
 #endif
+
+   return gid;
 }
 
 #endif  // _NETDB_H
@@ -0,0 +1,137 @@
+//
+//  Copyright (C) 2018  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "util.h"
+#include "rt.h"
+#include "tree.h"
+#include "common.h"
+#include "nvtapi.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Signals are stored as the raw scalar values returned by rt_watch_value
+// under their full instance path. Each signal is registered with the
+// writer once so a later capture window appends to the same streams.
+
+typedef struct {
+   int       signal;
+   unsigned  count;
+   uint64_t *values;
+   watch_t  *watch;
+} nvt_data_t;
+
+static nvt_writer_t *nvt_writer;
+static tree_t        nvt_top;
+static ident_t       nvt_data_i;
+
+static void nvt_close(void)
+{
+   if (nvt_writer != NULL) {
+      nvt_writer_close(nvt_writer);
+      nvt_writer = NULL;
+   }
+}
+
+static void nvt_event_cb(uint64_t now, tree_t decl, watch_t *w, void *user)
+{
+   nvt_data_t *data = user;
+   rt_watch_value(w, data->values, data->count, false);
+   nvt_writer_change(nvt_writer, data->signal, now, data->values);
+}
+
+static unsigned nvt_type_width(type_t type)
+{
+   if (type_is_array(type))
+      return nvt_type_width(type_elem(type));
+
+   type_t base = type_base_recur(type);
+   switch (type_kind(base)) {
+   case T_ENUM:
+      return (type_enum_literals(base) <= 256) ? 1 : 4;
+   case T_RECORD:
+      {
+         unsigned width = 1;
+         const int nfields = type_fields(base);
+         for (int i = 0; i < nfields; i++)
+            width = MAX(width, nvt_type_width(tree_type(type_field(base, i))));
+         return width;
+      }
+   default:
+      return 8;
+   }
+}
+
+static void nvt_process_signal(tree_t d)
+{
+   nvt_data_t *data = tree_attr_ptr(d, nvt_data_i);
+   if (data == NULL) {
+      data = xcalloc(sizeof(nvt_data_t));
+      data->signal = -1;
+   }
+
+   data->watch = rt_set_wave_cb(d, nvt_event_cb, data);
+
+   if (data->signal == -1) {
+      const int ngroups = rt_watch_groups(data->watch);
+      for (int i = 0; i < ngroups; i++) {
+         int first, length;
+         rt_watch_group_range(data->watch, i, &first, &length);
+         data->count += length;
+      }
+
+      type_t type = tree_type(d);
+      data->values = xmalloc(MAX(data->count, 1) * sizeof(uint64_t));
+      data->signal = nvt_writer_add(nvt_writer, istr(tree_ident(d)),
+                                    type_pp(type), MAX(data->count, 1),
+                                    nvt_type_width(type));
+
+      tree_add_attr_ptr(d, nvt_data_i, data);
+   }
+}
+
+void nvt_restart(void)
+{
+   if (nvt_writer == NULL)
+      return;
+
+   const int ndecls = tree_decls(nvt_top);
+   for (int i = 0; i < ndecls; i++) {
+      tree_t d = tree_decl(nvt_top, i);
+      if (tree_kind(d) == T_SIGNAL_DECL && wave_should_dump(d))
+         nvt_process_signal(d);
+   }
+
+   for (int i = 0; i < ndecls; i++) {
+      tree_t d = tree_decl(nvt_top, i);
+      if (tree_kind(d) == T_SIGNAL_DECL) {
+         nvt_data_t *data = tree_attr_ptr(d, nvt_data_i);
+         if (data != NULL)
+            nvt_event_cb(rt_now(NULL), d, data->watch, data);
+      }
+   }
+}
+
+void nvt_init(const char *file, tree_t top)
+{
+   nvt_data_i = ident_new("nvt_data");
+
+   nvt_writer = nvt_writer_open(file);
+   nvt_top    = top;
+
+   atexit(nvt_close);
+}
@@ -0,0 +1,574 @@
+//
+//  Copyright (C) 2018  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "util.h"
+#include "nvtapi.h"
+#include "fastlz.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// The file starts with an eight byte header followed by the compressed
+// blocks in the order they were filled. After the blocks comes the
+// signal table and then the block index sorted by signal and time. The
+// last 24 bytes give the offsets of the signal table and index so a
+// reader never has to scan the block data. Each record within a block is
+// the time delta from the previous change in LEB128 followed by the
+// values in little-endian order. All integers in the header, table and
+// index are little-endian.
+
+#define NVT_MAGIC      0x5456454e   // "NEVT"
+#define NVT_VERSION    1
+#define NVT_BLOCK_SIZE (16 * 1024)
+#define NVT_MIN_PACK   16
+#define NVT_TRAILER    24
+
+typedef struct {
+   uint64_t first;
+   uint64_t last;
+   uint64_t offset;
+   uint32_t signal;
+   uint32_t csize;
+   uint32_t rsize;
+   uint32_t nchanges;
+} nvt_block_t;
+
+typedef struct {
+   char     *name;
+   char     *type;
+   unsigned  count;
+   unsigned  width;
+   uint8_t  *buf;
+   size_t    len;
+   uint64_t  first;
+   uint64_t  last;
+   uint32_t  nchanges;
+} nvt_stream_t;
+
+struct nvt_writer {
+   FILE         *file;
+   char         *fname;
+   uint64_t      offset;
+   nvt_stream_t *streams;
+   unsigned      nstreams;
+   unsigned      max_streams;
+   nvt_block_t  *index;
+   size_t        nblocks;
+   size_t        max_blocks;
+   uint8_t      *packed;
+};
+
+typedef struct {
+   const char *name;
+   const char *type;
+   unsigned    count;
+   unsigned    width;
+   size_t      first_block;
+   size_t      nblocks;
+} nvt_signal_t;
+
+struct nvt_reader {
+   const uint8_t *map;
+   size_t         size;
+   char          *fname;
+   nvt_signal_t  *signals;
+   unsigned       nsignals;
+   nvt_block_t   *index;
+   size_t         nblocks;
+   uint8_t       *unpacked;
+   uint64_t      *values;
+   uint64_t      *initial;
+};
+
+static inline void nvt_put_le(uint8_t *p, uint64_t value, unsigned width)
+{
+   for (unsigned i = 0; i < width; i++, value >>= 8)
+      p[i] = value & 0xff;
+}
+
+static inline uint64_t nvt_get_le(const uint8_t *p, unsigned width)
+{
+   uint64_t value = 0;
+   for (unsigned i = 0; i < width; i++)
+      value |= (uint64_t)p[i] << (i * 8);
+   return value;
+}
+
+static void nvt_write(nvt_writer_t *w, const void *data, size_t len)
+{
+   if (len > 0 && fwrite(data, len, 1, w->file) != 1)
+      fatal_errno("failed writing NVT output %s", w->fname);
+   w->offset += len;
+}
+
+static void nvt_write_int(nvt_writer_t *w, uint64_t value, unsigned width)
+{
+   uint8_t buf[8];
+   nvt_put_le(buf, value, width);
+   nvt_write(w, buf, width);
+}
+
+static void nvt_write_pad(nvt_writer_t *w)
+{
+   static const uint8_t zero[8];
+   nvt_write(w, zero, (8 - (w->offset & 7)) & 7);
+}
+
+static void nvt_flush_stream(nvt_writer_t *w, int signal)
+{
+   nvt_stream_t *s = &(w->streams[signal]);
+   if (s->len == 0)
+      return;
+
+   // Small blocks and blocks that do not compress are stored as is and
+   // marked by having the same packed and unpacked size
+
+   const void *data = s->buf;
+   size_t csize = s->len;
+   if (s->len >= NVT_MIN_PACK) {
+      const int n = fastlz_compress_level(1, s->buf, s->len, w->packed);
+      if (n > 0 && n < (int)s->len) {
+         data  = w->packed;
+         csize = n;
+      }
+   }
+
+   if (w->nblocks == w->max_blocks) {
+      w->max_blocks = MAX(w->max_blocks * 2, 256);
+      w->index = xrealloc(w->index, w->max_blocks * sizeof(nvt_block_t));
+   }
+
+   nvt_block_t *b = &(w->index[(w->nblocks)++]);
+   b->first    = s->first;
+   b->last     = s->last;
+   b->offset   = w->offset;
+   b->signal   = signal;
+   b->csize    = csize;
+   b->rsize    = s->len;
+   b->nchanges = s->nchanges;
+
+   nvt_write(w, data, csize);
+
+   s->len      = 0;
+   s->nchanges = 0;
+}
+
+nvt_writer_t *nvt_writer_open(const char *file)
+{
+   nvt_writer_t *w = xmalloc(sizeof(nvt_writer_t));
+   memset(w, '\0', sizeof(nvt_writer_t));
+
+   if ((w->file = fopen(file, "wb")) == NULL)
+      fatal_errno("failed to open NVT output %s", file);
+
+   w->fname  = xstrdup(file);
+   w->packed = xmalloc(NVT_BLOCK_SIZE * 2);
+
+   nvt_write_int(w, NVT_MAGIC, 4);
+   nvt_write_int(w, NVT_VERSION, 4);
+
+   return w;
+}
+
+int nvt_writer_add(nvt_writer_t *w, const char *name, const char *type,
+                   unsigned count, unsigned width)
+{
+   assert(width == 1 || width == 2 || width == 4 || width == 8);
+   assert(count > 0);
+
+   if (w->nstreams == w->max_streams) {
+      w->max_streams = MAX(w->max_streams * 2, 64);
+      w->streams = xrealloc(w->streams,
+                            w->max_streams * sizeof(nvt_stream_t));
+   }
+
+   const size_t record_max = 10 + count * width;
+   if (record_max > NVT_BLOCK_SIZE)
+      w->packed = xrealloc(w->packed, record_max * 2);
+
+   nvt_stream_t *s = &(w->streams[w->nstreams]);
+   memset(s, '\0', sizeof(nvt_stream_t));
+   s->name  = xstrdup(name);
+   s->type  = xstrdup(type ?: "");
+   s->count = count;
+   s->width = width;
+   s->buf   = xmalloc(MAX(record_max, NVT_BLOCK_SIZE));
+
+   return (w->nstreams)++;
+}
+
+void nvt_writer_change(nvt_writer_t *w, int signal, uint64_t when,
+                       const uint64_t *values)
+{
+   assert(signal >= 0 && signal < w->nstreams);
+
+   nvt_stream_t *s = &(w->streams[signal]);
+
+   const size_t record_max = 10 + s->count * s->width;
+   if (s->len + record_max > MAX(record_max, NVT_BLOCK_SIZE))
+      nvt_flush_stream(w, signal);
+
+   // The first record in each block holds an absolute time so blocks can
+   // be decoded independently
+
+   uint64_t delta;
+   if (s->nchanges == 0) {
+      s->first = when;
+      delta = when;
+   }
+   else {
+      assert(when >= s->last);
+      delta = when - s->last;
+   }
+
+   uint8_t *p = s->buf + s->len;
+   do {
+      *p++ = (delta & 0x7f) | (delta > 0x7f ? 0x80 : 0);
+      delta >>= 7;
+   } while (delta > 0);
+
+   for (unsigned i = 0; i < s->count; i++, p += s->width)
+      nvt_put_le(p, values[i], s->width);
+
+   s->len  = p - s->buf;
+   s->last = when;
+   s->nchanges++;
+}
+
+static int nvt_block_cmp(const void *a, const void *b)
+{
+   const nvt_block_t *l = a, *r = b;
+   if (l->signal != r->signal)
+      return (l->signal > r->signal) - (l->signal < r->signal);
+   else
+      return (l->offset > r->offset) - (l->offset < r->offset);
+}
+
+void nvt_writer_close(nvt_writer_t *w)
+{
+   for (unsigned i = 0; i < w->nstreams; i++)
+      nvt_flush_stream(w, i);
+
+   nvt_write_pad(w);
+
+   const uint64_t table_off = w->offset;
+   nvt_write_int(w, w->nstreams, 4);
+   for (unsigned i = 0; i < w->nstreams; i++) {
+      nvt_stream_t *s = &(w->streams[i]);
+      const size_t name_len = strlen(s->name) + 1;
+      const size_t type_len = strlen(s->type) + 1;
+      nvt_write_int(w, s->count, 4);
+      nvt_write_int(w, s->width, 4);
+      nvt_write_int(w, name_len, 4);
+      nvt_write_int(w, type_len, 4);
+      nvt_write(w, s->name, name_len);
+      nvt_write(w, s->type, type_len);
+   }
+
+   nvt_write_pad(w);
+
+   // Blocks for each signal are written in time order so sorting by file
+   // offset within a signal keeps them in time order
+
+   qsort(w->index, w->nblocks, sizeof(nvt_block_t), nvt_block_cmp);
+
+   const uint64_t index_off = w->offset;
+   nvt_write_int(w, w->nblocks, 8);
+   for (size_t i = 0; i < w->nblocks; i++) {
+      const nvt_block_t *b = &(w->index[i]);
+      nvt_write_int(w, b->first, 8);
+      nvt_write_int(w, b->last, 8);
+      nvt_write_int(w, b->offset, 8);
+      nvt_write_int(w, b->signal, 4);
+      nvt_write_int(w, b->csize, 4);
+      nvt_write_int(w, b->rsize, 4);
+      nvt_write_int(w, b->nchanges, 4);
+   }
+
+   nvt_write_int(w, table_off, 8);
+   nvt_write_int(w, index_off, 8);
+   nvt_write_int(w, NVT_MAGIC, 4);
+   nvt_write_int(w, NVT_VERSION, 4);
+
+   if (fclose(w->file) != 0)
+      fatal_errno("failed writing NVT output %s", w->fname);
+
+   for (unsigned i = 0; i < w->nstreams; i++) {
+      free(w->streams[i].name);
+      free(w->streams[i].type);
+      free(w->streams[i].buf);
+   }
+
+   free(w->streams);
+   free(w->index);
+   free(w->packed);
+   free(w->fname);
+   free(w);
+}
+
+static void nvt_check(nvt_reader_t *r, bool cond, const char *what)
+{
+   if (!cond)
+      fatal("%s is not a valid NVT file: %s", r->fname, what);
+}
+
+nvt_reader_t *nvt_reader_open(const char *file)
+{
+   int fd = open(file, O_RDONLY);
+   if (fd < 0)
+      return NULL;
+
+   struct stat st;
+   if (fstat(fd, &st) != 0)
+      fatal_errno("%s", file);
+
+   nvt_reader_t *r = xmalloc(sizeof(nvt_reader_t));
+   memset(r, '\0', sizeof(nvt_reader_t));
+   r->fname = xstrdup(file);
+   r->size  = st.st_size;
+
+   nvt_check(r, r->size >= 8 + NVT_TRAILER, "file too short");
+
+   r->map = map_file(fd, r->size);
+   close(fd);
+
+   const uint8_t *trailer = r->map + r->size - NVT_TRAILER;
+   nvt_check(r, nvt_get_le(r->map, 4) == NVT_MAGIC
+             && nvt_get_le(trailer + 16, 4) == NVT_MAGIC, "bad magic number");
+
+   const unsigned version = nvt_get_le(trailer + 20, 4);
+   if (version != NVT_VERSION)
+      fatal("%s was written with NVT version %u but this is version %u",
+            file, version, NVT_VERSION);
+
+   const uint64_t table_off = nvt_get_le(trailer, 8);
+   const uint64_t index_off = nvt_get_le(trailer + 8, 8);
+   nvt_check(r, table_off + 4 <= index_off
+             && index_off + 8 <= r->size - NVT_TRAILER, "bad trailer");
+
+   const uint8_t *p = r->map + table_off;
+   r->nsignals = nvt_get_le(p, 4);
+   r->signals  = xmalloc(MAX(r->nsignals, 1) * sizeof(nvt_signal_t));
+   p += 4;
+
+   for (unsigned i = 0; i < r->nsignals; i++) {
+      nvt_check(r, p + 16 <= r->map + index_off, "bad signal table");
+
+      nvt_signal_t *s = &(r->signals[i]);
+      s->count = nvt_get_le(p, 4);
+      s->width = nvt_get_le(p + 4, 4);
+
+      const size_t name_len = nvt_get_le(p + 8, 4);
+      const size_t type_len = nvt_get_le(p + 12, 4);
+      p += 16;
+
+      nvt_check(r, p + name_len + type_len <= r->map + index_off
+                && name_len > 0 && type_len > 0, "bad signal table");
+
+      s->name = (const char *)p;
+      s->type = (const char *)p + name_len;
+      s->first_block = 0;
+      s->nblocks     = 0;
+      p += name_len + type_len;
+
+      nvt_check(r, s->name[name_len - 1] == '\0'
+                && s->type[type_len - 1] == '\0', "bad signal name");
+   }
+
+   p = r->map + index_off;
+   r->nblocks = nvt_get_le(p, 8);
+   p += 8;
+
+   nvt_check(r, r->nblocks <= (r->size - index_off) / 40, "bad index");
+
+   size_t max_rsize = NVT_BLOCK_SIZE;
+   unsigned max_count = 1;
+
+   r->index = xmalloc(MAX(r->nblocks, 1) * sizeof(nvt_block_t));
+   for (size_t i = 0; i < r->nblocks; i++, p += 40) {
+      nvt_block_t *b = &(r->index[i]);
+      b->first    = nvt_get_le(p, 8);
+      b->last     = nvt_get_le(p + 8, 8);
+      b->offset   = nvt_get_le(p + 16, 8);
+      b->signal   = nvt_get_le(p + 24, 4);
+      b->csize    = nvt_get_le(p + 28, 4);
+      b->rsize    = nvt_get_le(p + 32, 4);
+      b->nchanges = nvt_get_le(p + 36, 4);
+
+      nvt_check(r, b->signal < r->nsignals
+                && b->offset + b->csize <= table_off, "bad block");
+      nvt_check(r, i == 0 || b->signal >= r->index[i - 1].signal,
+                "index not sorted");
+
+      nvt_signal_t *s = &(r->signals[b->signal]);
+      if (s->nblocks++ == 0)
+         s->first_block = i;
+
+      max_rsize = MAX(max_rsize, b->rsize);
+      max_count = MAX(max_count, s->count);
+   }
+
+   r->unpacked = xmalloc(max_rsize);
+   r->values   = xmalloc(max_count * sizeof(uint64_t));
+   r->initial  = xmalloc(max_count * sizeof(uint64_t));
+
+   return r;
+}
+
+void nvt_reader_close(nvt_reader_t *r)
+{
+   unmap_file((void *)r->map, r->size);
+
+   free(r->signals);
+   free(r->index);
+   free(r->unpacked);
+   free(r->values);
+   free(r->initial);
+   free(r->fname);
+   free(r);
+}
+
+int nvt_reader_signals(nvt_reader_t *r)
+{
+   return r->nsignals;
+}
+
+int nvt_reader_find(nvt_reader_t *r, const char *name)
+{
+   for (unsigned i = 0; i < r->nsignals; i++) {
+      if (strcmp(r->signals[i].name, name) == 0)
+         return i;
+   }
+
+   return -1;
+}
+
+const char *nvt_reader_name(nvt_reader_t *r, int signal)
+{
+   assert(signal >= 0 && signal < r->nsignals);
+   return r->signals[signal].name;
+}
+
+const char *nvt_reader_type(nvt_reader_t *r, int signal)
+{
+   assert(signal >= 0 && signal < r->nsignals);
+   return r->signals[signal].type;
+}
+
+unsigned nvt_reader_count(nvt_reader_t *r, int signal)
+{
+   assert(signal >= 0 && signal < r->nsignals);
+   return r->signals[signal].count;
+}
+
+static const uint8_t *nvt_unpack(nvt_reader_t *r, const nvt_block_t *b)
+{
+   const uint8_t *data = r->map + b->offset;
+   if (b->csize == b->rsize)
+      return data;
+
+   const int n = fastlz_decompress(data, b->csize, r->unpacked, b->rsize);
+   nvt_check(r, n == (int)b->rsize, "corrupt block");
+   return r->unpacked;
+}
+
+static const uint8_t *nvt_decode(nvt_reader_t *r, const nvt_signal_t *s,
+                                 const uint8_t *p, const uint8_t *end,
+                                 uint64_t *when)
+{
+   uint64_t delta = 0;
+   unsigned shift = 0;
+   do {
+      nvt_check(r, p < end && shift < 64, "corrupt block");
+      delta |= (uint64_t)(*p & 0x7f) << shift;
+      shift += 7;
+   } while (*p++ & 0x80);
+
+   nvt_check(r, p + s->count * s->width <= end, "corrupt block");
+
+   for (unsigned i = 0; i < s->count; i++, p += s->width)
+      r->values[i] = nvt_get_le(p, s->width);
+
+   *when += delta;
+   return p;
+}
+
+void nvt_reader_read(nvt_reader_t *r, int signal, uint64_t from,
+                     uint64_t to, nvt_change_fn_t fn, void *context)
+{
+   assert(signal >= 0 && signal < r->nsignals);
+
+   const nvt_signal_t *s = &(r->signals[signal]);
+   if (s->nblocks == 0 || from > to)
+      return;
+
+   const nvt_block_t *blocks = r->index + s->first_block;
+
+   // Find the last block starting at or before from as this contains the
+   // value in effect at that time unless from is before the first change
+
+   size_t low = 0, high = s->nblocks;
+   while (high - low > 1) {
+      const size_t mid = (low + high) / 2;
+      if (blocks[mid].first <= from)
+         low = mid;
+      else
+         high = mid;
+   }
+
+   // Records at or before from only occur in the first block visited and
+   // the last of them is held back until the first change in the window
+
+   bool have_initial = false;
+   uint64_t initial_time = 0;
+
+   for (size_t i = low; i < s->nblocks && blocks[i].first <= to; i++) {
+      const nvt_block_t *b = &(blocks[i]);
+      const uint8_t *p = nvt_unpack(r, b);
+      const uint8_t *end = p + b->rsize;
+
+      uint64_t when = 0;
+      for (uint32_t j = 0; j < b->nchanges; j++) {
+         p = nvt_decode(r, s, p, end, &when);
+
+         if (when <= from) {
+            memcpy(r->initial, r->values, s->count * sizeof(uint64_t));
+            initial_time = when;
+            have_initial = true;
+            continue;
+         }
+
+         if (have_initial) {
+            (*fn)(initial_time, r->initial, s->count, context);
+            have_initial = false;
+         }
+
+         if (when > to)
+            return;
+
+         (*fn)(when, r->values, s->count, context);
+      }
+   }
+
+   if (have_initial)
+      (*fn)(initial_time, r->initial, s->count, context);
+}
@@ -0,0 +1,61 @@
+//
+//  Copyright (C) 2018  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _NVTAPI_H
+#define _NVTAPI_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// NVT is a waveform format designed for reading a few signals over a
+// short window of time. The changes to each signal are stored in their
+// own stream split into compressed blocks and an index at the end of the
+// file gives the time range and file offset of every block. A reader
+// maps the file and only decompresses the blocks of the signals it asks
+// for which overlap the requested window.
+//
+// Each signal is a fixed number of scalar values each of which is stored
+// in 1, 2, 4 or 8 bytes. Values are passed to and from the API as an
+// array of uint64_t with one entry per scalar.
+
+typedef struct nvt_writer nvt_writer_t;
+typedef struct nvt_reader nvt_reader_t;
+
+typedef void (*nvt_change_fn_t)(uint64_t when, const uint64_t *values,
+                                unsigned count, void *context);
+
+nvt_writer_t *nvt_writer_open(const char *file);
+int nvt_writer_add(nvt_writer_t *w, const char *name, const char *type,
+                   unsigned count, unsigned width);
+void nvt_writer_change(nvt_writer_t *w, int signal, uint64_t when,
+                       const uint64_t *values);
+void nvt_writer_close(nvt_writer_t *w);
+
+nvt_reader_t *nvt_reader_open(const char *file);
+void nvt_reader_close(nvt_reader_t *r);
+int nvt_reader_signals(nvt_reader_t *r);
+int nvt_reader_find(nvt_reader_t *r, const char *name);
+const char *nvt_reader_name(nvt_reader_t *r, int signal);
+const char *nvt_reader_type(nvt_reader_t *r, int signal);
+unsigned nvt_reader_count(nvt_reader_t *r, int signal);
+
+// Calls fn first with the value in effect at time from, giving the time
+// it last changed, then for each change up to and including time to
+void nvt_reader_read(nvt_reader_t *r, int signal, uint64_t from,
+                     uint64_t to, nvt_change_fn_t fn, void *context);
+
+#endif  // _NVTAPI_H
@@ -0,0 +1,123 @@
+//
+//  Copyright (C) 2018  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "util.h"
+#include "pgo.h"
+#include "ident.h"
+#include "hash.h"
+
+#include <stdlib.h>
+#include <inttypes.h>
+
+// The profile is a text file with a header line followed by one line per
+// process giving the number of counts, the counts, and then the process
+// name which goes last as extended identifiers may contain spaces
+
+#define PGO_MAGIC   "nvc-pgo"
+#define PGO_VERSION 1
+
+typedef struct {
+   unsigned count;
+   uint64_t counts[0];
+} pgo_entry_t;
+
+struct pgo {
+   hash_t *entries;
+};
+
+void pgo_write_header(FILE *f)
+{
+   fprintf(f, "%s %d\n", PGO_MAGIC, PGO_VERSION);
+}
+
+void pgo_write(FILE *f, ident_t name, const uint64_t *counts, unsigned count)
+{
+   fprintf(f, "%u", count);
+   for (unsigned i = 0; i < count; i++)
+      fprintf(f, " %"PRIu64, counts[i]);
+   fprintf(f, " %s\n", istr(name));
+}
+
+pgo_t *pgo_read(const char *file)
+{
+   FILE *f = fopen(file, "r");
+   if (f == NULL)
+      fatal_errno("failed to open %s", file);
+
+   int version;
+   if (fscanf(f, PGO_MAGIC " %d\n", &version) != 1 || version != PGO_VERSION)
+      fatal("%s: not a profile written by this version of " PACKAGE_NAME,
+            file);
+
+   pgo_t *pgo = xmalloc(sizeof(pgo_t));
+   pgo->entries = hash_new(256, true);
+
+   LOCAL_TEXT_BUF tb = tb_new();
+   int lineno = 2;
+   unsigned count;
+   while (fscanf(f, "%u", &count) == 1) {
+      pgo_entry_t *e = xmalloc(sizeof(pgo_entry_t) + count * sizeof(uint64_t));
+      e->count = count;
+
+      for (unsigned i = 0; i < count; i++) {
+         if (fscanf(f, "%"SCNu64, &(e->counts[i])) != 1)
+            fatal("%s:%d: malformed profile", file, lineno);
+      }
+
+      if (fgetc(f) != ' ')
+         fatal("%s:%d: malformed profile", file, lineno);
+
+      tb_rewind(tb);
+
+      int ch;
+      while ((ch = fgetc(f)) != EOF && ch != '\n')
+         tb_append(tb, ch);
+
+      ident_t name = ident_new(tb_get(tb));
+      free(hash_get(pgo->entries, name));
+      hash_put(pgo->entries, name, e);
+
+      lineno++;
+   }
+
+   if (!feof(f))
+      fatal("%s:%d: malformed profile", file, lineno);
+
+   fclose(f);
+   return pgo;
+}
+
+void pgo_free(pgo_t *pgo)
+{
+   hash_iter_t it = HASH_BEGIN;
+   const void *key;
+   void *value;
+   while (hash_iter(pgo->entries, &it, &key, &value))
+      free(value);
+
+   hash_free(pgo->entries);
+   free(pgo);
+}
+
+const uint64_t *pgo_lookup(pgo_t *pgo, ident_t name, unsigned count)
+{
+   pgo_entry_t *e = hash_get(pgo->entries, name);
+   if (e == NULL || e->count != count)
+      return NULL;
+   else
+      return e->counts;
+}
@@ -0,0 +1,42 @@
+//
+//  Copyright (C) 2018  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _PGO_H
+#define _PGO_H
+
+#include "prim.h"
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Execution counts for each process of a design elaborated with
+// --pgo-collect. The first count is the number of times the process
+// function was called followed by one count per vcode block.
+
+typedef struct pgo pgo_t;
+
+void pgo_write_header(FILE *f);
+void pgo_write(FILE *f, ident_t name, const uint64_t *counts, unsigned count);
+
+pgo_t *pgo_read(const char *file);
+void pgo_free(pgo_t *pgo);
+
+// Returns NULL unless there is a profile for name with exactly count
+// entries as the code has changed since it was collected otherwise
+const uint64_t *pgo_lookup(pgo_t *pgo, ident_t name, unsigned count);
+
+#endif  // _PGO_H
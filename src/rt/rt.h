@@ -23,6 +23,12 @@
 
 #include <stdint.h>
 
+#if defined HAVE_PTHREAD && !defined __MINGW32__
+#define RT_MULTITHREAD 1
+#else
+#define RT_MULTITHREAD 0
+#endif
+
 typedef struct watch watch_t;
 
 typedef void (*sig_event_fn_t)(uint64_t now, tree_t, watch_t *, void *user);
@@ -71,6 +77,7 @@ typedef enum {
    R_IDENT    = (1 << 1),
    R_RECORD   = (1 << 2),
    R_BOUNDARY = (1 << 3),
+   R_FOLD     = (1 << 4),
 } res_flags_t;
 
 typedef enum {
@@ -81,6 +88,7 @@ typedef enum {
    NET_F_GLOBAL     = (1 << 4),
    NET_F_LAST_VALUE = (1 << 5),
    NET_F_BOUNDARY   = (1 << 6),
+   NET_F_CLOCK      = (1 << 7),
 } net_flags_t;
 
 typedef enum {
@@ -105,27 +113,50 @@ typedef enum {
    SEVERITY_FAILURE
 } rt_severity_t;
 
+typedef enum {
+   FST_PACK_ZLIB,
+   FST_PACK_FASTLZ,
+   FST_PACK_LZ4
+} fst_pack_t;
+
 typedef struct {
    loc_t  loc;
    tree_t tree;
 } jit_trace_t;
 
+#define JIT_TRACE_MAX 10
+
+typedef void *(*jit_lookup_fn_t)(const char *name);
+
 void rt_start_of_tool(tree_t top);
 void rt_end_of_tool(tree_t top);
 void rt_run_sim(uint64_t stop_time);
 void rt_run_interactive(uint64_t stop_time);
 void rt_restart(tree_t top);
+void rt_restore(const char *file);
+void rt_set_checkpoint(uint64_t when, const char *file);
+void rt_set_profile_file(const char *file);
 void rt_set_timeout_cb(uint64_t when, timeout_fn_t fn, void *user);
 watch_t *rt_set_event_cb(tree_t s, sig_event_fn_t fn, void *user,
                          bool postponed);
+watch_t *rt_set_wave_cb(tree_t s, sig_event_fn_t fn, void *user);
+watch_t *rt_set_value_watch(tree_t s);
+void rt_set_wave_window(uint64_t from, uint64_t to, bool on_assert);
+void rt_set_wave_capture(bool enable);
 void rt_set_global_cb(rt_event_t event, rt_event_fn_t fn, void *user);
 size_t rt_watch_value(watch_t *w, uint64_t *buf, size_t max, bool last);
 size_t rt_watch_string(watch_t *w, const char *map, char *buf, size_t max);
+int rt_watch_groups(watch_t *w);
+void rt_watch_group_range(watch_t *w, int group, int *first, int *length);
+int rt_watch_changes(watch_t *w, const int **changed);
+size_t rt_watch_group_string(watch_t *w, int group, const char *map,
+                             char *buf, size_t max);
 size_t rt_signal_value(tree_t s, uint64_t *buf, size_t max);
 size_t rt_signal_string(tree_t s, const char *map, char *buf, size_t max);
 bool rt_force_signal(tree_t s, const uint64_t *buf, size_t count,
                      bool propagate);
 bool rt_can_create_delta(void);
+bool rt_sandbox_call(void (*fn)(void *), void *context);
 uint64_t rt_now(unsigned *deltas);
 void rt_stop(void);
 void rt_set_exit_severity(rt_severity_t severity);
@@ -133,7 +164,13 @@ void rt_set_exit_severity(rt_severity_t severity);
 void jit_init(tree_t top);
 void jit_shutdown(void);
 void *jit_find_symbol(const char *name, bool required);
+void *jit_find_native(ident_t unit, const char *symbol);
 void jit_trace(jit_trace_t **trace, size_t *count);
+int jit_backtrace(void **frames, int max);
+void jit_trace_frames(void *const *frames, int nframes, jit_trace_t **trace,
+                      size_t *count);
+tree_t jit_find_decl(void *pc, const char **symbol);
+void jit_register(ident_t unit, jit_lookup_fn_t fn);
 
 text_buf_t *pprint(struct tree *t, const uint64_t *values, size_t len);
 
@@ -145,12 +182,36 @@ void lxt_restart(void);
 
 void fst_init(const char *file, tree_t top);
 void fst_restart(void);
+void fst_flush_stats(uint64_t *count, uint64_t *usec);
+
+void nvt_init(const char *file, tree_t top);
+void nvt_restart(void);
 
 void wave_include_glob(const char *glob);
 void wave_exclude_glob(const char *glob);
 void wave_include_file(const char *base);
+void wave_set_depth(int depth);
 bool wave_should_dump(tree_t decl);
 
+typedef struct {
+   uint64_t when;
+   bool     delta;
+   bool     stop;
+} dist_status_t;
+
+typedef void (*dist_apply_fn_t)(uint32_t gid, const void *data, uint32_t len);
+
+void dist_init(tree_t top, const char *partition, int node,
+               const char *address);
+bool dist_enabled(void);
+bool dist_owns(ident_t name);
+void dist_add_change(uint32_t gid, const void *data, uint32_t size,
+                     uint32_t count);
+dist_status_t dist_sync(dist_status_t local, dist_apply_fn_t fn);
+void dist_shutdown(void);
+
+void cosim_init(tree_t top, const char *file);
+
 #ifdef ENABLE_VHPI
 void vhpi_load_plugins(tree_t top, const char *plugins);
 #else
@@ -20,11 +20,16 @@
 #include "lib.h"
 #include "util.h"
 #include "alloc.h"
-#include "heap.h"
+#include "wheel.h"
 #include "common.h"
 #include "netdb.h"
+#include "kernel.h"
 #include "cover.h"
 #include "hash.h"
+#include "fbuf.h"
+#include "slab.h"
+#include "pgo.h"
+#include "mem.h"
 
 #include <assert.h>
 #include <stdint.h>
@@ -45,32 +50,59 @@
 #include <alloca.h>
 #endif
 
+#ifdef HAVE_EXECINFO_H
+#include <execinfo.h>
+#endif
+
 #ifdef __MINGW32__
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 #undef SEVERITY_ERROR
 #endif
 
+#if RT_MULTITHREAD
+#include <pthread.h>
+#include <unistd.h>
+#define RT_TLS __thread
+#else
+#define RT_TLS
+#endif
+
 #define TRACE_DELTAQ  1
 #define TRACE_PENDING 0
 #define RT_DEBUG      0
 
+#define BUCKET_CACHE_SZ 64
+#define PENDING_LEVELS  33
+
 typedef void (*proc_fn_t)(int32_t reset);
 typedef uint64_t (*resolution_fn_t)(void *vals, int32_t n);
 
-typedef struct netgroup   netgroup_t;
-typedef struct driver     driver_t;
 typedef struct rt_proc    rt_proc_t;
 typedef struct event      event_t;
 typedef struct waveform   waveform_t;
-typedef struct sens_list  sens_list_t;
-typedef struct value      value_t;
-typedef struct watch_list watch_list_t;
-typedef struct res_memo   res_memo_t;
 typedef struct callback   callback_t;
 typedef struct image_map  image_map_t;
 typedef struct rt_loc     rt_loc_t;
+typedef struct bucket     bucket_t;
 typedef struct size_list  size_list_t;
+typedef struct defer_op   defer_op_t;
+typedef struct defer_log  defer_log_t;
+typedef struct batch_item batch_item_t;
+typedef struct rt_clock   rt_clock_t;
+
+#define INIT_RES_CACHE_SIZE 256
+#define INIT_RES_MAX_BYTES  64
+#define RES_FOLD_CHECKS     8192
+
+typedef struct {
+   res_memo_t *memo;
+   uint16_t    n_drivers;
+   uint16_t    size;
+   uint32_t    length;
+   uint8_t     inputs[INIT_RES_MAX_BYTES];
+   uint8_t     result[INIT_RES_MAX_BYTES];
+} init_res_t;
 
 struct rt_proc {
    tree_t    source;
@@ -81,6 +113,11 @@ struct rt_proc {
    bool      postponed;
    bool      pending;
    uint64_t  usage;
+   hash_t   *drivers;
+   rt_clock_t *clock;
+   bool        native;
+   int         level;
+   bool        remote;
 };
 
 typedef enum {
@@ -89,10 +126,50 @@ typedef enum {
    E_PROCESS
 } event_kind_t;
 
+typedef enum {
+   CAPTURE_IDLE,
+   CAPTURE_ON,
+   CAPTURE_DONE
+} capture_state_t;
+
+typedef enum {
+   CAPTURE_REQ_NONE,
+   CAPTURE_REQ_START,
+   CAPTURE_REQ_STOP
+} capture_req_t;
+
+#define N_EVENT_KINDS (E_PROCESS + 1)
+
+#define STATS_HIST_BINS 32
+
+typedef struct {
+   uint64_t cycles;
+   uint64_t deltas;
+   uint64_t events[N_EVENT_KINDS];
+   uint64_t stale_events;
+   uint64_t driver_groups;
+   uint64_t res_calls;
+   uint64_t res_memo_hits;
+   uint64_t res_init_hits;
+   uint64_t native_clocks;
+   uint64_t region_procs;
+   uint64_t wave_records;
+   uint64_t wave_stalls;
+   uint64_t batches;
+   uint64_t batch_procs;
+   uint64_t worker_procs;
+   size_t   peak_eventq;
+   size_t   peak_run_queue;
+   uint64_t events_per_cycle[STATS_HIST_BINS];
+   uint64_t deltas_per_step[STATS_HIST_BINS];
+} rt_stats_t;
+
 struct event {
    uint64_t      when;
    event_kind_t  kind;
    uint32_t      wakeup_gen;
+   int32_t       driver;
+   uint32_t      ngroups;
    event_t      *delta_chain;
    rt_proc_t    *proc;
    netgroup_t   *group;
@@ -100,6 +177,13 @@ struct event {
    void         *timeout_user;
 };
 
+struct bucket {
+   uint64_t   when;
+   event_t   *head[N_EVENT_KINDS];
+   event_t  **tail[N_EVENT_KINDS];
+   bucket_t  *next;
+};
+
 struct waveform {
    uint64_t    when;
    waveform_t *next;
@@ -128,24 +212,6 @@ struct value {
    };
 } __attribute__((aligned(8)));
 
-struct netgroup {
-   netid_t       first;
-   uint32_t      length;
-   net_flags_t   flags;
-   void         *resolved;
-   void         *last_value;
-   value_t      *forcing;
-   uint16_t      size;
-   uint16_t      n_drivers;
-   driver_t     *drivers;
-   res_memo_t   *resolution;
-   uint64_t      last_event;
-   tree_t        sig_decl;
-   value_t      *free_values;
-   sens_list_t  *pending;
-   watch_list_t *watching;
-};
-
 struct uarray {
    void    *ptr;
    struct {
@@ -169,14 +235,22 @@ struct watch {
    watch_t       *chain_pending;
    netgroup_t   **groups;
    int            n_groups;
+   int           *first;
+   int           *changed;
+   int            n_changed;
+   bool          *is_changed;
    void          *user_data;
    range_kind_t   dir;
    size_t         length;
+   size_t         nbytes;
    bool           postponed;
+   bool           deferred;
+   bool           wave;
 };
 
 struct watch_list {
    watch_t      *watch;
+   int           index;
    watch_list_t *next;
 };
 
@@ -185,6 +259,7 @@ struct res_memo {
    res_flags_t     flags;
    int8_t          tab2[16][16];
    int8_t          tab1[16];
+   unsigned        fold_max;
 };
 
 typedef enum {
@@ -222,21 +297,73 @@ struct size_list {
    uint32_t flags;
 };
 
+typedef enum {
+   DEFER_SCHED_PROCESS,
+   DEFER_SCHED_WAVEFORM_S,
+   DEFER_SCHED_WAVEFORM,
+   DEFER_SCHED_EVENT,
+   DEFER_ASSERT_FAIL,
+   DEFER_FILE_WRITE,
+   DEFER_FILE_CLOSE,
+   DEFER_ENV_STOP,
+   DEFER_TRACE,
+   DEFER_FATAL,
+   DEFER_NOP
+} defer_kind_t;
+
+struct defer_op {
+   defer_kind_t  kind;
+   uint32_t      length;
+   const void   *ptr;
+   int64_t       args[4];
+   uint8_t       data[0];
+} __attribute__((aligned(8)));
+
+struct defer_log {
+   uint8_t *buf;
+   size_t   len;
+   size_t   alloc;
+};
+
+struct batch_item {
+   rt_proc_t   *proc;
+   sens_list_t *entry;
+   event_t     *event;
+   defer_log_t *log;
+   size_t       log_start;
+   size_t       log_end;
+};
+
 static struct rt_proc   *procs = NULL;
-static struct rt_proc   *active_proc = NULL;
 static struct run_queue  run_queue;
 
-static heap_t        eventq_heap = NULL;
+static RT_TLS rt_proc_t   *active_proc = NULL;
+static RT_TLS void        *proc_tmp_stack = NULL;
+static RT_TLS defer_log_t *defer_log = NULL;
+static RT_TLS batch_item_t *active_item = NULL;
+static RT_TLS bool         is_worker = false;
+
+static cover_mode_t cover_mode = COVER_NONE;
+static int          cover_nstmts = 0;
+static int          cover_nconds = 0;
+static int32_t    **cover_shards = NULL;
+static int          n_cover_shards = 0;
+static size_t       cover_shardsz = 0;
+
+static wheel_t       eventq_wheel = NULL;
+static bucket_t     *bucket_cache[BUCKET_CACHE_SZ];
 static size_t        n_procs = 0;
-static uint64_t      now = 0;
+uint64_t             now = 0;
 static int           iteration = -1;
 static bool          trace_on = false;
 static nvc_rusage_t  ready_rusage;
 static jmp_buf       fatal_jmp;
 static bool          aborted = false;
-static netdb_t      *netdb = NULL;
-static netgroup_t   *groups = NULL;
-static sens_list_t  *pending = NULL;
+netdb_t             *netdb = NULL;
+netgroup_t          *groups = NULL;
+netgroup_cold_t     *groups_cold = NULL;
+static sens_list_t **pending[PENDING_LEVELS];
+static uint64_t      pending_levels = 0;
 static sens_list_t  *resume = NULL;
 static sens_list_t  *postponed = NULL;
 static watch_t      *watches = NULL;
@@ -244,42 +371,135 @@ static watch_t      *callbacks = NULL;
 static event_t      *delta_proc = NULL;
 static event_t      *delta_driver = NULL;
 static void         *global_tmp_stack = NULL;
-static void         *proc_tmp_stack = NULL;
 static uint32_t      global_tmp_alloc;
+static void         *tmp_stack_pool = NULL;
+static unsigned      tmp_stacks_mapped = 0;
+static unsigned      tmp_stacks_reused = 0;
 static hash_t       *res_memo_hash = NULL;
 static side_effect_t init_side_effect = SIDE_EFFECT_ALLOW;
+static jmp_buf      *sandbox_jmp = NULL;
 static bool          force_stop;
 static bool          can_create_delta;
 static callback_t   *global_cbs[RT_LAST_EVENT];
+static bool          clocks_enabled = false;
+static bool          clock_start_pending = false;
+static bool          cycle_based = false;
+static sens_list_t **region = NULL;
+static int           n_levels = 0;
+static bool          region_running = false;
+static event_t      *region_driver = NULL;
 static rt_severity_t exit_severity = SEVERITY_ERROR;
+static uint64_t      capture_from = 0;
+static uint64_t      capture_to = UINT64_MAX;
+static bool          capture_on_assert = false;
+static capture_state_t capture_state = CAPTURE_IDLE;
+static capture_req_t   capture_req = CAPTURE_REQ_NONE;
 static hash_t       *decl_hash = NULL;
 static bool          profiling = false;
+static rt_stats_t    stats;
+static init_res_t   *init_res_cache = NULL;
 
 static rt_alloc_stack_t event_stack = NULL;
 static rt_alloc_stack_t waveform_stack = NULL;
 static rt_alloc_stack_t sens_list_stack = NULL;
 static rt_alloc_stack_t watch_stack = NULL;
 static rt_alloc_stack_t callback_stack = NULL;
+static rt_alloc_stack_t bucket_stack = NULL;
 
 static netgroup_t **active_groups;
 static unsigned     n_active_groups = 0;
 static unsigned     n_active_alloc = 0;
 
+static batch_item_t *batch = NULL;
+static size_t        batch_len = 0;
+static size_t        batch_alloc = 0;
+static size_t        batch_next = 0;
+static bool          replaying = false;
+static defer_log_t   main_log;
+
+#if RT_MULTITHREAD
+typedef struct {
+   pthread_t   thread;
+   defer_log_t log;
+   uint64_t    procs;
+} rt_worker_t;
+
+static rt_worker_t     *workers = NULL;
+static int              n_workers = 0;
+static unsigned         batch_gen = 0;
+static int              batch_finished = 0;
+static bool             batch_parallel = false;
+static bool             workers_exit = false;
+static pthread_mutex_t  batch_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   batch_start_cv = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t   batch_done_cv = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t   halt_cv = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t  guard_lock = PTHREAD_MUTEX_INITIALIZER;
+#else
+static const int        n_workers = 0;
+#endif
+
+#if RT_MULTITHREAD
+#define WAVE_RING_SIZE  (4 * 1024 * 1024)
+#define WAVE_BATCH_SIZE (64 * 1024)
+
+typedef struct {
+   uint64_t  when;
+   watch_t  *watch;
+   uint32_t  size;
+   uint32_t  n_changed;
+} wave_record_t;
+
+static char             *wave_ring = NULL;
+static size_t            wave_pos = 0;
+static size_t            wave_wr = 0;
+static size_t            wave_rd = 0;
+static bool              wave_full = false;
+static bool              wave_exit = false;
+static bool              wave_running = false;
+static bool              wave_deferred = false;
+static pthread_t         wave_thread;
+static pthread_mutex_t   wave_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t    wave_data_cv = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t    wave_space_cv = PTHREAD_COND_INITIALIZER;
+#else
+static const bool        wave_deferred = false;
+#endif
+
+static RT_TLS const char *wave_values = NULL;
+static RT_TLS const int  *wave_changed = NULL;
+static RT_TLS int         wave_n_changed = 0;
+
 static void deltaq_insert_proc(uint64_t delta, rt_proc_t *wake);
 static void deltaq_insert_driver(uint64_t delta, netgroup_t *group,
-                                 rt_proc_t *driver);
-static bool rt_sched_driver(netgroup_t *group, uint64_t after,
+                                 unsigned ngroups, rt_proc_t *proc,
+                                 int driver);
+static bool rt_sched_driver(netgroup_t *group, int driver, uint64_t after,
                             uint64_t reject, value_t *values);
+static int rt_driver_index(netgroup_t *group, rt_proc_t *proc);
+static sens_list_t **rt_pending_list(netid_t first, netid_t last);
 static void rt_sched_event(sens_list_t **list, netid_t first, netid_t last,
                            rt_proc_t *proc, bool is_static);
 static void *rt_tmp_alloc(size_t sz);
 static value_t *rt_alloc_value(netgroup_t *g);
 static tree_t rt_recall_decl(const char *name);
 static res_memo_t *rt_memo_resolution_fn(type_t type, resolution_fn_t fn);
+static rt_clock_t *rt_clock_detect(rt_proc_t *proc);
+static void rt_clock_observe(rt_clock_t *c);
+static void rt_clock_tick(netgroup_t *group, rt_clock_t *c);
+static void rt_clock_step(rt_clock_t *c);
 static void _tracef(const char *fmt, ...);
+static defer_op_t *rt_defer(defer_kind_t kind, const void *ptr, size_t length);
+static void rt_defer_flush_files(void);
+static void rt_batch_halt(void) __attribute__((noreturn));
+static void rt_fatal(const rt_loc_t *where, const char *fmt, ...)
+   __attribute__((format(printf, 2, 3), noreturn));
+static void rt_replay_deferred(const batch_item_t *item);
 
 #define GLOBAL_TMP_STACK_SZ (1024 * 1024)
 #define PROC_TMP_STACK_SZ   (64 * 1024)
+#define MEM_CHECK_CYCLES    4096
+#define MAX_INT_IMAGE       20
 
 #if RT_DEBUG
 #define RT_ASSERT(x) assert((x))
@@ -315,14 +535,15 @@ static const char *fmt_group(const netgroup_t *g)
    const char *eptr = buf + BUF_LEN;
    char *p = buf;
 
-   p += checked_sprintf(p, eptr - p, "%s", istr(tree_ident(g->sig_decl)));
+   tree_t decl = rt_group_cold(g)->sig_decl;
+   p += checked_sprintf(p, eptr - p, "%s", istr(tree_ident(decl)));
 
-   groupid_t sig_group0 = netdb_lookup(netdb, tree_net(g->sig_decl, 0));
+   groupid_t sig_group0 = netdb_lookup(netdb, tree_net(decl, 0));
    netid_t sig_net0 = groups[sig_group0].first;
    int offset = g->first - sig_net0;
 
    const int length = g->length;
-   type_t type = tree_type(g->sig_decl);
+   type_t type = tree_type(decl);
    while (type_is_array(type)) {
       const int stride = type_width(type_elem(type));
       const int ndims = array_dimension(type);
@@ -372,11 +593,9 @@ static const char *fmt_values(const void *values, int length)
    return vbuf;
 }
 
-static inline uint64_t heap_key(uint64_t when, event_kind_t kind)
+static inline unsigned bucket_cache_slot(uint64_t when)
 {
-   // Use the bottom bit of the key to indicate the kind
-   // The highest priority should have the lowest enumeration value
-   return (when << 2) | (kind & 3);
+   return (when * UINT64_C(0x9e3779b97f4a7c15)) >> 58;
 }
 
 static void from_rt_loc(const rt_loc_t *rt, loc_t *loc)
@@ -390,11 +609,11 @@ static void from_rt_loc(const rt_loc_t *rt, loc_t *loc)
    loc->linebuf = NULL;
 }
 
-static void rt_show_trace(void)
+static void rt_print_trace(void *const *frames, int nframes)
 {
    jit_trace_t *trace;
    size_t count;
-   jit_trace(&trace, &count);
+   jit_trace_frames(frames, nframes, &trace, &count);
 
    for (size_t i = 0; i < count; i++)
       note_at(&(trace[i].loc), "in subprogram %s",
@@ -403,15 +622,99 @@ static void rt_show_trace(void)
    free(trace);
 }
 
+static void rt_show_trace(void)
+{
+   if (replaying)
+      return;   // Original stack is gone
+
+   void *frames[JIT_TRACE_MAX];
+   const int nframes = jit_backtrace(frames, JIT_TRACE_MAX);
+
+   if (unlikely(defer_log != NULL)) {
+      // Looking up the symbols is not thread safe so only the return
+      // addresses are saved until the log is replayed
+      defer_op_t *op = rt_defer(DEFER_TRACE, NULL, nframes * sizeof(void *));
+      memcpy(op->data, frames, nframes * sizeof(void *));
+      return;
+   }
+
+   rt_print_trace(frames, nframes);
+}
+
+static void rt_fatal(const rt_loc_t *where, const char *fmt, ...)
+{
+   // Runtime errors in a process on a worker thread are deferred so
+   // earlier processes in serial order have their effects first
+
+   va_list ap;
+   va_start(ap, fmt);
+   char *msg LOCAL = xvasprintf(fmt, ap);
+   va_end(ap);
+
+   if (unlikely(defer_log != NULL)) {
+      const size_t len = strlen(msg) + 1;
+      defer_op_t *op = rt_defer(DEFER_FATAL, NULL, sizeof(rt_loc_t) + len);
+      op->args[0] = (where != NULL);
+      if (where != NULL)
+         memcpy(op->data, where, sizeof(rt_loc_t));
+      memcpy(op->data + sizeof(rt_loc_t), msg, len);
+      rt_batch_halt();
+   }
+   else if (where != NULL) {
+      loc_t loc;
+      from_rt_loc(where, &loc);
+      fatal_at(&loc, "%s", msg);
+   }
+   else
+      fatal("%s", msg);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Runtime support functions
 
-DLLEXPORT void     *_tmp_stack;
-DLLEXPORT uint32_t  _tmp_alloc;
+DLLEXPORT RT_TLS void     *_tmp_stack;
+DLLEXPORT RT_TLS uint32_t  _tmp_alloc;
+
+// Code compiled in memory with --jit cannot link against thread local
+// variables so it finds the temporary stack through these
+DLLEXPORT
+void **_tmp_stack_ptr(void)
+{
+   return &_tmp_stack;
+}
+
+DLLEXPORT
+uint32_t *_tmp_alloc_ptr(void)
+{
+   return &_tmp_alloc;
+}
+
+// Statement and condition counts with --cover go to a separate shard
+// for each kernel thread
+DLLEXPORT RT_TLS int32_t *_cover_stmts;
+DLLEXPORT RT_TLS int32_t *_cover_conds;
+
+DLLEXPORT
+int32_t **_cover_stmts_ptr(void)
+{
+   return &_cover_stmts;
+}
+
+DLLEXPORT
+int32_t **_cover_conds_ptr(void)
+{
+   return &_cover_conds;
+}
 
 DLLEXPORT
 void _sched_process(int64_t delay)
 {
+   if (unlikely(defer_log != NULL)) {
+      defer_op_t *op = rt_defer(DEFER_SCHED_PROCESS, NULL, 0);
+      op->args[0] = delay;
+      return;
+   }
+
    TRACE("_sched_process delay=%s", fmt_time(delay));
    deltaq_insert_proc(delay, active_proc);
 }
@@ -422,6 +725,14 @@ void _sched_waveform_s(void *_nids, uint64_t scalar,
 {
    const int32_t *nids = _nids;
 
+   if (unlikely(defer_log != NULL)) {
+      defer_op_t *op = rt_defer(DEFER_SCHED_WAVEFORM_S, _nids, 0);
+      op->args[0] = scalar;
+      op->args[1] = after;
+      op->args[2] = reject;
+      return;
+   }
+
    TRACE("_sched_waveform_s %s value=%08x after=%s reject=%s",
          fmt_net(nids[0]), scalar, fmt_time(after), fmt_time(reject));
 
@@ -436,8 +747,9 @@ void _sched_waveform_s(void *_nids, uint64_t scalar,
       value_t *values_copy = rt_alloc_value(g);
       values_copy->qwords[0] = scalar;
 
-      if (!rt_sched_driver(g, after, reject, values_copy))
-         deltaq_insert_driver(after, g, active_proc);
+      const int driver = rt_driver_index(g, active_proc);
+      if (!rt_sched_driver(g, driver, after, reject, values_copy))
+         deltaq_insert_driver(after, g, 1, active_proc, driver);
    }
 }
 
@@ -447,6 +759,27 @@ void _sched_waveform(void *_nids, void *values, int32_t n,
 {
    const int32_t *nids = _nids;
 
+   if (unlikely(defer_log != NULL)) {
+      size_t bytes = 0;
+      for (int offset = 0; offset < n;) {
+         const netid_t nid = nids[offset];
+         if (likely(nid != NETID_INVALID)) {
+            netgroup_t *g = &(groups[netdb_lookup(netdb, nid)]);
+            bytes += g->size * g->length;
+            offset += g->length;
+         }
+         else
+            offset++;
+      }
+
+      defer_op_t *op = rt_defer(DEFER_SCHED_WAVEFORM, _nids, bytes);
+      op->args[0] = n;
+      op->args[1] = after;
+      op->args[2] = reject;
+      memcpy(op->data, values, bytes);
+      return;
+   }
+
    TRACE("_sched_waveform %s values=%s n=%d after=%s reject=%s",
          fmt_net(nids[0]),
          fmt_values(values, n * groups[netdb_lookup(netdb, nids[0])].size),
@@ -456,6 +789,13 @@ void _sched_waveform(void *_nids, void *values, int32_t n,
       fatal("postponed process %s cannot cause a delta cycle",
             istr(tree_ident(active_proc->source)));
 
+   // Adjacent groups that need a new driver event are covered by a single
+   // event for the whole run rather than one per group
+
+   netgroup_t *run_first = NULL, *run_last = NULL;
+   unsigned run_len = 0;
+   int run_driver = 0;
+
    const uint8_t *vp = values;
    int offset = 0;
    while (offset < n) {
@@ -466,8 +806,23 @@ void _sched_waveform(void *_nids, void *values, int32_t n,
          value_t *values_copy = rt_alloc_value(g);
          memcpy(values_copy->data, vp, g->size * g->length);
 
-         if (!rt_sched_driver(g, after, reject, values_copy))
-            deltaq_insert_driver(after, g, active_proc);
+         const int driver = rt_driver_index(g, active_proc);
+         if (!rt_sched_driver(g, driver, after, reject, values_copy)) {
+            if (run_first != NULL
+                && run_last->first + run_last->length == g->first) {
+               run_last = g;
+               run_len++;
+            }
+            else {
+               if (run_first != NULL)
+                  deltaq_insert_driver(after, run_first, run_len,
+                                       active_proc, run_driver);
+
+               run_first = run_last = g;
+               run_len = 1;
+               run_driver = driver;
+            }
+         }
 
          vp += g->size * g->length;
          offset += g->length;
@@ -476,6 +831,9 @@ void _sched_waveform(void *_nids, void *values, int32_t n,
          offset++;
    }
 
+   if (run_first != NULL)
+      deltaq_insert_driver(after, run_first, run_len, active_proc, run_driver);
+
    RT_ASSERT(offset == n);
 }
 
@@ -484,6 +842,13 @@ void _sched_event(void *_nids, int32_t n, int32_t flags)
 {
    const int32_t *nids = _nids;
 
+   if (unlikely(defer_log != NULL)) {
+      defer_op_t *op = rt_defer(DEFER_SCHED_EVENT, _nids, 0);
+      op->args[0] = n;
+      op->args[1] = flags;
+      return;
+   }
+
    TRACE("_sched_event %s n=%d flags=%d proc %s", fmt_net(nids[0]), n,
          flags, istr(tree_ident(active_proc->source)));
 
@@ -496,8 +861,9 @@ void _sched_event(void *_nids, int32_t n, int32_t flags)
    else {
       const bool global = !!(flags & SCHED_SEQUENTIAL);
       if (global) {
-         // Place on the global pending list
-         rt_sched_event(&pending, nids[0], nids[n - 1], active_proc,
+         // Place on the global pending index
+         rt_sched_event(rt_pending_list(nids[0], nids[n - 1]),
+                        nids[0], nids[n - 1], active_proc,
                         flags & SCHED_STATIC);
       }
 
@@ -536,17 +902,15 @@ void _alloc_driver(const int32_t *all_nets, int32_t all_length,
       netgroup_t *g = &(groups[netdb_lookup(netdb, driven_nets[offset])]);
       offset += g->length;
 
-      // Try to find this process in the list of existing drivers
-      int driver;
-      for (driver = 0; driver < g->n_drivers; driver++) {
-         if (likely(g->drivers[driver].proc == active_proc))
-            break;
-      }
+      if (active_proc->drivers == NULL)
+         active_proc->drivers = hash_new(16, true);
 
       // Allocate memory for drivers on demand
-      if (driver == g->n_drivers) {
+      if (hash_get(active_proc->drivers, g) == NULL) {
+         const int driver = g->n_drivers;
          if ((g->n_drivers == 1) && (g->resolution == NULL))
-            fatal_at(tree_loc(g->sig_decl), "group %s has multiple drivers "
+            fatal_at(tree_loc(rt_group_cold(g)->sig_decl),
+                     "group %s has multiple drivers "
                      "but no resolution function", fmt_group(g));
 
          const size_t driver_sz = sizeof(struct driver);
@@ -561,6 +925,10 @@ void _alloc_driver(const int32_t *all_nets, int32_t all_length,
          driver_t *d = &(g->drivers[driver]);
          d->proc = active_proc;
 
+         // Store the index biased by one so it cannot be mistaken for a
+         // missing entry
+         hash_put(active_proc->drivers, g, (void *)(uintptr_t)(driver + 1));
+
          const void *src = (init == NULL) ? g->resolved : initp;
 
          // Assign the initial value of the driver
@@ -577,6 +945,53 @@ void _alloc_driver(const int32_t *all_nets, int32_t all_length,
    }
 }
 
+static void *rt_tmp_stack_get(const char *tag)
+{
+   // Temporary stacks are recycled through a free list threaded through
+   // the first word of each stack as the compiled code cannot grow a
+   // stack which has live allocations
+
+#if RT_MULTITHREAD
+   const bool locked = (n_workers > 0);
+   if (locked)
+      pthread_mutex_lock(&guard_lock);
+#endif
+
+   void *stack = tmp_stack_pool;
+   if (stack != NULL) {
+      tmp_stack_pool = *(void **)stack;
+      tmp_stacks_reused++;
+   }
+   else {
+      stack = mmap_guarded(PROC_TMP_STACK_SZ, tag);
+      tmp_stacks_mapped++;
+   }
+
+#if RT_MULTITHREAD
+   if (locked)
+      pthread_mutex_unlock(&guard_lock);
+#endif
+
+   return stack;
+}
+
+static void rt_tmp_stack_put(void *stack)
+{
+#if RT_MULTITHREAD
+   const bool locked = (n_workers > 0);
+   if (locked)
+      pthread_mutex_lock(&guard_lock);
+#endif
+
+   *(void **)stack = tmp_stack_pool;
+   tmp_stack_pool = stack;
+
+#if RT_MULTITHREAD
+   if (locked)
+      pthread_mutex_unlock(&guard_lock);
+#endif
+}
+
 DLLEXPORT
 void _private_stack(void)
 {
@@ -585,9 +1000,7 @@ void _private_stack(void)
 
    if (active_proc->tmp_stack == NULL && _tmp_alloc > 0) {
       active_proc->tmp_stack = _tmp_stack;
-
-      proc_tmp_stack = mmap_guarded(PROC_TMP_STACK_SZ,
-                                    istr(tree_ident(active_proc->source)));
+      proc_tmp_stack = rt_tmp_stack_get(istr(tree_ident(active_proc->source)));
    }
 
    active_proc->tmp_alloc = _tmp_alloc;
@@ -602,6 +1015,18 @@ void *_resolved_address(int32_t nid)
    return g->resolved;
 }
 
+static void rt_alloc_last_value(netgroup_t *g)
+{
+   // Groups share the resolved value for 'LAST_VALUE until a reference
+   // to the attribute needs a separate copy
+
+   if (g->resolved != NULL && g->last_value == g->resolved) {
+      const size_t nbytes = g->length * g->size;
+      g->last_value = xmalloc(nbytes);
+      memcpy(g->last_value, g->resolved, nbytes);
+   }
+}
+
 DLLEXPORT
 void _needs_last_value(const int32_t *nids, int32_t n)
 {
@@ -611,32 +1036,21 @@ void _needs_last_value(const int32_t *nids, int32_t n)
    while (offset < n) {
       netgroup_t *g = &(groups[netdb_lookup(netdb, nids[offset])]);
       g->flags |= NET_F_LAST_VALUE;
+      rt_alloc_last_value(g);
 
       offset += g->length;
    }
 }
 
-DLLEXPORT
-void _set_initial(int32_t nid, const uint8_t *values,
-                  const size_list_t *size_list, int32_t nparts,
-                  const char *name)
+static void rt_set_initial(int32_t nid, uint8_t *res_mem,
+                           const size_list_t *size_list, int32_t nparts,
+                           tree_t decl)
 {
-   tree_t decl = rt_recall_decl(name);
-   RT_ASSERT(tree_kind(decl) == T_SIGNAL_DECL);
-
-   TRACE("_set_initial %s values=%s nparts=%d", name,
-         fmt_values(values, size_list[0].count * size_list[0].size), nparts);
-
-   int total_size = 0;
-   for (int i = 0; i < nparts; i++)
-      total_size += size_list[i].size * size_list[i].count;
-
-   uint8_t *res_mem  = xmalloc(total_size * 2);
-   uint8_t *last_mem = res_mem + total_size;
+   // The initial value has already been written to res_mem so each
+   // group covering the signal just points into it
 
    type_t type = tree_type(decl);
 
-   const uint8_t *src = values;
    int offset = 0, part = 0, remain = size_list[0].count;
    while (part < nparts) {
       groupid_t gid = netdb_lookup(netdb, nid + offset);
@@ -644,7 +1058,7 @@ void _set_initial(int32_t nid, const uint8_t *values,
 
       const int size = size_list[part].size;
 
-      RT_ASSERT(g->sig_decl == NULL);
+      RT_ASSERT(rt_group_cold(g)->sig_decl == NULL);
       RT_ASSERT(remain >= g->length);
 
       res_memo_t *memo = NULL;
@@ -656,25 +1070,22 @@ void _set_initial(int32_t nid, const uint8_t *values,
             g->flags |= NET_F_BOUNDARY;
       }
 
-      g->sig_decl   = decl;
+      rt_group_cold(g)->sig_decl = decl;
+
       g->resolution = memo;
       g->size       = size;
       g->resolved   = res_mem;
-      g->last_value = last_mem;
+      g->last_value = res_mem;
 
       if (offset == 0)
          g->flags |= NET_F_OWNS_MEM;
 
-      const int nbytes = g->length * size;
-
-      res_mem += nbytes;
-      last_mem += nbytes;
+      res_mem += g->length * size;
 
-      memcpy(g->resolved, src, nbytes);
-      memcpy(g->last_value, src, nbytes);
+      if (g->flags & NET_F_LAST_VALUE)
+         rt_alloc_last_value(g);
 
       offset += g->length;
-      src    += nbytes;
       remain -= g->length;
 
       if (remain == 0) {
@@ -684,6 +1095,27 @@ void _set_initial(int32_t nid, const uint8_t *values,
    }
 }
 
+DLLEXPORT
+void _set_initial(int32_t nid, const uint8_t *values,
+                  const size_list_t *size_list, int32_t nparts,
+                  const char *name)
+{
+   tree_t decl = rt_recall_decl(name);
+   RT_ASSERT(tree_kind(decl) == T_SIGNAL_DECL);
+
+   TRACE("_set_initial %s values=%s nparts=%d", name,
+         fmt_values(values, size_list[0].count * size_list[0].size), nparts);
+
+   int total_size = 0;
+   for (int i = 0; i < nparts; i++)
+      total_size += size_list[i].size * size_list[i].count;
+
+   uint8_t *res_mem = xmalloc(total_size);
+   memcpy(res_mem, values, total_size);
+
+   rt_set_initial(nid, res_mem, size_list, nparts, decl);
+}
+
 DLLEXPORT
 void _set_initial_1(int32_t nid, const uint8_t *values, uint32_t size,
                     uint32_t count, void *resolution, const char *name)
@@ -698,6 +1130,45 @@ void _set_initial_1(int32_t nid, const uint8_t *values, uint32_t size,
    _set_initial(nid, values, &size_list, 1, name);
 }
 
+DLLEXPORT
+void _set_initial_fill(int32_t nid, int64_t value, uint32_t size,
+                       uint32_t count, void *resolution, const char *name)
+{
+   // Every element of the signal has the same initial value
+
+   tree_t decl = rt_recall_decl(name);
+   RT_ASSERT(tree_kind(decl) == T_SIGNAL_DECL);
+
+   TRACE("_set_initial_fill %s value=%"PRIi64" count=%u", name,
+         value, count);
+
+   const size_t total_size = size * count;
+   uint8_t *res_mem = xmalloc(total_size);
+
+   if (size == 1)
+      memset(res_mem, value, count);
+   else if (count > 0) {
+#define INITIAL_FILL(type) do {                 \
+         const type v = value;                  \
+         memcpy(res_mem, &v, sizeof(type));     \
+      } while (0)
+
+      FOR_ALL_SIZES(size, INITIAL_FILL);
+
+      for (size_t done = size; done < total_size; done *= 2)
+         memcpy(res_mem + done, res_mem, MIN(done, total_size - done));
+   }
+
+   const size_list_t size_list = {
+      .size       = size,
+      .count      = count,
+      .resolution = resolution,
+      .flags      = 0
+   };
+
+   rt_set_initial(nid, res_mem, &size_list, 1, decl);
+}
+
 DLLEXPORT
 void _assert_fail(const uint8_t *msg, int32_t msg_len, int8_t severity,
                   int8_t is_report, const rt_loc_t *where)
@@ -715,13 +1186,35 @@ void _assert_fail(const uint8_t *msg, int32_t msg_len, int8_t severity,
       "Note", "Warning", "Error", "Failure"
    };
 
+   if (unlikely(sandbox_jmp != NULL))
+      longjmp(*sandbox_jmp, 1);
+
    if (init_side_effect != SIDE_EFFECT_ALLOW) {
       init_side_effect = SIDE_EFFECT_OCCURRED;
       return;
    }
 
+   if (unlikely(defer_log != NULL)) {
+      rt_show_trace();
+
+      // The location is allocated on the caller's stack
+      defer_op_t *op = rt_defer(DEFER_ASSERT_FAIL, NULL,
+                                sizeof(rt_loc_t) + msg_len);
+      op->args[0] = severity;
+      op->args[1] = is_report;
+      memcpy(op->data, where, sizeof(rt_loc_t));
+      memcpy(op->data + sizeof(rt_loc_t), msg, msg_len);
+
+      if (severity >= exit_severity)
+         rt_batch_halt();
+      return;
+   }
+
    rt_show_trace();
 
+   if (unlikely(capture_on_assert) && !is_report)
+      rt_set_wave_capture(true);
+
    loc_t loc;
    from_rt_loc(where, &loc);
 
@@ -750,10 +1243,10 @@ DLLEXPORT
 void _bounds_fail(int32_t value, int32_t min, int32_t max, int32_t kind,
                   rt_loc_t *where, const char *hint)
 {
-   rt_show_trace();
+   if (unlikely(sandbox_jmp != NULL))
+      longjmp(*sandbox_jmp, 1);
 
-   loc_t loc;
-   from_rt_loc(where, &loc);
+   rt_show_trace();
 
    char *copy LOCAL = xstrdup(hint ?: "");
    const char *prefix = copy, *suffix = copy;
@@ -767,41 +1260,41 @@ void _bounds_fail(int32_t value, int32_t min, int32_t max, int32_t kind,
 
    switch ((bounds_kind_t)kind) {
    case BOUNDS_ARRAY_TO:
-      fatal_at(&loc, "array index %d outside bounds %d to %d%s%s",
+      rt_fatal(where, "array index %d outside bounds %d to %d%s%s",
                value, min, max, spacer, suffix);
       break;
    case BOUNDS_ARRAY_DOWNTO:
-      fatal_at(&loc, "array index %d outside bounds %d downto %d%s%s",
+      rt_fatal(where, "array index %d outside bounds %d downto %d%s%s",
                value, max, min, spacer, suffix);
       break;
 
    case BOUNDS_ENUM:
-      fatal_at(&loc, "value %d outside %s bounds %d to %d%s%s",
+      rt_fatal(where, "value %d outside %s bounds %d to %d%s%s",
                value, prefix, min, max, spacer, suffix);
       break;
 
    case BOUNDS_TYPE_TO:
-      fatal_at(&loc, "value %d outside bounds %d to %d%s%s",
+      rt_fatal(where, "value %d outside bounds %d to %d%s%s",
                value, min, max, spacer, suffix);
       break;
 
    case BOUNDS_TYPE_DOWNTO:
-      fatal_at(&loc, "value %d outside bounds %d downto %d%s%s",
+      rt_fatal(where, "value %d outside bounds %d downto %d%s%s",
                value, max, min, spacer, suffix);
       break;
 
    case BOUNDS_ARRAY_SIZE:
-      fatal_at(&loc, "length of target %d does not match length of value "
+      rt_fatal(where, "length of target %d does not match length of value "
                "%d%s%s", min, max, spacer, suffix);
       break;
 
    case BOUNDS_INDEX_TO:
-      fatal_at(&loc, "index %d violates constraint bounds %d to %d",
+      rt_fatal(where, "index %d violates constraint bounds %d to %d",
                value, min, max);
       break;
 
    case BOUNDS_INDEX_DOWNTO:
-      fatal_at(&loc, "index %d violates constraint bounds %d downto %d",
+      rt_fatal(where, "index %d violates constraint bounds %d downto %d",
                value, max, min);
       break;
    }
@@ -817,7 +1310,6 @@ int64_t _value_attr(const uint8_t *raw_str, int32_t str_len,
    while (p < endp && isspace((int)*p))
       ++p;
 
-   loc_t loc = LOC_INVALID;
    int64_t value = INT64_MIN;
 
    switch (map->kind) {
@@ -825,6 +1317,7 @@ int64_t _value_attr(const uint8_t *raw_str, int32_t str_len,
       {
          bool is_negative = p < endp && *p == '-';
          int num_digits = 0;
+         value = 0;
 
          if (is_negative) {
             ++p;
@@ -842,21 +1335,18 @@ int64_t _value_attr(const uint8_t *raw_str, int32_t str_len,
          }
 
          if (num_digits == 0) {
-            from_rt_loc(where, &loc);
-            fatal_at(&loc, "invalid integer value "
+            rt_fatal(where, "invalid integer value "
                      "\"%.*s\"", str_len, (const char *)raw_str);
          }
       }
       break;
 
    case IMAGE_REAL:
-      from_rt_loc(where, &loc);
-      fatal_at(&loc, "real values not yet supported in 'VALUE");
+      rt_fatal(where, "real values not yet supported in 'VALUE");
       break;
 
    case IMAGE_PHYSICAL:
-      from_rt_loc(where, &loc);
-      fatal_at(&loc, "physical values not yet supported in 'VALUE");
+      rt_fatal(where, "physical values not yet supported in 'VALUE");
       break;
 
    case IMAGE_ENUM:
@@ -878,8 +1368,7 @@ int64_t _value_attr(const uint8_t *raw_str, int32_t str_len,
       }
 
       if (value < 0) {
-         from_rt_loc(where, &loc);
-         fatal_at(&loc, "\"%.*s\" is not a valid enumeration value",
+         rt_fatal(where, "\"%.*s\" is not a valid enumeration value",
                   str_len, (const char *)raw_str);
       }
       break;
@@ -887,8 +1376,7 @@ int64_t _value_attr(const uint8_t *raw_str, int32_t str_len,
 
    while (p < endp && *p != '\0') {
       if (!isspace((int)*p)) {
-         from_rt_loc(where, &loc);
-         fatal_at(&loc, "found invalid characters \"%.*s\" after value "
+         rt_fatal(where, "found invalid characters \"%.*s\" after value "
                   "\"%.*s\"", (int)(endp - p), p, str_len,
                   (const char *)raw_str);
       }
@@ -901,17 +1389,19 @@ int64_t _value_attr(const uint8_t *raw_str, int32_t str_len,
 DLLEXPORT
 void _div_zero(const rt_loc_t *where)
 {
-   loc_t loc;
-   from_rt_loc(where, &loc);
-   fatal_at(&loc, "division by zero");
+   if (unlikely(sandbox_jmp != NULL))
+      longjmp(*sandbox_jmp, 1);
+
+   rt_fatal(where, "division by zero");
 }
 
 DLLEXPORT
 void _null_deref(const rt_loc_t *where)
 {
-   loc_t loc;
-   from_rt_loc(where, &loc);
-   fatal_at(&loc, "null access dereference");
+   if (unlikely(sandbox_jmp != NULL))
+      longjmp(*sandbox_jmp, 1);
+
+   rt_fatal(where, "null access dereference");
 }
 
 DLLEXPORT
@@ -923,6 +1413,14 @@ int64_t _std_standard_now(void)
 DLLEXPORT
 void _nvc_env_stop(int32_t finish, int32_t have_status, int32_t status)
 {
+   if (unlikely(defer_log != NULL)) {
+      defer_op_t *op = rt_defer(DEFER_ENV_STOP, NULL, 0);
+      op->args[0] = finish;
+      op->args[1] = have_status;
+      op->args[2] = status;
+      rt_batch_halt();
+   }
+
    if (have_status)
       notef("%s called with status %d", finish ? "FINISH" : "STOP", status);
    else
@@ -931,50 +1429,56 @@ void _nvc_env_stop(int32_t finish, int32_t have_status, int32_t status)
    exit(status);
 }
 
-DLLEXPORT
-void *_vec_load(const int32_t *nids, void *where,
-                int32_t low, int32_t high, int32_t last)
+static size_t rt_format_int(char *buf, int64_t val)
 {
-   TRACE("_vec_load %s where=%p low=%d high=%d last=%d",
-         fmt_net(nids[0]), where, low, high, last);
-
-   int offset = low;
-
-   groupid_t gid = netdb_lookup(netdb, nids[offset]);
-   netgroup_t *g = &(groups[gid]);
-   int skip = nids[offset] - g->first;
-
-   RT_ASSERT((g->flags & NET_F_LAST_VALUE) || !last);
-
-   if (offset + g->length - skip > high) {
-      // If the signal data is already contiguous return a pointer to
-      // that rather than copying into the user buffer
-      void *r = unlikely(last) ? g->last_value : g->resolved;
-      return (uint8_t *)r + (skip * g->size);
+   // Converts two digits at a time working back from the end of a
+   // buffer of at least MAX_INT_IMAGE characters
+
+   static const char digit_pairs[] =
+      "00010203040506070809101112131415161718192021222324"
+      "25262728293031323334353637383940414243444546474849"
+      "50515253545556575859606162636465666768697071727374"
+      "75767778798081828384858687888990919293949596979899";
+
+   char tmp[MAX_INT_IMAGE];
+   char *p = tmp + MAX_INT_IMAGE;
+
+   uint64_t mag = val < 0 ? -(uint64_t)val : (uint64_t)val;
+   while (mag >= 100) {
+      const unsigned pair = (mag % 100) * 2;
+      mag /= 100;
+      *--p = digit_pairs[pair + 1];
+      *--p = digit_pairs[pair];
    }
 
-   uint8_t *p = where;
-   for (;;) {
-      const int to_copy = MIN(high - offset + 1, g->length - skip);
-      const int bytes   = to_copy * g->size;
-
-      const void *src = unlikely(last) ? g->last_value : g->resolved;
-
-      memcpy(p, (uint8_t *)src + (skip * g->size), bytes);
+   if (mag >= 10) {
+      *--p = digit_pairs[mag * 2 + 1];
+      *--p = digit_pairs[mag * 2];
+   }
+   else
+      *--p = '0' + mag;
 
-      offset += g->length - skip;
-      p += bytes;
+   if (val < 0)
+      *--p = '-';
 
-      if (offset > high)
-         break;
+   const size_t len = tmp + MAX_INT_IMAGE - p;
+   memcpy(buf, p, len);
+   return len;
+}
 
-      gid = netdb_lookup(netdb, nids[offset]);
-      g = &(groups[gid]);
-      skip = nids[offset] - g->first;
-   }
+static void rt_image_result(struct uarray *u, char *buf, size_t len)
+{
+   u->ptr = buf;
+   u->dims[0].left  = 1;
+   u->dims[0].right = len;
+   u->dims[0].dir   = RANGE_TO;
+}
 
-   // Signal data was non-contiguous so return the user buffer
-   return where;
+DLLEXPORT
+void _image_int(int64_t val, struct uarray *u)
+{
+   char *buf = rt_tmp_alloc(MAX_INT_IMAGE);
+   rt_image_result(u, buf, rt_format_int(buf, val));
 }
 
 DLLEXPORT
@@ -985,14 +1489,19 @@ void _image(int64_t val, image_map_t *map, struct uarray *u)
 
    switch (map->kind) {
    case IMAGE_INTEGER:
-      buf = rt_tmp_alloc(16);
-      len = checked_sprintf(buf, 16, "%"PRIi64, val);
+      buf = rt_tmp_alloc(MAX_INT_IMAGE);
+      len = rt_format_int(buf, val);
       break;
 
    case IMAGE_ENUM:
-      buf = rt_tmp_alloc(map->stride);
-      strncpy(buf, map->elems + (val * map->stride), map->stride);
-      len = strlen(buf);
+      {
+         // Each literal is padded with NULs to the stride
+         const char *elem = map->elems + (val * map->stride);
+         const char *end = memchr(elem, '\0', map->stride);
+         len = (end == NULL) ? map->stride : end - elem;
+         buf = rt_tmp_alloc(len);
+         memcpy(buf, elem, len);
+      }
       break;
 
    case IMAGE_REAL:
@@ -1007,16 +1516,19 @@ void _image(int64_t val, image_map_t *map, struct uarray *u)
       break;
 
    case IMAGE_PHYSICAL:
-      buf = rt_tmp_alloc(16 + map->stride);
-      len = checked_sprintf(buf, 16 + map->stride, "%"PRIi64" %s",
-                            val, map->elems + (0 * map->stride));
+      {
+         // Always printed in the primary unit which is the first element
+         const size_t ulen = strnlen(map->elems, map->stride);
+         buf = rt_tmp_alloc(MAX_INT_IMAGE + 1 + ulen);
+         len = rt_format_int(buf, val);
+         buf[len++] = ' ';
+         memcpy(buf + len, map->elems, ulen);
+         len += ulen;
+      }
       break;
    }
 
-   u->ptr = buf;
-   u->dims[0].left  = 1;
-   u->dims[0].right = len;
-   u->dims[0].dir   = RANGE_TO;
+   rt_image_result(u, buf, len);
 }
 
 DLLEXPORT
@@ -1032,27 +1544,30 @@ void _bit_shift(int32_t kind, const uint8_t *data, int32_t len,
 
    uint8_t *buf = rt_tmp_alloc(len);
 
-   for (int i = 0; i < len; i++) {
-      switch (kind) {
-      case BIT_SHIFT_SLL:
-         buf[i] = (i < len - shift) ? data[i + shift] : 0;
-         break;
-      case BIT_SHIFT_SRL:
-         buf[i] = (i >= shift) ? data[i - shift] : 0;
-         break;
-      case BIT_SHIFT_SLA:
-         buf[i] = (i < len - shift) ? data[i + shift] : data[len - 1];
-         break;
-      case BIT_SHIFT_SRA:
-         buf[i] = (i >= shift) ? data[i - shift] : data[0];
-         break;
-      case BIT_SHIFT_ROL:
-         buf[i] = (i < len - shift) ? data[i + shift] : data[(i + shift) % len];
-         break;
-      case BIT_SHIFT_ROR:
-         buf[i] = (i >= shift) ? data[i - shift] : data[len + i - shift];
-         break;
-      }
+   // Each element occupies one byte so shifts and rotates reduce to
+   // block copies with the vacated positions filled in afterwards
+
+   const int keep = len - shift;
+
+   switch (kind) {
+   case BIT_SHIFT_SLL:
+   case BIT_SHIFT_SLA:
+      memcpy(buf, data + shift, keep);
+      memset(buf + keep, (kind == BIT_SHIFT_SLA) ? data[len - 1] : 0, shift);
+      break;
+   case BIT_SHIFT_SRL:
+   case BIT_SHIFT_SRA:
+      memcpy(buf + shift, data, keep);
+      memset(buf, (kind == BIT_SHIFT_SRA) ? data[0] : 0, shift);
+      break;
+   case BIT_SHIFT_ROL:
+      memcpy(buf, data + shift, keep);
+      memcpy(buf + keep, data, shift);
+      break;
+   case BIT_SHIFT_ROR:
+      memcpy(buf + shift, data, keep);
+      memcpy(buf, data + keep, shift);
+      break;
    }
 
    u->ptr = buf;
@@ -1067,47 +1582,63 @@ void _bit_vec_op(int32_t kind, const uint8_t *left, int32_t left_len,
                  int8_t right_dir, struct uarray *u)
 {
    if ((kind != BIT_VEC_NOT) && (left_len != right_len))
-      fatal("arguments to bit vector operation are not the same length");
+      rt_fatal(NULL, "arguments to bit vector operation are not the same "
+               "length");
 
    uint8_t *buf = rt_tmp_alloc(left_len);
 
+   // Elements are stored one per byte as zero or one so the operation
+   // can be applied to eight elements at once in a 64-bit word, which
+   // the compiler is free to widen further with vector instructions
+   // The final partial word is padded with zeros and truncated
+
+   const uint64_t ones = UINT64_C(0x0101010101010101);
+
+#define BIT_VEC_WORDS(expr) do {                              \
+      for (int i = 0; i < left_len; i += 8) {                 \
+         const int n = MIN(8, left_len - i);                  \
+         uint64_t l = 0, r = 0;                               \
+         memcpy(&l, left + i, n);                             \
+         if (right != NULL)                                   \
+            memcpy(&r, right + i, n);                         \
+         const uint64_t x = (expr);                           \
+         memcpy(buf + i, &x, n);                              \
+      }                                                       \
+   } while (0)
+
    switch (kind) {
    case BIT_VEC_NOT:
-      for (int i = 0; i < left_len; i++)
-         buf[i] = !left[i];
+      right = NULL;
+      BIT_VEC_WORDS(l ^ ones);
       break;
 
    case BIT_VEC_AND:
-      for (int i = 0; i < left_len; i++)
-         buf[i] = left[i] && right[i];
+      BIT_VEC_WORDS(l & r);
       break;
 
    case BIT_VEC_OR:
-      for (int i = 0; i < left_len; i++)
-         buf[i] = left[i] || right[i];
+      BIT_VEC_WORDS(l | r);
       break;
 
    case BIT_VEC_XOR:
-      for (int i = 0; i < left_len; i++)
-         buf[i] = left[i] ^ right[i];
+      BIT_VEC_WORDS(l ^ r);
       break;
 
    case BIT_VEC_XNOR:
-      for (int i = 0; i < left_len; i++)
-         buf[i] = !(left[i] ^ right[i]);
+      BIT_VEC_WORDS(l ^ r ^ ones);
       break;
 
    case BIT_VEC_NAND:
-      for (int i = 0; i < left_len; i++)
-         buf[i] = !(left[i] && right[i]);
+      BIT_VEC_WORDS((l & r) ^ ones);
       break;
 
    case BIT_VEC_NOR:
-      for (int i = 0; i < left_len; i++)
-         buf[i] = !(left[i] || right[i]);
+      BIT_VEC_WORDS((l | r) ^ ones);
       break;
    }
 
+#undef BIT_VEC_WORDS
+
    u->ptr = buf;
    u->dims[0].left  = (left_dir == RANGE_TO) ? 0 : left_len - 1;
    u->dims[0].right = (left_dir == RANGE_TO) ? left_len - 1 : 0;
@@ -1134,45 +1665,12 @@ void _debug_dump(const uint8_t *ptr, int32_t len)
 }
 
 DLLEXPORT
-int64_t _last_event(const int32_t *nids, int32_t n)
+void _file_open(int8_t *status, void **_fp, uint8_t *name_bytes,
+                int32_t name_len, int8_t mode)
 {
-   //TRACE("_last_event %s n=%d %d", fmt_net(nids[0]), n);
-
-   int64_t last = INT64_MAX;
-   int offset = 0;
-   while (offset < n) {
-      netgroup_t *g = &(groups[netdb_lookup(netdb, nids[offset])]);
-      if (g->last_event < now)
-         last = MIN(last, now - g->last_event);
-
-      offset += g->length;
-   }
-
-   return last;
-}
+   if (unlikely(defer_log != NULL))
+      rt_defer_flush_files();
 
-DLLEXPORT
-int32_t _test_net_flag(const int32_t *nids, int32_t n, int32_t flag)
-{
-   //TRACE("_test_net_flag %s n=%d flag=%d", fmt_net(nids[0]), n, flag);
-
-   int offset = 0;
-   while (offset < n) {
-      netgroup_t *g = &(groups[netdb_lookup(netdb, nids[offset])]);
-
-      if (g->flags & flag)
-         return 1;
-
-      offset += g->length;
-   }
-
-   return 0;
-}
-
-DLLEXPORT
-void _file_open(int8_t *status, void **_fp, uint8_t *name_bytes,
-                int32_t name_len, int8_t mode)
-{
    FILE **fp = (FILE **)_fp;
    if (*fp != NULL) {
       if (status != NULL) {
@@ -1208,7 +1706,7 @@ void _file_open(int8_t *status, void **_fp, uint8_t *name_bytes,
 
    if (*fp == NULL) {
       if (status == NULL)
-         fatal_errno("failed to open %s", fname);
+         rt_fatal(NULL, "failed to open %s: %s", fname, strerror(errno));
       else {
          switch (errno) {
          case ENOENT:
@@ -1218,7 +1716,7 @@ void _file_open(int8_t *status, void **_fp, uint8_t *name_bytes,
             *status = 3;   // MODE_ERROR
             break;
          default:
-            fatal_errno("%s", fname);
+            rt_fatal(NULL, "%s: %s", fname, strerror(errno));
          }
       }
    }
@@ -1231,6 +1729,13 @@ void _file_write(void **_fp, uint8_t *data, int32_t len)
 {
    FILE **fp = (FILE **)_fp;
 
+   if (unlikely(defer_log != NULL)) {
+      // The file variable may be a subprogram local so save the handle
+      defer_op_t *op = rt_defer(DEFER_FILE_WRITE, *fp, len);
+      memcpy(op->data, data, len);
+      return;
+   }
+
    TRACE("_file_write fp=%p data=%p len=%d", fp, data, len);
 
    if (*fp == NULL)
@@ -1244,10 +1749,13 @@ void _file_read(void **_fp, uint8_t *data, int32_t len, int32_t *out)
 {
    FILE **fp = (FILE **)_fp;
 
+   if (unlikely(defer_log != NULL))
+      rt_defer_flush_files();
+
    TRACE("_file_read fp=%p data=%p len=%d", fp, data, len);
 
    if (*fp == NULL)
-      fatal("read from closed file");
+      rt_fatal(NULL, "read from closed file");
 
    size_t n = fread(data, 1, len, *fp);
    if (out != NULL)
@@ -1259,6 +1767,12 @@ void _file_close(void **_fp)
 {
    FILE **fp = (FILE **)_fp;
 
+   if (unlikely(defer_log != NULL)) {
+      rt_defer(DEFER_FILE_CLOSE, *fp, 0);
+      *fp = NULL;
+      return;
+   }
+
    TRACE("_file_close fp=%p", fp);
 
    if (*fp == NULL)
@@ -1268,13 +1782,62 @@ void _file_close(void **_fp)
    *fp = NULL;
 }
 
+DLLEXPORT
+void _std_textio_read_line(void **_fp, uint8_t *buf, int32_t len,
+                           int32_t *used, int32_t *done)
+{
+   // Fast path for READLINE which would otherwise call _endfile and
+   // _file_read for each character of the line
+
+   FILE **fp = (FILE **)_fp;
+
+   if (unlikely(defer_log != NULL))
+      rt_defer_flush_files();
+
+   TRACE("_std_textio_read_line fp=%p buf=%p len=%d", fp, buf, len);
+
+   if (*fp == NULL)
+      rt_fatal(NULL, "read from closed file");
+
+   // The stream is locked once for the whole line rather than by each
+   // call to getc where the C library allows it
+#ifndef __MINGW32__
+   flockfile(*fp);
+#endif
+
+   int32_t n = 0;
+   *done = 0;
+   while (n < len) {
+#ifdef __MINGW32__
+      const int c = fgetc(*fp);
+#else
+      const int c = getc_unlocked(*fp);
+#endif
+      if (c == EOF || c == '\n') {
+         *done = 1;
+         break;
+      }
+      else if (c != '\r')
+         buf[n++] = c;
+   }
+
+#ifndef __MINGW32__
+   funlockfile(*fp);
+#endif
+
+   *used = n;
+}
+
 DLLEXPORT
 int8_t _endfile(void *_f)
 {
    FILE *f = _f;
 
+   if (unlikely(defer_log != NULL))
+      rt_defer_flush_files();
+
    if (f == NULL)
-      fatal("ENDFILE called on closed file");
+      rt_fatal(NULL, "ENDFILE called on closed file");
 
    int c = fgetc(f);
    if (c == EOF)
@@ -1306,17 +1869,92 @@ static void _tracef(const char *fmt, ...)
    va_end(ap);
 }
 
+static bool rt_stale_event(event_t *e)
+{
+   return (e->kind == E_PROCESS) && (e->wakeup_gen != e->proc->wakeup_gen);
+}
+
+static inline int rt_stats_bin(uint64_t n)
+{
+   // Histogram bins are powers of two with zero in the first bin
+   return n == 0 ? 0 : MIN(64 - __builtin_clzll(n), STATS_HIST_BINS - 1);
+}
+
 static void deltaq_insert(event_t *e)
 {
    if (e->when == now) {
       event_t **chain = (e->kind == E_DRIVER) ? &delta_driver : &delta_proc;
+      if (unlikely(region_running) && e->kind == E_DRIVER)
+         chain = &region_driver;
       e->delta_chain = *chain;
       *chain = e;
    }
    else {
+      // Timed events are grouped into a bucket per time step with a
+      // list for each kind of event in priority order. There may be
+      // more than one bucket for the same time if its cache entry was
+      // replaced.
+
+      const unsigned slot = bucket_cache_slot(e->when);
+      bucket_t *b = bucket_cache[slot];
+      if (b == NULL || b->when != e->when) {
+         b = rt_alloc(bucket_stack);
+         b->when = e->when;
+         b->next = NULL;
+         for (int i = 0; i < N_EVENT_KINDS; i++) {
+            b->head[i] = NULL;
+            b->tail[i] = &(b->head[i]);
+         }
+
+         wheel_insert(eventq_wheel, e->when, b);
+         bucket_cache[slot] = b;
+
+         stats.peak_eventq = MAX(stats.peak_eventq, wheel_size(eventq_wheel));
+      }
+
       e->delta_chain = NULL;
-      heap_insert(eventq_heap, heap_key(e->when, e->kind), e);
+      *(b->tail[e->kind]) = e;
+      b->tail[e->kind] = &(e->delta_chain);
+   }
+}
+
+static bucket_t *deltaq_take_bucket(void)
+{
+   bucket_t *b = wheel_extract_min(eventq_wheel);
+
+   const unsigned slot = bucket_cache_slot(b->when);
+   if (bucket_cache[slot] == b)
+      bucket_cache[slot] = NULL;
+
+   return b;
+}
+
+static bool deltaq_purge_bucket(bucket_t *b)
+{
+   // Drop all the stale process wakeups at once and return true if the
+   // bucket is now empty
+
+   event_t **tail = &(b->head[E_PROCESS]);
+   for (event_t *e = b->head[E_PROCESS], *next; e != NULL; e = next) {
+      next = e->delta_chain;
+      if (rt_stale_event(e)) {
+         stats.stale_events++;
+         rt_free(event_stack, e);
+      }
+      else {
+         *tail = e;
+         tail = &(e->delta_chain);
+      }
+   }
+   *tail = NULL;
+   b->tail[E_PROCESS] = tail;
+
+   for (int i = 0; i < N_EVENT_KINDS; i++) {
+      if (b->head[i] != NULL)
+         return false;
    }
+
+   return true;
 }
 
 static void deltaq_insert_proc(uint64_t delta, rt_proc_t *wake)
@@ -1325,19 +1963,27 @@ static void deltaq_insert_proc(uint64_t delta, rt_proc_t *wake)
    e->when       = now + delta;
    e->kind       = E_PROCESS;
    e->proc       = wake;
+   e->group      = NULL;
+   e->driver     = 0;
+   e->ngroups    = 0;
    e->wakeup_gen = wake->wakeup_gen;
 
    deltaq_insert(e);
 }
 
 static void deltaq_insert_driver(uint64_t delta, netgroup_t *group,
-                                 rt_proc_t *driver)
+                                 unsigned ngroups, rt_proc_t *proc,
+                                 int driver)
 {
+   RT_ASSERT(ngroups == 1 || proc != NULL);
+
    event_t *e = rt_alloc(event_stack);
    e->when       = now + delta;
    e->kind       = E_DRIVER;
    e->group      = group;
-   e->proc       = driver;
+   e->ngroups    = ngroups;
+   e->proc       = proc;
+   e->driver     = driver;
    e->wakeup_gen = UINT32_MAX;
 
    deltaq_insert(e);
@@ -1346,34 +1992,42 @@ static void deltaq_insert_driver(uint64_t delta, netgroup_t *group,
 #if TRACE_DELTAQ > 0
 static void deltaq_walk(uint64_t key, void *user, void *context)
 {
-   event_t *e = user;
-
-   fprintf(stderr, "%s\t", fmt_time(e->when));
-   switch (e->kind) {
-   case E_DRIVER:
-      fprintf(stderr, "driver\t %s\n", fmt_group(e->group));
-      break;
-   case E_PROCESS:
-      fprintf(stderr, "process\t %s%s\n", istr(tree_ident(e->proc->source)),
-              (e->wakeup_gen == e->proc->wakeup_gen) ? "" : " (stale)");
-      break;
-   case E_TIMEOUT:
-      fprintf(stderr, "timeout\t %p %p\n", e->timeout_fn, e->timeout_user);
-      break;
+   bucket_t *b = user;
+
+   for (int i = 0; i < N_EVENT_KINDS; i++) {
+      for (event_t *e = b->head[i]; e != NULL; e = e->delta_chain) {
+         fprintf(stderr, "%s\t", fmt_time(e->when));
+         switch (e->kind) {
+         case E_DRIVER:
+            fprintf(stderr, "driver\t %s (%u groups)\n", fmt_group(e->group),
+                    e->ngroups);
+            break;
+         case E_PROCESS:
+            fprintf(stderr, "process\t %s%s\n",
+                    istr(tree_ident(e->proc->source)),
+                    (e->wakeup_gen == e->proc->wakeup_gen) ? "" : " (stale)");
+            break;
+         case E_TIMEOUT:
+            fprintf(stderr, "timeout\t %p %p\n", e->timeout_fn,
+                    e->timeout_user);
+            break;
+         }
+      }
    }
 }
 
 static void deltaq_dump(void)
 {
    for (event_t *e = delta_driver; e != NULL; e = e->delta_chain)
-      fprintf(stderr, "delta\tdriver\t %s\n", fmt_group(e->group));
+      fprintf(stderr, "delta\tdriver\t %s (%u groups)\n", fmt_group(e->group),
+              e->ngroups);
 
    for (event_t *e = delta_proc; e != NULL; e = e->delta_chain)
       fprintf(stderr, "delta\tprocess\t %s%s\n",
               istr(tree_ident(e->proc->source)),
               (e->wakeup_gen == e->proc->wakeup_gen) ? "" : " (stale)");
 
-   heap_walk(eventq_heap, deltaq_walk, NULL);
+   wheel_walk(eventq_wheel, deltaq_walk, NULL);
 }
 #endif
 
@@ -1389,8 +2043,9 @@ static res_memo_t *rt_memo_resolution_fn(type_t type, resolution_fn_t fn)
       type = type_elem(type);
 
    memo = xmalloc(sizeof(res_memo_t));
-   memo->fn    = fn;
-   memo->flags = 0;
+   memo->fn       = fn;
+   memo->flags    = 0;
+   memo->fold_max = 0;
 
    hash_put(res_memo_hash, fn, memo);
 
@@ -1437,10 +2092,51 @@ static res_memo_t *rt_memo_resolution_fn(type_t type, resolution_fn_t fn)
       identity = identity && (memo->tab1[i] == i);
    }
 
+   // The function can be applied to more than two drivers by folding
+   // the two value table over the drivers in order. A function may
+   // depend on the number of drivers so the fold is checked against the
+   // function for every input with three drivers, then four, and so on
+   // while the number of inputs is at most RES_FOLD_CHECKS. Larger
+   // groups always call the function.
+
+   bool fold = true;
+   for (int i = 0; fold && (i < nlits); i++) {
+      for (int j = 0; fold && (j < nlits); j++) {
+         const int8_t ij = memo->tab2[i][j];
+         fold = (ij >= 0) && (ij < nlits);
+      }
+   }
+
+   memo->fold_max = 2;
+
+   int ninputs = nlits * nlits * nlits;
+   for (int n = 3; fold && (nlits > 1) && (ninputs <= RES_FOLD_CHECKS); n++) {
+      int8_t args[n];
+      memset(args, '\0', n);
+
+      for (int k = 0; fold && (k < ninputs); k++) {
+         int8_t r = args[0];
+         for (int i = 1; i < n; i++)
+            r = memo->tab2[(int)r][(int)args[i]];
+
+         fold = ((*fn)(args, n) == r);
+
+         for (int i = n - 1; (i >= 0) && (++args[i] == nlits); i--)
+            args[i] = 0;
+      }
+
+      if (fold)
+         memo->fold_max = n;
+
+      ninputs *= nlits;
+   }
+
    if (init_side_effect != SIDE_EFFECT_OCCURRED) {
       memo->flags |= R_MEMO;
       if (identity)
          memo->flags |= R_IDENT;
+      if (memo->fold_max > 2)
+         memo->flags |= R_FOLD;
    }
 
    return memo;
@@ -1461,27 +2157,22 @@ static void rt_global_event(rt_event_t kind)
    }
 }
 
+static inline size_t rt_value_size(netgroup_t *g)
+{
+   return sizeof(struct value) + MAX(sizeof(uint64_t), g->size * g->length);
+}
+
 static value_t *rt_alloc_value(netgroup_t *g)
 {
-   if (g->free_values == NULL) {
-      const size_t size = MAX(sizeof(uint64_t), g->size * g->length);
-      value_t *v = xmalloc(sizeof(struct value) + size);
-      v->next = NULL;
-      return v;
-   }
-   else {
-      value_t *v = g->free_values;
-      g->free_values = v->next;
-      v->next = NULL;
-      return v;
-   }
+   value_t *v = slab_alloc(rt_value_size(g));
+   v->next = NULL;
+   return v;
 }
 
 static void rt_free_value(netgroup_t *g, value_t *v)
 {
    RT_ASSERT(v->next == NULL);
-   v->next = g->free_values;
-   g->free_values = v;
+   slab_free(v, rt_value_size(g));
 }
 
 static void *rt_tmp_alloc(size_t sz)
@@ -1493,6 +2184,23 @@ static void *rt_tmp_alloc(size_t sz)
    return ptr;
 }
 
+static sens_list_t **rt_pending_list(netid_t first, netid_t last)
+{
+   // Sensitivity to part of a signal is stored in an implicit segment
+   // tree over the net IDs: each entry is kept in the list for the
+   // smallest aligned power-of-two block of nets containing it
+
+   const int level = (first == last) ? 0 : 32 - __builtin_clz(first ^ last);
+
+   if (unlikely(pending[level] == NULL)) {
+      const size_t nblocks = ((uint64_t)netdb->nnets >> level) + 1;
+      pending[level] = xcalloc(nblocks * sizeof(sens_list_t *));
+      pending_levels |= UINT64_C(1) << level;
+   }
+
+   return &(pending[level][(uint64_t)first >> level]);
+}
+
 static void rt_sched_event(sens_list_t **list, netid_t first, netid_t last,
                            rt_proc_t *proc, bool is_static)
 {
@@ -1529,21 +2237,47 @@ static void rt_sched_event(sens_list_t **list, netid_t first, netid_t last,
 #if TRACE_PENDING
 static void rt_dump_pending(void)
 {
-   for (struct sens_list *it = pending; it != NULL; it = it->next) {
-      printf("%d..%d\t%s%s\n", it->first, it->last,
-             istr(tree_ident(it->proc->source)),
-             (it->wakeup_gen == it->proc->wakeup_gen) ? "" : " (stale)");
+   for (int level = 0; level < PENDING_LEVELS; level++) {
+      if (pending[level] == NULL)
+         continue;
+
+      const size_t nblocks = ((uint64_t)netdb->nnets >> level) + 1;
+      for (size_t b = 0; b < nblocks; b++) {
+         for (sens_list_t *it = pending[level][b]; it; it = it->next) {
+            printf("%d..%d\t%s%s\n", it->first, it->last,
+                   istr(tree_ident(it->proc->source)),
+                   (it->wakeup_gen == it->proc->wakeup_gen) ? "" : " (stale)");
+         }
+      }
    }
 }
 #endif  // TRACE_PENDING
 
+static netgroup_t *rt_alloc_groups(size_t count)
+{
+   // Keep each group in its own cache line
+   const size_t bytes = MAX(count, 1) * sizeof(netgroup_t);
+   void *mem;
+#ifdef __MINGW32__
+   if ((mem = _aligned_malloc(bytes, 64)) == NULL)
+#else
+   if (posix_memalign(&mem, 64, bytes) != 0)
+#endif
+      fatal("memory exhausted (%zu net groups)", count);
+
+   return mem;
+}
+
 static void rt_reset_group(groupid_t gid, netid_t first, unsigned length)
 {
    netgroup_t *g = &(groups[gid]);
    memset(g, '\0', sizeof(netgroup_t));
-   g->first       = first;
-   g->length      = length;
-   g->last_event  = INT64_MAX;
+   g->first  = first;
+   g->length = length;
+
+   netgroup_cold_t *cold = &(groups_cold[gid]);
+   memset(cold, '\0', sizeof(netgroup_cold_t));
+   cold->last_event = INT64_MAX;
 }
 
 static void rt_free_delta_events(event_t *e)
@@ -1562,24 +2296,29 @@ static void rt_setup(tree_t top)
    active_proc = NULL;
    force_stop = false;
    can_create_delta = true;
+   capture_state = CAPTURE_IDLE;
+   capture_req = CAPTURE_REQ_NONE;
 
    RT_ASSERT(resume == NULL);
 
    rt_free_delta_events(delta_proc);
    rt_free_delta_events(delta_driver);
 
-   if (eventq_heap != NULL)
-      heap_free(eventq_heap);
-   eventq_heap = heap_new(512);
+   if (eventq_wheel != NULL)
+      wheel_free(eventq_wheel);
+   eventq_wheel = wheel_new();
+   memset(bucket_cache, '\0', sizeof(bucket_cache));
+   memset(&stats, '\0', sizeof(stats));
 
    if (netdb == NULL) {
       netdb = netdb_open(top);
-      groups = xmalloc(sizeof(struct netgroup) * netdb_size(netdb));
+      groups = rt_alloc_groups(netdb_size(netdb));
+      groups_cold = xmalloc(sizeof(netgroup_cold_t) * netdb_size(netdb));
    }
 
    if (procs == NULL) {
       n_procs = tree_stmts(top);
-      procs   = xmalloc(sizeof(struct rt_proc) * n_procs);
+      procs   = xcalloc(sizeof(struct rt_proc) * n_procs);
    }
 
    const int ndecls = tree_decls(top);
@@ -1593,6 +2332,8 @@ static void rt_setup(tree_t top)
 
    netdb_walk(netdb, rt_reset_group);
 
+   n_levels = 0;
+
    const int nstmts = tree_stmts(top);
    for (int i = 0; i < nstmts; i++) {
       tree_t p = tree_stmt(top, i);
@@ -1606,7 +2347,26 @@ static void rt_setup(tree_t top)
       procs[i].tmp_alloc  = 0;
       procs[i].pending    = false;
       procs[i].usage      = 0;
+      procs[i].drivers    = NULL;
+      procs[i].native     = false;
+
+      procs[i].remote = dist_enabled() && !dist_owns(tree_ident(p));
+
+      free(procs[i].clock);
+      procs[i].clock = procs[i].remote ? NULL : rt_clock_detect(&(procs[i]));
+
+      procs[i].level = -1;
+      if (cycle_based) {
+         procs[i].level = tree_attr_int(p, cycle_level_i, -1);
+         n_levels = MAX(n_levels, procs[i].level + 1);
+      }
    }
+
+   free(region);
+   region = xcalloc(MAX(n_levels, 1) * sizeof(sens_list_t *));
+
+   clocks_enabled = false;
+   clock_start_pending = false;
 }
 
 static void rt_run(struct rt_proc *proc, bool reset)
@@ -1641,9 +2401,19 @@ static void rt_run(struct rt_proc *proc, bool reset)
 
    if (reset)
       global_tmp_alloc = _tmp_alloc;
+   else if (proc->tmp_stack != NULL && proc->tmp_alloc == 0
+            && proc->tmp_stack != global_tmp_stack) {
+      // Nothing is live on the private stack so it can be given to the
+      // next process which suspends in a procedure
+      rt_tmp_stack_put(proc->tmp_stack);
+      proc->tmp_stack = NULL;
+   }
 
    if (start_clock != 0)
       proc->usage += get_timestamp_us() - start_clock;
+
+   if (unlikely(proc->clock != NULL) && !reset)
+      rt_clock_observe(proc->clock);
 }
 
 static void rt_call_module_reset(ident_t name)
@@ -1662,6 +2432,325 @@ static void rt_call_module_reset(ident_t name)
    global_tmp_alloc = _tmp_alloc;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Parallel process execution
+//
+// Processes that become runnable in the same cycle may execute concurrently
+// on a pool of worker threads. Signal values cannot change while processes
+// are running but anything a process does that affects the kernel state,
+// such as scheduling transactions or reporting, is recorded in a per-thread
+// log instead. The logs are then replayed on the main thread in the same
+// order the processes would have run serially, so the result is identical
+// to the sequential kernel.
+
+static defer_op_t *rt_defer(defer_kind_t kind, const void *ptr, size_t length)
+{
+   const size_t total = sizeof(defer_op_t) + ((length + 7) & ~7);
+
+   if (unlikely(defer_log->len + total > defer_log->alloc)) {
+      defer_log->alloc = MAX(defer_log->alloc * 2, defer_log->len + total);
+      defer_log->buf = xrealloc(defer_log->buf, defer_log->alloc);
+   }
+
+   defer_op_t *op = (defer_op_t *)(defer_log->buf + defer_log->len);
+   op->kind   = kind;
+   op->length = length;
+   op->ptr    = ptr;
+
+   defer_log->len += total;
+   return op;
+}
+
+static void rt_defer_flush_files(void)
+{
+   // Reading from a file must observe any earlier writes by the same
+   // process so perform those immediately
+
+   uint8_t *p = defer_log->buf + active_item->log_start;
+   uint8_t *end = defer_log->buf + defer_log->len;
+   while (p < end) {
+      defer_op_t *op = (defer_op_t *)p;
+
+      if (op->kind == DEFER_FILE_WRITE || op->kind == DEFER_FILE_CLOSE) {
+         FILE *f = (FILE *)op->ptr;
+         if (f == NULL)
+            rt_fatal(NULL, "%s closed file", op->kind == DEFER_FILE_WRITE
+                     ? "write to" : "attempt to close already");
+         else if (op->kind == DEFER_FILE_WRITE)
+            fwrite(op->data, 1, op->length, f);
+         else
+            fclose(f);
+
+         op->kind = DEFER_NOP;
+      }
+
+      p += sizeof(defer_op_t) + ((op->length + 7) & ~7);
+   }
+}
+
+static void rt_batch_halt(void)
+{
+   // The running process is about to end the simulation: wait for the
+   // rest of the batch and then replay everything up to this point in
+   // serial order
+
+   active_item->log_end = defer_log->len;
+   defer_log = NULL;
+
+#if RT_MULTITHREAD
+   pthread_mutex_lock(&batch_lock);
+   if (is_worker) {
+      if (++batch_finished == n_workers)
+         pthread_cond_signal(&batch_done_cv);
+
+      // The main thread will exit while replaying the log
+      for (;;)
+         pthread_cond_wait(&halt_cv, &batch_lock);
+   }
+
+   while (batch_parallel && batch_finished < n_workers)
+      pthread_cond_wait(&batch_done_cv, &batch_lock);
+   pthread_mutex_unlock(&batch_lock);
+#endif
+
+   for (batch_item_t *it = batch; it <= active_item; it++)
+      rt_replay_deferred(it);
+
+   fatal_trace("simulation did not stop after replaying batch");
+}
+
+static void rt_replay_deferred(const batch_item_t *item)
+{
+   active_proc = item->proc;
+   replaying = true;
+
+   const uint8_t *p = item->log->buf + item->log_start;
+   const uint8_t *end = item->log->buf + item->log_end;
+   while (p < end) {
+      const defer_op_t *op = (const defer_op_t *)p;
+
+      switch (op->kind) {
+      case DEFER_SCHED_PROCESS:
+         _sched_process(op->args[0]);
+         break;
+      case DEFER_SCHED_WAVEFORM_S:
+         _sched_waveform_s((void *)op->ptr, op->args[0], op->args[1],
+                           op->args[2]);
+         break;
+      case DEFER_SCHED_WAVEFORM:
+         _sched_waveform((void *)op->ptr, (void *)op->data, op->args[0],
+                         op->args[1], op->args[2]);
+         break;
+      case DEFER_SCHED_EVENT:
+         _sched_event((void *)op->ptr, op->args[0], op->args[1]);
+         break;
+      case DEFER_ASSERT_FAIL:
+         _assert_fail(op->data + sizeof(rt_loc_t),
+                      op->length - sizeof(rt_loc_t),
+                      op->args[0], op->args[1], (const rt_loc_t *)op->data);
+         break;
+      case DEFER_FILE_WRITE:
+         {
+            void *fp = (void *)op->ptr;
+            _file_write(&fp, (uint8_t *)op->data, op->length);
+         }
+         break;
+      case DEFER_FILE_CLOSE:
+         {
+            void *fp = (void *)op->ptr;
+            _file_close(&fp);
+         }
+         break;
+      case DEFER_ENV_STOP:
+         _nvc_env_stop(op->args[0], op->args[1], op->args[2]);
+         break;
+      case DEFER_TRACE:
+         rt_print_trace((void *const *)op->data,
+                        op->length / sizeof(void *));
+         break;
+      case DEFER_FATAL:
+         rt_fatal(op->args[0] ? (const rt_loc_t *)op->data : NULL,
+                  "%s", (const char *)op->data + sizeof(rt_loc_t));
+         break;
+      case DEFER_NOP:
+         break;
+      }
+
+      p += sizeof(defer_op_t) + ((op->length + 7) & ~7);
+   }
+
+   replaying = false;
+}
+
+static void rt_batch_add(rt_proc_t *proc, sens_list_t *entry, event_t *event)
+{
+   if (unlikely(batch_len == batch_alloc)) {
+      batch_alloc = MAX(batch_alloc * 2, 64);
+      batch = xrealloc(batch, batch_alloc * sizeof(batch_item_t));
+   }
+
+   batch_item_t *item = &(batch[batch_len++]);
+   item->proc  = proc;
+   item->entry = entry;
+   item->event = event;
+   item->log   = NULL;
+}
+
+static uint64_t rt_run_batch_items(defer_log_t *log)
+{
+   defer_log = log;
+
+   uint64_t nprocs = 0;
+   size_t i;
+   while ((i = __atomic_fetch_add(&batch_next, 1, __ATOMIC_RELAXED))
+          < batch_len) {
+      batch_item_t *item = &(batch[i]);
+      item->log       = log;
+      item->log_start = log->len;
+      active_item = item;
+      rt_run(item->proc, false /* reset */);
+      item->log_end   = log->len;
+      nprocs++;
+   }
+
+   active_item = NULL;
+   defer_log = NULL;
+   return nprocs;
+}
+
+#if RT_MULTITHREAD
+static void *rt_worker_thread(void *arg)
+{
+   rt_worker_t *w = arg;
+   is_worker = true;
+
+   proc_tmp_stack = rt_tmp_stack_get("process temp stack");
+
+   unsigned gen = 0;
+   for (;;) {
+      pthread_mutex_lock(&batch_lock);
+      while (batch_gen == gen && !workers_exit)
+         pthread_cond_wait(&batch_start_cv, &batch_lock);
+      const bool stop = workers_exit;
+      gen = batch_gen;
+      pthread_mutex_unlock(&batch_lock);
+
+      if (stop)
+         break;
+
+      if (cover_shards != NULL) {
+         int32_t *shard = cover_shards[w - workers];
+         _cover_stmts = shard;
+         _cover_conds = shard + cover_nstmts;
+      }
+
+      // Each worker counts into its own slot which is added to the
+      // totals when the workers stop
+      w->procs += rt_run_batch_items(&(w->log));
+
+      pthread_mutex_lock(&batch_lock);
+      if (++batch_finished == n_workers)
+         pthread_cond_signal(&batch_done_cv);
+      pthread_mutex_unlock(&batch_lock);
+   }
+
+   slab_flush_thread();
+   return NULL;
+}
+
+static void rt_start_workers(int nthreads)
+{
+   n_workers = nthreads - 1;
+   workers = xcalloc(n_workers * sizeof(rt_worker_t));
+   workers_exit = false;
+
+   for (int i = 0; i < n_workers; i++) {
+      if (pthread_create(&(workers[i].thread), NULL,
+                         rt_worker_thread, &(workers[i])) != 0)
+         fatal_errno("pthread_create");
+   }
+}
+
+static void rt_stop_workers(void)
+{
+   pthread_mutex_lock(&batch_lock);
+   workers_exit = true;
+   pthread_cond_broadcast(&batch_start_cv);
+   pthread_mutex_unlock(&batch_lock);
+
+   for (int i = 0; i < n_workers; i++) {
+      pthread_join(workers[i].thread, NULL);
+      stats.worker_procs += workers[i].procs;
+      free(workers[i].log.buf);
+   }
+
+   free(workers);
+   workers = NULL;
+   n_workers = 0;
+}
+#endif  // RT_MULTITHREAD
+
+static void rt_run_batch(void)
+{
+   // Run all the processes in the batch and then replay their side
+   // effects in batch order
+
+   batch_next = 0;
+   main_log.len = 0;
+
+#if RT_MULTITHREAD
+   batch_parallel = batch_len > 1;
+   if (batch_parallel) {
+      stats.batches++;
+      stats.batch_procs += batch_len;
+
+      pthread_mutex_lock(&batch_lock);
+      for (int i = 0; i < n_workers; i++)
+         workers[i].log.len = 0;
+      batch_finished = 0;
+      batch_gen++;
+      pthread_cond_broadcast(&batch_start_cv);
+      pthread_mutex_unlock(&batch_lock);
+
+      rt_run_batch_items(&main_log);
+
+      pthread_mutex_lock(&batch_lock);
+      while (batch_finished < n_workers)
+         pthread_cond_wait(&batch_done_cv, &batch_lock);
+      pthread_mutex_unlock(&batch_lock);
+   }
+   else
+#endif
+      rt_run_batch_items(&main_log);
+}
+
+static void rt_run_queue_batch(event_t *first)
+{
+   // Execute a sequence of consecutive process wakeups from the run queue
+   // as a single batch
+
+   batch_len = 0;
+   rt_batch_add(first->proc, NULL, first);
+
+   while (run_queue.rd < run_queue.wr) {
+      event_t *e = run_queue.queue[run_queue.rd];
+      if (e->kind != E_PROCESS)
+         break;
+
+      rt_batch_add(e->proc, NULL, e);
+      run_queue.rd++;
+   }
+
+   rt_run_batch();
+
+   for (size_t i = 0; i < batch_len; i++) {
+      rt_replay_deferred(&(batch[i]));
+      rt_free(event_stack, batch[i].event);
+   }
+
+   batch_len = 0;
+}
+
 static int32_t rt_resolve_group(netgroup_t *group, int driver, void *values)
 {
    // Set driver to -1 for initial call to resolution function
@@ -1678,11 +2767,13 @@ static int32_t rt_resolve_group(netgroup_t *group, int driver, void *values)
    else if ((group->resolution->flags & R_IDENT) && (group->n_drivers == 1)) {
       // Resolution function behaves like identity for a single driver
       resolved = values;
+      stats.res_memo_hits++;
    }
    else if ((group->resolution->flags & R_MEMO) && (group->n_drivers == 1)) {
       // Resolution function has been memoised so do a table lookup
 
       resolved = alloca(valuesz);
+      stats.res_memo_hits++;
 
       for (int j = 0; j < group->length; j++) {
          const int index = { ((const char *)values)[j] };
@@ -1694,6 +2785,7 @@ static int32_t rt_resolve_group(netgroup_t *group, int driver, void *values)
       // Resolution function has been memoised so do a table lookup
 
       resolved = alloca(valuesz);
+      stats.res_memo_hits++;
 
       const char *p0 = group->drivers[0].waveforms->values->data;
       const char *p1 = group->drivers[1].waveforms->values->data;
@@ -1707,6 +2799,27 @@ static int32_t rt_resolve_group(netgroup_t *group, int driver, void *values)
          ((int8_t *)resolved)[j] = r;
       }
    }
+   else if ((group->resolution->flags & R_FOLD) && (group->n_drivers > 2)
+            && (group->n_drivers <= group->resolution->fold_max)) {
+      // Resolution function agrees with folding each driver into the
+      // result using the two value table
+
+      int8_t *r = resolved = alloca(valuesz);
+      const int8_t (*tab2)[16] = group->resolution->tab2;
+      stats.res_memo_hits++;
+
+      for (int i = 0; i < group->n_drivers; i++) {
+         const int8_t *p = (i == driver)
+            ? values : (int8_t *)group->drivers[i].waveforms->values->data;
+
+         if (i == 0)
+            memcpy(r, p, group->length);
+         else {
+            for (int j = 0; j < group->length; j++)
+               r[j] = tab2[(int)r[j]][(int)p[j]];
+         }
+      }
+   }
    else if (group->resolution->flags & R_RECORD) {
       // Call resolution function for resolved record
 
@@ -1760,6 +2873,8 @@ static int32_t rt_resolve_group(netgroup_t *group, int driver, void *values)
          offset += p->length;
       }
 
+      stats.res_calls++;
+
       uint8_t *result =
          (uint8_t *)(*group->resolution->fn)(inputs, group->n_drivers);
       resolved = result + group_off;
@@ -1768,6 +2883,7 @@ static int32_t rt_resolve_group(netgroup_t *group, int driver, void *values)
       // Must actually call resolution function in general case
 
       resolved = alloca(valuesz);
+      stats.res_calls += group->length;
 
       for (int j = 0; j < group->length; j++) {
 #define CALL_RESOLUTION_FN(type) do {                                   \
@@ -1798,19 +2914,77 @@ static int32_t rt_resolve_group(netgroup_t *group, int driver, void *values)
          memcpy(group->last_value, group->resolved, valuesz);
       memcpy(group->resolved, resolved, valuesz);
 
-      group->last_event = now;
+      rt_group_cold(group)->last_event = now;
    }
 
    return new_flags;
 }
 
+static bool rt_resolve_initial_cached(netgroup_t *g)
+{
+   // Groups with the same resolution function, number of drivers and
+   // initial values always resolve to the same value so the function
+   // only needs to be called for the first of them. This only holds if
+   // the function is pure which is known for a memoised function as no
+   // side effect occurred while building its tables
+
+   const size_t valuesz = g->size * g->length;
+   const size_t nbytes = valuesz * (g->n_drivers + 1);
+
+   if (!(g->resolution->flags & R_MEMO) || (g->resolution->flags & R_RECORD)
+       || nbytes > INIT_RES_MAX_BYTES)
+      return false;
+
+   uint8_t inputs[INIT_RES_MAX_BYTES];
+   memcpy(inputs, g->resolved, valuesz);
+   for (int i = 0; i < g->n_drivers; i++)
+      memcpy(inputs + (i + 1) * valuesz,
+             g->drivers[i].waveforms->values->data, valuesz);
+
+   uint32_t hash = (uintptr_t)g->resolution >> 4;
+   hash = hash * 31 + g->n_drivers;
+   hash = hash * 31 + g->length;
+   for (size_t i = 0; i < nbytes; i++)
+      hash = hash * 31 + inputs[i];
+
+   init_res_t *e = &(init_res_cache[hash % INIT_RES_CACHE_SIZE]);
+
+   if (e->memo == g->resolution && e->n_drivers == g->n_drivers
+       && e->size == g->size && e->length == g->length
+       && memcmp(e->inputs, inputs, nbytes) == 0) {
+      if (memcmp(g->resolved, e->result, valuesz) != 0) {
+         if (g->flags & NET_F_LAST_VALUE)
+            memcpy(g->last_value, g->resolved, valuesz);
+         memcpy(g->resolved, e->result, valuesz);
+
+         rt_group_cold(g)->last_event = now;
+      }
+
+      stats.res_init_hits++;
+      return true;
+   }
+
+   rt_resolve_group(g, -1, g->resolved);
+
+   e->memo      = g->resolution;
+   e->n_drivers = g->n_drivers;
+   e->size      = g->size;
+   e->length    = g->length;
+   memcpy(e->inputs, inputs, nbytes);
+   memcpy(e->result, g->resolved, valuesz);
+
+   return true;
+}
+
 static void rt_group_inital(groupid_t gid, netid_t first, unsigned length)
 {
    netgroup_t *g = &(groups[gid]);
    if ((g->n_drivers == 1) && (g->resolution == NULL))
       rt_resolve_group(g, -1, g->drivers[0].waveforms->values->data);
-   else if (g->n_drivers > 0)
-      rt_resolve_group(g, -1, g->resolved);
+   else if (g->n_drivers > 0) {
+      if (g->resolution == NULL || !rt_resolve_initial_cached(g))
+         rt_resolve_group(g, -1, g->resolved);
+   }
 }
 
 static void rt_initial(tree_t top)
@@ -1826,18 +3000,26 @@ static void rt_initial(tree_t top)
 
    rt_call_module_reset(tree_ident(top));
 
-   for (size_t i = 0; i < n_procs; i++)
-      rt_run(&procs[i], true /* reset */);
+   // Processes owned by another node are never run so they have no
+   // drivers or sensitivity here
+
+   for (size_t i = 0; i < n_procs; i++) {
+      if (likely(!procs[i].remote))
+         rt_run(&procs[i], true /* reset */);
+   }
 
    TRACE("calculate initial driver values");
 
    init_side_effect = SIDE_EFFECT_ALLOW;
+   init_res_cache = xcalloc(INIT_RES_CACHE_SIZE * sizeof(init_res_t));
    netdb_walk(netdb, rt_group_inital);
+   free(init_res_cache);
+   init_res_cache = NULL;
 
    TRACE("used %d bytes of global temporary stack", global_tmp_alloc);
 }
 
-static void rt_watch_signal(watch_t *w)
+static void rt_watch_signal(watch_t *w, bool notify)
 {
    const int nnets = tree_nets(w->signal);
    int offset = 0;
@@ -1845,23 +3027,32 @@ static void rt_watch_signal(watch_t *w)
       netid_t nid = tree_net(w->signal, offset);
       netgroup_t *g = &(groups[netdb_lookup(netdb, nid)]);
 
-      watch_list_t *link = xmalloc(sizeof(watch_list_t));
-      link->next  = g->watching;
-      link->watch = w;
+      if (notify) {
+         watch_list_t *link = xmalloc(sizeof(watch_list_t));
+         netgroup_cold_t *cold = rt_group_cold(g);
+         link->next  = cold->watching;
+         link->watch = w;
+         link->index = w->n_groups;
 
-      g->watching = link;
+         cold->watching = link;
+      }
 
       offset += g->length;
+      w->nbytes += g->size * g->length;
       (w->n_groups)++;
    }
 
-   w->groups = xmalloc(sizeof(netgroup_t *) * w->n_groups);
+   w->groups     = xmalloc(sizeof(netgroup_t *) * w->n_groups);
+   w->first      = xmalloc(sizeof(int) * w->n_groups);
+   w->changed    = xmalloc(sizeof(int) * w->n_groups);
+   w->is_changed = xcalloc(sizeof(bool) * w->n_groups);
 
    int ptr = 0;
    offset = 0;
    while (offset < nnets) {
       netid_t nid = tree_net(w->signal, offset);
       netgroup_t *g = &(groups[netdb_lookup(netdb, nid)]);
+      w->first[ptr] = offset;
       w->groups[ptr++] = g;
       w->length += g->length;
       offset += g->length;
@@ -1878,7 +3069,10 @@ static void rt_wakeup(sens_list_t *sl)
    // generation: these correspond to stale "wait on" statements that
    // have already resumed.
 
-   if (sl->wakeup_gen == sl->proc->wakeup_gen || sl->reenq != NULL) {
+   // Processes replaced by a native clock never resume
+
+   if ((sl->wakeup_gen == sl->proc->wakeup_gen || sl->reenq != NULL)
+       && likely(!sl->proc->native)) {
       TRACE("wakeup process %s%s", istr(tree_ident(sl->proc->source)),
             sl->proc->postponed ? " [postponed]" : "");
       ++(sl->proc->wakeup_gen);
@@ -1887,6 +3081,12 @@ static void rt_wakeup(sens_list_t *sl)
          sl->next  = postponed;
          postponed = sl;
       }
+      else if (sl->proc->level >= 0) {
+         if (!sl->proc->pending)
+            stats.region_procs++;
+         sl->next = region[sl->proc->level];
+         region[sl->proc->level] = sl;
+      }
       else {
          sl->next = resume;
          resume = sl;
@@ -1898,24 +3098,26 @@ static void rt_wakeup(sens_list_t *sl)
       rt_free(sens_list_stack, sl);
 }
 
-static bool rt_sched_driver(netgroup_t *group, uint64_t after,
+static int rt_driver_index(netgroup_t *group, rt_proc_t *proc)
+{
+   if (likely(group->n_drivers == 1))
+      return 0;
+
+   uintptr_t driver = 0;
+   if (likely(proc->drivers != NULL))
+      driver = (uintptr_t)hash_get(proc->drivers, group);
+
+   RT_ASSERT(driver != 0);
+   return driver - 1;
+}
+
+static bool rt_sched_driver(netgroup_t *group, int driver, uint64_t after,
                             uint64_t reject, value_t *values)
 {
    if (unlikely(reject > after))
       fatal("signal %s pulse reject limit %s is greater than "
             "delay %s", fmt_group(group), fmt_time(reject), fmt_time(after));
 
-   int driver = 0;
-   if (unlikely(group->n_drivers != 1)) {
-      // Try to find this process in the list of existing drivers
-      for (driver = 0; driver < group->n_drivers; driver++) {
-         if (likely(group->drivers[driver].proc == active_proc))
-            break;
-      }
-
-      RT_ASSERT(driver != group->n_drivers);
-   }
-
    driver_t *d = &(group->drivers[driver]);
 
    const size_t valuesz = group->size * group->length;
@@ -1994,51 +3196,64 @@ static void rt_update_group(netgroup_t *group, int driver, void *values)
          group->pending = next;
       }
 
-      // Now check the global pending list
+      // Now check the lists in the global pending index for each block
+      // of nets which overlaps this group
       if (group->flags & NET_F_GLOBAL) {
-         for (it = pending; it != NULL; it = next) {
-            next = it->next;
-
-            const netid_t x = group->first;
-            const netid_t y = group->first + group->length - 1;
-            const netid_t a = it->first;
-            const netid_t b = it->last;
-
-            const bool hit = (x <= b) && (a <= y);
-
-            if (hit) {
-               rt_wakeup(it);
-               if (last == NULL)
-                  pending = next;
-               else
-                  last->next = next;
+         const netid_t x = group->first;
+         const netid_t y = group->first + group->length - 1;
+
+         for (int level = 0; level < PENDING_LEVELS; level++) {
+            if (!(pending_levels & (UINT64_C(1) << level)))
+               continue;
+
+            const uint64_t bmax = (uint64_t)y >> level;
+            for (uint64_t blk = (uint64_t)x >> level; blk <= bmax; blk++) {
+               sens_list_t **list = &(pending[level][blk]);
+               for (it = *list, last = NULL; it != NULL; it = next) {
+                  next = it->next;
+
+                  const netid_t a = it->first;
+                  const netid_t b = it->last;
+
+                  const bool hit = (x <= b) && (a <= y);
+
+                  if (hit) {
+                     rt_wakeup(it);
+                     if (last == NULL)
+                        *list = next;
+                     else
+                        last->next = next;
+                  }
+                  else
+                     last = it;
+               }
             }
-            else
-               last = it;
          }
       }
 
-      // Schedule any callbacks to run
-      for (watch_list_t *wl = group->watching; wl != NULL; wl = wl->next) {
-         if (!wl->watch->pending) {
-            wl->watch->chain_pending = callbacks;
-            wl->watch->pending = true;
-            callbacks = wl->watch;
+      // Schedule any callbacks to run and note which part of each
+      // watched signal changed
+      watch_list_t *wl = rt_group_cold(group)->watching;
+      for (; wl != NULL; wl = wl->next) {
+         watch_t *w = wl->watch;
+         if (!w->is_changed[wl->index]) {
+            w->is_changed[wl->index] = true;
+            w->changed[(w->n_changed)++] = wl->index;
+         }
+
+         if (!w->pending) {
+            w->chain_pending = callbacks;
+            w->pending = true;
+            callbacks = w;
          }
       }
    }
 }
 
-static void rt_update_driver(netgroup_t *group, rt_proc_t *proc)
+static void rt_update_driver(netgroup_t *group, rt_proc_t *proc, int driver)
 {
    if (likely(proc != NULL)) {
-      // Find the driver owned by proc
-      int driver;
-      for (driver = 0; driver < group->n_drivers; driver++) {
-         if (likely(group->drivers[driver].proc == proc))
-            break;
-      }
-      RT_ASSERT(driver != group->n_drivers);
+      RT_ASSERT(group->drivers[driver].proc == proc);
 
       waveform_t *w_now  = group->drivers[driver].waveforms;
       waveform_t *w_next = w_now->next;
@@ -2048,6 +3263,9 @@ static void rt_update_driver(netgroup_t *group, rt_proc_t *proc)
          group->drivers[driver].waveforms = w_next;
          rt_free_value(group, w_now->values);
          rt_free(waveform_stack, w_now);
+
+         if (unlikely(group->flags & NET_F_CLOCK))
+            rt_clock_tick(group, proc->clock);
       }
       else
          RT_ASSERT(w_now != NULL);
@@ -2056,9 +3274,21 @@ static void rt_update_driver(netgroup_t *group, rt_proc_t *proc)
       rt_update_group(group, -1, group->forcing->data);
 }
 
-static bool rt_stale_event(event_t *e)
+static void rt_update_driver_run(event_t *e)
 {
-   return (e->kind == E_PROCESS) && (e->wakeup_gen != e->proc->wakeup_gen);
+   // Driver events may cover a run of adjacent groups scheduled by the
+   // same signal assignment: any group in the run whose transaction has
+   // since been deleted is skipped by rt_update_driver
+
+   netgroup_t *g = e->group;
+   rt_update_driver(g, e->proc, e->driver);
+
+   for (unsigned i = 1; i < e->ngroups; i++) {
+      g = &(groups[netdb_lookup(netdb, g->first + g->length)]);
+      rt_update_driver(g, e->proc, rt_driver_index(g, e->proc));
+   }
+
+   stats.driver_groups += e->ngroups;
 }
 
 static void rt_push_run_queue(event_t *e)
@@ -2075,13 +3305,18 @@ static void rt_push_run_queue(event_t *e)
       }
    }
 
-   if (unlikely(rt_stale_event(e)))
+   if (unlikely(rt_stale_event(e))) {
+      stats.stale_events++;
       rt_free(event_stack, e);
+   }
    else {
       run_queue.queue[(run_queue.wr)++] = e;
       if (e->kind == E_PROCESS)
          ++(e->proc->wakeup_gen);
    }
+
+   if (run_queue.wr - run_queue.rd > stats.peak_run_queue)
+      stats.peak_run_queue = run_queue.wr - run_queue.rd;
 }
 
 static event_t *rt_pop_run_queue(void)
@@ -2091,8 +3326,22 @@ static event_t *rt_pop_run_queue(void)
       run_queue.rd = 0;
       return NULL;
    }
-   else
-      return run_queue.queue[(run_queue.rd)++];
+
+   // Start loading the state the next event will touch while this one
+   // runs as draining the queue otherwise stalls on each group or
+   // process in turn
+   if (run_queue.rd + 1 < run_queue.wr) {
+      const event_t *next = run_queue.queue[run_queue.rd + 1];
+      if (next->kind == E_DRIVER)
+         __builtin_prefetch(next->group);
+      else if (next->kind == E_PROCESS)
+         __builtin_prefetch(next->proc);
+   }
+
+   if (run_queue.rd + 2 < run_queue.wr)
+      __builtin_prefetch(run_queue.queue[run_queue.rd + 2]);
+
+   return run_queue.queue[(run_queue.rd)++];
 }
 
 static void rt_iteration_limit(void)
@@ -2116,9 +3365,26 @@ static void rt_iteration_limit(void)
 
 static void rt_resume_processes(sens_list_t **list)
 {
+   size_t next_item = 0;
+   batch_len = 0;
+
+   if (n_workers > 0) {
+      for (sens_list_t *it = *list; it != NULL; it = it->next) {
+         if (it->proc->pending) {
+            rt_batch_add(it->proc, it, NULL);
+            it->proc->pending = false;
+         }
+      }
+
+      if (batch_len > 0)
+         rt_run_batch();
+   }
+
    sens_list_t *it = *list;
    while (it != NULL) {
-      if (it->proc->pending) {
+      if (next_item < batch_len && batch[next_item].entry == it)
+         rt_replay_deferred(&(batch[next_item++]));
+      else if (it->proc->pending) {
          rt_run(it->proc, false /* reset */);
          it->proc->pending = false;
       }
@@ -2136,6 +3402,364 @@ static void rt_resume_processes(sens_list_t **list)
    }
 
    *list = NULL;
+   batch_len = 0;
+}
+
+static void rt_run_region(void)
+{
+   // Evaluate the combinational processes woken in this cycle one level
+   // at a time and apply their zero delay transactions straight away so
+   // the next level sees the new values without another delta cycle
+
+   for (int i = 0; i < n_levels; i++) {
+      if (region[i] == NULL)
+         continue;
+
+      TRACE("run region level %d", i);
+
+      region_running = true;
+      rt_resume_processes(&(region[i]));
+      region_running = false;
+
+      event_t *e = region_driver;
+      region_driver = NULL;
+
+      while (e != NULL) {
+         event_t *next = e->delta_chain;
+         stats.events[E_DRIVER]++;
+         rt_update_driver_run(e);
+         rt_free(event_stack, e);
+         e = next;
+      }
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Waveform writer thread
+//
+// Waveform callbacks are not run on the simulation thread. Instead the
+// values of each watched signal are copied into a ring buffer along with
+// the time and the watch and a separate thread calls the callback which
+// formats and writes them. The callback sees the copied values through
+// rt_watch_value and rt_watch_string. Records are handed over to the
+// writer in batches to avoid waking it every time step and when the ring
+// is full the simulation waits for the writer to catch up.
+
+#if RT_MULTITHREAD
+
+static void *rt_wave_thread_fn(void *arg)
+{
+   size_t rd = wave_rd;
+   for (;;) {
+      const size_t wr = __atomic_load_n(&wave_wr, __ATOMIC_ACQUIRE);
+      if (rd == wr) {
+         pthread_mutex_lock(&wave_lock);
+         while (rd == __atomic_load_n(&wave_wr, __ATOMIC_ACQUIRE)
+                && !wave_exit)
+            pthread_cond_wait(&wave_data_cv, &wave_lock);
+         const bool stop = (rd == wave_wr) && wave_exit;
+         pthread_mutex_unlock(&wave_lock);
+
+         if (stop)
+            break;
+         else
+            continue;
+      }
+
+      while (rd != wr) {
+         const size_t offset = rd % WAVE_RING_SIZE;
+         const wave_record_t *r = (wave_record_t *)(wave_ring + offset);
+
+         if (WAVE_RING_SIZE - offset < sizeof(wave_record_t)
+             || r->watch == NULL) {
+            // Padding at the end of the ring
+            rd += WAVE_RING_SIZE - offset;
+            continue;
+         }
+
+         // The indices of the changed groups are followed by the values
+         watch_t *w = r->watch;
+         wave_changed   = (const int *)(r + 1);
+         wave_n_changed = r->n_changed;
+         wave_values    = (const char *)(r + 1)
+            + ((r->n_changed * sizeof(int) + 7) & ~7);
+         (*w->fn)(r->when, w->signal, w, w->user_data);
+         wave_values = NULL;
+
+         rd += r->size;
+         __atomic_store_n(&wave_rd, rd, __ATOMIC_SEQ_CST);
+
+         if (__atomic_load_n(&wave_full, __ATOMIC_SEQ_CST)) {
+            pthread_mutex_lock(&wave_lock);
+            pthread_cond_signal(&wave_space_cv);
+            pthread_mutex_unlock(&wave_lock);
+         }
+      }
+   }
+
+   return NULL;
+}
+
+static void rt_wave_publish(bool force)
+{
+   if (wave_pos == wave_wr)
+      return;
+   else if (!force && wave_pos - wave_wr < WAVE_BATCH_SIZE)
+      return;
+
+   pthread_mutex_lock(&wave_lock);
+   __atomic_store_n(&wave_wr, wave_pos, __ATOMIC_RELEASE);
+   pthread_cond_signal(&wave_data_cv);
+   pthread_mutex_unlock(&wave_lock);
+}
+
+static bool rt_wave_has_space(size_t need)
+{
+   return wave_pos + need - __atomic_load_n(&wave_rd, __ATOMIC_SEQ_CST)
+      <= WAVE_RING_SIZE;
+}
+
+static void rt_wave_wait(size_t need)
+{
+   rt_wave_publish(true);
+
+   pthread_mutex_lock(&wave_lock);
+   __atomic_store_n(&wave_full, true, __ATOMIC_SEQ_CST);
+   while (!rt_wave_has_space(need))
+      pthread_cond_wait(&wave_space_cv, &wave_lock);
+   __atomic_store_n(&wave_full, false, __ATOMIC_SEQ_CST);
+   pthread_mutex_unlock(&wave_lock);
+}
+
+static void rt_wave_flush(void)
+{
+   // Wait for the writer to process every record so the waveform
+   // callbacks can safely be called from this thread
+
+   if (wave_running)
+      rt_wave_wait(WAVE_RING_SIZE);
+}
+
+static void rt_wave_stop(void)
+{
+   if (!wave_running)
+      return;
+
+   rt_wave_publish(true);
+
+   pthread_mutex_lock(&wave_lock);
+   wave_exit = true;
+   pthread_cond_signal(&wave_data_cv);
+   pthread_mutex_unlock(&wave_lock);
+
+   if (pthread_join(wave_thread, NULL) != 0)
+      fatal_errno("pthread_join");
+
+   wave_running = false;
+}
+
+static void rt_wave_start(void)
+{
+   if (wave_ring == NULL)
+      wave_ring = xmalloc(WAVE_RING_SIZE);
+
+   wave_exit = false;
+
+   if (pthread_create(&wave_thread, NULL, rt_wave_thread_fn, NULL) != 0)
+      fatal_errno("pthread_create");
+
+   // Make sure the writer finishes before the waveform files are closed
+   static bool registered = false;
+   if (!registered) {
+      atexit(rt_wave_stop);
+      registered = true;
+   }
+
+   wave_running = true;
+}
+
+static void rt_wave_push(watch_t *w)
+{
+   const size_t changedsz = (w->n_changed * sizeof(int) + 7) & ~7;
+   const size_t size = (sizeof(wave_record_t) + changedsz + w->nbytes + 7) & ~7;
+
+   if (unlikely(size > WAVE_RING_SIZE / 4)) {
+      // Too large to copy into the ring
+      rt_wave_flush();
+      (*w->fn)(now, w->signal, w, w->user_data);
+      return;
+   }
+
+   if (unlikely(!wave_running))
+      rt_wave_start();
+
+   const size_t offset = wave_pos % WAVE_RING_SIZE;
+   const size_t pad = (offset + size > WAVE_RING_SIZE)
+      ? WAVE_RING_SIZE - offset : 0;
+
+   if (unlikely(!rt_wave_has_space(pad + size))) {
+      stats.wave_stalls++;
+      rt_wave_wait(pad + size);
+   }
+
+   if (pad > 0) {
+      if (pad >= sizeof(wave_record_t))
+         ((wave_record_t *)(wave_ring + offset))->watch = NULL;
+      wave_pos += pad;
+   }
+
+   wave_record_t *r = (wave_record_t *)(wave_ring + wave_pos % WAVE_RING_SIZE);
+   r->when      = now;
+   r->watch     = w;
+   r->size      = size;
+   r->n_changed = w->n_changed;
+
+   memcpy(r + 1, w->changed, w->n_changed * sizeof(int));
+
+   char *p = (char *)(r + 1) + changedsz;
+   for (int i = 0; i < w->n_groups; i++) {
+      netgroup_t *g = w->groups[i];
+      const size_t nbytes = g->size * g->length;
+      memcpy(p, g->resolved, nbytes);
+      p += nbytes;
+   }
+
+   wave_pos += size;
+   stats.wave_records++;
+}
+
+#else  // RT_MULTITHREAD
+
+static void rt_wave_flush(void)
+{
+}
+
+static void rt_wave_stop(void)
+{
+}
+
+static void rt_wave_publish(bool force)
+{
+}
+
+static void rt_wave_push(watch_t *w)
+{
+   (*w->fn)(now, w->signal, w, w->user_data);
+}
+
+#endif  // RT_MULTITHREAD
+
+////////////////////////////////////////////////////////////////////////////////
+// Waveform capture window
+//
+// Waveform output starts when the capture window opens which is at time
+// zero by default. The headers and the initial value of each signal are
+// written then and the waveform callbacks are only attached at that
+// point. When the window closes the callbacks are detached from every
+// signal so there is no cost per event outside the window. Requests to
+// start or stop are acted on between the event and process phases of a
+// cycle where the callback lists are not in use. Capture only happens
+// once per run and the state is reset by rt_restart.
+
+static void rt_wave_begin(void)
+{
+   if (capture_state != CAPTURE_IDLE)
+      return;
+
+   TRACE("start waveform capture");
+
+   rt_wave_flush();
+   vcd_restart();
+   lxt_restart();
+   fst_restart();
+   nvt_restart();
+
+   capture_state = CAPTURE_ON;
+}
+
+static void rt_wave_end(void)
+{
+   if (capture_state != CAPTURE_ON)
+      return;
+
+   TRACE("stop waveform capture");
+
+   rt_wave_flush();
+
+   watch_t **last = &callbacks;
+   for (watch_t *it = callbacks; it != NULL; it = *last) {
+      if (it->wave) {
+         *last = it->chain_pending;
+         it->chain_pending = NULL;
+      }
+      else
+         last = &(it->chain_pending);
+   }
+
+   for (watch_t *w = watches; w != NULL; w = w->chain_all) {
+      if (!w->wave)
+         continue;
+
+      for (int i = 0; i < w->n_groups; i++) {
+         watch_list_t **wl = &(rt_group_cold(w->groups[i])->watching);
+         while (*wl != NULL) {
+            if ((*wl)->watch == w) {
+               watch_list_t *tmp = *wl;
+               *wl = tmp->next;
+               free(tmp);
+            }
+            else
+               wl = &((*wl)->next);
+         }
+      }
+   }
+
+   capture_state = CAPTURE_DONE;
+}
+
+static void rt_wave_capture(void)
+{
+   const capture_req_t req = capture_req;
+   capture_req = CAPTURE_REQ_NONE;
+
+   if (req == CAPTURE_REQ_START)
+      rt_wave_begin();
+   else if (req == CAPTURE_REQ_STOP)
+      rt_wave_end();
+}
+
+static void rt_wave_window_cb(uint64_t when, void *user)
+{
+   rt_set_wave_capture(user != NULL);
+}
+
+static void rt_wave_restart(void)
+{
+   // Open the capture window now or arrange for it to open later
+
+   if (now >= capture_to)
+      return;
+   else if (!capture_on_assert) {
+      if (now >= capture_from)
+         rt_set_wave_capture(true);
+      else
+         rt_set_timeout_cb(capture_from - now, rt_wave_window_cb, (void *)1);
+   }
+
+   if (capture_to != UINT64_MAX)
+      rt_set_timeout_cb(capture_to - now, rt_wave_window_cb, NULL);
+}
+
+void rt_set_wave_capture(bool enable)
+{
+   capture_req = enable ? CAPTURE_REQ_START : CAPTURE_REQ_STOP;
+}
+
+void rt_set_wave_window(uint64_t from, uint64_t to, bool on_assert)
+{
+   capture_from      = from;
+   capture_to        = to;
+   capture_on_assert = on_assert;
 }
 
 static void rt_event_callback(bool postponed)
@@ -2145,15 +3769,24 @@ static void rt_event_callback(bool postponed)
    for (it = callbacks; it != NULL; it = next) {
       next = it->chain_pending;
       if (it->postponed == postponed) {
-         (*it->fn)(now, it->signal, it, it->user_data);
+         if (it->deferred)
+            rt_wave_push(it);
+         else
+            (*it->fn)(now, it->signal, it, it->user_data);
          it->pending = false;
 
+         for (int i = 0; i < it->n_changed; i++)
+            it->is_changed[it->changed[i]] = false;
+         it->n_changed = 0;
+
          *last = it->chain_pending;
          it->chain_pending = NULL;
       }
       else
          last = &(it->chain_pending);
    }
+
+   rt_wave_publish(false);
 }
 
 static inline bool rt_next_cycle_is_delta(void)
@@ -2161,280 +3794,1620 @@ static inline bool rt_next_cycle_is_delta(void)
    return (delta_driver != NULL) || (delta_proc != NULL);
 }
 
-static void rt_cycle(int stop_delta)
+////////////////////////////////////////////////////////////////////////////////
+// Sampling profiler
+//
+// A profiling timer interrupts the simulation at a fixed rate and the
+// signal handler records the running process and the return addresses on
+// the stack in a ring buffer. The unwinder steps through the signal frame
+// so the interrupted function is included. The buffer is drained at the
+// end of each cycle and the samples are aggregated by call stack with
+// frames mapped back to VHDL subprograms. The result is written in the
+// folded stack format used by flame graph tools.
+
+#define PROF_DEPTH     16
+#define PROF_RING_SZ   4096
+#define PROF_PERIOD_US 1000
+
+typedef struct {
+   rt_proc_t *proc;
+   void      *pcs[PROF_DEPTH];
+   int        depth;
+   bool       valid;
+} prof_sample_t;
+
+static prof_sample_t *prof_ring = NULL;
+static unsigned       prof_head = 0;
+static unsigned       prof_tail = 0;
+static unsigned       prof_dropped = 0;
+static hash_t        *prof_stacks = NULL;
+static const char    *prof_file = NULL;
+
+#if !defined __MINGW32__ && defined HAVE_EXECINFO_H
+static void rt_prof_sighandler(int sig, siginfo_t *info, void *context)
 {
-   // Simulation cycle is described in LRM 93 section 12.6.4
-
-   const bool is_delta_cycle = (delta_driver != NULL) || (delta_proc != NULL);
-
-   if (is_delta_cycle)
-      iteration = iteration + 1;
-   else {
-      event_t *peek = heap_min(eventq_heap);
-      while (unlikely(rt_stale_event(peek))) {
-         // Discard stale events
-         rt_free(event_stack, heap_extract_min(eventq_heap));
-         if (heap_size(eventq_heap) == 0)
-            return;
-         else
-            peek = heap_min(eventq_heap);
-      }
-      now = peek->when;
-      iteration = 0;
+   const unsigned slot = __sync_fetch_and_add(&prof_head, 1);
+   if (slot - prof_tail >= PROF_RING_SZ) {
+      __sync_fetch_and_add(&prof_dropped, 1);
+      __sync_fetch_and_sub(&prof_head, 1);
+      return;
    }
 
-   TRACE("begin cycle");
+   prof_sample_t *s = &(prof_ring[slot % PROF_RING_SZ]);
+   s->proc  = active_proc;
+   s->depth = backtrace(s->pcs, PROF_DEPTH);
 
-#if TRACE_DELTAQ > 0
-   if (trace_on)
-      deltaq_dump();
-#endif
-#if TRACE_PENDING > 0
-   if (trace_on)
-      rt_dump_pending();
+   __sync_synchronize();
+   s->valid = true;
+}
 #endif
 
-   if (is_delta_cycle) {
-      for (event_t *e = delta_driver; e != NULL; e = e->delta_chain)
-         rt_push_run_queue(e);
+static void rt_prof_drain(void)
+{
+   LOCAL_TEXT_BUF tb = tb_new();
 
-      for (event_t *e = delta_proc; e != NULL; e = e->delta_chain)
-         rt_push_run_queue(e);
+   while (prof_tail != prof_head) {
+      prof_sample_t *s = &(prof_ring[prof_tail % PROF_RING_SZ]);
+      if (!s->valid)
+         break;   // Signal handler is still writing this sample
 
-      delta_driver = NULL;
-      delta_proc = NULL;
-   }
-   else {
-      rt_global_event(RT_NEXT_TIME_STEP);
+      // Frames are written outermost first starting with the process
 
-      for (;;) {
-         rt_push_run_queue(heap_extract_min(eventq_heap));
+      tb_rewind(tb);
 
-         if (heap_size(eventq_heap) == 0)
-            break;
+      if (s->proc != NULL)
+         tb_printf(tb, "%s", istr(tree_ident(s->proc->source)));
+      else
+         tb_printf(tb, "[kernel]");
+
+      const char *last = NULL;
+      for (int i = s->depth - 1; i >= 0; i--) {
+         const char *symbol;
+         tree_t decl = jit_find_decl(s->pcs[i], &symbol);
+         if (symbol == NULL || symbol == last)
+            continue;
+         else if (decl != NULL) {
+            const loc_t *loc = tree_loc(decl);
+            tb_printf(tb, ";%s (%s:%d)", istr(tree_ident(decl)),
+                      loc->file ? istr(loc->file) : "?", loc->first_line);
+         }
+         else
+            tb_printf(tb, ";%s", symbol);
 
-         event_t *peek = heap_min(eventq_heap);
-         if (peek->when > now)
-            break;
+         last = symbol;
       }
-   }
 
-   event_t *event;
-   while ((event = rt_pop_run_queue())) {
-      switch (event->kind) {
-      case E_PROCESS:
-         rt_run(event->proc, false /* reset */);
-         break;
-      case E_DRIVER:
-         rt_update_driver(event->group, event->proc);
-         break;
-      case E_TIMEOUT:
-         (*event->timeout_fn)(now, event->timeout_user);
-         break;
-      }
+      ident_t key = ident_new(tb_get(tb));
+      const uintptr_t count = (uintptr_t)hash_get(prof_stacks, key);
+      hash_put(prof_stacks, key, (void *)(count + 1));
 
-      rt_free(event_stack, event);
+      s->valid = false;
+      __sync_synchronize();
+      prof_tail++;
    }
+}
 
-   if (unlikely(now == 0 && iteration == 0)) {
-      vcd_restart();
-      lxt_restart();
-      fst_restart();
-   }
-   else if (unlikely((stop_delta > 0) && (iteration == stop_delta)))
-      rt_iteration_limit();
+static void rt_prof_start(void)
+{
+#if !defined __MINGW32__ && defined HAVE_EXECINFO_H
+   prof_ring   = xcalloc(PROF_RING_SZ * sizeof(prof_sample_t));
+   prof_stacks = hash_new(1024, true);
 
-   // Run all non-postponed event callbacks
-   rt_event_callback(false);
+   // Call backtrace once outside the signal handler as the first call may
+   // load libgcc and allocate memory
+   void *dummy[1];
+   backtrace(dummy, 1);
 
-   // Run all processes that resumed because of signal events
-   rt_resume_processes(&resume);
-   rt_global_event(RT_END_OF_PROCESSES);
+   struct sigaction sa;
+   sa.sa_sigaction = rt_prof_sighandler;
+   sigemptyset(&sa.sa_mask);
+   sa.sa_flags = SA_RESTART | SA_SIGINFO;
+   sigaction(SIGPROF, &sa, NULL);
+
+   struct itimerval it = {
+      .it_interval = { 0, PROF_PERIOD_US },
+      .it_value    = { 0, PROF_PERIOD_US }
+   };
+   if (setitimer(ITIMER_PROF, &it, NULL) != 0)
+      fatal_errno("setitimer");
+#else
+   warnf("sampling profiler is not supported on this platform");
+   prof_file = NULL;
+#endif
+}
+
+static void rt_prof_stop(void)
+{
+#if !defined __MINGW32__ && defined HAVE_EXECINFO_H
+   struct itimerval it = {};
+   setitimer(ITIMER_PROF, &it, NULL);
+   signal(SIGPROF, SIG_IGN);
+
+   rt_prof_drain();
+
+   FILE *f = fopen(prof_file, "w");
+   if (f == NULL)
+      fatal_errno("failed to create %s", prof_file);
+
+   unsigned total = 0;
+   hash_iter_t it_h = HASH_BEGIN;
+   const void *key;
+   void *value;
+   while (hash_iter(prof_stacks, &it_h, &key, &value)) {
+      fprintf(f, "%s %u\n", istr((ident_t)key), (unsigned)(uintptr_t)value);
+      total += (uintptr_t)value;
+   }
+
+   fclose(f);
+
+   notef("wrote %u profile samples to %s", total, prof_file);
+   if (prof_dropped > 0)
+      warnf("%u profile samples were dropped", prof_dropped);
+
+   hash_free(prof_stacks);
+   free(prof_ring);
+   prof_stacks = NULL;
+   prof_ring = NULL;
+#endif
+}
+
+void rt_set_profile_file(const char *file)
+{
+   prof_file = file;
+}
+
+static void rt_mem_slab(const slab_stats_t *ss, void *context)
+{
+   size_t *totals = context;
+   totals[0] += ss->slabs;
+   totals[1] += ss->live_bytes;
+}
+
+static void rt_mem_stack(const char *group, rt_alloc_stack_t s)
+{
+   const size_t bytes = s->stack_sz * (s->item_sz + sizeof(void *));
+   mem_record(group, s->name, s->stack_sz - s->stack_top, bytes);
+}
+
+static void rt_mem_stats(void)
+{
+   if (netdb != NULL) {
+      const unsigned ngroups = netdb_size(netdb);
+      mem_record("netdb map", NULL, netdb->nnets, netdb_memory(netdb));
+      mem_record("net groups", NULL, ngroups,
+                 ngroups * (sizeof(netgroup_t) + sizeof(netgroup_cold_t)));
+   }
+
+   size_t slabs[2] = { 0, 0 };
+   slab_walk_stats(rt_mem_slab, slabs);
+   mem_record("signal values", NULL, slabs[0], slabs[1]);
+
+   rt_mem_stack("driver waveforms", waveform_stack);
+
+   const rt_alloc_stack_t stacks[] = {
+      event_stack, sens_list_stack, watch_stack, callback_stack,
+      bucket_stack
+   };
+
+   for (size_t i = 0; i < ARRAY_LEN(stacks); i++)
+      rt_mem_stack("kernel queues", stacks[i]);
+
+   mem_record("temp stacks", NULL, tmp_stacks_mapped + 1,
+              tmp_stacks_mapped * PROC_TMP_STACK_SZ + GLOBAL_TMP_STACK_SZ);
+}
+
+static void rt_mem_check(void)
+{
+   mem_check("simulating to %s", fmt_time(now));
+
+   // Empty slabs are otherwise kept for reuse by later values
+   if (mem_constrained())
+      slab_trim();
+}
+
+static void rt_cycle(int stop_delta)
+{
+   // Simulation cycle is described in LRM 93 section 12.6.4
+
+   const bool is_delta_cycle = (delta_driver != NULL) || (delta_proc != NULL);
+
+   if (is_delta_cycle)
+      iteration = iteration + 1;
+   else {
+      if (iteration >= 0)
+         stats.deltas_per_step[rt_stats_bin(iteration)]++;
+
+      bucket_t *peek = wheel_min(eventq_wheel);
+      while (unlikely(deltaq_purge_bucket(peek))) {
+         // Discard time steps with only stale events
+         rt_free(bucket_stack, deltaq_take_bucket());
+         if (wheel_size(eventq_wheel) == 0)
+            return;
+         else
+            peek = wheel_min(eventq_wheel);
+      }
+      now = peek->when;
+      iteration = 0;
+   }
+
+   TRACE("begin cycle");
+
+   stats.cycles++;
+   if (is_delta_cycle)
+      stats.deltas++;
+
+   if (unlikely(stats.cycles % MEM_CHECK_CYCLES == 0) && mem_enabled())
+      rt_mem_check();
+
+#if TRACE_DELTAQ > 0
+   if (trace_on)
+      deltaq_dump();
+#endif
+#if TRACE_PENDING > 0
+   if (trace_on)
+      rt_dump_pending();
+#endif
+
+   if (is_delta_cycle) {
+      for (event_t *e = delta_driver; e != NULL; e = e->delta_chain)
+         rt_push_run_queue(e);
+
+      for (event_t *e = delta_proc; e != NULL; e = e->delta_chain)
+         rt_push_run_queue(e);
+
+      delta_driver = NULL;
+      delta_proc = NULL;
+   }
+   else {
+      rt_global_event(RT_NEXT_TIME_STEP);
+
+      bucket_t *step = NULL, **tail = &step;
+      do {
+         bucket_t *b = deltaq_take_bucket();
+         *tail = b;
+         tail = &(b->next);
+      } while (wheel_size(eventq_wheel) > 0
+               && ((bucket_t *)wheel_min(eventq_wheel))->when == now);
+
+      for (int i = 0; i < N_EVENT_KINDS; i++) {
+         for (bucket_t *b = step; b != NULL; b = b->next) {
+            for (event_t *e = b->head[i], *next; e != NULL; e = next) {
+               next = e->delta_chain;
+               rt_push_run_queue(e);
+            }
+         }
+      }
+
+      for (bucket_t *b = step, *next; b != NULL; b = next) {
+         next = b->next;
+         rt_free(bucket_stack, b);
+      }
+   }
+
+   uint64_t nevents = 0;
+   event_t *event;
+   while ((event = rt_pop_run_queue())) {
+      stats.events[event->kind]++;
+      nevents++;
+
+      switch (event->kind) {
+      case E_PROCESS:
+         if (unlikely(event->proc->native)) {
+            rt_clock_step(event->proc->clock);
+            break;
+         }
+         else if (n_workers > 0) {
+            rt_run_queue_batch(event);
+            continue;
+         }
+         rt_run(event->proc, false /* reset */);
+         break;
+      case E_DRIVER:
+         rt_update_driver_run(event);
+         break;
+      case E_TIMEOUT:
+         (*event->timeout_fn)(now, event->timeout_user);
+         break;
+      }
+
+      rt_free(event_stack, event);
+   }
+
+   stats.events_per_cycle[rt_stats_bin(nevents)]++;
+
+   if (unlikely(now == 0 && iteration == 0))
+      rt_wave_restart();
+   else if (unlikely((stop_delta > 0) && (iteration == stop_delta)))
+      rt_iteration_limit();
+
+   if (unlikely(capture_req != CAPTURE_REQ_NONE))
+      rt_wave_capture();
+
+   if (n_levels > 0)
+      rt_run_region();
+
+   // Run all non-postponed event callbacks
+   rt_event_callback(false);
+
+   // Run all processes that resumed because of signal events
+   rt_resume_processes(&resume);
+   rt_global_event(RT_END_OF_PROCESSES);
+
+   for (unsigned i = 0; i < n_active_groups; i++) {
+      netgroup_t *g = active_groups[i];
+
+      // Send any change to a signal driven on this node to the others
+      if (unlikely(dist_enabled()) && (g->flags & NET_F_EVENT)
+          && g->n_drivers > 0)
+         dist_add_change(g - groups, g->resolved, g->size, g->length);
+
+      g->flags &= ~(NET_F_ACTIVE | NET_F_EVENT);
+   }
+   n_active_groups = 0;
+
+   if (!rt_next_cycle_is_delta()) {
+      can_create_delta = false;
+      rt_global_event(RT_LAST_KNOWN_DELTA_CYCLE);
+
+      // Run any postponed processes
+      rt_resume_processes(&postponed);
+
+      // Execute all postponed event callbacks
+      rt_event_callback(true);
+
+      can_create_delta = true;
+   }
+
+   if (unlikely(prof_ring != NULL))
+      rt_prof_drain();
+}
+
+static tree_t rt_recall_decl(const char *name)
+{
+   tree_t decl = hash_get(decl_hash, ident_new(name));
+   if (decl != NULL)
+      return decl;
+   else
+      fatal("cannot find name %s in elaborated design", name);
+}
+
+static void rt_cleanup_group(groupid_t gid, netid_t first, unsigned length)
+{
+   netgroup_t *g = &(groups[gid]);
+
+   RT_ASSERT(g->first == first);
+   RT_ASSERT(g->length == length);
+
+   if (g->last_value != g->resolved)
+      free(g->last_value);
+
+   if (g->flags & NET_F_OWNS_MEM)
+      free(g->resolved);
+
+   if (g->forcing != NULL)
+      rt_free_value(g, g->forcing);
+
+   for (int j = 0; j < g->n_drivers; j++) {
+      while (g->drivers[j].waveforms != NULL) {
+         waveform_t *next = g->drivers[j].waveforms->next;
+         rt_free_value(g, g->drivers[j].waveforms->values);
+         rt_free(waveform_stack, g->drivers[j].waveforms);
+         g->drivers[j].waveforms = next;
+      }
+   }
+   free(g->drivers);
+
+   while (g->pending != NULL) {
+      sens_list_t *next = g->pending->next;
+      rt_free(sens_list_stack, g->pending);
+      g->pending = next;
+   }
+
+   netgroup_cold_t *cold = rt_group_cold(g);
+   while (cold->watching != NULL) {
+      watch_list_t *next = cold->watching->next;
+      free(cold->watching);
+      cold->watching = next;
+   }
+}
+
+static void rt_cleanup(tree_t top)
+{
+   RT_ASSERT(resume == NULL);
+
+   while (wheel_size(eventq_wheel) > 0) {
+      bucket_t *b = deltaq_take_bucket();
+      for (int i = 0; i < N_EVENT_KINDS; i++)
+         rt_free_delta_events(b->head[i]);
+      rt_free(bucket_stack, b);
+   }
+
+   rt_free_delta_events(delta_proc);
+   rt_free_delta_events(delta_driver);
+
+   for (size_t i = 0; i < n_procs; i++) {
+      if (procs[i].drivers != NULL) {
+         hash_free(procs[i].drivers);
+         procs[i].drivers = NULL;
+      }
+
+      free(procs[i].clock);
+      procs[i].clock = NULL;
+   }
+
+   free(region);
+   region = NULL;
+   n_levels = 0;
+
+   wheel_free(eventq_wheel);
+   eventq_wheel = NULL;
+
+   for (int level = 0; level < PENDING_LEVELS; level++) {
+      if (pending[level] == NULL)
+         continue;
+
+      const size_t nblocks = ((uint64_t)netdb->nnets >> level) + 1;
+      for (size_t b = 0; b < nblocks; b++) {
+         while (pending[level][b] != NULL) {
+            sens_list_t *next = pending[level][b]->next;
+            rt_free(sens_list_stack, pending[level][b]);
+            pending[level][b] = next;
+         }
+      }
+
+      free(pending[level]);
+      pending[level] = NULL;
+   }
+   pending_levels = 0;
+
+   netdb_walk(netdb, rt_cleanup_group);
+   netdb_close(netdb);
+
+   hash_free(decl_hash);
+   decl_hash = NULL;
+
+   while (watches != NULL) {
+      watch_t *next = watches->chain_all;
+      rt_free(watch_stack, watches);
+      free(watches->groups);
+      watches = next;
+   }
+
+   for (int i = 0; i < RT_LAST_EVENT; i++) {
+      while (global_cbs[i] != NULL) {
+         callback_t *tmp = global_cbs[i]->next;
+         rt_free(callback_stack, global_cbs[i]);
+         global_cbs[i] = tmp;
+      }
+   }
+
+   rt_alloc_stack_destroy(event_stack);
+   rt_alloc_stack_destroy(waveform_stack);
+   rt_alloc_stack_destroy(sens_list_stack);
+   rt_alloc_stack_destroy(watch_stack);
+   rt_alloc_stack_destroy(callback_stack);
+   rt_alloc_stack_destroy(bucket_stack);
+
+   hash_free(res_memo_hash);
+
+   slab_trim();
+}
+
+static bool rt_stop_now(uint64_t stop_time)
+{
+   if ((delta_driver != NULL) || (delta_proc != NULL))
+      return false;
+   else if (wheel_size(eventq_wheel) == 0)
+      return true;
+   else if (force_stop)
+      return true;
+   else if (stop_time == UINT64_MAX)
+      return false;
+   else {
+      bucket_t *peek = wheel_min(eventq_wheel);
+      return peek->when > stop_time;
+   }
+}
+
+static int rt_proc_usage_cmp(const void *lhs, const void *rhs)
+{
+   return ((const rt_proc_t *)rhs)->usage - ((const rt_proc_t *)lhs)->usage;
+}
+
+static void rt_stats_print(void)
+{
+   nvc_rusage_t ru;
+   nvc_rusage(&ru);
+
+   if (profiling) {
+      notef("top processes by CPU usage");
+
+      qsort(procs, n_procs, sizeof(rt_proc_t), rt_proc_usage_cmp);
+
+      const uint64_t ru_us = ru.ms * 1000;
+
+      color_printf("$white$%10s %5s %s$$\n", "us", "%", "process");
+      for (size_t i = 0; i < MIN(n_procs, 10); i++) {
+         const double pc = ((double)procs[i].usage / ru_us) * 100.0;
+         printf("%10"PRIu64" %5.1f %s\n", procs[i].usage, pc,
+                istr(tree_ident(procs[i].source)));
+      }
+   }
+
+   notef("setup:%ums run:%ums maxrss:%ukB", ready_rusage.ms, ru.ms, ru.rss);
+}
+
+static void rt_stats_histogram(FILE *f, const char *name,
+                               const uint64_t *bins, bool last)
+{
+   fprintf(f, "  \"%s\": [", name);
+
+   bool first = true;
+   for (int i = 0; i < STATS_HIST_BINS; i++) {
+      if (bins[i] == 0)
+         continue;
+
+      const uint64_t low = i == 0 ? 0 : UINT64_C(1) << (i - 1);
+      const uint64_t high = i == 0 ? 0 : (UINT64_C(1) << i) - 1;
+      fprintf(f, "%s\n    { \"min\": %"PRIu64", \"max\": ", first ? "" : ",",
+              low);
+      if (i == STATS_HIST_BINS - 1)
+         fprintf(f, "null");
+      else
+         fprintf(f, "%"PRIu64, high);
+      fprintf(f, ", \"count\": %"PRIu64" }", bins[i]);
+      first = false;
+   }
+
+   fprintf(f, "%s]%s\n", first ? "" : "\n  ", last ? "" : ",");
+}
+
+typedef struct {
+   FILE *file;
+   bool  first;
+} stats_slab_ctx_t;
+
+static void rt_stats_slab(const slab_stats_t *ss, void *context)
+{
+   stats_slab_ctx_t *ctx = context;
+
+   if (ss->peak_bytes == 0)
+      return;
+
+   fprintf(ctx->file, "%s\n    { \"size\": ", ctx->first ? "" : ",");
+   if (ss->size == 0)
+      fprintf(ctx->file, "null");
+   else
+      fprintf(ctx->file, "%zu", ss->size);
+   fprintf(ctx->file, ", \"live_bytes\": %zu, \"peak_bytes\": %zu, "
+           "\"slabs\": %zu }", ss->live_bytes, ss->peak_bytes, ss->slabs);
+
+   ctx->first = false;
+}
+
+static void rt_stats_json(const char *file)
+{
+   // Machine readable report of kernel counters for tracking simulator
+   // efficiency over time
+
+   FILE *f = fopen(file, "w");
+   if (f == NULL)
+      fatal_errno("failed to create %s", file);
+
+   nvc_rusage_t ru;
+   nvc_rusage(&ru);
+
+   // The final time step is still open at the end of the run
+   uint64_t deltas_per_step[STATS_HIST_BINS];
+   memcpy(deltas_per_step, stats.deltas_per_step, sizeof(deltas_per_step));
+   if (iteration >= 0)
+      deltas_per_step[rt_stats_bin(iteration)]++;
+
+   uint64_t fst_flushes, fst_flush_us;
+   fst_flush_stats(&fst_flushes, &fst_flush_us);
+
+   fprintf(f, "{\n");
+   fprintf(f, "  \"setup_ms\": %u,\n", ready_rusage.ms);
+   fprintf(f, "  \"run_ms\": %u,\n", ru.ms);
+   fprintf(f, "  \"maxrss_kb\": %u,\n", ru.rss);
+   fprintf(f, "  \"now_fs\": %"PRIu64",\n", now);
+   fprintf(f, "  \"processes\": %zu,\n", n_procs);
+   fprintf(f, "  \"native_clocks\": %"PRIu64",\n", stats.native_clocks);
+   fprintf(f, "  \"region_procs\": %"PRIu64",\n", stats.region_procs);
+   fprintf(f, "  \"wave_records\": %"PRIu64",\n", stats.wave_records);
+   fprintf(f, "  \"wave_stalls\": %"PRIu64",\n", stats.wave_stalls);
+   fprintf(f, "  \"fst\": {\n");
+   fprintf(f, "    \"flushes\": %"PRIu64",\n", fst_flushes);
+   fprintf(f, "    \"flush_ms\": %"PRIu64"\n", fst_flush_us / 1000);
+   fprintf(f, "  },\n");
+   fprintf(f, "  \"cycles\": %"PRIu64",\n", stats.cycles);
+   fprintf(f, "  \"delta_cycles\": %"PRIu64",\n", stats.deltas);
+   fprintf(f, "  \"events\": {\n");
+   fprintf(f, "    \"timeout\": %"PRIu64",\n", stats.events[E_TIMEOUT]);
+   fprintf(f, "    \"driver\": %"PRIu64",\n", stats.events[E_DRIVER]);
+   fprintf(f, "    \"driver_groups\": %"PRIu64",\n", stats.driver_groups);
+   fprintf(f, "    \"process\": %"PRIu64",\n", stats.events[E_PROCESS]);
+   fprintf(f, "    \"stale\": %"PRIu64"\n", stats.stale_events);
+   fprintf(f, "  },\n");
+   fprintf(f, "  \"peak_eventq\": %zu,\n", stats.peak_eventq);
+   fprintf(f, "  \"peak_run_queue\": %zu,\n", stats.peak_run_queue);
+   fprintf(f, "  \"resolution\": {\n");
+   fprintf(f, "    \"calls\": %"PRIu64",\n", stats.res_calls);
+   fprintf(f, "    \"memo_hits\": %"PRIu64",\n", stats.res_memo_hits);
+   fprintf(f, "    \"init_hits\": %"PRIu64"\n", stats.res_init_hits);
+   fprintf(f, "  },\n");
+   fprintf(f, "  \"threads\": {\n");
+   fprintf(f, "    \"batches\": %"PRIu64",\n", stats.batches);
+   fprintf(f, "    \"batch_procs\": %"PRIu64",\n", stats.batch_procs);
+   fprintf(f, "    \"worker_procs\": %"PRIu64"\n", stats.worker_procs);
+   fprintf(f, "  },\n");
+   fprintf(f, "  \"tmp_stacks\": {\n");
+   fprintf(f, "    \"mapped\": %u,\n", tmp_stacks_mapped);
+   fprintf(f, "    \"reused\": %u\n", tmp_stacks_reused);
+   fprintf(f, "  },\n");
+
+   const rt_alloc_stack_t stacks[] = {
+      event_stack, waveform_stack, sens_list_stack,
+      watch_stack, callback_stack, bucket_stack
+   };
+
+   fprintf(f, "  \"alloc_stacks\": [");
+   for (size_t i = 0; i < ARRAY_LEN(stacks); i++)
+      fprintf(f, "%s\n    { \"name\": \"%s\", \"item_size\": %zu, "
+              "\"capacity\": %zu, \"slow_allocs\": %u }",
+              i == 0 ? "" : ",", stacks[i]->name, stacks[i]->item_sz,
+              stacks[i]->stack_sz, stacks[i]->slow_allocs);
+   fprintf(f, "\n  ],\n");
+
+   fprintf(f, "  \"value_slabs\": [");
+   stats_slab_ctx_t slab_ctx = { f, true };
+   slab_walk_stats(rt_stats_slab, &slab_ctx);
+   fprintf(f, "\n  ],\n");
+
+   rt_stats_histogram(f, "events_per_cycle", stats.events_per_cycle, false);
+   rt_stats_histogram(f, "deltas_per_step", deltas_per_step, true);
+
+   fprintf(f, "}\n");
+   fclose(f);
+}
+
+static void rt_pgo_write(const char *file)
+{
+   // Each process elaborated with --pgo-collect has a global array of
+   // counters where the first element is the number that follow
+
+   FILE *f = fopen(file, "w");
+   if (f == NULL)
+      fatal_errno("failed to create %s", file);
+
+   pgo_write_header(f);
+
+   unsigned nwritten = 0;
+   for (size_t i = 0; i < n_procs; i++) {
+      ident_t name = tree_ident(procs[i].source);
+      char *sym LOCAL = xasprintf("%s.pgo", istr(name));
+      const uint64_t *counts = jit_find_symbol(sym, false);
+      if (counts == NULL)
+         continue;
+
+      pgo_write(f, name, counts + 1, counts[0]);
+      nwritten++;
+   }
+
+   fclose(f);
+
+   if (nwritten == 0)
+      warnf("design was not elaborated with --pgo-collect");
+   else
+      notef("wrote block counts for %u processes to %s", nwritten, file);
+}
+
+static void rt_free_cover_shards(void)
+{
+   for (int i = 0; i < n_cover_shards; i++)
+      free(cover_shards[i]);
+
+   free(cover_shards);
+   cover_shards = NULL;
+   n_cover_shards = 0;
+}
+
+static void rt_reset_coverage(tree_t top)
+{
+   cover_mode   = tree_attr_int(top, ident_new("cover_mode"), COVER_COUNT);
+   cover_nstmts = tree_attr_int(top, ident_new("stmt_tags"), 0);
+   cover_nconds = tree_attr_int(top, ident_new("cond_tags"), 0);
+
+   const bool hit = (cover_mode == COVER_HIT);
+   const size_t elemsz = hit ? sizeof(uint8_t) : sizeof(int32_t);
+
+   int32_t *cover_stmts = jit_find_symbol("cover_stmts", false);
+   if (cover_stmts != NULL)
+      memset(cover_stmts, '\0', elemsz * cover_nstmts);
+
+   int32_t *cover_conds = jit_find_symbol("cover_conds", false);
+   if (cover_conds != NULL)
+      memset(cover_conds, '\0',
+             elemsz * cover_nconds * (hit ? COVER_HIT_BYTES : 1));
+
+#if RT_MULTITHREAD
+   // The shards from an earlier reset are cleared and used again if they
+   // still fit otherwise they are freed
+   const size_t shardsz = (cover_nstmts + cover_nconds) * sizeof(int32_t);
+   const bool reuse = !hit && cover_stmts != NULL && cover_shards != NULL
+      && n_cover_shards == n_workers && cover_shardsz == shardsz;
+   if (reuse) {
+      for (int i = 0; i < n_cover_shards; i++)
+         memset(cover_shards[i], '\0', shardsz);
+   }
+   else
+      rt_free_cover_shards();
+#endif
+
+   if (hit || cover_stmts == NULL)
+      return;
+
+   _cover_stmts = cover_stmts;
+   _cover_conds = cover_conds;
+
+#if RT_MULTITHREAD
+   if (reuse)
+      return;
+
+   // The main thread counts directly into the arrays in the design
+   n_cover_shards = n_workers;
+   cover_shardsz  = shardsz;
+   cover_shards = xmalloc(MAX(n_workers, 1) * sizeof(int32_t *));
+   for (int i = 0; i < n_workers; i++)
+      cover_shards[i] = xcalloc(shardsz);
+#endif
+}
+
+static void rt_emit_coverage(tree_t top)
+{
+   int32_t *cover_stmts = jit_find_symbol("cover_stmts", false);
+   int32_t *cover_conds = jit_find_symbol("cover_conds", false);
+   if (cover_stmts == NULL)
+      return;
+
+   if (cover_mode == COVER_HIT) {
+      // Each byte which was set becomes a count of one or the
+      // corresponding bit of the condition mask
+      const uint8_t *stmt_hits = (const uint8_t *)cover_stmts;
+      const uint8_t *cond_hits = (const uint8_t *)cover_conds;
+
+      int32_t *counts = xmalloc(cover_nstmts * sizeof(int32_t));
+      for (int i = 0; i < cover_nstmts; i++)
+         counts[i] = stmt_hits[i];
+
+      int32_t *masks = xcalloc(MAX(cover_nconds, 1) * sizeof(int32_t));
+      for (int i = 0; i < cover_nconds * COVER_HIT_BYTES; i++) {
+         if (cond_hits[i])
+            masks[i / COVER_HIT_BYTES] |= 1 << (i % COVER_HIT_BYTES);
+      }
+
+      cover_report(top, counts, masks);
+
+      free(counts);
+      free(masks);
+      return;
+   }
+
+   for (int i = 0; i < n_cover_shards; i++) {
+      const int32_t *shard = cover_shards[i];
+      for (int j = 0; j < cover_nstmts; j++)
+         cover_stmts[j] += shard[j];
+      for (int j = 0; j < cover_nconds; j++)
+         cover_conds[j] |= shard[cover_nstmts + j];
+   }
+
+   rt_free_cover_shards();
+
+   cover_report(top, cover_stmts, cover_conds);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Checkpoint and restore
+//
+// A checkpoint records the kernel state at the boundary between two time
+// steps: signal values and drivers, pending events and sensitivity lists,
+// and the state of every process. It can only be restored into the same
+// elaborated design after it has been initialised. Processes with access
+// or file variables, or which are suspended inside a procedure, cannot be
+// saved. Package variables and open files are not recorded.
+
+#define CHECKPOINT_MAGIC   0x4e56434b
+#define CHECKPOINT_VERSION 2
+
+typedef struct {
+   int64_t  size;
+   void    *state;
+} checkpoint_info_t;
+
+typedef struct {
+   int32_t  jump_target;
+   void    *pcall_state;
+} proc_state_header_t;
+
+static const char *checkpoint_file = NULL;
+static uint64_t    checkpoint_time = UINT64_MAX;
+static fbuf_t     *checkpoint_fbuf = NULL;
+
+static checkpoint_info_t *rt_checkpoint_info(rt_proc_t *proc)
+{
+   ident_t name = tree_ident(proc->source);
+   char *buf LOCAL = xasprintf("%s__checkpoint", istr(name));
+
+   checkpoint_info_t *info = jit_find_symbol(buf, false);
+   if (info == NULL)
+      fatal("process %s has no checkpoint information: the design must "
+            "be elaborated again", istr(name));
+
+   return info;
+}
+
+static uint32_t rt_proc_index(rt_proc_t *proc)
+{
+   return (proc == NULL) ? UINT32_MAX : proc - procs;
+}
+
+static rt_proc_t *rt_proc_at_index(uint32_t index, fbuf_t *f)
+{
+   if (index == UINT32_MAX)
+      return NULL;
+   else if (index >= n_procs)
+      fatal("%s: process index %u out of range", fbuf_file_name(f), index);
+   else
+      return &(procs[index]);
+}
+
+static void rt_write_sens_list(sens_list_t *list, fbuf_t *f)
+{
+   uint32_t count = 0;
+   for (sens_list_t *it = list; it != NULL; it = it->next)
+      count++;
+
+   write_u32(count, f);
+
+   for (sens_list_t *it = list; it != NULL; it = it->next) {
+      write_u32(rt_proc_index(it->proc), f);
+      write_u32(it->wakeup_gen, f);
+      write_u32(it->first, f);
+      write_u32(it->last, f);
+      write_u8(it->reenq != NULL, f);
+   }
+}
+
+static void rt_read_sens_list(sens_list_t **list, fbuf_t *f)
+{
+   // Entries are appended so the list keeps its original order
+
+   sens_list_t **tail = list;
+   while (*tail != NULL)
+      tail = &((*tail)->next);
+
+   const uint32_t count = read_u32(f);
+   for (uint32_t i = 0; i < count; i++) {
+      sens_list_t *node = rt_alloc(sens_list_stack);
+      node->proc       = rt_proc_at_index(read_u32(f), f);
+      node->wakeup_gen = read_u32(f);
+      node->first      = read_u32(f);
+      node->last       = read_u32(f);
+      node->reenq      = read_u8(f) ? list : NULL;
+      node->next       = NULL;
+
+      *tail = node;
+      tail = &(node->next);
+   }
+}
+
+static void rt_free_sens_list(sens_list_t **list)
+{
+   while (*list != NULL) {
+      sens_list_t *next = (*list)->next;
+      rt_free(sens_list_stack, *list);
+      *list = next;
+   }
+}
+
+static void rt_write_event(event_t *e, fbuf_t *f)
+{
+   if (e->kind == E_TIMEOUT)
+      fatal("cannot checkpoint simulation with pending timeout callbacks");
+
+   write_u64(e->when, f);
+   write_u8(e->kind, f);
+   write_u32(e->wakeup_gen, f);
+   write_u32(rt_proc_index(e->proc), f);
+   write_u32((e->group == NULL) ? GROUPID_INVALID : e->group - groups, f);
+   write_u32(e->driver, f);
+   write_u32(e->ngroups, f);
+}
+
+static void rt_read_event(fbuf_t *f)
+{
+   event_t *e = rt_alloc(event_stack);
+   e->when       = read_u64(f);
+   e->kind       = read_u8(f);
+   e->wakeup_gen = read_u32(f);
+   e->proc       = rt_proc_at_index(read_u32(f), f);
+
+   const groupid_t gid = read_u32(f);
+   if (gid == GROUPID_INVALID)
+      e->group = NULL;
+   else if (gid < netdb_size(netdb))
+      e->group = &(groups[gid]);
+   else
+      fatal("%s: group %u out of range", fbuf_file_name(f), gid);
+
+   e->driver  = read_u32(f);
+   e->ngroups = read_u32(f);
+
+   if (e->kind != E_PROCESS && e->kind != E_DRIVER)
+      fatal("%s: invalid event kind %d", fbuf_file_name(f), e->kind);
+
+   deltaq_insert(e);
+}
+
+static void rt_write_group(groupid_t gid, netid_t first, unsigned length)
+{
+   netgroup_t *g = &(groups[gid]);
+   fbuf_t *f = checkpoint_fbuf;
+
+   const size_t valuesz = g->size * g->length;
+
+   write_u32(gid, f);
+   write_u32(g->flags & (NET_F_GLOBAL | NET_F_FORCED), f);
+   write_u64(rt_group_cold(g)->last_event, f);
+   write_raw(g->resolved, valuesz, f);
+
+   const bool own_last = (g->last_value != g->resolved);
+   write_u8(own_last, f);
+   if (own_last)
+      write_raw(g->last_value, valuesz, f);
+
+   if (g->flags & NET_F_FORCED)
+      write_raw(g->forcing->data, valuesz, f);
+
+   write_u16(g->n_drivers, f);
+   for (int i = 0; i < g->n_drivers; i++) {
+      write_u32(rt_proc_index(g->drivers[i].proc), f);
+
+      uint32_t count = 0;
+      for (waveform_t *w = g->drivers[i].waveforms; w; w = w->next)
+         count++;
+
+      write_u32(count, f);
+
+      for (waveform_t *w = g->drivers[i].waveforms; w; w = w->next) {
+         write_u64(w->when, f);
+         write_raw(w->values->data, valuesz, f);
+      }
+   }
+
+   rt_write_sens_list(g->pending, f);
+}
+
+static void rt_read_group(groupid_t gid, netid_t first, unsigned length)
+{
+   netgroup_t *g = &(groups[gid]);
+   fbuf_t *f = checkpoint_fbuf;
+
+   const size_t valuesz = g->size * g->length;
+
+   if (read_u32(f) != gid)
+      fatal("%s was not created from this design", fbuf_file_name(f));
+
+   g->flags = (g->flags & ~(NET_F_GLOBAL | NET_F_FORCED)) | read_u32(f);
+   rt_group_cold(g)->last_event = read_u64(f);
+   read_raw(g->resolved, valuesz, f);
+
+   const bool own_last = read_u8(f);
+   if (own_last != (g->last_value != g->resolved))
+      fatal("%s: checkpoint does not match signal %s",
+            fbuf_file_name(f), fmt_group(g));
+   else if (own_last)
+      read_raw(g->last_value, valuesz, f);
+
+   if (g->flags & NET_F_FORCED) {
+      if (g->forcing == NULL)
+         g->forcing = rt_alloc_value(g);
+      read_raw(g->forcing->data, valuesz, f);
+   }
+
+   if (read_u16(f) != g->n_drivers)
+      fatal("%s: checkpoint does not match drivers for signal %s",
+            fbuf_file_name(f), fmt_group(g));
+
+   for (int i = 0; i < g->n_drivers; i++) {
+      driver_t *d = &(g->drivers[i]);
+      if (rt_proc_at_index(read_u32(f), f) != d->proc)
+         fatal("%s: checkpoint does not match drivers for signal %s",
+               fbuf_file_name(f), fmt_group(g));
+
+      while (d->waveforms != NULL) {
+         waveform_t *next = d->waveforms->next;
+         rt_free_value(g, d->waveforms->values);
+         rt_free(waveform_stack, d->waveforms);
+         d->waveforms = next;
+      }
+
+      waveform_t **tail = &(d->waveforms);
+      const uint32_t count = read_u32(f);
+      for (uint32_t j = 0; j < count; j++) {
+         waveform_t *w = rt_alloc(waveform_stack);
+         w->when   = read_u64(f);
+         w->next   = NULL;
+         w->values = rt_alloc_value(g);
+         read_raw(w->values->data, valuesz, f);
+
+         *tail = w;
+         tail = &(w->next);
+      }
+   }
+
+   rt_free_sens_list(&(g->pending));
+   rt_read_sens_list(&(g->pending), f);
+}
+
+static void rt_checkpoint(const char *file)
+{
+   RT_ASSERT(resume == NULL);
+   RT_ASSERT(delta_proc == NULL && delta_driver == NULL);
+
+   if (postponed != NULL)
+      fatal("cannot checkpoint simulation with postponed processes pending");
+
+   for (size_t i = 0; i < n_procs; i++) {
+      rt_proc_t *p = &(procs[i]);
+      checkpoint_info_t *info = rt_checkpoint_info(p);
+      if (info->size == 0)
+         fatal_at(tree_loc(p->source), "process %s has variables which "
+                  "cannot be saved in a checkpoint",
+                  istr(tree_ident(p->source)));
+      else if (((proc_state_header_t *)info->state)->pcall_state != NULL
+               || p->tmp_stack != NULL)
+         fatal_at(tree_loc(p->source), "cannot checkpoint process %s while "
+                  "it is suspended in a procedure",
+                  istr(tree_ident(p->source)));
+   }
+
+   fbuf_t *f = fbuf_open(file, FBUF_OUT);
+   if (f == NULL)
+      fatal_errno("failed to create checkpoint %s", file);
+
+   notef("writing checkpoint at %s to %s", fmt_time(now), file);
+
+   write_u32(CHECKPOINT_MAGIC, f);
+   write_u32(CHECKPOINT_VERSION, f);
+
+   write_u64(now, f);
+   write_u32(netdb_size(netdb), f);
+   write_u32(n_procs, f);
+
+   for (size_t i = 0; i < n_procs; i++) {
+      rt_proc_t *p = &(procs[i]);
+      checkpoint_info_t *info = rt_checkpoint_info(p);
+
+      const char *name = istr(tree_ident(p->source));
+      write_u32(strlen(name), f);
+      write_raw(name, strlen(name), f);
+
+      write_u32(p->wakeup_gen, f);
+      write_u64(info->size, f);
+      write_raw(info->state, info->size, f);
+   }
+
+   checkpoint_fbuf = f;
+   netdb_walk(netdb, rt_write_group);
+
+   for (int level = 0; level < PENDING_LEVELS; level++) {
+      if (pending[level] == NULL)
+         continue;
+
+      const size_t nblocks = ((uint64_t)netdb->nnets >> level) + 1;
+      for (size_t b = 0; b < nblocks; b++) {
+         if (pending[level][b] != NULL) {
+            write_u8(level, f);
+            write_u32(b, f);
+            rt_write_sens_list(pending[level][b], f);
+         }
+      }
+   }
+   write_u8(UINT8_MAX, f);
+
+   // Drain the event queue in order and then put the buckets back so the
+   // simulation can continue
+
+   const size_t nbuckets = wheel_size(eventq_wheel);
+   bucket_t **saved = xmalloc(nbuckets * sizeof(bucket_t *));
+
+   uint32_t nevents = 0;
+   for (size_t i = 0; i < nbuckets; i++) {
+      saved[i] = deltaq_take_bucket();
+      for (int k = 0; k < N_EVENT_KINDS; k++) {
+         for (event_t *e = saved[i]->head[k]; e; e = e->delta_chain)
+            nevents++;
+      }
+   }
+
+   write_u32(nevents, f);
+
+   for (size_t i = 0; i < nbuckets; i++) {
+      for (int k = 0; k < N_EVENT_KINDS; k++) {
+         for (event_t *e = saved[i]->head[k]; e; e = e->delta_chain)
+            rt_write_event(e, f);
+      }
+
+      wheel_insert(eventq_wheel, saved[i]->when, saved[i]);
+      bucket_cache[bucket_cache_slot(saved[i]->when)] = saved[i];
+   }
+
+   free(saved);
+   fbuf_close(f);
+   checkpoint_fbuf = NULL;
+}
+
+void rt_restore(const char *file)
+{
+   fbuf_t *f = fbuf_open(file, FBUF_IN);
+   if (f == NULL)
+      fatal_errno("failed to open checkpoint %s", file);
+
+   if (read_u32(f) != CHECKPOINT_MAGIC)
+      fatal("%s is not a checkpoint file", file);
+   else if (read_u32(f) != CHECKPOINT_VERSION)
+      fatal("%s was created by an incompatible version", file);
+
+   const uint64_t when = read_u64(f);
+
+   if ((read_u32(f) != netdb_size(netdb)) || (read_u32(f) != n_procs))
+      fatal("%s was not created from this design", file);
+
+   notef("restoring checkpoint at %s from %s", fmt_time(when), file);
+
+   // The restored processes may be part way through a clock sequence
+   clock_start_pending = false;
+
+   // Discard everything scheduled during initialisation
+
+   while (wheel_size(eventq_wheel) > 0) {
+      bucket_t *b = deltaq_take_bucket();
+      for (int i = 0; i < N_EVENT_KINDS; i++)
+         rt_free_delta_events(b->head[i]);
+      rt_free(bucket_stack, b);
+   }
+
+   rt_free_delta_events(delta_proc);
+   rt_free_delta_events(delta_driver);
+   delta_proc = delta_driver = NULL;
+
+   memset(bucket_cache, '\0', sizeof(bucket_cache));
+
+   for (int level = 0; level < PENDING_LEVELS; level++) {
+      if (pending[level] == NULL)
+         continue;
+
+      const size_t nblocks = ((uint64_t)netdb->nnets >> level) + 1;
+      for (size_t b = 0; b < nblocks; b++)
+         rt_free_sens_list(&(pending[level][b]));
+   }
+
+   for (size_t i = 0; i < n_procs; i++) {
+      rt_proc_t *p = &(procs[i]);
+      checkpoint_info_t *info = rt_checkpoint_info(p);
+
+      const char *name = istr(tree_ident(p->source));
+      const size_t namelen = read_u32(f);
+      char *buf LOCAL = xmalloc(namelen + 1);
+      read_raw(buf, namelen, f);
+      buf[namelen] = '\0';
+
+      if (strcmp(buf, name) != 0)
+         fatal("%s was not created from this design", file);
+
+      p->wakeup_gen = read_u32(f);
+      p->tmp_stack  = NULL;
+      p->tmp_alloc  = 0;
+
+      if (read_u64(f) != info->size || info->size == 0)
+         fatal("%s: process %s has changed since checkpoint was created",
+               file, name);
+
+      read_raw(info->state, info->size, f);
+   }
+
+   checkpoint_fbuf = f;
+   netdb_walk(netdb, rt_read_group);
+
+   for (;;) {
+      const uint8_t level = read_u8(f);
+      if (level == UINT8_MAX)
+         break;
+
+      const uint64_t block = read_u32(f);
+      if (level >= PENDING_LEVELS || block > (netdb->nnets >> level))
+         fatal("%s: corrupt sensitivity index", file);
+
+      const uint64_t first = block << level;
+      const uint64_t last  = first | ((UINT64_C(1) << level) - 1);
+      rt_read_sens_list(rt_pending_list(first, last), f);
+   }
+
+   now = when;
+
+   const uint32_t nevents = read_u32(f);
+   for (uint32_t i = 0; i < nevents; i++)
+      rt_read_event(f);
+
+   fbuf_close(f);
+   checkpoint_fbuf = NULL;
+
+   rt_wave_restart();
+   if (capture_req != CAPTURE_REQ_NONE)
+      rt_wave_capture();
+}
+
+void rt_set_checkpoint(uint64_t when, const char *file)
+{
+   checkpoint_time = when;
+   checkpoint_file = file;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Native clock processes
+//
+// Free running clock generators are recognised from the shape of their
+// process and replaced with a native driver after initialisation. A toggle
+// such as "clk <= not clk after T" is confirmed by watching the process
+// alternate between two values and afterwards each transaction on the
+// clock schedules the next directly when it is applied, so the process
+// never resumes. A process made only of literal assignments to one signal
+// each followed by "wait for T" keeps its wakeup events but each step is
+// performed without entering the generated code. Checkpoints and parallel
+// execution use the original processes.
+
+typedef enum {
+   CLOCK_TOGGLE,
+   CLOCK_SEQUENCE
+} clock_kind_t;
+
+typedef struct {
+   int64_t  value;
+   uint64_t wait;
+} clock_step_t;
+
+struct rt_clock {
+   clock_kind_t  kind;
+   rt_proc_t    *proc;
+   netgroup_t   *group;
+   bool          is_static;
+   bool          observed;
+   uint64_t      after;
+   uint64_t      reject;
+   unsigned      phase;
+   unsigned      nsteps;
+   clock_step_t  steps[0];
+};
+
+static bool rt_clock_time(tree_t t, uint64_t *value)
+{
+   int64_t ival;
+   if (!folded_int(t, &ival) || ival < 0)
+      return false;
+
+   *value = ival;
+   return true;
+}
+
+static tree_t rt_clock_signal(tree_t s)
+{
+   // Return the scalar signal driven by a simple signal assignment
+
+   if (tree_kind(s) != T_SIGNAL_ASSIGN || tree_waveforms(s) != 1)
+      return NULL;
+
+   tree_t target = tree_target(s);
+   if (tree_kind(target) != T_REF)
+      return NULL;
+
+   tree_t decl = tree_ref(target);
+   if (tree_kind(decl) != T_SIGNAL_DECL || tree_nets(decl) != 1
+       || !type_is_scalar(tree_type(decl)))
+      return NULL;
+
+   return decl;
+}
+
+static bool rt_clock_pure_fn(tree_t fcall)
+{
+   // Only predefined operators and those in the IEEE packages are known
+   // to have no side effects
+
+   if (tree_attr_str(tree_ref(fcall), builtin_i) != NULL)
+      return true;
+
+   return strncmp(istr(tree_ident(fcall)), "IEEE.", 5) == 0;
+}
+
+static rt_clock_t *rt_clock_new(clock_kind_t kind, rt_proc_t *proc,
+                                tree_t decl, unsigned nsteps)
+{
+   const netid_t nid = tree_net(decl, 0);
+
+   rt_clock_t *c = xcalloc(sizeof(rt_clock_t)
+                           + nsteps * sizeof(clock_step_t));
+   c->kind   = kind;
+   c->proc   = proc;
+   c->group  = &(groups[netdb_lookup(netdb, nid)]);
+   c->nsteps = nsteps;
+
+   return c;
+}
+
+static rt_clock_t *rt_clock_toggle(rt_proc_t *proc)
+{
+   // clk <= f(clk) after T; wait on clk;
+
+   tree_t s = tree_stmt(proc->source, 0);
+   tree_t w = tree_stmt(proc->source, 1);
+
+   tree_t decl = rt_clock_signal(s);
+   if (decl == NULL)
+      return NULL;
+
+   tree_t wave = tree_waveform(s, 0);
+
+   uint64_t after, reject;
+   if (!tree_has_delay(wave) || !rt_clock_time(tree_delay(wave), &after)
+       || after == 0)
+      return NULL;
+   else if (!tree_has_reject(s))
+      reject = 0;
+   else if (!rt_clock_time(tree_reject(s), &reject))
+      return NULL;
 
-   for (unsigned i = 0; i < n_active_groups; i++) {
-      netgroup_t *g = active_groups[i];
-      g->flags &= ~(NET_F_ACTIVE | NET_F_EVENT);
-   }
-   n_active_groups = 0;
+   tree_t value = tree_value(wave);
+   if (tree_kind(value) != T_FCALL || tree_params(value) != 1
+       || !rt_clock_pure_fn(value))
+      return NULL;
 
-   if (!rt_next_cycle_is_delta()) {
-      can_create_delta = false;
-      rt_global_event(RT_LAST_KNOWN_DELTA_CYCLE);
+   tree_t arg = tree_value(tree_param(value, 0));
+   if (tree_kind(arg) != T_REF || tree_ref(arg) != decl)
+      return NULL;
 
-      // Run any postponed processes
-      rt_resume_processes(&postponed);
+   if (tree_kind(w) != T_WAIT || tree_has_delay(w) || tree_has_value(w)
+       || tree_triggers(w) != 1)
+      return NULL;
 
-      // Execute all postponed event callbacks
-      rt_event_callback(true);
+   tree_t trigger = tree_trigger(w, 0);
+   if (tree_kind(trigger) != T_REF || tree_ref(trigger) != decl)
+      return NULL;
 
-      can_create_delta = true;
-   }
-}
+   rt_clock_t *c = rt_clock_new(CLOCK_TOGGLE, proc, decl, 2);
+   c->after     = after;
+   c->reject    = reject;
+   c->is_static = tree_attr_int(w, static_i, 0);
 
-static tree_t rt_recall_decl(const char *name)
-{
-   tree_t decl = hash_get(decl_hash, ident_new(name));
-   if (decl != NULL)
-      return decl;
-   else
-      fatal("cannot find name %s in elaborated design", name);
+   return c;
 }
 
-static void rt_cleanup_group(groupid_t gid, netid_t first, unsigned length)
+static rt_clock_t *rt_clock_sequence(rt_proc_t *proc)
 {
-   netgroup_t *g = &(groups[gid]);
+   // clk <= V0; wait for T0; clk <= V1; wait for T1; ...
 
-   RT_ASSERT(g->first == first);
-   RT_ASSERT(g->length == length);
+   const int nstmts = tree_stmts(proc->source);
+   if (nstmts < 4 || (nstmts % 2) != 0)
+      return NULL;
 
-   if (g->flags & NET_F_OWNS_MEM)
-      free(g->resolved);
+   tree_t decl = rt_clock_signal(tree_stmt(proc->source, 0));
+   if (decl == NULL)
+      return NULL;
 
-   free(g->forcing);
+   clock_step_t *steps LOCAL = xmalloc((nstmts / 2) * sizeof(clock_step_t));
+
+   for (int i = 0; i < nstmts; i += 2) {
+      tree_t s = tree_stmt(proc->source, i);
+      tree_t w = tree_stmt(proc->source, i + 1);
+
+      if (rt_clock_signal(s) != decl)
+         return NULL;
+
+      // Only zero delay assignments so no transaction is ever pending
+      // when the next is scheduled
+      tree_t wave = tree_waveform(s, 0);
+      uint64_t after = 0, reject = 0;
+      if (tree_has_delay(wave) && !rt_clock_time(tree_delay(wave), &after))
+         return NULL;
+      else if (tree_has_reject(s) && !rt_clock_time(tree_reject(s), &reject))
+         return NULL;
+      else if (after != 0 || reject != 0)
+         return NULL;
+
+      tree_t value = tree_value(wave);
+      int64_t ival;
+      unsigned pos;
+      if (folded_int(value, &ival))
+         steps[i / 2].value = ival;
+      else if (folded_enum(value, &pos))
+         steps[i / 2].value = pos;
+      else
+         return NULL;
 
-   for (int j = 0; j < g->n_drivers; j++) {
-      while (g->drivers[j].waveforms != NULL) {
-         waveform_t *next = g->drivers[j].waveforms->next;
-         rt_free_value(g, g->drivers[j].waveforms->values);
-         rt_free(waveform_stack, g->drivers[j].waveforms);
-         g->drivers[j].waveforms = next;
-      }
+      if (tree_kind(w) != T_WAIT || tree_has_value(w) || tree_triggers(w) > 0
+          || !tree_has_delay(w)
+          || !rt_clock_time(tree_delay(w), &(steps[i / 2].wait))
+          || steps[i / 2].wait == 0)
+         return NULL;
    }
-   free(g->drivers);
 
-   while (g->free_values != NULL) {
-      value_t *next = g->free_values->next;
-      free(g->free_values);
-      g->free_values = next;
-   }
+   rt_clock_t *c = rt_clock_new(CLOCK_SEQUENCE, proc, decl, nstmts / 2);
+   memcpy(c->steps, steps, (nstmts / 2) * sizeof(clock_step_t));
 
-   while (g->pending != NULL) {
-      sens_list_t *next = g->pending->next;
-      rt_free(sens_list_stack, g->pending);
-      g->pending = next;
-   }
+   return c;
+}
 
-   while (g->watching != NULL) {
-      watch_list_t *next = g->watching->next;
-      free(g->watching);
-      g->watching = next;
-   }
+static rt_clock_t *rt_clock_detect(rt_proc_t *proc)
+{
+   if (proc->postponed || tree_decls(proc->source) > 0)
+      return NULL;
+   else if (tree_stmts(proc->source) == 2)
+      return rt_clock_toggle(proc);
+   else
+      return rt_clock_sequence(proc);
 }
 
-static void rt_cleanup(tree_t top)
+static void rt_clock_start(void)
 {
-   RT_ASSERT(resume == NULL);
+   clock_start_pending = false;
+   clocks_enabled = (checkpoint_file == NULL) && (n_workers == 0);
 
-   while (heap_size(eventq_heap) > 0)
-      rt_free(event_stack, heap_extract_min(eventq_heap));
+   if (!clocks_enabled)
+      return;
 
-   rt_free_delta_events(delta_proc);
-   rt_free_delta_events(delta_driver);
+   for (size_t i = 0; i < n_procs; i++) {
+      rt_clock_t *c = procs[i].clock;
+      if (c == NULL || c->kind != CLOCK_SEQUENCE)
+         continue;
+      else if (c->group->size > sizeof(int64_t))
+         continue;
+
+      // Convert each literal to the representation used for the
+      // signal now its size is known
+      for (unsigned j = 0; j < c->nsteps; j++) {
+         const int64_t value = c->steps[j].value;
+         c->steps[j].value = 0;
+         switch (c->group->size) {
+         case 1: { int8_t v = value; memcpy(&(c->steps[j].value), &v, 1); }
+            break;
+         case 2: { int16_t v = value; memcpy(&(c->steps[j].value), &v, 2); }
+            break;
+         case 4: { int32_t v = value; memcpy(&(c->steps[j].value), &v, 4); }
+            break;
+         default:
+            c->steps[j].value = value;
+            break;
+         }
+      }
 
-   heap_free(eventq_heap);
-   eventq_heap = NULL;
+      // The process has been reset and will perform its first step in
+      // the initial delta cycle
+      c->phase = 0;
+      c->proc->native = true;
+      stats.native_clocks++;
 
-   netdb_walk(netdb, rt_cleanup_group);
-   netdb_close(netdb);
+      TRACE("native clock sequence %s driving %s",
+            istr(tree_ident(c->proc->source)), fmt_group(c->group));
+   }
+}
 
-   hash_free(decl_hash);
-   decl_hash = NULL;
+static void rt_clock_observe(rt_clock_t *c)
+{
+   // Take over a toggle once the process has been seen to schedule the
+   // value it read last time it ran
 
-   while (watches != NULL) {
-      watch_t *next = watches->chain_all;
-      rt_free(watch_stack, watches);
-      free(watches->groups);
-      watches = next;
-   }
+   if (c->kind != CLOCK_TOGGLE || !clocks_enabled)
+      return;
 
-   while (pending != NULL) {
-      sens_list_t *next = pending->next;
-      rt_free(sens_list_stack, pending);
-      pending = next;
-   }
+   netgroup_t *g = c->group;
+   if (g->n_drivers != 1 || g->drivers[0].proc != c->proc
+       || g->length != 1 || g->size > sizeof(int64_t)
+       || (g->flags & NET_F_FORCED))
+      return;
+   else if (g->resolution != NULL && !(g->resolution->flags & R_IDENT))
+      return;
 
-   for (int i = 0; i < RT_LAST_EVENT; i++) {
-      while (global_cbs[i] != NULL) {
-         callback_t *tmp = global_cbs[i]->next;
-         rt_free(callback_stack, global_cbs[i]);
-         global_cbs[i] = tmp;
-      }
+   waveform_t *w = g->drivers[0].waveforms->next;
+   if (w == NULL || w->next != NULL || w->when != now + c->after) {
+      c->observed = false;
+      return;
    }
 
-   rt_alloc_stack_destroy(event_stack);
-   rt_alloc_stack_destroy(waveform_stack);
-   rt_alloc_stack_destroy(sens_list_stack);
-   rt_alloc_stack_destroy(watch_stack);
-   rt_alloc_stack_destroy(callback_stack);
+   int64_t current = 0, next = 0;
+   memcpy(&current, g->resolved, g->size);
+   memcpy(&next, w->values->data, g->size);
 
-   hash_free(res_memo_hash);
-}
+   if (c->observed && current == c->steps[1].value
+       && next == c->steps[0].value && current != next) {
+      TRACE("native clock toggle %s driving %s",
+            istr(tree_ident(c->proc->source)), fmt_group(g));
 
-static bool rt_stop_now(uint64_t stop_time)
-{
-   if ((delta_driver != NULL) || (delta_proc != NULL))
-      return false;
-   else if (heap_size(eventq_heap) == 0)
-      return true;
-   else if (force_stop)
-      return true;
-   else if (stop_time == UINT64_MAX)
-      return false;
+      c->proc->native = true;
+      g->flags |= NET_F_CLOCK;
+      stats.native_clocks++;
+   }
    else {
-      event_t *peek = heap_min(eventq_heap);
-      return peek->when > stop_time;
+      c->steps[0].value = current;
+      c->steps[1].value = next;
+      c->observed = true;
    }
 }
 
-static int rt_proc_usage_cmp(const void *lhs, const void *rhs)
-{
-   return ((const rt_proc_t *)rhs)->usage - ((const rt_proc_t *)lhs)->usage;
-}
-
-static void rt_stats_print(void)
+static void rt_clock_demote(rt_clock_t *c)
 {
-   nvc_rusage_t ru;
-   nvc_rusage(&ru);
+   // Return control to the process which is still waiting for an event
+   // on the clock signal
 
-   if (profiling) {
-      notef("top processes by CPU usage");
-
-      qsort(procs, n_procs, sizeof(rt_proc_t), rt_proc_usage_cmp);
+   TRACE("native clock %s stopped", istr(tree_ident(c->proc->source)));
 
-      const uint64_t ru_us = ru.ms * 1000;
+   c->proc->native = false;
+   c->observed = false;
+   c->group->flags &= ~NET_F_CLOCK;
 
-      color_printf("$white$%10s %5s %s$$\n", "us", "%", "process");
-      for (size_t i = 0; i < MIN(n_procs, 10); i++) {
-         const double pc = ((double)procs[i].usage / ru_us) * 100.0;
-         printf("%10"PRIu64" %5.1f %s\n", procs[i].usage, pc,
-                istr(tree_ident(procs[i].source)));
+   for (sens_list_t *it = c->group->pending; it != NULL; it = it->next) {
+      if (it->proc == c->proc) {
+         if (it->reenq == NULL)
+            it->wakeup_gen = c->proc->wakeup_gen;
+         return;
       }
    }
 
-   notef("setup:%ums run:%ums maxrss:%ukB", ready_rusage.ms, ru.ms, ru.rss);
+   rt_sched_event(&(c->group->pending), NETID_INVALID, NETID_INVALID,
+                  c->proc, c->is_static);
 }
 
-static void rt_reset_coverage(tree_t top)
+static void rt_clock_tick(netgroup_t *group, rt_clock_t *c)
 {
-   int32_t *cover_stmts = jit_find_symbol("cover_stmts", false);
-   if (cover_stmts != NULL) {
-      const int ntags = tree_attr_int(top, ident_new("stmt_tags"), 0);
-      memset(cover_stmts, '\0', sizeof(int32_t) * ntags);
-   }
+   // Schedule the next edge as the process would have done when it
+   // resumed on this event
 
-   int32_t *cover_conds = jit_find_symbol("cover_conds", false);
-   if (cover_conds != NULL) {
-      const int ntags = tree_attr_int(top, ident_new("cond_tags"), 0);
-      memset(cover_conds, '\0', sizeof(int32_t) * ntags);
+   const int which = (memcmp(group->resolved, &(c->steps[0].value),
+                             group->size) == 0) ? 1 : 0;
+
+   if (unlikely(!(group->flags & NET_F_EVENT))
+       || (which == 0 && memcmp(group->resolved, &(c->steps[1].value),
+                                group->size) != 0)) {
+      rt_clock_demote(c);
+      return;
    }
+
+   value_t *v = rt_alloc_value(group);
+   memcpy(v->data, &(c->steps[which].value), group->size);
+
+   if (!rt_sched_driver(group, 0, c->after, c->reject, v))
+      deltaq_insert_driver(c->after, group, 1, c->proc, 0);
 }
 
-static void rt_emit_coverage(tree_t top)
+static void rt_clock_step(rt_clock_t *c)
 {
-   const int32_t *cover_stmts = jit_find_symbol("cover_stmts", false);
-   const int32_t *cover_conds = jit_find_symbol("cover_conds", false);
-   if (cover_stmts != NULL)
-      cover_report(top, cover_stmts, cover_conds);
+   // Perform one assignment and wait of a clock sequence
+
+   TRACE("native clock step %s", istr(tree_ident(c->proc->source)));
+
+   const clock_step_t *s = &(c->steps[c->phase]);
+   netgroup_t *g = c->group;
+
+   value_t *v = rt_alloc_value(g);
+   memcpy(v->data, &(s->value), g->size);
+
+   const int driver = rt_driver_index(g, c->proc);
+   if (!rt_sched_driver(g, driver, 0, 0, v))
+      deltaq_insert_driver(0, g, 1, c->proc, driver);
+
+   deltaq_insert_proc(s->wait, c->proc);
+
+   if (++(c->phase) == c->nsteps)
+      c->phase = 0;
 }
 
 static void rt_interrupt(void)
@@ -2484,29 +5457,84 @@ void rt_start_of_tool(tree_t top)
    trace_on = opt_get_int("rt_trace_en");
    profiling = opt_get_int("rt_profile");
 
+   if (prof_file != NULL)
+      rt_prof_start();
+
+   const int nthreads = opt_get_int("rt-threads");
+   if (nthreads > 1) {
+#if RT_MULTITHREAD
+      if (trace_on)
+         warnf("--threads is ignored when tracing is enabled");
+      else
+         rt_start_workers(nthreads);
+#else
+      warnf("multi-threaded simulation is not supported on this platform");
+#endif
+   }
+
+#if RT_MULTITHREAD
+   // A writer thread only helps if it can run alongside the simulation
+   wave_deferred = opt_get_int("rt-wave-thread")
+      && sysconf(_SC_NPROCESSORS_ONLN) > 1;
+#endif
+
+   cycle_based = opt_get_int("rt-cycle-based");
+   if (cycle_based && n_workers > 0) {
+      warnf("--cycle-based is ignored when running on multiple threads");
+      cycle_based = false;
+   }
+
    event_stack     = rt_alloc_stack_new(sizeof(event_t), "event");
    waveform_stack  = rt_alloc_stack_new(sizeof(waveform_t), "waveform");
    sens_list_stack = rt_alloc_stack_new(sizeof(sens_list_t), "sens_list");
    watch_stack     = rt_alloc_stack_new(sizeof(watch_t), "watch");
    callback_stack  = rt_alloc_stack_new(sizeof(callback_t), "callback");
+   bucket_stack    = rt_alloc_stack_new(sizeof(bucket_t), "bucket");
 
    n_active_alloc = 128;
    active_groups = xmalloc(n_active_alloc * sizeof(struct netgroup *));
 
    global_tmp_stack = mmap_guarded(GLOBAL_TMP_STACK_SZ, "global temp stack");
-   proc_tmp_stack   = mmap_guarded(PROC_TMP_STACK_SZ, "process temp stack");
+   proc_tmp_stack   = rt_tmp_stack_get("process temp stack");
 
    global_tmp_alloc = 0;
 
    rt_reset_coverage(top);
 
+   mem_add_source(rt_mem_stats);
+   mem_check("setting up %s", istr(tree_ident(top)));
+
    nvc_rusage(&ready_rusage);
 }
 
 void rt_end_of_tool(tree_t top)
 {
+#if RT_MULTITHREAD
+   if (n_workers > 0)
+      rt_stop_workers();
+#endif
+
+   rt_wave_stop();
+
+   if (prof_ring != NULL)
+      rt_prof_stop();
+
+   const char *stats_file = opt_get_str("rt-stats-json");
+   if (stats_file != NULL)
+      rt_stats_json(stats_file);
+
+   const char *pgo_file = opt_get_str("rt-pgo-collect");
+   if (pgo_file != NULL)
+      rt_pgo_write(pgo_file);
+
+   if (mem_enabled()) {
+      rt_mem_check();
+      mem_remove_source(rt_mem_stats);
+   }
+
    rt_cleanup(top);
    rt_emit_coverage(top);
+   dist_shutdown();
 
    jit_shutdown();
 
@@ -2514,13 +5542,103 @@ void rt_end_of_tool(tree_t top)
       rt_stats_print();
 }
 
+static uint64_t rt_next_event_time(void)
+{
+   while (wheel_size(eventq_wheel) > 0) {
+      bucket_t *peek = wheel_min(eventq_wheel);
+      if (!deltaq_purge_bucket(peek))
+         return peek->when;
+
+      rt_free(bucket_stack, deltaq_take_bucket());
+   }
+
+   return UINT64_MAX;
+}
+
+static void rt_dist_apply(uint32_t gid, const void *data, uint32_t len)
+{
+   // Force a signal driven on another node to its new value in the next
+   // delta cycle
+
+   if (gid >= netdb_size(netdb))
+      fatal("invalid net group %u from remote node", gid);
+
+   netgroup_t *g = &(groups[gid]);
+   if (len != g->size * g->length)
+      fatal("size mismatch for remote update to %s", fmt_group(g));
+   else if (g->n_drivers > 0)
+      fatal("signal %s is driven by processes on more than one node",
+            fmt_group(g));
+
+   g->flags |= NET_F_FORCED;
+
+   if (g->forcing == NULL)
+      g->forcing = rt_alloc_value(g);
+
+   memcpy(g->forcing->data, data, len);
+
+   deltaq_insert_driver(0, g, 1, NULL, -1);
+}
+
+static void rt_run_dist(uint64_t stop_time, int stop_delta)
+{
+   // Every node takes part in each decision so that all nodes run the
+   // same sequence of cycles: a node with nothing to do in a delta cycle
+   // or time step skips it but still advances its time
+
+   for (;;) {
+      const dist_status_t local = {
+         .when  = rt_next_event_time(),
+         .delta = rt_next_cycle_is_delta(),
+         .stop  = force_stop
+      };
+
+      const dist_status_t global = dist_sync(local, rt_dist_apply);
+
+      if (global.stop)
+         break;
+      else if (global.delta) {
+         if (rt_next_cycle_is_delta())
+            rt_cycle(stop_delta);
+      }
+      else if (global.when == UINT64_MAX || global.when > stop_time)
+         break;
+      else if (local.when == global.when)
+         rt_cycle(stop_delta);
+      else {
+         // Another node has events in this time step
+         if (iteration >= 0)
+            stats.deltas_per_step[rt_stats_bin(iteration)]++;
+         now = global.when;
+         iteration = 0;
+         rt_global_event(RT_NEXT_TIME_STEP);
+      }
+   }
+}
+
 void rt_run_sim(uint64_t stop_time)
 {
    const int stop_delta = opt_get_int("stop-delta");
 
    rt_global_event(RT_START_OF_SIMULATION);
-   while (!rt_stop_now(stop_time))
-      rt_cycle(stop_delta);
+
+   if (unlikely(clock_start_pending))
+      rt_clock_start();
+
+   if ((checkpoint_file != NULL) && (checkpoint_time <= stop_time)) {
+      while (!rt_stop_now(checkpoint_time))
+         rt_cycle(stop_delta);
+
+      if (!force_stop)
+         rt_checkpoint(checkpoint_file);
+   }
+
+   if (dist_enabled())
+      rt_run_dist(stop_time, stop_delta);
+   else {
+      while (!rt_stop_now(stop_time))
+         rt_cycle(stop_delta);
+   }
    rt_global_event(RT_END_OF_SIMULATION);
 }
 
@@ -2534,7 +5652,7 @@ void rt_run_interactive(uint64_t stop_time)
 {
    if (aborted)
       errorf("simulation has aborted and must be restarted");
-   else if ((heap_size(eventq_heap) == 0) && (delta_proc == NULL))
+   else if ((wheel_size(eventq_wheel) == 0) && (delta_proc == NULL))
       warnf("no future simulation events");
    else {
       set_fatal_fn(rt_interactive_fatal);
@@ -2548,9 +5666,11 @@ void rt_run_interactive(uint64_t stop_time)
 
 void rt_restart(tree_t top)
 {
+   rt_wave_flush();
    rt_setup(top);
    rt_initial(top);
    aborted = false;
+   clock_start_pending = true;
 }
 
 void rt_set_timeout_cb(uint64_t when, timeout_fn_t fn, void *user)
@@ -2559,6 +5679,8 @@ void rt_set_timeout_cb(uint64_t when, timeout_fn_t fn, void *user)
    e->when         = now + when;
    e->kind         = E_TIMEOUT;
    e->group        = NULL;
+   e->driver       = 0;
+   e->ngroups      = 0;
    e->proc         = NULL;
    e->timeout_fn   = fn;
    e->timeout_user = user;
@@ -2567,6 +5689,40 @@ void rt_set_timeout_cb(uint64_t when, timeout_fn_t fn, void *user)
    deltaq_insert(e);
 }
 
+static watch_t *rt_new_watch(tree_t s, sig_event_fn_t fn, void *user,
+                             bool postponed)
+{
+   watch_t *w = rt_alloc(watch_stack);
+   RT_ASSERT(w != NULL);
+   w->signal        = s;
+   w->fn            = fn;
+   w->chain_all     = watches;
+   w->chain_pending = NULL;
+   w->pending       = false;
+   w->groups        = NULL;
+   w->n_groups      = 0;
+   w->first         = NULL;
+   w->changed       = NULL;
+   w->n_changed     = 0;
+   w->is_changed    = NULL;
+   w->user_data     = user;
+   w->length        = 0;
+   w->nbytes        = 0;
+   w->postponed     = postponed;
+   w->deferred      = false;
+   w->wave          = false;
+
+   type_t type = tree_type(s);
+   if (type_is_array(type))
+      w->dir = direction_of(type, 0);
+   else
+      w->dir = RANGE_TO;
+
+   watches = w;
+
+   return w;
+}
+
 watch_t *rt_set_event_cb(tree_t s, sig_event_fn_t fn, void *user,
                          bool postponed)
 {
@@ -2584,32 +5740,35 @@ watch_t *rt_set_event_cb(tree_t s, sig_event_fn_t fn, void *user,
       return NULL;
    }
    else {
-      watch_t *w = rt_alloc(watch_stack);
-      RT_ASSERT(w != NULL);
-      w->signal        = s;
-      w->fn            = fn;
-      w->chain_all     = watches;
-      w->chain_pending = NULL;
-      w->pending       = false;
-      w->groups        = NULL;
-      w->n_groups      = 0;
-      w->user_data     = user;
-      w->length        = 0;
-      w->postponed     = postponed;
-
-      type_t type = tree_type(s);
-      if (type_is_array(type))
-         w->dir = direction_of(type, 0);
-      else
-         w->dir = RANGE_TO;
-
-      watches = w;
-
-      rt_watch_signal(w);
+      watch_t *w = rt_new_watch(s, fn, user, postponed);
+      rt_watch_signal(w, true);
       return w;
    }
 }
 
+watch_t *rt_set_wave_cb(tree_t s, sig_event_fn_t fn, void *user)
+{
+   // Waveform callbacks only ever see the value of the signal so can run
+   // on the writer thread with a copy taken at the end of the time step
+
+   watch_t *w = rt_set_event_cb(s, fn, user, true);
+   w->deferred = wave_deferred;
+   w->wave     = true;
+   return w;
+}
+
+watch_t *rt_set_value_watch(tree_t s)
+{
+   // Resolves the net groups of a signal once for repeated calls to
+   // rt_watch_value without being notified of events
+
+   RT_ASSERT(tree_kind(s) == T_SIGNAL_DECL);
+
+   watch_t *w = rt_new_watch(s, NULL, NULL, false);
+   rt_watch_signal(w, false);
+   return w;
+}
+
 void rt_set_global_cb(rt_event_t event, rt_event_fn_t fn, void *user)
 {
    RT_ASSERT(event < RT_LAST_EVENT);
@@ -2622,14 +5781,30 @@ void rt_set_global_cb(rt_event_t event, rt_event_fn_t fn, void *user)
    global_cbs[event] = cb;
 }
 
+static inline const void *rt_watch_data(netgroup_t *g, const char **copy)
+{
+   // Values copied for the waveform writer thread follow each other in
+   // the same order as the groups
+
+   if (likely(*copy == NULL))
+      return g->resolved;
+
+   const void *data = *copy;
+   *copy += g->size * g->length;
+   return data;
+}
+
 size_t rt_watch_value(watch_t *w, uint64_t *buf, size_t max, bool last)
 {
+   const char *copy = last ? NULL : wave_values;
+
    int offset = 0;
    for (int i = 0; (i < w->n_groups) && (offset < max); i++) {
       netgroup_t *g = w->groups[i];
+      const void *data = last ? g->last_value : rt_watch_data(g, &copy);
 
 #define SIGNAL_VALUE_EXPAND_U64(type) do {                              \
-         const type *sp = (type *)(last ? g->last_value : g->resolved); \
+         const type *sp = data;                                         \
          for (int j = 0; (j < g->length) && (offset + j < max); j++)    \
             buf[offset + j] = sp[j];                                    \
       } while (0)
@@ -2642,11 +5817,10 @@ size_t rt_watch_value(watch_t *w, uint64_t *buf, size_t max, bool last)
    return offset;
 }
 
-static size_t rt_group_string(netgroup_t *group, const char *map,
-                              char *buf, const char *end1)
+static size_t rt_group_string(netgroup_t *group, const char *vals,
+                              const char *map, char *buf, const char *end1)
 {
    char *bp = buf;
-   const char *vals = group->resolved;
 
    if (likely(map != NULL)) {
       for (int j = 0; j < group->length; j++) {
@@ -2667,13 +5841,59 @@ static size_t rt_group_string(netgroup_t *group, const char *map,
    return bp - buf;
 }
 
+int rt_watch_groups(watch_t *w)
+{
+   return w->n_groups;
+}
+
+void rt_watch_group_range(watch_t *w, int group, int *first, int *length)
+{
+   RT_ASSERT(group < w->n_groups);
+
+   *first = w->first[group];
+   *length = w->groups[group]->length;
+}
+
+int rt_watch_changes(watch_t *w, const int **changed)
+{
+   // Groups that changed since the callback last ran for this watch
+
+   if (wave_values != NULL) {
+      *changed = wave_changed;
+      return wave_n_changed;
+   }
+   else {
+      *changed = w->changed;
+      return w->n_changed;
+   }
+}
+
+size_t rt_watch_group_string(watch_t *w, int group, const char *map,
+                             char *buf, size_t max)
+{
+   RT_ASSERT(group < w->n_groups);
+
+   // Every group in a signal with a string representation has the same
+   // element size so the offset into the copied values is simple
+
+   netgroup_t *g = w->groups[group];
+   const char *vals = g->resolved;
+   if (wave_values != NULL)
+      vals = wave_values + w->first[group] * g->size;
+
+   return rt_group_string(g, vals, map, buf, buf + max) + 1;
+}
+
 size_t rt_watch_string(watch_t *w, const char *map, char *buf, size_t max)
 {
+   const char *copy = wave_values;
+
    char *bp = buf;
    size_t offset = 0;
    for (int i = 0; i < w->n_groups; i++) {
       netgroup_t *g = w->groups[i];
-      bp += rt_group_string(g, map, bp, buf + max);
+      const char *vals = rt_watch_data(g, &copy);
+      bp += rt_group_string(g, vals, map, bp, buf + max);
       offset += g->length;
    }
 
@@ -2688,7 +5908,7 @@ size_t rt_signal_string(tree_t s, const char *map, char *buf, size_t max)
    while (offset < nnets) {
       netid_t nid = tree_net(s, offset);
       netgroup_t *g = &(groups[netdb_lookup(netdb, nid)]);
-      bp += rt_group_string(g, map, bp, buf + max);
+      bp += rt_group_string(g, g->resolved, map, bp, buf + max);
       offset += g->length;
    }
 
@@ -2745,7 +5965,7 @@ bool rt_force_signal(tree_t s, const uint64_t *buf, size_t count,
       FOR_ALL_SIZES(g->size, SIGNAL_FORCE_EXPAND_U64);
 
       if (propagate)
-         deltaq_insert_driver(0, g, NULL);
+         deltaq_insert_driver(0, g, 1, NULL, -1);
 
       offset += g->length;
    }
@@ -2753,6 +5973,28 @@ bool rt_force_signal(tree_t s, const uint64_t *buf, size_t count,
    return (offset == count);
 }
 
+bool rt_sandbox_call(void (*fn)(void *), void *context)
+{
+   // Run native code at elaboration time: any failed check or report
+   // abandons the call so the caller can fall back to the interpreter
+
+   jmp_buf env, *saved_jmp = sandbox_jmp;
+   const side_effect_t saved_effect = init_side_effect;
+
+   init_side_effect = SIDE_EFFECT_DISALLOW;
+
+   bool ok = false;
+   if (setjmp(env) == 0) {
+      sandbox_jmp = &env;
+      (*fn)(context);
+      ok = (init_side_effect != SIDE_EFFECT_OCCURRED);
+   }
+
+   sandbox_jmp      = saved_jmp;
+   init_side_effect = saved_effect;
+   return ok;
+}
+
 bool rt_can_create_delta(void)
 {
    return can_create_delta;
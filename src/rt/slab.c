@@ -0,0 +1,363 @@
+//
+//  Copyright (C) 2018  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "util.h"
+#include "rt.h"
+#include "slab.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+
+#ifdef __MINGW32__
+#include <malloc.h>
+#endif
+
+// Each slab is a naturally aligned block so its header can be found from
+// any object address by masking. Objects are served first from a
+// per-thread magazine and the class lock is only taken to move half a
+// magazine to or from the slabs. A slab whose objects have all been
+// returned is released unless it is the only empty slab in its class.
+
+#define SLAB_SIZE   (64 * 1024)
+#define SLAB_HEADER 64
+#define MAG_SIZE    32
+#define MAG_XFER    (MAG_SIZE / 2)
+#define N_CLASSES   17
+#define MAX_CLASS   4096
+
+#if RT_MULTITHREAD
+#define SLAB_TLS __thread
+#else
+#define SLAB_TLS
+#endif
+
+typedef struct slab     slab_t;
+typedef struct free_obj free_obj_t;
+
+struct free_obj {
+   free_obj_t *next;
+};
+
+struct slab {
+   slab_t     *next;
+   slab_t     *prev;
+   free_obj_t *free;
+   char       *bump;
+   unsigned    used;
+   unsigned    capacity;
+   unsigned    cls;
+   bool        listed;
+};
+
+typedef struct {
+   volatile int lock;
+   slab_t      *avail;
+   unsigned     nempty;
+   size_t       live;
+   size_t       peak;
+   size_t       nslabs;
+} slab_class_t;
+
+typedef struct {
+   unsigned  count;
+   void     *items[MAG_SIZE];
+} magazine_t;
+
+static const unsigned class_size[N_CLASSES] = {
+   16, 24, 32, 48, 64, 96, 128, 192, 256, 384, 512,
+   768, 1024, 1536, 2048, 3072, 4096
+};
+
+static slab_class_t classes[N_CLASSES];
+static slab_class_t large;
+
+static SLAB_TLS magazine_t magazines[N_CLASSES];
+
+static inline void slab_lock(slab_class_t *c)
+{
+#if RT_MULTITHREAD
+   while (__sync_lock_test_and_set(&(c->lock), 1)) {
+      while (c->lock)
+         ;
+   }
+#endif
+}
+
+static inline void slab_unlock(slab_class_t *c)
+{
+#if RT_MULTITHREAD
+   __sync_lock_release(&(c->lock));
+#endif
+}
+
+static inline unsigned slab_class(size_t size)
+{
+   // Classes are powers of two with an extra step half way between each
+
+   if (size <= class_size[0])
+      return 0;
+
+   const size_t n = size - 1;
+   const int msb = 63 - __builtin_clzll(n);
+   const int half = (n >> (msb - 1)) & 1;
+   return (msb - 4) * 2 + half + 1;
+}
+
+static inline slab_t *slab_of(void *ptr)
+{
+   return (slab_t *)((uintptr_t)ptr & ~(uintptr_t)(SLAB_SIZE - 1));
+}
+
+static void slab_link(slab_class_t *c, slab_t *s)
+{
+   assert(!s->listed);
+
+   s->prev = NULL;
+   s->next = c->avail;
+   if (c->avail != NULL)
+      c->avail->prev = s;
+   c->avail  = s;
+   s->listed = true;
+}
+
+static void slab_unlink(slab_class_t *c, slab_t *s)
+{
+   assert(s->listed);
+
+   if (s->prev != NULL)
+      s->prev->next = s->next;
+   else
+      c->avail = s->next;
+
+   if (s->next != NULL)
+      s->next->prev = s->prev;
+
+   s->listed = false;
+}
+
+static slab_t *slab_new(unsigned cls)
+{
+   void *mem;
+#ifdef __MINGW32__
+   if ((mem = _aligned_malloc(SLAB_SIZE, SLAB_SIZE)) == NULL)
+#else
+   if (posix_memalign(&mem, SLAB_SIZE, SLAB_SIZE) != 0)
+#endif
+      fatal("memory exhausted (slab %u)", class_size[cls]);
+
+   slab_t *s = mem;
+   s->next     = NULL;
+   s->prev     = NULL;
+   s->free     = NULL;
+   s->bump     = (char *)mem + SLAB_HEADER;
+   s->used     = 0;
+   s->capacity = (SLAB_SIZE - SLAB_HEADER) / class_size[cls];
+   s->cls      = cls;
+   s->listed   = false;
+
+   classes[cls].nslabs++;
+   classes[cls].nempty++;
+   slab_link(&(classes[cls]), s);
+
+   return s;
+}
+
+static void slab_release(slab_class_t *c, slab_t *s)
+{
+   assert(s->used == 0);
+
+   slab_unlink(c, s);
+   c->nslabs--;
+   c->nempty--;
+
+#ifdef __MINGW32__
+   _aligned_free(s);
+#else
+   free(s);
+#endif
+}
+
+static void slab_refill(unsigned cls, magazine_t *m)
+{
+   slab_class_t *c = &(classes[cls]);
+   const size_t size = class_size[cls];
+
+   slab_lock(c);
+
+   while (m->count < MAG_XFER) {
+      slab_t *s = c->avail;
+      if (s == NULL)
+         s = slab_new(cls);
+
+      if (s->used == 0)
+         c->nempty--;
+
+      void *obj;
+      if (s->free != NULL) {
+         obj = s->free;
+         s->free = s->free->next;
+      }
+      else {
+         obj = s->bump;
+         s->bump += size;
+      }
+
+      if (++(s->used) == s->capacity)
+         slab_unlink(c, s);
+
+      m->items[(m->count)++] = obj;
+      c->live++;
+   }
+
+   c->peak = MAX(c->peak, c->live);
+
+   slab_unlock(c);
+}
+
+static void slab_flush(unsigned cls, magazine_t *m, unsigned n)
+{
+   // Return the oldest objects so the most recently freed stay cached and
+   // long lived slabs are not pinned by objects stuck in the magazine
+
+   slab_class_t *c = &(classes[cls]);
+
+   slab_lock(c);
+
+   for (unsigned i = 0; i < n; i++) {
+      free_obj_t *obj = m->items[i];
+      slab_t *s = slab_of(obj);
+      assert(s->cls == cls);
+
+      obj->next = s->free;
+      s->free = obj;
+
+      if (!s->listed)
+         slab_link(c, s);
+
+      if (--(s->used) == 0) {
+         if (c->nempty++ > 0)
+            slab_release(c, s);
+      }
+
+      c->live--;
+   }
+
+   slab_unlock(c);
+
+   m->count -= n;
+   memmove(m->items, m->items + n, m->count * sizeof(void *));
+}
+
+void *slab_alloc(size_t size)
+{
+   if (unlikely(size > MAX_CLASS)) {
+      slab_lock(&large);
+      large.live += size;
+      large.peak = MAX(large.peak, large.live);
+      slab_unlock(&large);
+
+      return xmalloc(size);
+   }
+
+   const unsigned cls = slab_class(size);
+   magazine_t *m = &(magazines[cls]);
+   if (unlikely(m->count == 0))
+      slab_refill(cls, m);
+
+   return m->items[--(m->count)];
+}
+
+void slab_free(void *ptr, size_t size)
+{
+   if (unlikely(size > MAX_CLASS)) {
+      slab_lock(&large);
+      large.live -= size;
+      slab_unlock(&large);
+
+      free(ptr);
+      return;
+   }
+
+   const unsigned cls = slab_class(size);
+   magazine_t *m = &(magazines[cls]);
+   if (unlikely(m->count == MAG_SIZE))
+      slab_flush(cls, m, MAG_XFER);
+
+   m->items[(m->count)++] = ptr;
+}
+
+void slab_flush_thread(void)
+{
+   // Return all objects cached by the calling thread
+
+   for (unsigned i = 0; i < N_CLASSES; i++) {
+      if (magazines[i].count > 0)
+         slab_flush(i, &(magazines[i]), magazines[i].count);
+   }
+}
+
+void slab_trim(void)
+{
+   slab_flush_thread();
+
+   for (unsigned i = 0; i < N_CLASSES; i++) {
+      slab_class_t *c = &(classes[i]);
+      slab_lock(c);
+
+      for (slab_t *s = c->avail, *next; s != NULL; s = next) {
+         next = s->next;
+         if (s->used == 0)
+            slab_release(c, s);
+      }
+
+      assert(c->nempty == 0);
+      slab_unlock(c);
+   }
+}
+
+void slab_walk_stats(slab_stats_fn_t fn, void *context)
+{
+   for (unsigned i = 0; i < N_CLASSES; i++) {
+      slab_class_t *c = &(classes[i]);
+      slab_lock(c);
+
+      const slab_stats_t stats = {
+         .size       = class_size[i],
+         .live_bytes = c->live * class_size[i],
+         .peak_bytes = c->peak * class_size[i],
+         .slabs      = c->nslabs
+      };
+
+      slab_unlock(c);
+      (*fn)(&stats, context);
+   }
+
+   slab_lock(&large);
+
+   const slab_stats_t stats = {
+      .size       = 0,
+      .live_bytes = large.live,
+      .peak_bytes = large.peak,
+      .slabs      = 0
+   };
+
+   slab_unlock(&large);
+   (*fn)(&stats, context);
+}
@@ -0,0 +1,44 @@
+//
+//  Copyright (C) 2018  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _SLAB_H
+#define _SLAB_H
+
+#include <stddef.h>
+
+// Shared allocator for variable sized objects such as signal values.
+// Requests are rounded up to one of a fixed set of size classes and
+// served from slabs shared by all callers, with a small per-thread cache
+// of free objects in front of each class. The caller must pass the same
+// size to slab_free as it passed to slab_alloc.
+
+typedef struct {
+   size_t size;         // Zero for objects larger than any class
+   size_t live_bytes;
+   size_t peak_bytes;
+   size_t slabs;
+} slab_stats_t;
+
+typedef void (*slab_stats_fn_t)(const slab_stats_t *stats, void *context);
+
+void *slab_alloc(size_t size);
+void slab_free(void *ptr, size_t size);
+void slab_flush_thread(void);
+void slab_trim(void);
+void slab_walk_stats(slab_stats_fn_t fn, void *context);
+
+#endif  // _SLAB_H
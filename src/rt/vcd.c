@@ -25,6 +25,14 @@
 #include <string.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <stdarg.h>
+#include <zlib.h>
+
+// Changes are formatted by hand into a large buffer which is written out
+// in one go when full, optionally through a gzip stream if the file name
+// ends in .gz.
+
+#define VCD_BUF_SIZE (256 * 1024)
 
 typedef struct vcd_data vcd_data_t;
 
@@ -32,6 +40,7 @@ typedef void (*vcd_fmt_fn_t)(tree_t, watch_t *, vcd_data_t *);
 
 struct vcd_data {
    char          key[64];
+   size_t        key_len;
    vcd_fmt_fn_t  fmt;
    range_kind_t  dir;
    const char   *map;
@@ -40,36 +49,125 @@ struct vcd_data {
 };
 
 static FILE    *vcd_file;
+static gzFile   vcd_gz;
+static char    *vcd_fname;
+static char    *vcd_buf;
+static size_t   vcd_buf_len;
+static size_t   vcd_buf_max;
+static bool     vcd_dirty;
 static tree_t   vcd_top;
 static ident_t  vcd_data_i;
 static uint64_t last_time;
 
+static void vcd_flush(void)
+{
+   if (vcd_buf_len == 0)
+      return;
+
+   if (vcd_gz != NULL) {
+      if (gzwrite(vcd_gz, vcd_buf, vcd_buf_len) != (int)vcd_buf_len)
+         fatal("failed writing VCD output %s", vcd_fname);
+   }
+   else if (fwrite(vcd_buf, vcd_buf_len, 1, vcd_file) != 1)
+      fatal_errno("failed writing VCD output %s", vcd_fname);
+
+   vcd_buf_len = 0;
+   vcd_dirty = true;
+}
+
+static inline char *vcd_reserve(size_t len)
+{
+   if (unlikely(len > vcd_buf_max - vcd_buf_len)) {
+      vcd_flush();
+      if (len > vcd_buf_max) {
+         vcd_buf_max = len;
+         vcd_buf = xrealloc(vcd_buf, vcd_buf_max);
+      }
+   }
+
+   return vcd_buf + vcd_buf_len;
+}
+
+static void vcd_printf(const char *fmt, ...)
+{
+   va_list ap, ap2;
+   va_start(ap, fmt);
+   va_copy(ap2, ap);
+
+   const int len = vsnprintf(NULL, 0, fmt, ap);
+   char *p = vcd_reserve(len + 1);
+   vsnprintf(p, len + 1, fmt, ap2);
+   vcd_buf_len += len;
+
+   va_end(ap2);
+   va_end(ap);
+}
+
+static void vcd_puts(const char *str)
+{
+   const size_t len = strlen(str);
+   memcpy(vcd_reserve(len), str, len);
+   vcd_buf_len += len;
+}
+
+static inline char *vcd_put_key(char *p, vcd_data_t *data)
+{
+   *p++ = ' ';
+   memcpy(p, data->key, data->key_len);
+   p += data->key_len;
+   *p++ = '\n';
+   return p;
+}
+
 static void vcd_fmt_int(tree_t decl, watch_t *w, vcd_data_t *data)
 {
    uint64_t val;
    rt_watch_value(w, &val, 1, false);
 
-   char buf[data->size + 1];
+   char *p = vcd_reserve(data->size + data->key_len + 3);
+   *p++ = 'b';
    for (size_t i = 0; i < data->size; i++)
-      buf[data->size - 1 - i] = (val & (1 << i)) ? '1' : '0';
-   buf[data->size] = '\0';
+      p[data->size - 1 - i] = '0' + ((val >> i) & 1);
+   p = vcd_put_key(p + data->size, data);
 
-   fprintf(vcd_file, "b%s %s\n", buf, data->key);
+   vcd_buf_len = p - vcd_buf;
 }
 
 static void vcd_fmt_chars(tree_t decl, watch_t *w, vcd_data_t *data)
 {
-   const int nvals = data->size;
-   char buf[nvals + 1];
-   rt_watch_string(w, data->map, buf, nvals + 1);
+   // The translated values are written straight into the output buffer
+
+   char *p = vcd_reserve(data->size + data->key_len + 3);
+   *p++ = 'b';
+   rt_watch_string(w, data->map, p, data->size + 1);
+   p = vcd_put_key(p + data->size, data);
 
-   fprintf(vcd_file, "b%s %s\n", buf, data->key);
+   vcd_buf_len = p - vcd_buf;
+}
+
+static void vcd_emit_time(uint64_t now)
+{
+   char digits[24];
+   char *dp = digits + sizeof(digits);
+   do {
+      *--dp = '0' + (now % 10);
+      now /= 10;
+   } while (now > 0);
+
+   const size_t ndigits = digits + sizeof(digits) - dp;
+   char *p = vcd_reserve(ndigits + 2);
+   *p++ = '#';
+   memcpy(p, dp, ndigits);
+   p += ndigits;
+   *p++ = '\n';
+
+   vcd_buf_len = p - vcd_buf;
 }
 
 static void vcd_event_cb(uint64_t now, tree_t decl, watch_t *w, void *user)
 {
    if (now != last_time) {
-      fprintf(vcd_file, "#%"PRIu64"\n", now);
+      vcd_emit_time(now);
       last_time = now;
    }
 
@@ -78,7 +176,7 @@ static void vcd_event_cb(uint64_t now, tree_t decl, watch_t *w, void *user)
       (*data->fmt)(decl, w, data);
 }
 
-static void vcd_key_fmt(int key, char *buf)
+static size_t vcd_key_fmt(int key, char *buf)
 {
    char *p = buf;
    do {
@@ -86,20 +184,58 @@ static void vcd_key_fmt(int key, char *buf)
       key /= (126 - 33);
    } while (key > 0);
    *p = '\0';
+
+   return p - buf;
+}
+
+static void vcd_open(void)
+{
+   const size_t len = strlen(vcd_fname);
+   if (len > 3 && strcmp(vcd_fname + len - 3, ".gz") == 0) {
+      if ((vcd_gz = gzopen(vcd_fname, "wb")) == NULL)
+         fatal_errno("failed to open VCD output %s", vcd_fname);
+   }
+   else if ((vcd_file = fopen(vcd_fname, "wb")) == NULL)
+      fatal_errno("failed to open VCD output %s", vcd_fname);
+
+   vcd_dirty = false;
+}
+
+static void vcd_close(void)
+{
+   if (vcd_file == NULL && vcd_gz == NULL)
+      return;
+
+   vcd_flush();
+
+   if (vcd_gz != NULL) {
+      gzclose(vcd_gz);
+      vcd_gz = NULL;
+   }
+   else {
+      fclose(vcd_file);
+      vcd_file = NULL;
+   }
 }
 
 static void vcd_emit_header(void)
 {
-   rewind(vcd_file);
+   // Start the file again if anything was already written
+
+   vcd_buf_len = 0;
+   if (vcd_dirty) {
+      vcd_close();
+      vcd_open();
+   }
 
    char tmbuf[64];
    time_t t = time(NULL);
    struct tm *tm = localtime(&t);
    strftime(tmbuf, sizeof(tmbuf), "%a, %d %b %Y %T %z", tm);
-   fprintf(vcd_file, "$date\n  %s\n$end\n", tmbuf);
+   vcd_printf("$date\n  %s\n$end\n", tmbuf);
 
-   fprintf(vcd_file, "$version\n  "PACKAGE_STRING"\n$end\n");
-   fprintf(vcd_file, "$timescale\n  1 fs\n$end\n");
+   vcd_puts("$version\n  "PACKAGE_STRING"\n$end\n");
+   vcd_puts("$timescale\n  1 fs\n$end\n");
 }
 
 static bool vcd_can_fmt_chars(type_t type, vcd_data_t *data)
@@ -193,19 +329,18 @@ static void vcd_process_signal(tree_t d, int *next_key)
 
    tree_add_attr_ptr(d, vcd_data_i, data);
 
-   data->watch = rt_set_event_cb(d, vcd_event_cb, data, true);
+   data->watch = rt_set_wave_cb(d, vcd_event_cb, data);
 
-   vcd_key_fmt(*next_key, data->key);
+   data->key_len = vcd_key_fmt(*next_key, data->key);
 
-   fprintf(vcd_file, "$var reg %d %s %s $end\n",
-           (int)data->size, data->key, name);
+   vcd_printf("$var reg %d %s %s $end\n", (int)data->size, data->key, name);
 
    ++(*next_key);
 }
 
 void vcd_restart(void)
 {
-   if (vcd_file == NULL)
+   if (vcd_file == NULL && vcd_gz == NULL)
       return;
 
    vcd_emit_header();
@@ -216,7 +351,7 @@ void vcd_restart(void)
       tree_t d = tree_decl(vcd_top, i);
       switch (tree_kind(d)) {
       case T_HIER:
-         fprintf(vcd_file, "$scope module %s $end\n", istr(tree_ident(d)));
+         vcd_printf("$scope module %s $end\n", istr(tree_ident(d)));
          break;
       case T_SIGNAL_DECL:
          if (wave_should_dump(d))
@@ -228,12 +363,12 @@ void vcd_restart(void)
 
       int npop = tree_attr_int(d, ident_new("scope_pop"), 0);
       while (npop-- > 0)
-         fprintf(vcd_file, "$upscope $end\n");
+         vcd_puts("$upscope $end\n");
    }
 
-   fprintf(vcd_file, "$enddefinitions $end\n");
+   vcd_puts("$enddefinitions $end\n");
 
-   fprintf(vcd_file, "$dumpvars\n");
+   vcd_puts("$dumpvars\n");
 
    last_time = UINT64_MAX;
 
@@ -242,11 +377,11 @@ void vcd_restart(void)
       if (tree_kind(d) == T_SIGNAL_DECL) {
          vcd_data_t *data = tree_attr_ptr(d, vcd_data_i);
          if (likely(data != NULL))
-            vcd_event_cb(0, d, data->watch, data);
+            vcd_event_cb(rt_now(NULL), d, data->watch, data);
       }
    }
 
-   fprintf(vcd_file, "$end\n");
+   vcd_puts("$end\n");
 }
 
 void vcd_init(const char *filename, tree_t top)
@@ -260,7 +395,11 @@ void vcd_init(const char *filename, tree_t top)
          "designs. If you are using GtkWave the --wave option will generate "
          "an FST file that overcomes these limitations.");
 
-   vcd_file = fopen(filename, "w");
-   if (vcd_file == NULL)
-      fatal_errno("failed to open VCD output %s", filename);
+   vcd_fname   = strdup(filename);
+   vcd_buf_max = VCD_BUF_SIZE;
+   vcd_buf     = xmalloc(vcd_buf_max);
+
+   vcd_open();
+
+   atexit(vcd_close);
 }
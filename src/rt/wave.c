@@ -18,45 +18,32 @@
 #include "rt.h"
 #include "util.h"
 #include "tree.h"
+#include "globset.h"
 
 #include <string.h>
+#include <limits.h>
 
-typedef struct {
-   char  *text;
-   size_t len;
-} glob_t;
+// Each signal name is matched against all the patterns in a set at once
+// so the cost does not grow with the number of patterns
 
-static int     n_incl = 0;
-static int     incl_sz = 0;
-static int     n_excl = 0;
-static int     excl_sz = 0;
-static glob_t *incl;
-static glob_t *excl;
+static glob_set_t *incl = NULL;
+static glob_set_t *excl = NULL;
+static int         max_depth = INT_MAX;
 
 void wave_include_glob(const char *glob)
 {
-   if (n_incl == incl_sz) {
-      incl_sz = MAX(incl_sz * 2, 256);
-      incl = xrealloc(incl, incl_sz * sizeof(glob_t));
-   }
-
-   incl[n_incl].text = strdup(glob);
-   incl[n_incl].len  = strlen(glob);
+   if (incl == NULL)
+      incl = glob_set_new();
 
-   n_incl++;
+   glob_set_add(incl, glob);
 }
 
 void wave_exclude_glob(const char *glob)
 {
-   if (n_excl == excl_sz) {
-      excl_sz = MAX(excl_sz * 2, 256);
-      excl = xrealloc(excl, excl_sz * sizeof(glob_t));
-   }
-
-   excl[n_excl].text = strdup(glob);
-   excl[n_excl].len  = strlen(glob);
+   if (excl == NULL)
+      excl = glob_set_new();
 
-   n_excl++;
+   glob_set_add(excl, glob);
 }
 
 static void wave_process_file(const char *fname, bool include)
@@ -102,19 +89,36 @@ void wave_include_file(const char *base)
    wave_process_file(buf, false);
 }
 
+void wave_set_depth(int depth)
+{
+   max_depth = depth;
+}
+
+static int wave_depth(const char *name)
+{
+   // Signals in the top level entity have depth one
+
+   int depth = -1;
+   for (const char *p = name; *p != '\0'; p++) {
+      if (*p == ':')
+         depth++;
+   }
+
+   return depth;
+}
+
 bool wave_should_dump(tree_t decl)
 {
    ident_t name = tree_ident(decl);
 
-   for (int i = 0; i < n_excl; i++) {
-      if (ident_glob(name, excl[i].text, excl[i].len))
-         return false;
-   }
+   if (max_depth != INT_MAX && wave_depth(istr(name)) > max_depth)
+      return false;
 
-   for (int i = 0; i < n_incl; i++) {
-      if (ident_glob(name, incl[i].text, incl[i].len))
-         return true;
-   }
+   if (excl != NULL && glob_set_first(excl, name) >= 0)
+      return false;
+
+   if (incl == NULL)
+      return true;
 
-   return (n_incl == 0);
+   return glob_set_first(incl, name) >= 0;
 }
@@ -0,0 +1,383 @@
+//
+//  Copyright (C) 2018  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "util.h"
+#include "wheel.h"
+#include "heap.h"
+
+#include <stdlib.h>
+#include <assert.h>
+
+// Each level of the wheel has 256 slots indexed by one byte of the key.
+// An entry is stored at the level of the most significant byte in which
+// its key differs from the base, which is the last key extracted. When
+// the lowest level is exhausted the next occupied slot above it is
+// cascaded down. Keys which differ from the base above the top level
+// are kept in a binary heap until the wheel drains. Peeking at the
+// minimum may cascade and advance the base beyond the last key
+// extracted: keys inserted before the new base are kept in a short
+// sorted list which is drained ahead of the wheel.
+
+#define WHEEL_BITS   8
+#define WHEEL_SLOTS  (1 << WHEEL_BITS)
+#define WHEEL_MASK   (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 6
+#define WHEEL_SPAN   (WHEEL_BITS * WHEEL_LEVELS)
+#define CHUNK_SIZE   256
+
+typedef struct wheel_node  wheel_node_t;
+typedef struct wheel_chunk wheel_chunk_t;
+
+struct wheel_node {
+   uint64_t      key;
+   uint64_t      seq;
+   void         *user;
+   wheel_node_t *next;
+};
+
+struct wheel_chunk {
+   wheel_chunk_t *next;
+   wheel_node_t   nodes[CHUNK_SIZE];
+};
+
+typedef struct {
+   wheel_node_t *head;
+   wheel_node_t *tail;
+} wheel_slot_t;
+
+struct wheel {
+   uint64_t        base;
+   uint64_t        seq;
+   size_t          count;
+   size_t          nwheel;
+   heap_t          overflow;
+   wheel_node_t   *freelist;
+   wheel_node_t   *early;
+   wheel_node_t   *early_tail;
+   wheel_chunk_t  *chunks;
+   wheel_node_t  **scratch;
+   size_t          scratch_sz;
+   int             min_slot;
+   unsigned        levels;
+   uint64_t        occupied[WHEEL_LEVELS][WHEEL_SLOTS / 64];
+   wheel_slot_t    slots[WHEEL_LEVELS][WHEEL_SLOTS];
+};
+
+typedef struct {
+   wheel_walk_fn_t  fn;
+   void            *context;
+} walk_ctx_t;
+
+static wheel_node_t *wheel_alloc_node(wheel_t w)
+{
+   if (unlikely(w->freelist == NULL)) {
+      wheel_chunk_t *c = xmalloc(sizeof(wheel_chunk_t));
+      c->next = w->chunks;
+      w->chunks = c;
+
+      for (int i = 0; i < CHUNK_SIZE; i++) {
+         c->nodes[i].next = w->freelist;
+         w->freelist = &(c->nodes[i]);
+      }
+   }
+
+   wheel_node_t *n = w->freelist;
+   w->freelist = n->next;
+   return n;
+}
+
+static void wheel_place(wheel_t w, wheel_node_t *n)
+{
+   const uint64_t diff = n->key ^ w->base;
+   if (unlikely(diff >> WHEEL_SPAN)) {
+      heap_insert(w->overflow, n->key, n);
+      return;
+   }
+
+   const int level = diff ? (63 - __builtin_clzll(diff)) / WHEEL_BITS : 0;
+   const int slot = (n->key >> (level * WHEEL_BITS)) & WHEEL_MASK;
+
+   wheel_slot_t *s = &(w->slots[level][slot]);
+   n->next = NULL;
+   if (s->tail == NULL)
+      s->head = s->tail = n;
+   else {
+      s->tail->next = n;
+      s->tail = n;
+   }
+
+   w->occupied[level][slot / 64] |= UINT64_C(1) << (slot % 64);
+   w->levels |= 1 << level;
+   w->nwheel++;
+}
+
+static void wheel_clear_slot(wheel_t w, int level, int slot)
+{
+   w->occupied[level][slot / 64] &= ~(UINT64_C(1) << (slot % 64));
+
+   for (int i = 0; i < WHEEL_SLOTS / 64; i++) {
+      if (w->occupied[level][i] != 0)
+         return;
+   }
+
+   w->levels &= ~(1 << level);
+}
+
+static int wheel_first_slot(wheel_t w, int level)
+{
+   for (int i = 0; i < WHEEL_SLOTS / 64; i++) {
+      if (w->occupied[level][i] != 0)
+         return i * 64 + __builtin_ctzll(w->occupied[level][i]);
+   }
+
+   return -1;
+}
+
+static int wheel_seq_cmp(const void *a, const void *b)
+{
+   const wheel_node_t *na = *(wheel_node_t * const *)a;
+   const wheel_node_t *nb = *(wheel_node_t * const *)b;
+   return (na->seq > nb->seq) - (na->seq < nb->seq);
+}
+
+static void wheel_refill(wheel_t w)
+{
+   // Move every overflow entry in the same block as the earliest one
+   // into the wheel in insertion order
+
+   wheel_node_t *first = heap_min(w->overflow);
+   w->base = first->key;
+
+   size_t n = 0;
+   while (heap_size(w->overflow) > 0) {
+      wheel_node_t *next = heap_min(w->overflow);
+      if ((next->key ^ w->base) >> WHEEL_SPAN)
+         break;
+
+      if (n == w->scratch_sz) {
+         w->scratch_sz = MAX(w->scratch_sz * 2, 64);
+         w->scratch = xrealloc(w->scratch,
+                               w->scratch_sz * sizeof(wheel_node_t *));
+      }
+
+      w->scratch[n++] = heap_extract_min(w->overflow);
+   }
+
+   qsort(w->scratch, n, sizeof(wheel_node_t *), wheel_seq_cmp);
+
+   for (size_t i = 0; i < n; i++)
+      wheel_place(w, w->scratch[i]);
+}
+
+static void wheel_cascade(wheel_t w, int level, int slot)
+{
+   const int shift = level * WHEEL_BITS;
+   const uint64_t above = ~((UINT64_C(1) << (shift + WHEEL_BITS)) - 1);
+   w->base = (w->base & above) | ((uint64_t)slot << shift);
+
+   wheel_slot_t *s = &(w->slots[level][slot]);
+   wheel_node_t *it = s->head;
+   s->head = s->tail = NULL;
+   wheel_clear_slot(w, level, slot);
+
+   while (it != NULL) {
+      wheel_node_t *next = it->next;
+      w->nwheel--;
+      wheel_place(w, it);
+      it = next;
+   }
+}
+
+static void wheel_insert_early(wheel_t w, wheel_node_t *n)
+{
+   // Entries are usually inserted in increasing key order
+
+   if (w->early == NULL || n->key >= w->early_tail->key) {
+      n->next = NULL;
+      if (w->early == NULL)
+         w->early = n;
+      else
+         w->early_tail->next = n;
+      w->early_tail = n;
+   }
+   else {
+      wheel_node_t **p = &(w->early);
+      while ((*p)->key <= n->key)
+         p = &((*p)->next);
+
+      n->next = *p;
+      *p = n;
+   }
+}
+
+static int wheel_settle(wheel_t w)
+{
+   // Ensure the minimum entry is at the head of a slot in the lowest
+   // level and return the index of that slot. The result stays valid
+   // until that slot is emptied or an earlier key is inserted.
+
+   if (likely(w->min_slot != -1))
+      return w->min_slot;
+
+   for (;;) {
+      if (w->nwheel == 0) {
+         if (heap_size(w->overflow) == 0)
+            return -1;
+
+         wheel_refill(w);
+         continue;
+      }
+
+      assert(w->levels != 0);
+
+      const int level = __builtin_ctz(w->levels);
+      const int slot = wheel_first_slot(w, level);
+      assert(slot != -1);
+
+      if (level == 0)
+         return (w->min_slot = slot);
+
+      wheel_cascade(w, level, slot);
+   }
+}
+
+wheel_t wheel_new(void)
+{
+   wheel_t w = xcalloc(sizeof(struct wheel));
+   w->overflow = heap_new(64);
+   w->min_slot = -1;
+   return w;
+}
+
+void wheel_free(wheel_t w)
+{
+   for (wheel_chunk_t *it = w->chunks, *tmp; it != NULL; it = tmp) {
+      tmp = it->next;
+      free(it);
+   }
+
+   heap_free(w->overflow);
+   free(w->scratch);
+   free(w);
+}
+
+void *wheel_extract_min(wheel_t w)
+{
+   if (w->early != NULL) {
+      wheel_node_t *n = w->early;
+      if ((w->early = n->next) == NULL)
+         w->early_tail = NULL;
+
+      w->count--;
+
+      void *user = n->user;
+      n->next = w->freelist;
+      w->freelist = n;
+      return user;
+   }
+
+   const int slot = wheel_settle(w);
+   if (unlikely(slot == -1))
+      fatal_trace("wheel underflow") LCOV_EXCL_LINE;
+
+   wheel_slot_t *s = &(w->slots[0][slot]);
+   wheel_node_t *n = s->head;
+   if ((s->head = n->next) == NULL) {
+      s->tail = NULL;
+      wheel_clear_slot(w, 0, slot);
+      w->min_slot = -1;
+   }
+
+   w->base = n->key;
+   w->nwheel--;
+   w->count--;
+
+   void *user = n->user;
+   n->next = w->freelist;
+   w->freelist = n;
+   return user;
+}
+
+void *wheel_min(wheel_t w)
+{
+   if (w->early != NULL)
+      return w->early->user;
+
+   const int slot = wheel_settle(w);
+   if (unlikely(slot == -1))
+      fatal_trace("wheel underflow") LCOV_EXCL_LINE;
+
+   return w->slots[0][slot].head->user;
+}
+
+uint64_t wheel_min_key(wheel_t w)
+{
+   if (w->early != NULL)
+      return w->early->key;
+
+   const int slot = wheel_settle(w);
+   if (unlikely(slot == -1))
+      fatal_trace("wheel underflow") LCOV_EXCL_LINE;
+
+   return w->slots[0][slot].head->key;
+}
+
+void wheel_insert(wheel_t w, uint64_t key, void *user)
+{
+   if (w->min_slot != -1 && key < w->slots[0][w->min_slot].head->key)
+      w->min_slot = -1;
+
+   wheel_node_t *n = wheel_alloc_node(w);
+   n->key  = key;
+   n->seq  = w->seq++;
+   n->user = user;
+
+   if (unlikely(key < w->base))
+      wheel_insert_early(w, n);
+   else
+      wheel_place(w, n);
+
+   w->count++;
+}
+
+size_t wheel_size(wheel_t w)
+{
+   return w->count;
+}
+
+static void wheel_walk_overflow(uint64_t key, void *user, void *context)
+{
+   walk_ctx_t *ctx = context;
+   (*ctx->fn)(key, ((wheel_node_t *)user)->user, ctx->context);
+}
+
+void wheel_walk(wheel_t w, wheel_walk_fn_t fn, void *context)
+{
+   for (wheel_node_t *it = w->early; it != NULL; it = it->next)
+      (*fn)(it->key, it->user, context);
+
+   for (int level = 0; level < WHEEL_LEVELS; level++) {
+      for (int slot = 0; slot < WHEEL_SLOTS; slot++) {
+         for (wheel_node_t *it = w->slots[level][slot].head;
+              it != NULL; it = it->next)
+            (*fn)(it->key, it->user, context);
+      }
+   }
+
+   walk_ctx_t ctx = { fn, context };
+   heap_walk(w->overflow, wheel_walk_overflow, &ctx);
+}
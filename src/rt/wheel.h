@@ -0,0 +1,41 @@
+//
+//  Copyright (C) 2018  Nick Gasson
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef _WHEEL_H
+#define _WHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Hierarchical timing wheel: a priority queue optimised for keys that
+// are never less than the last key extracted, as in a simulation event
+// queue. Entries with equal keys are returned in insertion order.
+
+typedef struct wheel *wheel_t;
+
+typedef void (*wheel_walk_fn_t)(uint64_t key, void *user, void *context);
+
+wheel_t wheel_new(void);
+void wheel_free(wheel_t w);
+void *wheel_extract_min(wheel_t w);
+void *wheel_min(wheel_t w);
+uint64_t wheel_min_key(wheel_t w);
+void wheel_insert(wheel_t w, uint64_t key, void *user);
+size_t wheel_size(wheel_t w);
+void wheel_walk(wheel_t w, wheel_walk_fn_t fn, void *context);
+
+#endif  // _WHEEL_H
@@ -30,6 +30,7 @@
 #include <sys/types.h>
 
 typedef struct scope       scope_t;
+typedef struct sym         sym_t;
 typedef struct loop_stack  loop_stack_t;
 typedef struct type_set    type_set_t;
 typedef struct defer_check defer_check_t;
@@ -57,11 +58,30 @@ typedef enum {
    SCOPE_CONTEXT   = (1 << 3)
 } scope_flags_t;
 
+// Every visible name maps to a chain of symbols with those in inner
+// scopes first and symbols in the same scope in declaration order. The
+// symbols in the innermost scope are always at the head of their chain
+// so can be removed in declaration order when the scope is popped.
+
+struct sym {
+   ident_t  name;
+   tree_t   decl;
+   scope_t *scope;
+   sym_t   *shadow;   // Next symbol with the same name
+   sym_t   *next;     // Next symbol in the same scope
+};
+
+typedef struct {
+   sym_t    *head;
+   unsigned  stamp;   // Changes whenever the chain is modified
+} sym_chain_t;
+
 struct scope {
    scope_t       *down;
 
    defer_check_t *deferred;
-   hash_t        *decls;
+   sym_t         *syms;
+   sym_t        **syms_tail;
    tree_t         subprog;
    wait_level_t   wait_level;
    impure_io_t    impure_io;
@@ -97,6 +117,23 @@ typedef struct {
    bool   partial;
 } formal_map_t;
 
+// Overload candidates found for a call are reused by later calls with
+// the same name, number of arguments, and expected result types until
+// a declaration with that name enters or leaves scope
+#define OVERLOAD_CACHE_SIZE 1024
+
+typedef struct {
+   ident_t   name;
+   unsigned  stamp;
+   int       nparams;
+   int       relax;
+   type_t   *types;
+   unsigned  ntypes;
+   tree_t   *overloads;
+   int       n_overloads;
+   int       found_func;
+} overload_memo_t;
+
 typedef tree_t (*get_fn_t)(tree_t);
 typedef void (*set_fn_t)(tree_t, tree_t);
 typedef tree_t (*get_nth_fn_t)(tree_t, unsigned);
@@ -118,9 +155,15 @@ static bool scope_import_unit(ident_t unit_name, lib_t lib,
 static int sem_ambiguous_rate(tree_t t);
 
 static scope_t      *top_scope = NULL;
+static hash_t       *symbols = NULL;
+static unsigned      symbol_stamp = 0;
 static int           errors = 0;
 static type_set_t   *top_type_set = NULL;
 static loop_stack_t *loop_stack = NULL;
+static unsigned      overload_hits = 0;
+static unsigned      overload_misses = 0;
+
+static overload_memo_t overload_cache[OVERLOAD_CACHE_SIZE];
 
 #define sem_error(t, ...) do {                        \
       error_at(t ? tree_loc(t) : NULL , __VA_ARGS__); \
@@ -130,8 +173,12 @@ static loop_stack_t *loop_stack = NULL;
 
 static void scope_push(ident_t prefix)
 {
+   if (symbols == NULL)
+      symbols = hash_new(4096, true);
+
    scope_t *s = xmalloc(sizeof(scope_t));
-   s->decls      = hash_new(1024, false);
+   s->syms       = NULL;
+   s->syms_tail  = &(s->syms);
    s->prefix     = prefix;
    s->imported   = NULL;
    s->down       = top_scope;
@@ -156,7 +203,15 @@ static void scope_pop(void)
       top_scope->imported = tmp;
    }
 
-   hash_free(top_scope->decls);
+   for (sym_t *it = top_scope->syms, *tmp; it != NULL; it = tmp) {
+      sym_chain_t *chain = hash_get(symbols, it->name);
+      assert(chain->head == it);
+      chain->head  = it->shadow;
+      chain->stamp = ++symbol_stamp;
+
+      tmp = it->next;
+      free(it);
+   }
 
    scope_t *s = top_scope;
    if (s->down != NULL && s->down->subprog == s->subprog) {
@@ -212,29 +267,41 @@ static void scope_apply_prefix(tree_t t)
                                      tree_ident(t), '.'));
 }
 
-static scope_t *scope_containing(scope_t *s, tree_t decl)
+static sym_t *scope_chain_head(ident_t name)
 {
-   int k = 0, tmp;
-   tree_t next;
-   ident_t name = tree_ident(decl);
-   while (tmp = k++, (next = hash_get_nth(s->decls, name, &tmp))) {
-      if (next == decl)
-         return s;
+   sym_chain_t *chain = hash_get(symbols, name);
+   return chain == NULL ? NULL : chain->head;
+}
+
+static scope_t *scope_containing(tree_t decl)
+{
+   sym_t *it = scope_chain_head(tree_ident(decl));
+   for (; it != NULL; it = it->shadow) {
+      if (it->decl == decl)
+         return it->scope;
    }
-   return s->down == NULL ? NULL : scope_containing(s->down, decl);
+
+   return NULL;
 }
 
 static tree_t scope_find_in(ident_t i, scope_t *s, bool recur, int k)
 {
+   // With recur the search includes the scopes enclosing s which always
+   // hold the symbols after those in s
+   assert(!recur || s == top_scope);
+
    if (s == NULL)
       return NULL;
-   else {
-      void *value = hash_get_nth(s->decls, i, &k);
-      if (value != NULL)
-         return (tree_t)value;
-      else
-         return (recur ? scope_find_in(i, s->down, true, k) : NULL);
+
+   sym_t *it = scope_chain_head(i);
+   for (; it != NULL; it = it->shadow) {
+      if (!recur && it->scope != s)
+         continue;
+      else if (k-- == 0)
+         return it->decl;
    }
+
+   return NULL;
 }
 
 static tree_t scope_find(ident_t i)
@@ -247,28 +314,78 @@ static tree_t scope_find_nth(ident_t i, int n)
    return scope_find_in(i, top_scope, true, n);
 }
 
-static bool scope_walk(scope_t **where, hash_iter_t *now, tree_t *decl)
+static bool scope_walk(scope_t **where, sym_t **now, tree_t *decl)
 {
-   const void *key;
-   void *value;
+   // Visits every declaration in the top scope or, if where is not NULL,
+   // in each enclosing scope as well: now starts as NULL
+
    scope_t *w = where == NULL ? top_scope : *where;
-   while (hash_iter(w->decls, now, &key, &value)) {
-      *decl = value;
-      if (tree_ident(*decl) != key)
+   sym_t *it = (*now == NULL) ? w->syms : (*now)->next;
+   for (; it != NULL; it = it->next) {
+      if (tree_ident(it->decl) != it->name)
          continue;   // Skip aliases
-      else
-         return true;
+
+      *now  = it;
+      *decl = it->decl;
+      return true;
    }
 
    if (where == NULL || w->down == NULL)
       return false;
    else {
       *where = w->down;
-      *now = HASH_BEGIN;
+      *now = NULL;
       return scope_walk(where, now, decl);
    }
 }
 
+static void scope_replace_decl(scope_t *s, tree_t t, tree_t with)
+{
+   for (sym_t *it = s->syms; it != NULL; it = it->next) {
+      if (it->decl == t) {
+         it->decl = with;
+
+         sym_chain_t *chain = hash_get(symbols, it->name);
+         chain->stamp = ++symbol_stamp;
+      }
+   }
+}
+
+static void scope_put(ident_t name, tree_t t)
+{
+   sym_t *sym = xmalloc(sizeof(sym_t));
+   sym->name  = name;
+   sym->decl  = t;
+   sym->scope = top_scope;
+   sym->next  = NULL;
+
+   sym_chain_t *chain = hash_get(symbols, name);
+   if (chain == NULL) {
+      chain = xcalloc(sizeof(sym_chain_t));
+      hash_put(symbols, name, chain);
+   }
+
+   chain->stamp = ++symbol_stamp;
+
+   // Insert after any symbols with the same name in this scope
+   sym_t *head = chain->head;
+   if (head == NULL || head->scope != top_scope) {
+      sym->shadow = head;
+      chain->head = sym;
+   }
+   else {
+      sym_t *last = head;
+      while (last->shadow != NULL && last->shadow->scope == top_scope)
+         last = last->shadow;
+
+      sym->shadow  = last->shadow;
+      last->shadow = sym;
+   }
+
+   *(top_scope->syms_tail) = sym;
+   top_scope->syms_tail = &(sym->next);
+}
+
 static bool scope_can_overload(tree_t t)
 {
    const tree_kind_t kind = tree_kind(t);
@@ -382,14 +499,14 @@ static bool scope_insert_aux(tree_t t, ident_t name, bool alias)
             // Allow builtin functions to be hidden by explicit functins
             // declared in the same region
             if (same_region) {
-               hash_replace(top_scope->decls, existing, t);
+               scope_replace_decl(top_scope, existing, t);
                return true;
             }
          }
       }
    } while (existing != NULL);
 
-   hash_put(top_scope->decls, name, t);
+   scope_put(name, t);
 
    const tree_kind_t kind = tree_kind(t);
    const bool may_have_fields = kind == T_VAR_DECL
@@ -418,7 +535,7 @@ static void scope_insert_alias(tree_t t, ident_t name)
 static void scope_replace(tree_t t, tree_t with)
 {
    assert(top_scope != NULL);
-   hash_replace(top_scope->decls, t, with);
+   scope_replace_decl(top_scope, t, with);
 }
 
 static void loop_push(ident_t name)
@@ -4017,6 +4134,75 @@ static bool sem_check_call_args(tree_t t, tree_t decl)
    return true;
 }
 
+static unsigned sem_overload_stamp(ident_t name)
+{
+   sym_chain_t *chain = hash_get(symbols, name);
+   return chain == NULL ? 0 : chain->stamp;
+}
+
+static overload_memo_t *sem_overload_memo(tree_t t, ident_t name, bool *hit)
+{
+   // Named arguments can change which declarations have a matching
+   // arity so those calls are always resolved from the symbol table
+   const int nparams = tree_params(t);
+   for (int i = 0; i < nparams; i++) {
+      if (tree_subkind(tree_param(t, i)) == P_NAMED)
+         return NULL;
+   }
+
+   type_t *types = NULL;
+   unsigned ntypes = 0;
+   if (top_type_set != NULL) {
+      types  = top_type_set->members;
+      ntypes = top_type_set->n_members;
+   }
+
+   uintptr_t hash = (uintptr_t)name ^ (nparams * 2654435761u);
+   for (unsigned i = 0; i < ntypes; i++)
+      hash = (hash * 31) ^ (uintptr_t)types[i];
+
+   overload_memo_t *memo =
+      &(overload_cache[(hash >> 3) % OVERLOAD_CACHE_SIZE]);
+
+   *hit = memo->name == name
+      && memo->stamp == sem_overload_stamp(name)
+      && memo->nparams == nparams
+      && memo->relax == relax_rules()
+      && memo->ntypes == ntypes
+      && (ntypes == 0 || memcmp(memo->types, types,
+                                ntypes * sizeof(type_t)) == 0);
+
+   return memo;
+}
+
+static void sem_overload_save(overload_memo_t *memo, tree_t t, ident_t name,
+                              tree_t *overloads, int n_overloads,
+                              int found_func)
+{
+   memo->name        = name;
+   memo->stamp       = sem_overload_stamp(name);
+   memo->nparams     = tree_params(t);
+   memo->relax       = relax_rules();
+   memo->n_overloads = n_overloads;
+   memo->found_func  = found_func;
+
+   memo->overloads = xrealloc(memo->overloads,
+                              MAX(n_overloads, 1) * sizeof(tree_t));
+   memcpy(memo->overloads, overloads, n_overloads * sizeof(tree_t));
+
+   memo->ntypes = (top_type_set == NULL) ? 0 : top_type_set->n_members;
+   memo->types  = xrealloc(memo->types, MAX(memo->ntypes, 1) * sizeof(type_t));
+   if (memo->ntypes > 0)
+      memcpy(memo->types, top_type_set->members,
+             memo->ntypes * sizeof(type_t));
+}
+
+void sem_overload_stats(unsigned *hits, unsigned *misses)
+{
+   *hits   = overload_hits;
+   *misses = overload_misses;
+}
+
 static bool sem_check_fcall(tree_t t)
 {
    if (!sem_check_params(t))
@@ -4030,105 +4216,121 @@ static bool sem_check_fcall(tree_t t)
    if (!sem_check_selected_name(name, t, NULL))
       return false;
 
-   tree_t decl;
-   int n = 0, found_func = 0;
-   do {
-      if ((decl = scope_find_nth(name, n++))) {
-         if (!class_has_type(class_of(decl)))
-            continue;
+   bool hit = false;
+   overload_memo_t *memo = sem_overload_memo(t, name, &hit);
+   if (hit) {
+      if (memo->n_overloads > max_overloads) {
+         max_overloads = memo->n_overloads;
+         overloads = xrealloc(overloads, max_overloads * sizeof(tree_t));
+      }
 
-         switch (tree_kind(decl)) {
-         case T_FUNC_DECL:
-         case T_FUNC_BODY:
+      n_overloads = memo->n_overloads;
+      memcpy(overloads, memo->overloads, n_overloads * sizeof(tree_t));
+      overload_hits++;
+   }
+   else
+      overload_misses++;
+
+   tree_t decl = NULL;
+   int n = 0, found_func = hit ? memo->found_func : 0;
+   while (!hit && (decl = scope_find_nth(name, n++))) {
+      if (!class_has_type(class_of(decl)))
+         continue;
+
+      switch (tree_kind(decl)) {
+      case T_FUNC_DECL:
+      case T_FUNC_BODY:
+         found_func++;
+         break;
+      case T_TYPE_DECL:
+         tree_change_kind(t, T_TYPE_CONV);
+         tree_set_ref(t, decl);
+         return sem_check_conversion(t);
+      case T_ALIAS:
+         if (tree_has_type(decl) && type_kind(tree_type(decl)) == T_FUNC) {
+            decl = tree_ref(tree_value(decl));
             found_func++;
             break;
-         case T_TYPE_DECL:
-            tree_change_kind(t, T_TYPE_CONV);
-            tree_set_ref(t, decl);
-            return sem_check_conversion(t);
-         case T_ALIAS:
-            if (tree_has_type(decl) && type_kind(tree_type(decl)) == T_FUNC) {
-               decl = tree_ref(tree_value(decl));
-               found_func++;
-               break;
-            }
-            else {
-               tree_t value = tree_value(decl);
-               if (tree_kind(value) == T_REF && tree_has_ref(value)
-                   && tree_kind(tree_ref(value)) == T_TYPE_DECL) {
-                  tree_change_kind(t, T_TYPE_CONV);
-                  tree_set_ref(t, tree_ref(value));
-                  return sem_check_conversion(t);
-               }
+         }
+         else {
+            tree_t value = tree_value(decl);
+            if (tree_kind(value) == T_REF && tree_has_ref(value)
+                && tree_kind(tree_ref(value)) == T_TYPE_DECL) {
+               tree_change_kind(t, T_TYPE_CONV);
+               tree_set_ref(t, tree_ref(value));
+               return sem_check_conversion(t);
             }
-            // Fall-through
-         default:
-            if (!class_has_type(class_of(decl)))
-               continue;
-            else {
-               type_t type = tree_type(decl);
-               const bool is_array_ref =
-                  type_is_array(type)
-                  || (type_is_access(type) && type_is_array(type_access(type)));
-               if (is_array_ref) {
-                  // The grammar is ambiguous between function calls and
-                  // array references so must be an array reference
-                  tree_t ref = tree_new(T_REF);
-                  tree_set_ident(ref, name);
-                  tree_set_loc(ref, tree_loc(t));
-
-                  tree_change_kind(t, T_ARRAY_REF);
-                  tree_set_value(t, ref);
-
-                  return sem_check_array_ref(t);
-               }
-               else
-                  continue;   // Look for the next matching name
+         }
+         // Fall-through
+      default:
+         if (!class_has_type(class_of(decl)))
+            continue;
+         else {
+            type_t type = tree_type(decl);
+            const bool is_array_ref =
+               type_is_array(type)
+               || (type_is_access(type) && type_is_array(type_access(type)));
+            if (is_array_ref) {
+               // The grammar is ambiguous between function calls and
+               // array references so must be an array reference
+               tree_t ref = tree_new(T_REF);
+               tree_set_ident(ref, name);
+               tree_set_loc(ref, tree_loc(t));
+
+               tree_change_kind(t, T_ARRAY_REF);
+               tree_set_value(t, ref);
+
+               return sem_check_array_ref(t);
             }
+            else
+               continue;   // Look for the next matching name
          }
+      }
 
-         type_t func_type = tree_type(decl);
+      type_t func_type = tree_type(decl);
 
-         if (type_set_member(type_result(func_type))) {
-            // Number of arguments must match
-            if (!sem_check_arity(t, decl))
-               continue;
+      if (type_set_member(type_result(func_type))) {
+         // Number of arguments must match
+         if (!sem_check_arity(t, decl))
+            continue;
 
-            const bool decl_is_builtin = tree_attr_str(decl, builtin_i) != NULL;
-            const bool prefer_explicit = relax_rules() & RELAX_PREFER_EXPLICT;
+         const bool decl_is_builtin = tree_attr_str(decl, builtin_i) != NULL;
+         const bool prefer_explicit = relax_rules() & RELAX_PREFER_EXPLICT;
 
-            // Same function may appear multiple times in the symbol
-            // table under different names
-            bool duplicate = false;
-            for (int i = 0; i < n_overloads; i++) {
-               if (overloads[i] == NULL)
-                  continue;
-               else if (overloads[i] == decl)
+         // Same function may appear multiple times in the symbol
+         // table under different names
+         bool duplicate = false;
+         for (int i = 0; i < n_overloads; i++) {
+            if (overloads[i] == NULL)
+               continue;
+            else if (overloads[i] == decl)
+               duplicate = true;
+            else if (type_eq(tree_type(overloads[i]), func_type)) {
+               const bool same_name =
+                  (tree_ident(overloads[i]) == tree_ident(decl));
+               const bool overload_i_is_builtin =
+                  tree_attr_str(overloads[i], builtin_i) != NULL;
+
+               if (same_name)
                   duplicate = true;
-               else if (type_eq(tree_type(overloads[i]), func_type)) {
-                  const bool same_name =
-                     (tree_ident(overloads[i]) == tree_ident(decl));
-                  const bool overload_i_is_builtin =
-                     tree_attr_str(overloads[i], builtin_i) != NULL;
-
-                  if (same_name)
+               else if (prefer_explicit) {
+                  if (decl_is_builtin && !overload_i_is_builtin)
                      duplicate = true;
-                  else if (prefer_explicit) {
-                     if (decl_is_builtin && !overload_i_is_builtin)
-                        duplicate = true;
-                     else if (!decl_is_builtin && overload_i_is_builtin)
-                        overloads[i] = decl;
-                  }
+                  else if (!decl_is_builtin && overload_i_is_builtin)
+                     overloads[i] = decl;
                }
             }
+         }
 
-            if (!duplicate) {
-               // Found a matching function definition
-               ARRAY_APPEND(overloads, decl, n_overloads, max_overloads);
-            }
+         if (!duplicate) {
+            // Found a matching function definition
+            ARRAY_APPEND(overloads, decl, n_overloads, max_overloads);
          }
       }
-   } while (decl != NULL);
+   }
+
+   if (memo != NULL && !hit)
+      sem_overload_save(memo, t, name, overloads, n_overloads, found_func);
 
    if (n_overloads == 0) {
       if (type_set_restrict(type_is_array)) {
@@ -4657,7 +4859,7 @@ static bool sem_check_concat(tree_t t)
       }
       else {
          // Find all one dimensional array types with this element type
-         hash_iter_t it = HASH_BEGIN;
+         sym_t *it = NULL;
          tree_t obj;
          scope_t *where = top_scope;
          type_t found[16];
@@ -5289,7 +5491,7 @@ static bool sem_check_pure_ref(tree_t ref, tree_t decl)
       && !(tree_flags(top_scope->subprog) & TREE_F_IMPURE);
 
    if (is_pure_func) {
-      scope_t *owner = scope_containing(top_scope, decl);
+      scope_t *owner = scope_containing(decl);
       if (owner != NULL && owner->subprog != top_scope->subprog)
          sem_error(ref, "invalid reference to %s inside pure function %s",
                    istr(tree_ident(decl)),
@@ -6183,6 +6385,28 @@ static bool sem_check_actual(formal_map_t *formals, int nformals,
    return true;
 }
 
+static bool sem_simple_formal(tree_t name, formal_map_t *formals,
+                              int nformals)
+{
+   // Nearly all named associations in large generated netlists use a
+   // simple formal name which can be resolved directly rather than by
+   // building a scope containing every formal for each instance
+
+   if (tree_kind(name) != T_REF)
+      return false;
+
+   ident_t id = tree_ident(name);
+   for (int i = 0; i < nformals; i++) {
+      if (tree_ident(formals[i].decl) == id) {
+         tree_set_type(name, tree_type(formals[i].decl));
+         tree_set_ref(name, formals[i].decl);
+         return true;
+      }
+   }
+
+   return false;
+}
+
 static bool sem_check_map(tree_t t, tree_t unit,
                           tree_formals_t tree_Fs, tree_formal_t tree_F,
                           tree_actuals_t tree_As, tree_actual_t tree_A)
@@ -6210,6 +6434,9 @@ static bool sem_check_map(tree_t t, tree_t unit,
       if (tree_subkind(p) != P_NAMED)
          continue;
 
+      if (!has_named && sem_simple_formal(tree_name(p), formals, nformals))
+         continue;
+
       if (!has_named) {
          scope_push(NULL);
          top_scope->flags |= SCOPE_FORMAL;
@@ -7349,7 +7576,7 @@ static bool sem_check_spec(tree_t t)
    }
    else {
       ident_t cname = tree_ident2(t);
-      hash_iter_t it = HASH_BEGIN;
+      sym_t *it = NULL;
       tree_t obj;
       while (scope_walk(NULL, &it, &obj)) {
          if (tree_kind(obj) != T_INSTANCE)
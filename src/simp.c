@@ -30,9 +30,12 @@
 typedef struct imp_signal imp_signal_t;
 
 struct imp_signal {
-   imp_signal_t *next;
-   tree_t        signal;
-   tree_t        process;
+   imp_signal_t  *next;
+   tree_t         signal;
+   tree_t         process;
+   tree_t         decl;
+   predef_attr_t  predef;
+   int64_t        delay;
 };
 
 typedef struct {
@@ -222,6 +225,17 @@ static tree_t simp_attr_delayed_transaction(tree_t t, predef_attr_t predef,
    if (kind != T_SIGNAL_DECL && kind != T_PORT_DECL)
       return t;
 
+   // Uses of the same attribute with the same constant delay share one
+   // implicit signal rather than each adding a signal and process
+   int64_t delay = 0;
+   const bool shared = predef != ATTR_DELAYED
+      || folded_int(tree_value(tree_param(t, 0)), &delay);
+
+   for (imp_signal_t *it = ctx->imp_signals; shared && it; it = it->next) {
+      if (it->decl == decl && it->predef == predef && it->delay == delay)
+         return make_ref(it->signal);
+   }
+
    char *sig_name LOCAL =
       xasprintf("%s_%s", (predef == ATTR_DELAYED) ? "delayed" : "transaction",
                 istr(tree_ident(name)));
@@ -289,6 +303,9 @@ static tree_t simp_attr_delayed_transaction(tree_t t, predef_attr_t predef,
    imp->next    = ctx->imp_signals;
    imp->signal  = s;
    imp->process = p;
+   imp->decl    = shared ? decl : NULL;
+   imp->predef  = predef;
+   imp->delay   = delay;
 
    ctx->imp_signals = imp;
 
@@ -517,6 +534,63 @@ static tree_t simp_array_ref(tree_t t)
    }
 }
 
+static tree_t simp_first_stmt(tree_t t)
+{
+   // Find the first statement that will execute skipping over null
+   // statements and the blocks left behind by folding if and case
+
+   const int nstmts = tree_stmts(t);
+   for (int i = 0; i < nstmts; i++) {
+      tree_t s = tree_stmt(t, i);
+      switch (tree_kind(s)) {
+      case T_NULL:
+         continue;
+      case T_BLOCK:
+         if ((s = simp_first_stmt(s)) != NULL)
+            return s;
+         continue;
+      default:
+         return s;
+      }
+   }
+
+   return NULL;
+}
+
+static bool simp_blocked_forever(tree_t t)
+{
+   // A process whose first statement is a wait that can never resume
+   // does nothing after initialisation and can be deleted as long as
+   // its declarations have no side effects and there are no signal
+   // assignments after the wait which would still create drivers
+
+   tree_t w = simp_first_stmt(t);
+   if (w == NULL || tree_kind(w) != T_WAIT || tree_has_delay(w))
+      return false;
+
+   if (tree_has_value(w)) {
+      // The condition is often a generic which is only folded once
+      // the instance is elaborated
+      bool value_b;
+      if (!folded_bool(tree_value(w), &value_b) || value_b)
+         return false;
+   }
+   else if (tree_triggers(w) > 0)
+      return false;
+
+   const int ndecls = tree_decls(t);
+   for (int i = 0; i < ndecls; i++) {
+      tree_t d = tree_decl(t, i);
+      if (tree_kind(d) == T_FILE_DECL)
+         return false;
+      else if (tree_visit_only(d, NULL, NULL, T_FCALL) > 0)
+         return false;
+   }
+
+   return tree_visit_only(t, NULL, NULL, T_SIGNAL_ASSIGN) == 0
+      && tree_visit_only(t, NULL, NULL, T_PCALL) == 0;
+}
+
 static tree_t simp_process(tree_t t)
 {
    // Replace sensitivity list with a "wait on" statement
@@ -550,6 +624,8 @@ static tree_t simp_process(tree_t t)
    // Delete processes that contain just a single wait statement
    if (tree_stmts(t) == 1 && tree_kind(tree_stmt(t, 0)) == T_WAIT)
       return NULL;
+   else if (simp_blocked_forever(t))
+      return NULL;
    else
       return t;
 }
@@ -566,41 +642,64 @@ static tree_t simp_wait(tree_t t)
    return t;
 }
 
+static bool simp_folded_choice(tree_t t, int64_t *value)
+{
+   unsigned uval;
+   if (folded_int(t, value))
+      return true;
+   else if (folded_enum(t, &uval)) {
+      *value = uval;
+      return true;
+   }
+   else
+      return false;
+}
+
 static tree_t simp_case(tree_t t)
 {
    const int nassocs = tree_assocs(t);
    if (nassocs == 0)
       return NULL;    // All choices are unreachable
 
+   // The selector is often a generic which only becomes constant once
+   // the instance is elaborated so this also folds enumeration values
+
    int64_t ival;
-   if (folded_int(tree_value(t), &ival)) {
+   if (simp_folded_choice(tree_value(t), &ival)) {
       for (int i = 0; i < nassocs; i++) {
          tree_t a = tree_assoc(t, i);
          switch ((assoc_kind_t)tree_subkind(a)) {
          case A_NAMED:
             {
                int64_t aval;
-               if (folded_int(tree_name(a), &aval) && (ival == aval)) {
-                  if (tree_has_value(a))
-                     return tree_value(a);
-                  else
-                     return NULL;
-               }
+               if (!simp_folded_choice(tree_name(a), &aval))
+                  return t;
+               else if (ival != aval)
+                  continue;
             }
             break;
 
          case A_RANGE:
-            continue;   // TODO
+            {
+               int64_t low, high;
+               if (!folded_bounds(tree_range(a, 0), &low, &high))
+                  return t;
+               else if (ival < low || ival > high)
+                  continue;
+            }
+            break;
 
          case A_OTHERS:
-            if (tree_has_value(a))
-               return tree_value(a);
-            else
-               return NULL;
+            break;
 
          case A_POS:
-            break;
+            continue;
          }
+
+         if (tree_has_value(a))
+            return tree_value(a);
+         else
+            return NULL;
       }
    }
 
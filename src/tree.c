@@ -339,7 +339,9 @@ object_class_t tree_object = {
    .last_kind      = T_LAST_TREE_KIND,
    .gc_roots       = { T_ARCH, T_ENTITY, T_PACKAGE, T_ELAB, T_PACK_BODY,
                        T_CONTEXT },
-   .gc_num_roots   = 5
+   .gc_num_roots   = 5,
+   .deferred_kind  = T_PACK_BODY,
+   .deferred_item  = I_DECLS
 };
 
 static bool tree_kind_in(tree_t t, const tree_kind_t *list, size_t len)
@@ -387,6 +389,11 @@ void tree_gc(void)
    object_gc();
 }
 
+void tree_new_arena(void)
+{
+   object_new_arena();
+}
+
 const loc_t *tree_loc(tree_t t)
 {
    assert(t != NULL);
@@ -449,7 +456,8 @@ void tree_change_kind(tree_t t, tree_kind_t kind)
 
 unsigned tree_ports(tree_t t)
 {
-   return lookup_item(&tree_object, t, I_PORTS)->tree_array.count;
+   item_t *item = lookup_item(&tree_object, t, I_PORTS);
+   return tree_array_count(&(item->tree_array));
 }
 
 tree_t tree_port(tree_t t, unsigned n)
@@ -477,7 +485,8 @@ void tree_set_subkind(tree_t t, unsigned sub)
 
 unsigned tree_generics(tree_t t)
 {
-   return lookup_item(&tree_object, t, I_GENERICS)->tree_array.count;
+   item_t *item = lookup_item(&tree_object, t, I_GENERICS);
+   return tree_array_count(&(item->tree_array));
 }
 
 tree_t tree_generic(tree_t t, unsigned n)
@@ -511,7 +520,8 @@ bool tree_has_type(tree_t t)
 
 unsigned tree_params(tree_t t)
 {
-   return lookup_item(&tree_object, t, I_PARAMS)->tree_array.count;
+   item_t *item = lookup_item(&tree_object, t, I_PARAMS);
+   return tree_array_count(&(item->tree_array));
 }
 
 tree_t tree_param(tree_t t, unsigned n)
@@ -528,14 +538,15 @@ void tree_add_param(tree_t t, tree_t e)
    tree_array_t *array = &(lookup_item(&tree_object, t, I_PARAMS)->tree_array);
 
    if (tree_subkind(e) == P_POS)
-      tree_set_pos(e, array->count);
+      tree_set_pos(e, tree_array_count(array));
 
    tree_array_add(array, e);
 }
 
 unsigned tree_genmaps(tree_t t)
 {
-   return lookup_item(&tree_object, t, I_GENMAPS)->tree_array.count;
+   item_t *item = lookup_item(&tree_object, t, I_GENMAPS);
+   return tree_array_count(&(item->tree_array));
 }
 
 tree_t tree_genmap(tree_t t, unsigned n)
@@ -551,7 +562,7 @@ void tree_add_genmap(tree_t t, tree_t e)
    tree_array_t *array = &(lookup_item(&tree_object, t, I_GENMAPS)->tree_array);
 
    if (tree_subkind(e) == P_POS)
-      tree_set_pos(e, array->count);
+      tree_set_pos(e, tree_array_count(array));
 
    tree_array_add(&(lookup_item(&tree_object, t, I_GENMAPS)->tree_array), e);
 }
@@ -593,7 +604,8 @@ void tree_set_flag(tree_t t, tree_flags_t mask)
 unsigned tree_chars(tree_t t)
 {
    assert((t->object.kind == T_LITERAL) && (tree_subkind(t) == L_STRING));
-   return lookup_item(&tree_object, t, I_CHARS)->ident_array.count;
+   item_t *item = lookup_item(&tree_object, t, I_CHARS);
+   return ident_array_count(&(item->ident_array));
 }
 
 tree_t tree_char(tree_t t, unsigned n)
@@ -630,24 +642,39 @@ void tree_set_value(tree_t t, tree_t v)
 
 unsigned tree_decls(tree_t t)
 {
-   return lookup_item(&tree_object, t, I_DECLS)->tree_array.count;
+   item_t *item = lookup_item(&tree_object, t, I_DECLS);
+   return tree_array_count(&(item->tree_array));
 }
 
 tree_t tree_decl(tree_t t, unsigned n)
 {
    item_t *item = lookup_item(&tree_object, t, I_DECLS);
-   return tree_array_nth(&(item->tree_array), n);
+   tree_t d = tree_array_nth(&(item->tree_array), n);
+   if (unlikely(d == NULL)) {
+      // Declarations of a package body are read from the library on
+      // first use
+      object_read_deferred(&(t->object));
+      d = tree_array_nth(&(item->tree_array), n);
+   }
+   return d;
 }
 
 void tree_add_decl(tree_t t, tree_t d)
 {
    tree_assert_decl(d);
-   tree_array_add(&(lookup_item(&tree_object, t, I_DECLS)->tree_array), d);
+
+   item_t *item = lookup_item(&tree_object, t, I_DECLS);
+   if (tree_array_count(&(item->tree_array)) > 0
+       && item->tree_array.items[0] == NULL)
+      object_read_deferred(&(t->object));
+
+   tree_array_add(&(item->tree_array), d);
 }
 
 unsigned tree_stmts(tree_t t)
 {
-   return lookup_item(&tree_object, t, I_STMTS)->tree_array.count;
+   item_t *item = lookup_item(&tree_object, t, I_STMTS);
+   return tree_array_count(&(item->tree_array));
 }
 
 tree_t tree_stmt(tree_t t, unsigned n)
@@ -664,7 +691,8 @@ void tree_add_stmt(tree_t t, tree_t s)
 
 unsigned tree_waveforms(tree_t t)
 {
-   return lookup_item(&tree_object, t, I_WAVES)->tree_array.count;
+   item_t *item = lookup_item(&tree_object, t, I_WAVES);
+   return tree_array_count(&(item->tree_array));
 }
 
 tree_t tree_waveform(tree_t t, unsigned n)
@@ -681,7 +709,8 @@ void tree_add_waveform(tree_t t, tree_t w)
 
 unsigned tree_else_stmts(tree_t t)
 {
-   return lookup_item(&tree_object, t, I_ELSES)->tree_array.count;
+   item_t *item = lookup_item(&tree_object, t, I_ELSES);
+   return tree_array_count(&(item->tree_array));
 }
 
 tree_t tree_else_stmt(tree_t t, unsigned n)
@@ -698,7 +727,8 @@ void tree_add_else_stmt(tree_t t, tree_t s)
 
 unsigned tree_conds(tree_t t)
 {
-   return lookup_item(&tree_object, t, I_CONDS)->tree_array.count;
+   item_t *item = lookup_item(&tree_object, t, I_CONDS);
+   return tree_array_count(&(item->tree_array));
 }
 
 tree_t tree_cond(tree_t t, unsigned n)
@@ -733,7 +763,8 @@ void tree_set_delay(tree_t t, tree_t d)
 
 unsigned tree_triggers(tree_t t)
 {
-   return lookup_item(&tree_object, t, I_TRIGGERS)->tree_array.count;
+   item_t *item = lookup_item(&tree_object, t, I_TRIGGERS);
+   return tree_array_count(&(item->tree_array));
 }
 
 tree_t tree_trigger(tree_t t, unsigned n)
@@ -750,7 +781,8 @@ void tree_add_trigger(tree_t t, tree_t s)
 
 unsigned tree_ops(tree_t t)
 {
-   return lookup_item(&tree_object, t, I_OPS)->tree_array.count;
+   item_t *item = lookup_item(&tree_object, t, I_OPS);
+   return tree_array_count(&(item->tree_array));
 }
 
 tree_t tree_op(tree_t t, unsigned n)
@@ -812,7 +844,8 @@ void tree_set_spec(tree_t t, tree_t s)
 
 unsigned tree_contexts(tree_t t)
 {
-   return lookup_item(&tree_object, t, I_CONTEXT)->tree_array.count;
+   item_t *item = lookup_item(&tree_object, t, I_CONTEXT);
+   return tree_array_count(&(item->tree_array));
 }
 
 tree_t tree_context(tree_t t, unsigned n)
@@ -830,7 +863,8 @@ void tree_add_context(tree_t t, tree_t ctx)
 
 unsigned tree_assocs(tree_t t)
 {
-   return lookup_item(&tree_object, t, I_ASSOCS)->tree_array.count;
+   item_t *item = lookup_item(&tree_object, t, I_ASSOCS);
+   return tree_array_count(&(item->tree_array));
 }
 
 tree_t tree_assoc(tree_t t, unsigned n)
@@ -846,14 +880,15 @@ void tree_add_assoc(tree_t t, tree_t a)
    tree_array_t *array = &(lookup_item(&tree_object, t, I_ASSOCS)->tree_array);
 
    if (tree_subkind(a) == A_POS)
-      tree_set_pos(a, array->count);
+      tree_set_pos(a, tree_array_count(array));
 
    tree_array_add(array, a);
 }
 
 unsigned tree_nets(tree_t t)
 {
-   return lookup_item(&tree_object, t, I_NETS)->netid_array.count;
+   item_t *item = lookup_item(&tree_object, t, I_NETS);
+   return netid_array_count(&(item->netid_array));
 }
 
 netid_t tree_net(tree_t t, unsigned n)
@@ -869,11 +904,41 @@ void tree_add_net(tree_t t, netid_t n)
    netid_array_add(&(lookup_item(&tree_object, t, I_NETS)->netid_array), n);
 }
 
+void tree_add_nets(tree_t t, netid_t first, unsigned count)
+{
+   netid_array_t *a = &(lookup_item(&tree_object, t, I_NETS)->netid_array);
+
+   const unsigned base = netid_array_count(a);
+   netid_array_resize(a, base + count, 0xff);
+
+   for (unsigned i = 0; i < count; i++)
+      a->items[base + i] = first + i;
+}
+
+void tree_copy_nets(tree_t t, unsigned n, tree_t from, unsigned first,
+                    unsigned count)
+{
+   assert(t != from);
+
+   item_t *src_item = lookup_item(&tree_object, from, I_NETS);
+   item_t *dst_item = lookup_item(&tree_object, t, I_NETS);
+
+   netid_array_t *src = &(src_item->netid_array);
+   netid_array_t *dst = &(dst_item->netid_array);
+
+   assert(first + count <= netid_array_count(src));
+
+   if (n + count > netid_array_count(dst))
+      netid_array_resize(dst, n + count, 0xff);
+
+   memcpy(dst->items + n, src->items + first, count * sizeof(netid_t));
+}
+
 void tree_change_net(tree_t t, unsigned n, netid_t i)
 {
    item_t *item = lookup_item(&tree_object, t, I_NETS);
 
-   if (n >= item->netid_array.count)
+   if (n >= netid_array_count(&(item->netid_array)))
       netid_array_resize(&(item->netid_array), n + 1, 0xff);
 
    item->netid_array.items[n] = i;
@@ -923,13 +988,14 @@ range_t tree_range(tree_t t, unsigned n)
 
 unsigned tree_ranges(tree_t t)
 {
-   return lookup_item(&tree_object, t, I_RANGES)->range_array.count;
+   item_t *item = lookup_item(&tree_object, t, I_RANGES);
+   return range_array_count(&(item->range_array));
 }
 
 void tree_change_range(tree_t t, unsigned n, range_t r)
 {
    item_t *item = lookup_item(&tree_object, t, I_RANGES);
-   assert(n < item->range_array.count);
+   assert(n < range_array_count(&(item->range_array)));
    item->range_array.items[n] = r;
 }
 
@@ -1068,11 +1134,13 @@ static attr_t *tree_find_attr(tree_t t, ident_t name, attr_kind_t kind)
    assert(t != NULL);
    assert(name != NULL);
 
-   item_t *item = lookup_item(&tree_object, t, I_ATTRS);
-   for (unsigned i = 0; i < item->attrs.num; i++) {
-      if ((item->attrs.table[i].kind == kind)
-          && (item->attrs.table[i].name == name))
-         return &(item->attrs.table[i]);
+   attr_tab_t *attrs = lookup_item(&tree_object, t, I_ATTRS)->attrs;
+   if (attrs == NULL)
+      return NULL;
+
+   for (unsigned i = 0; i < attrs->num; i++) {
+      if ((attrs->table[i].kind == kind) && (attrs->table[i].name == name))
+         return &(attrs->table[i]);
    }
 
    return NULL;
@@ -1089,21 +1157,23 @@ static attr_t *tree_add_attr(tree_t t, ident_t name, attr_kind_t kind)
 
    item_t *item = lookup_item(&tree_object, t, I_ATTRS);
 
-   if (item->attrs.table == NULL) {
-      item->attrs.alloc = 8;
-      item->attrs.table = xmalloc(sizeof(attr_t) * item->attrs.alloc);
+   if (item->attrs == NULL) {
+      item->attrs = xmalloc(sizeof(attr_tab_t) + sizeof(attr_t) * 2);
+      item->attrs->alloc = 2;
+      item->attrs->num   = 0;
    }
-   else if (item->attrs.alloc == item->attrs.num) {
-      item->attrs.alloc *= 2;
-      item->attrs.table = xrealloc(item->attrs.table,
-                                   sizeof(attr_t) * item->attrs.alloc);
+   else if (item->attrs->alloc == item->attrs->num) {
+      const unsigned alloc = item->attrs->alloc * 2;
+      item->attrs = xrealloc(item->attrs,
+                             sizeof(attr_tab_t) + sizeof(attr_t) * alloc);
+      item->attrs->alloc = alloc;
    }
 
-   unsigned i = item->attrs.num++;
-   item->attrs.table[i].kind = kind;
-   item->attrs.table[i].name = name;
+   unsigned i = item->attrs->num++;
+   item->attrs->table[i].kind = kind;
+   item->attrs->table[i].name = name;
 
-   return &(item->attrs.table[i]);
+   return &(item->attrs->table[i]);
 }
 
 void tree_remove_attr(tree_t t, ident_t name)
@@ -1111,20 +1181,21 @@ void tree_remove_attr(tree_t t, ident_t name)
    assert(t != NULL);
    assert(name != NULL);
 
-   item_t *item = lookup_item(&tree_object, t, I_ATTRS);
+   attr_tab_t *attrs = lookup_item(&tree_object, t, I_ATTRS)->attrs;
+   if (attrs == NULL)
+      return;
 
    unsigned i;
-   for (i = 0; (i < item->attrs.num)
-           && (item->attrs.table[i].name != name); i++)
+   for (i = 0; (i < attrs->num) && (attrs->table[i].name != name); i++)
       ;
 
-   if (i == item->attrs.num)
+   if (i == attrs->num)
       return;
 
-   for (; i + 1 < item->attrs.num; i++)
-      item->attrs.table[i] = item->attrs.table[i + 1];
+   for (; i + 1 < attrs->num; i++)
+      attrs->table[i] = attrs->table[i + 1];
 
-   item->attrs.num--;
+   attrs->num--;
 }
 
 void tree_add_attr_str(tree_t t, ident_t name, ident_t str)
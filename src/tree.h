@@ -316,6 +316,9 @@ unsigned tree_nets(tree_t t);
 netid_t tree_net(tree_t t, unsigned n);
 void tree_add_net(tree_t t, netid_t n);
 void tree_change_net(tree_t t, unsigned n, netid_t i);
+void tree_add_nets(tree_t t, netid_t first, unsigned count);
+void tree_copy_nets(tree_t t, unsigned n, tree_t from, unsigned first,
+                    unsigned count);
 
 tree_flags_t tree_flags(tree_t t);
 void tree_set_flag(tree_t t, tree_flags_t mask);
@@ -343,6 +346,10 @@ tree_t tree_copy(tree_t t, tree_copy_fn_t fn, void *context);
 
 void tree_gc(void);
 
+// Allocate trees and types created after this in a new arena which can
+// be freed by tree_gc as a unit
+void tree_new_arena(void);
+
 tree_wr_ctx_t tree_write_begin(fbuf_t *f);
 void tree_write(tree_t t, tree_wr_ctx_t ctx);
 void tree_write_end(tree_wr_ctx_t ctx);
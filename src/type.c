@@ -247,7 +247,8 @@ void type_set_ident(type_t t, ident_t id)
 
 unsigned type_dims(type_t t)
 {
-   return lookup_item(&type_object, t, I_DIMS)->range_array.count;
+   item_t *item = lookup_item(&type_object, t, I_DIMS);
+   return range_array_count(&(item->range_array));
 }
 
 range_t type_dim(type_t t, unsigned n)
@@ -264,7 +265,7 @@ void type_add_dim(type_t t, range_t r)
 void type_change_dim(type_t t, unsigned n, range_t r)
 {
    item_t *item = lookup_item(&type_object, t, I_DIMS);
-   assert(n < item->range_array.count);
+   assert(n < range_array_count(&(item->range_array)));
    item->range_array.items[n] = r;
 }
 
@@ -370,7 +371,8 @@ bool type_is_universal(type_t t)
 
 unsigned type_units(type_t t)
 {
-   return lookup_item(&type_object, t, I_UNITS)->tree_array.count;
+   item_t *item = lookup_item(&type_object, t, I_UNITS);
+   return tree_array_count(&(item->tree_array));
 }
 
 tree_t type_unit(type_t t, unsigned n)
@@ -386,7 +388,8 @@ void type_add_unit(type_t t, tree_t u)
 
 unsigned type_enum_literals(type_t t)
 {
-   return lookup_item(&type_object, t, I_LITERALS)->tree_array.count;
+   item_t *item = lookup_item(&type_object, t, I_LITERALS);
+   return tree_array_count(&(item->tree_array));
 }
 
 tree_t type_enum_literal(type_t t, unsigned n)
@@ -403,7 +406,8 @@ void type_enum_add_literal(type_t t, tree_t lit)
 
 unsigned type_params(type_t t)
 {
-   return lookup_item(&type_object, t, I_PTYPES)->type_array.count;
+   item_t *item = lookup_item(&type_object, t, I_PTYPES);
+   return type_array_count(&(item->type_array));
 }
 
 type_t type_param(type_t t, unsigned n)
@@ -420,7 +424,7 @@ void type_add_param(type_t t, type_t p)
 void type_change_param(type_t t, unsigned n, type_t p)
 {
    type_array_t *a = &(lookup_item(&type_object, t, I_PTYPES)->type_array);
-   assert(n < a->count);
+   assert(n < type_array_count(a));
    a->items[n] = p;
 }
 
@@ -428,8 +432,10 @@ unsigned type_fields(type_t t)
 {
    if (t->object.kind == T_SUBTYPE)
       return type_fields(type_base(t));
-   else
-      return lookup_item(&type_object, t, I_FIELDS)->tree_array.count;
+   else {
+      item_t *item = lookup_item(&type_object, t, I_FIELDS);
+      return tree_array_count(&(item->tree_array));
+   }
 }
 
 tree_t type_field(type_t t, unsigned n)
@@ -450,7 +456,8 @@ void type_add_field(type_t t, tree_t p)
 
 unsigned type_decls(type_t t)
 {
-   return lookup_item(&type_object, t, I_DECLS)->tree_array.count;
+   item_t *item = lookup_item(&type_object, t, I_DECLS);
+   return tree_array_count(&(item->tree_array));
 }
 
 tree_t type_decl(type_t t, unsigned n)
@@ -491,7 +498,8 @@ void type_change_kind(type_t t, type_kind_t kind)
 
 unsigned type_index_constrs(type_t t)
 {
-   return lookup_item(&type_object, t, I_INDEXCON)->type_array.count;
+   item_t *item = lookup_item(&type_object, t, I_INDEXCON);
+   return type_array_count(&(item->type_array));
 }
 
 void type_add_index_constr(type_t t, type_t c)
@@ -502,7 +510,7 @@ void type_add_index_constr(type_t t, type_t c)
 void type_change_index_constr(type_t t, unsigned n, type_t c)
 {
    type_array_t *a = &(lookup_item(&type_object, t, I_INDEXCON)->type_array);
-   assert(n < a->count);
+   assert(n < type_array_count(a));
    a->items[n] = c;
 }
 
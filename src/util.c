@@ -1442,6 +1442,46 @@ int64_t ipow(int64_t x, int64_t y)
    return r;
 }
 
+uint64_t hash_bytes(const void *data, size_t len, uint64_t seed)
+{
+   // MurmurHash64A by Austin Appleby which is in the public domain
+
+   const uint64_t m = UINT64_C(0xc6a4a7935bd1e995);
+   const int r = 47;
+
+   uint64_t h = seed ^ (len * m);
+
+   const uint8_t *p = data;
+   for (; len >= 8; p += 8, len -= 8) {
+      uint64_t k;
+      memcpy(&k, p, sizeof(uint64_t));
+
+      k *= m;
+      k ^= k >> r;
+      k *= m;
+
+      h ^= k;
+      h *= m;
+   }
+
+   switch (len) {
+   case 7: h ^= (uint64_t)p[6] << 48;
+   case 6: h ^= (uint64_t)p[5] << 40;
+   case 5: h ^= (uint64_t)p[4] << 32;
+   case 4: h ^= (uint64_t)p[3] << 24;
+   case 3: h ^= (uint64_t)p[2] << 16;
+   case 2: h ^= (uint64_t)p[1] << 8;
+   case 1: h ^= (uint64_t)p[0];
+      h *= m;
+   }
+
+   h ^= h >> r;
+   h *= m;
+   h ^= h >> r;
+
+   return h;
+}
+
 void *mmap_guarded(size_t sz, const char *tag)
 {
 #ifndef __MINGW32__
@@ -1611,19 +1651,14 @@ static unsigned tv2ms(struct timeval *tv)
 }
 #endif
 
-void nvc_rusage(nvc_rusage_t *ru)
+void nvc_rusage_total(nvc_rusage_t *ru)
 {
 #ifndef __MINGW32__
-   static struct rusage last;
-
    struct rusage sys;
    if (getrusage(RUSAGE_SELF, &sys) < 0)
       fatal_errno("getrusage");
 
-   const unsigned utime = tv2ms(&(sys.ru_utime)) - tv2ms(&(last.ru_utime));
-   const unsigned stime = tv2ms(&(sys.ru_stime)) - tv2ms(&(last.ru_stime));
-
-   ru->ms = utime + stime;
+   ru->ms = tv2ms(&(sys.ru_utime)) + tv2ms(&(sys.ru_stime));
 
 #ifdef __APPLE__
    const int rss_units = 1024;
@@ -1632,10 +1667,7 @@ void nvc_rusage(nvc_rusage_t *ru)
 #endif
 
    ru->rss = sys.ru_maxrss / rss_units;
-
-   last = sys;
 #else
-   static long long last;
    ULARGE_INTEGER lv_Tkernel, lv_Tuser;
    HANDLE hProcess = GetCurrentProcess();
 
@@ -1648,8 +1680,7 @@ void nvc_rusage(nvc_rusage_t *ru)
    lv_Tuser.LowPart = ftUser.dwLowDateTime;
    lv_Tuser.HighPart = ftUser.dwHighDateTime;
 
-   ru->ms = (lv_Tkernel.QuadPart + lv_Tuser.QuadPart) / 10000 - last;
-   last = ru->ms;
+   ru->ms = (lv_Tkernel.QuadPart + lv_Tuser.QuadPart) / 10000;
 
    PROCESS_MEMORY_COUNTERS counters;
    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
@@ -1659,6 +1690,18 @@ void nvc_rusage(nvc_rusage_t *ru)
 #endif
 }
 
+void nvc_rusage(nvc_rusage_t *ru)
+{
+   // Calls to nvc_rusage_total do not affect the interval
+   static unsigned last_ms;
+
+   nvc_rusage_total(ru);
+
+   const unsigned total = ru->ms;
+   ru->ms -= last_ms;
+   last_ms = total;
+}
+
 void run_program(const char *const *args, size_t n_args)
 {
    const bool quiet = (getenv("NVC_LINK_QUIET") != NULL);
@@ -1767,6 +1810,37 @@ void *map_file(int fd, size_t size)
    return ptr;
 }
 
+void *map_file_padded(int fd, size_t size, size_t pad)
+{
+   // Writable private mapping of the file followed by at least pad zero
+   // bytes: pages are only copied when they are first written to
+#ifdef __MINGW32__
+   char *ptr = xmalloc(size + pad);
+   for (size_t nread = 0; nread < size; ) {
+      const ssize_t n = read(fd, ptr + nread, size - nread);
+      if (n <= 0)
+         fatal_errno("read");
+      nread += n;
+   }
+   memset(ptr + size, '\0', pad);
+#else
+   const long pagesz = sysconf(_SC_PAGESIZE);
+   const size_t total = ((size + pad + pagesz - 1) / pagesz) * pagesz;
+
+   char *ptr = mmap(NULL, total, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANON, -1, 0);
+   if (ptr == MAP_FAILED)
+      fatal_errno("mmap");
+
+   // The rest of the last page of the file reads as zero and any page
+   // after it is still covered by the anonymous mapping
+   if (size > 0 && mmap(ptr, size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+      fatal_errno("mmap");
+#endif
+   return ptr;
+}
+
 void unmap_file(void *ptr, size_t size)
 {
 #ifdef __MINGW32__
@@ -145,6 +145,8 @@ int checked_sprintf(char *buf, int len, const char *fmt, ...)
 int next_power_of_2(int n) __attribute__((pure));
 int ilog2(int64_t n) __attribute__((pure));
 int64_t ipow(int64_t x, int64_t y)  __attribute__((pure));
+uint64_t hash_bytes(const void *data, size_t len, uint64_t seed)
+   __attribute__((pure));
 
 void *mmap_guarded(size_t sz, const char *tag);
 
@@ -197,8 +199,12 @@ typedef struct {
    unsigned ms;
 } nvc_rusage_t;
 
+// CPU time in ms since the last call and peak RSS in kB
 void nvc_rusage(nvc_rusage_t *ru);
 
+// As nvc_rusage but the CPU time is the total for the process
+void nvc_rusage_total(nvc_rusage_t *ru);
+
 uint64_t get_timestamp_us();
 
 void file_read_lock(int fd);
@@ -206,6 +212,7 @@ void file_write_lock(int fd);
 void file_unlock(int fd);
 
 void *map_file(int fd, size_t size);
+void *map_file_padded(int fd, size_t size, size_t pad);
 void unmap_file(void *ptr, size_t size);
 void make_dir(const char *path);
 
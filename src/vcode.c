@@ -21,6 +21,7 @@
 #include "hash.h"
 #include "tree.h"
 #include "common.h"
+#include "mem.h"
 
 #include <assert.h>
 #include <inttypes.h>
@@ -28,9 +29,8 @@
 #include <stdlib.h>
 #include <float.h>
 
-DECLARE_AND_DEFINE_ARRAY(vcode_reg);
-DECLARE_AND_DEFINE_ARRAY(vcode_block);
 DECLARE_AND_DEFINE_ARRAY(vcode_type);
+DECLARE_AND_DEFINE_ARRAY(loc);
 
 #define OP_HAS_TYPE(x)                                                  \
    (x == VCODE_OP_BOUNDS || x == VCODE_OP_ALLOCA  || x == VCODE_OP_COPY \
@@ -82,9 +82,23 @@ DECLARE_AND_DEFINE_ARRAY(vcode_type);
 #define OP_HAS_RESOLUTION(x)                                            \
    (x == VCODE_OP_SET_INITIAL)
 
+// Arguments and branch targets are allocated from the arena of the
+// unit containing the operation and are freed along with it
+typedef struct {
+   uint32_t     count;
+   uint32_t     max;
+   vcode_reg_t *items;
+} op_args_t;
+
+typedef struct {
+   uint32_t       count;
+   uint32_t       max;
+   vcode_block_t *items;
+} op_targets_t;
+
 typedef struct {
    vcode_op_t          kind;
-   vcode_reg_array_t   args;
+   op_args_t           args;
    vcode_reg_t         result;
    vcode_type_t        type;          // OP_HAS_TYPE
    union {
@@ -93,9 +107,9 @@ typedef struct {
       unsigned         subkind;       // OP_HAS_SUBKIND
    };
    union {
-      loc_t               loc;        // OP_HAS_LOC
-      vcode_block_array_t targets;    // OP_HAS_TARGET
-      vcode_res_fn_t     *resolution; // OP_HAS_RESOLUTION
+      unsigned         loc;           // OP_HAS_LOC index into unit locs
+      op_targets_t     targets;       // OP_HAS_TARGET
+      vcode_res_fn_t  *resolution;    // OP_HAS_RESOLUTION
    };
    union {
       vcode_cmp_t      cmp;           // OP_HAS_CMP
@@ -196,6 +210,17 @@ typedef enum {
    UNIT_UNDEFINED = (1 << 1)
 } unit_flags_t;
 
+typedef struct arena_chunk arena_chunk_t;
+
+struct arena_chunk {
+   arena_chunk_t *next;
+   size_t         used;
+   size_t         size;
+   uint32_t       data[0];
+};
+
+#define ARENA_CHUNK_SZ 4096   // In 32-bit words
+
 struct vcode_unit {
    vunit_kind_t   kind;
    vcode_unit_t   context;
@@ -212,6 +237,9 @@ struct vcode_unit {
    vcode_unit_t   children;
    vcode_unit_t   next;
    unsigned       refcount;
+   loc_array_t    locs;
+   arena_chunk_t *arena;
+   uint32_t       serial;
 };
 
 #define MASK_CONTEXT(x)   ((x) >> 24)
@@ -234,12 +262,42 @@ struct vcode_unit {
    VCODE_FOR_EACH_OP(name) if (name->kind == k)
 
 #define VCODE_MAGIC        0x76636f64
-#define VCODE_VERSION      6
+#define VCODE_VERSION      8
 #define VCODE_CHECK_UNIONS 0
 
 static vcode_unit_t  active_unit = NULL;
 static vcode_block_t active_block = VCODE_INVALID_BLOCK;
 static hash_t       *registry = NULL;
+static hash_t       *lazy_units = NULL;
+
+// A vcode file starts with a header followed by each unit in its own
+// compressed block so a unit can be decoded without reading any that
+// precede it. An index giving the offset of each unit is written after
+// the last unit and the final block holds the offset of the index.
+
+typedef struct {
+   ident_t name;
+   ident_t context;
+   size_t  offset;
+} vcode_index_t;
+
+DECLARE_AND_DEFINE_ARRAY(vcode_index);
+
+typedef struct vcode_file vcode_file_t;
+
+typedef struct {
+   ident_t       context;
+   size_t        offset;
+   vcode_file_t *file;
+} lazy_unit_t;
+
+struct vcode_file {
+   fbuf_t      *fbuf;
+   unsigned     pending;
+   lazy_unit_t  units[0];
+};
+
+static vcode_unit_t vcode_load_lazy(ident_t name, lazy_unit_t *lazy);
 
 static inline int64_t sadd64(int64_t a, int64_t b)
 {
@@ -306,14 +364,65 @@ static op_t *vcode_add_op(vcode_op_t kind)
    return op;
 }
 
+static uint32_t *vcode_arena_alloc(size_t words)
+{
+   arena_chunk_t *chunk = active_unit->arena;
+   if (chunk == NULL || chunk->used + words > chunk->size) {
+      const size_t size = MAX(words, ARENA_CHUNK_SZ);
+      chunk = xmalloc(sizeof(arena_chunk_t) + size * sizeof(uint32_t));
+      chunk->next = active_unit->arena;
+      chunk->used = 0;
+      chunk->size = size;
+
+      active_unit->arena = chunk;
+   }
+
+   uint32_t *ptr = chunk->data + chunk->used;
+   chunk->used += words;
+   return ptr;
+}
+
+static void *vcode_arena_grow(void *items, uint32_t count, uint32_t *max,
+                              uint32_t want)
+{
+   // Space given up when an array grows is only reclaimed when the
+   // unit is freed but most operations have a fixed number of arguments
+   if (want <= *max)
+      return items;
+
+   const uint32_t newmax = MAX(want, MAX(*max * 2, 4));
+   uint32_t *new = vcode_arena_alloc(newmax);
+   if (count > 0)
+      memcpy(new, items, count * sizeof(uint32_t));
+
+   *max = newmax;
+   return new;
+}
+
+static void vcode_resize_args(op_t *op, uint32_t count)
+{
+   op->args.items = vcode_arena_grow(op->args.items, op->args.count,
+                                     &(op->args.max), count);
+   op->args.count = count;
+}
+
 static void vcode_add_arg(op_t *op, vcode_reg_t arg)
 {
-   vcode_reg_array_add(&(op->args), arg);
+   vcode_resize_args(op, op->args.count + 1);
+   op->args.items[op->args.count - 1] = arg;
+}
+
+static void vcode_resize_targets(op_t *op, uint32_t count)
+{
+   op->targets.items = vcode_arena_grow(op->targets.items, op->targets.count,
+                                        &(op->targets.max), count);
+   op->targets.count = count;
 }
 
 static void vcode_add_target(op_t *op, vcode_block_t block)
 {
-   vcode_block_array_add(&(op->targets), block);
+   vcode_resize_targets(op, op->targets.count + 1);
+   op->targets.items[op->targets.count - 1] = block;
 }
 
 static op_t *vcode_op_data(int op)
@@ -400,7 +509,7 @@ void vcode_clear_storage_hint(uint32_t tag)
 
    o->comment = xasprintf("Unused storage hint for r%d", o->args.items[0]);
    o->kind = VCODE_OP_COMMENT;
-   vcode_reg_array_resize(&(o->args), 0, VCODE_INVALID_REG);
+   o->args.count = 0;
 }
 
 void vcode_heap_allocate(vcode_reg_t reg)
@@ -552,6 +661,19 @@ void vcode_state_restore(const vcode_state_t *state)
    active_block = state->block;
 }
 
+static void vcode_free_op(op_t *o)
+{
+   if (OP_HAS_COMMENT(o->kind))
+      free(o->comment);
+   if (OP_HAS_HINT(o->kind))
+      free(o->hint);
+   if (OP_HAS_IMAGE_MAP(o->kind)) {
+      free(o->image_map->elems);
+      free(o->image_map->values);
+      free(o->image_map);
+   }
+}
+
 void vcode_unit_unref(vcode_unit_t unit)
 {
    assert(unit != NULL);
@@ -586,19 +708,8 @@ void vcode_unit_unref(vcode_unit_t unit)
    for (unsigned i = 0; i < unit->blocks.count; i++) {
       block_t *b = &(unit->blocks.items[i]);
 
-      for (unsigned j = 0; j < b->ops.count; j++) {
-         op_t *o = &(b->ops.items[j]);
-         if (OP_HAS_COMMENT(o->kind))
-            free(o->comment);
-         if (OP_HAS_HINT(o->kind))
-            free(o->hint);
-         if (OP_HAS_IMAGE_MAP(o->kind)) {
-            free(o->image_map->elems);
-            free(o->image_map->values);
-            free(o->image_map);
-         }
-         free(o->args.items);
-      }
+      for (unsigned j = 0; j < b->ops.count; j++)
+         vcode_free_op(&(b->ops.items[j]));
       free(b->ops.items);
    }
    free(unit->blocks.items);
@@ -614,6 +725,13 @@ void vcode_unit_unref(vcode_unit_t unit)
    free(unit->signals.items);
    free(unit->vars.items);
    free(unit->params.items);
+   free(unit->locs.items);
+
+   for (arena_chunk_t *it = unit->arena, *tmp; it != NULL; it = tmp) {
+      tmp = it->next;
+      free(it);
+   }
+
    free(unit);
 }
 
@@ -627,6 +745,52 @@ vcode_unit_t vcode_unit_child(vcode_unit_t unit)
    return unit->children;
 }
 
+static size_t vcode_array_bytes(uint32_t count, size_t size)
+{
+   // Arrays grow in powers of two once past the base size
+   if (count == 0)
+      return 0;
+   else
+      return MAX(next_power_of_2(count), ARRAY_BASE_SZ) * size;
+}
+
+#define ARRAY_BYTES(a) vcode_array_bytes((a).count, sizeof(*(a).items))
+
+static size_t vcode_unit_bytes(vcode_unit_t vu)
+{
+   size_t bytes = sizeof(struct vcode_unit) + ARRAY_BYTES(vu->blocks)
+      + ARRAY_BYTES(vu->regs) + ARRAY_BYTES(vu->types)
+      + ARRAY_BYTES(vu->vars) + ARRAY_BYTES(vu->signals)
+      + ARRAY_BYTES(vu->params) + ARRAY_BYTES(vu->locs);
+
+   for (unsigned i = 0; i < vu->blocks.count; i++)
+      bytes += ARRAY_BYTES(vu->blocks.items[i].ops);
+
+   for (arena_chunk_t *it = vu->arena; it != NULL; it = it->next)
+      bytes += sizeof(arena_chunk_t) + it->size * sizeof(uint32_t);
+
+   return bytes;
+}
+
+void vcode_mem_stats(void)
+{
+   if (registry == NULL)
+      return;
+
+   size_t count = 0, bytes = 0;
+   hash_iter_t it = HASH_BEGIN;
+   const void *key;
+   void *value;
+   while (hash_iter(registry, &it, &key, &value)) {
+      if (value != NULL) {
+         bytes += vcode_unit_bytes(value);
+         count++;
+      }
+   }
+
+   mem_record("vcode units", NULL, count, bytes);
+}
+
 int vcode_count_regs(void)
 {
    assert(active_unit != NULL);
@@ -670,8 +834,759 @@ bool vcode_reg_const(vcode_reg_t reg, int64_t *value)
       return false;
 }
 
+bool vcode_reg_const_fill(vcode_reg_t reg, vcode_reg_t *elem)
+{
+   // True if reg is a constant array of scalars with every element
+   // given by the same register
+
+   op_t *defn = vcode_find_definition(reg);
+   if (defn == NULL || defn->kind != VCODE_OP_CONST_ARRAY
+       || defn->args.count == 0)
+      return false;
+
+   const vtype_kind_t kind = vcode_reg_kind(defn->args.items[0]);
+   if (kind != VCODE_TYPE_INT && kind != VCODE_TYPE_REAL)
+      return false;
+
+   for (int i = 1; i < defn->args.count; i++) {
+      if (defn->args.items[i] != defn->args.items[0])
+         return false;
+   }
+
+   *elem = defn->args.items[0];
+   return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Optimisation passes run on each unit once it has been lowered
+
+typedef struct {
+   op_t        *op;
+   vcode_reg_t  result;
+   int          block;
+   int          prev;
+} cse_entry_t;
+
+typedef struct {
+   vcode_reg_t reg;
+   int64_t     low;
+   int64_t     high;
+} range_undo_t;
+
+#define CSE_BUCKETS 1024
+
+typedef struct {
+   int           nblocks;
+   int          *npreds;
+   int          *pred;
+   int          *idom;
+   int          *child;
+   int          *sibling;
+   op_t        **defs;
+   vcode_reg_t  *rename;
+   bool         *ranged;
+   int64_t      *low;
+   int64_t      *high;
+   range_undo_t *undo;
+   size_t        nundo;
+   size_t        maxundo;
+   cse_entry_t  *cse;
+   size_t        ncse;
+   size_t        maxcse;
+   int           heads[CSE_BUCKETS];
+} vcode_opt_t;
+
+static void vcode_opt_delete(op_t *o)
+{
+   // Deleted ops are removed from the block at the end of vcode_opt
+   vcode_free_op(o);
+   o->args.count = 0;
+   o->kind = (vcode_op_t)-1;
+}
+
+static int vcode_opt_targets(const block_t *b, const vcode_block_t **targets)
+{
+   if (b->ops.count == 0)
+      return 0;
+
+   const op_t *last = &(b->ops.items[b->ops.count - 1]);
+   if (!OP_HAS_TARGET(last->kind))
+      return 0;
+
+   *targets = last->targets.items;
+   return last->targets.count;
+}
+
+static bool vcode_opt_resumes(const block_t *b)
+{
+   // Blocks after a wait or procedure call can also be entered directly
+   // from the jump table at the start of the unit
+   if (b->ops.count == 0)
+      return false;
+
+   const vcode_op_t kind = b->ops.items[b->ops.count - 1].kind;
+   return kind == VCODE_OP_WAIT || kind == VCODE_OP_PCALL
+      || kind == VCODE_OP_NESTED_PCALL;
+}
+
+static void vcode_opt_fold_branches(void)
+{
+   // Replace conditional branches on a constant with a jump
+
+   for (int i = 0; i < active_unit->blocks.count; i++) {
+      block_t *b = &(active_unit->blocks.items[i]);
+      if (b->ops.count == 0)
+         continue;
+
+      op_t *o = &(b->ops.items[b->ops.count - 1]);
+      if (o->kind != VCODE_OP_COND && o->kind != VCODE_OP_CASE)
+         continue;
+
+      int64_t value;
+      if (!vcode_reg_const(o->args.items[0], &value))
+         continue;
+
+      vcode_block_t target = VCODE_INVALID_BLOCK;
+      if (o->kind == VCODE_OP_COND)
+         target = o->targets.items[value ? 0 : 1];
+      else {
+         target = o->targets.items[0];
+         for (int j = 1; j < o->args.count; j++) {
+            int64_t cmp;
+            if (!vcode_reg_const(o->args.items[j], &cmp)) {
+               target = VCODE_INVALID_BLOCK;
+               break;
+            }
+            else if (cmp == value) {
+               target = o->targets.items[j];
+               break;
+            }
+         }
+      }
+
+      if (target == VCODE_INVALID_BLOCK)
+         continue;
+
+      o->kind = VCODE_OP_JUMP;
+      o->args.count = 0;
+      o->targets.count = 1;
+      o->targets.items[0] = target;
+   }
+}
+
+static void vcode_opt_roots(int *roots, int *nroots)
+{
+   const int nblocks = active_unit->blocks.count;
+
+   *nroots = 0;
+   roots[(*nroots)++] = 0;
+
+   // The jump table in a process defaults to the block after reset
+   if (active_unit->kind == VCODE_UNIT_PROCESS && nblocks > 1)
+      roots[(*nroots)++] = 1;
+
+   for (int i = 0; i < nblocks; i++) {
+      const block_t *b = &(active_unit->blocks.items[i]);
+      const vcode_block_t *targets;
+      if (vcode_opt_resumes(b) && vcode_opt_targets(b, &targets) > 0)
+         roots[(*nroots)++] = targets[0];
+   }
+}
+
+static void vcode_opt_unreachable(const int *roots, int nroots, bool *live)
+{
+   // Delete the contents of blocks which cannot be reached from the
+   // start of the unit or the jump table: code generation emits an
+   // unreachable instruction for empty blocks
+
+   const int nblocks = active_unit->blocks.count;
+   int *stack LOCAL = xmalloc((nblocks + nroots) * sizeof(int));
+   int sp = 0;
+
+   for (int i = 0; i < nroots; i++) {
+      if (!live[roots[i]]) {
+         live[roots[i]] = true;
+         stack[sp++] = roots[i];
+      }
+   }
+
+   while (sp > 0) {
+      const block_t *b = &(active_unit->blocks.items[stack[--sp]]);
+      const vcode_block_t *targets;
+      const int ntargets = vcode_opt_targets(b, &targets);
+      for (int i = 0; i < ntargets; i++) {
+         if (!live[targets[i]]) {
+            live[targets[i]] = true;
+            stack[sp++] = targets[i];
+         }
+      }
+   }
+
+   for (int i = 0; i < nblocks; i++) {
+      if (live[i])
+         continue;
+
+      block_t *b = &(active_unit->blocks.items[i]);
+      for (int j = 0; j < b->ops.count; j++)
+         vcode_free_op(&(b->ops.items[j]));
+      b->ops.count = 0;
+   }
+}
+
+static int vcode_opt_intersect(vcode_opt_t *opt, int a, int b, const int *po)
+{
+   while (a != b) {
+      while (po[a] < po[b])
+         a = opt->idom[a];
+      while (po[b] < po[a])
+         b = opt->idom[b];
+   }
+   return a;
+}
+
+static void vcode_opt_dominators(vcode_opt_t *opt, const int *roots,
+                                 int nroots, const bool *live)
+{
+   // Iterative algorithm from "A Simple, Fast Dominance Algorithm" by
+   // Cooper, Harvey and Kennedy with a virtual entry node whose
+   // successors are the roots
+
+   const int nblocks = opt->nblocks;
+   const int entry = nblocks;
+
+   int *npreds = opt->npreds;
+   int *pred   = opt->pred;
+   for (int i = 0; i < nblocks; i++)
+      pred[i] = -1;
+
+   for (int i = 0; i < nroots; i++) {
+      npreds[roots[i]]++;
+      pred[roots[i]] = entry;
+   }
+
+   for (int i = 0; i < nblocks; i++) {
+      const vcode_block_t *targets;
+      const int ntargets =
+         vcode_opt_targets(&(active_unit->blocks.items[i]), &targets);
+      for (int j = 0; j < ntargets; j++) {
+         if (j > 0 && targets[j] == targets[j - 1])
+            continue;
+         npreds[targets[j]]++;
+         pred[targets[j]] = i;
+      }
+   }
+
+   // Depth first search gives the post order numbering
+   int *po    LOCAL = xmalloc((nblocks + 1) * sizeof(int));
+   int *order LOCAL = xmalloc((nblocks + 1) * sizeof(int));
+   int *stack LOCAL = xmalloc((nblocks + 1) * sizeof(int));
+   int *next  LOCAL = xcalloc((nblocks + 1) * sizeof(int));
+   bool *seen LOCAL = xcalloc((nblocks + 1) * sizeof(bool));
+
+   int sp = 0, count = 0;
+   stack[sp++] = entry;
+   seen[entry] = true;
+   while (sp > 0) {
+      const int n = stack[sp - 1];
+      int succ = -1;
+      if (n == entry) {
+         if (next[n] < nroots)
+            succ = roots[next[n]++];
+      }
+      else {
+         const vcode_block_t *targets;
+         const int ntargets =
+            vcode_opt_targets(&(active_unit->blocks.items[n]), &targets);
+         if (next[n] < ntargets)
+            succ = targets[next[n]++];
+      }
+
+      if (succ == -1) {
+         po[n] = count;
+         order[count++] = n;
+         sp--;
+      }
+      else if (!seen[succ]) {
+         seen[succ] = true;
+         stack[sp++] = succ;
+      }
+   }
+
+   int *idom = opt->idom;
+   for (int i = 0; i <= nblocks; i++)
+      idom[i] = -1;
+   idom[entry] = entry;
+
+   // Predecessors are found by scanning every block which is acceptable
+   // as this converges in a few iterations for structured code
+   bool changed;
+   do {
+      changed = false;
+      for (int k = count - 2; k >= 0; k--) {
+         const int b = order[k];
+         int new_idom = -1;
+
+         for (int i = 0; i < nroots; i++) {
+            if (roots[i] == b) {
+               new_idom = entry;
+               break;
+            }
+         }
+
+         for (int p = 0; p < nblocks && new_idom != entry; p++) {
+            if (!live[p] || idom[p] == -1)
+               continue;
+
+            const vcode_block_t *targets;
+            const int ntargets =
+               vcode_opt_targets(&(active_unit->blocks.items[p]), &targets);
+            for (int j = 0; j < ntargets; j++) {
+               if (targets[j] == b) {
+                  if (new_idom == -1)
+                     new_idom = p;
+                  else
+                     new_idom = vcode_opt_intersect(opt, p, new_idom, po);
+                  break;
+               }
+            }
+         }
+
+         if (idom[b] != new_idom) {
+            idom[b] = new_idom;
+            changed = true;
+         }
+      }
+   } while (changed);
+
+   for (int i = 0; i <= nblocks; i++)
+      opt->child[i] = opt->sibling[i] = -1;
+
+   for (int i = nblocks - 1; i >= 0; i--) {
+      if (live[i] && idom[i] != -1) {
+         opt->sibling[i] = opt->child[idom[i]];
+         opt->child[idom[i]] = i;
+      }
+   }
+}
+
+static bool vcode_opt_pure(vcode_op_t kind)
+{
+   // Constants are not included as they are already shared within a
+   // block and cost nothing to materialise in another
+   switch (kind) {
+   case VCODE_OP_ADD:
+   case VCODE_OP_ADDI:
+   case VCODE_OP_SUB:
+   case VCODE_OP_MUL:
+   case VCODE_OP_DIV:
+   case VCODE_OP_MOD:
+   case VCODE_OP_REM:
+   case VCODE_OP_EXP:
+   case VCODE_OP_NEG:
+   case VCODE_OP_ABS:
+   case VCODE_OP_CMP:
+   case VCODE_OP_CAST:
+   case VCODE_OP_SELECT:
+   case VCODE_OP_AND:
+   case VCODE_OP_OR:
+   case VCODE_OP_NOT:
+   case VCODE_OP_XOR:
+   case VCODE_OP_XNOR:
+   case VCODE_OP_NAND:
+   case VCODE_OP_NOR:
+   case VCODE_OP_WRAP:
+   case VCODE_OP_UNWRAP:
+   case VCODE_OP_UARRAY_LEFT:
+   case VCODE_OP_UARRAY_RIGHT:
+   case VCODE_OP_UARRAY_DIR:
+   case VCODE_OP_UARRAY_LEN:
+   case VCODE_OP_RECORD_REF:
+   case VCODE_OP_INDEX:
+   case VCODE_OP_NETS:
+   case VCODE_OP_RANGE_NULL:
+      return true;
+   default:
+      return false;
+   }
+}
+
+static unsigned vcode_opt_hash(const op_t *o)
+{
+   uint64_t h = o->kind;
+   for (int i = 0; i < o->args.count; i++)
+      h = h * 31 + o->args.items[i];
+
+   switch (o->kind) {
+   case VCODE_OP_ADDI:
+      h = h * 31 + o->value;
+      break;
+   case VCODE_OP_CMP:
+      h = h * 31 + o->cmp;
+      break;
+   case VCODE_OP_UARRAY_LEFT:
+   case VCODE_OP_UARRAY_RIGHT:
+   case VCODE_OP_UARRAY_DIR:
+   case VCODE_OP_UARRAY_LEN:
+      h = h * 31 + o->dim;
+      break;
+   case VCODE_OP_RECORD_REF:
+      h = h * 31 + o->field;
+      break;
+   case VCODE_OP_INDEX:
+      h = h * 31 + o->address;
+      break;
+   case VCODE_OP_NETS:
+      h = h * 31 + o->signal;
+      break;
+   default:
+      break;
+   }
+
+   return (h ^ (h >> 29)) & (CSE_BUCKETS - 1);
+}
+
+static bool vcode_opt_same(const op_t *a, const op_t *b)
+{
+   if (a->kind != b->kind || a->args.count != b->args.count)
+      return false;
+
+   for (int i = 0; i < a->args.count; i++) {
+      if (a->args.items[i] != b->args.items[i])
+         return false;
+   }
+
+   if (!vtype_eq(vcode_reg_type(a->result), vcode_reg_type(b->result)))
+      return false;
+
+   switch (a->kind) {
+   case VCODE_OP_ADDI:
+      return a->value == b->value;
+   case VCODE_OP_CMP:
+      return a->cmp == b->cmp;
+   case VCODE_OP_CAST:
+      return vtype_eq(a->type, b->type);
+   case VCODE_OP_UARRAY_LEFT:
+   case VCODE_OP_UARRAY_RIGHT:
+   case VCODE_OP_UARRAY_DIR:
+   case VCODE_OP_UARRAY_LEN:
+      return a->dim == b->dim;
+   case VCODE_OP_RECORD_REF:
+      return a->field == b->field;
+   case VCODE_OP_INDEX:
+      return a->address == b->address;
+   case VCODE_OP_NETS:
+      return a->signal == b->signal;
+   default:
+      return true;
+   }
+}
+
+static void vcode_opt_narrow(vcode_opt_t *opt, vcode_reg_t reg,
+                             int64_t low, int64_t high)
+{
+   if (!opt->ranged[reg])
+      return;
+   else if (low <= opt->low[reg] && high >= opt->high[reg])
+      return;
+
+   if (opt->nundo == opt->maxundo) {
+      opt->maxundo = MAX(opt->maxundo * 2, 64);
+      opt->undo = xrealloc(opt->undo, opt->maxundo * sizeof(range_undo_t));
+   }
+
+   range_undo_t *u = &(opt->undo[opt->nundo++]);
+   u->reg  = reg;
+   u->low  = opt->low[reg];
+   u->high = opt->high[reg];
+
+   opt->low[reg]  = MAX(opt->low[reg], low);
+   opt->high[reg] = MIN(opt->high[reg], high);
+}
+
+static bool vcode_opt_within(vcode_opt_t *opt, vcode_reg_t reg,
+                             int64_t low, int64_t high)
+{
+   return opt->ranged[reg] && opt->low[reg] >= low && opt->high[reg] <= high;
+}
+
+static void vcode_opt_branch_facts(vcode_opt_t *opt, int block)
+{
+   // A block whose only predecessor is a conditional branch on an
+   // integer comparison knows the result of that comparison
+
+   if (opt->npreds[block] != 1 || opt->pred[block] == opt->nblocks)
+      return;
+
+   const block_t *p = &(active_unit->blocks.items[opt->pred[block]]);
+   const op_t *cond = &(p->ops.items[p->ops.count - 1]);
+   if (cond->kind != VCODE_OP_COND
+       || cond->targets.items[0] == cond->targets.items[1])
+      return;
+
+   const op_t *cmp = opt->defs[cond->args.items[0]];
+   if (cmp == NULL || cmp->kind != VCODE_OP_CMP)
+      return;
+
+   vcode_reg_t a = cmp->args.items[0], b = cmp->args.items[1];
+   if (!opt->ranged[a] || !opt->ranged[b])
+      return;
+
+   vcode_cmp_t kind = cmp->cmp;
+   if (cond->targets.items[1] == block) {
+      switch (kind) {
+      case VCODE_CMP_EQ:  kind = VCODE_CMP_NEQ; break;
+      case VCODE_CMP_NEQ: kind = VCODE_CMP_EQ; break;
+      case VCODE_CMP_LT:  kind = VCODE_CMP_GEQ; break;
+      case VCODE_CMP_GEQ: kind = VCODE_CMP_LT; break;
+      case VCODE_CMP_GT:  kind = VCODE_CMP_LEQ; break;
+      case VCODE_CMP_LEQ: kind = VCODE_CMP_GT; break;
+      }
+   }
+
+   if (kind == VCODE_CMP_GT || kind == VCODE_CMP_GEQ) {
+      const vcode_reg_t tmp = a;
+      a = b;
+      b = tmp;
+      kind = (kind == VCODE_CMP_GT) ? VCODE_CMP_LT : VCODE_CMP_LEQ;
+   }
+
+   switch (kind) {
+   case VCODE_CMP_EQ:
+      {
+         const int64_t low  = MAX(opt->low[a], opt->low[b]);
+         const int64_t high = MIN(opt->high[a], opt->high[b]);
+         vcode_opt_narrow(opt, a, low, high);
+         vcode_opt_narrow(opt, b, low, high);
+      }
+      break;
+   case VCODE_CMP_LT:
+      if (opt->high[b] > INT64_MIN && opt->low[a] < INT64_MAX) {
+         vcode_opt_narrow(opt, a, INT64_MIN, opt->high[b] - 1);
+         vcode_opt_narrow(opt, b, opt->low[a] + 1, INT64_MAX);
+      }
+      break;
+   case VCODE_CMP_LEQ:
+      vcode_opt_narrow(opt, a, INT64_MIN, opt->high[b]);
+      vcode_opt_narrow(opt, b, opt->low[a], INT64_MAX);
+      break;
+   default:
+      break;
+   }
+}
+
+static bool vcode_opt_check(vcode_opt_t *opt, op_t *o)
+{
+   // Returns true if a bounds or index check is known to pass
+
+   switch (o->kind) {
+   case VCODE_OP_BOUNDS:
+      {
+         if (vtype_kind(o->type) != VCODE_TYPE_INT)
+            return false;
+
+         const vcode_reg_t reg = o->args.items[0];
+         const int64_t low = vtype_low(o->type), high = vtype_high(o->type);
+         if (vcode_opt_within(opt, reg, low, high))
+            return true;
+
+         vcode_opt_narrow(opt, reg, low, high);
+         return false;
+      }
+
+   case VCODE_OP_DYNAMIC_BOUNDS:
+      {
+         const vcode_reg_t reg  = o->args.items[0];
+         const vcode_reg_t low  = o->args.items[1];
+         const vcode_reg_t high = o->args.items[2];
+         if (!opt->ranged[low] || !opt->ranged[high])
+            return false;
+         else if (vcode_opt_within(opt, reg, opt->high[low], opt->low[high]))
+            return true;
+
+         vcode_opt_narrow(opt, reg, opt->low[low], opt->high[high]);
+         return false;
+      }
+
+   case VCODE_OP_INDEX_CHECK:
+      {
+         // Null ranges are not checked so nothing can be learned here
+         int64_t low, high;
+         if (o->args.count == 2) {
+            low  = vtype_low(o->type);
+            high = vtype_high(o->type);
+         }
+         else {
+            const vcode_reg_t blow = o->args.items[2];
+            const vcode_reg_t bhigh = o->args.items[3];
+            if (!opt->ranged[blow] || !opt->ranged[bhigh])
+               return false;
+
+            low  = opt->high[blow];
+            high = opt->low[bhigh];
+         }
+
+         return vcode_opt_within(opt, o->args.items[0], low, high)
+            && vcode_opt_within(opt, o->args.items[1], low, high);
+      }
+
+   default:
+      return false;
+   }
+}
+
+static void vcode_opt_visit(vcode_opt_t *opt, int block)
+{
+   const size_t cse_mark = opt->ncse;
+   const size_t undo_mark = opt->nundo;
+
+   // The virtual entry node has no operations
+   block_t *b = NULL;
+   if (block < opt->nblocks) {
+      vcode_opt_branch_facts(opt, block);
+      b = &(active_unit->blocks.items[block]);
+   }
+
+   for (int i = 0; b != NULL && i < b->ops.count; i++) {
+      op_t *o = &(b->ops.items[i]);
+
+      for (int j = 0; j < o->args.count; j++) {
+         if (o->args.items[j] != VCODE_INVALID_REG)
+            o->args.items[j] = opt->rename[o->args.items[j]];
+      }
+
+      if (vcode_opt_check(opt, o))
+         vcode_opt_delete(o);
+      else if (vcode_opt_pure(o->kind) && o->result != VCODE_INVALID_REG) {
+         const unsigned hash = vcode_opt_hash(o);
+
+         int it;
+         for (it = opt->heads[hash]; it != -1; it = opt->cse[it].prev) {
+            if (vcode_opt_same(opt->cse[it].op, o))
+               break;
+         }
+
+         // Code generation requires definitions to appear in an earlier
+         // block than their uses
+         if (it != -1 && opt->cse[it].block <= block) {
+            opt->rename[o->result] = opt->cse[it].result;
+            vcode_opt_delete(o);
+         }
+         else {
+            if (opt->ncse == opt->maxcse) {
+               opt->maxcse = MAX(opt->maxcse * 2, 256);
+               opt->cse = xrealloc(opt->cse, opt->maxcse * sizeof(cse_entry_t));
+            }
+
+            cse_entry_t *e = &(opt->cse[opt->ncse]);
+            e->op     = o;
+            e->result = o->result;
+            e->block  = block;
+            e->prev   = opt->heads[hash];
+
+            opt->heads[hash] = opt->ncse++;
+         }
+      }
+   }
+
+   for (int c = opt->child[block]; c != -1; c = opt->sibling[c])
+      vcode_opt_visit(opt, c);
+
+   while (opt->ncse > cse_mark) {
+      const cse_entry_t *e = &(opt->cse[--opt->ncse]);
+      opt->heads[vcode_opt_hash(e->op)] = e->prev;
+   }
+
+   while (opt->nundo > undo_mark) {
+      const range_undo_t *u = &(opt->undo[--opt->nundo]);
+      opt->low[u->reg]  = u->low;
+      opt->high[u->reg] = u->high;
+   }
+}
+
+static void vcode_opt_dominated(const int *roots, int nroots, const bool *live)
+{
+   // Walk the dominator tree replacing pure operations with an earlier
+   // identical one and removing bounds checks which must pass given
+   // the checks and branches that dominate them
+
+   const int nblocks = active_unit->blocks.count;
+   const int nregs = active_unit->regs.count;
+
+   vcode_opt_t opt = {
+      .nblocks = nblocks
+   };
+
+   opt.npreds  = xcalloc(nblocks * sizeof(int));
+   opt.pred    = xmalloc(nblocks * sizeof(int));
+   opt.idom    = xmalloc((nblocks + 1) * sizeof(int));
+   opt.child   = xmalloc((nblocks + 1) * sizeof(int));
+   opt.sibling = xmalloc((nblocks + 1) * sizeof(int));
+   opt.defs    = xcalloc(nregs * sizeof(op_t *));
+   opt.rename  = xmalloc(nregs * sizeof(vcode_reg_t));
+   opt.ranged  = xcalloc(nregs * sizeof(bool));
+   opt.low     = xmalloc(nregs * sizeof(int64_t));
+   opt.high    = xmalloc(nregs * sizeof(int64_t));
+
+   for (int i = 0; i < CSE_BUCKETS; i++)
+      opt.heads[i] = -1;
+
+   for (int i = 0; i < nregs; i++) {
+      opt.rename[i] = i;
+
+      const reg_t *r = &(active_unit->regs.items[i]);
+      const vtype_kind_t kind = vtype_kind(r->type);
+      if (kind == VCODE_TYPE_INT || kind == VCODE_TYPE_OFFSET) {
+         const vtype_t *bounds = vcode_type_data(r->bounds);
+         opt.ranged[i] = true;
+         opt.low[i]    = bounds->low;
+         opt.high[i]   = bounds->high;
+      }
+   }
+
+   for (int i = 0; i < nblocks; i++) {
+      block_t *b = &(active_unit->blocks.items[i]);
+      for (int j = 0; j < b->ops.count; j++) {
+         op_t *o = &(b->ops.items[j]);
+         if (o->result != VCODE_INVALID_REG && o->kind != VCODE_OP_COMMENT)
+            opt.defs[o->result] = o;
+      }
+   }
+
+   vcode_opt_dominators(&opt, roots, nroots, live);
+   vcode_opt_visit(&opt, nblocks);
+
+   free(opt.npreds);
+   free(opt.pred);
+   free(opt.idom);
+   free(opt.child);
+   free(opt.sibling);
+   free(opt.defs);
+   free(opt.rename);
+   free(opt.ranged);
+   free(opt.low);
+   free(opt.high);
+   free(opt.undo);
+   free(opt.cse);
+}
+
 void vcode_opt(void)
 {
+   // The unit tests disable these passes to check the unoptimised code
+   if (opt_get_int("vcode-opt")) {
+      const int nblocks = active_unit->blocks.count;
+
+      vcode_opt_fold_branches();
+
+      int *roots LOCAL = xmalloc((nblocks + 2) * sizeof(int));
+      int nroots;
+      vcode_opt_roots(roots, &nroots);
+
+      bool *live LOCAL = xcalloc(nblocks * sizeof(bool));
+      vcode_opt_unreachable(roots, nroots, live);
+
+      vcode_opt_dominated(roots, nroots, live);
+   }
+
    // Prune assignments to unused registers
 
    int *uses LOCAL = xmalloc(active_unit->regs.count * sizeof(int));
@@ -728,7 +1643,7 @@ void vcode_opt(void)
                                             o->result);
                      o->kind = VCODE_OP_COMMENT;
                   }
-                  vcode_reg_array_resize(&(o->args), 0, VCODE_INVALID_REG);
+                  o->args.count = 0;
                   pruned++;
                }
                uses[o->result] = -1;
@@ -792,6 +1707,16 @@ int vcode_count_ops(void)
    return active_unit->blocks.items[active_block].ops.count;
 }
 
+int vcode_count_unit_ops(void)
+{
+   assert(active_unit != NULL);
+
+   int count = 0;
+   for (unsigned i = 0; i < active_unit->blocks.count; i++)
+      count += active_unit->blocks.items[i].ops.count;
+   return count;
+}
+
 int vcode_count_vars(void)
 {
    assert(active_unit != NULL);
@@ -987,7 +1912,8 @@ int vcode_count_args(int op)
 vcode_reg_t vcode_get_arg(int op, int arg)
 {
    op_t *o = vcode_op_data(op);
-   return vcode_reg_array_nth(&(o->args), arg);
+   assert(arg < o->args.count);
+   return o->args.items[arg];
 }
 
 vcode_reg_t vcode_get_result(int op)
@@ -1014,7 +1940,7 @@ const loc_t *vcode_get_loc(int op)
 {
    op_t *o = vcode_op_data(op);
    assert(OP_HAS_LOC(o->kind));
-   return &(o->loc);
+   return loc_array_nth_ptr(&(active_unit->locs), o->loc);
 }
 
 const char *vcode_get_hint(int op)
@@ -1028,7 +1954,8 @@ vcode_block_t vcode_get_target(int op, int nth)
 {
    op_t *o = vcode_op_data(op);
    assert(OP_HAS_TARGET(o->kind));
-   return vcode_block_array_nth(&(o->targets), nth);
+   assert(nth < o->targets.count);
+   return o->targets.items[nth];
 }
 
 bool vcode_block_empty(void)
@@ -2190,8 +3117,9 @@ void vcode_dump_with_mark(int mark_op)
 
          case VCODE_OP_DEBUG_INFO:
             {
-               color_printf("$cyan$@ %s:%d:%d$$", istr(op->loc.file),
-                            op->loc.first_line, op->loc.first_column);
+               const loc_t *loc = &(active_unit->locs.items[op->loc]);
+               color_printf("$cyan$@ %s:%d:%d$$", istr(loc->file),
+                            loc->first_line, loc->first_column);
             }
             break;
          }
@@ -2667,6 +3595,12 @@ bool vcode_unit_pure(void)
    return active_unit->flags & UNIT_PURE;
 }
 
+uint32_t vcode_unit_serial(void)
+{
+   assert(active_unit != NULL);
+   return active_unit->serial;
+}
+
 bool vcode_unit_has_undefined(void)
 {
    assert(active_unit != NULL);
@@ -2708,22 +3642,36 @@ static unsigned vcode_unit_calc_depth(vcode_unit_t unit)
 
 static void vcode_registry_add(vcode_unit_t vu)
 {
+   static uint32_t next_serial = 1;
+
    if (registry == NULL)
       registry = hash_new(512, true);
 
+   // Unique for every registered unit even if a later unit reuses its
+   // name or address so callers can safely cache results keyed on it
+   vu->serial = next_serial++;
+
    assert(vu->refcount > 0);
    hash_put(registry, vu->name, vu);
+
+   if (lazy_units != NULL)
+      hash_put(lazy_units, vu->name, NULL);
 }
 
 vcode_unit_t vcode_find_unit(ident_t name)
 {
-   if (registry == NULL)
-      return NULL;
-   else {
-      vcode_unit_t vu =  hash_get(registry, name);
-      assert(vu == NULL || vu->refcount > 0);
-      return vu;
+   vcode_unit_t vu = NULL;
+   if (registry != NULL)
+      vu = hash_get(registry, name);
+
+   if (vu == NULL && lazy_units != NULL) {
+      lazy_unit_t *lazy = hash_get(lazy_units, name);
+      if (lazy != NULL)
+         vu = vcode_load_lazy(name, lazy);
    }
+
+   assert(vu == NULL || vu->refcount > 0);
+   return vu;
 }
 
 static void vcode_add_child(vcode_unit_t context, vcode_unit_t child)
@@ -2934,7 +3882,7 @@ static vcode_reg_t emit_fcall_op(vcode_op_t op, ident_t func, vcode_type_t type,
       vcode_add_arg(o, args[i]);
 
    if (resume_bb != VCODE_INVALID_BLOCK)
-      vcode_block_array_add(&(o->targets), resume_bb);
+      vcode_add_target(o, resume_bb);
 
    for (int i = 0; i < nargs; i++)
       VCODE_ASSERT(args[i] != VCODE_INVALID_REG, "invalid argument to function");
@@ -3305,7 +4253,7 @@ void emit_store(vcode_reg_t reg, vcode_var_t var)
          other->kind = VCODE_OP_COMMENT;
          other->comment =
             xasprintf("Dead store to %s", istr(vcode_var_name(var)));
-         vcode_reg_array_resize(&(other->args), 0, VCODE_INVALID_REG);
+         other->args.count = 0;
       }
       else if (other->kind == VCODE_OP_NESTED_FCALL
                || other->kind == VCODE_OP_NESTED_PCALL)
@@ -4878,10 +5826,11 @@ void emit_debug_info(const loc_t *loc)
    for (int i = b->ops.count - 1; i >= 0; i--) {
       op_t *other = &(b->ops.items[i]);
       if (other->kind == VCODE_OP_DEBUG_INFO) {
-         if (loc_eq(&(other->loc), loc))
+         loc_t *other_loc = &(active_unit->locs.items[other->loc]);
+         if (loc_eq(other_loc, loc))
             return;   // Matches last debug info
          else if (!seen_real_op) {
-            other->loc = *loc;
+            *other_loc = *loc;
             b->last_loc = *loc;
             return;   // Unused debug info
          }
@@ -4893,52 +5842,61 @@ void emit_debug_info(const loc_t *loc)
    }
 
    op_t *op = vcode_add_op(VCODE_OP_DEBUG_INFO);
-   op->loc = *loc;
+   op->loc = active_unit->locs.count;
+   loc_array_add(&(active_unit->locs), *loc);
 
    b->last_loc = *loc;
 }
 
 static void vcode_write_unit(vcode_unit_t unit, fbuf_t *f,
-                             ident_wr_ctx_t ident_wr_ctx)
+                             vcode_index_array_t *index)
 {
+   vcode_index_t *entry = vcode_index_array_alloc(index);
+   entry->name    = unit->name;
+   entry->context =
+      (unit->kind == VCODE_UNIT_CONTEXT) ? NULL : unit->context->name;
+   entry->offset  = fbuf_tell(f);
+
+   ident_wr_ctx_t ident_wr_ctx = ident_write_begin(f);
+
    write_u8(unit->kind, f);
    ident_write(unit->name, ident_wr_ctx);
    write_u32(unit->result, f);
    write_u32(unit->flags, f);
    write_u32(unit->depth, f);
 
-   if (unit->kind != VCODE_UNIT_CONTEXT) {
-      vcode_select_unit(unit);
-      vcode_select_unit(vcode_unit_context());
-      ident_write(vcode_unit_name(), ident_wr_ctx);
-      vcode_close();
-   }
+   if (unit->kind != VCODE_UNIT_CONTEXT)
+      ident_write(unit->context->name, ident_wr_ctx);
+
+   // Most fields of an operation are small so are written as variable
+   // length integers with one added to registers so an invalid register
+   // takes a single byte
 
-   write_u32(unit->blocks.count, f);
+   write_uint(unit->blocks.count, f);
    for (unsigned i = 0; i < unit->blocks.count; i++) {
       const block_t *b = &(unit->blocks.items[i]);
-      write_u32(b->ops.count, f);
+      write_uint(b->ops.count, f);
 
       for (unsigned j = 0; j < b->ops.count; j++) {
          const op_t *op = &(b->ops.items[j]);
 
          write_u8(op->kind, f);
-         write_u32(op->result, f);
+         write_uint((uint32_t)(op->result + 1), f);
 
-         write_u32(op->args.count, f);
+         write_uint(op->args.count, f);
          for (unsigned k = 0; k < op->args.count; k++)
-            write_u32(op->args.items[k], f);
+            write_uint((uint32_t)(op->args.items[k] + 1), f);
 
          if (OP_HAS_TARGET(op->kind)) {
-            write_u32(op->targets.count, f);
+            write_uint(op->targets.count, f);
             for (unsigned k = 0; k < op->targets.count; k++)
-               write_u32(op->targets.items[k], f);
+               write_uint(op->targets.items[k], f);
          }
 
          if (OP_HAS_TYPE(op->kind))
-            write_u32(op->type, f);
+            write_uint((uint32_t)(op->type + 1), f);
          if (OP_HAS_ADDRESS(op->kind))
-            write_u32(op->address, f);
+            write_uint(op->address, f);
          if (OP_HAS_FUNC(op->kind))
             ident_write(op->func, ident_wr_ctx);
          if (OP_HAS_SUBKIND(op->kind))
@@ -4946,19 +5904,19 @@ static void vcode_write_unit(vcode_unit_t unit, fbuf_t *f,
          if (OP_HAS_CMP(op->kind))
             write_u8(op->cmp, f);
          if (OP_HAS_VALUE(op->kind))
-            write_u64(op->value, f);
+            write_uint(((uint64_t)op->value << 1) ^ (op->value >> 63), f);
          if (OP_HAS_REAL(op->kind))
             write_double(op->real, f);
          if (OP_HAS_COMMENT(op->kind))
             ;   // Do not save comments
          if (OP_HAS_SIGNAL(op->kind))
-            write_u32(op->signal, f);
+            write_uint(op->signal, f);
          if (OP_HAS_DIM(op->kind))
-            write_u32(op->dim, f);
+            write_uint(op->dim, f);
          if (OP_HAS_HOPS(op->kind))
-            write_u32(op->hops, f);
+            write_uint(op->hops, f);
          if (OP_HAS_FIELD(op->kind))
-            write_u32(op->field, f);
+            write_uint(op->field, f);
          if (OP_HAS_HINT(op->kind)) {
             if (op->hint == NULL)
                write_u16(0, f);
@@ -4969,9 +5927,9 @@ static void vcode_write_unit(vcode_unit_t unit, fbuf_t *f,
             }
          }
          if (OP_HAS_TAG(op->kind))
-            write_u32(op->tag, f);
+            write_uint(op->tag, f);
          if (OP_HAS_LOC(op->kind))
-            loc_write(&(op->loc), f, ident_wr_ctx);
+            loc_write(&(unit->locs.items[op->loc]), f, ident_wr_ctx);
          if (OP_HAS_IMAGE_MAP(op->kind)) {
             ident_write(op->image_map->name, ident_wr_ctx);
             write_u16(op->image_map->kind, f);
@@ -4996,18 +5954,18 @@ static void vcode_write_unit(vcode_unit_t unit, fbuf_t *f,
                   write_u32(op->resolution->element[i].type, f);
                   write_u32(op->resolution->element[i].ileft, f);
                   write_u32(op->resolution->element[i].kind, f);
-                  write_u32(op->resolution->element[i].boundary, f);
+                  write_u8(op->resolution->element[i].boundary, f);
                }
             }
          }
       }
    }
 
-   write_u32(unit->regs.count, f);
+   write_uint(unit->regs.count, f);
    for (unsigned i = 0; i < unit->regs.count; i++) {
       const reg_t *r = &(unit->regs.items[i]);
-      write_u32(r->type, f);
-      write_u32(r->bounds, f);
+      write_uint((uint32_t)(r->type + 1), f);
+      write_uint((uint32_t)(r->bounds + 1), f);
    }
 
    write_u32(unit->types.count, f);
@@ -5087,34 +6045,48 @@ static void vcode_write_unit(vcode_unit_t unit, fbuf_t *f,
       write_u32(p->reg, f);
    }
 
+   ident_write_end(ident_wr_ctx);
+
    if (unit->next != NULL)
-      vcode_write_unit(unit->next, f, ident_wr_ctx);
+      vcode_write_unit(unit->next, f, index);
 
    if (unit->children != NULL)
-      vcode_write_unit(unit->children, f, ident_wr_ctx);
+      vcode_write_unit(unit->children, f, index);
 }
 
 void vcode_write(vcode_unit_t unit, fbuf_t *f)
 {
-   assert(unit->kind = VCODE_UNIT_CONTEXT);
+   assert(unit->kind == VCODE_UNIT_CONTEXT);
 
    write_u32(VCODE_MAGIC, f);
    write_u8(VCODE_VERSION, f);
 
+   vcode_index_array_t index = { 0, NULL };
+   vcode_write_unit(unit, f, &index);
+
+   const size_t index_offset = fbuf_tell(f);
+
    ident_wr_ctx_t ident_wr_ctx = ident_write_begin(f);
-   vcode_write_unit(unit, f, ident_wr_ctx);
-   write_u8(0xff, f);  // End marker
+   write_uint(index.count, f);
+   for (unsigned i = 0; i < index.count; i++) {
+      ident_write(index.items[i].name, ident_wr_ctx);
+      ident_write(index.items[i].context, ident_wr_ctx);
+      write_uint(index.items[i].offset, f);
+   }
    ident_write_end(ident_wr_ctx);
+
+   // Start a new block so the offset is alone at the start of the last
+   // block where vcode_read expects to find it
+   (void)fbuf_tell(f);
+   write_u64(index_offset, f);
+
+   free(index.items);
 }
 
-static bool vcode_read_unit(fbuf_t *f, ident_rd_ctx_t ident_rd_ctx)
+static vcode_unit_t vcode_read_unit(fbuf_t *f, ident_rd_ctx_t ident_rd_ctx)
 {
-   const uint8_t marker = read_u8(f);
-   if (marker == 0xff)
-      return false;
-
    vcode_unit_t unit = xcalloc(sizeof(struct vcode_unit));
-   unit->kind     = marker;
+   unit->kind     = read_u8(f);
    unit->name     = ident_read(ident_rd_ctx);
    unit->result   = read_u32(f);
    unit->flags    = read_u32(f);
@@ -5131,51 +6103,56 @@ static bool vcode_read_unit(fbuf_t *f, ident_rd_ctx_t ident_rd_ctx)
    else
       unit->context = unit;
 
-   block_array_resize(&(unit->blocks), read_u32(f), 0);
+   vcode_unit_t saved_unit = active_unit;
+   active_unit = unit;
+
+   block_array_resize(&(unit->blocks), read_uint(f), 0);
    for (unsigned i = 0; i < unit->blocks.count; i++) {
       block_t *b = &(unit->blocks.items[i]);
-      op_array_resize(&(b->ops), read_u32(f), 0);
+      op_array_resize(&(b->ops), read_uint(f), 0);
 
       for (unsigned j = 0; j < b->ops.count; j++) {
          op_t *op = &(b->ops.items[j]);
 
          op->kind = read_u8(f);
-         op->result = read_u32(f);
+         op->result = read_uint(f) - 1;
 
-         vcode_reg_array_resize(&(op->args), read_u32(f), 0);
+         vcode_resize_args(op, read_uint(f));
          for (unsigned k = 0; k < op->args.count; k++)
-            op->args.items[k] = read_u32(f);
+            op->args.items[k] = read_uint(f) - 1;
 
          if (OP_HAS_TARGET(op->kind)) {
-            vcode_block_array_resize(&(op->targets), read_u32(f), 0);
+            vcode_resize_targets(op, read_uint(f));
             for (unsigned k = 0; k < op->targets.count; k++)
-               op->targets.items[k] = read_u32(f);
+               op->targets.items[k] = read_uint(f);
          }
 
          if (OP_HAS_TYPE(op->kind))
-            op->type = read_u32(f);
+            op->type = read_uint(f) - 1;
          if (OP_HAS_ADDRESS(op->kind))
-            op->address = read_u32(f);
+            op->address = read_uint(f);
          if (OP_HAS_FUNC(op->kind))
             op->func = ident_read(ident_rd_ctx);
          if (OP_HAS_SUBKIND(op->kind))
             op->subkind = read_u8(f);
          if (OP_HAS_CMP(op->kind))
             op->cmp = read_u8(f);
-         if (OP_HAS_VALUE(op->kind))
-            op->value = read_u64(f);
+         if (OP_HAS_VALUE(op->kind)) {
+            const uint64_t zigzag = read_uint(f);
+            op->value = (zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+         }
          if (OP_HAS_REAL(op->kind))
             op->real = read_double(f);
          if (OP_HAS_COMMENT(op->kind))
             op->comment = NULL;
          if (OP_HAS_SIGNAL(op->kind))
-            op->signal = read_u32(f);
+            op->signal = read_uint(f);
          if (OP_HAS_DIM(op->kind))
-            op->dim = read_u32(f);
+            op->dim = read_uint(f);
          if (OP_HAS_HOPS(op->kind))
-            op->hops = read_u32(f);
+            op->hops = read_uint(f);
          if (OP_HAS_FIELD(op->kind))
-            op->field = read_u32(f);
+            op->field = read_uint(f);
          if (OP_HAS_HINT(op->kind)) {
             const size_t len = read_u16(f);
             if (len == 0)
@@ -5187,9 +6164,11 @@ static bool vcode_read_unit(fbuf_t *f, ident_rd_ctx_t ident_rd_ctx)
             }
          }
          if (OP_HAS_TAG(op->kind))
-            op->tag = read_u32(f);
-         if (OP_HAS_LOC(op->kind))
-            loc_read(&(op->loc), f, ident_rd_ctx);
+            op->tag = read_uint(f);
+         if (OP_HAS_LOC(op->kind)) {
+            op->loc = unit->locs.count;
+            loc_read(loc_array_alloc(&(unit->locs)), f, ident_rd_ctx);
+         }
          if (OP_HAS_IMAGE_MAP(op->kind)) {
             op->image_map = xmalloc(sizeof(image_map_t));
             op->image_map->name = ident_read(ident_rd_ctx);
@@ -5231,11 +6210,13 @@ static bool vcode_read_unit(fbuf_t *f, ident_rd_ctx_t ident_rd_ctx)
       }
    }
 
-   reg_array_resize(&(unit->regs), read_u32(f), 0);
+   active_unit = saved_unit;
+
+   reg_array_resize(&(unit->regs), read_uint(f), 0);
    for (unsigned i = 0; i < unit->regs.count; i++) {
       reg_t *r = &(unit->regs.items[i]);
-      r->type = read_u32(f);
-      r->bounds = read_u32(f);
+      r->type = read_uint(f) - 1;
+      r->bounds = read_uint(f) - 1;
    }
 
    vtype_array_resize(&(unit->types), read_u32(f), 0);
@@ -5319,7 +6300,31 @@ static bool vcode_read_unit(fbuf_t *f, ident_rd_ctx_t ident_rd_ctx)
 
    vcode_registry_add(unit);
 
-   return true;
+   return unit;
+}
+
+static vcode_unit_t vcode_load_lazy(ident_t name, lazy_unit_t *lazy)
+{
+   hash_put(lazy_units, name, NULL);
+
+   // The context must be loaded before seeking as it may be in the
+   // same file
+   if (lazy->context != NULL)
+      (void)vcode_find_unit(lazy->context);
+
+   vcode_file_t *file = lazy->file;
+   fbuf_seek(file->fbuf, lazy->offset);
+
+   ident_rd_ctx_t ident_rd_ctx = ident_read_begin(file->fbuf);
+   vcode_unit_t vu = vcode_read_unit(file->fbuf, ident_rd_ctx);
+   ident_read_end(ident_rd_ctx);
+
+   if (--(file->pending) == 0) {
+      fbuf_close(file->fbuf);
+      free(file);
+   }
+
+   return vu;
 }
 
 void vcode_read(fbuf_t *f)
@@ -5332,12 +6337,47 @@ void vcode_read(fbuf_t *f)
       fatal("%s was created with vcode format version %d (expected %d)",
             fbuf_file_name(f), version, VCODE_VERSION);
 
+   // Only the index is read here and each unit is decoded the first
+   // time it is looked up with vcode_find_unit
+
+   fbuf_seek(f, fbuf_last_block(f));
+   fbuf_seek(f, read_u64(f));
+
+   if (lazy_units == NULL)
+      lazy_units = hash_new(512, true);
+
    ident_rd_ctx_t ident_rd_ctx = ident_read_begin(f);
 
-   while (vcode_read_unit(f, ident_rd_ctx))
-      ;
+   const unsigned count = read_uint(f);
+   vcode_file_t *file =
+      xmalloc(sizeof(vcode_file_t) + count * sizeof(lazy_unit_t));
+   file->fbuf    = f;
+   file->pending = 0;
+
+   for (unsigned i = 0; i < count; i++) {
+      ident_t name = ident_read(ident_rd_ctx);
+      ident_t context = ident_read(ident_rd_ctx);
+      const size_t offset = read_uint(f);
+
+      if (hash_get(lazy_units, name) != NULL)
+         continue;
+      else if (registry != NULL && hash_get(registry, name) != NULL)
+         continue;
+
+      lazy_unit_t *lazy = &(file->units[file->pending++]);
+      lazy->context = context;
+      lazy->offset  = offset;
+      lazy->file    = file;
+
+      hash_put(lazy_units, name, lazy);
+   }
 
    ident_read_end(ident_rd_ctx);
+
+   if (file->pending == 0) {
+      fbuf_close(f);
+      free(file);
+   }
 }
 
 #if VCODE_CHECK_UNIONS
@@ -243,6 +243,7 @@ vcode_unit_t vcode_find_unit(ident_t name);
 vcode_unit_t vcode_unit_next(vcode_unit_t unit);
 vcode_unit_t vcode_unit_child(vcode_unit_t unit);
 void vcode_unit_unref(vcode_unit_t unit);
+void vcode_mem_stats(void);
 
 void vcode_opt(void);
 void vcode_close(void);
@@ -258,6 +259,7 @@ bool vcode_block_empty(void);
 ident_t vcode_unit_name(void);
 int vcode_unit_depth(void);
 bool vcode_unit_pure(void);
+uint32_t vcode_unit_serial(void);
 bool vcode_unit_has_undefined(void);
 vunit_kind_t vcode_unit_kind(void);
 vcode_type_t vcode_unit_result(void);
@@ -266,6 +268,9 @@ vcode_unit_t vcode_active_unit(void);
 vcode_unit_t vcode_unit_context(void);
 
 void vcode_write(vcode_unit_t unit, fbuf_t *fbuf);
+
+// Reads the index of a vcode file and takes ownership of the file which
+// is kept open until every unit in it has been decoded by vcode_find_unit
 void vcode_read(fbuf_t *fbuf);
 
 void vcode_state_save(vcode_state_t *state);
@@ -280,6 +285,7 @@ vcode_type_t vcode_reg_type(vcode_reg_t reg);
 vtype_kind_t vcode_reg_kind(vcode_reg_t reg);
 vcode_type_t vcode_reg_bounds(vcode_reg_t reg);
 bool vcode_reg_const(vcode_reg_t reg, int64_t *value);
+bool vcode_reg_const_fill(vcode_reg_t reg, vcode_reg_t *elem);
 void vcode_heap_allocate(vcode_reg_t reg);
 
 int vcode_count_signals(void);
@@ -292,6 +298,7 @@ vcode_type_t vcode_signal_bounds(vcode_signal_t sig);
 bool vcode_signal_extern(vcode_signal_t sig);
 
 int vcode_count_ops(void);
+int vcode_count_unit_ops(void);
 vcode_op_t vcode_get_op(int op);
 ident_t vcode_get_func(int op);
 int64_t vcode_get_value(int op);
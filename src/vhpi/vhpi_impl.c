@@ -44,25 +44,57 @@
 #include <dlfcn.h>
 #endif
 
-typedef struct vhpi_cb  vhpi_cb_t;
-typedef struct vhpi_obj vhpi_obj_t;
+typedef struct vhpi_cb    vhpi_cb_t;
+typedef struct vhpi_obj   vhpi_obj_t;
+typedef struct vhpi_group vhpi_group_t;
+typedef struct vhpi_batch vhpi_batch_t;
 
 struct vhpi_cb {
-   int         reason;
-   bool        enabled;
-   bool        fired;
-   bool        repetitive;
-   bool        released;
-   vhpiCbDataT data;
-   int         list_pos;
-   bool        has_handle;
+   int          reason;
+   bool         enabled;
+   bool         fired;
+   bool         repetitive;
+   bool         released;
+   vhpiCbDataT  data;
+   int          list_pos;
+   bool         has_handle;
+   vhpi_batch_t *batch;
+};
+
+struct vhpi_group {
+   vhpiFormatT  format;
+   int          count;
+   vhpi_obj_t **handles;
+   tree_t      *signals;
+   watch_t    **watches;
+   size_t      *widths;
+   size_t       total;
+   uint64_t    *scratch;
+};
+
+typedef struct {
+   vhpi_obj_t *cb;
+   int         index;
+} vhpi_member_t;
+
+struct vhpi_batch {
+   vhpi_obj_t       *group;
+   vhpi_member_t    *members;
+   bool             *pending;
+   int              *changed;
+   int               nchanged;
+   size_t           *offsets;
+   void             *values;
+   vhpiValueChangeT *records;
+   vhpiValueT        value;
 };
 
 typedef enum {
    VHPI_CALLBACK,
    VHPI_TREE,
    VHPI_TYPE,
-   VHPI_RANGE
+   VHPI_RANGE,
+   VHPI_GROUP
 } vhpi_obj_kind_t;
 
 #define VHPI_ANY (vhpi_obj_kind_t)-1
@@ -74,10 +106,11 @@ struct vhpi_obj {
    unsigned        refcnt;
    vhpi_cb_t       cb;
    union {
-      tree_t  tree;
-      type_t  type;
-      void   *pointer;
-      range_t range;
+      tree_t        tree;
+      type_t        type;
+      void         *pointer;
+      range_t       range;
+      vhpi_group_t *group;
    };
 };
 
@@ -90,8 +123,11 @@ typedef struct {
 static cb_list_t       cb_list;
 static tree_t          top_level;
 static hash_t         *handle_hash;
+static hash_t         *name_index;
+static hash_t         *hier_paths;
 static vhpiErrorInfoT  last_error;
 static bool            trace_on = false;
+static int             live_groups = 0;
 
 const vhpiPhysT vhpiFS = { 0, 1 };
 const vhpiPhysT vhpiPS = { 0, 0x3e8 };
@@ -170,7 +206,7 @@ static uint64_t vhpi_time_to_native(const vhpiTimeT *time)
 
 static const char *vhpi_obj_kind_str(vhpi_obj_kind_t kind)
 {
-   const char *names[] = { "callback", "tree", "type", "range" };
+   const char *names[] = { "callback", "tree", "type", "range", "group" };
    if ((unsigned int)kind > ARRAY_LEN(names))
       return "???";
    else
@@ -234,6 +270,9 @@ static const char *vhpi_pretty_handle(vhpiHandleT handle)
 
    case VHPI_RANGE:
       return "<range>";
+
+   case VHPI_GROUP:
+      return (buf = xasprintf("<group count=%d>", handle->group->count));
    }
 
    return "<\?\?\?>";
@@ -323,7 +362,7 @@ static void vhpi_check_for_leaks(void)
 
    leak_cb += vhpi_count_live_cbs(&cb_list);
 
-   if (leak_tree > 0 || leak_cb > 0 || leak_type > 0) {
+   if (leak_tree > 0 || leak_cb > 0 || leak_type > 0 || live_groups > 0) {
       LOCAL_TEXT_BUF tb = tb_new();
       tb_printf(tb, "VHPI plugin leaked");
       if (leak_tree > 0)
@@ -338,11 +377,90 @@ static void vhpi_check_for_leaks(void)
          tb_printf(tb, "%s%s %d callback handles",
                    leak_tree || leak_type ? "," : "",
                    leak_tree ? " and" : "", leak_cb);
+      if (live_groups > 0)
+         tb_printf(tb, "%s %d value group handles",
+                   leak_tree || leak_type || leak_cb ? "," : "", live_groups);
 
       warnf("%s", tb_get(tb));
    }
 }
 
+static void vhpi_build_name_index(void)
+{
+   // Signals already have their full path name as an identifier but
+   // a T_HIER scope marker only has its label so the path of each
+   // enclosing instance is tracked while walking the declarations
+
+   const int ndecls = tree_decls(top_level);
+   name_index = hash_new_kind(ndecls * 2, true, HASH_STR);
+   hier_paths = hash_new(64, true);
+
+   int depth = 0, max_depth = 16;
+   ident_t *scopes = xmalloc(max_depth * sizeof(ident_t));
+
+   for (int i = 0; i < ndecls; i++) {
+      tree_t d = tree_decl(top_level, i);
+
+      switch (tree_kind(d)) {
+      case T_SIGNAL_DECL:
+         hash_put(name_index, istr(tree_ident(d)), d);
+         break;
+      case T_HIER:
+         {
+            ident_t path = (depth == 0)
+               ? ident_prefix(ident_new(":"), tree_ident(d), '\0')
+               : ident_prefix(scopes[depth - 1], tree_ident(d), ':');
+            ARRAY_APPEND(scopes, path, depth, max_depth);
+
+            hash_put(name_index, istr(path), d);
+            hash_put(hier_paths, d, path);
+         }
+         break;
+      default:
+         break;
+      }
+
+      depth -= MIN(tree_attr_int(d, scope_pop_i, 0), depth);
+   }
+
+   free(scopes);
+}
+
+static const char *vhpi_full_name(tree_t t)
+{
+   switch (tree_kind(t)) {
+   case T_ELAB:
+      return istr(tree_attr_str(t, simple_name_i));
+   case T_HIER:
+      if (name_index == NULL)
+         vhpi_build_name_index();
+      return istr(hash_get(hier_paths, t));
+   default:
+      return istr(tree_ident(t));
+   }
+}
+
+static vhpiClassKindT vhpi_class_of_decl(tree_t t)
+{
+   switch (tree_kind(t)) {
+   case T_HIER:
+      switch (tree_subkind(t)) {
+      case T_BLOCK:
+         return vhpiBlockStmtK;
+      case T_PACKAGE:
+         return vhpiPackInstK;
+      default:
+         return vhpiCompInstStmtK;
+      }
+   case T_SIGNAL_DECL:
+      if (tree_attr_int(t, fst_dir_i, -1) != -1)
+         return vhpiPortDeclK;
+      // Fall-through
+   default:
+      return vhpiSigDeclK;
+   }
+}
+
 static vhpi_obj_t *vhpi_tree_to_obj(tree_t t, vhpiClassKindT class)
 {
    vhpi_obj_t *obj = hash_get(handle_hash, t);
@@ -441,6 +559,148 @@ static void vhpi_global_cb(void *user)
       vhpi_fire_event((vhpiHandleT)user);
 }
 
+static size_t vhpi_group_elemsz(const vhpi_group_t *g)
+{
+   return g->format == vhpiIntVal ? sizeof(vhpiIntT) : sizeof(vhpiSmallEnumT);
+}
+
+static void vhpi_group_store(const vhpi_group_t *g, const uint64_t *values,
+                             size_t count, void *buf)
+{
+   if (g->format == vhpiIntVal) {
+      vhpiIntT *restrict dp = buf;
+      for (size_t i = 0; i < count; i++)
+         dp[i] = values[i];
+   }
+   else {
+      vhpiSmallEnumT *restrict dp = buf;
+      for (size_t i = 0; i < count; i++)
+         dp[i] = values[i];
+   }
+}
+
+static void vhpi_batch_flush_cb(void *user);
+
+static void vhpi_batch_event_cb(uint64_t now, tree_t sig,
+                                watch_t *watch, void *user)
+{
+   // Only note which signals changed here: their values are read once
+   // when the whole batch is delivered
+
+   vhpi_member_t *m = user;
+   vhpi_batch_t *b = m->cb->cb.batch;
+   if (b == NULL || b->pending[m->index])
+      return;
+
+   // Kernel global callbacks only fire once so the flush is queued
+   // again by the first change after each delivery
+   if (b->nchanged == 0) {
+      const rt_event_t event = m->cb->cb.reason == vhpiCbGroupChangeDelta
+         ? RT_END_OF_PROCESSES : RT_LAST_KNOWN_DELTA_CYCLE;
+      rt_set_global_cb(event, vhpi_batch_flush_cb, m->cb);
+   }
+
+   b->pending[m->index] = true;
+   b->changed[(b->nchanged)++] = m->index;
+}
+
+static void vhpi_batch_flush_cb(void *user)
+{
+   vhpi_obj_t *obj = user;
+   vhpi_batch_t *b = obj->cb.batch;
+   if (b == NULL)
+      return;
+
+   vhpi_group_t *g = b->group->group;
+   const size_t elemsz = vhpi_group_elemsz(g);
+
+   for (int i = 0; i < b->nchanged; i++) {
+      const int index = b->changed[i];
+      void *dest = (char *)b->values + b->offsets[index] * elemsz;
+
+      const size_t count = rt_watch_value(g->watches[index], g->scratch,
+                                          g->widths[index], false);
+      vhpi_group_store(g, g->scratch, count, dest);
+
+      b->records[i].obj      = g->handles[index];
+      b->records[i].numElems = count;
+      b->records[i].value    = dest;
+
+      b->pending[index] = false;
+   }
+
+   b->value.format    = vhpiPtrVal;
+   b->value.bufSize   = b->nchanged * sizeof(vhpiValueChangeT);
+   b->value.numElems  = b->nchanged;
+   b->value.value.ptr = b->records;
+
+   obj->cb.data.value = &(b->value);
+
+   // The callback may register or release handles so the batch must be
+   // empty again before it runs
+   b->nchanged = 0;
+
+   vhpi_fire_event(obj);
+}
+
+static bool vhpi_register_batch(vhpi_obj_t *obj, vhpiHandleT group)
+{
+   if (!vhpi_validate_handle(group, VHPI_GROUP))
+      return false;
+
+   vhpi_group_t *g = group->group;
+
+   vhpi_batch_t *b = xcalloc(sizeof(vhpi_batch_t));
+   b->group   = group;
+   b->members = xmalloc(MAX(g->count, 1) * sizeof(vhpi_member_t));
+   b->pending = xcalloc(MAX(g->count, 1) * sizeof(bool));
+   b->changed = xmalloc(MAX(g->count, 1) * sizeof(int));
+   b->offsets = xmalloc(MAX(g->count, 1) * sizeof(size_t));
+   b->records = xmalloc(MAX(g->count, 1) * sizeof(vhpiValueChangeT));
+   b->values  = xmalloc(MAX(g->total, 1) * vhpi_group_elemsz(g));
+
+   (group->refcnt)++;
+
+   obj->cb.batch      = b;
+   obj->cb.repetitive = true;
+
+   size_t offset = 0;
+   for (int i = 0; i < g->count; i++) {
+      b->members[i].cb    = obj;
+      b->members[i].index = i;
+      b->offsets[i] = offset;
+      offset += g->widths[i];
+
+      rt_set_event_cb(g->signals[i], vhpi_batch_event_cb,
+                      &(b->members[i]), false);
+   }
+
+   return true;
+}
+
+static void vhpi_release_batch(vhpi_obj_t *obj)
+{
+   vhpi_batch_t *b = obj->cb.batch;
+   vhpi_group_t *g = b->group->group;
+
+   for (int i = 0; i < g->count; i++)
+      rt_set_event_cb(g->signals[i], NULL, &(b->members[i]), false);
+
+   vhpi_release_handle(b->group);
+
+   // The kernel may still hold the handle and members in a queued flush
+   // or disabled watch so like vhpiCbValueChange these are never freed
+   free(b->pending);
+   free(b->changed);
+   free(b->offsets);
+   free(b->records);
+   free(b->values);
+   free(b);
+
+   obj->cb.batch   = NULL;
+   obj->cb.enabled = false;
+}
+
 static const char *vhpi_map_str_for_type(type_t type)
 {
    ident_t type_name;
@@ -582,6 +842,14 @@ vhpiHandleT vhpi_register_cb(vhpiCbDataT *cb_data_p, int32_t flags)
       }
       break;
 
+   case vhpiCbGroupChangeDelta:
+   case vhpiCbGroupChangeTimeStep:
+      if (!vhpi_register_batch(obj, cb_data_p->obj))
+         goto failed;
+
+      vhpi_remember_cb(&cb_list, obj);
+      break;
+
    default:
       fatal("unsupported reason %d in vhpi_register_cb", cb_data_p->reason);
    }
@@ -666,21 +934,24 @@ vhpiHandleT vhpi_handle_by_name(const char *name, vhpiHandleT scope)
       root = scope->tree;
    }
 
-   ident_t search = NULL;
-   if (tree_kind(root) == T_ELAB)
-      search = ident_prefix(tree_attr_str(root, simple_name_i),
-                            ident_new(name), ':');
-   else
-      search = ident_prefix(tree_ident(root), ident_new(name), ':');
+   if (name_index == NULL)
+      vhpi_build_name_index();
 
-   const int ndecls = tree_decls(top_level);
-   for (int i = 0; i < ndecls; i++) {
-      tree_t d = tree_decl(top_level, i);
-      if (tree_ident(d) == search)
-         return (vhpiHandleT)vhpi_tree_to_obj(d, vhpiSigDeclK);
-   }
+   // Build the path name with hierarchy separated by colons as in the
+   // elaborated tree so the lookup does not allocate a new identifier
+   const char *base = vhpi_full_name(root);
+   const size_t baselen = strlen(base), namelen = strlen(name);
+   char search[baselen + namelen + 2];
+   memcpy(search, base, baselen);
+   search[baselen] = ':';
+   for (size_t i = 0; i <= namelen; i++)
+      search[baselen + 1 + i] = (name[i] == '.') ? ':' : name[i];
+
+   tree_t d = hash_get(name_index, search);
+   if (d != NULL)
+      return (vhpiHandleT)vhpi_tree_to_obj(d, vhpi_class_of_decl(d));
 
-   vhpi_error(vhpiError, NULL, "object %s not found", istr(search));
+   vhpi_error(vhpiError, NULL, "object %s not found", search);
    return NULL;
 }
 
@@ -795,7 +1066,11 @@ vhpiIntT vhpi_get(vhpiIntPropertyT property, vhpiHandleT handle)
 
    case vhpiSizeP:
       {
-         if (!vhpi_validate_handle(handle, VHPI_TREE))
+         if (!vhpi_validate_handle(handle, VHPI_ANY))
+            return vhpiUndefined;
+         else if (handle->kind == VHPI_GROUP)
+            return handle->group->total;
+         else if (!vhpi_validate_handle(handle, VHPI_TREE))
             return vhpiUndefined;
 
          return type_width(tree_type(handle->tree));
@@ -811,10 +1086,8 @@ vhpiIntT vhpi_get(vhpiIntPropertyT property, vhpiHandleT handle)
             return vhpiPortDeclK;
 
          case T_SIGNAL_DECL:
-            if (tree_attr_int(handle->tree, fst_dir_i, -1) == -1)
-               return vhpiSigDeclK;
-            else
-               return vhpiPortDeclK;
+         case T_HIER:
+            return vhpi_class_of_decl(handle->tree);
 
          case T_ELAB:
             return vhpiRootInstK;
@@ -871,12 +1144,7 @@ const vhpiCharT *vhpi_get_str(vhpiStrPropertyT property,
          if (!vhpi_validate_handle(handle, VHPI_TREE))
             return NULL;
 
-         const char *full = NULL;
-         if (tree_kind(handle->tree) == T_ELAB)
-            full = istr(tree_attr_str(handle->tree, simple_name_i));
-         else
-            full = istr(tree_ident(handle->tree));
-
+         const char *full = vhpi_full_name(handle->tree);
          const char *last_sep = strrchr(full, ':');
          if (last_sep == NULL)
             return (vhpiCharT *)full;
@@ -890,11 +1158,7 @@ const vhpiCharT *vhpi_get_str(vhpiStrPropertyT property,
          if (!vhpi_validate_handle(handle, VHPI_TREE))
             return NULL;
 
-         if (tree_kind(handle->tree) == T_ELAB)
-            return (vhpiCharT *)istr(tree_attr_str(handle->tree,
-                                                   simple_name_i));
-         else
-            return (vhpiCharT *)istr(tree_ident(handle->tree));
+         return (vhpiCharT *)vhpi_full_name(handle->tree);
       }
 
    case vhpiKindStrP:
@@ -1267,6 +1531,168 @@ int vhpi_put_value(vhpiHandleT handle,
    }
 }
 
+static bool vhpi_group_accepts(type_t type, vhpiFormatT format)
+{
+   type_t base = type_base_recur(type);
+   if (type_is_array(base))
+      base = type_base_recur(type_elem(base));
+
+   switch (type_kind(base)) {
+   case T_ENUM:
+      return format == vhpiIntVal || type_enum_literals(base) <= 256;
+   case T_INTEGER:
+      return format == vhpiIntVal;
+   default:
+      return false;
+   }
+}
+
+vhpiHandleT vhpi_create_value_group(vhpiHandleT *handles, int count,
+                                    vhpiFormatT format)
+{
+   vhpi_clear_error();
+
+   VHPI_TRACE("handles=%p count=%d format=%d", handles, count, format);
+
+   if (format != vhpiIntVal && format != vhpiSmallEnumVecVal) {
+      vhpi_error(vhpiError, NULL, "value group format must be vhpiIntVal "
+                 "or vhpiSmallEnumVecVal");
+      return NULL;
+   }
+
+   for (int i = 0; i < count; i++) {
+      if (!vhpi_validate_handle(handles[i], VHPI_TREE))
+         return NULL;
+
+      tree_t t = handles[i]->tree;
+      if (tree_kind(t) != T_SIGNAL_DECL) {
+         vhpi_error(vhpiError, tree_loc(t), "value groups may only contain "
+                    "signal declaration objects");
+         return NULL;
+      }
+      else if (!vhpi_group_accepts(tree_type(t), format)) {
+         vhpi_error(vhpiError, tree_loc(t), "type %s of signal %s not "
+                    "supported in value group with format %d",
+                    type_pp(tree_type(t)), istr(tree_ident(t)), format);
+         return NULL;
+      }
+   }
+
+   // The net groups of each signal are found once here so reading or
+   // forcing the whole group later only walks the prepared watches
+
+   vhpi_group_t *g = xcalloc(sizeof(vhpi_group_t));
+   g->format  = format;
+   g->count   = count;
+   g->handles = xmalloc(count * sizeof(vhpi_obj_t *));
+   g->signals = xmalloc(count * sizeof(tree_t));
+   g->watches = xmalloc(count * sizeof(watch_t *));
+   g->widths  = xmalloc(count * sizeof(size_t));
+
+   for (int i = 0; i < count; i++) {
+      tree_t t = handles[i]->tree;
+      g->handles[i] = handles[i];
+      g->signals[i] = t;
+      (handles[i]->refcnt)++;
+      g->watches[i] = rt_set_value_watch(t);
+      g->widths[i]  = type_width(tree_type(t));
+      g->total     += g->widths[i];
+   }
+
+   g->scratch = xmalloc(MAX(g->total, 1) * sizeof(uint64_t));
+
+   vhpi_obj_t *obj = xcalloc(sizeof(vhpi_obj_t));
+   obj->magic  = VHPI_MAGIC;
+   obj->kind   = VHPI_GROUP;
+   obj->group  = g;
+   obj->refcnt = 1;
+
+   live_groups++;
+   return obj;
+}
+
+int vhpi_get_group_values(vhpiHandleT handle, void *buf, size_t bufSize)
+{
+   vhpi_clear_error();
+
+   VHPI_TRACE("handle=%s buf=%p bufSize=%zu", vhpi_pretty_handle(handle),
+              buf, bufSize);
+
+   if (!vhpi_validate_handle(handle, VHPI_GROUP))
+      return -1;
+
+   vhpi_group_t *g = handle->group;
+
+   const size_t need = g->total * vhpi_group_elemsz(g);
+   if (bufSize < need)
+      return need;
+
+   size_t offset = 0;
+   for (int i = 0; i < g->count; i++)
+      offset += rt_watch_value(g->watches[i], g->scratch + offset,
+                               g->widths[i], false);
+
+   vhpi_group_store(g, g->scratch, offset, buf);
+   return 0;
+}
+
+int vhpi_put_group_values(vhpiHandleT handle, const void *buf,
+                          size_t bufSize, vhpiPutValueModeT mode)
+{
+   vhpi_clear_error();
+
+   VHPI_TRACE("handle=%s buf=%p bufSize=%zu mode=%d",
+              vhpi_pretty_handle(handle), buf, bufSize, mode);
+
+   if (!vhpi_validate_handle(handle, VHPI_GROUP))
+      return 1;
+
+   vhpi_group_t *g = handle->group;
+
+   bool propagate = false;
+   switch (mode) {
+   case vhpiForcePropagate:
+      if (!rt_can_create_delta()) {
+         vhpi_error(vhpiError, NULL, "cannot force propagate signal "
+                    "during current simulation phase");
+         return 1;
+      }
+      propagate = true;
+   case vhpiForce:
+      break;
+   default:
+      vhpi_error(vhpiFailure, NULL, "mode %d not supported in "
+                 "vhpi_put_group_values", mode);
+      return 1;
+   }
+
+   if (bufSize < g->total * vhpi_group_elemsz(g)) {
+      vhpi_error(vhpiError, NULL, "buffer of %zu bytes too small for value "
+                 "group of %zu elements", bufSize, g->total);
+      return 1;
+   }
+
+   if (g->format == vhpiIntVal) {
+      const vhpiIntT *restrict sp = buf;
+      for (size_t i = 0; i < g->total; i++)
+         g->scratch[i] = sp[i];
+   }
+   else {
+      const vhpiSmallEnumT *restrict sp = buf;
+      for (size_t i = 0; i < g->total; i++)
+         g->scratch[i] = sp[i];
+   }
+
+   size_t offset = 0;
+   for (int i = 0; i < g->count; i++) {
+      rt_force_signal(g->signals[i], g->scratch + offset, g->widths[i],
+                      propagate);
+      offset += g->widths[i];
+   }
+
+   return 0;
+}
+
 int vhpi_schedule_transaction(vhpiHandleT drivHdl,
                               vhpiValueT *value_p,
                               uint32_t numValues,
@@ -1323,6 +1749,11 @@ int vhpi_control(vhpiSimControlT command, ...)
       vhpi_error(vhpiFailure, NULL, "vhpiReset not supported");
       return 1;
 
+   case vhpiStartWave:
+   case vhpiStopWave:
+      rt_set_wave_capture(command == vhpiStartWave);
+      return 0;
+
    default:
       vhpi_error(vhpiFailure, NULL, "unsupported command in vhpi_control");
       return 1;
@@ -1410,10 +1841,36 @@ int vhpi_release_handle(vhpiHandleT handle)
          rt_set_event_cb(handle->tree, NULL, handle, false);
          return 0;
 
+      case vhpiCbGroupChangeDelta:
+      case vhpiCbGroupChangeTimeStep:
+         if (handle->cb.list_pos != -1)
+            vhpi_forget_cb(&cb_list, handle);
+         vhpi_release_batch(handle);
+         return 0;
+
       default:
          assert(false);
       }
 
+   case VHPI_GROUP:
+      assert(handle->refcnt > 0);
+      if (--(handle->refcnt) > 0)
+         return 0;
+
+      for (int i = 0; i < handle->group->count; i++)
+         vhpi_release_handle(handle->group->handles[i]);
+
+      // The watches belong to the kernel and are freed when it resets
+      free(handle->group->handles);
+      free(handle->group->signals);
+      free(handle->group->watches);
+      free(handle->group->widths);
+      free(handle->group->scratch);
+      free(handle->group);
+      vhpi_free_obj(handle);
+      live_groups--;
+      return 0;
+
    case VHPI_TREE:
    case VHPI_TYPE:
    case VHPI_RANGE:
@@ -1474,6 +1931,12 @@ void vhpi_load_plugins(tree_t top, const char *plugins)
 
    handle_hash = hash_new(1024, true);
 
+   if (name_index != NULL) {
+      hash_free(name_index);
+      hash_free(hier_paths);
+      name_index = hier_paths = NULL;
+   }
+
    trace_on = opt_get_int("vhpi_trace_en");
 
    vhpi_clear_error();
@@ -491,6 +491,8 @@ const char *vhpi_cb_reason_str(int reason)
    case vhpiCbTimeOut: return "vhpiCbTimeOut";
    case vhpiCbRepTimeOut: return "vhpiCbRepTimeOut";
    case vhpiCbSensitivity: return "vhpiCbSensitivity";
+   case vhpiCbGroupChangeDelta: return "vhpiCbGroupChangeDelta";
+   case vhpiCbGroupChangeTimeStep: return "vhpiCbGroupChangeTimeStep";
    default:
       {
          static char buf[64];
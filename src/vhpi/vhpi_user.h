@@ -974,6 +974,20 @@ typedef struct vhpiCbDataS
 #define vhpiCbRepTimeOut           1048 /* repetitive */
 #define vhpiCbSensitivity          1049 /* repetitive */
 
+/* nvc extensions: all the changes to signals in a group created with
+   vhpi_create_value_group collected over a delta cycle or a time step
+   and delivered in one call with the value field of the callback data
+   pointing at numElems vhpiValueChangeT records in value.ptr */
+#define vhpiCbGroupChangeDelta     2000 /* repetitive */
+#define vhpiCbGroupChangeTimeStep  2001 /* repetitive */
+
+typedef struct vhpiValueChangeS
+{
+  vhpiHandleT obj;      /* signal handle given when creating the group */
+  int32_t numElems;     /* number of scalar elements in value */
+  const void *value;    /* new value in the format of the group */
+} vhpiValueChangeT;
+
 /************************* CALLBACK FLAGS ***************************/
 #define vhpiReturnCb  0x00000001
 #define vhpiDisableCb 0x00000010
@@ -1091,6 +1105,23 @@ XXTERN int vhpi_schedule_transaction (vhpiHandleT drivHdl,
 XXTERN int vhpi_format_value (const vhpiValueT *in_value_p,
                               vhpiValueT *out_value_p);
 
+/* nvc extensions: a prepared group of signals whose values are all read
+   or forced in one call through a contiguous buffer with an element per
+   scalar subelement in the order the handles were given */
+
+XXTERN vhpiHandleT vhpi_create_value_group (vhpiHandleT *handles,
+                                            int count,
+                                            vhpiFormatT format);
+
+XXTERN int vhpi_get_group_values (vhpiHandleT group,
+                                  void *buf,
+                                  size_t bufSize);
+
+XXTERN int vhpi_put_group_values (vhpiHandleT group,
+                                  const void *buf,
+                                  size_t bufSize,
+                                  vhpiPutValueModeT mode);
+
 /* time processing */
 
 XXTERN void vhpi_get_time (vhpiTimeT *time_p,
@@ -1105,7 +1136,11 @@ XXTERN int vhpi_get_next_time (vhpiTimeT *time_p);
 typedef enum {
   vhpiStop     = 0,
   vhpiFinish   = 1,
-  vhpiReset    = 2
+  vhpiReset    = 2,
+
+  /* nvc extensions */
+  vhpiStartWave = 1000,
+  vhpiStopWave  = 1001
 #ifdef VHPIEXTEND_CONTROL
   VHPIEXTEND_CONTROL
 #endif
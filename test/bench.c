@@ -0,0 +1,478 @@
+#include "util.h"
+#include "rt/heap.h"
+#include "rt/wheel.h"
+#include "rt/alloc.h"
+#include "rt/slab.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <libgen.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#ifdef __MINGW32__
+#define realpath(N, R) _fullpath((R), (N), _MAX_PATH)
+#define setenv(x, y, z) _putenv_s((x), (y))
+#endif
+
+// Micro-benchmarks for the simulation kernel. Data structures which can
+// be linked directly are timed in process over a fixed number of
+// operations; the kernel paths which need an elaborated design are timed
+// by running small models from test/bench. Inputs come from a fixed seed
+// so every run does exactly the same work.
+
+#define NS     UINT64_C(1000000)
+#define US     (NS * 1000)
+#define MS     (US * 1000)
+#define SEED   UINT64_C(0x9e3779b97f4a7c15)
+#define NDELAY 4096
+
+typedef enum { DIST_DELTA, DIST_CLOCK, DIST_MIXED } dist_t;
+
+typedef struct {
+   const char *name;
+   double    (*run)(const void *arg);
+   const void *arg;
+} micro_t;
+
+typedef struct {
+   const char *name;
+   const char *unit;
+   const char *elab_args;
+   const char *run_args;
+} design_t;
+
+typedef struct {
+   bool   is_wheel;
+   dist_t dist;
+   size_t depth;
+} eventq_arg_t;
+
+static char   bin_dir[PATH_MAX];
+static char   test_dir[PATH_MAX];
+static char   bench_dir[PATH_MAX];
+static int    repeat = 5;
+static bool   quick = false;
+static FILE  *json = NULL;
+static bool   first_result = true;
+static char **filters = NULL;
+static int    nfilters = 0;
+
+static uint64_t rand_next(uint64_t *state)
+{
+   // xorshift64*
+   uint64_t x = *state;
+   x ^= x >> 12;
+   x ^= x << 25;
+   x ^= x >> 27;
+   *state = x;
+   return x * UINT64_C(2685821657736338717);
+}
+
+static void fill_delays(uint64_t *delays, dist_t dist)
+{
+   // Rough shapes of the queue traffic seen in real designs: mostly
+   // zero delay updates, a handful of clocks with fixed periods, and a
+   // spread of gate delays with occasional long timeouts
+
+   static const uint64_t periods[] = { 10 * NS, 8 * NS, 5 * NS, 10 * NS };
+
+   uint64_t state = SEED;
+   for (int i = 0; i < NDELAY; i++) {
+      const uint64_t r = rand_next(&state);
+      switch (dist) {
+      case DIST_DELTA:
+         delays[i] = (r % 10 == 0) ? ((r >> 8) % 10 + 1) * NS : 0;
+         break;
+      case DIST_CLOCK:
+         delays[i] = periods[i % ARRAY_LEN(periods)];
+         break;
+      case DIST_MIXED:
+         if (r % 20 == 0)
+            delays[i] = MS;
+         else if (r % 20 < 4)
+            delays[i] = ((r >> 8) % 16 + 1) * US;
+         else
+            delays[i] = ((r >> 8) % 16 + 1) * NS;
+         break;
+      }
+   }
+}
+
+static double bench_eventq(const void *arg)
+{
+   // Hold model: the queue stays at a fixed depth while each operation
+   // extracts the earliest event and schedules another after a delay
+
+   const eventq_arg_t *a = arg;
+   const uint64_t ops = quick ? 1 << 16 : 1 << 21;
+
+   uint64_t delays[NDELAY];
+   fill_delays(delays, a->dist);
+
+   heap_t h = a->is_wheel ? NULL : heap_new(a->depth);
+   wheel_t w = a->is_wheel ? wheel_new() : NULL;
+
+   for (size_t i = 0; i < a->depth; i++) {
+      const uint64_t key = delays[i % NDELAY];
+      if (w != NULL)
+         wheel_insert(w, key, (void *)(uintptr_t)(key + 1));
+      else
+         heap_insert(h, key, (void *)(uintptr_t)(key + 1));
+   }
+
+   const uint64_t start = get_timestamp_us();
+
+   for (uint64_t i = 0; i < ops; i++) {
+      void *user;
+      if (w != NULL)
+         user = wheel_extract_min(w);
+      else
+         user = heap_extract_min(h);
+
+      const uint64_t key = (uintptr_t)user - 1 + delays[i % NDELAY];
+      if (w != NULL)
+         wheel_insert(w, key, (void *)(uintptr_t)(key + 1));
+      else
+         heap_insert(h, key, (void *)(uintptr_t)(key + 1));
+   }
+
+   const uint64_t elapsed = get_timestamp_us() - start;
+
+   if (w != NULL)
+      wheel_free(w);
+   else
+      heap_free(h);
+
+   return elapsed * 1000.0 / ops;
+}
+
+static double bench_alloc_lifo(const void *arg)
+{
+   const uint64_t ops = quick ? 1 << 18 : 1 << 24;
+
+   rt_alloc_stack_t s = rt_alloc_stack_new(64, "bench");
+
+   const uint64_t start = get_timestamp_us();
+
+   for (uint64_t i = 0; i < ops; i++) {
+      void *p = rt_alloc(s);
+      *(volatile char *)p = 0;
+      rt_free(s, p);
+   }
+
+   const uint64_t elapsed = get_timestamp_us() - start;
+
+   rt_alloc_stack_destroy(s);
+   return elapsed * 1000.0 / ops;
+}
+
+static double bench_alloc_burst(const void *arg)
+{
+   // Allocate a burst of events for one cycle and release them all
+   // afterwards: the first burst grows the stack and the rest reuse it
+
+   const size_t burst = 4096;
+   const uint64_t rounds = quick ? 16 : 1024;
+
+   rt_alloc_stack_t s = rt_alloc_stack_new(64, "bench");
+   void **items = xmalloc(burst * sizeof(void *));
+
+   const uint64_t start = get_timestamp_us();
+
+   for (uint64_t r = 0; r < rounds; r++) {
+      for (size_t i = 0; i < burst; i++)
+         items[i] = rt_alloc(s);
+      for (size_t i = 0; i < burst; i++)
+         rt_free(s, items[burst - i - 1]);
+   }
+
+   const uint64_t elapsed = get_timestamp_us() - start;
+
+   free(items);
+   rt_alloc_stack_destroy(s);
+   return elapsed * 1000.0 / (rounds * burst);
+}
+
+static double bench_slab(const void *arg)
+{
+   static const size_t sizes[] = { 1, 8, 16, 40, 64, 256, 1024, 4096 };
+
+   const size_t burst = 1024;
+   const uint64_t rounds = quick ? 16 : 1024;
+
+   void **items = xmalloc(burst * sizeof(void *));
+
+   const uint64_t start = get_timestamp_us();
+
+   for (uint64_t r = 0; r < rounds; r++) {
+      for (size_t i = 0; i < burst; i++)
+         items[i] = slab_alloc(sizes[i % ARRAY_LEN(sizes)]);
+      for (size_t i = 0; i < burst; i++)
+         slab_free(items[i], sizes[i % ARRAY_LEN(sizes)]);
+   }
+
+   const uint64_t elapsed = get_timestamp_us() - start;
+
+   free(items);
+   slab_trim();
+   return elapsed * 1000.0 / (rounds * burst);
+}
+
+static const eventq_arg_t heap_delta  = { false, DIST_DELTA, 1024 };
+static const eventq_arg_t heap_clock  = { false, DIST_CLOCK, 1024 };
+static const eventq_arg_t heap_mixed  = { false, DIST_MIXED, 16384 };
+static const eventq_arg_t wheel_delta = { true, DIST_DELTA, 1024 };
+static const eventq_arg_t wheel_clock = { true, DIST_CLOCK, 1024 };
+static const eventq_arg_t wheel_mixed = { true, DIST_MIXED, 16384 };
+
+static const micro_t micros[] = {
+   { "eventq_heap_delta",  bench_eventq, &heap_delta },
+   { "eventq_heap_clock",  bench_eventq, &heap_clock },
+   { "eventq_heap_mixed",  bench_eventq, &heap_mixed },
+   { "eventq_wheel_delta", bench_eventq, &wheel_delta },
+   { "eventq_wheel_clock", bench_eventq, &wheel_clock },
+   { "eventq_wheel_mixed", bench_eventq, &wheel_mixed },
+   { "alloc_lifo",         bench_alloc_lifo, NULL },
+   { "alloc_burst",        bench_alloc_burst, NULL },
+   { "slab_mixed",         bench_slab, NULL },
+};
+
+static const design_t designs[] = {
+   { "resolve_1",      "resolve",      "-gDRIVERS=1",  NULL },
+   { "resolve_2",      "resolve",      "-gDRIVERS=2",  NULL },
+   { "resolve_16",     "resolve",      "-gDRIVERS=16", NULL },
+   { "sched_scalar",   "sched_scalar", "",             NULL },
+   { "sched_vector",   "sched_vector", "",             NULL },
+   { "sensitivity",    "fanout",       "",             NULL },
+   { "wave_callbacks", "sched_scalar", "",             "--wave=wave.fst" },
+};
+
+static bool selected(const char *name)
+{
+   if (nfilters == 0)
+      return true;
+
+   for (int i = 0; i < nfilters; i++) {
+      if (strncmp(name, filters[i], strlen(filters[i])) == 0)
+         return true;
+   }
+
+   return false;
+}
+
+static int double_cmp(const void *a, const void *b)
+{
+   const double l = *(const double *)a;
+   const double r = *(const double *)b;
+   return (l > r) - (l < r);
+}
+
+static void result_begin(const char *name, const char *kind)
+{
+   fprintf(json, "%s\n    { \"name\": \"%s\", \"kind\": \"%s\"",
+           first_result ? "" : ",", name, kind);
+   first_result = false;
+}
+
+static void result_samples(const char *unit, double *samples, int n)
+{
+   qsort(samples, n, sizeof(double), double_cmp);
+
+   fprintf(json, ", \"min_%s\": %.2f, \"median_%s\": %.2f"
+           ", \"max_%s\": %.2f", unit, samples[0], unit, samples[n / 2],
+           unit, samples[n - 1]);
+}
+
+static void run_micro(const micro_t *m)
+{
+   fprintf(stderr, "%20s : ", m->name);
+   fflush(stderr);
+
+   (*m->run)(m->arg);   // Warm up caches and allocator state
+
+   double *samples = xmalloc(repeat * sizeof(double));
+   for (int i = 0; i < repeat; i++)
+      samples[i] = (*m->run)(m->arg);
+
+   result_begin(m->name, "micro");
+   result_samples("ns_per_op", samples, repeat);
+   fprintf(json, " }");
+
+   fprintf(stderr, "%.2f ns/op\n", samples[0]);
+   free(samples);
+}
+
+static void run_nvc(const design_t *d, const char *args)
+{
+   char *cmd LOCAL = xasprintf("\"%s" PATH_SEP "nvc%s\" %s >> %s.log 2>&1",
+                               bin_dir, EXEEXT, args, d->name);
+   if (system(cmd) != 0)
+      fatal("%s failed: see %s" PATH_SEP "%s.log", cmd, bench_dir, d->name);
+}
+
+static void copy_file(const char *name)
+{
+   FILE *f = fopen(name, "r");
+   if (f == NULL)
+      fatal_errno("failed to open %s", name);
+
+   char buf[1024];
+   size_t n;
+   while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+      // Drop the trailing newline so the object nests cleanly
+      if (feof(f) && buf[n - 1] == '\n')
+         n--;
+      fwrite(buf, 1, n, json);
+   }
+
+   fclose(f);
+}
+
+static void run_design(const design_t *d)
+{
+   fprintf(stderr, "%20s : ", d->name);
+   fflush(stderr);
+
+   char *log LOCAL = xasprintf("%s.log", d->name);
+   remove(log);
+
+   const char *cycles = quick ? " -gCYCLES=100" : "";
+
+   char *elab LOCAL = xasprintf("-a \"%s" PATH_SEP "bench" PATH_SEP "%s.vhd\" "
+                                "-e %s %s%s", test_dir, d->unit, d->unit,
+                                d->elab_args, cycles);
+   run_nvc(d, elab);
+
+   char *stats LOCAL = xasprintf("%s.json", d->name);
+   char *run LOCAL = xasprintf("-r --stats-json=%s %s %s", stats,
+                               d->run_args ?: "", d->unit);
+
+   run_nvc(d, run);   // Warm up the file cache
+
+   double *samples = xmalloc(repeat * sizeof(double));
+   for (int i = 0; i < repeat; i++) {
+      const uint64_t start = get_timestamp_us();
+      run_nvc(d, run);
+      samples[i] = (get_timestamp_us() - start) / 1000.0;
+   }
+
+   result_begin(d->name, "design");
+   result_samples("wall_ms", samples, repeat);
+   fprintf(json, ",\n      \"kernel\": ");
+   copy_file(stats);
+   fprintf(json, " }");
+
+   fprintf(stderr, "%.1f ms\n", samples[0]);
+   free(samples);
+}
+
+static void usage(const char *argv0)
+{
+   printf("Usage: %s [OPTION]... [NAME]...\n"
+          "\n"
+          "Run the kernel benchmarks whose names start with any NAME, or\n"
+          "all of them if none are given.\n"
+          "\n"
+          " -l, --list\t\tPrint the benchmark names and exit\n"
+          " -o, --output=FILE\tWrite results to FILE instead of stdout\n"
+          " -q, --quick\t\tRun a small number of iterations\n"
+          " -r, --repeat=N\t\tTime each benchmark N times (default 5)\n",
+          argv0);
+}
+
+int main(int argc, char **argv)
+{
+   static struct option long_options[] = {
+      { "list",   no_argument,       0, 'l' },
+      { "output", required_argument, 0, 'o' },
+      { "quick",  no_argument,       0, 'q' },
+      { "repeat", required_argument, 0, 'r' },
+      { "help",   no_argument,       0, 'h' },
+      { 0, 0, 0, 0 }
+   };
+
+   const char *output = NULL;
+   int c, index = 0;
+   while ((c = getopt_long(argc, argv, "lo:qr:h", long_options,
+                           &index)) != -1) {
+      switch (c) {
+      case 'l':
+         for (size_t i = 0; i < ARRAY_LEN(micros); i++)
+            printf("%s\n", micros[i].name);
+         for (size_t i = 0; i < ARRAY_LEN(designs); i++)
+            printf("%s\n", designs[i].name);
+         return EXIT_SUCCESS;
+      case 'o':
+         output = optarg;
+         break;
+      case 'q':
+         quick = true;
+         break;
+      case 'r':
+         if ((repeat = atoi(optarg)) <= 0)
+            fatal("invalid repeat count %s", optarg);
+         break;
+      case 'h':
+         usage(argv[0]);
+         return EXIT_SUCCESS;
+      default:
+         usage(argv[0]);
+         return EXIT_FAILURE;
+      }
+   }
+
+   filters  = argv + optind;
+   nfilters = argc - optind;
+
+   if (realpath(TESTDIR, test_dir) == NULL)
+      fatal_errno("failed to get real path for %s", TESTDIR);
+
+   char argv0_path[PATH_MAX];
+   if (realpath(argv[0], argv0_path) == NULL)
+      fatal_errno("failed to get real path for %s", argv[0]);
+   strncpy(bin_dir, dirname(argv0_path), sizeof(bin_dir) - 1);
+
+   char *lib_dir LOCAL = xasprintf("%s" PATH_SEP ".." PATH_SEP "lib",
+                                   bin_dir);
+
+   setenv("NVC_IMP_LIB", lib_dir, 1);
+   setenv("NVC_LIBPATH", lib_dir, 1);
+
+   if (output != NULL && (json = fopen(output, "w")) == NULL)
+      fatal_errno("failed to create %s", output);
+   else if (output == NULL)
+      json = stdout;
+
+   // Designs are analysed into a scratch work library which is kept
+   // afterwards so failures can be investigated
+   make_dir("bench");
+   if (chdir("bench") != 0)
+      fatal_errno("failed to change to bench directory");
+   if (getcwd(bench_dir, sizeof(bench_dir)) == NULL)
+      fatal_errno("getcwd");
+
+   fprintf(json, "{\n  \"repeat\": %d,\n  \"quick\": %s,\n"
+           "  \"benchmarks\": [", repeat, quick ? "true" : "false");
+
+   for (size_t i = 0; i < ARRAY_LEN(micros); i++) {
+      if (selected(micros[i].name))
+         run_micro(&(micros[i]));
+   }
+
+   for (size_t i = 0; i < ARRAY_LEN(designs); i++) {
+      if (selected(designs[i].name))
+         run_design(&(designs[i]));
+   }
+
+   fprintf(json, "%s]\n}\n", first_result ? "" : "\n  ");
+
+   if (json != stdout)
+      fclose(json);
+
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,32 @@
+entity fanout is
+    generic ( LOADS  : positive := 256;
+              CYCLES : positive := 20000 );
+end entity;
+
+architecture bench of fanout is
+    signal clk : bit := '0';
+begin
+
+    clkgen: process is
+    begin
+        for j in 1 to CYCLES loop
+            clk <= not clk;
+            wait for 1 ns;
+        end loop;
+        wait;
+    end process;
+
+    -- Every process wakes on each clock edge but only half of them do
+    -- anything beyond checking the condition
+
+    load: for i in 1 to LOADS generate
+        process (clk) is
+            variable count : natural := 0;
+        begin
+            if clk = '1' and (i mod 2) = 0 then
+                count := count + 1;
+            end if;
+        end process;
+    end generate;
+
+end architecture;
@@ -0,0 +1,43 @@
+entity resolve is
+    generic ( DRIVERS : positive := 2;
+              CYCLES  : positive := 200000 );
+end entity;
+
+architecture bench of resolve is
+
+    type int_vector is array (natural range <>) of integer;
+
+    function sum (v : int_vector) return integer is
+        variable result : integer := 0;
+    begin
+        for i in v'range loop
+            result := result + v(i);
+        end loop;
+        return result;
+    end function;
+
+    subtype rint is sum integer;
+
+    signal r : rint := 0;
+
+begin
+
+    drive: for i in 1 to DRIVERS generate
+        process is
+        begin
+            for j in 1 to CYCLES loop
+                r <= (j mod 8) + i;
+                wait for 1 ns;
+            end loop;
+            r <= 0;
+            wait;
+        end process;
+    end generate;
+
+    reader: process (r) is
+        variable count : natural := 0;
+    begin
+        count := count + 1;
+    end process;
+
+end architecture;
@@ -0,0 +1,25 @@
+entity sched_scalar is
+    generic ( PROCS  : positive := 64;
+              CYCLES : positive := 20000 );
+end entity;
+
+architecture bench of sched_scalar is
+    signal s : bit_vector(1 to PROCS) := (others => '0');
+begin
+
+    -- Each process toggles its own signal with a period and transport
+    -- delay that differ between processes so the event queue holds a
+    -- spread of future times rather than a single clock edge
+
+    toggle: for i in 1 to PROCS generate
+        process is
+        begin
+            for j in 1 to CYCLES loop
+                s(i) <= transport not s(i) after ((i mod 5) + 1) * 1 ns;
+                wait for ((i mod 7) + 1) * 1 ns;
+            end loop;
+            wait;
+        end process;
+    end generate;
+
+end architecture;
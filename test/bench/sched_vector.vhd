@@ -0,0 +1,25 @@
+entity sched_vector is
+    generic ( WIDTH  : positive := 4096;
+              CYCLES : positive := 20000 );
+end entity;
+
+architecture bench of sched_vector is
+    signal v : bit_vector(WIDTH - 1 downto 0) := (others => '0');
+begin
+
+    driver: process is
+    begin
+        for j in 1 to CYCLES loop
+            v <= not v after 1 ns;
+            wait for 1 ns;
+        end loop;
+        wait;
+    end process;
+
+    reader: process (v) is
+        variable count : natural := 0;
+    begin
+        count := count + 1;
+    end process;
+
+end architecture;
@@ -0,0 +1,25 @@
+entity elide is
+end entity;
+
+architecture test of elide is
+begin
+
+    process is
+        subtype small is integer range 0 to 7;
+        variable a : small;
+        variable b : integer range 0 to 15;
+        variable c : integer range 0 to 8;
+        variable v : bit_vector(0 to 15);
+        variable x : integer;
+    begin
+        b := a + a;                     -- OK
+        c := a + 1;                     -- OK
+        a := b;                         -- Not in range
+        v(a) := '1';                    -- OK
+        v(b * 1) := '1';                -- OK
+        v(x) := '0';                    -- Not in range
+        c := a * 2 - 6;                 -- Not in range
+        wait;
+    end process;
+
+end architecture;
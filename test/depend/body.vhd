@@ -0,0 +1,4 @@
+-- use work.other.all
+package body Pack is
+    constant s : string := "use work.other.all";
+end package body;
@@ -0,0 +1,11 @@
+library mylib;
+use mylib.pack.all;
+
+entity ent is
+end entity;
+
+architecture a of ent is
+    signal x : bit := '1';
+begin
+    x <= not x'delayed(1 ns) after 1 ns;
+end architecture;
@@ -0,0 +1,3 @@
+package pack is
+    constant k : integer := 5;
+end package;
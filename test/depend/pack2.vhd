@@ -0,0 +1,3 @@
+package pack is
+    constant k : integer := 6;
+end package;
@@ -0,0 +1,16 @@
+entity top is
+end entity;
+
+architecture a of top is
+    /* entity work.pack */
+    component c is
+    end component;
+begin
+    u1: entity work.ent;
+    u2: component c;
+end architecture;
+
+configuration conf of top is
+    for a
+    end for;
+end configuration;
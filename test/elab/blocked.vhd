@@ -0,0 +1,62 @@
+entity checker is
+    generic ( ENABLE : boolean );
+    port ( i : in integer );
+end entity;
+
+architecture test of checker is
+begin
+
+    -- Disabled by the generic
+    check: process is
+    begin
+        if not ENABLE then
+            wait;
+        end if;
+        loop
+            wait on i;
+            assert i >= 0;
+        end loop;
+    end process;
+
+    -- Never resumes after initialisation when enabled
+    idle: process is
+        variable v : integer := 5;
+    begin
+        wait until not ENABLE;
+        report "unreachable";
+    end process;
+
+end architecture;
+
+entity blocked is
+end entity;
+
+architecture test of blocked is
+    signal s : integer;
+
+    impure function get_value return integer is
+    begin
+        report "side effect";
+        return 1;
+    end function;
+begin
+
+    u1: entity work.checker generic map ( true ) port map ( s );
+    u2: entity work.checker generic map ( false ) port map ( s );
+
+    -- Must be kept as the unreachable assignment creates a driver
+    drive: process is
+    begin
+        wait;
+        s <= 1;
+    end process;
+
+    -- Must be kept as the variable initialiser has a side effect
+    init: process is
+        variable v : integer := get_value;
+    begin
+        wait;
+        report "unreachable";
+    end process;
+
+end architecture;
@@ -0,0 +1,56 @@
+entity inc is
+    port ( x : in integer;
+           y : out integer );
+end entity;
+
+architecture test of inc is
+begin
+    add: y <= x + 1;
+end architecture;
+
+-------------------------------------------------------------------------------
+
+entity cycle1 is
+end entity;
+
+architecture test of cycle1 is
+    signal clk     : bit;
+    signal r, a, b : integer;
+    signal c, d    : integer;
+    signal p, q    : bit;
+    signal m       : integer;
+    signal n       : integer;
+begin
+
+    reg: process (clk) is
+    begin
+        if clk'event and clk = '1' then
+            r <= b;
+        end if;
+    end process;
+
+    u: entity work.inc port map ( r, a );
+
+    dbl: b <= a * 2;
+
+    sum: process (a, b) is
+        variable tmp : integer;
+    begin
+        tmp := a + b;
+        c <= tmp;
+    end process;
+
+    late: d <= c after 1 ns;
+
+    loop1: p <= q;
+    loop2: q <= p;
+
+    other: process (p, a) is
+    begin
+        m <= a;
+    end process;
+
+    multi1: n <= a;
+    multi2: n <= b;
+
+end architecture;
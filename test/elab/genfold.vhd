@@ -0,0 +1,43 @@
+package pack is
+    type mode_t is (FAST, SLOW, OFF);
+end package;
+
+use work.pack.all;
+
+entity sub is
+    generic ( M : mode_t; W : integer );
+    port ( o : out integer );
+end entity;
+
+architecture test of sub is
+begin
+
+    process is
+    begin
+        case M is
+            when FAST => o <= 1;
+            when SLOW => o <= 2;
+            when OFF => null;
+        end case;
+        case W is
+            when 0 to 3 => o <= 3;
+            when others => o <= 4;
+        end case;
+        wait;
+    end process;
+
+end architecture;
+
+use work.pack.all;
+
+entity genfold is
+end entity;
+
+architecture test of genfold is
+    signal s1, s2 : integer;
+begin
+
+    u1: entity work.sub generic map ( SLOW, 2 ) port map ( s1 );
+    u2: entity work.sub generic map ( OFF, 10 ) port map ( s2 );
+
+end architecture;
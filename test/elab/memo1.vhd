@@ -0,0 +1,43 @@
+entity sub is
+    generic ( N : integer; V : bit := '0' );
+    port ( i : in bit_vector(N - 1 downto 0);
+           o : out bit );
+end entity;
+
+architecture test of sub is
+begin
+
+    p: process (i) is
+    begin
+        o <= i(N - 1) xor V;
+    end process;
+
+end architecture;
+
+-------------------------------------------------------------------------------
+
+entity memo1 is
+end entity;
+
+architecture test of memo1 is
+    signal x : bit_vector(7 downto 0);
+    signal o1, o2, o3, o4 : bit;
+begin
+
+    u1: entity work.sub
+        generic map ( 4 )
+        port map ( x(3 downto 0), o1 );
+
+    u2: entity work.sub
+        generic map ( N => 4 )
+        port map ( i => x(7 downto 4), o => o2 );
+
+    u3: entity work.sub
+        generic map ( 8, '1' )
+        port map ( x, o3 );
+
+    u4: entity work.sub
+        generic map ( 4 )
+        port map ( "0101", o4 );
+
+end architecture;
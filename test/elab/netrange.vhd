@@ -0,0 +1,29 @@
+entity sub is
+    port ( p : in bit_vector(7 downto 0);
+           q : in bit_vector(3 downto 0) );
+end entity;
+
+architecture test of sub is
+begin
+end architecture;
+
+entity netrange is
+end entity;
+
+architecture test of netrange is
+    type rec is record
+        x : bit_vector(7 downto 0);
+        y : bit;
+    end record;
+
+    signal v : bit_vector(15 downto 0);
+    signal r : rec;
+begin
+
+    u: entity work.sub
+        port map (
+            p(7 downto 4) => v(15 downto 12),
+            p(3 downto 0) => r.x(3 downto 0),
+            q             => v(3 downto 0) );
+
+end architecture;
@@ -0,0 +1,16 @@
+entity signal15 is
+end entity;
+
+architecture test of signal15 is
+    signal s : bit_vector(0 to 3);
+    signal x : bit;
+begin
+
+    process is
+        variable v : bit_vector(1 to 4);
+    begin
+        (s(1), s(2), s(3), x) <= v;
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,26 @@
+package vcodeopt is
+end package;
+
+package body vcodeopt is
+
+    type int_vector is array (natural range <>) of integer;
+
+    function cse(a : int_vector; n : integer) return integer is
+        variable r : integer := a'length;
+    begin
+        if n > 0 then
+            r := a'length;
+        end if;
+        return r + a'length;
+    end function;
+
+    function narrow(x : integer) return natural is
+        variable n : natural := 0;
+    begin
+        if x >= 0 then
+            n := x;
+        end if;
+        return n;
+    end function;
+
+end package body;
@@ -0,0 +1,467 @@
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <libgen.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stddef.h>
+
+#ifdef __MINGW32__
+#define realpath(N, R) _fullpath((R), (N), _MAX_PATH)
+#define setenv(x, y, z) _putenv_s((x), (y))
+#else
+#include <sys/resource.h>
+#include <sys/wait.h>
+#endif
+
+// End-to-end performance suite: analyses, elaborates and runs each of
+// the designs in test/perf and records the cost of every phase. The
+// results can be compared against an earlier run to catch regressions.
+
+#define MAX_ARGS  32
+#define DEF_THRESH 10.0
+
+typedef struct {
+   const char *name;
+   const char *generics;
+   const char *quick;     // Replaces generics with --quick
+   bool        vhpi;
+} perf_design_t;
+
+typedef struct {
+   double analyse_ms;
+   double elab_ms;
+   double run_ms;
+   double events_per_sec;
+   double peak_rss_kb;
+   long   events;
+} perf_result_t;
+
+typedef enum { HIGHER_WORSE, LOWER_WORSE } direction_t;
+
+typedef struct {
+   const char  *key;
+   size_t       offset;
+   direction_t  direction;
+   double       floor;     // Differences smaller than this are noise
+} perf_metric_t;
+
+static const perf_design_t designs[] = {
+   { "clocks",   "-gDOMAINS=4 -gDEPTH=128", "-gDEPTH=16 -gCYCLES=200", false },
+   { "datapath", "-gWIDTH=1024 -gSTAGES=8", "-gWIDTH=64 -gCYCLES=200", false },
+   { "tristate", "-gWIDTH=32 -gDRIVERS=8",  "-gCYCLES=200",            false },
+   { "stimulus", "-gLINES=100000",          "-gLINES=200",             false },
+   { "genarray", "-gROWS=32 -gCOLS=32",     "-gROWS=4 -gCOLS=4",       false },
+   { "cosim",    "-gCYCLES=100000",         "-gCYCLES=200",            true },
+};
+
+#define METRIC(name, dir, floor) \
+   { #name, offsetof(perf_result_t, name), dir, floor }
+
+static const perf_metric_t metrics[] = {
+   METRIC(analyse_ms,     HIGHER_WORSE, 5.0),
+   METRIC(elab_ms,        HIGHER_WORSE, 5.0),
+   METRIC(run_ms,         HIGHER_WORSE, 5.0),
+   METRIC(events_per_sec, LOWER_WORSE,  0.0),
+   METRIC(peak_rss_kb,    HIGHER_WORSE, 1024.0),
+};
+
+static char  bin_dir[PATH_MAX];
+static char  test_dir[PATH_MAX];
+static int   repeat = 3;
+static bool  quick = false;
+
+static double *metric_ptr(perf_result_t *r, const perf_metric_t *m)
+{
+   return (double *)((char *)r + m->offset);
+}
+
+static void push_args(char **argv, int *argc, const char *args)
+{
+   // Splits at spaces which is enough for the generic lists above
+   char *copy = xstrdup(args);
+   for (char *tok = strtok(copy, " "); tok; tok = strtok(NULL, " ")) {
+      if (*argc == MAX_ARGS - 1)
+         fatal_trace("too many arguments");
+      argv[(*argc)++] = xstrdup(tok);
+   }
+   free(copy);
+}
+
+static void free_args(char **argv, int argc)
+{
+   for (int i = 0; i < argc; i++)
+      free(argv[i]);
+}
+
+static double run_cmd(const char *name, char **argv, int argc,
+                      double *rss)
+{
+   // Returns the wall clock time of the command in milliseconds after
+   // updating the peak resident set size of any child so far
+
+   argv[argc] = NULL;
+
+   fflush(stdout);
+   fflush(stderr);
+
+   const uint64_t start = get_timestamp_us();
+
+#ifdef __MINGW32__
+   LOCAL_TEXT_BUF tb = tb_new();
+   for (int i = 0; i < argc; i++)
+      tb_printf(tb, "%s\"%s\"", i > 0 ? " " : "", argv[i]);
+   tb_printf(tb, " >> out 2>&1");
+
+   if (system(tb_get(tb)) != 0)
+      fatal("%s failed: see perf" PATH_SEP "%s" PATH_SEP "out", argv[0],
+            name);
+#else
+   pid_t pid = fork();
+   if (pid < 0)
+      fatal_errno("fork");
+   else if (pid == 0) {
+      int fd = open("out", O_WRONLY | O_CREAT | O_APPEND, 0666);
+      if (fd != -1) {
+         dup2(fd, STDOUT_FILENO);
+         dup2(fd, STDERR_FILENO);
+      }
+
+      execv(argv[0], argv);
+      fprintf(stderr, "exec failed: %s\n", strerror(errno));
+      _exit(EXIT_FAILURE);
+   }
+
+   int status;
+   struct rusage ru;
+   if (wait4(pid, &status, 0, &ru) < 0)
+      fatal_errno("wait4");
+
+   if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      fatal("%s %s failed: see perf" PATH_SEP "%s" PATH_SEP "out", argv[0],
+            argv[1], name);
+
+#ifdef __APPLE__
+   const long maxrss = ru.ru_maxrss / 1024;
+#else
+   const long maxrss = ru.ru_maxrss;
+#endif
+   *rss = MAX(*rss, (double)maxrss);
+#endif
+
+   return (get_timestamp_us() - start) / 1000.0;
+}
+
+static long stats_count(const char *text, const char *key)
+{
+   char *pattern LOCAL = xasprintf("\"%s\": ", key);
+   const char *p = strstr(text, pattern);
+   if (p == NULL)
+      fatal("missing %s in kernel statistics", key);
+
+   return strtol(p + strlen(pattern), NULL, 10);
+}
+
+static long read_events(const perf_design_t *d)
+{
+   FILE *f = fopen("stats.json", "r");
+   if (f == NULL)
+      fatal_errno("failed to open perf" PATH_SEP "%s" PATH_SEP "stats.json",
+                  d->name);
+
+   char text[4096];
+   const size_t n = fread(text, 1, sizeof(text) - 1, f);
+   text[n] = '\0';
+   fclose(f);
+
+   return stats_count(text, "timeout") + stats_count(text, "driver")
+      + stats_count(text, "process");
+}
+
+static void run_design(const perf_design_t *d, perf_result_t *r)
+{
+   make_dir(d->name);
+   if (chdir(d->name) != 0)
+      fatal_errno("failed to change to perf" PATH_SEP "%s", d->name);
+
+   remove("out");
+
+   char *nvc LOCAL = xasprintf("%s" PATH_SEP "nvc%s", bin_dir, EXEEXT);
+   char *plugin LOCAL = xasprintf("%s" PATH_SEP ".." PATH_SEP "lib"
+                                  PATH_SEP "%s.so", bin_dir, d->name);
+
+   memset(r, '\0', sizeof(perf_result_t));
+   r->analyse_ms = r->elab_ms = r->run_ms = INFINITY;
+
+   // Take the fastest of each phase as the least disturbed by other
+   // activity on the machine
+
+   for (int i = 0; i < repeat; i++) {
+      char *argv[MAX_ARGS];
+      int argc = 0;
+
+      argv[argc++] = xstrdup(nvc);
+      argv[argc++] = xstrdup("-a");
+      argv[argc++] = xasprintf("%s" PATH_SEP "perf" PATH_SEP "%s.vhd",
+                               test_dir, d->name);
+      const double analyse = run_cmd(d->name, argv, argc, &r->peak_rss_kb);
+      free_args(argv, argc);
+      r->analyse_ms = MIN(r->analyse_ms, analyse);
+
+      argc = 0;
+      argv[argc++] = xstrdup(nvc);
+      argv[argc++] = xstrdup("-e");
+      argv[argc++] = xstrdup(d->name);
+      push_args(argv, &argc, quick ? d->quick : d->generics);
+      const double elab = run_cmd(d->name, argv, argc, &r->peak_rss_kb);
+      free_args(argv, argc);
+      r->elab_ms = MIN(r->elab_ms, elab);
+
+      argc = 0;
+      argv[argc++] = xstrdup(nvc);
+      argv[argc++] = xstrdup("-r");
+      argv[argc++] = xstrdup("--stats-json=stats.json");
+      if (d->vhpi)
+         argv[argc++] = xasprintf("--load=%s", plugin);
+      argv[argc++] = xstrdup(d->name);
+      const double run = run_cmd(d->name, argv, argc, &r->peak_rss_kb);
+      free_args(argv, argc);
+      r->run_ms = MIN(r->run_ms, run);
+   }
+
+   r->events = read_events(d);
+   r->events_per_sec = r->events * 1000.0 / MAX(r->run_ms, 0.001);
+
+   if (chdir("..") != 0)
+      fatal_errno("chdir");
+}
+
+static void print_result(FILE *f, const char *name, const perf_result_t *r,
+                         bool first)
+{
+   // Each design is written on a single line which is all the baseline
+   // reader below depends on
+   fprintf(f, "%s\n    { \"name\": \"%s\", \"analyse_ms\": %.1f, "
+           "\"elab_ms\": %.1f, \"run_ms\": %.1f, \"events\": %ld, "
+           "\"events_per_sec\": %.0f, \"peak_rss_kb\": %.0f }",
+           first ? "" : ",", name, r->analyse_ms, r->elab_ms, r->run_ms,
+           r->events, r->events_per_sec, r->peak_rss_kb);
+}
+
+static bool parse_baseline(const char *file, const char *name,
+                           perf_result_t *r, bool *was_quick)
+{
+   FILE *f = fopen(file, "r");
+   if (f == NULL)
+      fatal_errno("failed to open %s", file);
+
+   char *want LOCAL = xasprintf("\"name\": \"%s\",", name);
+
+   bool found = false;
+   char line[1024];
+   while (!found && fgets(line, sizeof(line), f) != NULL) {
+      if (strstr(line, "\"quick\": true") != NULL)
+         *was_quick = true;
+
+      if (strstr(line, want) == NULL)
+         continue;
+
+      for (size_t i = 0; i < ARRAY_LEN(metrics); i++) {
+         char *pattern LOCAL = xasprintf("\"%s\": ", metrics[i].key);
+         const char *p = strstr(line, pattern);
+         if (p == NULL)
+            fatal("%s: missing %s for %s", file, metrics[i].key, name);
+
+         *metric_ptr(r, &(metrics[i])) = strtod(p + strlen(pattern), NULL);
+      }
+
+      found = true;
+   }
+
+   fclose(f);
+   return found;
+}
+
+static int compare(const char *file, const char *name, perf_result_t *r,
+                   double threshold)
+{
+   perf_result_t base;
+   bool was_quick = false;
+   if (!parse_baseline(file, name, &base, &was_quick)) {
+      fprintf(stderr, "%10s : not in baseline\n", name);
+      return 0;
+   }
+
+   if (was_quick != quick)
+      fatal("%s was recorded %s --quick", file,
+            was_quick ? "with" : "without");
+
+   int regressions = 0;
+   for (size_t i = 0; i < ARRAY_LEN(metrics); i++) {
+      const perf_metric_t *m = &(metrics[i]);
+      const double old = *metric_ptr(&base, m);
+      const double new = *metric_ptr(r, m);
+
+      bool worse;
+      if (m->direction == HIGHER_WORSE)
+         worse = new > old * (1.0 + threshold / 100.0)
+            && new - old > m->floor;
+      else
+         worse = new < old * (1.0 - threshold / 100.0);
+
+      if (worse) {
+         const double change = old > 0.0 ? (new - old) * 100.0 / old : 0.0;
+         fprintf(stderr, "%10s : %s regressed from %.1f to %.1f (%+.1f%%)\n",
+                 name, m->key, old, new, change);
+         regressions++;
+      }
+   }
+
+   return regressions;
+}
+
+static void usage(const char *argv0)
+{
+   printf("Usage: %s [OPTION]... [NAME]...\n"
+          "\n"
+          "Run the designs from test/perf whose names are given, or all\n"
+          "of them if none are.\n"
+          "\n"
+          " -b, --baseline=FILE\tFail if results regress against FILE\n"
+          " -o, --output=FILE\tWrite results to FILE instead of stdout\n"
+          " -q, --quick\t\tRun small versions of each design\n"
+          " -r, --repeat=N\t\tTime each phase N times (default 3)\n"
+          " -t, --threshold=PCT\tAllowed regression (default %.0f%%)\n",
+          argv0, DEF_THRESH);
+}
+
+int main(int argc, char **argv)
+{
+   static struct option long_options[] = {
+      { "baseline",  required_argument, 0, 'b' },
+      { "output",    required_argument, 0, 'o' },
+      { "quick",     no_argument,       0, 'q' },
+      { "repeat",    required_argument, 0, 'r' },
+      { "threshold", required_argument, 0, 't' },
+      { "help",      no_argument,       0, 'h' },
+      { 0, 0, 0, 0 }
+   };
+
+   const char *output = NULL, *baseline = NULL;
+   double threshold = DEF_THRESH;
+   int c, index = 0;
+   while ((c = getopt_long(argc, argv, "b:o:qr:t:h", long_options,
+                           &index)) != -1) {
+      switch (c) {
+      case 'b':
+         baseline = optarg;
+         break;
+      case 'o':
+         output = optarg;
+         break;
+      case 'q':
+         quick = true;
+         break;
+      case 'r':
+         if ((repeat = atoi(optarg)) <= 0)
+            fatal("invalid repeat count %s", optarg);
+         break;
+      case 't':
+         if ((threshold = strtod(optarg, NULL)) <= 0.0)
+            fatal("invalid threshold %s", optarg);
+         break;
+      case 'h':
+         usage(argv[0]);
+         return EXIT_SUCCESS;
+      default:
+         usage(argv[0]);
+         return EXIT_FAILURE;
+      }
+   }
+
+   if (realpath(TESTDIR, test_dir) == NULL)
+      fatal_errno("failed to get real path for %s", TESTDIR);
+
+   char argv0_path[PATH_MAX];
+   if (realpath(argv[0], argv0_path) == NULL)
+      fatal_errno("failed to get real path for %s", argv[0]);
+   strncpy(bin_dir, dirname(argv0_path), sizeof(bin_dir) - 1);
+
+   char *lib_dir LOCAL = xasprintf("%s" PATH_SEP ".." PATH_SEP "lib",
+                                   bin_dir);
+
+   setenv("NVC_IMP_LIB", lib_dir, 1);
+   setenv("NVC_LIBPATH", lib_dir, 1);
+
+   char *baseline_path LOCAL = NULL;
+   if (baseline != NULL) {
+      // The baseline is read after changing directory below
+      char tmp[PATH_MAX];
+      if (realpath(baseline, tmp) == NULL)
+         fatal_errno("failed to get real path for %s", baseline);
+      baseline_path = xstrdup(tmp);
+   }
+
+   FILE *json = stdout;
+   if (output != NULL && (json = fopen(output, "w")) == NULL)
+      fatal_errno("failed to create %s", output);
+
+   make_dir("perf");
+   if (chdir("perf") != 0)
+      fatal_errno("failed to change to perf directory");
+
+   fprintf(json, "{\n  \"repeat\": %d,\n  \"quick\": %s,\n"
+           "  \"designs\": [", repeat, quick ? "true" : "false");
+
+   bool first = true;
+   int regressions = 0;
+   for (size_t i = 0; i < ARRAY_LEN(designs); i++) {
+      const perf_design_t *d = &(designs[i]);
+
+      bool selected = (optind == argc);
+      for (int j = optind; j < argc; j++)
+         selected |= (strcmp(argv[j], d->name) == 0);
+
+      if (!selected)
+         continue;
+
+#ifndef ENABLE_VHPI
+      if (d->vhpi) {
+         fprintf(stderr, "%10s : skipped without VHPI\n", d->name);
+         continue;
+      }
+#endif
+
+      perf_result_t r;
+      run_design(d, &r);
+
+      fprintf(stderr, "%10s : analyse %.1f ms, elab %.1f ms, run %.1f ms, "
+              "%.0f events/s, %.0f kB\n", d->name, r.analyse_ms, r.elab_ms,
+              r.run_ms, r.events_per_sec, r.peak_rss_kb);
+
+      print_result(json, d->name, &r, first);
+      first = false;
+
+      if (baseline_path != NULL)
+         regressions += compare(baseline_path, d->name, &r, threshold);
+   }
+
+   fprintf(json, "%s]\n}\n", first ? "" : "\n  ");
+
+   if (json != stdout)
+      fclose(json);
+
+   if (regressions > 0) {
+      fprintf(stderr, "%d metric%s regressed by more than %.0f%%\n",
+              regressions, regressions > 1 ? "s" : "", threshold);
+      return EXIT_FAILURE;
+   }
+
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,49 @@
+entity clocks is
+    generic ( DOMAINS : positive := 4;
+              DEPTH   : positive := 128;
+              CYCLES  : positive := 20000 );
+end entity;
+
+architecture perf of clocks is
+
+    type int_vector is array (natural range <>) of integer;
+
+    signal clk  : bit_vector(1 to DOMAINS) := (others => '0');
+    signal regs : int_vector(0 to DOMAINS * DEPTH - 1) := (others => 0);
+
+begin
+
+    -- Each domain runs at a different period so edges rarely coincide
+    -- and registers in one domain sample values from another
+
+    domain: for d in 1 to DOMAINS generate
+
+        clkgen: process is
+        begin
+            for j in 1 to CYCLES / d loop
+                clk(d) <= '1';
+                wait for d * 1 ns;
+                clk(d) <= '0';
+                wait for d * 1 ns;
+            end loop;
+            wait;
+        end process;
+
+        reg: for r in 0 to DEPTH - 1 generate
+            constant idx : natural := (d - 1) * DEPTH + r;
+        begin
+            process (clk(d)) is
+            begin
+                if clk(d)'event and clk(d) = '1' then
+                    if idx = 0 then
+                        regs(idx) <= (regs(regs'right) + 1) mod 4096;
+                    else
+                        regs(idx) <= (regs(idx - 1) + r) mod 4096;
+                    end if;
+                end if;
+            end process;
+        end generate;
+
+    end generate;
+
+end architecture;
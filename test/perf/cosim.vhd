@@ -0,0 +1,23 @@
+entity cosim is
+    generic ( CYCLES : positive := 100000 );
+end entity;
+
+architecture perf of cosim is
+    signal stim   : integer := 0;
+    signal result : integer := 0;
+    signal done   : bit := '0';
+begin
+
+    -- The foreign model in test/vhpi/cosim.c drives stim every
+    -- nanosecond and checks result until done is set
+
+    result <= stim * 3 + 1;
+
+    process is
+    begin
+        wait for CYCLES * 1 ns;
+        done <= '1';
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,49 @@
+entity datapath is
+    generic ( WIDTH  : positive := 1024;
+              STAGES : positive := 8;
+              CYCLES : positive := 50000 );
+end entity;
+
+architecture perf of datapath is
+
+    subtype word is bit_vector(WIDTH - 1 downto 0);
+    type word_array is array (0 to STAGES) of word;
+
+    signal clk   : bit := '0';
+    signal stage : word_array := (others => (others => '0'));
+
+begin
+
+    clkgen: process is
+    begin
+        for j in 1 to CYCLES loop
+            clk <= '1';
+            wait for 1 ns;
+            clk <= '0';
+            wait for 1 ns;
+        end loop;
+        wait;
+    end process;
+
+    input: process (clk) is
+        variable lfsr : word := (0 => '1', others => '0');
+    begin
+        if clk'event and clk = '1' then
+            lfsr := lfsr(WIDTH - 2 downto 0)
+                    & (lfsr(WIDTH - 1) xor lfsr(WIDTH / 2));
+            stage(0) <= lfsr;
+        end if;
+    end process;
+
+    pipe: for i in 1 to STAGES generate
+        process (clk) is
+            variable prev : word;
+        begin
+            if clk'event and clk = '1' then
+                prev := stage(i - 1);
+                stage(i) <= prev xor (prev(0) & prev(WIDTH - 1 downto 1));
+            end if;
+        end process;
+    end generate;
+
+end architecture;
@@ -0,0 +1,60 @@
+entity cell is
+    generic ( ROW, COL : natural );
+    port ( clk   : in bit;
+           north : in integer;
+           west  : in integer;
+           o     : out integer );
+end entity;
+
+architecture perf of cell is
+begin
+
+    process (clk) is
+    begin
+        if clk'event and clk = '1' then
+            o <= (north + west + ROW * COL) mod 1024;
+        end if;
+    end process;
+
+end architecture;
+
+-------------------------------------------------------------------------------
+
+entity genarray is
+    generic ( ROWS   : positive := 32;
+              COLS   : positive := 32;
+              CYCLES : positive := 100 );
+end entity;
+
+architecture perf of genarray is
+
+    type grid_t is array (0 to ROWS, 0 to COLS) of integer;
+
+    signal clk  : bit := '0';
+    signal grid : grid_t := (others => (others => 1));
+
+begin
+
+    -- Most of the cost is in elaborating the instance array: the run is
+    -- kept short
+
+    clkgen: process is
+    begin
+        for j in 1 to CYCLES loop
+            clk <= '1';
+            wait for 1 ns;
+            clk <= '0';
+            wait for 1 ns;
+        end loop;
+        wait;
+    end process;
+
+    row_g: for r in 1 to ROWS generate
+        col_g: for c in 1 to COLS generate
+            u: entity work.cell
+                generic map ( r, c )
+                port map ( clk, grid(r - 1, c), grid(r, c - 1), grid(r, c) );
+        end generate;
+    end generate;
+
+end architecture;
@@ -0,0 +1,55 @@
+use std.textio.all;
+
+entity stimulus is
+    generic ( LINES : positive := 100000 );
+end entity;
+
+architecture perf of stimulus is
+    signal value : integer := 0;
+    signal bits  : bit_vector(15 downto 0);
+begin
+
+    -- Write a stimulus file and then replay it one line per clock as a
+    -- testbench reading test vectors would
+
+    process is
+        file f       : text;
+        variable l   : line;
+        variable n   : integer;
+        variable bv  : bit_vector(15 downto 0);
+        variable tag : string(1 to 4);
+    begin
+        file_open(f, "stimulus.txt", WRITE_MODE);
+        for i in 1 to LINES loop
+            n := (i * 7919) mod 65536;
+            for b in bv'range loop
+                if (n / (2 ** b)) mod 2 = 1 then
+                    bv(b) := '1';
+                else
+                    bv(b) := '0';
+                end if;
+            end loop;
+            write(l, string'("vec "));
+            write(l, n);
+            write(l, ' ');
+            write(l, bv);
+            writeline(f, l);
+        end loop;
+        file_close(f);
+
+        file_open(f, "stimulus.txt", READ_MODE);
+        while not endfile(f) loop
+            readline(f, l);
+            read(l, tag);
+            read(l, n);
+            read(l, bv);
+            value <= n;
+            bits  <= bv;
+            wait for 1 ns;
+        end loop;
+        file_close(f);
+
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,74 @@
+entity tristate is
+    generic ( WIDTH   : positive := 32;
+              DRIVERS : positive := 8;
+              CYCLES  : positive := 100000 );
+end entity;
+
+architecture perf of tristate is
+
+    type tri is ('0', '1', 'Z', 'X');
+    type tri_vector is array (natural range <>) of tri;
+
+    function resolve (v : tri_vector) return tri is
+        variable result : tri := 'Z';
+    begin
+        for i in v'range loop
+            if v(i) /= 'Z' then
+                if result = 'Z' then
+                    result := v(i);
+                elsif result /= v(i) then
+                    result := 'X';
+                end if;
+            end if;
+        end loop;
+        return result;
+    end function;
+
+    subtype rtri is resolve tri;
+    type rtri_vector is array (natural range <>) of rtri;
+
+    function encode (n : natural) return rtri_vector is
+        variable result : rtri_vector(WIDTH - 1 downto 0);
+        variable x      : natural := n;
+    begin
+        for i in result'reverse_range loop
+            if x mod 2 = 1 then
+                result(i) := '1';
+            else
+                result(i) := '0';
+            end if;
+            x := x / 2;
+        end loop;
+        return result;
+    end function;
+
+    signal bus_s : rtri_vector(WIDTH - 1 downto 0);
+
+begin
+
+    -- The drivers take turns owning the bus and release it otherwise
+
+    drive: for i in 0 to DRIVERS - 1 generate
+        process is
+        begin
+            for j in 0 to CYCLES - 1 loop
+                if j mod DRIVERS = i then
+                    bus_s <= encode(j mod 65536);
+                else
+                    bus_s <= (others => 'Z');
+                end if;
+                wait for 1 ns;
+            end loop;
+            bus_s <= (others => 'Z');
+            wait;
+        end process;
+    end generate;
+
+    check: process (bus_s) is
+    begin
+        for i in bus_s'range loop
+            assert bus_s(i) /= 'X' report "bus contention";
+        end loop;
+    end process;
+
+end architecture;
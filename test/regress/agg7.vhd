@@ -0,0 +1,57 @@
+entity agg7 is
+end entity;
+
+architecture test of agg7 is
+    type int_vec is array (natural range <>) of integer;
+    subtype table_t is int_vec(0 to 63);
+
+    type config_t is record
+        name  : string(1 to 4);
+        table : table_t;
+        flag  : boolean;
+    end record;
+
+    constant cfg : config_t := (
+        name  => "abcd",
+        table => (0 => 5, 1 => 6, 63 => 7, others => 1),
+        flag  => true );
+
+    function make(x, y : integer) return int_vec is
+        variable v : int_vec(1 to 8);
+    begin
+        v := (1 => x, 2 => 2, 3 => y, 8 => x + y, others => 0);
+        return v;
+    end function;
+
+    signal s : int_vec(0 to 3) := (others => 0);
+begin
+
+    process is
+        variable c : config_t;
+        variable v : int_vec(1 to 8);
+        variable b : bit_vector(1 to 5);
+        variable x : bit;
+    begin
+        c := cfg;
+        assert c.name = "abcd";
+        assert c.table(0) = 5 and c.table(1) = 6 and c.table(63) = 7;
+        assert c.table(2) = 1 and c.table(62) = 1;
+        assert c.flag;
+
+        v := make(3, 4);
+        assert v = (3, 2, 4, 0, 0, 0, 0, 7);
+
+        x := '1';
+        b := (2 => x, 4 => not x, others => '0');
+        assert b = "01000";
+        b := (x, '0', x, '1', not x);
+        assert b = "10110";
+
+        s <= (1 => v(1), others => 9);
+        wait for 1 ns;
+        assert s = (9, 3, 9, 9);
+
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,100 @@
+entity bitvec2 is
+end entity;
+
+architecture test of bitvec2 is
+
+    -- Long enough to cover several whole words and a partial word
+    constant N : integer := 37;
+
+    function pattern(seed : integer) return bit_vector is
+        variable r : bit_vector(1 to N);
+        variable x : integer := seed;
+    begin
+        for i in r'range loop
+            x := (x * 17 + 5) mod 23;
+            if x > 11 then
+                r(i) := '1';
+            end if;
+        end loop;
+        return r;
+    end function;
+
+    signal a : bit_vector(1 to N);
+    signal b : bit_vector(1 to N);
+
+begin
+
+    process is
+        variable r : bit_vector(1 to N);
+    begin
+        a <= pattern(3);
+        b <= pattern(8);
+        wait for 1 ns;
+
+        r := a and b;
+        for i in r'range loop
+            assert r(i) = (a(i) and b(i)) report "and" & integer'image(i);
+        end loop;
+
+        r := a or b;
+        for i in r'range loop
+            assert r(i) = (a(i) or b(i)) report "or" & integer'image(i);
+        end loop;
+
+        r := a xor b;
+        for i in r'range loop
+            assert r(i) = (a(i) xor b(i)) report "xor" & integer'image(i);
+        end loop;
+
+        r := a nand b;
+        for i in r'range loop
+            assert r(i) = (a(i) nand b(i)) report "nand" & integer'image(i);
+        end loop;
+
+        r := a nor b;
+        for i in r'range loop
+            assert r(i) = (a(i) nor b(i)) report "nor" & integer'image(i);
+        end loop;
+
+        r := a xnor b;
+        for i in r'range loop
+            assert r(i) = (a(i) xnor b(i)) report "xnor" & integer'image(i);
+        end loop;
+
+        r := not a;
+        for i in r'range loop
+            assert r(i) = (not a(i)) report "not" & integer'image(i);
+        end loop;
+
+        for s in 1 - N to N - 1 loop
+            r := a sll s;
+            for i in r'range loop
+                if i + s >= 1 and i + s <= N then
+                    assert r(i) = a(i + s) report "sll" & integer'image(s);
+                else
+                    assert r(i) = '0' report "sll" & integer'image(s);
+                end if;
+            end loop;
+
+            r := a rol s;
+            for i in r'range loop
+                assert r(i) = a((i - 1 + s + N) rem N + 1)
+                    report "rol" & integer'image(s);
+            end loop;
+
+            r := a sra s;
+            for i in r'range loop
+                if i - s >= 1 and i - s <= N then
+                    assert r(i) = a(i - s) report "sra" & integer'image(s);
+                elsif s > 0 then
+                    assert r(i) = a(1) report "sra" & integer'image(s);
+                else
+                    assert r(i) = a(N) report "sra" & integer'image(s);
+                end if;
+            end loop;
+        end loop;
+
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,35 @@
+package pack is
+    shared variable counter : integer := 10;
+    function twice (x : integer) return integer;
+end package;
+
+package body pack is
+    function twice (x : integer) return integer is
+    begin
+        return x * 2;
+    end function;
+end package body;
+
+-------------------------------------------------------------------------------
+
+use work.pack.all;
+use std.textio.all;
+
+entity bundle1 is
+end entity;
+
+architecture test of bundle1 is
+begin
+
+    process is
+        variable l : line;
+    begin
+        counter := counter + 1;
+        assert twice(counter) = 22;
+        write(l, string'("hello"));
+        assert l.all = "hello";
+        deallocate(l);
+        wait;
+    end process;
+
+end architecture;
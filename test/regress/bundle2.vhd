@@ -0,0 +1,44 @@
+package pack is
+    type int_vec is array (natural range <>) of integer;
+    function sum (v : int_vec) return integer;
+    subtype rint is sum integer;
+    signal s : rint := 0;
+end package;
+
+package body pack is
+    function sum (v : int_vec) return integer is
+        variable r : integer := 0;
+    begin
+        for i in v'range loop
+            r := r + v(i);
+        end loop;
+        return r;
+    end function;
+end package body;
+
+-------------------------------------------------------------------------------
+
+use work.pack.all;
+
+entity bundle2 is
+end entity;
+
+architecture test of bundle2 is
+    signal t : rint := 0;
+begin
+
+    d1: t <= 1;
+    d2: t <= 2;
+    d3: s <= 5;
+    d4: s <= 6;
+
+    check: process is
+    begin
+        wait for 1 ns;
+        assert t = 3;
+        assert s = 11;
+        report "done";
+        wait;
+    end process;
+
+end architecture;
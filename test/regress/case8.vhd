@@ -0,0 +1,119 @@
+entity case8 is
+end entity;
+
+architecture test of case8 is
+
+    type ulogic is ('U', 'X', '0', '1', 'Z', 'W', 'L', 'H', '-');
+    type ulogic_vector is array (natural range <>) of ulogic;
+
+    -- Constant assignments on a short bit vector become a table
+    function popcount(x : bit_vector(3 downto 0)) return natural is
+        variable r : natural;
+    begin
+        case x is
+            when "0000" => r := 0;
+            when "0001" | "0010" | "0100" | "1000" => r := 1;
+            when "1111" => r := 4;
+            when "0111" | "1011" | "1101" | "1110" => r := 3;
+            when others => r := 2;
+        end case;
+        return r;
+    end function;
+
+    -- Too many keys for a table so this is a single switch
+    function decode(x : ulogic_vector(7 downto 0)) return integer is
+        variable r : integer;
+    begin
+        case x is
+            when "00000000" => r := 0;
+            when "0000000Z" => r := -1;
+            when "11111111" =>
+                r := 255;
+                report "all ones";
+            when "1010XXXX" => r := -2;
+            when others =>
+                r := 0;
+                for i in x'range loop
+                    if x(i) = '1' then
+                        r := r + 2 ** i;
+                    end if;
+                end loop;
+        end case;
+        return r;
+    end function;
+
+    subtype nibble is integer range 0 to 15;
+
+    function to_hex(n : nibble) return character is
+        variable c : character;
+    begin
+        case n is
+            when 0 to 9 => c := character'val(character'pos('0') + n);
+            when 10 => c := 'a';
+            when 11 => c := 'b';
+            when 12 => c := 'c';
+            when 13 => c := 'd';
+            when 14 => c := 'e';
+            when 15 => c := 'f';
+        end case;
+        return c;
+    end function;
+
+    function is_vowel(c : character) return boolean is
+        variable r : boolean;
+    begin
+        case c is
+            when 'a' | 'e' | 'i' | 'o' | 'u' => r := true;
+            when others => r := false;
+        end case;
+        return r;
+    end function;
+
+    signal s : ulogic_vector(7 downto 0);
+
+begin
+
+    process is
+        variable v : bit_vector(3 downto 0);
+        variable n : natural;
+    begin
+        for i in 0 to 15 loop
+            v := "0000";
+            n := 0;
+            for j in 0 to 3 loop
+                if (i / 2 ** j) mod 2 = 1 then
+                    v(j) := '1';
+                    n := n + 1;
+                end if;
+            end loop;
+            assert popcount(v) = n;
+        end loop;
+
+        s <= "00000000";
+        wait for 1 ns;
+        assert decode(s) = 0;
+        s <= "0000000Z";
+        wait for 1 ns;
+        assert decode(s) = -1;
+        s <= "11111111";
+        wait for 1 ns;
+        assert decode(s) = 255;
+        s <= "1010XXXX";
+        wait for 1 ns;
+        assert decode(s) = -2;
+        s <= "01000011";
+        wait for 1 ns;
+        assert decode(s) = 67;
+
+        assert to_hex(0) = '0';
+        assert to_hex(7) = '7';
+        assert to_hex(10) = 'a';
+        assert to_hex(15) = 'f';
+
+        assert is_vowel('e');
+        assert not is_vowel('z');
+
+        wait;
+    end process;
+
+end architecture;
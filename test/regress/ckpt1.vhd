@@ -0,0 +1,44 @@
+entity ckpt1 is
+end entity;
+
+architecture test of ckpt1 is
+    signal clk   : bit := '0';
+    signal count : integer := 0;
+    signal v     : bit_vector(7 downto 0) := X"01";
+begin
+
+    clk <= not clk after 5 ns;
+
+    counter: process (clk) is
+    begin
+        if clk'event and clk = '1' then
+            count <= count + 1;
+            v <= v(6 downto 0) & v(7);
+        end if;
+    end process;
+
+    check: process is
+        variable sum : integer := 0;
+    begin
+        wait for 1 ns;
+        for i in 1 to 12 loop
+            wait until count'event;
+            sum := sum + count;
+            report "count=" & integer'image(count)
+                & " sum=" & integer'image(sum);
+        end loop;
+        wait;
+    end process;
+
+    slice: process is
+        variable n : integer := 0;
+    begin
+        wait on v(3 downto 2);
+        n := n + 1;
+        if n mod 4 = 0 then
+            report "slice events " & integer'image(n)
+                & " v=" & integer'image(count);
+        end if;
+    end process;
+
+end architecture;
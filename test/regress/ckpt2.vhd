@@ -0,0 +1,36 @@
+entity ckpt2 is
+end entity;
+
+architecture test of ckpt2 is
+    -- Wider than one library block so each saved value spans several
+    signal v : bit_vector(1 to 1000000) := (others => '0');
+begin
+
+    update: process is
+        variable tmp : bit_vector(v'range) := (others => '0');
+    begin
+        for i in 1 to 10 loop
+            wait for 10 ns;
+            tmp(i * 1000) := '1';
+            tmp(v'right - i) := '1';
+            v <= tmp;
+        end loop;
+        wait;
+    end process;
+
+    check: process is
+        variable count : integer;
+    begin
+        wait for 95 ns;
+        count := 0;
+        for i in v'range loop
+            if v(i) = '1' then
+                count := count + 1;
+            end if;
+        end loop;
+        report "count=" & integer'image(count)
+            & " last=" & bit'image(v(v'right - 9));
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,98 @@
+entity clock1 is
+end entity;
+
+architecture test of clock1 is
+    signal c1    : bit := '0';
+    signal c2    : boolean := false;
+    signal c3    : boolean;
+    signal phase : integer := 0;
+    signal n1    : natural;
+    signal n2    : natural;
+    signal n3    : natural;
+begin
+
+    -- Toggle with a static wait
+    c1 <= not c1 after 5 ns;
+
+    -- Toggle with an explicit wait
+    toggle: process is
+    begin
+        c2 <= not c2 after 2 ns;
+        wait on c2;
+    end process;
+
+    -- Sequence with an uneven duty cycle
+    duty: process is
+    begin
+        c3 <= true;
+        wait for 3 ns;
+        c3 <= false;
+        wait for 7 ns;
+    end process;
+
+    -- Sequence of more than two values
+    steps: process is
+    begin
+        phase <= 1;
+        wait for 1 ns;
+        phase <= 5;
+        wait for 2 ns;
+        phase <= -3;
+        wait for 4 ns;
+    end process;
+
+    count1: process (c1) is
+    begin
+        if c1 = '1' then
+            assert ((now / ns) mod 10) = 5;
+            n1 <= n1 + 1;
+        end if;
+    end process;
+
+    count2: process (c2) is
+    begin
+        if c2 then
+            assert ((now / ns) mod 4) = 2;
+            n2 <= n2 + 1;
+        end if;
+    end process;
+
+    count3: process (c3) is
+    begin
+        if c3'event then
+            if c3 then
+                assert ((now / ns) mod 10) = 0;
+            else
+                assert ((now / ns) mod 10) = 3;
+            end if;
+            n3 <= n3 + 1;
+        end if;
+    end process;
+
+    check: process is
+    begin
+        wait for 1 ns;
+        assert phase = 1;
+        wait for 1 ns;
+        assert phase = 5;
+        wait for 2 ns;
+        assert phase = -3;
+        assert phase'last_event = 1 ns;
+
+        -- Zero delay assignment occurs in the next delta cycle
+        wait for 3 ns;
+        assert phase = -3;
+        wait on phase;
+        assert phase = 1;
+        assert now = 7 ns;
+
+        wait for 993 ns;
+        assert n1 = 100 report integer'image(n1);
+        assert n2 = 250 report integer'image(n2);
+        assert n3 = 200 report integer'image(n3);
+        assert c1'event and c1 = '0';
+        report "done";
+        wait;
+    end process;
+
+end architecture;
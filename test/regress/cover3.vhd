@@ -0,0 +1,46 @@
+entity cover3 is
+end entity;
+
+architecture test of cover3 is
+    signal clk        : bit := '0';
+    signal a, b, c, d : integer := 0;
+begin
+
+    clkgen: process is
+    begin
+        for i in 1 to 10 loop
+            clk <= not clk;
+            wait for 5 ns;
+        end loop;
+        wait;
+    end process;
+
+    p1: process (clk) is
+    begin
+        if clk = '1' then
+            a <= a + 1;
+        end if;
+    end process;
+
+    p2: process (clk) is
+    begin
+        if clk = '1' then
+            b <= b + 2;
+        end if;
+    end process;
+
+    p3: process (clk) is
+    begin
+        if a > 100 then
+            c <= c + 1;
+        end if;
+    end process;
+
+    p4: process (clk) is
+    begin
+        if b > 100 or clk = '0' then
+            d <= d + 1;
+        end if;
+    end process;
+
+end architecture;
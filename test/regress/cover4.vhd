@@ -0,0 +1,26 @@
+entity cover4 is
+end entity;
+
+architecture test of cover4 is
+    signal s : integer;
+begin
+
+    process is
+        variable v : integer;
+    begin
+        v := 1;
+        s <= 2;
+        wait for 1 ns;
+        if s = 2 then
+            v := 3;
+        else
+            v := 2;
+        end if;
+        wait for 1 ns;
+        while v > 0 loop
+            v := v - 1;
+        end loop;
+        wait;
+    end process;
+
+end architecture;
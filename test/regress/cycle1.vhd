@@ -0,0 +1,69 @@
+entity cycle1 is
+end entity;
+
+architecture test of cycle1 is
+    signal clk      : bit := '0';
+    signal cnt      : integer := 0;
+    signal a, b, c  : integer;
+    signal d        : integer;
+    signal e        : boolean;
+    signal p, q     : bit := '0';
+    signal nchanges : integer := 0;
+begin
+
+    clk <= not clk after 5 ns when now < 500 ns;
+
+    counter: process (clk) is
+    begin
+        if clk'event and clk = '1' then
+            cnt <= cnt + 1;
+        end if;
+    end process;
+
+    -- Combinational chain written out of order
+    c <= b - a;
+    b <= a * 2;
+    a <= cnt + 1;
+
+    comb: process (a, c) is
+        variable tmp : integer;
+    begin
+        tmp := a + c;
+        d <= tmp * 3;
+    end process;
+
+    e <= (d mod 2) = 0;
+
+    -- Stable loop left to the event driven kernel
+    p <= q;
+    q <= p or bit'val(cnt / 1000);
+
+    watch: process (d) is
+    begin
+        nchanges <= nchanges + 1;
+    end process;
+
+    check: process (clk) is
+    begin
+        if clk'event and clk = '0' then
+            assert a = cnt + 1;
+            assert b = 2 * a;
+            assert c = a;
+            assert d = 6 * a;
+            assert e;
+            assert p = '0' and q = '0';
+        end if;
+    end process;
+
+    final: process is
+    begin
+        wait for 1 us;
+        assert cnt = 50;
+        assert d = 306;
+        -- D is only updated once after each clock edge rather than
+        -- once for each delta as the chain settles
+        assert nchanges = 52 report integer'image(nchanges);
+        wait;
+    end process;
+
+end architecture;
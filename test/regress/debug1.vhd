@@ -0,0 +1,54 @@
+package debug1_pack is
+   function double(x : integer) return integer;
+   procedure bump(variable x : inout integer);
+end package;
+
+package body debug1_pack is
+   function double(x : integer) return integer is
+   begin
+      return x * 2;
+   end function;
+
+   procedure bump(variable x : inout integer) is
+   begin
+      x := double(x) + 1;
+   end procedure;
+end package body;
+
+-------------------------------------------------------------------------------
+
+entity debug1 is
+end entity;
+
+use work.debug1_pack.all;
+
+architecture test of debug1 is
+   signal s : integer := 0;
+
+   function triple(x : integer) return integer is
+   begin
+      return x * 3;
+   end function;
+begin
+
+   p1: process is
+      variable v : integer := 1;
+   begin
+      bump(v);
+      s <= triple(double(v));
+      wait for 1 ns;
+      bump(v);
+      s <= triple(v);
+      wait;
+   end process;
+
+   p2: process is
+   begin
+      wait on s;
+      assert s = 18;
+      wait on s;
+      assert s = 21;
+      wait;
+   end process;
+
+end architecture;
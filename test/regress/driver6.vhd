@@ -0,0 +1,74 @@
+entity driver6 is
+end entity;
+
+architecture test of driver6 is
+
+    type wire is ('Z', '0', '1', 'X');
+    type wire_vec is array (natural range <>) of wire;
+
+    type wire_table is array (wire, wire) of wire;
+
+    constant wire_res : wire_table := (
+        ( 'Z', '0', '1', 'X' ),
+        ( '0', '0', 'X', 'X' ),
+        ( '1', 'X', '1', 'X' ),
+        ( 'X', 'X', 'X', 'X' ) );
+
+    function resolved(x : wire_vec) return wire is
+        variable r : wire := 'Z';
+    begin
+        for i in x'range loop
+            r := wire_res(r, x(i));
+        end loop;
+        return r;
+    end function;
+
+    -- Commutative but not a fold of the two input case
+    function majority(x : wire_vec) return wire is
+        variable ones, zeros : natural := 0;
+    begin
+        for i in x'range loop
+            if x(i) = '1' then
+                ones := ones + 1;
+            elsif x(i) = '0' then
+                zeros := zeros + 1;
+            end if;
+        end loop;
+        if ones > zeros then
+            return '1';
+        else
+            return '0';
+        end if;
+    end function;
+
+    subtype rwire is resolved wire;
+    subtype mwire is majority wire;
+
+    type rwire_vec is array (natural range <>) of rwire;
+
+    signal bus_s : rwire_vec(1 to 4) := (others => 'Z');
+    signal maj   : mwire;
+
+begin
+
+    d1: bus_s <= "Z01Z", "1Z1Z" after 1 ns, "ZZZZ" after 2 ns;
+    d2: bus_s <= "ZZ1Z", "1ZZ0" after 1 ns, "ZZZZ" after 2 ns;
+    d3: bus_s <= "ZZZZ", "1Z0Z" after 1 ns, "ZZZZ" after 2 ns;
+
+    m1: maj <= '1';
+    m2: maj <= '1';
+    m3: maj <= '0';
+
+    check: process is
+    begin
+        wait for 0 ns;
+        assert bus_s = "Z01Z";
+        assert maj = '1';
+        wait for 1 ns;
+        assert bus_s = "1ZX0";
+        wait for 1 ns;
+        assert bus_s = "ZZZZ";
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,134 @@
+entity driver7 is
+end entity;
+
+architecture test of driver7 is
+
+    type wire is ('Z', '0', '1', 'X');
+    type wire_vec is array (natural range <>) of wire;
+
+    type wire_table is array (wire, wire) of wire;
+
+    constant wire_res : wire_table := (
+        ( 'Z', '0', '1', 'X' ),
+        ( '0', '0', 'X', 'X' ),
+        ( '1', 'X', '1', 'X' ),
+        ( 'X', 'X', 'X', 'X' ) );
+
+    function fold(x : wire_vec) return wire is
+        variable r : wire := 'Z';
+    begin
+        for i in x'range loop
+            r := wire_res(r, x(i));
+        end loop;
+        return r;
+    end function;
+
+    function resolved(x : wire_vec) return wire is
+    begin
+        return fold(x);
+    end function;
+
+    -- Agrees with the fold for up to three drivers but not for four
+    function quad(x : wire_vec) return wire is
+    begin
+        if x'length = 4 and x = (1 to 4 => '1') then
+            return 'X';
+        else
+            return fold(x);
+        end if;
+    end function;
+
+    -- Agrees with the fold for up to four drivers but not for five
+    function quint(x : wire_vec) return wire is
+    begin
+        if x'length = 5 and x = (1 to 5 => '1') then
+            return 'X';
+        else
+            return fold(x);
+        end if;
+    end function;
+
+    -- Agrees with the fold for up to five drivers but not for six
+    function sext(x : wire_vec) return wire is
+    begin
+        if x'length = 6 and x = (1 to 6 => '1') then
+            return 'X';
+        else
+            return fold(x);
+        end if;
+    end function;
+
+    subtype rwire is resolved wire;
+    subtype qwire is quad wire;
+    subtype pwire is quint wire;
+    subtype swire is sext wire;
+
+    type rwire_vec is array (natural range <>) of rwire;
+
+    signal bus4 : rwire_vec(1 to 3) := (others => 'Z');
+    signal bus5 : rwire_vec(1 to 3) := (others => 'Z');
+    signal q    : qwire;
+    signal p    : pwire;
+    signal bus6 : rwire_vec(1 to 3) := (others => 'Z');
+    signal s    : swire;
+
+begin
+
+    -- Four and five drivers of a function which folds
+    a1: bus4 <= "Z0Z", "1ZZ" after 1 ns;
+    a2: bus4 <= "ZZZ", "1Z0" after 1 ns;
+    a3: bus4 <= "ZZ1", "1Z1" after 1 ns;
+    a4: bus4 <= "ZZZ", "ZZ0" after 1 ns;
+
+    b1: bus5 <= "0ZZ", "ZZ1" after 1 ns;
+    b2: bus5 <= "ZZZ", "ZZ1" after 1 ns;
+    b3: bus5 <= "ZZZ", "ZZ1" after 1 ns;
+    b4: bus5 <= "Z1Z", "ZZ1" after 1 ns;
+    b5: bus5 <= "ZZZ", "Z01" after 1 ns;
+
+    q1: q <= '0', '1' after 1 ns;
+    q2: q <= '1';
+    q3: q <= '1';
+    q4: q <= '1';
+
+    p1: p <= '0', '1' after 1 ns;
+    p2: p <= '1';
+    p3: p <= '1';
+    p4: p <= '1';
+    p5: p <= '1';
+
+    -- Six drivers of a function which folds and one which does not
+    c1: bus6 <= "ZZZ", "ZZ1" after 1 ns;
+    c2: bus6 <= "Z0Z", "ZZ1" after 1 ns;
+    c3: bus6 <= "ZZZ", "ZZ1" after 1 ns;
+    c4: bus6 <= "ZZZ", "ZZ1" after 1 ns;
+    c5: bus6 <= "1ZZ", "ZZ1" after 1 ns;
+    c6: bus6 <= "ZZZ", "0Z1" after 1 ns;
+
+    s1: s <= '0', '1' after 1 ns;
+    s2: s <= '1';
+    s3: s <= '1';
+    s4: s <= '1';
+    s5: s <= '1';
+    s6: s <= '1';
+
+    check: process is
+    begin
+        wait for 0 ns;
+        assert bus4 = "Z01";
+        assert bus5 = "01Z";
+        assert q = 'X';
+        assert p = 'X';
+        assert bus6 = "10Z";
+        assert s = 'X';
+        wait for 1 ns;
+        assert bus4 = "1ZX";
+        assert bus5 = "Z01";
+        assert q = 'X';
+        assert p = 'X';
+        assert bus6 = "0Z1";
+        assert s = 'X';
+        wait;
+    end process;
+
+end architecture;
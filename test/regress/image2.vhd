@@ -0,0 +1,56 @@
+entity image2 is
+end entity;
+
+architecture test of image2 is
+    type colour is (red, green, blue_green, 'x');
+    type int64 is range -9223372036854775807 - 1 to 9223372036854775807;
+
+    procedure check(x : in integer; s : in string) is
+    begin
+        assert integer'image(x) = s
+            report integer'image(x) & " /= " & s severity failure;
+        assert integer'value(s) = x;
+    end procedure;
+begin
+
+    process is
+        variable c   : colour;
+        variable i64 : int64;
+        variable t   : time;
+    begin
+        check(0, "0");
+        check(9, "9");
+        check(10, "10");
+        check(99, "99");
+        check(100, "100");
+        check(101, "101");
+        check(-1, "-1");
+        check(-10, "-10");
+        check(-99, "-99");
+        check(-100, "-100");
+        check(1234567, "1234567");
+        check(-7654321, "-7654321");
+        check(integer'high, "2147483647");
+        check(integer'low, "-2147483648");
+
+        i64 := int64'low;
+        assert int64'image(i64) = "-9223372036854775808";
+        i64 := int64'high;
+        assert int64'image(i64) = "9223372036854775807";
+
+        c := blue_green;
+        assert colour'image(c) = "blue_green";
+        c := 'x';
+        assert colour'image(c) = "'x'";
+        assert colour'value("BLUE_GREEN") = blue_green;
+
+        t := 42 ns;
+        assert time'image(t) = "42000000 FS";
+        t := -5 fs;
+        assert time'image(t) = "-5 FS";
+
+        report "done";
+        wait;
+    end process;
+
+end architecture;
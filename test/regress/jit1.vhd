@@ -0,0 +1,54 @@
+package pack1 is
+    function double(x : integer) return integer;
+end package;
+
+package body pack1 is
+    function double(x : integer) return integer is
+    begin
+        return x * 2;
+    end function;
+end package body;
+
+-------------------------------------------------------------------------------
+
+entity jit1 is
+end entity;
+
+use work.pack1.all;
+
+architecture test of jit1 is
+    signal x : integer := 0;
+    signal v : bit_vector(1 to 4) := "0000";
+
+    function invert(b : bit_vector) return bit_vector is
+    begin
+        return not b;
+    end function;
+begin
+
+    stim: process is
+    begin
+        for i in 1 to 5 loop
+            x <= double(i);
+            v <= invert(v);
+            wait for 1 ns;
+        end loop;
+        wait;
+    end process;
+
+    check: process is
+    begin
+        wait for 10 ns;
+        assert x = 10;
+        assert v = "1111";
+        report "done";
+        wait;
+    end process;
+
+    -- Never resumed after initialisation
+    idle: process is
+    begin
+        wait;
+    end process;
+
+end architecture;
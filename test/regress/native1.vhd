@@ -0,0 +1,66 @@
+package pack is
+    function fact(n : integer) return integer;
+    function dec(n : integer) return natural;
+end package;
+
+package body pack is
+
+    function fact(n : integer) return integer is
+        variable r : integer := 1;
+    begin
+        for i in 2 to n loop
+            r := r * i;
+        end loop;
+        return r;
+    end function;
+
+    function dec(n : integer) return natural is
+    begin
+        if n > 0 then
+            return n - 1;
+        else
+            return 0;
+        end if;
+    end function;
+
+end package body;
+
+-------------------------------------------------------------------------------
+
+entity sub is
+    generic ( G : integer );
+end entity;
+
+use work.pack.all;
+
+architecture test of sub is
+    constant C : integer := fact(G);
+    constant D : natural := dec(G);
+begin
+
+    process is
+    begin
+        if G = 5 then
+            assert C = 120;
+            assert D = 4;
+        else
+            assert C = 3628800;
+            assert D = 9;
+        end if;
+        wait;
+    end process;
+
+end architecture;
+
+-------------------------------------------------------------------------------
+
+entity native1 is
+end entity;
+
+architecture test of native1 is
+begin
+
+    u1: entity work.sub generic map ( 5 );
+    u2: entity work.sub generic map ( 10 );
+
+end architecture;
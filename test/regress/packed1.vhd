@@ -0,0 +1,53 @@
+entity packed1 is
+end entity;
+architecture test of packed1 is
+   function get(x : bit_vector) return bit_vector is
+   begin
+      return x;
+   end function;
+   subtype bv40 is bit_vector(1 to 40);
+begin
+   process is
+      variable a, b, c : bv40;
+      variable d : bit_vector(7 downto 0);
+      type int_vec is array (1 to 8) of integer;
+      variable x, y : int_vec;
+      variable s1, s2 : string(1 to 20);
+   begin
+      a := (1 => '1', 5 => '1', 40 => '1', others => '0');
+      b := (5 => '1', 39 => '1', others => '0');
+      c := a and b;
+      assert c = bv40'(5 => '1', others => '0');
+      c := a or b;
+      assert c = bv40'(1 | 5 | 39 | 40 => '1', others => '0');
+      c := a xor b;
+      assert c = bv40'(1 | 39 | 40 => '1', others => '0');
+      c := not a;
+      assert c = bv40'(2 to 4 | 6 to 39 => '1', others => '0');
+      c := a nand b;
+      assert c = bv40'(5 => '0', others => '1');
+      c := a nor b;
+      assert c = bv40'(1 | 5 | 39 | 40 => '0', others => '1');
+      c := a xnor b;
+      assert c = bv40'(1 | 39 | 40 => '0', others => '1');
+      assert c /= a;
+      d := "10100000";
+      d := not d;
+      assert d = "01011111";
+      assert get(not d)'left = 7;
+      assert get(not d)'right = 0;
+      x := (1, 2, 3, 4, 5, 6, 7, 8);
+      y := x;
+      assert x = y;
+      y(8) := 0;
+      assert x /= y;
+      s1 := "hello world abcdefgh";
+      s2 := s1;
+      assert s1 = s2;
+      s2(20) := 'x';
+      assert s1 /= s2;
+      s2(1 to 19) := s2(2 to 20);
+      assert s2 = "ello world abcdefgxx";
+      wait;
+   end process;
+end architecture;
@@ -0,0 +1,64 @@
+entity proc12 is
+end entity;
+
+architecture test of proc12 is
+
+    type int_vec is array (natural range <>) of integer;
+
+    function count_drivers(x : int_vec) return integer is
+    begin
+        return x'length;
+    end function;
+
+    subtype counted is count_drivers integer;
+
+    shared variable inits : natural := 0;
+
+    impure function next_init return natural is
+    begin
+        inits := inits + 1;
+        return inits;
+    end function;
+
+    constant ENABLE : boolean := false;
+
+    signal s : counted;
+
+begin
+
+    a: s <= 1;
+
+    -- Never resumes but its driver still takes part in resolution
+    drive: process is
+    begin
+        if not ENABLE then
+            wait;
+        end if;
+        s <= 2;
+        wait;
+    end process;
+
+    -- Never resumes but the initialiser is still evaluated
+    init: process is
+        variable v : natural := next_init;
+    begin
+        wait until ENABLE;
+        report "unreachable";
+    end process;
+
+    -- Never resumes and can be deleted
+    idle: process is
+    begin
+        wait until ENABLE;
+        report "unreachable";
+    end process;
+
+    check: process is
+    begin
+        wait for 1 ns;
+        assert s = 2;
+        assert inits = 1;
+        wait;
+    end process;
+
+end architecture;
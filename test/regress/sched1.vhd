@@ -0,0 +1,54 @@
+entity sched1 is
+end entity;
+
+architecture test of sched1 is
+    signal v     : bit_vector(0 to 31);
+    signal count : natural;
+begin
+
+    driver: process is
+    begin
+        -- Driving slices splits v into several groups
+        v(0 to 7) <= X"FF";
+        v(8 to 15) <= X"0F";
+        v(20 to 23) <= "1010";
+        wait for 1 ns;
+        assert v = X"FF0F0A00";
+
+        -- One transaction spanning every group
+        v <= X"12345678" after 5 ns;
+        wait for 1 ns;
+
+        -- Earlier transaction on part of the run preempts it
+        v(8 to 15) <= X"AB" after 2 ns;
+        wait for 3 ns;
+        assert v = X"FFAB0A00";
+        wait for 2 ns;
+        assert v = X"12AB5678";
+
+        -- Overlapping assignment at the same time
+        v <= X"FFFFFFFF" after 3 ns;
+        v(4 to 11) <= X"00" after 3 ns;
+        wait for 2 ns;
+        assert v = X"12AB5678";
+        wait for 2 ns;
+        assert v = X"F00FFFFF";
+
+        -- Zero delay assignment across groups
+        v <= X"00000000";
+        wait for 0 ns;
+        assert v = X"00000000";
+
+        wait for 1 ns;
+        assert count = 6 report integer'image(count);
+
+        report "done";
+        wait;
+    end process;
+
+    monitor: process (v) is
+    begin
+        count <= count + 1;
+    end process;
+
+end architecture;
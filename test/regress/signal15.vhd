@@ -0,0 +1,29 @@
+entity signal15 is
+end entity;
+
+architecture test of signal15 is
+    signal up   : bit_vector(0 to 7);
+    signal down : bit_vector(7 downto 0);
+    signal x, y : bit;
+begin
+
+    process is
+        variable v : bit_vector(1 to 4);
+    begin
+        v := "1011";
+        (up(2), up(3), up(4), up(5)) <= v;
+        (down(6), down(5), down(4), x) <= v;
+        (up(0), y, up(7)) <= bit_vector'("111");
+        wait for 1 ns;
+        assert up = "10101101";
+        assert down = "01010000";
+        assert x = '1';
+        assert y = '1';
+
+        (up(4), up(3), up(2)) <= bit_vector'("000");
+        wait for 1 ns;
+        assert up = "10000101";
+        wait;
+    end process;
+
+end architecture;
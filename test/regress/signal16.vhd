@@ -0,0 +1,92 @@
+entity signal16 is
+end entity;
+
+architecture test of signal16 is
+    type logic is ('U', '0', '1', 'Z');
+    type logic_vector is array (natural range <>) of logic;
+    type int_vector is array (natural range <>) of integer;
+
+    function resolved (v : logic_vector) return logic is
+        variable r : logic := 'Z';
+    begin
+        for i in v'range loop
+            if v(i) = 'U' or r = 'U' then
+                r := 'U';
+            elsif v(i) /= 'Z' then
+                if r = 'Z' or r = v(i) then
+                    r := v(i);
+                else
+                    r := 'U';
+                end if;
+            end if;
+        end loop;
+        return r;
+    end function;
+
+    function sum (v : int_vector) return integer is
+        variable r : integer := 0;
+    begin
+        for i in v'range loop
+            r := r + v(i);
+        end loop;
+        return r;
+    end function;
+
+    subtype rlogic is resolved logic;
+    subtype rint is sum integer;
+    type rlogic_vector is array (natural range <>) of rlogic;
+
+    type rint_vector is array (natural range <>) of rint;
+    type real_vector is array (natural range <>) of real;
+    type time_vector is array (natural range <>) of time;
+
+    signal bits  : bit_vector(1 to 1000) := (others => '1');
+    signal ints  : int_vector(1 to 100) := (others => -5);
+    signal reals : real_vector(1 to 10) := (others => 1.5);
+    signal times : time_vector(1 to 7) := (others => 3 ns);
+    signal mixed : int_vector(1 to 4) := (1, 2, 3, 4);
+    signal a, b  : rlogic_vector(1 to 64) := (others => 'Z');
+    signal c     : rlogic := '0';
+    signal d     : rint_vector(1 to 32) := (others => 0);
+begin
+
+    g: for i in d'range generate
+        d(i) <= 2;
+        d(i) <= 3;
+    end generate;
+
+    a <= (others => '1');
+    a <= (others => 'Z');
+    b <= (others => '0');
+    b <= (others => '1');
+    c <= '0';
+    c <= '0';
+
+    process is
+    begin
+        assert bits = (1 to 1000 => '1');
+        for i in ints'range loop
+            assert ints(i) = -5;
+        end loop;
+        for i in reals'range loop
+            assert reals(i) = 1.5;
+        end loop;
+        assert times = (1 to 7 => 3 ns);
+        assert mixed = (1, 2, 3, 4);
+        wait for 0 ns;
+        for i in a'range loop
+            assert a(i) = '1';
+            assert b(i) = 'U';
+        end loop;
+        assert c = '0';
+        assert d = (1 to 32 => 5);
+        assert not c'event;
+        bits(500) <= '0';
+        ints(7) <= 42;
+        wait for 1 ns;
+        assert bits(499 to 501) = "101";
+        assert ints(7) = 42 and ints(8) = -5;
+        wait;
+    end process;
+
+end architecture;
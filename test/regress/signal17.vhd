@@ -0,0 +1,50 @@
+entity signal17 is
+end entity;
+
+architecture test of signal17 is
+    type logic is ('U', '0', '1', 'Z');
+    type logic_vector is array (natural range <>) of logic;
+
+    function resolved (v : logic_vector) return logic is
+        variable r : logic := 'Z';
+    begin
+        report "resolving " & integer'image(v'length) & " drivers";
+        for i in v'range loop
+            if v(i) /= 'Z' then
+                r := v(i);
+            end if;
+        end loop;
+        return r;
+    end function;
+
+    subtype rlogic is resolved logic;
+    type rlogic_vector is array (natural range <>) of rlogic;
+
+    signal v : rlogic_vector(1 to 3) := (others => '1');
+begin
+
+    -- The resolution function has a side effect so it must be called
+    -- for every element even though each has the same initial drivers
+    g: for i in v'range generate
+        process is
+        begin
+            wait;
+            v(i) <= '0';
+        end process;
+
+        process is
+        begin
+            wait;
+            v(i) <= 'Z';
+        end process;
+    end generate;
+
+    process is
+    begin
+        wait for 1 ns;
+        assert v = "111";
+        report "done";
+        wait;
+    end process;
+
+end architecture;
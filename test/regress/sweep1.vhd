@@ -0,0 +1,18 @@
+entity sweep1 is
+end entity;
+
+architecture test of sweep1 is
+begin
+
+    process is
+    begin
+        for i in 1 to 5 loop
+            wait for 1 ns;
+            report "tick " & integer'image(i);
+        end loop;
+        report "bad count" severity error;
+        report "finished";
+        wait;
+    end process;
+
+end architecture;
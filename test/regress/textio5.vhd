@@ -0,0 +1,61 @@
+entity textio5 is
+end entity;
+
+use std.textio.all;
+
+architecture test of textio5 is
+
+    function make_line(n : natural) return string is
+        variable s : string(1 to n);
+    begin
+        for i in 1 to n loop
+            s(i) := character'val(character'pos('a') + i mod 26);
+        end loop;
+        return s;
+    end function;
+
+begin
+
+    process is
+        file f : text;
+        variable l : line;
+        variable c : character;
+    begin
+        file_open(f, "tmp.txt", WRITE_MODE);
+        write(l, string'("hello"));
+        writeline(f, l);
+        writeline(f, l);                -- Empty line
+        write(l, make_line(1000));      -- Longer than one chunk
+        writeline(f, l);
+        write(l, string'("crlf") & CR);
+        writeline(f, l);
+        write(l, make_line(256));       -- Exactly one chunk
+        writeline(f, l);
+        write(l, string'("no newline"));
+        write(f, l.all);
+        file_close(f);
+
+        file_open(f, "tmp.txt", READ_MODE);
+        readline(f, l);
+        assert l.all = "hello";
+        readline(f, l);
+        assert l'length = 0;
+        readline(f, l);
+        assert l.all = make_line(1000);
+        readline(f, l);
+        assert l.all = "crlf";
+        readline(f, l);
+        assert l.all = make_line(256);
+        read(l, c);
+        assert c = 'b';
+        assert l'length = 255;
+        readline(f, l);
+        assert l.all = "no newline";
+        assert endfile(f);
+        file_close(f);
+
+        report "done";
+        wait;
+    end process;
+
+end architecture;
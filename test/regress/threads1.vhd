@@ -0,0 +1,58 @@
+entity threads1 is
+end entity;
+
+architecture test of threads1 is
+    signal clk        : bit := '0';
+    signal a, b, c, d : integer := 0;
+begin
+
+    clkgen: process is
+    begin
+        for i in 1 to 10 loop
+            clk <= not clk;
+            wait for 5 ns;
+        end loop;
+        wait;
+    end process;
+
+    p1: process (clk) is
+    begin
+        if clk'event and clk = '1' then
+            a <= a + 1;
+            report "p1 " & integer'image(a);
+        end if;
+    end process;
+
+    p2: process (clk) is
+    begin
+        if clk'event and clk = '1' then
+            b <= b + 2;
+            report "p2 " & integer'image(b);
+        end if;
+    end process;
+
+    p3: process (clk) is
+    begin
+        if clk'event and clk = '1' then
+            c <= c + a;
+        end if;
+    end process;
+
+    p4: process (clk) is
+    begin
+        if clk'event and clk = '1' then
+            d <= d + b;
+        end if;
+    end process;
+
+    check: process is
+    begin
+        wait for 100 ns;
+        assert a = 5;
+        assert b = 10;
+        assert c = 10;
+        assert d = 20;
+        wait;
+    end process;
+
+end architecture;
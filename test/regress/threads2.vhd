@@ -0,0 +1,49 @@
+entity threads2 is
+end entity;
+
+architecture test of threads2 is
+    type int_vec is array (1 to 3) of integer;
+    signal clk : bit := '0';
+    signal n   : integer := 0;
+begin
+
+    clkgen: process is
+    begin
+        for i in 1 to 10 loop
+            clk <= not clk;
+            wait for 5 ns;
+        end loop;
+        wait;
+    end process;
+
+    count: process (clk) is
+    begin
+        if clk'event and clk = '1' then
+            n <= n + 1;
+        end if;
+    end process;
+
+    p1: process (clk) is
+    begin
+        if clk'event and clk = '1' then
+            report "p1 " & integer'image(n);
+        end if;
+    end process;
+
+    p2: process (clk) is
+        variable v : int_vec := (others => 0);
+    begin
+        if clk'event and clk = '1' then
+            v(n + 1) := n;              -- Error when n = 3
+            report "p2 " & integer'image(v(n + 1));
+        end if;
+    end process;
+
+    p3: process (clk) is
+    begin
+        if clk'event and clk = '1' then
+            report "p3 " & integer'image(n);
+        end if;
+    end process;
+
+end architecture;
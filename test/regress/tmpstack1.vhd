@@ -0,0 +1,44 @@
+entity tmpstack1 is
+end entity;
+
+architecture test of tmpstack1 is
+
+    procedure check_later(s : in string; expect : in integer;
+                          delay : in delay_length) is
+    begin
+        wait for delay;
+        assert s = integer'image(expect) & "!"
+            report "corrupt " & s severity failure;
+    end procedure;
+
+    constant N : integer := 50;
+
+    signal done : bit_vector(1 to N);
+
+begin
+
+    g: for i in 1 to N generate
+
+        process is
+        begin
+            for j in 1 to 20 loop
+                -- The argument is a temporary live across the wait
+                check_later(integer'image(i * 1000 + j) & "!",
+                            i * 1000 + j, (i mod 7 + 1) * ns);
+                wait for (j mod 3) * ns;
+            end loop;
+            done(i) <= '1';
+            wait;
+        end process;
+
+    end generate;
+
+    process is
+    begin
+        wait for 1 us;
+        assert done = (1 to N => '1');
+        report "done";
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,22 @@
+entity vhpi4_sub is
+    port ( i : in integer );
+end entity;
+
+architecture test of vhpi4_sub is
+    signal s : integer := 5;
+begin
+end architecture;
+
+-------------------------------------------------------------------------------
+
+entity vhpi4 is
+end entity;
+
+architecture test of vhpi4 is
+    signal x : integer := 2;
+begin
+
+    u1: entity work.vhpi4_sub
+        port map ( x );
+
+end architecture;
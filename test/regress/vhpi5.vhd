@@ -0,0 +1,22 @@
+entity vhpi5 is
+end entity;
+
+architecture test of vhpi5 is
+    signal x : integer := 3;
+    signal b : bit := '1';
+    signal v : bit_vector(3 downto 0) := "0101";
+    signal c : character := 'A';
+begin
+
+    process is
+    begin
+        wait for 2 ns;
+        assert x = 10;
+        assert b = '0';
+        assert v = "1001";
+        assert c = 'B';
+        report "values forced by VHPI";
+        wait;
+    end process;
+
+end architecture;
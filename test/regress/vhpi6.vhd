@@ -0,0 +1,22 @@
+entity vhpi6 is
+end entity;
+
+architecture test of vhpi6 is
+    signal a, b, c : integer := 0;
+begin
+
+    process is
+    begin
+        for i in 1 to 4 loop
+            wait for 1 ns;
+            a <= i;
+            if i mod 2 = 0 then
+                b <= i;
+            end if;
+        end loop;
+        wait;
+    end process;
+
+    c <= a * 10;
+
+end architecture;
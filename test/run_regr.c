@@ -21,6 +21,7 @@
 #include <fcntl.h>
 #include <assert.h>
 #include <signal.h>
+#include <math.h>
 
 #ifdef __CYGWIN__
 #include <process.h>
@@ -33,11 +34,19 @@
 #define realpath(N, R) _fullpath((R), (N), _MAX_PATH)
 #else
 #include <sys/wait.h>
+#include <sys/resource.h>
 #endif
 #include "config.h"
 
 #define WHITESPACE " \t\r\n"
 #define TIMEOUT    10
+#define RESULTS    "regress.json"
+
+// A test is reported as a performance outlier when its run time or peak
+// memory grows by this factor as well as by the absolute margin
+#define OUTLIER_RATIO    2.0
+#define OUTLIER_RUN_MS   100.0
+#define OUTLIER_RSS_KB   16384
 
 #define ANSI_RESET      0
 #define ANSI_BOLD       1
@@ -60,10 +69,37 @@
 #define F_COVER   (1 << 7)
 #define F_GENERIC (1 << 8)
 #define F_RELAX   (1 << 9)
+#define F_THREADS (1 << 10)
+#define F_CKPT    (1 << 11)
+#define F_CYCLE   (1 << 12)
+#define F_JIT     (1 << 13)
+#define F_DEBUG   (1 << 14)
+#define F_NATIVE  (1 << 15)
+#define F_HIT     (1 << 16)
+#define F_BUNDLE  (1 << 17)
+#define F_SWEEP   (1 << 18)
+#define F_MERGE   (1 << 19)
 
 typedef struct test test_t;
 typedef struct generic generic_t;
 typedef struct arglist arglist_t;
+typedef struct result result_t;
+
+typedef enum {
+   PHASE_ANALYSE,
+   PHASE_ELAB,
+   PHASE_RUN,
+
+   PHASE_COUNT
+} phase_t;
+
+struct result {
+   char     *name;
+   bool      passed;
+   double    ms[PHASE_COUNT];
+   long      rss_kb;
+   result_t *next;
+};
 
 struct generic {
    char      *name;
@@ -78,6 +114,14 @@ struct test {
    char      *stop;
    generic_t *generics;
    char      *relax;
+   char      *threads;
+   char      *checkpoint;
+   unsigned   index;
+   pid_t      pid;
+   bool       passed;
+   double     ms[PHASE_COUNT];
+   long       rss_kb;
+   result_t  *prev;
 };
 
 struct arglist {
@@ -87,10 +131,21 @@ struct arglist {
 };
 
 static test_t *test_list = NULL;
+static result_t *prev_results = NULL;
 static char test_dir[PATH_MAX];
 static char bin_dir[PATH_MAX];
+static char results_file[PATH_MAX];
 static bool is_tty = false;
 
+static const char *phase_keys[PHASE_COUNT] = {
+   "analyse_ms", "elab_ms", "run_ms"
+};
+
+// Names of the top level phases in the nvc --phase-report output
+static const char *phase_names[PHASE_COUNT] = {
+   "analyse", "elaborate", "run"
+};
+
 #ifdef __MINGW32__
 static char *strndup(const char *s, size_t n)
 {
@@ -238,6 +293,7 @@ static bool parse_test_list(int argc, char **argv)
    bool result = false;
    int lineno = 0;
    test_t *last = NULL;
+   unsigned ntests = 0;
    while (lineno++, !feof(f)) {
       char line[256];
       if (fgets(line, sizeof(line), f) == NULL)
@@ -270,7 +326,8 @@ static bool parse_test_list(int argc, char **argv)
       }
 
       test_t *test = calloc(sizeof(test_t), 1);
-      test->name = strdup(name);
+      test->name  = strdup(name);
+      test->index = ntests++;
 
       if (last == NULL)
          test_list = test;
@@ -306,6 +363,22 @@ static bool parse_test_list(int argc, char **argv)
             test->flags |= F_OPT;
          else if (strcmp(opt, "cover") == 0)
             test->flags |= F_COVER;
+         else if (strcmp(opt, "cover=hit") == 0)
+            test->flags |= F_COVER | F_HIT;
+         else if (strcmp(opt, "cycle") == 0)
+            test->flags |= F_CYCLE;
+         else if (strcmp(opt, "jit") == 0)
+            test->flags |= F_JIT;
+         else if (strcmp(opt, "debug") == 0)
+            test->flags |= F_DEBUG;
+         else if (strcmp(opt, "native") == 0)
+            test->flags |= F_NATIVE;
+         else if (strcmp(opt, "bundle") == 0)
+            test->flags |= F_BUNDLE;
+         else if (strcmp(opt, "sweep") == 0)
+            test->flags |= F_SWEEP;
+         else if (strcmp(opt, "merge") == 0)
+            test->flags |= F_SWEEP | F_MERGE;
          else if (strncmp(opt, "g", 1) == 0) {
             char *value = strchr(opt, '=');
             if (value == NULL) {
@@ -333,6 +406,28 @@ static bool parse_test_list(int argc, char **argv)
             test->flags |= F_RELAX;
             test->relax = strdup(value + 1);
          }
+         else if (strncmp(opt, "threads", 7) == 0) {
+            char *value = strchr(opt, '=');
+            if (value == NULL) {
+               fprintf(stderr, "Error on testlist line %d: missing argument to "
+                       "threads option in test %s\n", lineno, name);
+               goto out_close;
+            }
+
+            test->flags |= F_THREADS;
+            test->threads = strdup(value + 1);
+         }
+         else if (strncmp(opt, "checkpoint", 10) == 0) {
+            char *value = strchr(opt, '=');
+            if (value == NULL) {
+               fprintf(stderr, "Error on testlist line %d: missing argument to "
+                       "checkpoint option in test %s\n", lineno, name);
+               goto out_close;
+            }
+
+            test->flags |= F_CKPT;
+            test->checkpoint = strdup(value + 1);
+         }
          else {
             fprintf(stderr, "Error on testlist line %d: invalid option %s in "
                  "test %s\n", lineno, opt, name);
@@ -378,11 +473,84 @@ static void push_arg(arglist_t **args, const char *fmt, ...)
    }
 }
 
+static FILE *open_sweep_file(test_t *test)
+{
+   char fname[PATH_MAX];
+   snprintf(fname, PATH_MAX, "%s/regress/%s.sweep", test_dir, test->name);
+
+   FILE *f = fopen(fname, "r");
+   if (f == NULL)
+      fprintf(stderr, "Failed to open %s: %s\n", fname, strerror(errno));
+
+   return f;
+}
+
+static const char *next_sweep_entry(FILE *f, char *line, size_t len)
+{
+   while (fgets(line, len, f)) {
+      char *name = strtok(line, WHITESPACE);
+      if (name != NULL && !is_comment(name))
+         return name;
+   }
+
+   return NULL;
+}
+
+static bool push_sweep_reports(test_t *test, arglist_t **args)
+{
+   FILE *f = open_sweep_file(test);
+   if (f == NULL)
+      return false;
+
+   char line[256];
+   const char *name;
+   while ((name = next_sweep_entry(f, line, sizeof(line))))
+      push_arg(args, "work" PATH_SEP "%s.cover", name);
+
+   fclose(f);
+   return true;
+}
+
+static void append_sweep_logs(test_t *test, FILE *outf)
+{
+   // Each run of a sweep writes its output to a separate log which is
+   // copied to the test output so the gold file can check it
+
+   FILE *f = open_sweep_file(test);
+   if (f == NULL)
+      return;
+
+   char line[256];
+   const char *name;
+   while ((name = next_sweep_entry(f, line, sizeof(line)))) {
+      fprintf(outf, "---- %s.log\n", name);
+
+      char log_name[PATH_MAX];
+      snprintf(log_name, PATH_MAX, "%s.log", name);
+
+      FILE *log = fopen(log_name, "r");
+      if (log == NULL) {
+         fprintf(outf, "missing %s\n", log_name);
+         continue;
+      }
+
+      char buf[256];
+      size_t n;
+      while ((n = fread(buf, 1, sizeof(buf), log)) > 0)
+         fwrite(buf, 1, n, outf);
+
+      fclose(log);
+   }
+
+   fclose(f);
+   fflush(outf);
+}
+
 static void signal_handler(int sig)
 {
 }
 
-static bool run_cmd(FILE *log, arglist_t **args)
+static bool run_cmd(FILE *log, arglist_t **args, test_t *test)
 {
    fflush(stdout);
    fflush(stderr);
@@ -431,7 +599,8 @@ static bool run_cmd(FILE *log, arglist_t **args)
       signal(SIGCHLD, SIG_DFL);
 
       int status;
-      if (waitpid(pid, &status, WNOHANG) < 0) {
+      struct rusage ru;
+      if (wait4(pid, &status, WNOHANG, &ru) < 0) {
          fprintf(stderr, "Waiting for child failed: %s\n", strerror(errno));
          return false;
       }
@@ -446,8 +615,17 @@ static bool run_cmd(FILE *log, arglist_t **args)
 
          return false;
       }
-      else
+      else {
+#ifdef __APPLE__
+         const long maxrss = ru.ru_maxrss / 1024;
+#else
+         const long maxrss = ru.ru_maxrss;
+#endif
+         if (maxrss > test->rss_kb)
+            test->rss_kb = maxrss;
+
          return WEXITSTATUS(status) == 0;
+      }
    }
 #endif  // __CYGWIN__ || __MINGW32__
 }
@@ -460,6 +638,43 @@ static void push_std(test_t *test, arglist_t **args)
       push_arg(args, "--std=2008");
 }
 
+static void push_nvc(test_t *test, arglist_t **args)
+{
+   push_arg(args, "%s" PATH_SEP "nvc%s", bin_dir, EXEEXT);
+   push_arg(args, "--phase-report");
+   push_std(test, args);
+}
+
+static void read_phase_times(test_t *test, FILE *log)
+{
+   // Each command prints a table of phases to the log at exit and
+   // only the top level phase for the command itself is kept
+
+   char line[256];
+   bool in_report = false;
+   while (fgets(line, sizeof(line), log)) {
+      if (strncmp(line, "phase ", 6) == 0) {
+         in_report = true;
+         continue;
+      }
+      else if (!in_report || line[0] == ' ')
+         continue;
+
+      char name[64];
+      unsigned calls;
+      double ms;
+      if (sscanf(line, "%63s %u %lf", name, &calls, &ms) != 3) {
+         in_report = false;
+         continue;
+      }
+
+      for (int i = 0; i < PHASE_COUNT; i++) {
+         if (strcmp(name, phase_names[i]) == 0)
+            test->ms[i] += ms;
+      }
+   }
+}
+
 static void chomp(char *str)
 {
    const size_t len = strlen(str);
@@ -512,8 +727,7 @@ static bool run_test(test_t *test)
    }
 
    arglist_t *args = NULL;
-   push_arg(&args, "%s" PATH_SEP "nvc%s", bin_dir, EXEEXT);
-   push_std(test, &args);
+   push_nvc(test, &args);
 
    push_arg(&args, "-a");
    push_arg(&args, "%s" PATH_SEP "regress" PATH_SEP "%s.vhd",
@@ -528,31 +742,85 @@ static bool run_test(test_t *test)
    if (!(test->flags & F_OPT))
       push_arg(&args, "-O0");
 
-   if (test->flags & F_COVER)
+   if (test->flags & F_HIT)
+      push_arg(&args, "--cover=hit");
+   else if (test->flags & F_COVER)
       push_arg(&args, "--cover");
 
+   if (test->flags & F_JIT)
+      push_arg(&args, "--jit");
+
+   if (test->flags & F_DEBUG)
+      push_arg(&args, "--debug-info");
+
+   if (test->flags & F_NATIVE)
+      push_arg(&args, "--eval-native");
+
+   if (test->flags & F_BUNDLE)
+      push_arg(&args, "--bundle");
+
    for (generic_t *g = test->generics; g != NULL; g = g->next)
       push_arg(&args, "-g%s=%s", g->name, g->value);
 
    if (test->flags & F_FAIL) {
-      if (!run_cmd(outf, &args))
+      if (!run_cmd(outf, &args, test))
          goto out_print;
 
-      push_arg(&args, "%s/nvc%s", bin_dir, EXEEXT);
-      push_std(test, &args);
+      push_nvc(test, &args);
+   }
+
+   if (test->flags & F_CKPT) {
+      // Run once to save a checkpoint and then again restoring from it
+      push_arg(&args, "-r");
+
+      if (test->flags & F_STOP)
+         push_arg(&args, "--stop-time=%s", test->stop);
+
+      push_arg(&args, "--checkpoint-at=%s", test->checkpoint);
+      push_arg(&args, "--checkpoint-file=%s.ckpt", test->name);
+      push_arg(&args, "%s", test->name);
+
+      if (!run_cmd(outf, &args, test))
+         goto out_print;
+
+      push_nvc(test, &args);
    }
 
    push_arg(&args, "-r");
 
+   if (test->flags & F_CKPT)
+      push_arg(&args, "--restore=%s.ckpt", test->name);
+
    if (test->flags & F_STOP)
       push_arg(&args, "--stop-time=%s", test->stop);
 
+   if (test->flags & F_THREADS)
+      push_arg(&args, "--threads=%s", test->threads);
+
+   if (test->flags & F_CYCLE)
+      push_arg(&args, "--cycle-based");
+
    if (test->flags & F_VHPI)
       push_arg(&args, "--load=%s/../lib/%s.so%s", bin_dir, test->name, EXEEXT);
 
+   if (test->flags & F_SWEEP)
+      push_arg(&args, "--sweep=%s" PATH_SEP "regress" PATH_SEP "%s.sweep",
+               test_dir, test->name);
+
    push_arg(&args, "%s", test->name);
 
-   result = run_cmd(outf, &args);
+   result = run_cmd(outf, &args, test);
+
+   if (test->flags & F_SWEEP)
+      append_sweep_logs(test, outf);
+
+   if (result && (test->flags & F_MERGE)) {
+      // Merge the coverage reports written by each run of the sweep
+      push_nvc(test, &args);
+      push_arg(&args, "--cover-merge");
+      result = push_sweep_reports(test, &args)
+         && run_cmd(outf, &args, test);
+   }
 
    if (test->flags & F_FAIL)
       result = !result;
@@ -600,6 +868,10 @@ static bool run_test(test_t *test)
    }
 
  out_print:
+   outf = freopen("out", "r", outf);
+   assert(outf != NULL);
+   read_phase_times(test, outf);
+
    if (result) {
       set_attr(ANSI_FG_GREEN);
       printf("ok\n");
@@ -630,6 +902,273 @@ static bool run_test(test_t *test)
    return result;
 }
 
+static double result_value(const char *line, const char *key)
+{
+   char pattern[64];
+   snprintf(pattern, sizeof(pattern), "\"%s\": ", key);
+
+   const char *p = strstr(line, pattern);
+   return p ? strtod(p + strlen(pattern), NULL) : 0.0;
+}
+
+static void load_results(void)
+{
+   // Each test is on a single line of the file written below so this
+   // does not need a general JSON parser
+
+   FILE *f = fopen(results_file, "r");
+   if (f == NULL)
+      return;
+
+   char line[512];
+   while (fgets(line, sizeof(line), f)) {
+      const char *name = strstr(line, "\"name\": \"");
+      if (name == NULL)
+         continue;
+
+      name += strlen("\"name\": \"");
+      const char *end = strchr(name, '"');
+      if (end == NULL)
+         continue;
+
+      result_t *r = calloc(1, sizeof(result_t));
+      r->name   = strndup(name, end - name);
+      r->passed = strstr(line, "\"passed\": true") != NULL;
+      r->rss_kb = result_value(line, "peak_rss_kb");
+      for (int i = 0; i < PHASE_COUNT; i++)
+         r->ms[i] = result_value(line, phase_keys[i]);
+
+      r->next = prev_results;
+      prev_results = r;
+   }
+
+   fclose(f);
+
+   for (test_t *t = test_list; t != NULL; t = t->next) {
+      for (result_t *r = prev_results; r != NULL && !t->prev; r = r->next) {
+         if (strcmp(r->name, t->name) == 0)
+            t->prev = r;
+      }
+   }
+}
+
+static void print_result(FILE *f, const char *name, bool passed,
+                         const double *ms, long rss_kb, bool first)
+{
+   fprintf(f, "%s\n    { \"name\": \"%s\", \"passed\": %s", first ? "" : ",",
+           name, passed ? "true" : "false");
+   for (int i = 0; i < PHASE_COUNT; i++)
+      fprintf(f, ", \"%s\": %.1f", phase_keys[i], ms[i]);
+   fprintf(f, ", \"peak_rss_kb\": %ld }", rss_kb);
+}
+
+static void save_results(void)
+{
+   FILE *f = fopen(results_file, "w");
+   if (f == NULL) {
+      fprintf(stderr, "Failed to create %s: %s\n", results_file,
+              strerror(errno));
+      return;
+   }
+
+   fprintf(f, "{\n  \"tests\": [");
+
+   bool first = true;
+   for (test_t *t = test_list; t != NULL; t = t->next) {
+      print_result(f, t->name, t->passed, t->ms, t->rss_kb, first);
+      first = false;
+   }
+
+   // Keep the timings of tests which were not run this time so a later
+   // full run can still schedule them
+   for (result_t *r = prev_results; r != NULL; r = r->next) {
+      bool ran = false;
+      for (test_t *t = test_list; t != NULL && !ran; t = t->next)
+         ran = (t->prev == r);
+
+      if (!ran) {
+         print_result(f, r->name, r->passed, r->ms, r->rss_kb, first);
+         first = false;
+      }
+   }
+
+   fprintf(f, "%s]\n}\n", first ? "" : "\n  ");
+   fclose(f);
+}
+
+static void report_outliers(void)
+{
+   // Only compare tests which passed both times as a failure often
+   // stops early or runs until the timeout
+
+   bool header = false;
+   for (test_t *t = test_list; t != NULL; t = t->next) {
+      const result_t *r = t->prev;
+      if (r == NULL || !r->passed || !t->passed)
+         continue;
+
+      const double run = t->ms[PHASE_RUN], prev_run = r->ms[PHASE_RUN];
+      const bool slow = run > prev_run * OUTLIER_RATIO
+         && run - prev_run > OUTLIER_RUN_MS;
+      const bool fat = t->rss_kb > r->rss_kb * OUTLIER_RATIO
+         && t->rss_kb - r->rss_kb > OUTLIER_RSS_KB;
+
+      if (!slow && !fat)
+         continue;
+
+      if (!header) {
+         set_attr(ANSI_FG_YELLOW);
+         printf("\nPerformance regressions:\n");
+         set_attr(ANSI_RESET);
+         header = true;
+      }
+
+      if (slow)
+         printf("%15s : run time %.0f ms -> %.0f ms\n", t->name,
+                prev_run, run);
+      if (fat)
+         printf("%15s : peak RSS %ld kB -> %ld kB\n", t->name,
+                r->rss_kb, t->rss_kb);
+   }
+}
+
+#ifndef __MINGW32__
+static double total_ms(const double *ms)
+{
+   double total = 0.0;
+   for (int i = 0; i < PHASE_COUNT; i++)
+      total += ms[i];
+   return total;
+}
+
+static int longest_first(const void *a, const void *b)
+{
+   // Tests with no remembered time are started first as they may well
+   // be the new slow ones
+   const test_t *l = *(test_t * const *)a;
+   const test_t *r = *(test_t * const *)b;
+
+   const double lt = l->prev ? total_ms(l->prev->ms) : INFINITY;
+   const double rt = r->prev ? total_ms(r->prev->ms) : INFINITY;
+
+   if (lt != rt)
+      return lt < rt ? 1 : -1;
+   else
+      return (int)l->index - (int)r->index;
+}
+
+static void start_test(test_t *test)
+{
+   char report[PATH_MAX];
+   snprintf(report, sizeof(report), "%s.report", test->name);
+
+   fflush(stdout);
+   fflush(stderr);
+
+   pid_t pid = fork();
+   if (pid < 0) {
+      fprintf(stderr, "Fork failed: %s\n", strerror(errno));
+      exit(EXIT_FAILURE);
+   }
+   else if (pid == 0) {
+      // Buffer the output so the lines for each test are printed
+      // together once it finishes
+      if (freopen(report, "w", stdout) == NULL)
+         _exit(EXIT_FAILURE);
+
+      const bool passed = run_test(test);
+
+      char times[PATH_MAX];
+      snprintf(times, sizeof(times), "%s.times", test->name);
+
+      FILE *f = fopen(times, "w");
+      if (f != NULL) {
+         fprintf(f, "%f %f %f %ld\n", test->ms[PHASE_ANALYSE],
+                 test->ms[PHASE_ELAB], test->ms[PHASE_RUN], test->rss_kb);
+         fclose(f);
+      }
+
+      fclose(stdout);
+      _exit(passed ? EXIT_SUCCESS : EXIT_FAILURE);
+   }
+
+   test->pid = pid;
+}
+
+static void finish_test(test_t *test, int status)
+{
+   char path[PATH_MAX];
+   snprintf(path, sizeof(path), "%s.report", test->name);
+
+   FILE *f = fopen(path, "r");
+   if (f != NULL) {
+      char buf[1024];
+      size_t n;
+      while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+         fwrite(buf, 1, n, stdout);
+      fclose(f);
+      remove(path);
+   }
+
+   snprintf(path, sizeof(path), "%s.times", test->name);
+
+   if ((f = fopen(path, "r")) != NULL) {
+      if (fscanf(f, "%lf %lf %lf %ld", &(test->ms[PHASE_ANALYSE]),
+                 &(test->ms[PHASE_ELAB]), &(test->ms[PHASE_RUN]),
+                 &(test->rss_kb)) != 4)
+         memset(test->ms, '\0', sizeof(test->ms));
+      fclose(f);
+      remove(path);
+   }
+
+   fflush(stdout);
+
+   test->passed = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static bool run_parallel(int jobs)
+{
+   int ntests = 0;
+   for (test_t *it = test_list; it != NULL; it = it->next)
+      ntests++;
+
+   test_t **order = calloc(ntests, sizeof(test_t *));
+   int pos = 0;
+   for (test_t *it = test_list; it != NULL; it = it->next)
+      order[pos++] = it;
+
+   qsort(order, ntests, sizeof(test_t *), longest_first);
+
+   bool pass = true;
+   int next = 0, running = 0;
+   while (next < ntests || running > 0) {
+      while (running < jobs && next < ntests) {
+         start_test(order[next++]);
+         running++;
+      }
+
+      int status;
+      const pid_t pid = wait(&status);
+      if (pid < 0) {
+         fprintf(stderr, "Waiting for test failed: %s\n", strerror(errno));
+         exit(EXIT_FAILURE);
+      }
+
+      for (int i = 0; i < next; i++) {
+         if (order[i]->pid == pid) {
+            finish_test(order[i], status);
+            pass &= order[i]->passed;
+            running--;
+            break;
+         }
+      }
+   }
+
+   free(order);
+   return pass;
+}
+#endif  // __MINGW32__
+
 static void checked_realpath(const char *path, char *output)
 {
    if (realpath(path, output) == NULL) {
@@ -678,9 +1217,42 @@ int main(int argc, char **argv)
    if (getenv("QUICK"))
       return 0;
 
-   if (!parse_test_list(argc - 1, argv + 1))
+   // Strip -j N or -jN from the test name filters
+   int jobs = 1, nfilters = 0;
+   char **filters = calloc(argc, sizeof(char *));
+   for (int i = 1; i < argc; i++) {
+      if (strncmp(argv[i], "-j", 2) == 0) {
+         const char *arg = argv[i][2] != '\0' ? argv[i] + 2
+            : (i + 1 < argc ? argv[++i] : "");
+         if ((jobs = atoi(arg)) <= 0) {
+            fprintf(stderr, "Error: invalid job count '%s'\n", arg);
+            return EXIT_FAILURE;
+         }
+      }
+      else
+         filters[nfilters++] = argv[i];
+   }
+
+#ifdef __MINGW32__
+   if (jobs > 1) {
+      fprintf(stderr, "Warning: -j is not supported on this platform\n");
+      jobs = 1;
+   }
+#endif
+
+   if (!parse_test_list(nfilters, filters))
       return EXIT_FAILURE;
 
+   char cwd[PATH_MAX];
+   if (getcwd(cwd, sizeof(cwd)) == NULL) {
+      fprintf(stderr, "Failed to get current directory: %s\n",
+              strerror(errno));
+      return EXIT_FAILURE;
+   }
+
+   snprintf(results_file, sizeof(results_file), "%s" PATH_SEP RESULTS, cwd);
+   load_results();
+
    if (make_dir("logs") != 0 && errno != EEXIST) {
       fprintf(stderr, "Failed to make logs directory: %s\n", strerror(errno));
       return EXIT_FAILURE;
@@ -693,10 +1265,20 @@ int main(int argc, char **argv)
    }
 
    bool pass = true;
-   for (test_t *it = test_list; it != NULL; it = it->next) {
-      if (!run_test(it))
-         pass = false;
+#ifndef __MINGW32__
+   if (jobs > 1)
+      pass = run_parallel(jobs);
+   else
+#endif
+   {
+      for (test_t *it = test_list; it != NULL; it = it->next) {
+         if (!(it->passed = run_test(it)))
+            pass = false;
+      }
    }
 
+   report_outliers();
+   save_results();
+
    return pass ? 0 : EXIT_FAILURE;
 }
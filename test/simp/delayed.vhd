@@ -0,0 +1,17 @@
+entity delayed is
+end entity;
+
+architecture test of delayed is
+    signal x, y : integer;
+begin
+
+    process is
+    begin
+        assert x'delayed(1 ns) = 0;
+        assert x'delayed(1 ns) = x'delayed(1 ns);
+        assert x'delayed(2 ns) = y'delayed(1 ns);
+        assert x'transaction = x'transaction;
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,29 @@
+package pack is
+    function log2(x : natural) return natural;
+end package;
+
+package body pack is
+    function log2(x : natural) return natural is
+        variable r : natural := 0;
+        variable v : natural := x;
+    begin
+        while v > 1 loop
+            v := v / 2;
+            r := r + 1;
+        end loop;
+        return r;
+    end function;
+end package body;
+
+entity memo is
+end entity;
+
+use work.pack.all;
+
+architecture a of memo is
+    constant c1 : natural := log2(64);
+    constant c2 : natural := log2(64);
+    constant c3 : natural := log2(8);
+    constant c4 : natural := log2(8) + log2(64);
+begin
+end architecture;
@@ -1,6 +1,7 @@
 #include "type.h"
 #include "util.h"
 #include "phase.h"
+#include "common.h"
 #include "test_util.h"
 
 #include <check.h>
@@ -316,6 +317,36 @@ START_TEST(test_issue356)
 }
 END_TEST
 
+START_TEST(test_elide)
+{
+   input_from_file(TESTDIR "/bounds/elide.vhd");
+
+   tree_t a = parse_and_check(T_ENTITY, T_ARCH);
+   fail_unless(sem_errors() == 0);
+
+   simplify(a, 0);
+   bounds_check(a);
+   fail_unless(bounds_errors() == 0);
+
+   tree_t p = tree_stmt(a, 0);
+
+   const bool assign_elided[] = { true, true, false };
+   for (int i = 0; i < ARRAY_LEN(assign_elided); i++) {
+      tree_t s = tree_stmt(p, i);
+      fail_unless(tree_attr_int(s, elide_bounds_i, 0) == assign_elided[i]);
+   }
+
+   const bool ref_elided[] = { true, true, false };
+   for (int i = 0; i < ARRAY_LEN(ref_elided); i++) {
+      tree_t ref = tree_target(tree_stmt(p, i + 3));
+      fail_unless(tree_kind(ref) == T_ARRAY_REF);
+      fail_unless(!!(tree_flags(ref) & TREE_F_ELIDE_BOUNDS) == ref_elided[i]);
+   }
+
+   fail_if(tree_attr_int(tree_stmt(p, 6), elide_bounds_i, 0));
+}
+END_TEST
+
 Suite *get_bounds_tests(void)
 {
    Suite *s = suite_create("bounds");
@@ -334,6 +365,7 @@ Suite *get_bounds_tests(void)
    tcase_add_test(tc_core, test_issue269);
    tcase_add_test(tc_core, test_issue307b);
    tcase_add_test(tc_core, test_issue356);
+   tcase_add_test(tc_core, test_elide);
    suite_add_tcase(s, tc_core);
 
    return s;
@@ -0,0 +1,173 @@
+#include "util.h"
+#include "rt/cosimapi.h"
+
+#include <check.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define NSYNCS   20
+#define NCHANGES 200
+
+static char fname[64];
+
+static void setup(void)
+{
+   checked_sprintf(fname, sizeof(fname), "test_cosim_%d.shm", getpid());
+}
+
+static void teardown(void)
+{
+   unlink(fname);
+}
+
+static int run_model(void)
+{
+   // Replies to each sync with the time and the sum of the first value
+   // of every change since the previous sync
+
+   cosim_t *c = cosim_create(fname, 10, 4096);
+   const int a = cosim_add(c, ":top:a", COSIM_WATCH);
+   const int b = cosim_add(c, ":TOP:B", COSIM_DRIVE);
+   cosim_start(c);
+
+   if (cosim_count(c, a) != 3 || cosim_count(c, b) != 2)
+      return 1;
+
+   uint64_t sum = 0, last = 0;
+   cosim_event_t ev;
+   while (cosim_next(c, &ev)) {
+      switch (ev.kind) {
+      case COSIM_CHANGE:
+         if (ev.signal != a || ev.count != 3 || ev.when < last)
+            return 1;
+         else if (ev.values[1] != ev.values[0] + 1)
+            return 1;
+         sum += ev.values[0];
+         last = ev.when;
+         break;
+
+      case COSIM_SYNC:
+         {
+            const uint64_t reply[2] = { ev.when, sum };
+            cosim_drive(c, b, reply);
+            cosim_ack(c, ev.when);
+            sum = 0;
+         }
+         break;
+      }
+   }
+
+   cosim_close(c);
+   return 0;
+}
+
+START_TEST(test_roundtrip)
+{
+   const pid_t pid = fork();
+   if (pid == 0)
+      _exit(run_model());
+
+   fail_if(pid < 0);
+
+   cosim_t *c = cosim_attach(fname);
+   fail_unless(cosim_signals(c) == 2);
+   fail_unless(cosim_quantum(c) == 10);
+   fail_unless(strcmp(cosim_name(c, 0), ":top:a") == 0);
+   fail_unless(strcmp(cosim_name(c, 1), ":TOP:B") == 0);
+   fail_unless(cosim_mode(c, 0) == COSIM_WATCH);
+   fail_unless(cosim_mode(c, 1) == COSIM_DRIVE);
+
+   cosim_set_count(c, 0, 3);
+   cosim_set_count(c, 1, 2);
+   cosim_ready(c);
+
+   int signal;
+   const uint64_t *values;
+   unsigned count;
+
+   // More changes in each quantum than fit in the ring at once
+   for (uint64_t t = 0; t < NSYNCS * 10; t += 10) {
+      uint64_t sum = 0;
+      for (int i = 0; i < NCHANGES; i++) {
+         const uint64_t v[3] = { t + i, t + i + 1, 0 };
+         cosim_put_change(c, 0, t, v);
+         sum += t + i;
+      }
+
+      cosim_put_sync(c, t);
+      fail_unless(cosim_wait_ack(c, t));
+
+      // Values sent for a later sync are left in the ring
+      fail_if(t > 0 && cosim_get_drive(c, t - 10, &signal, &values, &count));
+
+      fail_unless(cosim_get_drive(c, t, &signal, &values, &count));
+      fail_unless(signal == 1);
+      fail_unless(count == 2);
+      fail_unless(values[0] == t);
+      fail_unless(values[1] == sum);
+
+      fail_if(cosim_pending(c));
+   }
+
+   cosim_put_end(c);
+   cosim_detach(c);
+
+   int status;
+   fail_unless(waitpid(pid, &status, 0) == pid);
+   fail_unless(WIFEXITED(status));
+   fail_unless(WEXITSTATUS(status) == 0);
+}
+END_TEST
+
+START_TEST(test_close)
+{
+   const pid_t pid = fork();
+   if (pid == 0) {
+      // Closing the channel removes the file
+      cosim_t *c = cosim_create(fname, 1, 0);
+      cosim_add(c, ":top:x", COSIM_WATCH);
+      cosim_start(c);
+
+      cosim_event_t ev;
+      while (cosim_next(c, &ev))
+         ;
+
+      cosim_close(c);
+      _exit(0);
+   }
+
+   fail_if(pid < 0);
+
+   cosim_t *c = cosim_attach(fname);
+   fail_unless(cosim_signals(c) == 1);
+   fail_if(cosim_closed(c));
+   cosim_set_count(c, 0, 1);
+   cosim_ready(c);
+
+   cosim_put_end(c);
+   cosim_detach(c);
+
+   int status;
+   fail_unless(waitpid(pid, &status, 0) == pid);
+   fail_unless(WIFEXITED(status));
+   fail_unless(WEXITSTATUS(status) == 0);
+   fail_if(access(fname, F_OK) == 0);
+}
+END_TEST
+
+Suite *get_cosim_tests(void)
+{
+   Suite *s = suite_create("cosim");
+
+   TCase *tc_core = tcase_create("Core");
+   tcase_add_checked_fixture(tc_core, setup, teardown);
+   tcase_add_test(tc_core, test_roundtrip);
+   tcase_add_test(tc_core, test_close);
+   suite_add_tcase(s, tc_core);
+
+   return s;
+}
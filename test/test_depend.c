@@ -0,0 +1,57 @@
+#include "test_util.h"
+#include "phase.h"
+
+#include <check.h>
+#include <stdlib.h>
+
+START_TEST(test_scan)
+{
+   char *files[] = {
+      TESTDIR "/depend/pack.vhd",
+      TESTDIR "/depend/body.vhd",
+      TESTDIR "/depend/ent.vhd",
+      TESTDIR "/depend/top.vhd",
+      TESTDIR "/depend/pack2.vhd"
+   };
+   const int nfiles = ARRAY_LEN(files);
+
+   depend_t *after = depend_scan(files, nfiles, ident_new("MYLIB"));
+   fail_if(after == NULL);
+
+#define AFTER(i, j) after[(i) * nfiles + (j)]
+
+   fail_unless(AFTER(1, 0) == DEPEND_USE);
+   fail_unless(AFTER(2, 0) == DEPEND_USE);
+   fail_unless(AFTER(2, 1) == DEPEND_NONE);
+   fail_unless(AFTER(3, 2) == DEPEND_USE);
+   fail_unless(AFTER(3, 0) == DEPEND_NONE);
+   fail_unless(AFTER(3, 1) == DEPEND_NONE);
+
+   // The second declaration of PACK must wait for the earlier one and
+   // every file which uses it
+   fail_unless(AFTER(4, 0) == DEPEND_ORDER);
+   fail_unless(AFTER(4, 1) == DEPEND_ORDER);
+   fail_unless(AFTER(4, 2) == DEPEND_ORDER);
+   fail_unless(AFTER(4, 3) == DEPEND_NONE);
+
+   for (int i = 0; i < nfiles; i++) {
+      for (int j = i; j < nfiles; j++)
+         fail_unless(AFTER(i, j) == DEPEND_NONE);
+   }
+
+#undef AFTER
+
+   free(after);
+}
+END_TEST
+
+Suite *get_depend_tests(void)
+{
+   Suite *s = suite_create("depend");
+
+   TCase *tc_core = nvc_unit_test();
+   tcase_add_test(tc_core, test_scan);
+   suite_add_tcase(s, tc_core);
+
+   return s;
+}
@@ -0,0 +1,166 @@
+#include "util.h"
+#include "common.h"
+#include "tree.h"
+#include "rt/rt.h"
+
+#include <check.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define MAX_CHANGES 4
+
+typedef struct {
+   uint32_t gid;
+   uint32_t len;
+   uint8_t  data[16];
+} change_t;
+
+static char     fname[64];
+static char     address[64];
+static change_t changes[MAX_CHANGES];
+static int      nchanges = 0;
+
+static const int32_t  ints[]   = { 0x01020304, -2 };
+static const uint16_t shorts[] = { 0x0102, 0x0304, 0xfffe };
+static const double   reals[]  = { 1.5 };
+
+static void setup(void)
+{
+   checked_sprintf(fname, sizeof(fname), "test_dist_%d.part", getpid());
+   checked_sprintf(address, sizeof(address), "127.0.0.1:%d",
+                   20000 + getpid() % 20000);
+
+   FILE *f = fopen(fname, "w");
+   fail_if(f == NULL);
+   fprintf(f, "0 :top:a*   # Comment\n");
+   fprintf(f, "1 :top:b*\n");
+   fclose(f);
+
+   intern_strings();
+}
+
+static void teardown(void)
+{
+   unlink(fname);
+}
+
+static void record_change(uint32_t gid, const void *data, uint32_t len)
+{
+   // Also called in the child so any unexpected change is left for the
+   // caller to detect from the count
+   if (nchanges == MAX_CHANGES || len > sizeof(changes[0].data))
+      return;
+
+   change_t *c = &(changes[nchanges++]);
+   c->gid = gid;
+   c->len = len;
+   memcpy(c->data, data, len);
+}
+
+static tree_t make_top(void)
+{
+   tree_t top = tree_new(T_ELAB);
+   tree_set_ident(top, ident_new("top"));
+   tree_add_attr_int(top, nnets_i, 16);
+   return top;
+}
+
+static int run_peer(void)
+{
+   // Node one sends its changes first and then waits for the decision
+
+   dist_init(make_top(), fname, 1, address);
+
+   if (dist_owns(ident_new(":top:a1")) || !dist_owns(ident_new(":top:b1")))
+      return 1;
+   else if (dist_owns(ident_new(":top:c")))
+      return 2;
+
+   dist_add_change(5, ints, sizeof(int32_t), ARRAY_LEN(ints));
+
+   const dist_status_t local1 = { .when = 30 };
+   const dist_status_t global1 = dist_sync(local1, record_change);
+
+   if (!global1.delta || global1.stop || global1.when != 20)
+      return 3;
+   else if (nchanges != 1 || changes[0].gid != 7)
+      return 4;
+   else if (changes[0].len != sizeof(shorts))
+      return 5;
+   else if (memcmp(changes[0].data, shorts, sizeof(shorts)) != 0)
+      return 6;
+
+   const dist_status_t local2 = { .when = 30, .stop = true };
+   const dist_status_t global2 = dist_sync(local2, record_change);
+
+   if (!global2.stop || nchanges != 2 || changes[1].gid != 9)
+      return 7;
+   else if (memcmp(changes[1].data, reals, sizeof(reals)) != 0)
+      return 8;
+
+   dist_shutdown();
+   return 0;
+}
+
+START_TEST(test_loopback)
+{
+   const pid_t pid = fork();
+   if (pid == 0)
+      _exit(run_peer());
+
+   fail_if(pid < 0);
+
+   dist_init(make_top(), fname, 0, address);
+   fail_unless(dist_enabled());
+   fail_unless(dist_owns(ident_new(":top:a1")));
+   fail_if(dist_owns(ident_new(":top:b1")));
+
+   // Processes not matched by any rule run on node zero
+   fail_unless(dist_owns(ident_new(":top:c")));
+
+   dist_add_change(7, shorts, sizeof(uint16_t), ARRAY_LEN(shorts));
+
+   // Values arrive in host byte order and the earliest time wins
+   const dist_status_t local1 = { .when = 20 };
+   const dist_status_t global1 = dist_sync(local1, record_change);
+   fail_unless(global1.delta);
+   fail_if(global1.stop);
+   fail_unless(global1.when == 20);
+   fail_unless(nchanges == 1);
+   fail_unless(changes[0].gid == 5);
+   fail_unless(changes[0].len == sizeof(ints));
+   fail_unless(memcmp(changes[0].data, ints, sizeof(ints)) == 0);
+
+   dist_add_change(9, reals, sizeof(double), ARRAY_LEN(reals));
+
+   // A stop request from any node stops them all
+   const dist_status_t local2 = { .when = 40 };
+   const dist_status_t global2 = dist_sync(local2, record_change);
+   fail_unless(global2.stop);
+   fail_unless(nchanges == 1);
+
+   dist_shutdown();
+   fail_if(dist_enabled());
+
+   int status;
+   fail_unless(waitpid(pid, &status, 0) == pid);
+   fail_unless(WIFEXITED(status));
+   fail_unless(WEXITSTATUS(status) == 0);
+}
+END_TEST
+
+Suite *get_dist_tests(void)
+{
+   Suite *s = suite_create("dist");
+
+   TCase *tc_core = tcase_create("Core");
+   tcase_add_checked_fixture(tc_core, setup, teardown);
+   tcase_add_test(tc_core, test_loopback);
+   suite_add_tcase(s, tc_core);
+
+   return s;
+}
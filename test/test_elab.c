@@ -252,6 +252,9 @@ START_TEST(test_const1)
    fail_unless(tree_kind(ctr_r) == T_SIGNAL_DECL);
    fail_unless(tree_ident(ctr_r) == ident_new(":top:pwm_1:ctr_r"));
    fail_unless(tree_nets(ctr_r) == 15);
+
+   // Code translated to fold the constant is freed after elaboration
+   fail_unless(eval_code_cache_size() == 0);
 }
 END_TEST
 
@@ -629,6 +632,215 @@ START_TEST(test_issue374)
 }
 END_TEST
 
+START_TEST(test_cycle1)
+{
+   input_from_file(TESTDIR "/elab/cycle1.vhd");
+
+   tree_t e = run_elab();
+   fail_if(e == NULL);
+
+   cycle_regions(e);
+
+   static const struct {
+      const char *name;
+      int         level;
+   } expect[] = {
+      { ":cycle1:reg", -1 },
+      { ":cycle1:u:add", 0 },
+      { ":cycle1:dbl", 1 },
+      { ":cycle1:sum", 2 },
+      { ":cycle1:late", -1 },
+      { ":cycle1:loop1", -1 },
+      { ":cycle1:loop2", -1 },
+      { ":cycle1:other", -1 },
+      { ":cycle1:multi1", -1 },
+      { ":cycle1:multi2", -1 },
+   };
+
+   const int nstmts = tree_stmts(e);
+   for (size_t i = 0; i < ARRAY_LEN(expect); i++) {
+      tree_t p = NULL;
+      for (int j = 0; j < nstmts && p == NULL; j++) {
+         if (icmp(tree_ident(tree_stmt(e, j)), expect[i].name))
+            p = tree_stmt(e, j);
+      }
+
+      fail_if(p == NULL, "missing process %s", expect[i].name);
+      fail_unless(tree_attr_int(p, cycle_level_i, -1) == expect[i].level,
+                  "process %s has level %d", expect[i].name,
+                  tree_attr_int(p, cycle_level_i, -1));
+   }
+}
+END_TEST
+
+START_TEST(test_memo1)
+{
+   input_from_file(TESTDIR "/elab/memo1.vhd");
+
+   tree_t e = run_elab();
+   fail_if(e == NULL);
+
+   // The first two instances are identical after generic substitution
+   // but the last is connected to a literal
+   unsigned hits, misses;
+   elab_memo_stats(&hits, &misses);
+   fail_unless(hits == 1);
+   fail_unless(misses == 2);
+
+   const struct {
+      const char *name;
+      const char *port;
+      int64_t     index;
+   } expect[] = {
+      { ":memo1:u1:p", ":memo1:u1:i", 3 },
+      { ":memo1:u2:p", ":memo1:u2:i", 3 },
+      { ":memo1:u3:p", ":memo1:u3:i", 7 },
+   };
+
+   const int nstmts = tree_stmts(e);
+   for (size_t i = 0; i < ARRAY_LEN(expect); i++) {
+      tree_t p = NULL;
+      for (int j = 0; j < nstmts && p == NULL; j++) {
+         if (icmp(tree_ident(tree_stmt(e, j)), expect[i].name))
+            p = tree_stmt(e, j);
+      }
+
+      fail_if(p == NULL, "missing process %s", expect[i].name);
+
+      tree_t s0 = tree_stmt(p, 0);
+      fail_unless(tree_kind(s0) == T_SIGNAL_ASSIGN);
+      tree_t xor = tree_value(tree_waveform(s0, 0));
+      fail_unless(tree_kind(xor) == T_FCALL);
+      tree_t aref = tree_value(tree_param(xor, 0));
+      fail_unless(tree_kind(aref) == T_ARRAY_REF);
+      fail_unless(icmp(tree_ident(tree_ref(tree_value(aref))),
+                       expect[i].port));
+      tree_t index = tree_value(tree_param(aref, 0));
+      fail_unless(tree_kind(index) == T_LITERAL);
+      fail_unless(tree_ival(index) == expect[i].index);
+   }
+}
+END_TEST
+
+START_TEST(test_genfold)
+{
+   input_from_file(TESTDIR "/elab/genfold.vhd");
+
+   tree_t e = run_elab();
+   fail_if(e == NULL);
+
+   // Case statements on generics are replaced by the chosen alternative
+   const struct {
+      const char *prefix;
+      int         nassign;
+      int64_t     first;
+      int64_t     second;
+   } expect[] = {
+      { ":genfold:u1:", 1, 2, 3 },
+      { ":genfold:u2:", 0, 0, 4 },
+   };
+
+   const int nstmts = tree_stmts(e);
+   for (size_t i = 0; i < ARRAY_LEN(expect); i++) {
+      const size_t len = strlen(expect[i].prefix);
+
+      tree_t p = NULL;
+      for (int j = 0; j < nstmts && p == NULL; j++) {
+         tree_t s = tree_stmt(e, j);
+         if (tree_kind(s) == T_PROCESS
+             && strncmp(istr(tree_ident(s)), expect[i].prefix, len) == 0)
+            p = s;
+      }
+
+      fail_if(p == NULL, "missing process in %s", expect[i].prefix);
+
+      tree_t b0 = tree_stmt(p, 0);
+      fail_unless(tree_kind(b0) == T_BLOCK);
+      if (expect[i].nassign > 0) {
+         tree_t s = tree_stmt(b0, 0);
+         fail_unless(tree_kind(s) == T_SIGNAL_ASSIGN);
+         tree_t v = tree_value(tree_waveform(s, 0));
+         fail_unless(tree_ival(v) == expect[i].first);
+      }
+      else
+         fail_unless(tree_stmts(b0) == 0);
+
+      tree_t b1 = tree_stmt(p, 1);
+      fail_unless(tree_kind(b1) == T_BLOCK);
+      tree_t s = tree_stmt(b1, 0);
+      fail_unless(tree_kind(s) == T_SIGNAL_ASSIGN);
+      fail_unless(tree_ival(tree_value(tree_waveform(s, 0)))
+                  == expect[i].second);
+   }
+}
+END_TEST
+
+START_TEST(test_netrange)
+{
+   input_from_file(TESTDIR "/elab/netrange.vhd");
+
+   tree_t top = run_elab();
+   fail_if(top == NULL);
+
+   tree_t v = NULL, r = NULL, p = NULL, q = NULL;
+   const int ndecls = tree_decls(top);
+   for (int i = 0; i < ndecls; i++) {
+      tree_t d = tree_decl(top, i);
+      if (tree_kind(d) != T_SIGNAL_DECL)
+         continue;
+      else if (icmp(tree_ident(d), ":netrange:v"))
+         v = d;
+      else if (icmp(tree_ident(d), ":netrange:r"))
+         r = d;
+      else if (icmp(tree_ident(d), ":netrange:u:p"))
+         p = d;
+      else if (icmp(tree_ident(d), ":netrange:u:q"))
+         q = d;
+   }
+
+   fail_if(v == NULL || r == NULL || p == NULL || q == NULL);
+   fail_unless(tree_nets(v) == 16);
+   fail_unless(tree_nets(r) == 9);
+   fail_unless(tree_nets(p) == 8);
+   fail_unless(tree_nets(q) == 4);
+
+   // Each slice of the port shares a range of nets with the actual
+   for (int i = 0; i < 4; i++) {
+      fail_unless(tree_net(p, i) == tree_net(v, i));
+      fail_unless(tree_net(p, i + 4) == tree_net(r, i + 4));
+      fail_unless(tree_net(q, i) == tree_net(v, i + 12));
+   }
+}
+END_TEST
+
+START_TEST(test_blocked)
+{
+   input_from_file(TESTDIR "/elab/blocked.vhd");
+
+   tree_t e = run_elab();
+   fail_if(e == NULL);
+
+   // Processes that can never resume after initialisation are removed
+   // once the generics are folded
+   const char *expect[] = {
+      ":blocked:u1:check",
+      ":blocked:u2:idle",
+      ":blocked:drive",
+      ":blocked:init"
+   };
+
+   const int nstmts = tree_stmts(e);
+   fail_unless(nstmts == ARRAY_LEN(expect));
+
+   for (int i = 0; i < nstmts; i++) {
+      tree_t p = tree_stmt(e, i);
+      fail_unless(tree_kind(p) == T_PROCESS);
+      fail_unless(icmp(tree_ident(p), expect[i]),
+                  "unexpected process %s", istr(tree_ident(p)));
+   }
+}
+END_TEST
+
 Suite *get_elab_tests(void)
 {
    Suite *s = suite_create("elab");
@@ -675,6 +887,11 @@ Suite *get_elab_tests(void)
    tcase_add_test(tc, test_issue232);
    tcase_add_test(tc, test_issue373);
    tcase_add_test(tc, test_issue374);
+   tcase_add_test(tc, test_cycle1);
+   tcase_add_test(tc, test_memo1);
+   tcase_add_test(tc, test_genfold);
+   tcase_add_test(tc, test_netrange);
+   tcase_add_test(tc, test_blocked);
    suite_add_tcase(s, tc);
 
    return s;
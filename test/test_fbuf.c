@@ -0,0 +1,110 @@
+#include "util.h"
+#include "fbuf.h"
+
+#include <check.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define NVALUES 10000
+
+static char fname[64];
+static char tmpname[64];
+
+static void setup(void)
+{
+   checked_sprintf(fname, sizeof(fname), "test_fbuf_%d.bin", getpid());
+   checked_sprintf(tmpname, sizeof(tmpname), "test_fbuf_%d.tmp", getpid());
+}
+
+static void teardown(void)
+{
+   unlink(fname);
+   unlink(tmpname);
+   fbuf_set_codec(FBUF_CS_LZ4);
+}
+
+static void write_values(const char *path, uint32_t base)
+{
+   // The second half starts a new block so the reader can split there
+   fbuf_t *f = fbuf_open(path, FBUF_OUT);
+   fail_if(f == NULL);
+
+   for (uint32_t i = 0; i < NVALUES; i++) {
+      if (i == NVALUES / 2)
+         (void)fbuf_tell(f);
+      write_u32(base + i, f);
+   }
+
+   fbuf_close(f);
+}
+
+static fbuf_t *read_first_half(const char *path, uint32_t base)
+{
+   fbuf_t *f = fbuf_open(path, FBUF_IN);
+   fail_if(f == NULL);
+
+   for (uint32_t i = 0; i < NVALUES / 2; i++)
+      fail_unless(read_u32(f) == base + i);
+
+   fbuf_t *split = fbuf_split(f);
+   fbuf_close(f);
+   return split;
+}
+
+static void read_second_half(fbuf_t *f, uint32_t base)
+{
+   for (uint32_t i = NVALUES / 2; i < NVALUES; i++)
+      fail_unless(read_u32(f) == base + i);
+
+   fbuf_close(f);
+}
+
+START_TEST(test_split)
+{
+   // A split part shares the mapping of the original file and can still
+   // be read after the original is closed
+   const fbuf_cs_t codecs[] = { FBUF_CS_NONE, FBUF_CS_FASTLZ, FBUF_CS_LZ4 };
+   for (size_t i = 0; i < ARRAY_LEN(codecs); i++) {
+      fbuf_set_codec(codecs[i]);
+      write_values(fname, i * NVALUES);
+
+      fbuf_t *split = read_first_half(fname, i * NVALUES);
+      read_second_half(split, i * NVALUES);
+   }
+}
+END_TEST
+
+START_TEST(test_replaced)
+{
+   // Library units are saved by renaming a new file into place which
+   // leaves the pages of the old file mapped by the reader
+   write_values(fname, 0);
+
+   fbuf_t *a = read_first_half(fname, 0);
+   fbuf_t *b = read_first_half(fname, 0);
+
+   write_values(tmpname, NVALUES);
+   fail_if(rename(tmpname, fname) != 0);
+
+   read_second_half(a, 0);
+
+   fbuf_t *c = read_first_half(fname, NVALUES);
+   read_second_half(c, NVALUES);
+
+   read_second_half(b, 0);
+}
+END_TEST
+
+Suite *get_fbuf_tests(void)
+{
+   Suite *s = suite_create("fbuf");
+
+   TCase *tc_core = tcase_create("Core");
+   tcase_add_checked_fixture(tc_core, setup, teardown);
+   tcase_add_test(tc_core, test_split);
+   tcase_add_test(tc_core, test_replaced);
+   suite_add_tcase(s, tc_core);
+
+   return s;
+}
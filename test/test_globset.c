@@ -0,0 +1,74 @@
+#include "test_util.h"
+#include "rt/globset.h"
+
+#include <check.h>
+#include <stdlib.h>
+
+START_TEST(test_first)
+{
+   glob_set_t *g = glob_set_new();
+   fail_unless(glob_set_first(g, ident_new("foo")) == -1);
+
+   fail_unless(glob_set_add(g, ":top:u1:*") == 0);
+   fail_unless(glob_set_add(g, "*:clk") == 1);
+   fail_unless(glob_set_add(g, ":top:x") == 2);
+   fail_unless(glob_set_size(g) == 3);
+
+   fail_unless(glob_set_first(g, ident_new(":top:u1:a")) == 0);
+   fail_unless(glob_set_first(g, ident_new(":top:u1:clk")) == 0);
+   fail_unless(glob_set_first(g, ident_new(":top:u2:clk")) == 1);
+   fail_unless(glob_set_first(g, ident_new(":top:x")) == 2);
+   fail_unless(glob_set_first(g, ident_new(":top:xy")) == -1);
+   fail_unless(glob_set_first(g, ident_new(":top:u1:")) == -1);
+   fail_unless(glob_set_first(g, ident_new(":clk")) == -1);
+
+   glob_set_free(g);
+}
+END_TEST
+
+START_TEST(test_same_as_ident_glob)
+{
+   // Every pattern set must agree with matching each pattern in turn
+   static const char *patterns[] = {
+      "foobar", "*", "f*", "f*r", "f*b*r", "f*c*r", "**bar", "*:a",
+      "foo:*", "*o*", "a*a", "*ab*"
+   };
+   const int npatterns = ARRAY_LEN(patterns);
+
+   glob_set_t *g = glob_set_new();
+   for (int i = 0; i < npatterns; i++)
+      glob_set_add(g, patterns[i]);
+
+   for (int i = 0; i < 10000; i++) {
+      char buf[12];
+      const int len = (rand() % (sizeof(buf) - 2)) + 1;
+      for (int j = 0; j < len; j++)
+         buf[j] = "abfor:"[rand() % 6];
+      buf[len] = '\0';
+
+      ident_t id = ident_new(buf);
+
+      int expect = -1;
+      for (int j = 0; j < npatterns && expect == -1; j++) {
+         if (ident_glob(id, patterns[j], -1))
+            expect = j;
+      }
+
+      fail_unless(glob_set_first(g, id) == expect);
+   }
+
+   glob_set_free(g);
+}
+END_TEST
+
+Suite *get_globset_tests(void)
+{
+   Suite *s = suite_create("globset");
+
+   TCase *tc_core = nvc_unit_test();
+   tcase_add_test(tc_core, test_first);
+   tcase_add_test(tc_core, test_same_as_ident_glob);
+   suite_add_tcase(s, tc_core);
+
+   return s;
+}
@@ -18,32 +18,44 @@ typedef struct {
 static void group_dump(group_nets_ctx_t *ctx)
 {
    printf("-------------\n");
-   for (group_t *it = ctx->groups; it != NULL; it = it->next)
-      printf("%3d : %d..%d\n", it->gid, it->first, it->first + it->length - 1);
+   group_node_t **list = group_collect(ctx);
+   for (unsigned i = 0; i < ctx->ngroups; i++)
+      printf("%3d : %d..%d\n", list[i]->gid, list[i]->first,
+             list[i]->first + list[i]->length - 1);
+   free(list);
 }
 
 static bool group_sanity_check(group_nets_ctx_t *ctx, netid_t max)
 {
    bool error = false;
 
-   for (netid_t i = 0; i <= max; i++) {
-      bool have = false;
-      for (group_t *it = ctx->groups; it != NULL; it = it->next) {
-         if ((i >= it->first) && (i < it->first + it->length)) {
-            if (have) {
-               printf("net %d appears in multiple groups\n", i);
-               error = true;
-            }
-            have = true;
-         }
+   int *owner = xmalloc((max + 1) * sizeof(int));
+   for (netid_t i = 0; i <= max; i++)
+      owner[i] = 0;
+
+   group_node_t **list = group_collect(ctx);
+   for (unsigned i = 0; i < ctx->ngroups; i++) {
+      for (netid_t j = 0; j < list[i]->length; j++) {
+         const netid_t nid = list[i]->first + j;
+         if (nid <= max)
+            owner[nid]++;
       }
+   }
+   free(list);
 
-      if (!have) {
+   for (netid_t i = 0; i <= max; i++) {
+      if (owner[i] > 1) {
+         printf("net %d appears in multiple groups\n", i);
+         error = true;
+      }
+      else if (owner[i] == 0) {
          printf("net %d in no group\n", i);
          error = true;
       }
    }
 
+   free(owner);
+
    if (error)
       group_dump(ctx);
 
@@ -53,18 +65,17 @@ static bool group_sanity_check(group_nets_ctx_t *ctx, netid_t max)
 static void group_expect(group_nets_ctx_t *ctx, const group_expect_t *expect,
                          int n_expect)
 {
-   int ngroups = 0;
-   for (group_t *it = ctx->groups; it != NULL; it = it->next)
-      ngroups++;
-
+   const int ngroups = ctx->ngroups;
    const int n_expect_orig = n_expect;
 
+   group_node_t **list = group_collect(ctx);
+
    for (; n_expect-- > 0; expect++) {
       const int length = expect->last - expect->first + 1;
 
       bool found = false;
-      for (group_t *it = ctx->groups; (it != NULL) && !found; it = it->next) {
-         if ((it->first == expect->first) && (it->length == length))
+      for (int i = 0; (i < ngroups) && !found; i++) {
+         if ((list[i]->first == expect->first) && (list[i]->length == length))
             found = true;
       }
 
@@ -74,6 +85,8 @@ static void group_expect(group_nets_ctx_t *ctx, const group_expect_t *expect,
       }
    }
 
+   free(list);
+
    if (ngroups != n_expect_orig) {
       group_dump(ctx);
       fail("expected %d groups but have %d", n_expect_orig, ngroups);
@@ -482,6 +495,59 @@ START_TEST(test_issue371)
 }
 END_TEST
 
+START_TEST(test_random)
+{
+   group_nets_ctx_t ctx;
+   group_test_init(&ctx, NULL);
+
+   for (int i = 0; i < 5000; i++) {
+      const int first = rand() % DEFAULT_NNETS;
+      const int length = 1 + rand() % MIN(DEFAULT_NNETS - first, 16);
+      group_add(&ctx, first, length);
+   }
+
+   group_add(&ctx, 0, DEFAULT_NNETS);
+
+   fail_unless(group_sanity_check(&ctx, DEFAULT_NNETS - 1));
+
+   group_free_context(&ctx);
+}
+END_TEST
+
+START_TEST(test_many_slices)
+{
+   // A register file declared as one signal with each word then assigned
+   // separately in an arbitrary order
+
+   const int nwords = 1 << 20, width = 8;
+
+   group_nets_ctx_t ctx;
+   group_init_context(&ctx, nwords * width);
+
+   group_add(&ctx, 0, nwords * width);
+   for (int i = 0; i < nwords; i++) {
+      const int word = (i * 7919) & (nwords - 1);
+      group_add(&ctx, word * width, width);
+   }
+
+   // Assigning the whole signal again must not merge the words
+   fail_unless(group_add(&ctx, 0, nwords * width) == GROUPID_INVALID);
+
+   fail_unless(ctx.ngroups == nwords);
+
+   for (int i = 0; i < nwords; i += 4097) {
+      group_node_t *g = group_find(&ctx, i * width, width);
+      fail_if(g == NULL);
+      fail_unless(g->first == i * width);
+      fail_unless(g->length == width);
+   }
+
+   fail_unless(group_sanity_check(&ctx, nwords * width - 1));
+
+   group_free_context(&ctx);
+}
+END_TEST
+
 Suite *get_group_tests(void)
 {
    Suite *s = suite_create("group");
@@ -507,7 +573,13 @@ Suite *get_group_tests(void)
    tcase_add_test(tc_core, test_jcore2);
    tcase_add_test(tc_core, test_jcore4);
    tcase_add_test(tc_core, test_issue371);
+   tcase_add_test(tc_core, test_random);
    suite_add_tcase(s, tc_core);
 
+   TCase *tc_large = tcase_create("Large");
+   tcase_add_test(tc_large, test_many_slices);
+   tcase_set_timeout(tc_large, 60);
+   suite_add_tcase(s, tc_large);
+
    return s;
 }
@@ -6,7 +6,7 @@
 #include <string.h>
 #include <time.h>
 
-#define VOIDP(x) ((void *)(uintptr_t)x)
+#define VOIDP(x) ((void *)(uintptr_t)(x))
 
 START_TEST(test_basic)
 {
@@ -69,6 +69,201 @@ START_TEST(test_replace)
 }
 END_TEST;
 
+START_TEST(test_delete)
+{
+   hash_t *h = hash_new(8, true);
+
+   for (int i = 1; i <= 100; i++)
+      hash_put(h, VOIDP(i * 16), VOIDP(i));
+
+   for (int i = 1; i <= 100; i += 2)
+      fail_unless(hash_delete(h, VOIDP(i * 16)));
+
+   fail_if(hash_delete(h, VOIDP(16)));
+   fail_unless(hash_members(h) == 50);
+
+   for (int i = 1; i <= 100; i++) {
+      void *expect = (i % 2 == 0) ? VOIDP(i) : NULL;
+      fail_unless(hash_get(h, VOIDP(i * 16)) == expect);
+   }
+
+   hash_put(h, VOIDP(16), VOIDP(42));
+   fail_unless(hash_get(h, VOIDP(16)) == VOIDP(42));
+   fail_unless(hash_members(h) == 51);
+
+   hash_free(h);
+}
+END_TEST
+
+START_TEST(test_int_keys)
+{
+   hash_t *h = hash_new_kind(4, true, HASH_INT);
+
+   // Zero is a valid integer key
+   hash_put_int(h, 0, VOIDP(1));
+   for (uint32_t i = 1; i < 5000; i++)
+      hash_put_int(h, i * 3, VOIDP(i + 1));
+
+   fail_unless(hash_get_int(h, 0) == VOIDP(1));
+   for (uint32_t i = 1; i < 5000; i++)
+      fail_unless(hash_get_int(h, i * 3) == VOIDP(i + 1));
+   fail_unless(hash_get_int(h, 1) == NULL);
+
+   fail_unless(hash_put_int(h, 0, VOIDP(7)));
+   fail_unless(hash_get_int(h, 0) == VOIDP(7));
+   fail_unless(hash_delete_int(h, 0));
+   fail_unless(hash_get_int(h, 0) == NULL);
+   fail_unless(hash_members(h) == 4999);
+
+   hash_free(h);
+}
+END_TEST
+
+START_TEST(test_str_keys)
+{
+   hash_t *h = hash_new_kind(16, true, HASH_STR);
+
+   char buf[2][32];
+   for (int i = 0; i < 1000; i++) {
+      checked_sprintf(buf[0], sizeof(buf[0]), "key%d", i);
+      hash_put(h, strdup(buf[0]), VOIDP(i + 1));
+   }
+
+   // Lookups compare the characters not the pointer
+   for (int i = 0; i < 1000; i++) {
+      checked_sprintf(buf[1], sizeof(buf[1]), "key%d", i);
+      fail_unless(hash_get(h, buf[1]) == VOIDP(i + 1));
+   }
+   fail_unless(hash_get(h, "key1000") == NULL);
+   fail_unless(hash_delete(h, "key500"));
+   fail_unless(hash_get(h, "key500") == NULL);
+
+   hash_iter_t it = HASH_BEGIN;
+   const void *key;
+   void *value;
+   while (hash_iter(h, &it, &key, &value))
+      free((void *)key);
+
+   hash_free(h);
+}
+END_TEST
+
+START_TEST(test_reserve)
+{
+   hash_t *h = hash_new(2, false);
+
+   hash_put(h, VOIDP(8), VOIDP(1));
+   hash_reserve(h, 10000);
+
+   for (int i = 2; i < 10000; i++)
+      hash_put(h, VOIDP(i * 8), VOIDP(i));
+
+   fail_unless(hash_members(h) == 9999);
+   fail_unless(hash_get(h, VOIDP(8)) == VOIDP(1));
+   for (int i = 2; i < 10000; i++)
+      fail_unless(hash_get(h, VOIDP(i * 8)) == VOIDP(i));
+
+   hash_free(h);
+}
+END_TEST
+
+START_TEST(test_grow)
+{
+   // Entries are moved to the larger table a few at a time so check
+   // lookups, replacements, deletion and iteration part way through
+
+   hash_t *h = hash_new_kind(16, true, HASH_INT);
+
+   static const int N = 100000;
+
+   for (int i = 0; i < N; i++) {
+      hash_put_int(h, i, VOIDP(i + 1));
+      fail_unless(hash_get_int(h, i / 2) == VOIDP(i / 2 + 1));
+
+      if (i % 3 == 0)
+         fail_unless(hash_put_int(h, i / 3, VOIDP(i / 3 + 1)));
+
+      if (i % 5 == 4) {
+         fail_unless(hash_delete_int(h, i - 2));
+         fail_unless(hash_get_int(h, i - 2) == NULL);
+         hash_put_int(h, i - 2, VOIDP(i - 1));
+      }
+
+      if (i % 9973 == 0) {
+         unsigned count = 0;
+         hash_iter_t it = HASH_BEGIN;
+         const void *key;
+         void *value;
+         while (hash_iter(h, &it, &key, &value)) {
+            fail_unless(value == VOIDP((uintptr_t)key + 1));
+            count++;
+         }
+         fail_unless(count == i + 1);
+      }
+   }
+
+   fail_unless(hash_members(h) == N);
+   for (int i = 0; i < N; i++)
+      fail_unless(hash_get_int(h, i) == VOIDP(i + 1));
+
+   hash_free(h);
+}
+END_TEST
+
+START_TEST(test_replace_grow)
+{
+   hash_t *h = hash_new(4, false);
+
+   for (int i = 0; i < 1000; i++) {
+      hash_put(h, VOIDP(i * 4 + 4), VOIDP(i + 1));
+      hash_put(h, VOIDP(4), VOIDP(i + 2000));
+   }
+
+   int n = 0;
+   fail_unless(hash_get_nth(h, VOIDP(4), &n) == VOIDP(1));
+   for (int i = 0; i < 1000; i++) {
+      n = i + 1;
+      fail_unless(hash_get_nth(h, VOIDP(4), &n) == VOIDP(i + 2000));
+   }
+
+   fail_unless(hash_delete(h, VOIDP(4)));
+   n = 0;
+   fail_unless(hash_get_nth(h, VOIDP(4), &n) == VOIDP(2000));
+
+   hash_free(h);
+}
+END_TEST
+
+START_TEST(test_many)
+{
+   static const int N = 1 << 20;
+
+   hash_t *h = hash_new(16, true);
+
+   for (int i = 0; i < N; i++)
+      hash_put(h, VOIDP((i + 1) * 8), VOIDP(i));
+
+   uintptr_t sum = 0;
+   for (int j = 0; j < 4; j++) {
+      for (int i = 0; i < N; i++)
+         sum += (uintptr_t)hash_get(h, VOIDP(((i * 7919) % N + 1) * 8));
+   }
+
+   for (int i = 0; i < N; i += 2)
+      hash_delete(h, VOIDP((i + 1) * 8));
+
+   fail_unless(sum == 4 * ((uintptr_t)N * (N - 1) / 2));
+   fail_unless(hash_members(h) == N / 2);
+
+   // Only the odd keys remain after growing and deleting
+   for (int i = 0; i < N; i += 4097)
+      fail_unless(hash_get(h, VOIDP((i + 1) * 8))
+                  == ((i & 1) ? VOIDP(i) : NULL));
+
+   hash_free(h);
+}
+END_TEST
+
 Suite *get_hash_tests(void)
 {
    Suite *s = suite_create("hash");
@@ -77,6 +272,13 @@ Suite *get_hash_tests(void)
    tcase_add_test(tc_core, test_basic);
    tcase_add_test(tc_core, test_rand);
    tcase_add_test(tc_core, test_replace);
+   tcase_add_test(tc_core, test_delete);
+   tcase_add_test(tc_core, test_int_keys);
+   tcase_add_test(tc_core, test_str_keys);
+   tcase_add_test(tc_core, test_reserve);
+   tcase_add_test(tc_core, test_grow);
+   tcase_add_test(tc_core, test_replace_grow);
+   tcase_add_test(tc_core, test_many);
    suite_add_tcase(s, tc_core);
 
    return s;
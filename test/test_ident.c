@@ -284,6 +284,44 @@ START_TEST(test_suffix_until)
 }
 END_TEST
 
+START_TEST(test_new_n)
+{
+   const char *text = "entity foo_bar is";
+
+   ident_t i1 = ident_new_n(text + 7, 7);
+   fail_unless(i1 == ident_new("foo_bar"));
+   fail_unless(ident_new_n(text + 7, 3) == ident_new("foo"));
+   fail_unless(ident_new_n(text, 6) == ident_new("entity"));
+   fail_unless(ident_new_n(text + 15, 2) == ident_new("is"));
+   fail_unless(ident_len(i1) == 7);
+}
+END_TEST
+
+START_TEST(test_stable)
+{
+   // The string returned by istr stays valid and unchanged
+   ident_t i1 = ident_new("top");
+   ident_t i2 = ident_prefix(i1, ident_new("u_core"), ':');
+   const char *s1 = istr(i1);
+   const char *s2 = istr(i2);
+
+   for (int i = 0; i < 1000; i++) {
+      char buf[32];
+      checked_sprintf(buf, sizeof(buf), "u%d", i);
+      ident_t i3 = ident_prefix(i2, ident_new(buf), ':');
+      fail_unless(ident_len(i3) == ident_len(i2) + strlen(buf) + 1);
+      fail_unless(ident_prefix(i2, ident_new(buf), ':') == i3);
+      fail_unless(ident_runtil(i3, ':') == i2);
+   }
+
+   fail_unless(istr(i1) == s1);
+   fail_unless(istr(i2) == s2);
+   fail_unless(strcmp(s2, "top:u_core") == 0);
+   fail_unless(ident_strip(i2, i2) != NULL);
+   fail_unless(ident_len(ident_strip(i2, i2)) == 0);
+}
+END_TEST
+
 Suite *get_ident_tests(void)
 {
    Suite *s = suite_create("ident");
@@ -308,6 +346,8 @@ Suite *get_ident_tests(void)
    tcase_add_test(tc_core, test_len);
    tcase_add_test(tc_core, test_downcase);
    tcase_add_test(tc_core, test_suffix_until);
+   tcase_add_test(tc_core, test_new_n);
+   tcase_add_test(tc_core, test_stable);
    suite_add_tcase(s, tc_core);
 
    return s;
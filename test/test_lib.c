@@ -2,11 +2,19 @@
 #include "tree.h"
 #include "util.h"
 #include "common.h"
+#include "fbuf.h"
+#include "fastlz.h"
 
 #include <check.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 
 static lib_t work;
 static const char *tmp;
@@ -23,6 +31,9 @@ static void setup(void)
    char *path LOCAL = xasprintf("%s" PATH_SEP "test_lib", tmp);
    work = lib_new("test_lib", path);
    fail_if(work == NULL);
+
+   // Every test starts with the same default as the nvc binary
+   opt_set_int("ignore-time", 0);
 }
 
 static void teardown(void)
@@ -103,6 +114,69 @@ START_TEST(test_lib_fopen)
 }
 END_TEST
 
+START_TEST(test_lib_codecs)
+{
+   const fbuf_cs_t codecs[] = { FBUF_CS_NONE, FBUF_CS_FASTLZ, FBUF_CS_LZ4 };
+
+   fbuf_set_block_size(4096);
+
+   for (int i = 0; i < ARRAY_LEN(codecs); i++) {
+      fbuf_set_codec(codecs[i]);
+
+      // Enough data to span many blocks
+      fbuf_t *f = lib_fbuf_open(work, "_codec", FBUF_OUT);
+      fail_if(f == NULL);
+      for (uint32_t j = 0; j < 10000; j++) {
+         write_u32(j, f);
+         write_uint(j * 1000, f);
+         write_raw("hello", 5, f);
+      }
+      fbuf_close(f);
+
+      f = lib_fbuf_open(work, "_codec", FBUF_IN);
+      fail_if(f == NULL);
+      for (uint32_t j = 0; j < 10000; j++) {
+         fail_unless(read_u32(f) == j);
+         fail_unless(read_uint(f) == j * 1000);
+
+         char buf[5];
+         read_raw(buf, 5, f);
+         fail_unless(memcmp(buf, "hello", 5) == 0);
+      }
+      fbuf_close(f);
+   }
+
+   fbuf_set_codec(FBUF_CS_LZ4);
+   fbuf_set_block_size(256 * 1024);
+}
+END_TEST
+
+START_TEST(test_lib_legacy)
+{
+   // Files written before the header was added are a sequence of FastLZ
+   // blocks each prefixed with a big-endian length
+   uint8_t data[64], out[128];
+   for (int i = 0; i < ARRAY_LEN(data); i++)
+      data[i] = i / 4;
+
+   const int len = fastlz_compress_level(2, data, sizeof(data), out);
+   fail_unless(len > 0);
+
+   FILE *f = lib_fopen(work, "_legacy", "w");
+   fail_if(f == NULL);
+   const uint8_t blksz[4] = { 0, 0, 0, len };
+   fwrite(blksz, 4, 1, f);
+   fwrite(out, len, 1, f);
+   fclose(f);
+
+   fbuf_t *fb = lib_fbuf_open(work, "_legacy", FBUF_IN);
+   fail_if(fb == NULL);
+   for (int i = 0; i < ARRAY_LEN(data); i++)
+      fail_unless(read_u8(fb) == i / 4);
+   fbuf_close(fb);
+}
+END_TEST
+
 START_TEST(test_lib_save)
 {
    {
@@ -268,6 +342,243 @@ START_TEST(test_lib_save)
 }
 END_TEST
 
+START_TEST(test_lib_deferred)
+{
+   {
+      tree_t body = tree_new(T_PACK_BODY);
+      tree_set_ident(body, ident_new("pack-body"));
+
+      tree_t l = tree_new(T_LIBRARY);
+      tree_set_ident(l, ident_new("foo"));
+      tree_add_context(body, l);
+
+      type_t e = type_new(T_ENUM);
+      type_set_ident(e, ident_new("myenum"));
+      tree_t a = tree_new(T_ENUM_LIT);
+      tree_set_ident(a, ident_new("a"));
+      tree_set_type(a, e);
+      type_enum_add_literal(e, a);
+
+      tree_t v1 = tree_new(T_VAR_DECL);
+      tree_set_ident(v1, ident_new("v1"));
+      tree_set_type(v1, e);
+      tree_add_decl(body, v1);
+
+      tree_t v2 = tree_new(T_VAR_DECL);
+      tree_set_ident(v2, ident_new("v2"));
+      tree_set_type(v2, e);
+      tree_add_decl(body, v2);
+
+      tree_t r = tree_new(T_REF);
+      tree_set_ident(r, ident_new("v1"));
+      tree_set_ref(r, v1);
+      tree_set_type(r, e);
+
+      tree_t c = tree_new(T_CONST_DECL);
+      tree_set_ident(c, ident_new("c"));
+      tree_set_type(c, e);
+      tree_set_value(c, r);
+      tree_add_decl(body, c);
+
+      lib_put(work, body);
+   }
+
+   tree_gc();
+
+   lib_save(work);
+   lib_free(work);
+
+   lib_add_search_path(tmp);
+   work = lib_find(ident_new("test_lib"), false);
+   fail_if(work == NULL);
+
+   {
+      tree_t body = lib_get(work, ident_new("pack-body"));
+      fail_if(body == NULL);
+      fail_unless(tree_kind(body) == T_PACK_BODY);
+
+      // The context and number of declarations are known before any
+      // declaration is read
+      fail_unless(tree_contexts(body) == 1);
+      fail_unless(tree_ident(tree_context(body, 0)) == ident_new("foo"));
+      fail_unless(tree_decls(body) == 3);
+
+      tree_gc();
+
+      tree_t c = tree_decl(body, 2);
+      fail_unless(tree_kind(c) == T_CONST_DECL);
+      fail_unless(tree_ident(c) == ident_new("c"));
+
+      tree_t v1 = tree_decl(body, 0);
+      fail_unless(tree_ident(v1) == ident_new("v1"));
+      fail_unless(tree_ref(tree_value(c)) == v1);
+      fail_unless(tree_type(tree_decl(body, 1)) == tree_type(v1));
+      fail_unless(type_enum_literals(tree_type(c)) == 1);
+   }
+}
+END_TEST
+
+START_TEST(test_lib_index)
+{
+   ident_t e1_i = ident_new("e1"), e2_i = ident_new("e2");
+
+   {
+      tree_t e1 = tree_new(T_ENTITY);
+      tree_set_ident(e1, e1_i);
+      lib_put(work, e1);
+
+      tree_t e2 = tree_new(T_PACKAGE);
+      tree_set_ident(e2, e2_i);
+      lib_put(work, e2);
+   }
+
+   tree_gc();
+
+   lib_save(work);
+   lib_free(work);
+
+   lib_add_search_path(tmp);
+   work = lib_find(ident_new("test_lib"), false);
+   fail_if(work == NULL);
+
+   fail_unless(lib_index_size(work) == 2);
+   fail_unless(lib_index_kind(work, e1_i) == T_ENTITY);
+   fail_unless(lib_index_kind(work, e2_i) == T_PACKAGE);
+   fail_unless(lib_index_kind(work, ident_new("e3")) == T_LAST_TREE_KIND);
+
+   // The modification time is taken from the index without reading
+   // the unit and matches the file on disk
+   lib_mtime_t mt;
+   fail_unless(lib_stat(work, "e1", &mt));
+   fail_unless(lib_mtime(work, e1_i) == mt);
+
+   tree_t e1 = lib_get(work, e1_i);
+   fail_if(e1 == NULL);
+   fail_unless(tree_kind(e1) == T_ENTITY);
+   fail_unless(lib_mtime(work, e1_i) == mt);
+
+   fail_unless(lib_get(work, ident_new("e3")) == NULL);
+}
+END_TEST
+
+START_TEST(test_lib_touched)
+{
+   char *src LOCAL = xasprintf("%s" PATH_SEP "test_lib_src.vhd", tmp);
+
+   FILE *f = fopen(src, "w");
+   fail_if(f == NULL);
+   fputs("entity touched is end entity;\n", f);
+   fclose(f);
+
+   ident_t name_i = ident_new("touched");
+
+   {
+      tree_t e = tree_new(T_ENTITY);
+      tree_set_ident(e, name_i);
+
+      loc_t loc = LOC_INVALID;
+      loc.file = ident_new(src);
+      tree_set_loc(e, &loc);
+
+      lib_put(work, e);
+   }
+
+   tree_gc();
+
+   lib_save(work);
+   lib_free(work);
+
+   // Make the source look newer than the unit without changing it
+   struct timeval times[2];
+   gettimeofday(&times[0], NULL);
+   times[0].tv_sec += 100;
+   times[1] = times[0];
+   fail_unless(utimes(src, times) == 0);
+
+   lib_add_search_path(tmp);
+   work = lib_find(ident_new("test_lib"), false);
+   fail_if(work == NULL);
+
+   lib_mtime_t mt;
+   fail_unless(lib_stat(work, "touched", &mt));
+   fail_unless(mt < (lib_mtime_t)times[0].tv_sec * 1000000);
+
+   tree_t e = lib_get_check_stale(work, name_i);
+   fail_if(e == NULL);
+   fail_unless(tree_kind(e) == T_ENTITY);
+
+   remove(src);
+}
+END_TEST
+
+static int count_hidden(lib_t lib)
+{
+   DIR *d = opendir(lib_path(lib));
+   fail_if(d == NULL);
+
+   int count = 0;
+   struct dirent *e;
+   while ((e = readdir(d))) {
+      if (e->d_name[0] == '.' && strcmp(e->d_name, ".") != 0
+          && strcmp(e->d_name, "..") != 0)
+         count++;
+   }
+
+   closedir(d);
+   return count;
+}
+
+static bool lib_has_file(lib_t lib, const char *name)
+{
+   char path[PATH_MAX];
+   lib_realpath(lib, name, path, sizeof(path));
+   return access(path, F_OK) == 0;
+}
+
+START_TEST(test_lib_temp)
+{
+   tree_t e1 = tree_new(T_ENTITY);
+   tree_set_ident(e1, ident_new("temp"));
+   lib_put(work, e1);
+
+   // Each unit and the index are written to a temporary file which is
+   // then renamed into place
+   lib_save(work);
+   fail_unless(lib_has_file(work, "temp"));
+   fail_unless(count_hidden(work) == 0);
+
+   const pid_t pid = fork();
+   if (pid == 0)
+      _exit(0);
+
+   fail_if(pid < 0);
+   fail_unless(waitpid(pid, NULL, 0) == pid);
+
+   char stale[64], live[64];
+   checked_sprintf(stale, sizeof(stale), ".temp.%d", pid);
+   checked_sprintf(live, sizeof(live), ".temp.%d", getpid());
+
+   fclose(lib_fopen(work, stale, "w"));
+   fclose(lib_fopen(work, live, "w"));
+   fail_unless(count_hidden(work) == 2);
+
+   // Opening the library again removes the file left by the process
+   // which exited but not the one still being written
+   lib_free(work);
+
+   lib_add_search_path(tmp);
+   work = lib_find(ident_new("test_lib"), false);
+   fail_if(work == NULL);
+
+   fail_if(lib_has_file(work, stale));
+   fail_unless(lib_has_file(work, live));
+
+   char path[PATH_MAX];
+   lib_realpath(work, live, path, sizeof(path));
+   unlink(path);
+}
+END_TEST
+
 Suite *get_lib_tests(void)
 {
    Suite *s = suite_create("lib");
@@ -276,7 +587,13 @@ Suite *get_lib_tests(void)
    tcase_add_checked_fixture(tc_core, setup, teardown);
    tcase_add_test(tc_core, test_lib_new);
    tcase_add_test(tc_core, test_lib_fopen);
+   tcase_add_test(tc_core, test_lib_codecs);
+   tcase_add_test(tc_core, test_lib_legacy);
    tcase_add_test(tc_core, test_lib_save);
+   tcase_add_test(tc_core, test_lib_deferred);
+   tcase_add_test(tc_core, test_lib_index);
+   tcase_add_test(tc_core, test_lib_touched);
+   tcase_add_test(tc_core, test_lib_temp);
    suite_add_tcase(s, tc_core);
 
    return s;
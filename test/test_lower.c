@@ -2,8 +2,11 @@
 #include "phase.h"
 #include "vcode.h"
 #include "common.h"
+#include "fbuf.h"
 
 #include <inttypes.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 typedef struct {
    vcode_op_t    op;
@@ -338,6 +341,18 @@ static vcode_unit_t find_unit(tree_t t)
    return vu;
 }
 
+static int find_op(vcode_op_t kind)
+{
+   const int nops = vcode_count_ops();
+   for (int i = 0; i < nops; i++) {
+      if (vcode_get_op(i) == kind)
+         return i;
+   }
+
+   fail("missing %s op", vcode_op_string(kind));
+   return -1;
+}
+
 START_TEST(test_wait1)
 {
    input_from_file(TESTDIR "/lower/wait1.vhd");
@@ -2882,6 +2897,8 @@ START_TEST(test_tounsigned)
 {
    input_from_file(TESTDIR "/lower/tounsigned.vhd");
 
+   opt_set_int("vcode-opt", 0);
+
    tree_t p = parse_check_and_simplify(T_PACKAGE, T_PACK_BODY);
    lower_unit(p);
 
@@ -2991,6 +3008,66 @@ START_TEST(test_tounsigned)
    };
 
    CHECK_BB(6);
+
+   // The loop bound minus one is computed once before the loop
+   opt_set_int("vcode-opt", 1);
+   vcode_opt();
+
+   {
+      EXPECT_BB(4) = {
+         { VCODE_OP_CONST, .value = 0 },
+         { VCODE_OP_LOAD, .name = "RESULT" },
+         { VCODE_OP_LOAD, .name = "I.MAINLOOP" },
+         { VCODE_OP_CONST, .value = 0 },
+         { VCODE_OP_CONST, .value = 1 },
+         { VCODE_OP_DYNAMIC_BOUNDS },
+         { VCODE_OP_SUB },
+         { VCODE_OP_SUB },
+         { VCODE_OP_UARRAY_DIR },
+         { VCODE_OP_SELECT },
+         { VCODE_OP_CAST },
+         { VCODE_OP_UNWRAP },
+         { VCODE_OP_ADD },
+         { VCODE_OP_STORE_INDIRECT },
+         { VCODE_OP_JUMP, .target = 6 },
+      };
+
+      CHECK_BB(4);
+
+      EXPECT_BB(5) = {
+         { VCODE_OP_CONST, .value = 1 },
+         { VCODE_OP_LOAD, .name = "RESULT" },
+         { VCODE_OP_LOAD, .name = "I.MAINLOOP" },
+         { VCODE_OP_CONST, .value = 0 },
+         { VCODE_OP_CONST, .value = 1 },
+         { VCODE_OP_DYNAMIC_BOUNDS },
+         { VCODE_OP_SUB },
+         { VCODE_OP_SUB },
+         { VCODE_OP_UARRAY_DIR },
+         { VCODE_OP_SELECT },
+         { VCODE_OP_CAST },
+         { VCODE_OP_UNWRAP },
+         { VCODE_OP_ADD },
+         { VCODE_OP_STORE_INDIRECT },
+         { VCODE_OP_JUMP, .target = 6 }
+      };
+
+      CHECK_BB(5);
+
+      EXPECT_BB(6) = {
+         { VCODE_OP_LOAD, .name = "I_VAL" },
+         { VCODE_OP_CONST, .value = 2 },
+         { VCODE_OP_DIV },
+         { VCODE_OP_STORE, .name = "I_VAL" },
+         { VCODE_OP_LOAD, .name = "I.MAINLOOP" },
+         { VCODE_OP_ADDI, .value = 1 },
+         { VCODE_OP_STORE, .name = "I.MAINLOOP" },
+         { VCODE_OP_CMP, .cmp = VCODE_CMP_EQ },
+         { VCODE_OP_COND, .target = 2, .target_else = 3 }
+      };
+
+      CHECK_BB(6);
+   }
 }
 END_TEST
 
@@ -3065,6 +3142,8 @@ START_TEST(test_sum)
 {
    input_from_file(TESTDIR "/lower/sum.vhd");
 
+   opt_set_int("vcode-opt", 0);
+
    tree_t p = parse_check_and_simplify(T_PACKAGE, T_PACK_BODY);
    bounds_check(p);
    fail_if(bounds_errors() > 0);
@@ -3112,6 +3191,262 @@ START_TEST(test_sum)
    };
 
    CHECK_BB(3);
+
+   // The array attributes computed before the loop are reused
+   opt_set_int("vcode-opt", 1);
+   vcode_opt();
+
+   {
+      EXPECT_BB(3) = {
+         { VCODE_OP_LOAD, .name = "RESULT" },
+         { VCODE_OP_LOAD, .name = "I.line_11" },
+         { VCODE_OP_SUB },
+         { VCODE_OP_SUB },
+         { VCODE_OP_SELECT },
+         { VCODE_OP_CAST },
+         { VCODE_OP_UNWRAP },
+         { VCODE_OP_ADD },
+         { VCODE_OP_LOAD_INDIRECT },
+         { VCODE_OP_ADD },
+         { VCODE_OP_BOUNDS, .low = INT32_MIN, .high = INT32_MAX },
+         { VCODE_OP_STORE, .name = "RESULT" },
+         { VCODE_OP_ADD },
+         { VCODE_OP_STORE, .name = "I.line_11" },
+         { VCODE_OP_CMP, .cmp = VCODE_CMP_EQ },
+         { VCODE_OP_COND, .target = 2, .target_else = 3 }
+      };
+
+      CHECK_BB(3);
+   }
+}
+END_TEST
+
+START_TEST(test_signal15)
+{
+   input_from_file(TESTDIR "/lower/signal15.vhd");
+
+   tree_t e = run_elab();
+   lower_unit(e);
+
+   vcode_unit_t v0 = find_unit(tree_stmt(e, 0));
+   vcode_select_unit(v0);
+
+   // The three adjacent elements of S are driven by one transaction
+   vcode_select_block(1);
+
+   int nsched = 0;
+   const int nops = vcode_count_ops();
+   for (int i = 0; i < nops; i++) {
+      if (vcode_get_op(i) == VCODE_OP_SCHED_WAVEFORM) {
+         int64_t count;
+         fail_unless(vcode_reg_const(vcode_get_arg(i, 1), &count));
+         fail_unless(count == (nsched == 0 ? 3 : 1));
+         nsched++;
+      }
+   }
+
+   fail_unless(nsched == 2);
+}
+END_TEST
+
+START_TEST(test_vcode_cse)
+{
+   input_from_file(TESTDIR "/lower/vcodeopt.vhd");
+
+   opt_set_int("vcode-opt", 0);
+
+   tree_t p = parse_check_and_simplify(T_PACKAGE, T_PACK_BODY);
+   lower_unit(p);
+
+   vcode_unit_t v0 = find_unit(tree_decl(p, 1));
+   vcode_select_unit(v0);
+
+   EXPECT_BB(1) = {
+      { VCODE_OP_UARRAY_LEN },
+      { VCODE_OP_CAST },
+      { VCODE_OP_STORE, .name = "R" },
+      { VCODE_OP_JUMP, .target = 2 }
+   };
+
+   CHECK_BB(1);
+
+   EXPECT_BB(2) = {
+      { VCODE_OP_LOAD, .name = "R" },
+      { VCODE_OP_UARRAY_LEN },
+      { VCODE_OP_CAST },
+      { VCODE_OP_ADD },
+      { VCODE_OP_BOUNDS, .low = INT32_MIN, .high = INT32_MAX },
+      { VCODE_OP_RETURN }
+   };
+
+   CHECK_BB(2);
+
+   // The length computed in the entry block is reused by the blocks it
+   // dominates
+   opt_set_int("vcode-opt", 1);
+   vcode_opt();
+
+   {
+      EXPECT_BB(1) = {
+         { VCODE_OP_STORE, .name = "R" },
+         { VCODE_OP_JUMP, .target = 2 }
+      };
+
+      CHECK_BB(1);
+
+      EXPECT_BB(2) = {
+         { VCODE_OP_LOAD, .name = "R" },
+         { VCODE_OP_ADD },
+         { VCODE_OP_BOUNDS, .low = INT32_MIN, .high = INT32_MAX },
+         { VCODE_OP_RETURN }
+      };
+
+      CHECK_BB(2);
+   }
+
+   vcode_select_block(0);
+   const vcode_reg_t len = vcode_get_result(find_op(VCODE_OP_CAST));
+   vcode_select_block(2);
+   fail_unless(vcode_get_arg(find_op(VCODE_OP_ADD), 1) == len);
+}
+END_TEST
+
+START_TEST(test_vcode_bounds)
+{
+   input_from_file(TESTDIR "/lower/vcodeopt.vhd");
+
+   opt_set_int("vcode-opt", 0);
+
+   tree_t p = parse_check_and_simplify(T_PACKAGE, T_PACK_BODY);
+   lower_unit(p);
+
+   vcode_unit_t v0 = find_unit(tree_decl(p, 2));
+   vcode_select_unit(v0);
+
+   EXPECT_BB(1) = {
+      { VCODE_OP_BOUNDS, .low = 0, .high = INT32_MAX },
+      { VCODE_OP_STORE, .name = "N" },
+      { VCODE_OP_JUMP, .target = 2 }
+   };
+
+   CHECK_BB(1);
+
+   // The branch into block 1 is only taken when X >= 0
+   opt_set_int("vcode-opt", 1);
+   vcode_opt();
+
+   {
+      EXPECT_BB(1) = {
+         { VCODE_OP_STORE, .name = "N" },
+         { VCODE_OP_JUMP, .target = 2 }
+      };
+
+      CHECK_BB(1);
+   }
+}
+END_TEST
+
+START_TEST(test_vcode_fold)
+{
+   vcode_unit_t context = emit_context(ident_new("WORK.FOLD"));
+   vcode_type_t vint = vtype_int(0, 10);
+   emit_function(ident_new("WORK.FOLD.FN"), context, vint);
+
+   vcode_block_t b1 = emit_block();
+   vcode_block_t b2 = emit_block();
+
+   vcode_reg_t one = emit_const(vint, 1);
+   vcode_reg_t two = emit_const(vint, 2);
+   emit_case(two, b1, &one, &b2, 1);
+
+   vcode_select_block(b1);
+   emit_return(two);
+
+   vcode_select_block(b2);
+   emit_return(one);
+
+   // The case on a constant becomes a jump to the default block and
+   // the other block can no longer be reached
+   vcode_opt();
+
+   EXPECT_BB(0) = {
+      { VCODE_OP_CONST, .value = 2 },
+      { VCODE_OP_JUMP, .target = 1 }
+   };
+
+   CHECK_BB(0);
+
+   EXPECT_BB(1) = {
+      { VCODE_OP_RETURN }
+   };
+
+   CHECK_BB(1);
+
+   vcode_select_block(b2);
+   fail_unless(vcode_count_ops() == 0);
+
+   vcode_close();
+}
+END_TEST
+
+static int count_unit_ops(vcode_unit_t vu)
+{
+   vcode_select_unit(vu);
+
+   int nops = 0;
+   for (int i = 0; i < vcode_count_blocks(); i++) {
+      vcode_select_block(i);
+      nops += vcode_count_ops();
+   }
+
+   return nops;
+}
+
+START_TEST(test_vcode_file)
+{
+   input_from_file(TESTDIR "/lower/vcodeopt.vhd");
+
+   tree_t p = parse_check_and_simplify(T_PACKAGE, T_PACK_BODY);
+   vcode_unit_t context = lower_unit(p);
+
+   ident_t names[2];
+   int nops[2];
+   for (int i = 0; i < 2; i++) {
+      names[i] = tree_attr_str(tree_decl(p, i + 1), mangled_i);
+      nops[i] = count_unit_ops(find_unit(tree_decl(p, i + 1)));
+   }
+
+   char *path LOCAL = xasprintf("%s/test_lower_%d.vcode",
+                                getenv("TEMP") ?: "/tmp", getpid());
+
+   fbuf_t *f = fbuf_open(path, FBUF_OUT);
+   fail_if(f == NULL);
+   vcode_write(context, f);
+   fbuf_close(f);
+
+   for (int i = 0; i < 2; i++)
+      vcode_unit_unref(vcode_find_unit(names[i]));
+   vcode_unit_unref(context);
+
+   fail_unless(vcode_find_unit(names[0]) == NULL);
+   fail_unless(vcode_find_unit(names[1]) == NULL);
+
+   // Each unit is decoded from the file through the index when it is
+   // first looked up, here in the opposite order to how it was written
+   f = fbuf_open(path, FBUF_IN);
+   fail_if(f == NULL);
+   vcode_read(f);
+
+   for (int i = 1; i >= 0; i--) {
+      vcode_unit_t vu = vcode_find_unit(names[i]);
+      fail_if(vu == NULL);
+      fail_unless(count_unit_ops(vu) == nops[i]);
+      fail_unless(vcode_unit_name() == names[i]);
+      fail_unless(vcode_unit_kind() == VCODE_UNIT_FUNCTION);
+   }
+
+   vcode_close();
+   unlink(path);
 }
 END_TEST
 
@@ -3189,6 +3524,11 @@ Suite *get_lower_tests(void)
    tcase_add_test(tc, test_signal11);
    tcase_add_test(tc, test_access1);
    tcase_add_test(tc, test_sum);
+   tcase_add_test(tc, test_signal15);
+   tcase_add_test(tc, test_vcode_cse);
+   tcase_add_test(tc, test_vcode_bounds);
+   tcase_add_test(tc, test_vcode_fold);
+   tcase_add_test(tc, test_vcode_file);
    suite_add_tcase(s, tc);
 
    return s;
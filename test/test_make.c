@@ -0,0 +1,198 @@
+#include "test_util.h"
+#include "phase.h"
+#include "lib.h"
+#include "common.h"
+
+#include <check.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <utime.h>
+
+#define MAX_JOBS 8
+
+static const char *sources[] = {
+   "package pack is\n"
+   "    constant k : integer := 5;\n"
+   "end package;\n",
+
+   "use work.pack.all;\n"
+   "entity ent is\n"
+   "end entity;\n"
+   "architecture a of ent is\n"
+   "    signal x : integer := k;\n"
+   "begin\n"
+   "end architecture;\n",
+
+   "entity top is\n"
+   "end entity;\n"
+   "architecture a of top is\n"
+   "begin\n"
+   "    u: entity work.ent;\n"
+   "end architecture;\n"
+};
+
+static const char *names[] = { "pack", "ent", "top" };
+
+static char  paths[ARRAY_LEN(sources)][PATH_MAX];
+static lib_t lib;
+static int   job_fd = -1;
+static char  fail_name[16];
+
+static void write_sources(const char *dir)
+{
+   for (size_t i = 0; i < ARRAY_LEN(sources); i++) {
+      checked_sprintf(paths[i], PATH_MAX, "%s/test_make_%d_%s.vhd",
+                      dir, getpid(), names[i]);
+
+      FILE *f = fopen(paths[i], "w");
+      fail_if(f == NULL);
+      fputs(sources[i], f);
+      fclose(f);
+   }
+}
+
+static int record_job(const char *command, const char *arg)
+{
+   // Runs in the forked child so the parent learns the order of jobs
+   // through the pipe
+
+   const char *base = strrchr(arg, '_') + 1;
+   char line[32];
+   const int len = checked_sprintf(line, sizeof(line), "%.*s ",
+                                   (int)strcspn(base, "."), base);
+   if (write(job_fd, line, len) != len)
+      return 2;
+
+   const size_t len_fail = strlen(fail_name);
+   return len_fail > 0 && strncmp(base, fail_name, len_fail) == 0;
+}
+
+static int run_build(int jobs, char *order, size_t size)
+{
+   int fds[2];
+   fail_if(pipe(fds) != 0);
+   job_fd = fds[1];
+
+   // The jobs print the commands they run and the skipped rules a
+   // warning which are not part of the test
+   fflush(NULL);
+   const int saved_out = dup(STDOUT_FILENO);
+   const int saved_err = dup(STDERR_FILENO);
+   const int null_fd = open("/dev/null", O_WRONLY);
+   dup2(null_fd, STDOUT_FILENO);
+   dup2(null_fd, STDERR_FILENO);
+   close(null_fd);
+
+   const int status = make_build(NULL, 0, jobs, record_job);
+
+   fflush(NULL);
+   dup2(saved_out, STDOUT_FILENO);
+   dup2(saved_err, STDERR_FILENO);
+   close(saved_out);
+   close(saved_err);
+
+   close(fds[1]);
+   const ssize_t n = read(fds[0], order, size - 1);
+   fail_if(n < 0);
+   order[n] = '\0';
+   close(fds[0]);
+
+   return status;
+}
+
+static void setup(void)
+{
+   const char *tmp = getenv("TEMP") ?: "/tmp";
+
+   char *dir LOCAL = xasprintf("%s/test_make.%d", tmp, getpid());
+   write_sources(tmp);
+
+   lib = lib_new("test_make", dir);
+   fail_if(lib == NULL);
+   lib_set_work(lib);
+
+   const tree_kind_t kinds[][2] = {
+      { T_PACKAGE, -1 },
+      { T_ENTITY, T_ARCH },
+      { T_ENTITY, T_ARCH }
+   };
+
+   for (size_t i = 0; i < ARRAY_LEN(sources); i++) {
+      input_from_file(paths[i]);
+      _parse_and_check(kinds[i], kinds[i][1] == -1 ? 1 : 2, true, false);
+   }
+
+   opt_set_int("make-deps-only", 0);
+   fail_name[0] = '\0';
+}
+
+static void teardown(void)
+{
+   for (size_t i = 0; i < ARRAY_LEN(sources); i++)
+      unlink(paths[i]);
+
+   lib_set_work(NULL);
+   lib_destroy(lib);
+   lib_free(lib);
+   lib = NULL;
+}
+
+START_TEST(test_order)
+{
+   // Nothing has been saved so every rule is out of date and each
+   // must wait for the rules it depends on even with spare jobs
+   char order[64];
+   fail_unless(run_build(MAX_JOBS, order, sizeof(order)) == EXIT_SUCCESS);
+   fail_unless(strcmp(order, "pack ent top ") == 0);
+}
+END_TEST
+
+START_TEST(test_failed)
+{
+   // A failed rule stops everything that depends on it
+   strcpy(fail_name, "pack");
+
+   char order[64];
+   fail_unless(run_build(1, order, sizeof(order)) == EXIT_FAILURE);
+   fail_unless(strcmp(order, "pack ") == 0);
+}
+END_TEST
+
+START_TEST(test_current)
+{
+   lib_save(lib);
+
+   char order[64];
+   fail_unless(run_build(1, order, sizeof(order)) == EXIT_SUCCESS);
+   fail_unless(strcmp(order, "") == 0);
+
+   // Changing a source rebuilds its rule and every rule which depends
+   // on it but not the rules it depends on
+   struct utimbuf ut = {
+      .actime  = time(NULL) + 10,
+      .modtime = time(NULL) + 10
+   };
+   fail_if(utime(paths[1], &ut) != 0);
+
+   fail_unless(run_build(MAX_JOBS, order, sizeof(order)) == EXIT_SUCCESS);
+   fail_unless(strcmp(order, "ent top ") == 0);
+}
+END_TEST
+
+Suite *get_make_tests(void)
+{
+   Suite *s = suite_create("make");
+
+   TCase *tc_core = nvc_unit_test();
+   tcase_add_checked_fixture(tc_core, setup, teardown);
+   tcase_add_test(tc_core, test_order);
+   tcase_add_test(tc_core, test_failed);
+   tcase_add_test(tc_core, test_current);
+   suite_add_tcase(s, tc_core);
+
+   return s;
+}
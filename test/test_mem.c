@@ -0,0 +1,117 @@
+#include "util.h"
+#include "mem.h"
+
+#include <check.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+static unsigned samples = 0;
+
+static void count_source(void)
+{
+   samples++;
+   mem_record("test", "item", samples, samples * 1024);
+}
+
+static int run_child(int (*fn)(void))
+{
+   // The accounting state is global so each test runs in a new process
+   const pid_t pid = fork();
+   if (pid == 0) {
+      if (freopen("/dev/null", "w", stderr) == NULL)
+         _exit(99);
+      _exit((*fn)());
+   }
+
+   fail_if(pid < 0);
+
+   int status;
+   fail_unless(waitpid(pid, &status, 0) == pid);
+   fail_unless(WIFEXITED(status));
+   return WEXITSTATUS(status);
+}
+
+static int sources_child(void)
+{
+   mem_set_budget(SIZE_MAX / 2);
+   mem_add_source(count_source);
+
+   // A new source is always sampled at the next check
+   mem_check("first");
+   if (samples != 1)
+      return 1;
+
+   // Removing a source samples it once more
+   mem_remove_source(count_source);
+   if (samples != 2)
+      return 2;
+
+   mem_check("second");
+   if (samples != 2 || mem_constrained())
+      return 3;
+
+   return 0;
+}
+
+START_TEST(test_sources)
+{
+   fail_unless(run_child(sources_child) == 0);
+}
+END_TEST
+
+static int constrained_child(void)
+{
+   // Sampling the sources the first time can touch pages not yet
+   // resident in the child
+   mem_set_budget(SIZE_MAX / 2);
+   mem_check("warm up");
+
+   nvc_rusage_t ru;
+   nvc_rusage_total(&ru);
+
+   // Past three quarters of the budget but not over it
+   mem_set_budget((size_t)ru.rss * 1024 / 10 * 12);
+   if (mem_constrained())
+      return 1;
+
+   mem_check("constrained");
+   if (!mem_constrained())
+      return 2;
+
+   return 0;
+}
+
+START_TEST(test_constrained)
+{
+   fail_unless(run_child(constrained_child) == 0);
+}
+END_TEST
+
+static int exceeded_child(void)
+{
+   mem_set_budget(1024);
+   mem_check("exceeded");
+   return 0;
+}
+
+START_TEST(test_exceeded)
+{
+   fail_unless(run_child(exceeded_child) == EXIT_FAILURE);
+}
+END_TEST
+
+Suite *get_mem_tests(void)
+{
+   Suite *s = suite_create("mem");
+
+   TCase *tc_core = tcase_create("Core");
+   tcase_add_test(tc_core, test_sources);
+   tcase_add_test(tc_core, test_constrained);
+   tcase_add_test(tc_core, test_exceeded);
+   suite_add_tcase(s, tc_core);
+
+   return s;
+}
@@ -0,0 +1,177 @@
+#include "util.h"
+#include "rt/nvtapi.h"
+
+#include <check.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#define NCHANGES 100000
+
+typedef struct {
+   uint64_t times[16];
+   uint64_t values[16][4];
+   unsigned count;
+   unsigned nchanges;
+} collect_t;
+
+static char fname[64];
+
+static void setup(void)
+{
+   checked_sprintf(fname, sizeof(fname), "test_nvt_%d.nvt", getpid());
+}
+
+static void teardown(void)
+{
+   unlink(fname);
+}
+
+static void collect_fn(uint64_t when, const uint64_t *values,
+                       unsigned count, void *context)
+{
+   collect_t *c = context;
+   fail_unless(c->nchanges < 16);
+   c->times[c->nchanges] = when;
+   memcpy(c->values[c->nchanges], values, count * sizeof(uint64_t));
+   c->count = count;
+   c->nchanges++;
+}
+
+static void count_fn(uint64_t when, const uint64_t *values,
+                     unsigned count, void *context)
+{
+   // The counter signal has value i at time 10 * i
+   uint64_t *next = context;
+   fail_unless(when == *next * 10);
+   fail_unless(values[0] == (*next & 0xffff));
+   fail_unless(values[1] == *next * 3);
+   (*next)++;
+}
+
+START_TEST(test_roundtrip)
+{
+   nvt_writer_t *w = nvt_writer_open(fname);
+   const int cnt = nvt_writer_add(w, ":top:cnt", "rec", 2, 8);
+   const int bit = nvt_writer_add(w, ":top:bit", "BIT", 1, 1);
+   const int vec = nvt_writer_add(w, ":top:vec", "BIT_VECTOR", 4, 1);
+   fail_unless(cnt == 0);
+   fail_unless(bit == 1);
+   fail_unless(vec == 2);
+
+   // Enough changes to span many blocks with the streams interleaved
+   for (uint64_t i = 0; i < NCHANGES; i++) {
+      const uint64_t v[2] = { i & 0xffff, i * 3 };
+      nvt_writer_change(w, cnt, i * 10, v);
+
+      if (i % 1000 == 0) {
+         const uint64_t b = (i / 1000) & 1;
+         nvt_writer_change(w, bit, i * 10, &b);
+      }
+   }
+
+   const uint64_t v1[4] = { 1, 0, 1, 0 };
+   nvt_writer_change(w, vec, 55, v1);
+
+   nvt_writer_close(w);
+
+   nvt_reader_t *r = nvt_reader_open(fname);
+   fail_if(r == NULL);
+
+   fail_unless(nvt_reader_signals(r) == 3);
+   fail_unless(nvt_reader_find(r, ":top:bit") == bit);
+   fail_unless(nvt_reader_find(r, ":top:nothere") == -1);
+   fail_unless(strcmp(nvt_reader_name(r, vec), ":top:vec") == 0);
+   fail_unless(strcmp(nvt_reader_type(r, cnt), "rec") == 0);
+   fail_unless(nvt_reader_count(r, cnt) == 2);
+   fail_unless(nvt_reader_count(r, vec) == 4);
+
+   uint64_t next = 0;
+   nvt_reader_read(r, cnt, 0, UINT64_MAX, count_fn, &next);
+   fail_unless(next == NCHANGES);
+
+   collect_t c = {};
+   nvt_reader_read(r, vec, 0, 1000, collect_fn, &c);
+   fail_unless(c.nchanges == 1);
+   fail_unless(c.times[0] == 55);
+   fail_unless(c.count == 4);
+   fail_unless(memcmp(c.values[0], v1, sizeof(v1)) == 0);
+
+   nvt_reader_close(r);
+}
+END_TEST
+
+START_TEST(test_window)
+{
+   nvt_writer_t *w = nvt_writer_open(fname);
+   const int cnt = nvt_writer_add(w, "cnt", "", 2, 4);
+   const int bit = nvt_writer_add(w, "bit", "", 1, 1);
+
+   for (uint64_t i = 0; i < NCHANGES; i++) {
+      const uint64_t v[2] = { i & 0xffff, i * 3 };
+      nvt_writer_change(w, cnt, i * 10, v);
+
+      if (i % 1000 == 0) {
+         const uint64_t b = (i / 1000) & 1;
+         nvt_writer_change(w, bit, i * 10, &b);
+      }
+   }
+
+   nvt_writer_close(w);
+
+   nvt_reader_t *r = nvt_reader_open(fname);
+   fail_if(r == NULL);
+
+   // The first change is the value in effect at the start of the window
+   uint64_t next = 54321;
+   nvt_reader_read(r, cnt, 543215, 600000, count_fn, &next);
+   fail_unless(next == 60001);
+
+   next = 70000;
+   nvt_reader_read(r, cnt, 700000, 700030, count_fn, &next);
+   fail_unless(next == 70004);
+
+   // Window after the last change
+   next = NCHANGES - 1;
+   nvt_reader_read(r, cnt, UINT64_MAX - 1, UINT64_MAX, count_fn, &next);
+   fail_unless(next == NCHANGES);
+
+   collect_t c = {};
+   nvt_reader_read(r, bit, 25000, 35000, collect_fn, &c);
+   fail_unless(c.nchanges == 2);
+   fail_unless(c.times[0] == 20000);
+   fail_unless(c.values[0][0] == 0);
+   fail_unless(c.times[1] == 30000);
+   fail_unless(c.values[1][0] == 1);
+
+   // Window with no changes still gives the value in effect
+   memset(&c, '\0', sizeof(c));
+   nvt_reader_read(r, bit, 41000, 41500, collect_fn, &c);
+   fail_unless(c.nchanges == 1);
+   fail_unless(c.times[0] == 40000);
+   fail_unless(c.values[0][0] == 0);
+
+   nvt_reader_close(r);
+}
+END_TEST
+
+START_TEST(test_missing)
+{
+   fail_unless(nvt_reader_open("no_such_file.nvt") == NULL);
+}
+END_TEST
+
+Suite *get_nvt_tests(void)
+{
+   Suite *s = suite_create("nvt");
+
+   TCase *tc_core = tcase_create("Core");
+   tcase_add_checked_fixture(tc_core, setup, teardown);
+   tcase_add_test(tc_core, test_roundtrip);
+   tcase_add_test(tc_core, test_window);
+   tcase_add_test(tc_core, test_missing);
+   suite_add_tcase(s, tc_core);
+
+   return s;
+}
@@ -0,0 +1,66 @@
+#include "util.h"
+#include "ident.h"
+#include "rt/pgo.h"
+
+#include <check.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+
+static char fname[64];
+
+static void setup(void)
+{
+   checked_sprintf(fname, sizeof(fname), "test_pgo_%d.pgo", getpid());
+}
+
+static void teardown(void)
+{
+   unlink(fname);
+}
+
+START_TEST(test_roundtrip)
+{
+   FILE *f = fopen(fname, "w");
+   fail_if(f == NULL);
+
+   const uint64_t c1[] = { 5, 1, 4, 0, UINT64_MAX };
+   const uint64_t c2[] = { 1, 1 };
+
+   pgo_write_header(f);
+   pgo_write(f, ident_new(":top:p1"), c1, ARRAY_LEN(c1));
+   pgo_write(f, ident_new(":top:\\ext name\\"), c2, ARRAY_LEN(c2));
+   fclose(f);
+
+   pgo_t *pgo = pgo_read(fname);
+
+   const uint64_t *r1 = pgo_lookup(pgo, ident_new(":top:p1"), ARRAY_LEN(c1));
+   fail_if(r1 == NULL);
+   for (int i = 0; i < ARRAY_LEN(c1); i++)
+      fail_unless(r1[i] == c1[i]);
+
+   const uint64_t *r2 =
+      pgo_lookup(pgo, ident_new(":top:\\ext name\\"), ARRAY_LEN(c2));
+   fail_if(r2 == NULL);
+   fail_unless(r2[0] == 1);
+   fail_unless(r2[1] == 1);
+
+   // Profile no longer matches the code
+   fail_unless(pgo_lookup(pgo, ident_new(":top:p1"), 3) == NULL);
+   fail_unless(pgo_lookup(pgo, ident_new(":top:p3"), 2) == NULL);
+
+   pgo_free(pgo);
+}
+END_TEST
+
+Suite *get_pgo_tests(void)
+{
+   Suite *s = suite_create("pgo");
+
+   TCase *tc_core = tcase_create("Core");
+   tcase_add_checked_fixture(tc_core, setup, teardown);
+   tcase_add_test(tc_core, test_roundtrip);
+   suite_add_tcase(s, tc_core);
+
+   return s;
+}
@@ -586,6 +586,44 @@ START_TEST(test_issue362)
 }
 END_TEST
 
+START_TEST(test_memo)
+{
+   input_from_file(TESTDIR "/simp/memo.vhd");
+
+   unsigned hits0, misses0;
+   eval_memo_stats(&hits0, &misses0);
+
+   tree_t a = parse_check_simplify_and_lower(T_PACKAGE, T_PACK_BODY,
+                                             T_ENTITY, T_ARCH);
+   fail_unless(sem_errors() == 0);
+
+   fail_unless(folded_i(tree_value(tree_decl(a, 0)), 6));
+   fail_unless(folded_i(tree_value(tree_decl(a, 1)), 6));
+   fail_unless(folded_i(tree_value(tree_decl(a, 2)), 3));
+   fail_unless(folded_i(tree_value(tree_decl(a, 3)), 9));
+
+   unsigned hits, misses;
+   eval_memo_stats(&hits, &misses);
+   fail_unless(hits - hits0 == 3);
+   fail_unless(misses - misses0 == 2);
+}
+END_TEST
+
+START_TEST(test_delayed)
+{
+   input_from_file(TESTDIR "/simp/delayed.vhd");
+
+   tree_t a = parse_and_check(T_ENTITY, T_ARCH);
+   fail_unless(sem_errors() == 0);
+
+   simplify(a, 0);
+
+   // One implicit signal and process for each distinct attribute
+   fail_unless(tree_decls(a) == 2 + 4);
+   fail_unless(tree_stmts(a) == 1 + 4);
+}
+END_TEST
+
 Suite *get_simp_tests(void)
 {
    Suite *s = suite_create("simplify");
@@ -611,6 +649,8 @@ Suite *get_simp_tests(void)
    tcase_add_test(tc_core, test_issue344);
    tcase_add_test(tc_core, test_issue345);
    tcase_add_test(tc_core, test_issue362);
+   tcase_add_test(tc_core, test_memo);
+   tcase_add_test(tc_core, test_delayed);
    suite_add_tcase(s, tc_core);
 
    return s;
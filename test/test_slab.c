@@ -0,0 +1,177 @@
+#include "util.h"
+#include "rt/slab.h"
+
+#include <check.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef struct {
+   size_t size;
+   size_t live;
+   size_t peak;
+   size_t slabs;
+} class_info_t;
+
+static void stats_fn(const slab_stats_t *stats, void *context)
+{
+   class_info_t *info = context;
+   if (stats->size == info->size) {
+      info->live  = stats->live_bytes;
+      info->peak  = stats->peak_bytes;
+      info->slabs = stats->slabs;
+   }
+}
+
+static class_info_t get_info(size_t size)
+{
+   class_info_t info = { size, 0, 0, 0 };
+   slab_walk_stats(stats_fn, &info);
+   return info;
+}
+
+static void teardown(void)
+{
+   slab_trim();
+}
+
+START_TEST(test_basic)
+{
+   char *p = slab_alloc(20);
+   char *q = slab_alloc(20);
+   fail_if(p == NULL);
+   fail_if(q == NULL);
+   fail_if(p == q);
+   fail_unless(((uintptr_t)p & 7) == 0);
+
+   memset(p, 'a', 20);
+   memset(q, 'b', 20);
+   fail_unless(p[19] == 'a');
+
+   slab_free(p, 20);
+   slab_free(q, 20);
+
+   // Freed objects are reused from the thread cache
+   char *r = slab_alloc(24);
+   fail_unless(r == p || r == q);
+   slab_free(r, 24);
+}
+END_TEST
+
+START_TEST(test_classes)
+{
+   static const size_t sizes[] = {
+      1, 16, 17, 24, 25, 33, 48, 49, 100, 129, 1000, 3000, 4096
+   };
+
+   void *ptrs[ARRAY_LEN(sizes)];
+   for (size_t i = 0; i < ARRAY_LEN(sizes); i++) {
+      ptrs[i] = slab_alloc(sizes[i]);
+      memset(ptrs[i], i, sizes[i]);
+   }
+
+   for (size_t i = 0; i < ARRAY_LEN(sizes); i++) {
+      const unsigned char *p = ptrs[i];
+      for (size_t j = 0; j < sizes[i]; j++)
+         fail_unless(p[j] == i);
+      slab_free(ptrs[i], sizes[i]);
+   }
+}
+END_TEST
+
+START_TEST(test_large)
+{
+   void *p = slab_alloc(100000);
+   memset(p, 0, 100000);
+
+   class_info_t info = get_info(0);
+   fail_unless(info.live >= 100000);
+
+   slab_free(p, 100000);
+
+   info = get_info(0);
+   fail_unless(info.live == 0);
+   fail_unless(info.peak >= 100000);
+}
+END_TEST
+
+START_TEST(test_release)
+{
+   const int nobjs = 20000;
+   void **ptrs = malloc(nobjs * sizeof(void *));
+
+   for (int i = 0; i < nobjs; i++)
+      ptrs[i] = slab_alloc(64);
+
+   class_info_t info = get_info(64);
+   fail_unless(info.live >= nobjs * 64);
+   fail_unless(info.slabs > 1);
+
+   for (int i = 0; i < nobjs; i++)
+      slab_free(ptrs[i], 64);
+
+   // Empty slabs are released as objects are returned
+   info = get_info(64);
+   fail_unless(info.slabs <= 2);
+   fail_unless(info.peak >= nobjs * 64);
+
+   slab_trim();
+
+   info = get_info(64);
+   fail_unless(info.slabs == 0);
+   fail_unless(info.live == 0);
+
+   free(ptrs);
+}
+END_TEST
+
+START_TEST(test_rand)
+{
+   const int nslots = 512;
+   void **ptrs = calloc(nslots, sizeof(void *));
+   size_t *sizes = calloc(nslots, sizeof(size_t));
+
+   for (int i = 0; i < 50000; i++) {
+      const int slot = rand() % nslots;
+      if (ptrs[slot] != NULL) {
+         fail_unless(*(size_t *)ptrs[slot] == sizes[slot]);
+         slab_free(ptrs[slot], sizes[slot]);
+         ptrs[slot] = NULL;
+      }
+      else {
+         sizes[slot] = 8 + rand() % 5000;
+         ptrs[slot] = slab_alloc(sizes[slot]);
+         *(size_t *)ptrs[slot] = sizes[slot];
+      }
+   }
+
+   for (int i = 0; i < nslots; i++) {
+      if (ptrs[i] != NULL)
+         slab_free(ptrs[i], sizes[i]);
+   }
+
+   slab_trim();
+
+   for (size_t size = 16; size <= 4096; size *= 2)
+      fail_unless(get_info(size).live == 0);
+
+   free(ptrs);
+   free(sizes);
+}
+END_TEST
+
+Suite *get_slab_tests(void)
+{
+   Suite *s = suite_create("slab");
+
+   TCase *tc_core = tcase_create("Core");
+   tcase_add_checked_fixture(tc_core, NULL, teardown);
+   tcase_add_test(tc_core, test_basic);
+   tcase_add_test(tc_core, test_classes);
+   tcase_add_test(tc_core, test_large);
+   tcase_add_test(tc_core, test_release);
+   tcase_add_test(tc_core, test_rand);
+   suite_add_tcase(s, tc_core);
+
+   return s;
+}
@@ -52,6 +52,7 @@ static void setup_per_test(void)
    lib_set_work(test_lib);
 
    opt_set_int("cover", 0);
+   opt_set_int("vcode-opt", 1);
 
    reset_bounds_errors();
    reset_sem_errors();
@@ -0,0 +1,163 @@
+#include "rt/wheel.h"
+
+#include <check.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static wheel_t w = NULL;
+
+static void setup(void)
+{
+   w = wheel_new();
+}
+
+static void teardown(void)
+{
+   wheel_free(w);
+   w = NULL;
+}
+
+static int magnitude_compar(const void *a, const void *b)
+{
+   const uint64_t l = *(const uint64_t *)a;
+   const uint64_t r = *(const uint64_t *)b;
+   return (l > r) - (l < r);
+}
+
+static void walk_fn(uint64_t key, void *user, void *context)
+{
+   int *count = context;
+
+   fail_if(key != (uintptr_t)user);
+
+   (*count)++;
+}
+
+START_TEST(test_basic)
+{
+   wheel_insert(w, 5, (void*)5);
+   wheel_insert(w, 2, (void*)2);
+   wheel_insert(w, 62, (void*)62);
+
+   fail_unless(wheel_size(w) == 3);
+
+   fail_unless(wheel_min(w) == (void*)2);
+   fail_unless(wheel_min_key(w) == 2);
+
+   fail_unless(wheel_extract_min(w) == (void*)2);
+   fail_unless(wheel_extract_min(w) == (void*)5);
+   fail_unless(wheel_extract_min(w) == (void*)62);
+
+   fail_unless(wheel_size(w) == 0);
+}
+END_TEST
+
+START_TEST(test_walk)
+{
+   wheel_insert(w, 5, (void*)5);
+   wheel_insert(w, 1000, (void*)1000);
+   wheel_insert(w, UINT64_C(1) << 60, (void*)(UINT64_C(1) << 60));
+
+   int count = 0;
+   wheel_walk(w, walk_fn, &count);
+
+   fail_unless(count == 3);
+}
+END_TEST
+
+START_TEST(test_fifo)
+{
+   wheel_insert(w, 100, (void*)1);
+   wheel_insert(w, 70000, (void*)2);
+   wheel_insert(w, 100, (void*)3);
+   wheel_insert(w, 70000, (void*)4);
+   wheel_insert(w, UINT64_C(1) << 50, (void*)5);
+   wheel_insert(w, UINT64_C(1) << 50, (void*)6);
+
+   static const uintptr_t expect[] = { 1, 3, 2, 4, 5, 6 };
+   for (int i = 0; i < 6; i++)
+      fail_unless(wheel_extract_min(w) == (void*)expect[i]);
+}
+END_TEST
+
+START_TEST(test_rebase)
+{
+   wheel_insert(w, 10, (void*)10);
+   wheel_insert(w, 500000, (void*)500000);
+
+   fail_unless(wheel_extract_min(w) == (void*)10);
+
+   // Peeking cascades the far entry down
+   fail_unless(wheel_min(w) == (void*)500000);
+
+   // Keys before the new base are kept in order of insertion
+   wheel_insert(w, 30, (void*)30);
+   wheel_insert(w, 20, (void*)20);
+   wheel_insert(w, 600000, (void*)600000);
+   wheel_insert(w, 20, (void*)21);
+
+   fail_unless(wheel_min_key(w) == 20);
+   fail_unless(wheel_extract_min(w) == (void*)20);
+   fail_unless(wheel_extract_min(w) == (void*)21);
+   fail_unless(wheel_extract_min(w) == (void*)30);
+   fail_unless(wheel_extract_min(w) == (void*)500000);
+   fail_unless(wheel_extract_min(w) == (void*)600000);
+   fail_unless(wheel_size(w) == 0);
+}
+END_TEST
+
+START_TEST(test_rand)
+{
+   static const int N = 4096;
+   uint64_t keys[N];
+
+   // Interleave inserts and extracts with each new key no earlier than
+   // the last one removed as in the event queue
+   uint64_t now = 0;
+   int nkeys = 0, next = 0;
+   for (int i = 0; i < N; i++) {
+      uint64_t delay;
+      switch (rand() % 4) {
+      case 0: delay = rand() % 64; break;
+      case 1: delay = rand() % 100000; break;
+      case 2: delay = (uint64_t)rand() << 20; break;
+      default: delay = (uint64_t)rand() << 31; break;
+      }
+
+      keys[nkeys++] = now + delay;
+      wheel_insert(w, now + delay, (void*)(uintptr_t)(now + delay));
+
+      if (rand() % 3 == 0) {
+         qsort(keys + next, nkeys - next, sizeof(uint64_t), magnitude_compar);
+         fail_unless(wheel_min_key(w) == keys[next]);
+         fail_unless(wheel_extract_min(w) == (void*)(uintptr_t)keys[next]);
+         now = keys[next++];
+      }
+   }
+
+   qsort(keys + next, nkeys - next, sizeof(uint64_t), magnitude_compar);
+
+   for (int i = next; i < nkeys; i++)
+      fail_unless(wheel_extract_min(w) == (void*)(uintptr_t)keys[i]);
+
+   fail_unless(wheel_size(w) == 0);
+}
+END_TEST
+
+Suite *get_wheel_tests(void)
+{
+   Suite *s = suite_create("wheel");
+
+   TCase *tc_core = tcase_create("Core");
+   tcase_add_checked_fixture(tc_core, setup, teardown);
+   tcase_add_test(tc_core, test_basic);
+   tcase_add_test(tc_core, test_walk);
+   tcase_add_test(tc_core, test_fifo);
+   tcase_add_test(tc_core, test_rebase);
+   tcase_add_test(tc_core, test_rand);
+   suite_add_tcase(s, tc_core);
+
+   return s;
+}
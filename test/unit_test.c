@@ -50,6 +50,13 @@ int main(int argc, char **argv)
    nfail += RUN_TESTS(ident);
    nfail += RUN_TESTS(hash);
    nfail += RUN_TESTS(heap);
+   nfail += RUN_TESTS(wheel);
+   nfail += RUN_TESTS(slab);
+   nfail += RUN_TESTS(fbuf);
+   nfail += RUN_TESTS(nvt);
+   nfail += RUN_TESTS(cosim);
+   nfail += RUN_TESTS(mem);
+   nfail += RUN_TESTS(pgo);
    nfail += RUN_TESTS(lib);
    nfail += RUN_TESTS(parse);
    nfail += RUN_TESTS(sem);
@@ -59,6 +66,10 @@ int main(int argc, char **argv)
    nfail += RUN_TESTS(lower);
    nfail += RUN_TESTS(group);
    nfail += RUN_TESTS(elab);
+   nfail += RUN_TESTS(depend);
+   nfail += RUN_TESTS(globset);
+   nfail += RUN_TESTS(dist);
+   nfail += RUN_TESTS(make);
 
    return nfail == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
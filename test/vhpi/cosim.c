@@ -0,0 +1,135 @@
+#include "vhpi_user.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Foreign half of the test/perf/cosim.vhd benchmark: drives a new
+// stimulus every nanosecond and reads back the result computed by the
+// design until it sets done
+
+#define fail_if(x)                                                      \
+   if (x) vhpi_assert(vhpiFailure, "assertion '%s' failed at %s:%d",    \
+                      #x, __FILE__, __LINE__)
+#define fail_unless(x) fail_if(!(x))
+
+static vhpiHandleT handle_stim;
+static vhpiHandleT handle_result;
+static vhpiHandleT handle_done;
+static vhpiIntT    stim = 0;
+static unsigned    changes = 0;
+
+static void check_error(void)
+{
+   vhpiErrorInfoT info;
+   if (vhpi_check_error(&info))
+      vhpi_assert(vhpiFailure, "unexpected error '%s'", info.message);
+}
+
+static vhpiIntT get_int(vhpiHandleT handle)
+{
+   vhpiValueT value = {
+      .format = vhpiObjTypeVal
+   };
+   vhpi_get_value(handle, &value);
+   check_error();
+
+   switch (value.format) {
+   case vhpiIntVal:
+      return value.value.intg;
+   case vhpiSmallEnumVal:
+      return value.value.smallenumv;
+   default:
+      return value.value.enumv;
+   }
+}
+
+static void result_change(const vhpiCbDataT *cb_data)
+{
+   (void)get_int(handle_result);
+   changes++;
+}
+
+static void after_1ns(const vhpiCbDataT *cb_data)
+{
+   fail_unless(get_int(handle_result) == stim * 3 + 1);
+
+   if (get_int(handle_done) == 1) {
+      vhpi_printf("%u result changes", changes);
+
+      vhpi_release_handle(handle_stim);
+      vhpi_release_handle(handle_result);
+      vhpi_release_handle(handle_done);
+      return;
+   }
+
+   stim = (stim + 1) % 65536;
+
+   vhpiValueT value = {
+      .format     = vhpiIntVal,
+      .value.intg = stim
+   };
+   vhpi_put_value(handle_stim, &value, vhpiForcePropagate);
+   check_error();
+
+   vhpiTimeT time_1ns = {
+      .low = 1000000
+   };
+
+   vhpiCbDataT cb_data1 = {
+      .reason = vhpiCbAfterDelay,
+      .cb_rtn = after_1ns,
+      .time   = &time_1ns
+   };
+   vhpi_register_cb(&cb_data1, 0);
+   check_error();
+}
+
+static void start_of_sim(const vhpiCbDataT *cb_data)
+{
+   vhpiHandleT root = vhpi_handle(vhpiRootInst, NULL);
+   check_error();
+
+   handle_stim = vhpi_handle_by_name("stim", root);
+   check_error();
+   handle_result = vhpi_handle_by_name("result", root);
+   check_error();
+   handle_done = vhpi_handle_by_name("done", root);
+   check_error();
+
+   vhpi_release_handle(root);
+
+   vhpiCbDataT cb_data1 = {
+      .reason = vhpiCbValueChange,
+      .cb_rtn = result_change,
+      .obj    = handle_result
+   };
+   vhpi_register_cb(&cb_data1, 0);
+   check_error();
+
+   vhpiTimeT time_1ns = {
+      .low = 1000000
+   };
+
+   vhpiCbDataT cb_data2 = {
+      .reason = vhpiCbAfterDelay,
+      .cb_rtn = after_1ns,
+      .time   = &time_1ns
+   };
+   vhpi_register_cb(&cb_data2, 0);
+   check_error();
+}
+
+static void startup()
+{
+   vhpiCbDataT cb_data = {
+      .reason = vhpiCbStartOfSimulation,
+      .cb_rtn = start_of_sim
+   };
+   vhpi_register_cb(&cb_data, 0);
+   check_error();
+}
+
+void (*vhpi_startup_routines[])() = {
+   startup,
+   NULL
+};
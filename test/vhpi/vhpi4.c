@@ -0,0 +1,85 @@
+#include "vhpi_user.h"
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define fail_if(x)                                                      \
+   if (x) vhpi_assert(vhpiFailure, "assertion '%s' failed at %s:%d",    \
+                      #x, __FILE__, __LINE__)
+#define fail_unless(x) fail_if(!(x))
+
+static void check_error(void)
+{
+   vhpiErrorInfoT info;
+   if (vhpi_check_error(&info))
+      vhpi_assert(vhpiFailure, "unexpected error '%s'", info.message);
+}
+
+static void start_of_sim(const vhpiCbDataT *cb_data)
+{
+   vhpi_printf("start_of_sim");
+
+   vhpiHandleT root = vhpi_handle(vhpiRootInst, NULL);
+   check_error();
+   fail_if(root == NULL);
+
+   vhpiHandleT handle_u1 = vhpi_handle_by_name("u1", root);
+   check_error();
+   fail_if(handle_u1 == NULL);
+   fail_unless(vhpi_get(vhpiKindP, handle_u1) == vhpiCompInstStmtK);
+   vhpi_printf("u1 full name is %s",
+               vhpi_get_str(vhpiFullNameP, handle_u1));
+   fail_unless(strcmp((char *)vhpi_get_str(vhpiNameP, handle_u1),
+                      "u1") == 0);
+
+   vhpiHandleT handle_s = vhpi_handle_by_name("s", handle_u1);
+   check_error();
+   fail_if(handle_s == NULL);
+   fail_unless(vhpi_get(vhpiKindP, handle_s) == vhpiSigDeclK);
+   vhpi_printf("s full name is %s", vhpi_get_str(vhpiFullNameP, handle_s));
+
+   vhpiHandleT handle_i = vhpi_handle_by_name("u1.i", root);
+   check_error();
+   fail_if(handle_i == NULL);
+   fail_unless(vhpi_get(vhpiKindP, handle_i) == vhpiPortDeclK);
+
+   // Repeated lookups return the same handle
+   vhpiHandleT handle_s2 = vhpi_handle_by_name("vhpi4.u1.s", NULL);
+   check_error();
+   fail_unless(handle_s2 == handle_s);
+
+   vhpiHandleT handle_x = vhpi_handle_by_name("vhpi4.x", NULL);
+   check_error();
+   fail_if(handle_x == NULL);
+
+   vhpiHandleT handle_bad = vhpi_handle_by_name("u1.nothere", root);
+   fail_unless(handle_bad == NULL);
+
+   vhpiErrorInfoT info;
+   fail_unless(vhpi_check_error(&info));
+
+   vhpi_release_handle(handle_x);
+   vhpi_release_handle(handle_s2);
+   vhpi_release_handle(handle_i);
+   vhpi_release_handle(handle_s);
+   vhpi_release_handle(handle_u1);
+   vhpi_release_handle(root);
+}
+
+static void startup()
+{
+   vhpiCbDataT cb_data1 = {
+      .reason    = vhpiCbStartOfSimulation,
+      .cb_rtn    = start_of_sim,
+      .user_data = NULL,
+   };
+   (void)vhpi_register_cb(&cb_data1, vhpiReturnCb);
+   check_error();
+}
+
+void (*vhpi_startup_routines[])() = {
+   startup,
+   NULL
+};
@@ -0,0 +1,113 @@
+#include "vhpi_user.h"
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define fail_if(x)                                                      \
+   if (x) vhpi_assert(vhpiFailure, "assertion '%s' failed at %s:%d",    \
+                      #x, __FILE__, __LINE__)
+#define fail_unless(x) fail_if(!(x))
+
+static vhpiHandleT handles[4];
+static vhpiHandleT group;
+
+static void check_error(void)
+{
+   vhpiErrorInfoT info;
+   if (vhpi_check_error(&info))
+      vhpi_assert(vhpiFailure, "unexpected error '%s'", info.message);
+}
+
+static void after_1ns(const vhpiCbDataT *cb_data)
+{
+   vhpi_printf("after_1ns");
+
+   vhpiIntT values[7];
+   fail_unless(vhpi_get_group_values(group, values, sizeof(values)) == 0);
+   check_error();
+
+   const vhpiIntT expect[7] = { 10, 0, 1, 0, 0, 1, 'B' };
+   fail_unless(memcmp(values, expect, sizeof(values)) == 0);
+
+   // Only the bit and vector fit the small enumeration format
+   vhpiHandleT small = vhpi_create_value_group(handles + 1, 2,
+                                               vhpiSmallEnumVecVal);
+   check_error();
+   fail_if(small == NULL);
+
+   vhpiSmallEnumT bits[5];
+   fail_unless(vhpi_get_group_values(small, bits, 4) == 5);
+   fail_unless(vhpi_get_group_values(small, bits, sizeof(bits)) == 0);
+   fail_unless(bits[0] == 0 && bits[1] == 1 && bits[4] == 1);
+
+   vhpi_release_handle(small);
+   vhpi_release_handle(group);
+   for (int i = 0; i < 4; i++)
+      vhpi_release_handle(handles[i]);
+}
+
+static void start_of_sim(const vhpiCbDataT *cb_data)
+{
+   vhpi_printf("start_of_sim");
+
+   const char *names[4] = { "x", "b", "v", "c" };
+   vhpiHandleT root = vhpi_handle(vhpiRootInst, NULL);
+   check_error();
+   for (int i = 0; i < 4; i++) {
+      handles[i] = vhpi_handle_by_name(names[i], root);
+      check_error();
+      fail_if(handles[i] == NULL);
+   }
+   vhpi_release_handle(root);
+
+   group = vhpi_create_value_group(handles, 4, vhpiIntVal);
+   check_error();
+   fail_if(group == NULL);
+   vhpi_printf("group has %d elements", vhpi_get(vhpiSizeP, group));
+
+   vhpiIntT values[7];
+   fail_unless(vhpi_get_group_values(group, values, sizeof(values)) == 0);
+   check_error();
+   vhpi_printf("x=%d b=%d v=%d%d%d%d c=%c", values[0], values[1],
+               values[2], values[3], values[4], values[5], values[6]);
+
+   const vhpiIntT forced[7] = { 10, 0, 1, 0, 0, 1, 'B' };
+   vhpi_put_group_values(group, forced, sizeof(forced), vhpiForcePropagate);
+   check_error();
+
+   vhpiHandleT bad = vhpi_create_value_group(handles, 1, vhpiSmallEnumVecVal);
+   fail_unless(bad == NULL);
+
+   vhpiErrorInfoT info;
+   fail_unless(vhpi_check_error(&info));
+
+   vhpiTimeT time_1ns = {
+      .low = 1000000
+   };
+
+   vhpiCbDataT cb_data2 = {
+      .reason = vhpiCbAfterDelay,
+      .cb_rtn = after_1ns,
+      .time   = &time_1ns
+   };
+   vhpi_register_cb(&cb_data2, 0);
+   check_error();
+}
+
+static void startup()
+{
+   vhpiCbDataT cb_data1 = {
+      .reason    = vhpiCbStartOfSimulation,
+      .cb_rtn    = start_of_sim,
+      .user_data = NULL,
+   };
+   (void)vhpi_register_cb(&cb_data1, vhpiReturnCb);
+   check_error();
+}
+
+void (*vhpi_startup_routines[])() = {
+   startup,
+   NULL
+};
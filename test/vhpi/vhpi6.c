@@ -0,0 +1,132 @@
+#include "vhpi_user.h"
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define fail_if(x)                                                      \
+   if (x) vhpi_assert(vhpiFailure, "assertion '%s' failed at %s:%d",    \
+                      #x, __FILE__, __LINE__)
+#define fail_unless(x) fail_if(!(x))
+
+static vhpiHandleT handles[3];
+static vhpiHandleT all_group, ac_group;
+static vhpiHandleT step_cb, delta_cb;
+static vhpiIntT    latest[3];
+static int         delta_batches, delta_changes;
+
+static void check_error(void)
+{
+   vhpiErrorInfoT info;
+   if (vhpi_check_error(&info))
+      vhpi_assert(vhpiFailure, "unexpected error '%s'", info.message);
+}
+
+static void time_step_changes(const vhpiCbDataT *cb_data)
+{
+   fail_unless(cb_data->obj == all_group);
+   fail_unless(cb_data->value->format == vhpiPtrVal);
+
+   const vhpiValueChangeT *changes = cb_data->value->value.ptr;
+   const int count = cb_data->value->numElems;
+
+   for (int i = 0; i < count; i++) {
+      fail_unless(changes[i].numElems == 1);
+      for (int j = 0; j < 3; j++) {
+         if (changes[i].obj == handles[j])
+            latest[j] = *(const vhpiIntT *)changes[i].value;
+      }
+   }
+
+   long cycles;
+   vhpiTimeT now;
+   vhpi_get_time(&now, &cycles);
+
+   vhpi_printf("%d fs: %d changes a=%d b=%d c=%d", now.low, count,
+               latest[0], latest[1], latest[2]);
+}
+
+static void delta_changes_cb(const vhpiCbDataT *cb_data)
+{
+   fail_unless(cb_data->obj == ac_group);
+
+   // Signal c always changes in the delta after a
+   fail_unless(cb_data->value->numElems == 1);
+
+   delta_batches++;
+   delta_changes += cb_data->value->numElems;
+}
+
+static void start_of_sim(const vhpiCbDataT *cb_data)
+{
+   const char *names[3] = { "a", "b", "c" };
+   vhpiHandleT root = vhpi_handle(vhpiRootInst, NULL);
+   check_error();
+   for (int i = 0; i < 3; i++) {
+      handles[i] = vhpi_handle_by_name(names[i], root);
+      check_error();
+      fail_if(handles[i] == NULL);
+   }
+   vhpi_release_handle(root);
+
+   all_group = vhpi_create_value_group(handles, 3, vhpiIntVal);
+   check_error();
+
+   vhpiHandleT ac[2] = { handles[0], handles[2] };
+   ac_group = vhpi_create_value_group(ac, 2, vhpiIntVal);
+   check_error();
+
+   vhpiCbDataT cb_data2 = {
+      .reason = vhpiCbGroupChangeTimeStep,
+      .cb_rtn = time_step_changes,
+      .obj    = all_group
+   };
+   step_cb = vhpi_register_cb(&cb_data2, vhpiReturnCb);
+   check_error();
+
+   vhpiCbDataT cb_data3 = {
+      .reason = vhpiCbGroupChangeDelta,
+      .cb_rtn = delta_changes_cb,
+      .obj    = ac_group
+   };
+   delta_cb = vhpi_register_cb(&cb_data3, vhpiReturnCb);
+   check_error();
+
+   // The callbacks keep the groups and signals alive
+   vhpi_release_handle(all_group);
+   vhpi_release_handle(ac_group);
+   for (int i = 0; i < 3; i++)
+      vhpi_release_handle(handles[i]);
+}
+
+static void end_of_sim(const vhpiCbDataT *cb_data)
+{
+   vhpi_printf("%d delta batches with %d changes", delta_batches,
+               delta_changes);
+
+   vhpi_release_handle(step_cb);
+   vhpi_release_handle(delta_cb);
+}
+
+static void startup()
+{
+   vhpiCbDataT cb_data1 = {
+      .reason = vhpiCbStartOfSimulation,
+      .cb_rtn = start_of_sim
+   };
+   vhpi_register_cb(&cb_data1, 0);
+   check_error();
+
+   vhpiCbDataT cb_data2 = {
+      .reason = vhpiCbEndOfSimulation,
+      .cb_rtn = end_of_sim
+   };
+   vhpi_register_cb(&cb_data2, 0);
+   check_error();
+}
+
+void (*vhpi_startup_routines[])() = {
+   startup,
+   NULL
+};
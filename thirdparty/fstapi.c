@@ -56,6 +56,8 @@
 #include <windows.h>
 #endif
 
+#include <sys/time.h>
+
 #ifdef HAVE_ALLOCA_H
 #include <alloca.h>
 #elif defined(__GNUC__)
@@ -784,6 +786,10 @@ size_t fst_huge_break_size;
 
 fstHandle next_huge_break;
 
+int zlib_level;
+uint64_t flush_count;
+uint64_t flush_usec;
+
 Pvoid_t path_array;
 uint32_t path_array_count;
 
@@ -1098,6 +1104,7 @@ xc->fst_huge_break_size = FST_BREAK_SIZE;
 xc->fst_break_size = xc->fst_orig_break_size = FST_BREAK_SIZE;
 xc->fst_break_add_size = xc->fst_orig_break_add_size = FST_BREAK_ADD_SIZE;
 xc->next_huge_break = FST_ACTIVATE_HUGE_BREAK;
+xc->zlib_level = 4;
 }
 
 
@@ -1444,7 +1451,7 @@ for(i=0;i<xc->maxhandle;i++)
                                         dmem = packmem = malloc(compressBound(packmemlen = wrlen));
                                         }
 
-                                rc = compress2(dmem, &destlen, scratchpnt, wrlen, 4);
+                                rc = compress2(dmem, &destlen, scratchpnt, wrlen, xc->zlib_level);
                                 if(rc == Z_OK)
                                         {
 #ifndef FST_DYNAMIC_ALIAS_DISABLE
@@ -2487,6 +2494,56 @@ if(xc)
 }
 
 
+/*
+ * size of value change data buffered before a section is flushed, this
+ * also stops the buffer growing with the number of signals
+ */
+void fstWriterSetBreakSize(void *ctx, size_t numbytes)
+{
+struct fstWriterContext *xc = (struct fstWriterContext *)ctx;
+if(xc && numbytes)
+        {
+        if(numbytes > FST_BREAK_SIZE_MAX) numbytes = FST_BREAK_SIZE_MAX;
+        xc->fst_break_size = xc->fst_orig_break_size = numbytes;
+        xc->fst_huge_break_size = numbytes;
+
+        if(xc->vchg_mem && (xc->vchg_siz < numbytes + xc->fst_break_add_size))
+                {
+                xc->vchg_alloc_siz = numbytes + xc->fst_break_add_size;
+                xc->vchg_mem = realloc(xc->vchg_mem, xc->vchg_alloc_siz);
+                }
+        }
+}
+
+
+/*
+ * zlib level used for value change data when the pack type is zlib
+ */
+void fstWriterSetCompressionLevel(void *ctx, int level)
+{
+struct fstWriterContext *xc = (struct fstWriterContext *)ctx;
+if(xc)
+        {
+        xc->zlib_level = (level < 1) ? 1 : (level > 9) ? 9 : level;
+        }
+}
+
+
+/*
+ * number of sections flushed and total time in microseconds the caller
+ * was blocked by them
+ */
+void fstWriterGetFlushStats(void *ctx, uint64_t *count, uint64_t *usec)
+{
+struct fstWriterContext *xc = (struct fstWriterContext *)ctx;
+if(xc)
+        {
+        *count = xc->flush_count;
+        *usec = xc->flush_usec;
+        }
+}
+
+
 void fstWriterSetDumpSizeLimit(void *ctx, uint64_t numbytes)
 {
 struct fstWriterContext *xc = (struct fstWriterContext *)ctx;
@@ -2925,8 +2982,14 @@ if(xc)
                 {
                 if((xc->vchg_siz >= xc->fst_break_size) || (xc->flush_context_pending))
                         {
+                        struct timeval tv_start, tv_end;
+                        gettimeofday(&tv_start, NULL);
                         xc->flush_context_pending = 0;
                         fstWriterFlushContextPrivate(xc);
+                        gettimeofday(&tv_end, NULL);
+                        xc->flush_count++;
+                        xc->flush_usec += (tv_end.tv_sec - tv_start.tv_sec) * 1000000
+                                + (tv_end.tv_usec - tv_start.tv_usec);
                         xc->tchn_cnt++;
                         fstWriterVarint(xc->tchn_handle, xc->curtime);
                         }
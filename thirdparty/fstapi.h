@@ -340,10 +340,13 @@ void            fstWriterEmitTimeChange(void *ctx, uint64_t tim);
 void            fstWriterFlushContext(void *ctx);
 int             fstWriterGetDumpSizeLimitReached(void *ctx);
 int             fstWriterGetFseekFailed(void *ctx);
+void            fstWriterGetFlushStats(void *ctx, uint64_t *count, uint64_t *usec);
 void            fstWriterSetAttrBegin(void *ctx, enum fstAttrType attrtype, int subtype,
                         const char *attrname, uint64_t arg);
 void            fstWriterSetAttrEnd(void *ctx);
+void            fstWriterSetBreakSize(void *ctx, size_t numbytes);
 void            fstWriterSetComment(void *ctx, const char *comm);
+void            fstWriterSetCompressionLevel(void *ctx, int level);
 void            fstWriterSetDate(void *ctx, const char *dat);
 void            fstWriterSetDumpSizeLimit(void *ctx, uint64_t numbytes);
 void            fstWriterSetEnvVar(void *ctx, const char *envvar);